@@ -0,0 +1,156 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    ActivityComponent.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ActivityComponent.h"
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include "CommandMap.h"
+#include "LR_IPC_Out.h"
+#include "MIDIProcessor.h"
+#include "PowerMonitor.h"
+
+namespace {
+    constexpr int kSampleInterval = 500; //ms
+    constexpr size_t kTopCount = 8;
+    constexpr int kLeft = 30; //room for channel numbers
+    constexpr int kTop = 20; //room for section titles
+    constexpr int kCellWidth = 3;
+    constexpr int kCellHeight = 10;
+    constexpr int kLineHeight = 14;
+    constexpr int kMapWidth = kCellWidth * static_cast<int>(ActivityStats::kControls);
+    constexpr int kMapHeight = kCellHeight * static_cast<int>(ActivityStats::kChannels);
+    constexpr int kListTop = kTop + kMapHeight + 15;
+    constexpr float kHottestRate = 1000.f; //messages/s drawn fully red
+    constexpr size_t kSlots = ActivityStats::kChannels * ActivityStats::kControls;
+
+    // the largest entries, largest first
+    void KeepTop(std::vector<std::pair<float, size_t>>& entries)
+    {
+        const auto count = std::min(entries.size(), kTopCount);
+        std::partial_sort(entries.begin(), entries.begin() + static_cast<std::ptrdiff_t>(count),
+            entries.end(), std::greater<std::pair<float, size_t>>());
+        entries.resize(count);
+    }
+}
+
+ActivityComponent::ActivityComponent(std::shared_ptr<MIDIProcessor> midi_processor,
+    std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out):
+    midi_processor_{std::move(midi_processor)}, lr_ipc_out_{std::move(lr_ipc_out)},
+    last_counts_(kSlots), rates_(kSlots)
+{
+    setSize(kLeft + kMapWidth + 10, kListTop + kLineHeight * static_cast<int>(kTopCount + 1) + 10);
+    startTimer(kSampleInterval);
+}
+
+ActivityComponent::~ActivityComponent()
+{
+    stopTimer();
+}
+
+void ActivityComponent::timerCallback()
+{
+    PowerMonitor::CountWakeUp();
+    if (!isShowing()) { //closing the dialog only hides it, and reopening makes a new one
+        stopTimer();
+        return;
+    }
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    const auto seconds = static_cast<float>(std::max(1e-3, (now - last_sample_) / 1000.0));
+    const auto first = last_sample_ == 0.0; //only take a baseline
+    last_sample_ = now;
+    top_controls_.clear();
+    if (midi_processor_) {
+        const auto& activity = midi_processor_->getActivityStats();
+        for (size_t slot = 0; slot < kSlots; ++slot) {
+            const auto count = activity.Count(slot / ActivityStats::kControls,
+                slot % ActivityStats::kControls);
+            rates_[slot] = first ? 0.f : static_cast<float>(count - last_counts_[slot]) / seconds;
+            last_counts_[slot] = count;
+            if (rates_[slot] > 0.f)
+                top_controls_.emplace_back(rates_[slot], slot);
+        }
+        KeepTop(top_controls_);
+    }
+    top_commands_.clear();
+    if (const auto ptr = lr_ipc_out_.lock()) {
+        const auto& outbound = ptr->getOutboundStats();
+        last_bytes_.resize(outbound.CommandCount());
+        for (size_t id = 0; id < last_bytes_.size(); ++id) {
+            const auto bytes = outbound.SentBytes(id);
+            if (!first && bytes > last_bytes_[id])
+                top_commands_.emplace_back(static_cast<float>(bytes - last_bytes_[id]) / seconds, id);
+            last_bytes_[id] = bytes;
+        }
+        KeepTop(top_commands_);
+    }
+    repaint();
+}
+
+void ActivityComponent::paint(juce::Graphics& g)
+{
+    g.fillAll(juce::Colours::white);
+    g.setFont(12.0f);
+    g.setColour(juce::Colours::black);
+    // section titles over CC, notes and pitch bend
+    g.drawText("CC", kLeft, 0, kCellWidth * 128, kTop, juce::Justification::centred);
+    g.drawText("Note", kLeft + kCellWidth * 128, 0, kCellWidth * 128, kTop,
+        juce::Justification::centred);
+    g.drawText("PB", kLeft + kMapWidth - 20, 0, 20, kTop, juce::Justification::centredRight);
+    for (size_t channel = 0; channel < ActivityStats::kChannels; ++channel) {
+        const auto y = kTop + kCellHeight * static_cast<int>(channel);
+        g.setColour(juce::Colours::black);
+        g.drawText(juce::String(static_cast<int>(channel) + 1), 0, y, kLeft - 5, kCellHeight,
+            juce::Justification::centredRight);
+        for (size_t control = 0; control < ActivityStats::kControls; ++control) {
+            const auto rate = rates_[channel * ActivityStats::kControls + control];
+            if (rate <= 0.f)
+                continue;
+            // log scale, yellow for a trickle to red at kHottestRate
+            const auto heat = juce::jlimit(0.f, 1.f,
+                std::log10(1.f + rate) / std::log10(1.f + kHottestRate));
+            g.setColour(juce::Colour::fromHSV(0.17f * (1.f - heat), 1.f, 1.f, 1.f));
+            g.fillRect(kLeft + kCellWidth * static_cast<int>(control), y, kCellWidth, kCellHeight);
+        }
+    }
+    g.setColour(juce::Colours::grey);
+    g.drawRect(kLeft - 1, kTop - 1, kMapWidth + 2, kMapHeight + 2);
+
+    const auto column_width = (getWidth() - kLeft) / 2;
+    g.setColour(juce::Colours::black);
+    g.drawText("Busiest controls, messages/s", kLeft, kListTop, column_width, kLineHeight,
+        juce::Justification::centredLeft);
+    g.drawText("Most bytes to Lightroom, bytes/s", kLeft + column_width, kListTop, column_width,
+        kLineHeight, juce::Justification::centredLeft);
+    for (size_t i = 0; i < top_controls_.size(); ++i)
+        g.drawText(ActivityStats::ControlName(top_controls_[i].second / ActivityStats::kControls,
+            top_controls_[i].second % ActivityStats::kControls) + ": " +
+            juce::String(top_controls_[i].first, 1), kLeft,
+            kListTop + kLineHeight * static_cast<int>(i + 1), column_width, kLineHeight,
+            juce::Justification::centredLeft);
+    for (size_t i = 0; i < top_commands_.size(); ++i)
+        g.drawText(juce::String(CommandMap::getCommandString(
+            static_cast<CommandMap::CommandId>(top_commands_[i].second))) + ": " +
+            juce::String(top_commands_[i].first, 1), kLeft + column_width,
+            kListTop + kLineHeight * static_cast<int>(i + 1), column_width, kLineHeight,
+            juce::Justification::centredLeft);
+}
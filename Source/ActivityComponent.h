@@ -0,0 +1,58 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ActivityComponent.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_ACTIVITYCOMPONENT_H_INCLUDED
+#define MIDI2LR_ACTIVITYCOMPONENT_H_INCLUDED
+
+#include <memory>
+#include <utility>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LatencyStats.h"
+class LR_IPC_OUT;
+class MIDIProcessor;
+
+// live heatmap of message rates per channel and control, with the busiest controls
+// and the commands sending the most bytes to Lightroom
+class ActivityComponent final: public juce::Component, private juce::Timer {
+public:
+    ActivityComponent(std::shared_ptr<MIDIProcessor> midi_processor,
+        std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out);
+    ~ActivityComponent();
+    ActivityComponent(const ActivityComponent&) = delete;
+    ActivityComponent& operator=(const ActivityComponent&) = delete;
+
+private:
+    void paint(juce::Graphics&) override;
+    // Timer interface, samples the counters
+    void timerCallback() override;
+
+    std::shared_ptr<MIDIProcessor> midi_processor_;
+    std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
+    double last_sample_{0.0};
+    std::vector<juce::uint32> last_counts_;
+    std::vector<juce::uint64> last_bytes_;
+    std::vector<float> rates_; //messages/s per channel and control, last interval
+    std::vector<std::pair<float, size_t>> top_controls_; //rate, channel * kControls + control
+    std::vector<std::pair<float, size_t>> top_commands_; //bytes/s, command id
+};
+
+#endif  // ACTIVITYCOMPONENT_H_INCLUDED
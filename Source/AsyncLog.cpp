@@ -0,0 +1,241 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    AsyncLog.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "AsyncLog.h"
+#include <algorithm>
+#include <array>
+#include <cstdarg>
+#include <cstdio>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace {
+    constexpr size_t kLines = 256; //per thread, a power of two
+    constexpr size_t kLineLength = 160;
+    constexpr int kFlushInterval = 250; //ms
+    constexpr int kStopWait = 1000;
+    constexpr std::array<const char*, 5> kLevelNames{{"off", "error", "warning", "info", "debug"}};
+    constexpr std::array<const char*, RSJ::kLogCategories> kCategoryNames{{"MIDI", "IPC",
+        "profile", "keys"}};
+
+    struct Line {
+        juce::uint32 time;
+        RSJ::LogLevel level;
+        RSJ::LogCategory category;
+        char text[kLineLength];
+    };
+    // written by its thread, read by the flusher
+    struct ThreadRing {
+        juce::String thread_name;
+        std::atomic<juce::uint64> written{0};
+        std::atomic<juce::uint64> read{0};
+        std::atomic<juce::uint32> dropped{0};
+        std::array<Line, kLines> lines;
+    };
+    // lines this second, reset by the first line of the next
+    struct CategoryLimit {
+        std::atomic<juce::uint32> second{0};
+        std::atomic<int> lines{0};
+        std::atomic<juce::uint32> suppressed{0};
+    };
+    // rings outlive their threads, so a thread's last lines are still written
+    struct Registry {
+        std::mutex mutex;
+        std::deque<std::unique_ptr<ThreadRing>> rings;
+        std::array<CategoryLimit, RSJ::kLogCategories> limits;
+    };
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+    // allocates and locks on a thread's first call, so threads register before writing.
+    // nullptr if the ring can't be made
+    ThreadRing* GetRing() noexcept
+    {
+        thread_local ThreadRing* ring{nullptr};
+        if (!ring) try {
+            auto created = std::make_unique<ThreadRing>();
+            if (const auto thread = juce::Thread::getCurrentThread())
+                created->thread_name = thread->getThreadName();
+            else if (const auto manager = juce::MessageManager::getInstanceWithoutCreating())
+                created->thread_name = manager->isThisTheMessageThread() ?
+                "message thread" : "driver thread";
+            auto& registry = GetRegistry();
+            std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+            registry.rings.push_back(std::move(created));
+            ring = registry.rings.back().get();
+        }
+        catch (...) {
+            return nullptr;
+        }
+        return ring;
+    }
+
+    class Flusher final: juce::Thread {
+    public:
+        explicit Flusher(const juce::File& file): juce::Thread{"MIDI2LR log"}, file_{file}
+        {
+            startThread(2); //well below the MIDI and IPC threads
+        }
+        ~Flusher()
+        {
+            signalThreadShouldExit();
+            notify();
+            stopThread(kStopWait);
+            Flush_();
+        }
+        Flusher(const Flusher&) = delete;
+        Flusher& operator=(const Flusher&) = delete;
+
+    private:
+        void run() override
+        {
+            while (!threadShouldExit()) {
+                wait(kFlushInterval);
+                Flush_();
+            }
+        }
+        void Flush_();
+        juce::File file_;
+        std::mutex flush_mutex_; //the destructor's flush may overlap the thread's last
+    };
+
+    void Flusher::Flush_()
+    {
+        std::lock_guard<decltype(flush_mutex_)> flush_lock(flush_mutex_);
+        // ms counter to wall clock, for every line of this flush
+        const auto counter = juce::Time::getMillisecondCounter();
+        const auto wall = juce::Time::currentTimeMillis();
+        std::vector<std::pair<juce::uint32, juce::String>> lines;
+        auto& registry = GetRegistry();
+        {
+            std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+            for (const auto& ring : registry.rings) {
+                const auto written = ring->written.load(std::memory_order_acquire);
+                for (auto i = ring->read.load(std::memory_order_relaxed); i < written; ++i) {
+                    const auto& line = ring->lines[i & (kLines - 1)];
+                    lines.emplace_back(line.time, ring->thread_name + " " +
+                        kCategoryNames[static_cast<size_t>(line.category)] + " " +
+                        kLevelNames[static_cast<size_t>(line.level)] + ": " +
+                        juce::String::fromUTF8(line.text));
+                }
+                ring->read.store(written, std::memory_order_release);
+                if (const auto dropped = ring->dropped.exchange(0, std::memory_order_relaxed))
+                    lines.emplace_back(counter, ring->thread_name + " dropped " +
+                        juce::String(dropped) + " lines, its ring was full");
+            }
+        }
+        for (size_t c = 0; c < RSJ::kLogCategories; ++c)
+            if (const auto suppressed = registry.limits[c].suppressed.exchange(0,
+                std::memory_order_relaxed))
+                lines.emplace_back(counter, juce::String{kCategoryNames[c]} + " suppressed " +
+                    juce::String(suppressed) + " lines over " +
+                    juce::String(AsyncLog::kLinesPerSecond) + "/s");
+        if (lines.empty())
+            return;
+        std::stable_sort(lines.begin(), lines.end(), [](const std::pair<juce::uint32, juce::String>& a,
+            const std::pair<juce::uint32, juce::String>& b) noexcept {
+            return static_cast<juce::int32>(a.first - b.first) < 0; });
+        juce::String text;
+        for (const auto& line : lines) {
+            const juce::Time time{wall - static_cast<juce::int64>(counter - line.first)};
+            text << time.formatted("%Y-%m-%d %H:%M:%S.") <<
+                juce::String(time.getMilliseconds()).paddedLeft('0', 3) << " " << line.second << "\n";
+        }
+        file_.appendText(text);
+    }
+
+    std::unique_ptr<Flusher> flusher{nullptr}; //message thread
+}
+
+std::atomic<int> AsyncLog::level_{static_cast<int>(RSJ::LogLevel::off)};
+
+void AsyncLog::Start(const juce::File& file, RSJ::LogLevel level)
+{
+    Stop();
+    if (level == RSJ::LogLevel::off)
+        return;
+    flusher = std::make_unique<Flusher>(file);
+    RegisterThread();
+    SetLevel(level);
+}
+
+void AsyncLog::RegisterThread() noexcept
+{
+    GetRing();
+}
+
+void AsyncLog::Stop()
+{
+    SetLevel(RSJ::LogLevel::off);
+    flusher.reset();
+}
+
+void AsyncLog::SetLevel(RSJ::LogLevel level) noexcept
+{
+    level_.store(flusher ? static_cast<int>(level) : static_cast<int>(RSJ::LogLevel::off),
+        std::memory_order_relaxed);
+}
+
+RSJ::LogLevel AsyncLog::ParseLevel(const juce::String& name) noexcept
+{
+    for (size_t i = 0; i < kLevelNames.size(); ++i)
+        if (name.equalsIgnoreCase(kLevelNames[i]))
+            return static_cast<RSJ::LogLevel>(i);
+    return RSJ::LogLevel::off;
+}
+
+void AsyncLog::Write_(RSJ::LogCategory category, RSJ::LogLevel level, const char* format,
+    ...) noexcept
+{
+    const auto now = juce::Time::getMillisecondCounter();
+    auto& limit = GetRegistry().limits[static_cast<size_t>(category)];
+    // threads racing over a new second may let a few extra lines through
+    if (limit.second.exchange(now / 1000, std::memory_order_relaxed) != now / 1000)
+        limit.lines.store(0, std::memory_order_relaxed);
+    if (limit.lines.fetch_add(1, std::memory_order_relaxed) >= kLinesPerSecond) {
+        limit.suppressed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const auto ring_pointer = GetRing();
+    if (!ring_pointer)
+        return;
+    auto& ring = *ring_pointer;
+    const auto index = ring.written.load(std::memory_order_relaxed);
+    if (index - ring.read.load(std::memory_order_acquire) >= kLines) {
+        ring.dropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    auto& line = ring.lines[index & (kLines - 1)];
+    line.time = now;
+    line.level = level;
+    line.category = category;
+    va_list args;
+    va_start(args, format);
+    std::vsnprintf(line.text, kLineLength, format, args);
+    va_end(args);
+    ring.written.store(index + 1, std::memory_order_release);
+}
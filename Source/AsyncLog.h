@@ -0,0 +1,75 @@
+#pragma once
+/*
+  ==============================================================================
+
+    AsyncLog.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_ASYNCLOG_H_INCLUDED
+#define MIDI2LR_ASYNCLOG_H_INCLUDED
+
+#include <atomic>
+#include "../JuceLibraryCode/JuceHeader.h"
+
+namespace RSJ {
+    enum struct LogLevel: int {
+        off, error, warning, info, debug
+    };
+    enum struct LogCategory: int {
+        midi, ipc, profile, keys
+    };
+    constexpr size_t kLogCategories = 4;
+}
+
+// Logging the MIDI and IPC threads can afford. A line is formatted straight into the
+// calling thread's ring, without locking or allocating once the thread has registered,
+// and a background thread appends the rings to the log file in time order. A full ring
+// drops the line rather than wait, and each category keeps to kLinesPerSecond so a
+// stuck control can't flood the file; both are noted in the file. Any thread
+class AsyncLog {
+public:
+    constexpr static int kLinesPerSecond = 50;
+    // starts the flusher appending to file. Nothing is logged before. Message thread
+    static void Start(const juce::File& file, RSJ::LogLevel level);
+    // writes what is left and stops the flusher. Message thread
+    static void Stop();
+    // makes the calling thread's ring now, as the first line of an unregistered thread
+    // allocates it, and drops the line if it can't. RSJ::RaiseCurrentThread calls this
+    static void RegisterThread() noexcept;
+    static void SetLevel(RSJ::LogLevel level) noexcept;
+    // "off", "error", "warning", "info" or "debug", anything else is off
+    static RSJ::LogLevel ParseLevel(const juce::String& name) noexcept;
+    static bool Enabled(RSJ::LogLevel level) noexcept
+    {
+        return static_cast<int>(level) <= level_.load(std::memory_order_relaxed);
+    }
+    // printf style, so arguments must be plain values: pass strings as toRawUTF8()
+    template<class... Args>
+    static void Write(RSJ::LogCategory category, RSJ::LogLevel level, const char* format,
+        Args... args) noexcept
+    {
+        if (Enabled(level))
+            Write_(category, level, format, args...);
+    }
+
+private:
+    static void Write_(RSJ::LogCategory category, RSJ::LogLevel level, const char* format,
+        ...) noexcept;
+    static std::atomic<int> level_;
+};
+
+#endif  // ASYNCLOG_H_INCLUDED
@@ -0,0 +1,573 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    Benchmark.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "Benchmark.h"
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "CommandMap.h"
+#include "ControlsModel.h"
+#include "LR_IPC_Out.h"
+#include "LRCommands.h"
+#include "MIDIProcessor.h"
+#include "MidiUtilities.h"
+#include "NrpnMessage.h"
+#include "ParserHarness.h"
+#include "Utilities/Utilities.h"
+#ifdef MIDI2LR_RTMIDI
+#include "../rtmidi/RtMidi.h"
+#endif
+
+namespace {
+    constexpr size_t kOperations = 1 << 20;
+    constexpr size_t kWarmUp = kOperations / 16;
+    constexpr size_t kBatch = 64;
+    constexpr short kControl = 1;
+    constexpr size_t kMaxSources = 8;
+    constexpr size_t kInFlight = 256; //per source, so the ingress queue never drops
+    volatile double sink{0.0}; //results land here so the optimizer keeps the work
+
+    // runs operation(i) for i in [0, kOperations) after a warm-up, and adds its row
+    template<class Operation>
+    void Time(juce::String& report, const char* name, Operation&& operation)
+    {
+        for (size_t i = 0; i < kWarmUp; ++i)
+            operation(i);
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kOperations; ++i)
+            operation(i);
+        const auto taken = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+        report << name << ", " << juce::String(taken / kOperations, 2) << ", "
+            << juce::String(static_cast<juce::int64>(kOperations)) << "\n";
+    }
+
+    short Value(size_t i) noexcept
+    {
+        return static_cast<short>(i & 0x7F);
+    }
+
+    void ControlsCases(juce::String& report)
+    {
+        const std::array<std::pair<RSJ::CCmethod, const char*>, 4> methods{{
+            {RSJ::CCmethod::absolute, "absolute"},
+            {RSJ::CCmethod::twoscomplement, "twoscomplement"},
+            {RSJ::CCmethod::binaryoffset, "binaryoffset"},
+            {RSJ::CCmethod::signmagnitude, "signmagnitude"}}};
+        for (const auto& method : methods) {
+            ControlsModel model;
+            model.setCCmethod(0, kControl, method.first);
+            const auto to_plugin = juce::String{"ControllerToPlugin "} + method.second;
+            Time(report, to_plugin.toRawUTF8(), [&model](size_t i) {
+                sink = sink + model.ControllerToPlugin({RSJ::kCCFlag, 0, kControl, Value(i)});
+            });
+            const auto to_controller = juce::String{"PluginToController "} + method.second;
+            Time(report, to_controller.toRawUTF8(), [&model](size_t i) {
+                sink = sink + model.PluginToController(RSJ::kCCFlag, 0, kControl,
+                    static_cast<double>(i & 0xFF) / 255.0);
+            });
+        }
+        ControlsModel model;
+        std::array<RSJ::MidiMessage, kBatch> messages;
+        for (size_t i = 0; i < kBatch; ++i)
+            messages[i] = {RSJ::kCCFlag, 0, static_cast<short>(i), Value(i)};
+        std::array<double, kBatch> results;
+        Time(report, "ControllerToPlugin batch of 64", [&](size_t) {
+            model.ControllerToPlugin(messages, results);
+            sink = sink + results[0];
+        });
+    }
+
+    constexpr size_t kChannels = 16;
+    constexpr size_t kControls = 0x4000; //per channel, CC and NRPN
+    constexpr size_t kRandomMessages = 1 << 16;
+
+    // messages on random channels and controls, so each conversion is a cache miss
+    // and the rows measure how many lines a control's settings span
+    std::vector<RSJ::MidiMessage> RandomMessages()
+    {
+        std::vector<RSJ::MidiMessage> messages(kRandomMessages);
+        juce::uint32 state{0x2545F491}; //xorshift32
+        for (size_t i = 0; i < kRandomMessages; ++i) {
+            state ^= state << 13;
+            state ^= state >> 17;
+            state ^= state << 5;
+            messages[i] = {RSJ::kCCFlag, static_cast<short>(state % kChannels),
+                static_cast<short>((state >> 4) % kControls), Value(i)};
+        }
+        return messages;
+    }
+
+    // the layout ChannelModel had before the settings were packed: one array per field
+    struct SplitControls {
+        std::array<RSJ::CCmethod, kControls> method;
+        std::array<short, kControls> high;
+        std::array<short, kControls> low;
+        std::array<std::atomic<short>, kControls> current;
+    };
+
+    // one record per control holding all four fields
+    struct alignas(8) PackedControl {
+        RSJ::CCmethod method;
+        short low;
+        short high;
+        std::atomic<short> current;
+    };
+
+    // absolute conversion the way the old ChannelModel did it, reading method, low and
+    // high for the control
+    template<class Method, class Low, class High>
+    double Convert(const Method& method, const Low& low, const High& high, short value) noexcept
+    {
+        if (method != RSJ::CCmethod::absolute)
+            return 0.0;
+        return static_cast<double>(value - low) / static_cast<double>(high - low);
+    }
+
+    void LayoutCases(juce::String& report)
+    {
+        const auto messages = RandomMessages();
+        const auto high = [](size_t control) noexcept {
+            return static_cast<short>(control < 0x80 ? 0x7F : 0x3FFF);
+        };
+        {
+            const auto split = std::make_unique<std::array<SplitControls, kChannels>>();
+            for (auto& channel : *split)
+                for (size_t control = 0; control < kControls; ++control) {
+                    channel.method[control] = RSJ::CCmethod::absolute;
+                    channel.high[control] = high(control);
+                    channel.low[control] = 0;
+                    channel.current[control].store(0x3F, std::memory_order_relaxed);
+                }
+            Time(report, "random control layout split arrays", [&](size_t i) {
+                const auto& mm = messages[i & (kRandomMessages - 1)];
+                const auto& channel = (*split)[static_cast<size_t>(mm.channel)];
+                const auto control = static_cast<size_t>(mm.number);
+                sink = sink + Convert(channel.method[control], channel.low[control],
+                    channel.high[control], mm.value);
+            });
+        }
+        {
+            const auto packed = std::make_unique<
+                std::array<std::array<PackedControl, kControls>, kChannels>>();
+            for (auto& channel : *packed)
+                for (size_t control = 0; control < kControls; ++control) {
+                    auto& record = channel[control];
+                    record.method = RSJ::CCmethod::absolute;
+                    record.high = high(control);
+                    record.low = 0;
+                    record.current.store(0x3F, std::memory_order_relaxed);
+                }
+            Time(report, "random control layout packed records", [&](size_t i) {
+                const auto& mm = messages[i & (kRandomMessages - 1)];
+                const auto& record =
+                    (*packed)[static_cast<size_t>(mm.channel)][static_cast<size_t>(mm.number)];
+                sink = sink + Convert(record.method, record.low, record.high, mm.value);
+            });
+        }
+        ControlsModel model;
+        Time(report, "random control ControlsModel", [&](size_t i) {
+            sink = sink + model.ControllerToPlugin(messages[i & (kRandomMessages - 1)]);
+        });
+    }
+
+    class Subscriber {
+    public:
+        void Received(RSJ::MidiMessage mm)
+        {
+            total += mm.value;
+        }
+        size_t total{0};
+    };
+
+    // MIDIProcessor's three subscribers (LR_IPC_OUT, ProfileManager and
+    // MainContentComponent), first through the std::vector<std::function> of std::bind
+    // it used before, then through the callback_list it uses now
+    void SubscriberCases(juce::String& report)
+    {
+        std::array<Subscriber, 3> subscribers;
+        std::vector<std::function<void(RSJ::MidiMessage)>> functions;
+        for (auto& subscriber : subscribers)
+            functions.emplace_back(std::bind(&Subscriber::Received, &subscriber,
+                std::placeholders::_1));
+        Time(report, "dispatch to 3 std::function", [&functions](size_t i) {
+            const RSJ::MidiMessage mm{RSJ::kCCFlag, 0, kControl, Value(i)};
+            for (const auto& function : functions)
+                function(mm);
+        });
+        RSJ::callback_list<3, RSJ::MidiMessage> callbacks;
+        for (auto& subscriber : subscribers)
+            callbacks.add<Subscriber, &Subscriber::Received>(&subscriber);
+        Time(report, "dispatch to 3 callback_list", [&callbacks](size_t i) {
+            callbacks({RSJ::kCCFlag, 0, kControl, Value(i)});
+        });
+        sink = sink + static_cast<double>(subscribers[0].total);
+    }
+
+    void CommandMapCases(juce::String& report)
+    {
+        CommandMap map;
+        for (auto controller = 0; controller < 128; ++controller)
+            map.addCommandforMessage(static_cast<size_t>(controller % 64 + 1),
+                RSJ::MidiMessageId{1, controller, RSJ::MsgIdEnum::CC});
+        Time(report, "CommandMap getCommandIdforMessage", [&map](size_t i) {
+            sink = sink + map.getCommandIdforMessage(
+                RSJ::MidiMessageId{1, static_cast<int>(i & 0xFF), RSJ::MsgIdEnum::CC});
+        });
+        const auto& names = LRCommandList::LRStringList;
+        Time(report, "getIndexOfCommand", [&names](size_t i) {
+            sink = sink + LRCommandList::getIndexOfCommand(names[i % names.size()]);
+        });
+    }
+
+    // the NRPN assembler before it became a single-writer state machine: every value
+    // message takes both spinlocks and the result goes through a std::queue, which
+    // MIDIProcessor then polled under the lock after each message
+    class LockedNrpn {
+    public:
+        bool ProcessMidi(short control, short value)
+        {
+            switch (control) {
+            case 6:
+            case 38:
+            {
+                std::lock(data_guard_, queue_guard_);
+                std::lock_guard<decltype(data_guard_)> dlock(data_guard_, std::adopt_lock);
+                std::lock_guard<decltype(queue_guard_)> qlock(queue_guard_, std::adopt_lock);
+                if (ready_ < 0b11)
+                    return false;
+                if (control == 6) {
+                    value_msb_ = value;
+                    ready_ |= 0b100;
+                }
+                else {
+                    value_lsb_ = value;
+                    ready_ |= 0b1000;
+                }
+                if (ready_ == 0b1111) {
+                    nrpn_queued_.emplace(true, static_cast<short>((control_msb_ << 7) +
+                        control_lsb_), static_cast<short>((value_msb_ << 7) + value_lsb_));
+                    ready_ = 0;
+                }
+                return true;
+            }
+            case 98:
+            case 99:
+            {
+                std::lock_guard<decltype(data_guard_)> lock(data_guard_);
+                (control == 98 ? control_lsb_ : control_msb_) = value;
+                ready_ |= control == 98 ? 0b10 : 0b1;
+                return true;
+            }
+            default:
+                return false;
+            }
+        }
+        RSJ::NRPN GetNRPNifReady()
+        {
+            std::lock_guard<decltype(queue_guard_)> lock(queue_guard_);
+            if (nrpn_queued_.empty())
+                return RSJ::invalidNRPN;
+            const auto nrpn = nrpn_queued_.front();
+            nrpn_queued_.pop();
+            return nrpn;
+        }
+    private:
+        RSJ::RelaxTTasSpinLock data_guard_;
+        RSJ::RelaxTTasSpinLock queue_guard_;
+        short control_lsb_{0};
+        short control_msb_{0};
+        short value_lsb_{0};
+        short value_msb_{0};
+        std::queue<RSJ::NRPN> nrpn_queued_{};
+        unsigned char ready_{0};
+    };
+
+    // NRPN-heavy profiles send 4-message NRPNs, here spread over all 16 channels
+    void NrpnCases(juce::String& report)
+    {
+        NRPN_Filter filter;
+        Time(report, "NRPN_Filter::ProcessMidi 4-message NRPN", [&filter](size_t i) {
+            RSJ::NRPN nrpn;
+            filter.ProcessMidi(0, 99, 1, nrpn);
+            filter.ProcessMidi(0, 98, Value(i), nrpn);
+            filter.ProcessMidi(0, 6, Value(i >> 7), nrpn);
+            filter.ProcessMidi(0, 38, Value(i), nrpn);
+            sink = sink + nrpn.value;
+        });
+        Time(report, "NRPN_Filter::ProcessMidi 4-message NRPN 16 channels", [&filter](size_t i) {
+            const auto channel = static_cast<short>(i & 0xF);
+            RSJ::NRPN nrpn;
+            filter.ProcessMidi(channel, 99, 1, nrpn);
+            filter.ProcessMidi(channel, 98, Value(i), nrpn);
+            filter.ProcessMidi(channel, 6, Value(i >> 7), nrpn);
+            filter.ProcessMidi(channel, 38, Value(i), nrpn);
+            sink = sink + nrpn.value;
+        });
+        std::array<LockedNrpn, 16> locked;
+        Time(report, "locked queue NRPN 4-message NRPN 16 channels", [&locked](size_t i) {
+            auto& message = locked[i & 0xF];
+            const std::array<std::pair<short, short>, 4> parts{{
+                {99, 1}, {98, Value(i)}, {6, Value(i >> 7)}, {38, Value(i)}}};
+            for (const auto& part : parts)
+                if (message.ProcessMidi(part.first, part.second)) {
+                    const auto nrpn = message.GetNRPNifReady();
+                    if (nrpn.isValid)
+                        sink = sink + nrpn.value;
+                }
+        });
+    }
+
+    void OutboundCases(juce::String& report)
+    {
+        std::string out;
+        out.reserve(256);
+        const auto commands = LRCommandList::LRStringList.size();
+        for (const auto compact : {false, true})
+            Time(report, compact ? "outbound line compact" : "outbound line text",
+                [&out, commands, compact](size_t i) {
+                out.clear();
+                LR_IPC_OUT::AppendLine(out, 1 + i % (commands - 1),
+                    static_cast<double>(i & 0xFFFF) / 65535.0, compact);
+                sink = sink + static_cast<double>(out.size());
+            });
+    }
+
+    void InboundCases(juce::String& report)
+    {
+        // a photo-change refresh as the plugin frames it, most values unmapped
+        const auto& names = LRCommandList::LRStringList;
+        std::string refresh{"Snapshot 1\n"};
+        for (size_t i = 1; i <= kBatch; ++i)
+            refresh += names[i * 5 % (names.size() - 1) + 1] + ' ' +
+            std::to_string(static_cast<double>(i) / kBatch) + '\n';
+        refresh += "EndSnapshot 1\n";
+        const auto* const data = reinterpret_cast<const juce::uint8*>(refresh.data());
+        Time(report, "inbound refresh of 64 lines", [data, &refresh](size_t) {
+            ParseInboundOnce(data, refresh.size());
+        });
+    }
+
+    // stands in for LR_IPC_OUT: formats each resolved message on the dispatching thread
+    class ResolvedCounter {
+    public:
+        void Resolved(const RSJ::ResolvedMessage& resolved)
+        {
+            thread_local std::string out;
+            out.clear();
+            LR_IPC_OUT::AppendLine(out, resolved.command_id, resolved.value, false);
+            counts[static_cast<size_t>(resolved.message.device)].fetch_add(1,
+                std::memory_order_release);
+        }
+        std::array<std::atomic<size_t>, kMaxSources> counts{};
+    };
+
+    // several controllers on their factory channel, each sending from its own driver
+    // thread, through the one dispatch thread and then through a shard per controller.
+    // Per message, queueing included, so rows for more sources show how dispatch scales
+    void DispatchCases(juce::String& report)
+    {
+        CommandMap map;
+        for (auto controller = 0; controller < 64; ++controller)
+            map.addCommandforMessage(static_cast<size_t>(controller + 1),
+                RSJ::MidiMessageId{1, controller, RSJ::MsgIdEnum::CC});
+        ControlsModel model;
+        for (const size_t sources : {1, 2, 4, 8})
+            for (const auto sharded : {false, true}) {
+                if (sharded && sources == 1)
+                    continue; //no different from one thread
+                ResolvedCounter counter;
+                MIDIProcessor processor{&map, &model};
+                processor.addResolvedCallback<ResolvedCounter, &ResolvedCounter::Resolved>(
+                    &counter);
+                if (sharded)
+                    processor.SetDispatchShards(static_cast<int>(sources));
+                processor.Init(true, false);
+                const auto per_source = kOperations / sources;
+                const auto start = std::chrono::steady_clock::now();
+                std::vector<std::thread> threads;
+                for (size_t source = 0; source < sources; ++source)
+                    threads.emplace_back([&processor, &counter, source, per_source] {
+                        for (size_t i = 0; i < per_source; ++i) {
+                            while (i - counter.counts[source].load(std::memory_order_acquire) >=
+                                kInFlight)
+                                std::this_thread::yield();
+                            RSJ::MidiMessage message{RSJ::kCCFlag, 0,
+                                static_cast<short>(i & 0x3F), Value(i)};
+                            message.device = static_cast<short>(source);
+                            processor.Inject(message);
+                        }
+                    });
+                for (auto& thread : threads)
+                    thread.join();
+                for (size_t source = 0; source < sources; ++source)
+                    while (counter.counts[source].load(std::memory_order_acquire) < per_source)
+                        std::this_thread::yield();
+                const auto taken = std::chrono::duration<double, std::nano>(
+                    std::chrono::steady_clock::now() - start).count();
+                const auto total = per_source * sources;
+                report << "dispatch " << juce::String(static_cast<int>(sources)) <<
+                    (sharded ? " sources sharded" : " sources one thread") << ", " <<
+                    juce::String(taken / static_cast<double>(total), 2) << ", " <<
+                    juce::String(static_cast<juce::int64>(total)) << "\n";
+            }
+    }
+
+    constexpr size_t kRoundTrips = 1 << 12;
+    constexpr int kLoopbackTimeout = 1000; //ms, after which the port is taken as broken
+    const juce::String kLoopbackName{"MIDI2LR Benchmark"};
+
+    // wakes the sender for each message coming back through a loopback port
+    class LoopbackReceiver final: public juce::MidiInputCallback {
+    public:
+        void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage&) override
+        {
+            arrived.signal();
+        }
+        static void RtMidiCallback(double, std::vector<unsigned char>*, void* receiver)
+        {
+            static_cast<LoopbackReceiver*>(receiver)->arrived.signal();
+        }
+        juce::WaitableEvent arrived;
+    };
+
+    void Skipped(juce::String& report, const juce::String& backend)
+    {
+        report << "MIDI loopback " << backend << ", skipped, 0\n";
+    }
+
+    // sends CCs one at a time out of a virtual port and into an input opened on it,
+    // waiting for each, and adds rows for wall time and process CPU time per message.
+    // The sender blocks rather than spins, so CPU covers the send, the OS delivery and
+    // the backend's input thread (std::clock is wall time on Windows, so there the
+    // two rows match)
+    template<class Send>
+    void RoundTrips(juce::String& report, const juce::String& backend,
+        LoopbackReceiver& receiver, Send&& send)
+    {
+        const auto cpu_start = std::clock();
+        const auto start = std::chrono::steady_clock::now();
+        for (size_t i = 0; i < kRoundTrips; ++i) {
+            send(static_cast<unsigned char>(Value(i)));
+            if (!receiver.arrived.wait(kLoopbackTimeout)) {
+                report << "MIDI loopback " << backend << ", lost, " <<
+                    juce::String(static_cast<juce::int64>(i)) << "\n";
+                return;
+            }
+        }
+        const auto taken = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+        const auto cpu = static_cast<double>(std::clock() - cpu_start) * 1e9 / CLOCKS_PER_SEC;
+        const auto operations = juce::String(static_cast<juce::int64>(kRoundTrips));
+        report << "MIDI loopback " << backend << " latency, " <<
+            juce::String(taken / kRoundTrips, 2) << ", " << operations << "\n";
+        report << "MIDI loopback " << backend << " CPU, " <<
+            juce::String(cpu / kRoundTrips, 2) << ", " << operations << "\n";
+    }
+
+    // the two MIDI backends, each through its own virtual port and back. Windows has
+    // no virtual ports, so there both rows are skipped
+    void BackendCases(juce::String& report)
+    {
+        {
+            LoopbackReceiver receiver;
+            const auto name = kLoopbackName + " JUCE";
+            const std::unique_ptr<juce::MidiOutput> output{
+                juce::MidiOutput::createNewDevice(name)};
+            std::unique_ptr<juce::MidiInput> input;
+            if (output) {
+                const auto devices = juce::MidiInput::getDevices();
+                for (auto index = 0; index < devices.size(); ++index)
+                    if (devices[index].contains(name)) {
+                        input.reset(juce::MidiInput::openDevice(index, &receiver));
+                        break;
+                    }
+            }
+            if (input) {
+                input->start();
+                RoundTrips(report, "JUCE", receiver, [&output](unsigned char value) {
+                    output->sendMessageNow(juce::MidiMessage::controllerEvent(1, kControl,
+                        value));
+                });
+                input->stop();
+            }
+            else
+                Skipped(report, "JUCE");
+        }
+#ifdef MIDI2LR_RTMIDI
+        try {
+            LoopbackReceiver receiver;
+            const auto name = (kLoopbackName + " RtMidi").toStdString();
+            RtMidiOut output{RtMidi::UNSPECIFIED, "MIDI2LR"};
+            output.openVirtualPort(name);
+            RtMidiIn input{RtMidi::UNSPECIFIED, "MIDI2LR"};
+            const auto count = input.getPortCount();
+            auto port = count;
+            for (unsigned int i = 0; i < count; ++i)
+                if (input.getPortName(i).find(name) != std::string::npos) {
+                    port = i;
+                    break;
+                }
+            if (port == count)
+                Skipped(report, "RtMidi");
+            else {
+                input.setCallback(&LoopbackReceiver::RtMidiCallback, &receiver);
+                input.openPort(port);
+                RoundTrips(report, "RtMidi", receiver, [&output](unsigned char value) {
+                    const std::array<unsigned char, 3> cc{{RSJ::kCCFlag << 4, kControl, value}};
+                    output.sendMessage(cc.data(), cc.size());
+                });
+                input.closePort(); //waits for a running callback
+            }
+        }
+        catch (const RtMidiError& e) {
+            DBG("Benchmark: RtMidi loopback failed: " + e.getMessage());
+            Skipped(report, "RtMidi");
+        }
+#else
+        Skipped(report, "RtMidi"); //built without MIDI2LR_RTMIDI
+#endif
+    }
+}
+
+juce::String RunBenchmarks()
+{
+    juce::String report{"benchmark, ns/op, operations\n"};
+    ControlsCases(report);
+    LayoutCases(report);
+    SubscriberCases(report);
+    CommandMapCases(report);
+    NrpnCases(report);
+    OutboundCases(report);
+    InboundCases(report);
+    DispatchCases(report);
+    BackendCases(report);
+    return report;
+}
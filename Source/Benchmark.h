@@ -0,0 +1,33 @@
+#pragma once
+/*
+  ==============================================================================
+
+    Benchmark.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_BENCHMARK_H_INCLUDED
+#define MIDI2LR_BENCHMARK_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Times the hot-path components on their own, without Lightroom, controllers or
+// windows, for --benchmark. MIDI I/O only goes through virtual ports it opens itself.
+// Returns "benchmark, ns/op, operations" CSV rows in a fixed order, so runs can be
+// compared line by line
+juce::String RunBenchmarks();
+
+#endif  // BENCHMARK_H_INCLUDED
@@ -129,7 +129,7 @@ CCoptions::CCoptions()
 
     addAndMakeVisible(applyAll = new TextButton("new button"));
     applyAll->setTooltip(TRANS("Apply these settings to all similar controls."));
-    applyAll->setExplicitFocusOrder(7);
+    applyAll->setExplicitFocusOrder(11);
     applyAll->setButtonText(TRANS("Apply to all"));
     applyAll->addListener(this);
 
@@ -141,16 +141,111 @@ CCoptions::CCoptions()
     controlID->setColour(TextEditor::textColourId, Colours::black);
     controlID->setColour(TextEditor::backgroundColourId, Colour(0x00000000));
 
+    addAndMakeVisible(curvelabel = new Label("curvelabel",
+        TRANS("Response curve")));
+    curvelabel->setFont(Font(15.00f, Font::plain));
+    curvelabel->setJustificationType(Justification::centredLeft);
+    curvelabel->setEditable(false, false, false);
+    curvelabel->setColour(TextEditor::textColourId, Colours::black);
+    curvelabel->setColour(TextEditor::backgroundColourId, Colour(0x00000000));
+
+    addAndMakeVisible(curvebox = new ComboBox("curvebox"));
+    curvebox->setTooltip(TRANS("How controller position maps to the Lightroom value."));
+    curvebox->setExplicitFocusOrder(7);
+    curvebox->setEditableText(false);
+    curvebox->setJustificationType(Justification::centredLeft);
+    curvebox->addItem(TRANS("Linear"), 1);
+    curvebox->addItem(TRANS("Logarithmic"), 2);
+    curvebox->addItem(TRANS("Gamma"), 3);
+    curvebox->addItem(TRANS("S-curve"), 4);
+    curvebox->addItem(TRANS("Custom"), 5);
+    curvebox->addListener(this);
+
+    addAndMakeVisible(curvetext = new TextEditor("curvetext"));
+    curvetext->setTooltip(TRANS("Curve strength, or for custom curves x:y points between 0 and 1, e.g. 0.5:0.2 0.8:0.6"));
+    curvetext->setExplicitFocusOrder(8);
+    curvetext->setMultiLine(false);
+    curvetext->setReturnKeyStartsNewLine(false);
+    curvetext->setReadOnly(false);
+    curvetext->setScrollbarsShown(true);
+    curvetext->setCaretVisible(true);
+    curvetext->setPopupMenuEnabled(true);
+    curvetext->setText(TRANS("1"));
+
+    addChildComponent(accellabel = new Label("accellabel",
+        TRANS("Acceleration")));
+    accellabel->setFont(Font(15.00f, Font::plain));
+    accellabel->setJustificationType(Justification::centredLeft);
+    accellabel->setEditable(false, false, false);
+    accellabel->setColour(TextEditor::textColourId, Colours::black);
+    accellabel->setColour(TextEditor::backgroundColourId, Colour(0x00000000));
+
+    addChildComponent(accelbox = new ComboBox("accelbox"));
+    accelbox->setTooltip(TRANS("Fast turns move further per step, slow turns keep fine control."));
+    accelbox->setExplicitFocusOrder(7);
+    accelbox->setEditableText(false);
+    accelbox->setJustificationType(Justification::centredLeft);
+    accelbox->addItem(TRANS("None"), 1);
+    accelbox->addItem(TRANS("Mild"), 2);
+    accelbox->addItem(TRANS("Strong"), 3);
+    accelbox->addListener(this);
+
+    addAndMakeVisible(deadbandlabel = new Label("deadbandlabel",
+        TRANS("Deadband")));
+    deadbandlabel->setFont(Font(15.00f, Font::plain));
+    deadbandlabel->setJustificationType(Justification::centredLeft);
+    deadbandlabel->setEditable(false, false, false);
+    deadbandlabel->setColour(TextEditor::textColourId, Colours::black);
+    deadbandlabel->setColour(TextEditor::backgroundColourId, Colour(0x00000000));
+
+    addAndMakeVisible(deadbandtext = new TextEditor("deadbandtext"));
+    deadbandtext->setTooltip(TRANS("Ignore changes this small or smaller, for controls that jitter. 0 turns it off."));
+    deadbandtext->setExplicitFocusOrder(9);
+    deadbandtext->setMultiLine(false);
+    deadbandtext->setReturnKeyStartsNewLine(false);
+    deadbandtext->setReadOnly(false);
+    deadbandtext->setScrollbarsShown(true);
+    deadbandtext->setCaretVisible(true);
+    deadbandtext->setPopupMenuEnabled(true);
+    deadbandtext->setText(TRANS("0"));
+
+    addAndMakeVisible(touchlabel = new Label("touchlabel",
+        TRANS("Touch note")));
+    touchlabel->setFont(Font(15.00f, Font::plain));
+    touchlabel->setJustificationType(Justification::centredLeft);
+    touchlabel->setEditable(false, false, false);
+    touchlabel->setColour(TextEditor::textColourId, Colours::black);
+    touchlabel->setColour(TextEditor::backgroundColourId, Colour(0x00000000));
+
+    addAndMakeVisible(touchtext = new TextEditor("touchtext"));
+    touchtext->setTooltip(TRANS("Note the controller sends while this motor fader is touched, so feedback waits for its release. Empty for none."));
+    touchtext->setExplicitFocusOrder(10);
+    touchtext->setMultiLine(false);
+    touchtext->setReturnKeyStartsNewLine(false);
+    touchtext->setReadOnly(false);
+    touchtext->setScrollbarsShown(true);
+    touchtext->setCaretVisible(true);
+    touchtext->setPopupMenuEnabled(true);
+    touchtext->setText(String());
+
     //[UserPreSize]
         //[/UserPreSize]
 
-    setSize(280, 350);
+    setSize(280, 500);
 
     //[Constructor] You can add your own custom stuff here..
     maxvaltext->setInputFilter(&numrestrict, false);
     minvaltext->setInputFilter(&numrestrict, false);
     maxvaltext->addListener(this);
     minvaltext->addListener(this);
+    curvetext->setInputFilter(&curverestrict, false);
+    curvetext->addListener(this);
+    deadbandtext->setInputFilter(&deadbandrestrict, false);
+    deadbandtext->addListener(this);
+    touchtext->setInputFilter(&touchrestrict, false);
+    touchtext->addListener(this);
+    curvebox->setSelectedId(1, dontSendNotification);
+    accelbox->setSelectedId(1, dontSendNotification);
     //[/Constructor]
 }
 
@@ -170,6 +265,15 @@ CCoptions::~CCoptions()
     maxvallabel = nullptr;
     applyAll = nullptr;
     controlID = nullptr;
+    curvelabel = nullptr;
+    curvebox = nullptr;
+    curvetext = nullptr;
+    accellabel = nullptr;
+    accelbox = nullptr;
+    deadbandlabel = nullptr;
+    deadbandtext = nullptr;
+    touchlabel = nullptr;
+    touchtext = nullptr;
 
     //[Destructor]. You can add your own custom destruction code here..
     //[/Destructor]
@@ -201,8 +305,17 @@ void CCoptions::resized()
     minvaltext->setBounds(200, 228, 56, 24);
     minvallabel->setBounds(16, 228, 150, 24);
     maxvallabel->setBounds(16, 268, 150, 24);
-    applyAll->setBounds((getWidth()/2)-(150/2), (getHeight()/2)+141, 150, 24);
+    applyAll->setBounds((getWidth()/2)-(150/2), (getHeight()/2)+216, 150, 24);
     controlID->setBounds((getWidth()/2)-(248/2), 16, 248, 24);
+    curvelabel->setBounds(16, 308, 110, 24);
+    curvebox->setBounds(136, 308, 120, 24);
+    curvetext->setBounds(16, 348, 240, 24);
+    accellabel->setBounds(16, 308, 110, 24);
+    accelbox->setBounds(136, 308, 120, 24);
+    deadbandlabel->setBounds(16, 388, 150, 24);
+    deadbandtext->setBounds(200, 388, 56, 24);
+    touchlabel->setBounds(16, 428, 150, 24);
+    touchtext->setBounds(200, 428, 56, 24);
     //[UserResized] Add your own custom resize handling here..
     //[/UserResized]
 }
@@ -218,6 +331,7 @@ void CCoptions::buttonClicked(Button* buttonThatWasClicked)
         minvallabel->setVisible(false);
         maxvallabel->setText(TRANS("Resolution"), juce::dontSendNotification);
         minvaltext->setText("0", juce::dontSendNotification);
+        showCurveControls(false);
         controls_model_->setCCmethod(boundchannel, boundnumber, RSJ::CCmethod::twoscomplement);
         //[/UserButtonCode_twosbutton]
     }
@@ -226,6 +340,7 @@ void CCoptions::buttonClicked(Button* buttonThatWasClicked)
         minvaltext->setVisible(true);
         minvallabel->setVisible(true);
         maxvallabel->setText(TRANS("Maximum value"), juce::dontSendNotification);
+        showCurveControls(true);
         controls_model_->setCCmethod(boundchannel, boundnumber, RSJ::CCmethod::absolute);
         //[/UserButtonCode_absbutton]
     }
@@ -235,6 +350,7 @@ void CCoptions::buttonClicked(Button* buttonThatWasClicked)
         minvallabel->setVisible(false);
         maxvallabel->setText(TRANS("Resolution"), juce::dontSendNotification);
         minvaltext->setText("0", juce::dontSendNotification);
+        showCurveControls(false);
         controls_model_->setCCmethod(boundchannel, boundnumber, RSJ::CCmethod::binaryoffset);
 
         //[/UserButtonCode_binbutton]
@@ -245,6 +361,7 @@ void CCoptions::buttonClicked(Button* buttonThatWasClicked)
         minvallabel->setVisible(false);
         maxvallabel->setText(TRANS("Resolution"), juce::dontSendNotification);
         minvaltext->setText("0", juce::dontSendNotification);
+        showCurveControls(false);
         controls_model_->setCCmethod(boundchannel, boundnumber, RSJ::CCmethod::signmagnitude);
         //[/UserButtonCode_signbutton]
     }
@@ -273,15 +390,78 @@ void CCoptions::buttonClicked(Button* buttonThatWasClicked)
     //[/UserbuttonClicked_Post]
 }
 
+void CCoptions::comboBoxChanged(ComboBox* comboBoxThatHasChanged)
+{
+    //[UsercomboBoxChanged_Pre]
+    //[/UsercomboBoxChanged_Pre]
+
+    if (comboBoxThatHasChanged==curvebox) {
+        //[UserComboBoxCode_curvebox] -- add your combo box handling code here..
+        applyCurve();
+        //[/UserComboBoxCode_curvebox]
+    }
+    else if (comboBoxThatHasChanged==accelbox) {
+        //[UserComboBoxCode_accelbox] -- add your combo box handling code here..
+        controls_model_->setCCacceleration(boundchannel, boundnumber,
+            static_cast<RSJ::Acceleration>(accelbox->getSelectedId() - 1));
+        //[/UserComboBoxCode_accelbox]
+    }
+
+    //[UsercomboBoxChanged_Post]
+    //[/UsercomboBoxChanged_Post]
+}
+
 //[MiscUserCode] You can add your own definitions of your custom methods or any other code here...
 void CCoptions::textEditorFocusLost(TextEditor& t)
 {
-    const auto val = gsl::narrow_cast<short>(t.getText().getIntValue());
     const auto nam = t.getName();
+    if (nam=="curvetext") {
+        applyCurve();
+        return;
+    }
+    const auto val = gsl::narrow_cast<short>(t.getText().getIntValue());
     if (nam=="minvaltext")
         controls_model_->setCCmin(boundchannel, boundnumber, val);
     else if (nam=="maxvaltext")
         controls_model_->setCCmax(boundchannel, boundnumber, val);
+    else if (nam=="deadbandtext")
+        controls_model_->setCCdeadband(boundchannel, boundnumber, val);
+    else if (nam=="touchtext")
+        controls_model_->setCCtouch(boundchannel, boundnumber, t.isEmpty() ? short{-1} : val);
+}
+
+void CCoptions::applyCurve()
+{
+    const auto selected = curvebox->getSelectedId();
+    if (selected <= 0)
+        return; //nothing chosen yet
+    RSJ::ResponseCurve curve;
+    curve.type = static_cast<RSJ::CurveType>(selected - 1);
+    if (curve.type == RSJ::CurveType::custom) {
+        juce::StringArray pairs;
+        pairs.addTokens(curvetext->getText(), " ,", "");
+        pairs.removeEmptyStrings();
+        for (const auto& pair : pairs) {
+            curve.points.push_back(pair.upToFirstOccurrenceOf(":", false, false).getFloatValue());
+            curve.points.push_back(pair.fromFirstOccurrenceOf(":", false, false).getFloatValue());
+        }
+    }
+    else
+        curve.amount = curvetext->getText().getFloatValue();
+    controls_model_->setCurve(boundchannel, boundnumber, curve);
+}
+
+void CCoptions::showCurveControls(bool absolute)
+{
+    curvelabel->setVisible(absolute);
+    curvebox->setVisible(absolute);
+    curvetext->setVisible(absolute);
+    deadbandlabel->setVisible(absolute);
+    deadbandtext->setVisible(absolute);
+    touchlabel->setVisible(absolute && boundnumber <= 0x7F); //CC 0-127 get feedback
+    touchtext->setVisible(absolute && boundnumber <= 0x7F);
+    accellabel->setVisible(!absolute);
+    accelbox->setVisible(!absolute);
 }
 
 void CCoptions::bindToControl(size_t channel, short number)
@@ -292,6 +472,21 @@ void CCoptions::bindToControl(size_t channel, short number)
         juce::dontSendNotification);
     minvaltext->setText(juce::String(controls_model_->getCCmin(boundchannel, boundnumber)), juce::dontSendNotification);
     maxvaltext->setText(juce::String(controls_model_->getCCmax(boundchannel, boundnumber)), juce::dontSendNotification);
+    deadbandtext->setText(juce::String(controls_model_->getCCdeadband(boundchannel, boundnumber)), juce::dontSendNotification);
+    const auto touch = controls_model_->getCCtouch(boundchannel, boundnumber);
+    touchtext->setText(touch < 0 ? juce::String{} : juce::String(touch), juce::dontSendNotification);
+    accelbox->setSelectedId(static_cast<int>(controls_model_->getCCacceleration(boundchannel, boundnumber)) + 1,
+        juce::dontSendNotification);
+    const auto curve = controls_model_->getCurve(boundchannel, boundnumber);
+    curvebox->setSelectedId(static_cast<int>(curve.type) + 1, juce::dontSendNotification);
+    if (curve.type == RSJ::CurveType::custom) {
+        juce::String points;
+        for (size_t i = 0; i + 1 < curve.points.size(); i += 2)
+            points << curve.points[i] << ":" << curve.points[i + 1] << " ";
+        curvetext->setText(points.trimEnd(), juce::dontSendNotification);
+    }
+    else
+        curvetext->setText(juce::String(curve.amount), juce::dontSendNotification);
     switch (controls_model_->getCCmethod(boundchannel, boundnumber)) {
     case RSJ::CCmethod::absolute:
         absbutton->setToggleState(true, juce::sendNotification);
@@ -322,7 +517,7 @@ BEGIN_JUCER_METADATA
                  parentClasses="public Component, private TextEditor::Listener"
                  constructorParams="" variableInitialisers="" snapPixels="8" snapActive="1"
                  snapShown="1" overlayOpacity="0.330" fixedSize="1" initialWidth="280"
-                 initialHeight="350">
+                 initialHeight="500">
   <BACKGROUND backgroundColour="ffffffff"/>
   <GROUPCOMPONENT name="CCmethod" id="3dee10ca9db3e476" memberName="groupComponent"
                   virtualName="" explicitFocusOrder="0" pos="16 60 240 157" title="CC Message Type"/>
@@ -361,7 +556,7 @@ BEGIN_JUCER_METADATA
          editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
          fontsize="15" bold="0" italic="0" justification="33"/>
   <TEXTBUTTON name="new button" id="836af06f251dc94d" memberName="applyAll"
-              virtualName="" explicitFocusOrder="7" pos="0Cc 141C 150 24" tooltip="Apply these settings to all similar controls."
+              virtualName="" explicitFocusOrder="11" pos="0Cc 216C 150 24" tooltip="Apply these settings to all similar controls."
               buttonText="Apply to all" connectedEdges="0" needsCallback="1"
               radioGroupId="0"/>
   <LABEL name="channel 0 number 0" id="aa2312920c3b6ed" memberName="controlID"
@@ -369,6 +564,46 @@ BEGIN_JUCER_METADATA
          edBkgCol="0" labelText="Channel 0 Number 0" editableSingleClick="0"
          editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
          fontsize="15" bold="0" italic="0" justification="36"/>
+  <LABEL name="curvelabel" id="5b1f0e7a2c9d4e31" memberName="curvelabel"
+         virtualName="" explicitFocusOrder="0" pos="16 308 110 24" edTextCol="ff000000"
+         edBkgCol="0" labelText="Response curve" editableSingleClick="0"
+         editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
+         fontsize="15" bold="0" italic="0" justification="33"/>
+  <COMBOBOX name="curvebox" id="c7a94b1d03e2f58a" memberName="curvebox"
+            virtualName="" explicitFocusOrder="7" pos="136 308 120 24" tooltip="How controller position maps to the Lightroom value."
+            editable="0" layout="33" items="Linear&#10;Logarithmic&#10;Gamma&#10;S-curve&#10;Custom"
+            textWhenNonSelected="" textWhenNoItems="(no choices)"/>
+  <TEXTEDITOR name="curvetext" id="2e8d6f4a9b1c7035" memberName="curvetext"
+              virtualName="" explicitFocusOrder="8" pos="16 348 240 24" tooltip="Curve strength, or for custom curves x:y points between 0 and 1, e.g. 0.5:0.2 0.8:0.6"
+              initialText="1" multiline="0" retKeyStartsLine="0" readonly="0"
+              scrollbars="1" caret="1" popupmenu="1"/>
+  <LABEL name="accellabel" id="d05b7e2f9a4c8136" memberName="accellabel"
+         virtualName="" explicitFocusOrder="0" pos="16 308 110 24" edTextCol="ff000000"
+         edBkgCol="0" labelText="Acceleration" editableSingleClick="0"
+         editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
+         fontsize="15" bold="0" italic="0" justification="33"/>
+  <COMBOBOX name="accelbox" id="6a1e4c93b7f20d58" memberName="accelbox"
+            virtualName="" explicitFocusOrder="7" pos="136 308 120 24" tooltip="Fast turns move further per step, slow turns keep fine control."
+            editable="0" layout="33" items="None&#10;Mild&#10;Strong" textWhenNonSelected=""
+            textWhenNoItems="(no choices)"/>
+  <LABEL name="deadbandlabel" id="8f3c2a61d4e7b905" memberName="deadbandlabel"
+         virtualName="" explicitFocusOrder="0" pos="16 388 150 24" edTextCol="ff000000"
+         edBkgCol="0" labelText="Deadband" editableSingleClick="0"
+         editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
+         fontsize="15" bold="0" italic="0" justification="33"/>
+  <TEXTEDITOR name="deadbandtext" id="4b7e09d1c3a6f528" memberName="deadbandtext"
+              virtualName="" explicitFocusOrder="9" pos="200 388 56 24" tooltip="Ignore changes this small or smaller, for controls that jitter. 0 turns it off."
+              initialText="0" multiline="0" retKeyStartsLine="0" readonly="0"
+              scrollbars="1" caret="1" popupmenu="1"/>
+  <LABEL name="touchlabel" id="c7a41e8d2f609b35" memberName="touchlabel"
+         virtualName="" explicitFocusOrder="0" pos="16 428 150 24" edTextCol="ff000000"
+         edBkgCol="0" labelText="Touch note" editableSingleClick="0"
+         editableDoubleClick="0" focusDiscardsChanges="0" fontname="Default font"
+         fontsize="15" bold="0" italic="0" justification="33"/>
+  <TEXTEDITOR name="touchtext" id="5e92b0c4a71d3f86" memberName="touchtext"
+              virtualName="" explicitFocusOrder="10" pos="200 428 56 24" tooltip="Note the controller sends while this motor fader is touched, so feedback waits for its release. Empty for none."
+              initialText="" multiline="0" retKeyStartsLine="0" readonly="0"
+              scrollbars="1" caret="1" popupmenu="1"/>
 </JUCER_COMPONENT>
 
 END_JUCER_METADATA
@@ -56,7 +56,8 @@ class ControlsModel;
 */
 class CCoptions: public Component,
     private TextEditor::Listener,
-    public ButtonListener {
+    public ButtonListener,
+    public ComboBoxListener {
 public:
     //==============================================================================
     CCoptions();
@@ -74,11 +75,17 @@ class CCoptions: public Component,
     void paint(Graphics& g) override;
     void resized() override;
     void buttonClicked(Button* buttonThatWasClicked) override;
+    void comboBoxChanged(ComboBox* comboBoxThatHasChanged) override;
 
 private:
     //[UserVariables]   -- You can add your own custom variables in this section.
     TextEditor::LengthAndCharacterRestriction numrestrict{5, "0123456789"};
+    TextEditor::LengthAndCharacterRestriction curverestrict{200, "0123456789.:, "};
+    TextEditor::LengthAndCharacterRestriction deadbandrestrict{2, "0123456789"};
+    TextEditor::LengthAndCharacterRestriction touchrestrict{3, "0123456789"};
     void textEditorFocusLost(TextEditor & t) override;
+    void applyCurve();
+    void showCurveControls(bool absolute);
     static ControlsModel* controls_model_;
     short boundchannel; //note: 0-based
     short boundnumber;
@@ -96,6 +103,15 @@ class CCoptions: public Component,
     ScopedPointer<Label> maxvallabel;
     ScopedPointer<TextButton> applyAll;
     ScopedPointer<Label> controlID;
+    ScopedPointer<Label> curvelabel;
+    ScopedPointer<ComboBox> curvebox;
+    ScopedPointer<TextEditor> curvetext;
+    ScopedPointer<Label> accellabel;
+    ScopedPointer<ComboBox> accelbox;
+    ScopedPointer<Label> deadbandlabel;
+    ScopedPointer<TextEditor> deadbandtext;
+    ScopedPointer<Label> touchlabel;
+    ScopedPointer<TextEditor> touchtext;
 
     //==============================================================================
     JUCE_DECLARE_NON_COPYABLE_WITH_LEAK_DETECTOR(CCoptions)
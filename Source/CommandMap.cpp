@@ -21,56 +21,587 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 
+#include <algorithm>
 #include <cassert>
+#include <gsl/gsl>
 #include "CommandMap.h"
 #include "LRCommands.h"
 
-CommandMap::CommandMap() noexcept
+namespace {
+    constexpr size_t kWriteBuffer = 0x10000; //bytes buffered before each profile write
+
+    // streams name="value", escaped as juce::XmlElement would
+    void Attribute(juce::OutputStream& out, const char* name, const juce::String& value)
+    {
+        out << " " << name << "=\"";
+        if (value.containsAnyOf("&<>\"'\n\r\t"))
+            out << value.replace("&", "&amp;").replace("<", "&lt;").replace(">", "&gt;").
+            replace("\"", "&quot;").replace("'", "&apos;").replace("\n", "&#10;").
+            replace("\r", "&#13;").replace("\t", "&#9;");
+        else
+            out << value;
+        out << "\"";
+    }
+    void Attribute(juce::OutputStream& out, const char* name, int value)
+    {
+        out << " " << name << "=\"" << value << "\"";
+    }
+    void Attribute(juce::OutputStream& out, const char* name, double value)
+    {
+        out << " " << name << "=\"" << juce::String{value, 20} << "\""; //as XmlElement formats it
+    }
+    void Attribute(juce::OutputStream& out, const char* name, const std::string& value)
+    {
+        Attribute(out, name, juce::String{value});
+    }
+}
+
+CommandMap::CommandMap():
+    snapshot_{std::make_shared<const Snapshot>()}
 {}
 
 void CommandMap::addCommandforMessage(size_t command, const RSJ::MidiMessageId& message)
 {
     // adds a message to the message:command map, and its associated command to the
     // command:message map
-    if (command < LRCommandList::LRStringList.size()) {
-        message_map_[message] = LRCommandList::LRStringList[command];
-        command_string_map_.insert({LRCommandList::LRStringList[command], message});
+    auto next = Copy_();
+    const auto id = gsl::narrow_cast<CommandId>(command);
+    Map_(*next, id, message);
+    SetId_(*next, message, id);
+    Publish_(std::move(next));
+}
+
+void CommandMap::addCommandforMessage(const std::string& command, const RSJ::MidiMessageId& message)
+{
+    const auto id = LRCommandList::getIndexOfCommand(command);
+    addCommandforMessage(id == LRCommandList::kNotFound ? 0 : id, message); //unknown commands are Unmapped
+}
+
+void CommandMap::setMappings(const std::vector<std::pair<RSJ::MidiMessageId, CommandId>>& mappings,
+    const std::unordered_map<RSJ::MidiMessageId, std::vector<RSJ::MacroTarget>>& macros)
+{
+    // build the new map off to the side, readers switch to it in one store
+    Publish_(Build_(mappings, macros));
+}
+
+std::unique_ptr<CommandMap::Prepared> CommandMap::Prepare(const RSJ::CompiledProfile& profile)
+{
+    auto prepared = std::make_unique<Prepared>();
+    prepared->snapshot_ = Build_(profile.mappings, profile.macros);
+    return prepared;
+}
+
+void CommandMap::setPrepared(std::unique_ptr<Prepared> prepared)
+{
+    Expects(prepared && prepared->snapshot_);
+    Publish_(std::move(prepared->snapshot_));
+}
+
+size_t CommandMap::MemoryUse(const Prepared& prepared)
+{
+    return prepared.snapshot_ ? SnapshotBytes_(*prepared.snapshot_) : 0;
+}
+
+size_t CommandMap::SnapshotBytes_(const Snapshot& snapshot)
+{
+    auto bytes = sizeof(Snapshot) + RSJ::HeapBytes(snapshot.message_map) +
+        RSJ::HeapBytes(snapshot.command_messages) + RSJ::HeapBytes(snapshot.macros) +
+        RSJ::HeapBytes(snapshot.macro_index) + RSJ::HeapBytes(snapshot.macro_targets);
+    for (const auto& messages : snapshot.command_messages)
+        bytes += messages.HeapBytes();
+    for (const auto& macro : snapshot.macros)
+        bytes += RSJ::HeapBytes(macro.second);
+    for (const auto& page : snapshot.pages)
+        if (page)
+            bytes += sizeof(Page);
+    return bytes;
+}
+
+size_t CommandMap::MemoryUse_() const
+{
+    return SnapshotBytes_(*Current_());
+}
+
+std::unique_ptr<CommandMap::Snapshot> CommandMap::Build_(
+    const std::vector<std::pair<RSJ::MidiMessageId, CommandId>>& mappings,
+    const std::unordered_map<RSJ::MidiMessageId, std::vector<RSJ::MacroTarget>>& macros)
+{
+    auto next = std::make_unique<Snapshot>();
+    next->message_map.reserve(mappings.size());
+    next->command_messages.resize(LRCommandList::LRStringList.size());
+    std::array<std::shared_ptr<Page>, kPages> pages{};
+    for (const auto& mapping : mappings) {
+        Map_(*next, mapping.second, mapping.first);
+        auto& page = pages[PageIndex_(mapping.first)];
+        if (!page) {
+            page = std::make_shared<Page>();
+            page->fill(kNoCommand);
+        }
+        (*page)[static_cast<size_t>(mapping.first.data) & (kPageSize - 1)] = mapping.second;
+    }
+    std::copy(pages.begin(), pages.end(), next->pages.begin());
+    for (const auto& macro : macros) {
+        if (!next->message_map.count(macro.first))
+            continue;
+        auto targets = macro.second;
+        DropInvalidTargets_(targets);
+        if (!targets.empty())
+            next->macros.emplace(macro.first, std::move(targets));
+    }
+    CompileMacros_(*next);
+    return next;
+}
+
+RSJ::CompiledProfile CommandMap::CompileProfile(const juce::XmlElement& root)
+{
+    RSJ::CompiledProfile profile;
+    profile.mappings.reserve(static_cast<size_t>(root.getNumChildElements()));
+    for (const auto* setting = root.getFirstChildElement(); setting;
+        setting = setting->getNextElement()) {
+        if (setting->hasTagName("controls")) {
+            profile.has_controls = true;
+            forEachXmlChildElementWithTagName(*setting, control, "control") {
+                const auto channel = control->getIntAttribute("channel") - 1;
+                const auto number = control->getIntAttribute("number", -1);
+                const auto method = control->getIntAttribute("method");
+                if (channel < 0 || channel > 15 || number < 0 || number > 0x3FFF ||
+                    method < 0 || method > static_cast<int>(RSJ::CCmethod::signmagnitude))
+                    continue;
+                RSJ::ResponseCurve curve;
+                curve.type = static_cast<RSJ::CurveType>(juce::jlimit(0,
+                    static_cast<int>(RSJ::CurveType::custom), control->getIntAttribute("curve")));
+                curve.amount = static_cast<float>(control->getDoubleAttribute("amount", 1.0));
+                for (const auto& point : juce::StringArray::fromTokens(
+                    control->getStringAttribute("points"), ",", ""))
+                    curve.points.push_back(point.getFloatValue());
+                profile.controls.emplace_back(static_cast<size_t>(channel), RSJ::SettingsStruct{
+                    static_cast<short>(number), static_cast<short>(control->getIntAttribute("low")),
+                    static_cast<short>(control->getIntAttribute("high", 0x7F)),
+                    static_cast<RSJ::CCmethod>(method), std::move(curve),
+                    static_cast<short>(juce::jlimit(0, 0x3F, control->getIntAttribute("deadband"))),
+                    static_cast<RSJ::Acceleration>(juce::jlimit(0,
+                    static_cast<int>(RSJ::Acceleration::strong), control->getIntAttribute("acceleration"))),
+                    static_cast<short>(juce::jlimit(-1, 0x7F, control->getIntAttribute("touch", -1)))});
+            }
+            continue;
+        }
+        RSJ::MidiMessageId message;
+        if (setting->hasAttribute("controller"))
+            message = {setting->getIntAttribute("channel"),
+                setting->getIntAttribute("controller"), RSJ::MsgIdEnum::CC};
+        else if (setting->hasAttribute("note"))
+            message = {setting->getIntAttribute("channel"),
+                setting->getIntAttribute("note"), RSJ::MsgIdEnum::NOTE};
+        else if (setting->hasAttribute("pitchbend"))
+            message = {setting->getIntAttribute("channel"), 0, RSJ::MsgIdEnum::PITCHBEND};
+        else
+            continue;
+        // a mapping for one of several identical devices names it by identifier
+        if (setting->hasAttribute("device")) {
+            message.source = RSJ::DeviceIndex(setting->getStringAttribute("device"));
+            if (!message.source)
+                continue; //more told-apart devices than indexes
+        }
+        if (setting->hasAttribute("layer")) {
+            message.layer = setting->getIntAttribute("layer");
+            if (message.layer < 0 || message.layer >= RSJ::kLayers)
+                continue;
+        }
+        const auto command = LRCommandList::getIndexOfCommand(setting->
+            getStringAttribute("command_string").toStdString());
+        profile.mappings.emplace_back(message, command == LRCommandList::kNotFound ? 0 :
+            gsl::narrow_cast<CommandId>(command));
+        // extra commands driven by the same message
+        std::vector<RSJ::MacroTarget> targets;
+        forEachXmlChildElementWithTagName(*setting, target, "target") {
+            const auto target_command = LRCommandList::getIndexOfCommand(target->
+                getStringAttribute("command_string").toStdString());
+            if (IsMacroTarget_(target_command))
+                targets.push_back({gsl::narrow_cast<CommandId>(target_command),
+                    static_cast<float>(target->getDoubleAttribute("scale", 1.0)),
+                    static_cast<float>(target->getDoubleAttribute("offset", 0.0))});
+        }
+        if (!targets.empty())
+            profile.macros[message] = std::move(targets);
+    }
+    IndexProfile(profile);
+    return profile;
+}
+
+void CommandMap::IndexProfile(RSJ::CompiledProfile& profile)
+{
+    profile.messages.clear();
+    profile.messages.reserve(profile.mappings.size());
+    for (const auto& mapping : profile.mappings)
+        profile.messages.push_back(mapping.first);
+    std::sort(profile.messages.begin(), profile.messages.end());
+    profile.messages.erase(std::unique(profile.messages.begin(), profile.messages.end()),
+        profile.messages.end());
+}
+
+void CommandMap::setMacroTargets(const RSJ::MidiMessageId& message, std::vector<RSJ::MacroTarget> targets)
+{
+    DropInvalidTargets_(targets);
+    if (targets.empty() && !Current_()->macros.count(message))
+        return;
+    auto next = Copy_();
+    if (targets.empty())
+        next->macros.erase(message);
+    else
+        next->macros[message] = std::move(targets);
+    CompileMacros_(*next);
+    Publish_(std::move(next));
+}
+
+void CommandMap::removeMessage(const RSJ::MidiMessageId& message)
+{
+    // removes message from the message:command map, and its associated command from
+    // the command:message map
+    auto next = Copy_();
+    const auto found = next->message_map.find(message);
+    if (found != next->message_map.end()) {
+        if (found->second < next->command_messages.size())
+            next->command_messages[found->second].Remove(message);
+        next->message_map.erase(found);
+    }
+    SetId_(*next, message, kNoCommand);
+    if (next->macros.erase(message))
+        CompileMacros_(*next);
+    Publish_(std::move(next));
+}
+
+void CommandMap::clearMap()
+{
+    Publish_(std::make_unique<Snapshot>());
+}
+
+std::unique_ptr<CommandMap::Snapshot> CommandMap::Copy_() const
+{
+    return std::make_unique<Snapshot>(*Current_());
+}
+
+void CommandMap::Publish_(std::unique_ptr<Snapshot> next)
+{
+    //other threads may still be reading the old snapshot, so it is retired
+    snapshot_.Publish(std::shared_ptr<const Snapshot>(std::move(next)));
+    changes_.fetch_add(1, std::memory_order_release);
+}
+
+void CommandMap::Map_(Snapshot& snapshot, CommandId id, const RSJ::MidiMessageId& message)
+{
+    auto& mapped = snapshot.message_map[message];
+    if (mapped < snapshot.command_messages.size()) //drop any earlier mapping of this message
+        snapshot.command_messages[mapped].Remove(message);
+    mapped = id;
+    snapshot.layers = std::max(snapshot.layers, message.layer + 1);
+    if (id < LRCommandList::LRStringList.size()) {
+        if (snapshot.command_messages.size() <= id)
+            snapshot.command_messages.resize(static_cast<size_t>(id) + 1);
+        snapshot.command_messages[id].Add(message);
+    }
+}
+
+void CommandMap::SetId_(Snapshot& snapshot, const RSJ::MidiMessageId& message, CommandId id)
+{
+    // copy on write: the page may be shared with snapshots other threads are reading
+    auto& slot = snapshot.pages[PageIndex_(message)];
+    std::shared_ptr<Page> page;
+    if (slot)
+        page = std::make_shared<Page>(*slot);
+    else {
+        if (id == kNoCommand)
+            return;
+        page = std::make_shared<Page>();
+        page->fill(kNoCommand);
+    }
+    (*page)[static_cast<size_t>(message.data) & (kPageSize - 1)] = id;
+    slot = std::move(page);
+}
+
+bool CommandMap::IsMacroTarget_(size_t id) noexcept
+{
+    return id != 0 && id < LRCommandList::LRStringList.size(); //kNotFound too
+}
+
+void CommandMap::DropInvalidTargets_(std::vector<RSJ::MacroTarget>& targets)
+{
+    targets.erase(std::remove_if(targets.begin(), targets.end(),
+        [](const RSJ::MacroTarget& target) noexcept {return !IsMacroTarget_(target.command_id); }),
+        targets.end());
+}
+
+void CommandMap::CompileMacros_(Snapshot& snapshot)
+{
+    // compile every list into one flat array so a message's targets are contiguous
+    snapshot.macro_index.clear();
+    snapshot.macro_targets.clear();
+    for (const auto& macro : snapshot.macros) {
+        snapshot.macro_index.push_back({macro.first,
+            {snapshot.macro_targets.size(), macro.second.size()}});
+        snapshot.macro_targets.insert(snapshot.macro_targets.end(),
+            macro.second.begin(), macro.second.end());
     }
+    std::sort(snapshot.macro_index.begin(), snapshot.macro_index.end(),
+        [](const MacroIndex& a, const MacroIndex& b) noexcept {return a.first < b.first; });
+}
+
+const std::string& CommandMap::getCommandString(CommandId id) noexcept(ndebug)
+{
+    const auto list_size = LRCommandList::LRStringList.size();
+    Expects(id < list_size + LRCommandList::NextPrevProfile.size());
+    if (id < list_size)
+        return LRCommandList::LRStringList[id];
+    return LRCommandList::NextPrevProfile[id - list_size];
+}
+
+unsigned char CommandMap::getCommandFlags(CommandId id) noexcept(ndebug)
+{
+    static const auto flags = [] {
+        const auto list_size = LRCommandList::LRStringList.size();
+        std::vector<unsigned char> f(list_size + LRCommandList::NextPrevProfile.size(), 0);
+        f[0] = RSJ::kCommandUnmapped;
+        for (size_t i = 1; i < list_size; ++i)
+            if (LRCommandList::isAction(i))
+                f[i] = RSJ::kCommandAction;
+        for (auto i = list_size; i < f.size(); ++i) {
+            const auto& command = LRCommandList::NextPrevProfile[i - list_size];
+            f[i] = RSJ::kCommandProfile | RSJ::kCommandAction;
+            if (command == "Previous Profile")
+                f[i] |= RSJ::kCommandPreviousProfile;
+            else if (command == "Next Profile")
+                f[i] |= RSJ::kCommandNextProfile;
+            else if (command == "Previous Layer")
+                f[i] |= RSJ::kCommandPreviousLayer;
+            else if (command == "Next Layer")
+                f[i] |= RSJ::kCommandNextLayer;
+            else if (getCommandLayer(gsl::narrow_cast<CommandId>(i)) >= 0 ||
+                getCommandModifier(gsl::narrow_cast<CommandId>(i)))
+                f[i] |= RSJ::kCommandLayer;
+        }
+        return f;
+    }();
+    Expects(id < flags.size());
+    return flags[id];
+}
+
+int CommandMap::getCommandLayer(CommandId id) noexcept
+{
+    static const auto base = LRCommandList::getIndexOfCommand("Base Layer");
+    if (base == LRCommandList::kNotFound || id < base || id >= base + RSJ::kLayers)
+        return -1;
+    return static_cast<int>(id - base);
+}
+
+int CommandMap::getCommandModifier(CommandId id) noexcept
+{
+    // held together, the modifiers' bits add up to the higher layers
+    static const auto first = LRCommandList::getIndexOfCommand("Modifier 1");
+    if (first == LRCommandList::kNotFound || id < first || id >= first + 2)
+        return 0;
+    return 1 << static_cast<int>(id - first);
+}
+
+int CommandMap::getCommandCapture(CommandId id) noexcept
+{
+    static const auto first = LRCommandList::getIndexOfCommand("Capture Snapshot A");
+    if (first == LRCommandList::kNotFound || id < first || id >= first + RSJ::kSnapshots)
+        return -1;
+    return static_cast<int>(id - first);
+}
+
+int CommandMap::getCommandRecall(CommandId id) noexcept
+{
+    static const auto first = LRCommandList::getIndexOfCommand("Recall Snapshot A");
+    if (first == LRCommandList::kNotFound || id < first || id >= first + RSJ::kSnapshots)
+        return -1;
+    return static_cast<int>(id - first);
+}
+
+int CommandMap::getCommandResetGroup(CommandId id) noexcept
+{
+    static const auto first = LRCommandList::getIndexOfCommand("Reset Group Basic");
+    if (first == LRCommandList::kNotFound || id < first || id >= first + RSJ::kResetGroups)
+        return -1;
+    return static_cast<int>(id - first);
+}
+
+int CommandMap::getCommandBatch(CommandId id) noexcept
+{
+    static const auto first = LRCommandList::getIndexOfCommand("Start Batch");
+    if (first == LRCommandList::kNotFound || id < first || id >= first + RSJ::kBatchCommands)
+        return -1;
+    return static_cast<int>(id - first);
+}
+
+void CommandMap::setLayer(int layer) noexcept(ndebug)
+{
+    Expects(layer >= 0 && layer < RSJ::kLayers);
+    layer_.store(layer, std::memory_order_release);
+}
+
+void CommandMap::setModifier(int modifier, bool held) noexcept(ndebug)
+{
+    Expects(modifier > 0 && modifier < RSJ::kLayers);
+    if (held)
+        modifiers_.fetch_or(modifier, std::memory_order_acq_rel);
     else
-        message_map_[message] = LRCommandList::NextPrevProfile[command - LRCommandList::LRStringList.size()];
+        modifiers_.fetch_and(~modifier, std::memory_order_acq_rel);
+}
+
+int CommandMap::getLayerCount() const noexcept
+{
+    return Current_()->layers;
+}
+
+CommandMap::View<RSJ::MidiMessageId> CommandMap::getMessagesForCommand(const std::string& command) const
+{
+    return getMessagesForCommandId(LRCommandList::getIndexOfCommand(command));
+}
+
+CommandMap::View<RSJ::MidiMessageId> CommandMap::getMessagesForCommandId(size_t id) const
+{
+    auto snapshot = Current_();
+    if (id >= snapshot->command_messages.size())
+        return {};
+    const auto messages = snapshot->command_messages[id].Get();
+    return {std::move(snapshot), messages};
+}
+
+std::vector<CommandMap::CommandId> CommandMap::getMappedCommands() const
+{
+    const auto snapshot = Current_();
+    const auto& command_messages = snapshot->command_messages;
+    std::vector<CommandId> mapped;
+    for (size_t id = 0; id < command_messages.size(); ++id)
+        if (!command_messages[id].Get().empty())
+            mapped.push_back(gsl::narrow_cast<CommandId>(id));
+    return mapped;
 }
 
-std::vector<const RSJ::MidiMessageId*> CommandMap::getMessagesForCommand(const std::string& command) const
+void CommandMap::MessageList::Add(const RSJ::MidiMessageId& message)
 {
-    std::vector<const RSJ::MidiMessageId*> mm;
-    const auto range = command_string_map_.equal_range(command);
-    for (auto it = range.first; it != range.second; ++it)
-        mm.push_back(&it->second);
-    return mm;
+    for (const auto& existing : Get())
+        if (existing == message)
+            return;
+    if (size_ < kInline)
+        local_[size_] = message;
+    else {
+        if (size_ == kInline)
+            heap_.assign(local_.begin(), local_.end());
+        heap_.push_back(message);
+    }
+    ++size_;
 }
 
-void CommandMap::toXMLDocument(const juce::File& file) const
+void CommandMap::MessageList::Remove(const RSJ::MidiMessageId& message) noexcept
 {
-    if (message_map_.size()) {//don't bother if map is empty
-      // save the contents of the command map to an xml file
-        juce::XmlElement root{"settings"};
-        for (const auto& map_entry : message_map_) {
-            auto* setting = new juce::XmlElement{"setting"};
-            setting->setAttribute("channel", map_entry.first.channel);
-            switch (map_entry.first.msg_id_type) {
-            case RSJ::MsgIdEnum::NOTE: setting->setAttribute("note", map_entry.first.pitch);
+    auto* const first = size_ > kInline ? heap_.data() : local_.data();
+    const auto last = first + size_;
+    const auto found = std::find(first, last, message);
+    if (found == last)
+        return;
+    std::copy(found + 1, last, found);
+    if (--size_ > kInline)
+        heap_.pop_back();
+    else if (size_ == kInline) { //back to inline storage
+        std::copy(heap_.begin(), heap_.begin() + kInline, local_.begin());
+        heap_.clear();
+    }
+}
+
+gsl::span<const RSJ::MidiMessageId> CommandMap::MessageList::Get() const noexcept
+{
+    return {size_ > kInline ? heap_.data() : local_.data(), static_cast<std::ptrdiff_t>(size_)};
+}
+
+void CommandMap::toXMLDocument(const juce::File& file, const ControlsModel* controls) const
+{
+    if (!writeXml(file, controls))
+        // Give feedback if file-save doesn't work
+        juce::AlertWindow::showMessageBox(juce::AlertWindow::WarningIcon, "File Save Error",
+            "Unable to save file as specified. Please try again, and consider saving to a different location.");
+}
+
+bool CommandMap::writeXml(const juce::File& file, const ControlsModel* controls) const
+{
+    const auto held = Current_();
+    const auto& snapshot = *held;
+    if (snapshot.message_map.empty()) //don't bother if map is empty
+        return true;
+    //write beside the old file and swap, so an interrupted save keeps the last one
+    juce::TemporaryFile temp{file};
+    {//scoped so the stream is flushed and closed before the swap
+        juce::FileOutputStream out{temp.getFile(), kWriteBuffer};
+        if (!out.openedOk())
+            return false;
+        // the schema juce::XmlElement wrote, streamed without building the tree
+        out << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n\n<settings>\n";
+        for (const auto& map_entry : snapshot.message_map) {
+            const auto& message = map_entry.first;
+            out << "  <setting";
+            Attribute(out, "channel", message.channel);
+            switch (message.msg_id_type) {
+            case RSJ::MsgIdEnum::NOTE: Attribute(out, "note", message.pitch);
                 break;
-            case RSJ::MsgIdEnum::CC: setting->setAttribute("controller", map_entry.first.controller);
+            case RSJ::MsgIdEnum::CC: Attribute(out, "controller", message.controller);
                 break;
-            case RSJ::MsgIdEnum::PITCHBEND: setting->setAttribute("pitchbend", 0);
+            case RSJ::MsgIdEnum::PITCHBEND: Attribute(out, "pitchbend", 0);
                 break;
             }
-            setting->setAttribute("command_string", map_entry.second);
-            root.addChildElement(setting);
+            if (message.source)
+                Attribute(out, "device", RSJ::DeviceIdentifier(static_cast<short>(message.source)));
+            if (message.layer)
+                Attribute(out, "layer", message.layer);
+            Attribute(out, "command_string", getCommandString(map_entry.second));
+            const auto macro = snapshot.macros.find(message);
+            if (macro == snapshot.macros.end() || macro->second.empty()) {
+                out << "/>\n";
+                continue;
+            }
+            out << ">\n";
+            for (const auto& target : macro->second) {
+                out << "    <target";
+                Attribute(out, "command_string", getCommandString(target.command_id));
+                Attribute(out, "scale", target.scale);
+                Attribute(out, "offset", target.offset);
+                out << "/>\n";
+            }
+            out << "  </setting>\n";
+        }
+        if (controls) {
+            const auto settings = controls->getSettings();
+            out << (settings.empty() ? "  <controls/>\n" : "  <controls>\n");
+            for (const auto& control : settings) {
+                const auto& set = control.second;
+                out << "    <control";
+                Attribute(out, "channel", static_cast<int>(control.first) + 1);
+                Attribute(out, "number", set.number);
+                Attribute(out, "method", static_cast<int>(set.method));
+                Attribute(out, "low", set.low);
+                Attribute(out, "high", set.high);
+                if (!set.curve.IsLinear()) {
+                    Attribute(out, "curve", static_cast<int>(set.curve.type));
+                    Attribute(out, "amount", static_cast<double>(set.curve.amount));
+                    juce::StringArray points;
+                    for (const auto point : set.curve.points)
+                        points.add(juce::String{point});
+                    Attribute(out, "points", points.joinIntoString(","));
+                }
+                if (set.deadband)
+                    Attribute(out, "deadband", set.deadband);
+                if (set.acceleration != RSJ::Acceleration::none)
+                    Attribute(out, "acceleration", static_cast<int>(set.acceleration));
+                if (set.touch >= 0)
+                    Attribute(out, "touch", set.touch);
+                out << "/>\n";
+            }
+            if (!settings.empty())
+                out << "  </controls>\n";
         }
-        if (!root.writeToFile(file, ""))
-            // Give feedback if file-save doesn't work
-            juce::AlertWindow::showMessageBox(juce::AlertWindow::WarningIcon, "File Save Error",
-                "Unable to save file as specified. Please try again, and consider saving to a different location.");
+        out << "</settings>\n";
+        out.flush();
+        if (out.getStatus().failed())
+            return false;
     }
+    return temp.overwriteTargetFileWithTemporary();
 }
\ No newline at end of file
@@ -23,20 +23,93 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_COMMANDMAP_H_INCLUDED
 #define MIDI2LR_COMMANDMAP_H_INCLUDED
 
+#include <algorithm>
+#include <array>
+#include <atomic>
 #include <functional>
-#include <map>
+#include <memory>
 #include <string>
 #include <unordered_map>
+#include <utility>
+#include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include <gsl/gsl>
+#include "ControlsModel.h"
+#include "Instrumentation.h"
+#include "LRCommands.h"
 #include "MidiUtilities.h"
+#include "Utilities/Utilities.h"
 
+namespace RSJ {
+    // a profile's mappings, compiled once from its XML so switching to it again only
+    // swaps the map
+    struct CompiledProfile {
+        std::vector<std::pair<MidiMessageId, CommandId>> mappings;
+        std::unordered_map<MidiMessageId, std::vector<MacroTarget>> macros;
+        std::vector<MidiMessageId> messages; //mapped messages, sorted, once each
+        // per-control settings as channel (0-15) and settings, used only if the
+        // profile has a controls section. Older profiles leave the current ones
+        bool has_controls{false};
+        std::vector<std::pair<size_t, SettingsStruct>> controls;
+    };
+}
+
+// edits are made on the message thread and publish a new snapshot. Every const member
+// reads the current snapshot without locking, so any thread may call them during an edit
 class CommandMap {
+private:
+    struct Snapshot;
 public:
-    CommandMap() noexcept;
+    // index into LRCommandList::LRStringList, continuing into NextPrevProfile
+    using CommandId = RSJ::CommandId;
+    constexpr static CommandId kNoCommand = 0xFFFF;
+    CommandMap();
     virtual ~CommandMap() = default;
     CommandMap(const CommandMap&) = delete;
     CommandMap& operator=(const CommandMap&) = delete;
 
+    // items read from one snapshot of the map, which stays alive as long as the view.
+    // A view holds an RSJ::EpochGuard, so it stays on the thread that made it
+    template<class T>
+    class View {
+    public:
+        View() noexcept = default;
+        View(RSJ::Published<Snapshot>::Reader&& snapshot, gsl::span<const T> items) noexcept:
+            snapshot_{std::move(snapshot)}, items_{items}
+        {}
+        const T* begin() const noexcept
+        {
+            return items_.data();
+        }
+        const T* end() const noexcept
+        {
+            return items_.data() + items_.size();
+        }
+        const T* data() const noexcept
+        {
+            return items_.data();
+        }
+        std::ptrdiff_t size() const noexcept
+        {
+            return items_.size();
+        }
+        bool empty() const noexcept
+        {
+            return items_.empty();
+        }
+        // a reference to the snapshot, for keeping the items past the view or on another
+        // thread. Empty views need none
+        std::shared_ptr<const void> owner() const noexcept
+        {
+            if (items_.empty() || !snapshot_.get())
+                return {};
+            return snapshot_->shared_from_this();
+        }
+    private:
+        RSJ::Published<Snapshot>::Reader snapshot_{};
+        gsl::span<const T> items_{};
+    };
+
     // adds an entry to the message:command map, and a corresponding entry to the
     // command:message map will look up the string by the index (but it is preferred to
     // directly use the string)
@@ -46,65 +119,293 @@ class CommandMap {
     // command:message map
     void addCommandforMessage(const std::string& command, const RSJ::MidiMessageId& cc);
 
+    // replaces the whole map with one snapshot swap, for loading a profile. A message
+    // listed more than once keeps its last command
+    void setMappings(const std::vector<std::pair<RSJ::MidiMessageId, CommandId>>& mappings,
+        const std::unordered_map<RSJ::MidiMessageId, std::vector<RSJ::MacroTarget>>& macros = {});
+
+    // reads a profile's "settings" XML. Unknown commands become Unmapped
+    static RSJ::CompiledProfile CompileProfile(const juce::XmlElement& root);
+
+    // fills a profile's sorted message list from its mappings
+    static void IndexProfile(RSJ::CompiledProfile& profile);
+
+    // a whole map built ahead of time, on any thread, for setPrepared to install
+    class Prepared;
+    static std::unique_ptr<Prepared> Prepare(const RSJ::CompiledProfile& profile);
+
+    // replaces the whole map with a prepared one in one snapshot swap
+    void setPrepared(std::unique_ptr<Prepared> prepared);
+    // heap bytes a prepared map holds, for memory accounts
+    static size_t MemoryUse(const Prepared& prepared);
+
+    // extra commands sent along with a message's own command, each with its own scale
+    // and offset. An empty list removes them. Unmapped and profile switches are dropped
+    void setMacroTargets(const RSJ::MidiMessageId& message, std::vector<RSJ::MacroTarget> targets);
+
+    // the extra commands for a message from the compiled flat table
+    View<RSJ::MacroTarget> getMacroTargets(const RSJ::MidiMessageId& message) const noexcept;
+
     // gets the LR command associated to a MIDI message
     const std::string& getCommandforMessage(const RSJ::MidiMessageId& message) const;
 
+    // gets the command id for a MIDI message, kNoCommand if none, with a direct table
+    // lookup. The active layer's mapping is used, else the base layer's, and a message
+    // from a told-apart device falls back to the mapping for any device
+    CommandId getCommandIdforMessage(const RSJ::MidiMessageId& message) const noexcept(ndebug);
+
+    // as getCommandIdforMessage, without the fallbacks
+    CommandId getExactCommandId(const RSJ::MidiMessageId& message) const noexcept(ndebug);
+
+    // the key message is mapped under on the active layer: its own device's if mapped,
+    // otherwise any device's, and the base layer's if the active layer doesn't map it
+    RSJ::MidiMessageId getMappedKey(const RSJ::MidiMessageId& message) const noexcept(ndebug);
+
+    // true if a mapped message is the one its control uses on the active layer, or on
+    // layer, so feedback for it belongs on the control
+    bool isVisible(const RSJ::MidiMessageId& message) const noexcept(ndebug);
+    bool isVisible(const RSJ::MidiMessageId& message, int layer) const noexcept(ndebug);
+
+    // the layer lookups use: the held modifiers' bitmask while any are held, otherwise
+    // the latched layer. Switching only stores an index, so the next message is looked
+    // up on the new layer. Any thread
+    int getLayer() const noexcept
+    {
+        const auto modifiers = modifiers_.load(std::memory_order_acquire);
+        return modifiers ? modifiers : layer_.load(std::memory_order_acquire);
+    }
+    int getLatchedLayer() const noexcept
+    {
+        return layer_.load(std::memory_order_acquire);
+    }
+    void setLayer(int layer) noexcept(ndebug);
+    // holds or releases modifier bits. Any thread
+    void setModifier(int modifier, bool held) noexcept(ndebug);
+
+    // the highest layer the map uses, plus one
+    int getLayerCount() const noexcept;
+
+    // the LR command string for an id
+    static const std::string& getCommandString(CommandId id) noexcept(ndebug);
+
+    // RSJ::CommandFlag bits for an id
+    static unsigned char getCommandFlags(CommandId id) noexcept(ndebug);
+
+    // the layer a "Base Layer" or "Layer n" command selects, -1 for other commands
+    static int getCommandLayer(CommandId id) noexcept;
+
+    // the bit a "Modifier n" command holds, 0 for other commands
+    static int getCommandModifier(CommandId id) noexcept;
+
+    // the snapshot (0 for A, 1 for B) a "Capture Snapshot" or "Recall Snapshot" command
+    // uses, -1 for other commands
+    static int getCommandCapture(CommandId id) noexcept;
+    static int getCommandRecall(CommandId id) noexcept;
+    // the group a "Reset Group" command resets, -1 for other commands
+    static int getCommandResetGroup(CommandId id) noexcept;
+    // 0 for "Start Batch", 1 for "Commit Batch to Selection", 2 for "Discard Batch", -1
+    // for other commands
+    static int getCommandBatch(CommandId id) noexcept;
+
     // in the command:message map
     // removes a MIDI message from the message:command map, and it's associated entry
     void removeMessage(const RSJ::MidiMessageId& message);
 
     // clears both message:command and command:message maps
-    void clearMap() noexcept;
+    void clearMap();
 
     // returns true if there is a mapping for a particular MIDI message
     bool messageExistsInMap(const RSJ::MidiMessageId& message) const;
 
-    std::vector<const RSJ::MidiMessageId*> getMessagesForCommand(const std::string& command) const;
+    // the MIDI messages mapped to a LR command, without allocating
+    View<RSJ::MidiMessageId> getMessagesForCommand(const std::string& command) const;
+    View<RSJ::MidiMessageId> getMessagesForCommandId(size_t id) const;
     // gets the MIDI message associated to a LR command
 
     // returns true if there is a mapping for a particular LR command
     bool commandHasAssociatedMessage(const std::string& command) const;
 
-    // saves the message:command map as an XML file
-    void toXMLDocument(const juce::File& file) const;
+    // the LR commands with at least one MIDI message mapped, in command order
+    std::vector<CommandId> getMappedCommands() const;
+
+    // saves the message:command map as an XML file, with the control settings if given
+    void toXMLDocument(const juce::File& file, const ControlsModel* controls = nullptr) const;
+
+    // as toXMLDocument, but returns false rather than reporting a failure. The file is
+    // only replaced once the whole profile is written. Any thread
+    bool writeXml(const juce::File& file, const ControlsModel* controls = nullptr) const;
+
+    // bumped on every change to the map
+    juce::uint32 getChangeCount() const noexcept
+    {
+        return changes_.load(std::memory_order_acquire);
+    }
 
 private:
-    std::multimap<std::string, RSJ::MidiMessageId> command_string_map_;
-    std::unordered_map<RSJ::MidiMessageId, std::string> message_map_;
+    constexpr static size_t kChannels = 16;
+    constexpr static size_t kMessageTypes = 3; //RSJ::MsgIdEnum values
+    constexpr static size_t kPageSize = 0x4000; //one entry per controller number
+    // ids for one message type and channel, shared by snapshots until one changes it
+    using Page = std::array<CommandId, kPageSize>;
+    constexpr static size_t kPages = RSJ::kLayers * RSJ::kDeviceIds * kMessageTypes * kChannels;
+    using Pages = std::array<std::shared_ptr<const Page>, kPages>;
+    // messages for one command. Most commands have one or two, so those stay inline
+    class MessageList {
+    public:
+        void Add(const RSJ::MidiMessageId& message);
+        void Remove(const RSJ::MidiMessageId& message) noexcept;
+        gsl::span<const RSJ::MidiMessageId> Get() const noexcept;
+        size_t HeapBytes() const noexcept
+        {
+            return RSJ::HeapBytes(heap_);
+        }
+    private:
+        constexpr static size_t kInline = 4;
+        std::array<RSJ::MidiMessageId, kInline> local_{};
+        std::vector<RSJ::MidiMessageId> heap_{}; //holds all of them once more than kInline
+        size_t size_{0};
+    };
+    using MacroIndex = std::pair<RSJ::MidiMessageId, std::pair<size_t, size_t>>; //first and count
+    // one immutable version of the map. Edits copy the current snapshot, change the copy
+    // and publish it, so readers on any thread never lock, wait or see a partial edit. A
+    // replaced one is freed once no reader's RSJ::EpochGuard can still see it, or after
+    // the last View::owner reference to it goes
+    struct Snapshot: std::enable_shared_from_this<Snapshot> {
+        std::unordered_map<RSJ::MidiMessageId, CommandId> message_map;
+        std::vector<MessageList> command_messages; //indexed by CommandId, grown on demand
+        Pages pages{}; //nullptr for a type and channel with nothing mapped
+        int layers{1}; //highest layer mapped, plus one
+        std::unordered_map<RSJ::MidiMessageId, std::vector<RSJ::MacroTarget>> macros;
+        // all messages' extra commands in one array, recompiled whenever any change
+        std::vector<MacroIndex> macro_index; //sorted by message
+        std::vector<RSJ::MacroTarget> macro_targets;
+    };
+public:
+    class Prepared {
+    private:
+        friend class CommandMap;
+        std::unique_ptr<Snapshot> snapshot_;
+    };
+private:
+    static size_t PageIndex_(const RSJ::MidiMessageId& message) noexcept(ndebug);
+    static std::unique_ptr<Snapshot> Build_(
+        const std::vector<std::pair<RSJ::MidiMessageId, CommandId>>& mappings,
+        const std::unordered_map<RSJ::MidiMessageId, std::vector<RSJ::MacroTarget>>& macros);
+    static void CompileMacros_(Snapshot& snapshot);
+    // only Lightroom commands can be extra commands; Unmapped and profile switches can't
+    static bool IsMacroTarget_(size_t id) noexcept;
+    static void DropInvalidTargets_(std::vector<RSJ::MacroTarget>& targets);
+    static size_t SnapshotBytes_(const Snapshot& snapshot);
+    size_t MemoryUse_() const; //message thread
+    static void Map_(Snapshot& snapshot, CommandId id, const RSJ::MidiMessageId& message);
+    static void SetId_(Snapshot& snapshot, const RSJ::MidiMessageId& message, CommandId id);
+    RSJ::Published<Snapshot>::Reader Current_() const noexcept;
+    std::unique_ptr<Snapshot> Copy_() const;
+    void Publish_(std::unique_ptr<Snapshot> next);
+    RSJ::Published<Snapshot> snapshot_;
+    std::atomic<juce::uint32> changes_{0};
+    std::atomic<int> layer_{0};
+    std::atomic<int> modifiers_{0}; //bitmask of held modifiers
+    MemoryAccount memory_{"CommandMap", [this] {return MemoryUse_(); }}; //last, goes first
 };
 
-inline void CommandMap::addCommandforMessage(const std::string& command, const RSJ::MidiMessageId& message)
+inline size_t CommandMap::PageIndex_(const RSJ::MidiMessageId& message) noexcept(ndebug)
 {
-    message_map_[message] = command;
-    command_string_map_.insert({command, message});
+    Expects(message.channel >= 1 && message.channel <= static_cast<int>(kChannels));
+    Expects(message.source >= 0 && message.source < RSJ::kDeviceIds);
+    Expects(message.layer >= 0 && message.layer < RSJ::kLayers);
+    return ((static_cast<size_t>(message.layer) * RSJ::kDeviceIds + static_cast<size_t>(message.source)) *
+        kMessageTypes + static_cast<size_t>(message.msg_id_type)) * kChannels +
+        static_cast<size_t>(message.channel - 1);
 }
 
-inline const std::string& CommandMap::getCommandforMessage(const RSJ::MidiMessageId& message) const
+inline RSJ::Published<CommandMap::Snapshot>::Reader CommandMap::Current_() const noexcept
+{
+    return snapshot_.Read();
+}
+
+inline CommandMap::CommandId CommandMap::getExactCommandId(const RSJ::MidiMessageId& message) const noexcept(ndebug)
+{
+    const auto snapshot = Current_();
+    const auto& page = snapshot->pages[PageIndex_(message)];
+    if (!page)
+        return kNoCommand;
+    return (*page)[static_cast<size_t>(message.data) & (kPageSize - 1)];
+}
+
+inline RSJ::MidiMessageId CommandMap::getMappedKey(const RSJ::MidiMessageId& message) const noexcept(ndebug)
+{
+    auto key = message;
+    key.layer = getLayer();
+    // each layer first tries the device's own mapping, then the one for any device
+    for (;;) {
+        if (getExactCommandId(key) != kNoCommand)
+            return key;
+        if (key.source) {
+            auto any = key;
+            any.source = 0;
+            if (getExactCommandId(any) != kNoCommand)
+                return any;
+        }
+        if (!key.layer)
+            break;
+        key.layer = 0;
+    }
+    key.source = 0; //not mapped
+    return key;
+}
+
+inline bool CommandMap::isVisible(const RSJ::MidiMessageId& message) const noexcept(ndebug)
 {
-    return message_map_.at(message);
+    return isVisible(message, getLayer());
 }
 
-inline void CommandMap::removeMessage(const RSJ::MidiMessageId& message)
+inline bool CommandMap::isVisible(const RSJ::MidiMessageId& message, int layer) const noexcept(ndebug)
 {
-    // removes message from the message:command map, and its associated command from
-    // the command:message map
-    command_string_map_.erase(message_map_[message]);
-    message_map_.erase(message);
+    if (message.layer == layer)
+        return true;
+    if (message.layer)
+        return false;
+    // a base mapping is hidden where the active layer maps the same control
+    auto shown = message;
+    shown.layer = layer;
+    if (getExactCommandId(shown) != kNoCommand)
+        return false;
+    shown.source = 0;
+    return getExactCommandId(shown) == kNoCommand;
 }
 
-inline void CommandMap::clearMap() noexcept
+inline CommandMap::CommandId CommandMap::getCommandIdforMessage(const RSJ::MidiMessageId& message) const noexcept(ndebug)
+{
+    return getExactCommandId(getMappedKey(message));
+}
+
+inline CommandMap::View<RSJ::MacroTarget> CommandMap::getMacroTargets(const RSJ::MidiMessageId& message) const noexcept
+{
+    auto snapshot = Current_();
+    const auto found = std::lower_bound(snapshot->macro_index.begin(), snapshot->macro_index.end(),
+        message, [](const MacroIndex& entry, const RSJ::MidiMessageId& key) noexcept {
+        return entry.first < key; });
+    if (found == snapshot->macro_index.end() || !(found->first == message))
+        return {};
+    const gsl::span<const RSJ::MacroTarget> targets{snapshot->macro_targets.data() +
+        found->second.first, static_cast<std::ptrdiff_t>(found->second.second)};
+    return {std::move(snapshot), targets};
+}
+
+inline const std::string& CommandMap::getCommandforMessage(const RSJ::MidiMessageId& message) const
 {
-    command_string_map_.clear();
-    message_map_.clear();
+    return getCommandString(Current_()->message_map.at(message));
 }
 
 inline bool CommandMap::messageExistsInMap(const RSJ::MidiMessageId& message) const
 {
-    return message_map_.find(message) != message_map_.end();
+    const auto snapshot = Current_();
+    return snapshot->message_map.find(message) != snapshot->message_map.end();
 }
 
 inline bool CommandMap::commandHasAssociatedMessage(const std::string& command) const
 {
-    return command_string_map_.find(command) != command_string_map_.end();
+    return !getMessagesForCommand(command).empty();
 }
-#endif  // COMMANDMAP_H_INCLUDED
+#endif  // COMMANDMAP_H_INCLUDED
\ No newline at end of file
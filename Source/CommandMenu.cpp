@@ -20,6 +20,8 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
+#include <utility>
+#include <vector>
 #include <gsl/gsl>
 #include "CommandMenu.h"
 #include "CCoptions.h"
@@ -27,23 +29,26 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "LRCommands.h"
 #include "PWoptions.h"
 
+namespace {
+    // menu text for every command, converted once and shared by all menus
+    const std::vector<juce::String>& ReadableNames()
+    {
+        static const auto names = [] {
+            std::vector<juce::String> converted;
+            converted.reserve(LRCommandList::ReadableList.size());
+            for (const auto& readable : LRCommandList::ReadableList)
+                // UTF-8 literals, so don't let juce::String treat them as ASCII
+                converted.push_back(juce::String::fromUTF8(readable));
+            return converted;
+        }();
+        return names;
+    }
+
+    std::vector<RSJ::CommandId> search_results; //message thread only
+}
+
 CommandMenu::CommandMenu(const RSJ::MidiMessageId& message):
     juce::TextButton{"Unmapped"},
-    menus_({"Keyboard Shortcuts for User", "Library filter", "General", "Library",
-        "Develop", "Basic", "Tone Curve", "HSL / Color / B&W", "Reset HSL / Color / B&W",
-        "Split Toning", "Detail", "Lens Corrections", "Transform", "Effects",
-        "Camera Calibration", "Develop Presets", "Local Adjustments", "Crop",
-        "Go to Tool, Module, or Panel", "Secondary Display", "Profiles",
-        "Next/Prev Profile"}),
-    menu_entries_({LRCommandList::KeyShortcuts, LRCommandList::Filters,
-        LRCommandList::General, LRCommandList::Library, LRCommandList::Develop,
-        LRCommandList::BasicAdjustments, LRCommandList::ToneCurve, LRCommandList::Mixer,
-        LRCommandList::ResetMixer, LRCommandList::SplitToning, LRCommandList::Detail,
-        LRCommandList::LensCorrections, LRCommandList::Transform, LRCommandList::Effects,
-        LRCommandList::Calibration, LRCommandList::DevelopPresets,
-        LRCommandList::LocalAdjustments, LRCommandList::Crop,
-        LRCommandList::ToolModulePanel, LRCommandList::SecondaryDisplay,
-        LRCommandList::ProgramProfiles, LRCommandList::NextPrevProfile}),
     message_{message}
 {}
 
@@ -60,13 +65,27 @@ void CommandMenu::setMsg(const RSJ::MidiMessageId& message) noexcept
 void CommandMenu::setSelectedItem(size_t index)
 {
     selected_item_ = index;
+    setButtonText(ItemText(index));
+}
+
+juce::String CommandMenu::ItemText(size_t index)
+{
     if (index - 1 < LRCommandList::LRStringList.size())
-        setButtonText(LRCommandList::LRStringList[index - 1]);
-    else
-        setButtonText(LRCommandList::NextPrevProfile[index - 1 - LRCommandList::LRStringList.size()]);
+        return LRCommandList::LRStringList[index - 1];
+    return LRCommandList::NextPrevProfile[index - 1 - LRCommandList::LRStringList.size()];
+}
+
+void CommandMenu::setSearch(std::vector<RSJ::CommandId>&& commands)
+{
+    search_results = std::move(commands);
 }
 
 void CommandMenu::clicked(const juce::ModifierKeys& modifiers)
+{
+    Show(modifiers);
+}
+
+bool CommandMenu::Show(const juce::ModifierKeys& modifiers)
 {
     if (modifiers.isPopupMenu()) {
         switch (message_.msg_id_type) {
@@ -92,19 +111,32 @@ void CommandMenu::clicked(const juce::ModifierKeys& modifiers)
         }
     }
     else {
+        const auto& names = ReadableNames();
         size_t index = 1;
         auto submenu_tick_set = false;
         juce::PopupMenu main_menu;
         main_menu.addItem(gsl::narrow_cast<int>(index), "Unmapped", true, submenu_tick_set = (index == selected_item_));
         index++;
+        if (!search_results.empty()) {
+            juce::PopupMenu results;
+            for (const auto id : search_results) {
+                // menu items are command id + 1, and names skip "Unmapped"
+                if (id == 0 || static_cast<size_t>(id) - 1 >= names.size())
+                    continue;
+                results.addItem(id + 1, names[static_cast<size_t>(id) - 1], true,
+                    static_cast<size_t>(id) + 1 == selected_item_);
+            }
+            main_menu.addSubMenu("Search results", results);
+        }
         // add each submenu
-        for (size_t menu_index = 0; menu_index < menus_.size(); ++menu_index) {
+        for (const auto& section : LRCommandList::MenuSections) {
             juce::PopupMenu subMenu;
-            for (const auto& command : menu_entries_[menu_index]) {
-                auto already_mapped = false;
-                if ((index - 1 < LRCommandList::LRStringList.size()) && (command_map_))
-                    already_mapped =
-                        command_map_->commandHasAssociatedMessage(LRCommandList::LRStringList[index - 1]);
+            for (size_t entry = 0; entry < section.count; ++entry) {
+                const auto& command = names[section.first + entry];
+                // command ids index the map's per-command lists directly
+                const auto already_mapped = command_map_ &&
+                    index - 1 < LRCommandList::LRStringList.size() &&
+                    !command_map_->getMessagesForCommandId(index - 1).empty();
 
                 // add each submenu entry, ticking the previously selected entry and
                 // disabling a previously mapped entry
@@ -118,7 +150,7 @@ void CommandMenu::clicked(const juce::ModifierKeys& modifiers)
             }
             // set whether or not the submenu is ticked (true if one of the submenu's
             // entries is selected)
-            main_menu.addSubMenu(menus_[menu_index], subMenu, true, nullptr,
+            main_menu.addSubMenu(section.title, subMenu, true, nullptr,
                 selected_item_ < index && !submenu_tick_set);
             submenu_tick_set |= (selected_item_ < index && !submenu_tick_set);
         }
@@ -129,13 +161,12 @@ void CommandMenu::clicked(const juce::ModifierKeys& modifiers)
             // associated to this menu
             if (selected_item_ < std::numeric_limits<size_t>::max())
                 command_map_->removeMessage(message_);
-            if (result - 1 < LRCommandList::LRStringList.size())
-                setButtonText(LRCommandList::LRStringList[result - 1]);
-            else
-                setButtonText(LRCommandList::NextPrevProfile[result - 1 - LRCommandList::LRStringList.size()]);
+            setButtonText(ItemText(result));
             selected_item_ = result;
             // Map the selected command to the CC
             command_map_->addCommandforMessage(result - 1, message_);
+            return true;
         }
     }
+    return false;
 }
\ No newline at end of file
@@ -26,9 +26,10 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "MidiUtilities.h"
+#include "Utilities/Utilities.h"
 class CommandMap;
 
-class CommandMenu final: public juce::TextButton {
+class CommandMenu final: public juce::TextButton, RSJ::counter<CommandMenu> {
 public:
     explicit CommandMenu(const RSJ::MidiMessageId& msg);
     void Init(CommandMap* const map_command) noexcept;
@@ -38,12 +39,20 @@ class CommandMenu final: public juce::TextButton {
     // sets which item in the menu is selected
     void setSelectedItem(size_t idx);
 
+    // the command menu, or for a popup menu click the control's options dialog. True if
+    // a different command was mapped to the message
+    bool Show(const juce::ModifierKeys& modifiers);
+
+    // text of menu item idx, the command id + 1
+    static juce::String ItemText(size_t idx);
+
+    // these commands head every menu, none removes the list. message thread
+    static void setSearch(std::vector<RSJ::CommandId>&& commands);
+
 private:
     void clicked(const juce::ModifierKeys& modifiers) override;
 
     CommandMap* command_map_{nullptr};
-    const std::vector<juce::String> menus_;
-    const std::vector<std::vector<std::string>> menu_entries_;
     RSJ::MidiMessageId message_;
     size_t selected_item_{std::numeric_limits<size_t>::max()};
 };
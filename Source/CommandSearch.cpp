@@ -0,0 +1,95 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    CommandSearch.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "CommandSearch.h"
+#include <unordered_map>
+#include "LRCommands.h"
+
+namespace {
+    // lower case searchable text for each command id, 0 being "Unmapped", and the ids
+    // whose text holds each three character sequence
+    struct SearchIndex {
+        std::vector<juce::String> text;
+        std::unordered_map<juce::uint32, std::vector<RSJ::CommandId>> trigrams;
+    };
+
+    // collisions only cost a wider candidate list, matches are always checked
+    juce::uint32 Trigram(juce::juce_wchar a, juce::juce_wchar b, juce::juce_wchar c) noexcept
+    {
+        return (static_cast<juce::uint32>(a) & 0x3FF) << 20 |
+            (static_cast<juce::uint32>(b) & 0x3FF) << 10 | (static_cast<juce::uint32>(c) & 0x3FF);
+    }
+
+    const SearchIndex& Index()
+    {
+        static const auto index = [] {
+            SearchIndex built;
+            built.text.reserve(LRCommandList::ReadableList.size() + 1);
+            built.text.push_back("unmapped");
+            for (size_t readable = 0; readable < LRCommandList::ReadableList.size(); ++readable) {
+                // menu entries follow LRStringList less "Unmapped", so id is readable + 1
+                auto text = juce::String::fromUTF8(LRCommandList::ReadableList[readable]);
+                if (readable + 1 < LRCommandList::LRStringList.size())
+                    text << "\n" << juce::String{LRCommandList::LRStringList[readable + 1]};
+                built.text.push_back(text.toLowerCase());
+            }
+            for (size_t id = 0; id < built.text.size(); ++id) {
+                const auto& text = built.text[id];
+                for (auto i = 0; i + 2 < text.length(); ++i) {
+                    auto& ids = built.trigrams[Trigram(text[i], text[i + 1], text[i + 2])];
+                    if (ids.empty() || ids.back() != static_cast<RSJ::CommandId>(id))
+                        ids.push_back(static_cast<RSJ::CommandId>(id));
+                }
+            }
+            return built;
+        }();
+        return index;
+    }
+}
+
+std::vector<RSJ::CommandId> RSJ::FindCommands(const juce::String& text)
+{
+    const auto& index = Index();
+    const auto needle = text.toLowerCase();
+    std::vector<CommandId> found;
+    if (needle.isEmpty())
+        return found;
+    if (needle.length() < 3) {
+        for (size_t id = 0; id < index.text.size(); ++id)
+            if (index.text[id].contains(needle))
+                found.push_back(static_cast<CommandId>(id));
+        return found;
+    }
+    // verify only the ids listed under the needle's rarest trigram
+    const std::vector<CommandId>* candidates{nullptr};
+    for (auto i = 0; i + 2 < needle.length(); ++i) {
+        const auto ids = index.trigrams.find(Trigram(needle[i], needle[i + 1], needle[i + 2]));
+        if (ids == index.trigrams.end())
+            return found;
+        if (!candidates || ids->second.size() < candidates->size())
+            candidates = &ids->second;
+    }
+    for (const auto id : *candidates)
+        if (index.text[id].contains(needle))
+            found.push_back(id);
+    return found;
+}
@@ -0,0 +1,35 @@
+#pragma once
+/*
+  ==============================================================================
+
+    CommandSearch.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_COMMANDSEARCH_H_INCLUDED
+#define MIDI2LR_COMMANDSEARCH_H_INCLUDED
+
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiUtilities.h"
+
+namespace RSJ {
+    // ids of the commands whose menu or Lightroom name contains text, ignoring case, in
+    // id order. Backed by a trigram index over LRCommandList built on first use
+    std::vector<CommandId> FindCommands(const juce::String& text);
+}
+
+#endif  // COMMANDSEARCH_H_INCLUDED
@@ -21,23 +21,36 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include <algorithm>
+#include <iterator>
 #include <gsl/gsl>
 #include "CommandTableModel.h"
 #include "CommandMap.h"
 #include "CommandMenu.h"
+#include "CommandSearch.h"
 #include "LRCommands.h"
 #include "MidiUtilities.h"
 
 
-CommandTableModel::CommandTableModel() noexcept
+CommandTableModel::CommandTableModel()
 {}
 
+CommandTableModel::~CommandTableModel() = default;
+
 void CommandTableModel::Init(CommandMap* const map_command) noexcept
 {
     //copy the pointer
     command_map_ = map_command;
 }
 
+size_t CommandTableModel::MemoryUse_() const
+{
+    auto bytes = sizeof(CommandTableModel) + RSJ::HeapBytes(commands_) + RSJ::HeapBytes(rows_) +
+        RSJ::HeapBytes(filter_) + RSJ::HeapBytes(shown_) + (menu_ ? sizeof(CommandMenu) : 0);
+    for (const auto& term : filter_)
+        bytes += RSJ::HeapBytes(term.commands);
+    return bytes;
+}
+
 /**
 */
 void CommandTableModel::sortOrderChanged(int newSortColumnId, bool isForwards)
@@ -59,7 +72,7 @@ int CommandTableModel::getNumRows()
 
     // If the number of rows changes, you must call TableListBox::updateContent()
     // to cause it to refresh the list.
-    return gsl::narrow_cast<int>(commands_.size());
+    return gsl::narrow_cast<int>(RowCount_());
 }
 
 void CommandTableModel::paintRowBackground(juce::Graphics& g, int /*rowNumber*/, //-V2009 overridden method
@@ -92,99 +105,94 @@ void CommandTableModel::paintCell(juce::Graphics& g, int row_number, int column_
 
     if (column_id == 1) // write the MIDI message in the MIDI command column
     {
+        const auto& message = commands_[Entry_(static_cast<size_t>(row_number))];
         auto value = 0;
         auto channel = 0;
-        switch (commands_[static_cast<size_t>(row_number)].msg_id_type) //-V108 int used as index because JUCE uses int
+        switch (message.msg_id_type)
         {
         case RSJ::MsgIdEnum::NOTE:
             formatStr = "%d | Note: %d";
-            channel = commands_[static_cast<size_t>(row_number)].channel;
-            value = commands_[static_cast<size_t>(row_number)].pitch;
+            channel = message.channel;
+            value = message.pitch;
             break;
         case RSJ::MsgIdEnum::CC:
             formatStr = "%d | CC: %d";
-            channel = commands_[static_cast<size_t>(row_number)].channel;
-            value = commands_[static_cast<size_t>(row_number)].controller;
+            channel = message.channel;
+            value = message.controller;
             break;
         case RSJ::MsgIdEnum::PITCHBEND:
             formatStr = "%d | Pitch: %d";
-            channel = commands_[static_cast<size_t>(row_number)].channel;
+            channel = message.channel;
             break;
         }
-        g.drawText(juce::String::formatted(formatStr, channel, value), 0, 0, width, height, juce::Justification::centred);
+        auto text = juce::String::formatted(formatStr, channel, value);
+        if (message.source)
+            text << " | " << RSJ::DeviceIdentifier(static_cast<short>(message.source));
+        if (message.layer)
+            text << " | Layer " << message.layer;
+        g.drawText(text, 0, 0, width, height, juce::Justification::centred);
+    }
+    else if (column_id == 2 && static_cast<size_t>(row_number) < RowCount_()) {
+        // drawn as the button it opens, from the command id the map holds
+        const auto id = command_map_ ? command_map_->getCommandIdforMessage(
+            commands_[Entry_(static_cast<size_t>(row_number))]) : 0;
+        const juce::Rectangle<float> bounds{1.0f, 1.0f, width - 2.0f, height - 2.0f};
+        g.setColour(juce::Colours::lightgrey);
+        g.fillRoundedRectangle(bounds, 3.0f);
+        g.setColour(juce::Colours::grey);
+        g.drawRoundedRectangle(bounds, 3.0f, 1.0f);
+        g.setColour(juce::Colours::black);
+        g.drawText(CommandMenu::ItemText(static_cast<size_t>(id) + 1), 0, 0, width, height,
+            juce::Justification::centred);
     }
 }
 
-juce::Component* CommandTableModel::refreshComponentForCell(int row_number,
-    int column_id, bool /*isRowSelected*/, juce::Component *existing_component_to_update)
+void CommandTableModel::cellClicked(int row_number, int column_id,
+    const juce::MouseEvent& event)
 {
-    //This is used to create or update a custom component to go in a cell.
-
-    // Any cell may contain a custom component, or can just be drawn with the
-    // paintCell() method and handle mouse clicks with cellClicked().
-
-    // This method will be called whenever a custom component might need to be
-    // updated - e.g. when the table is changed, or TableListBox::updateContent()
-    // is called.
-
-    // If you don't need a custom component for the specified cell, then return
-    // nullptr. (Bear in mind that even if you're not creating a new component,
-    // you may still need to delete existingComponentToUpdate if it's non-null).
-
-    // If you do want a custom component, and the existingComponentToUpdate is
-    // null, then this method must create a new component suitable for the cell,
-    // and return it.
-
-    // If the existingComponentToUpdate is non - null, it will be a pointer to a
-    // component previously created by this method.In this case, the method must
-    // either update it to make sure it's correctly representing the given
-    // cell(which may be different from the one that the component was created
-    // for), or it can delete this component and return a new one.
-    //// Because Juce recycles these components when scrolling, we need to reset
-    //// their properties
-    if (column_id == 2) // LR command column
-    {
-        auto command_select = dynamic_cast<CommandMenu *>(existing_component_to_update);
-
-        // create a new command menu
-        if (command_select == nullptr) {
-            command_select = new CommandMenu{commands_[static_cast<size_t>(row_number)]};
-            command_select->Init(command_map_);
-        }
-        else
-            command_select->setMsg(commands_[static_cast<size_t>(row_number)]);
-
-        if (command_map_)
-        // add 1 because 0 is reserved for no selection
-            command_select->setSelectedItem(LRCommandList::getIndexOfCommand(command_map_->
-                getCommandforMessage(commands_[static_cast<size_t>(row_number)])) + 1);
-
-        return command_select;
+    if (column_id != 2 || row_number < 0 || static_cast<size_t>(row_number) >= RowCount_())
+        return;
+    const auto& message = commands_[Entry_(static_cast<size_t>(row_number))];
+    if (!menu_) {
+        menu_ = std::make_unique<CommandMenu>(message);
+        menu_->Init(command_map_);
     }
-    return nullptr;
+    else
+        menu_->setMsg(message);
+    if (command_map_)
+        // add 1 because 0 is reserved for no selection
+        menu_->setSelectedItem(static_cast<size_t>(command_map_->
+            getCommandIdforMessage(message)) + 1);
+    if (menu_->Show(event.mods) && event.eventComponent)
+        event.eventComponent->repaint(); //the row, showing the new command
 }
 
-void CommandTableModel::addRow(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType)
+void CommandTableModel::addRow(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType,
+    int source, int layer)
 {
-    const RSJ::MidiMessageId msg{midi_channel, midi_data, msgType};
+    const RSJ::MidiMessageId msg{midi_channel, midi_data, msgType, source, layer};
     if (command_map_ && !command_map_->messageExistsInMap(msg)) {
-        commands_.push_back(msg);
         command_map_->addCommandforMessage(0, msg); // add an entry for 'no command'
-        Sort(); //re-sort list
+        Index_(Insert_(msg));
     }
 }
 
-void CommandTableModel::removeRow(size_t row)
+void CommandTableModel::removeRow(size_t shown_row)
 {
+    const auto row = Entry_(shown_row);
     if (command_map_)
         command_map_->removeMessage(commands_[row]);
+    rows_.erase(commands_[row]);
     commands_.erase(commands_.cbegin() + row);
+    Index_(row);
 }
 
 void CommandTableModel::removeAllRows()
 {
     commands_.clear();
-    if (command_map_) 
+    rows_.clear();
+    shown_.clear();
+    if (command_map_)
         command_map_->clearMap();
 }
 
@@ -192,46 +200,190 @@ void CommandTableModel::buildFromXml(const juce::XmlElement * const root)
 {
     if (root->getTagName().compare("settings") != 0)
         return;
-    removeAllRows();
-    const auto* setting = root->getFirstChildElement();
-    while ((setting) && (command_map_)) {
-        if (setting->hasAttribute("controller")) {
-            const RSJ::MidiMessageId message{setting->getIntAttribute("channel"),
-                setting->getIntAttribute("controller"), RSJ::MsgIdEnum::CC};
-            addRow(message.channel, message.controller, RSJ::MsgIdEnum::CC);
-            command_map_->addCommandforMessage(setting->
-                getStringAttribute("command_string").toStdString(), message);
+    buildFromProfile(CommandMap::CompileProfile(*root));
+}
+
+void CommandTableModel::buildFromProfile(const RSJ::CompiledProfile& profile)
+{
+    if (!command_map_) {
+        commands_.clear();
+        return;
+    }
+    command_map_->setMappings(profile.mappings, profile.macros);
+    showProfile(profile);
+}
+
+int CommandTableModel::showProfile(const RSJ::CompiledProfile& profile, int selected_row)
+{
+    if (!command_map_) {
+        commands_.clear();
+        return -1;
+    }
+    const auto selected = selected_row >= 0 && static_cast<size_t>(selected_row) < RowCount_() ?
+        commands_[Entry_(static_cast<size_t>(selected_row))] : RSJ::MidiMessageId{};
+    // profile.messages is sorted, and rows_ answers whether a message is shown
+    const auto gone = [&profile](const RSJ::MidiMessageId& message) {
+        return !std::binary_search(profile.messages.cbegin(), profile.messages.cend(), message);
+    };
+    auto first = static_cast<size_t>(std::find_if(commands_.begin(), commands_.end(), gone) -
+        commands_.begin());
+    const auto shown = commands_.size();
+    commands_.erase(std::remove_if(commands_.begin() + static_cast<std::ptrdiff_t>(first),
+        commands_.end(), [this, &gone](const RSJ::MidiMessageId& message) {
+        if (!gone(message))
+            return false;
+        rows_.erase(message);
+        return true;
+    }), commands_.end());
+    std::vector<RSJ::MidiMessageId> added;
+    for (const auto& message : profile.messages)
+        if (rows_.find(message) == rows_.end())
+            added.push_back(message);
+    static auto& changed_rows = Instrumentation::Counter("profile switch rows changed");
+    changed_rows.fetch_add(shown - commands_.size() + added.size(), std::memory_order_relaxed);
+    // a new command for a kept message can put it out of order when sorted by command,
+    // and past a quarter of the rows one sort beats inserting each
+    if (added.size() * 4 > profile.messages.size() || (current_sort.first != 1 &&
+        !std::is_sorted(commands_.cbegin(), commands_.cend(),
+            [this](const RSJ::MidiMessageId& a, const RSJ::MidiMessageId& b) {
+        return Before_(a, b); }))) {
+        commands_.insert(commands_.end(), added.cbegin(), added.cend());
+        Sort();
+    }
+    else {
+        for (const auto& message : added)
+            first = std::min(first, Insert_(message));
+        Index_(std::min(first, commands_.size()));
+    }
+    if (selected == RSJ::MidiMessageId{} || gone(selected))
+        return -1;
+    const auto row = getRowForMessage(selected.channel, selected.data, selected.msg_id_type,
+        selected.source, selected.layer);
+    return row < static_cast<int>(RowCount_()) ? row : -1;
+}
+
+int CommandTableModel::getRowForMessage(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType,
+    int source, int layer) const
+{
+    auto found = rows_.end();
+    for (auto on = layer; found == rows_.end() && on >= 0; on = on ? 0 : -1) {
+        found = rows_.find({midi_channel, midi_data, msgType, source, on});
+        if (found == rows_.end() && source)
+            found = rows_.find({midi_channel, midi_data, msgType, 0, on});
+    }
+    if (found == rows_.end())
+        return gsl::narrow_cast<int>(RowCount_());
+    if (filter_.empty())
+        return gsl::narrow_cast<int>(found->second);
+    const auto shown = std::lower_bound(shown_.cbegin(), shown_.cend(), found->second);
+    return gsl::narrow_cast<int>(shown != shown_.cend() && *shown == found->second ?
+        shown - shown_.cbegin() : shown_.cend() - shown_.cbegin());
+}
+
+void CommandTableModel::setFilter(const juce::String& filter)
+{
+    filter_.clear();
+    for (const auto& token : juce::StringArray::fromTokens(filter.toLowerCase(), " ", "")) {
+        if (token.isEmpty())
+            continue;
+        Term term;
+        if (token.containsOnly("0123456789"))
+            term.channel = token.getIntValue();
+        else if (token == "cc" || token == "note" || token == "pitch" || token == "pitchbend") {
+            term.any_type = false;
+            term.type = token == "cc" ? RSJ::MsgIdEnum::CC :
+                token == "note" ? RSJ::MsgIdEnum::NOTE : RSJ::MsgIdEnum::PITCHBEND;
         }
-        else if (setting->hasAttribute("note")) {
-            const RSJ::MidiMessageId note{setting->getIntAttribute("channel"),
-                setting->getIntAttribute("note"), RSJ::MsgIdEnum::NOTE};
-            addRow(note.channel, note.pitch, RSJ::MsgIdEnum::NOTE);
-            command_map_->addCommandforMessage(setting->
-                getStringAttribute("command_string").toStdString(), note);
+        else {
+            term.any_command = false;
+            term.commands = RSJ::FindCommands(token);
         }
-        else if (setting->hasAttribute("pitchbend")) {
-            const RSJ::MidiMessageId pb{setting->getIntAttribute("channel"), 0,
-                RSJ::MsgIdEnum::PITCHBEND};
-            addRow(pb.channel, 0, RSJ::MsgIdEnum::PITCHBEND);
-            command_map_->addCommandforMessage(setting->
-                getStringAttribute("command_string").toStdString(), pb);
+        filter_.push_back(std::move(term));
+    }
+    Index_(0);
+}
+
+std::vector<RSJ::CommandId> CommandTableModel::getFilterCommands() const
+{
+    std::vector<RSJ::CommandId> commands;
+    auto first = true;
+    for (const auto& term : filter_) {
+        if (term.any_command)
+            continue;
+        if (first)
+            commands = term.commands;
+        else {
+            std::vector<RSJ::CommandId> both;
+            std::set_intersection(commands.cbegin(), commands.cend(), term.commands.cbegin(),
+                term.commands.cend(), std::back_inserter(both));
+            commands.swap(both);
         }
-        setting = setting->getNextElement();
+        first = false;
     }
-    Sort();
+    return commands;
+}
+
+bool CommandTableModel::Before_(const RSJ::MidiMessageId& a,
+    const RSJ::MidiMessageId& b) const
+{
+    if (current_sort.first == 1)
+        return current_sort.second ? a < b : b < a;
+    const auto a_id = command_map_->getCommandIdforMessage(a);
+    const auto b_id = command_map_->getCommandIdforMessage(b);
+    return current_sort.second ? a_id < b_id : b_id < a_id;
+}
+
+size_t CommandTableModel::Insert_(const RSJ::MidiMessageId& message)
+{
+    // where the current sort puts it rather than re-sorting. Command keys are direct
+    // table lookups, so the binary search costs log n of them
+    const auto row = static_cast<size_t>(std::upper_bound(commands_.begin(), commands_.end(),
+        message, [this](const RSJ::MidiMessageId& a, const RSJ::MidiMessageId& b) {
+        return Before_(a, b); }) - commands_.begin());
+    commands_.insert(commands_.begin() + static_cast<std::ptrdiff_t>(row), message);
+    return row;
+}
+
+bool CommandTableModel::Matches_(const RSJ::MidiMessageId& message) const
+{
+    return std::all_of(filter_.cbegin(), filter_.cend(), [this, &message](const Term& term) {
+        if (term.channel)
+            return message.channel == term.channel;
+        if (!term.any_type)
+            return message.msg_id_type == term.type;
+        return term.any_command || (command_map_ && std::binary_search(term.commands.cbegin(),
+            term.commands.cend(), command_map_->getCommandIdforMessage(message)));
+    });
+}
+
+size_t CommandTableModel::Entry_(size_t row) const noexcept
+{
+    return filter_.empty() ? row : shown_[row];
+}
+
+size_t CommandTableModel::RowCount_() const noexcept
+{
+    return filter_.empty() ? commands_.size() : shown_.size();
 }
 
-int CommandTableModel::getRowForMessage(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType) const
+void CommandTableModel::Index_(size_t first)
 {
-    const RSJ::MidiMessageId msg_id{midi_channel, midi_data, msgType};
-    return gsl::narrow_cast<int>(std::find(commands_.begin(), commands_.end(), msg_id) - commands_.begin());
+    if (first == 0)
+        rows_.clear();
+    for (auto row = first; row < commands_.size(); ++row)
+        rows_[commands_[row]] = row;
+    // command lookups are direct, so refiltering every row stays cheap
+    shown_.clear();
+    if (!filter_.empty())
+        for (size_t row = 0; row < commands_.size(); ++row)
+            if (Matches_(commands_[row]))
+                shown_.push_back(row);
 }
 
 void CommandTableModel::Sort()
 {
-    // use LRCommandList::getIndexOfCommand(string); to sort by command
-    const auto msg_idx = [this](RSJ::MidiMessageId a) {return LRCommandList::getIndexOfCommand
-    (command_map_->getCommandforMessage(a)); };
+    // command ids are indices into LRCommandList, so they sort by command directly
+    const auto msg_idx = [this](RSJ::MidiMessageId a) {return command_map_->getCommandIdforMessage(a); };
     const auto msg_sort = [&msg_idx](RSJ::MidiMessageId a, RSJ::MidiMessageId b) { return msg_idx(a) < msg_idx(b); };
 
     if (current_sort.first == 1)
@@ -244,4 +396,5 @@ void CommandTableModel::Sort()
             std::sort(commands_.begin(), commands_.end(), msg_sort);
         else
             std::sort(commands_.rbegin(), commands_.rend(), msg_sort);
+    Index_(0);
 }
\ No newline at end of file
@@ -22,18 +22,23 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_COMMANDTABLEMODEL_H
 #define MIDI2LR_COMMANDTABLEMODEL_H
 
+#include <memory>
+#include <unordered_map>
 #include <utility>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "Instrumentation.h"
+#include "MidiUtilities.h"
 class CommandMap;
+class CommandMenu;
 namespace RSJ {
-    enum class MsgIdEnum: short;
-    struct MidiMessageId;
+    struct CompiledProfile;
 }
 
 class CommandTableModel final: public juce::TableListBoxModel {
 public:
-    CommandTableModel() noexcept;
+    CommandTableModel();
+    ~CommandTableModel();
     void Init(CommandMap* const mapCommand) noexcept;
     CommandTableModel& operator=(const CommandTableModel&) = delete;
     CommandTableModel(const CommandTableModel&) = delete;
@@ -44,11 +49,12 @@ class CommandTableModel final: public juce::TableListBoxModel {
         int height, bool rowIsSelected) override;
     void paintCell(juce::Graphics&, int rowNumber, int columnId, int width,
         int height, bool rowIsSelected) override;
-    juce::Component *refreshComponentForCell(int rowNumber, int columnId,
-        bool isRowSelected, juce::Component *existingComponentToUpdate) override;
+    void cellClicked(int rowNumber, int columnId, const juce::MouseEvent&) override;
 
-    // adds a row with a corresponding MIDI message to the table
-    void addRow(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType);
+    // adds a row with a corresponding MIDI message to the table. source is the
+    // message's RSJ::DeviceIndex, 0 for any device, and layer its layer
+    void addRow(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType, int source = 0,
+        int layer = 0);
 
     // removes a row from the table
     void removeRow(size_t row);
@@ -59,15 +65,58 @@ class CommandTableModel final: public juce::TableListBoxModel {
     // builds the table from an XML file
     void buildFromXml(const juce::XmlElement * const elem);
 
-    // returns the index of the row associated to a particular MIDI message
-    int getRowForMessage(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType) const;
+    // builds the table from an already compiled profile
+    void buildFromProfile(const RSJ::CompiledProfile& profile);
+
+    // lists a compiled profile the command map already holds. Only the rows that
+    // differ from those shown are removed and inserted, so rows the profiles share
+    // keep their order. Returns the row selected_row's message now has, -1 if gone
+    int showProfile(const RSJ::CompiledProfile& profile, int selected_row = -1);
+
+    // returns the index of the row associated to a particular MIDI message, or to
+    // the same message from any device if source has no row of its own, looking on
+    // layer and then on the base layer
+    int getRowForMessage(int midi_channel, int midi_data, RSJ::MsgIdEnum msgType,
+        int source = 0, int layer = 0) const;
+
+    // shows only rows matching every space separated term: a number matches the
+    // channel, "cc", "note" or "pitch" the message type, anything else the command
+    void setFilter(const juce::String& filter);
+
+    // commands matching all of the filter's command terms, empty when it has none
+    std::vector<RSJ::CommandId> getFilterCommands() const;
 
 private:
+    // a parsed filter term
+    struct Term {
+        int channel{0}; //0 when not a channel term
+        bool any_type{true};
+        RSJ::MsgIdEnum type{RSJ::MsgIdEnum::CC};
+        bool any_command{true};
+        std::vector<RSJ::CommandId> commands; //sorted
+    };
+    bool Matches_(const RSJ::MidiMessageId& message) const;
+    // whether a comes before b in the current sort
+    bool Before_(const RSJ::MidiMessageId& a, const RSJ::MidiMessageId& b) const;
+    // inserts where the current sort puts it, returning its position
+    size_t Insert_(const RSJ::MidiMessageId& message);
+    // position in commands_ of a shown row
+    size_t Entry_(size_t row) const noexcept;
+    size_t RowCount_() const noexcept;
+    // refreshes rows_ from this row to the end, and the shown rows when filtering
+    void Index_(size_t first);
     void Sort();
+    size_t MemoryUse_() const; //message thread
     CommandMap* command_map_{nullptr};
     std::pair<int, bool> current_sort{2, true};
     std::pair<int, bool> prior_sort{2, true};
     std::vector<RSJ::MidiMessageId> commands_;
+    std::unordered_map<RSJ::MidiMessageId, size_t> rows_; //row of each entry in commands_
+    std::vector<Term> filter_;
+    std::vector<size_t> shown_; //commands_ positions passing filter_, in order
+    // the command column is painted; this menu is made on the first click and reused
+    std::unique_ptr<CommandMenu> menu_{nullptr};
+    MemoryAccount memory_{"UI rows", [this] {return MemoryUse_(); }}; //last, goes first
 };
 
 #endif
\ No newline at end of file
@@ -0,0 +1,285 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    ControllerPresets.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ControllerPresets.h"
+#include <algorithm>
+#include <array>
+#include <set>
+#include <tuple>
+#include "AsyncLog.h"
+#include "ControlsModel.h"
+#include "Instrumentation.h"
+#include "MIDIProcessor.h"
+#include "MIDISender.h"
+#include "ProfileManager.h"
+
+namespace {
+    constexpr int kMaxPresets = 32; //B-Control presets are 1-32
+    constexpr int kNameLength = 24;
+    constexpr int kFaders = 8; //BCF2000 only
+    constexpr int kButtons = 48;
+    constexpr std::array<const char*, 4> kModes{{"absolute", "relative-1", "relative-2",
+        "relative-3"}}; //by RSJ::CCmethod
+
+    // Behringer's B-Control Language, a line per SysEx frame. A control keeps its
+    // element in every layer, so a knob doesn't wander on a bank change. Notes take the
+    // buttons (the two rows, then the encoder pushes), absolute CCs the BCF2000's motor
+    // faders while they last, and other CCs the encoders. Pitch bend has no element. The
+    // device must be set to send a program change when it recalls a preset, which is
+    // the bank change
+    class BControlDriver final: public PresetDriver {
+    public:
+        BControlDriver(bool faders, int first_preset) noexcept:
+            faders_{faders}, first_preset_{first_preset}
+        {}
+        bool Matches(const juce::String& device) const override
+        {
+            return device.containsIgnoreCase(faders_ ? "BCF2000" : "BCR2000");
+        }
+        std::vector<juce::MidiMessage> Build(const RSJ::CompiledProfile& profile,
+            const juce::String& name) const override;
+        int BankChange(const RSJ::MidiMessage& message) const noexcept override
+        {
+            if (message.message_type_byte != RSJ::kPgmChangeFlag)
+                return -1;
+            const auto layer = message.number - (first_preset_ - 1);
+            return layer >= 0 && layer < RSJ::kLayers ? layer : -1;
+        }
+
+    private:
+        juce::MidiMessage Frame_(int index, const juce::String& line) const;
+        const bool faders_;
+        const int first_preset_;
+    };
+
+    const RSJ::SettingsStruct* Settings(const RSJ::CompiledProfile& profile,
+        const RSJ::MidiMessageId& message) noexcept
+    {
+        for (const auto& control : profile.controls)
+            if (static_cast<int>(control.first) + 1 == message.channel &&
+                control.second.number == message.controller)
+                return &control.second;
+        return nullptr;
+    }
+
+    juce::String EasyPar(const RSJ::CompiledProfile& profile, const RSJ::MidiMessageId& message)
+    {
+        const auto address = juce::String(message.channel) + " " + juce::String(message.controller);
+        if (message.msg_id_type == RSJ::MsgIdEnum::NOTE)
+            return "  .easypar NOTE " + address + " 127 0 toggleoff";
+        const auto settings = Settings(profile, message);
+        if (settings && settings->method != RSJ::CCmethod::absolute)
+            return "  .easypar CC " + address + " 0 127 " +
+            kModes[static_cast<size_t>(settings->method)];
+        const auto low = settings ? settings->low : 0;
+        const auto high = settings ? settings->high : 127;
+        return "  .easypar CC " + address + " " + juce::String(low) + " " + juce::String(high) +
+            (high > 127 ? " absolute/14" : " absolute");
+    }
+
+    // the profile's file name as the device shows it
+    juce::String PresetName(const juce::String& name, int layer)
+    {
+        auto shown = name.containsChar('.') ? name.upToLastOccurrenceOf(".", false, false) : name;
+        if (layer)
+            shown = shown.substring(0, kNameLength - 3) + " L" + juce::String(layer + 1);
+        juce::String printable;
+        for (auto i = 0; i < std::min(shown.length(), kNameLength); ++i)
+            printable += shown[i] >= ' ' && shown[i] < 0x7F && shown[i] != '\'' ? shown[i] : '_';
+        return printable;
+    }
+
+    juce::uint64 Hash(const std::vector<juce::MidiMessage>& frames) noexcept
+    { //FNV-1a
+        juce::uint64 hash{0xcbf29ce484222325};
+        for (const auto& frame : frames)
+            for (auto i = 0; i < frame.getRawDataSize(); ++i)
+                hash = (hash ^ frame.getRawData()[i]) * 0x100000001b3;
+        return hash;
+    }
+}
+
+juce::MidiMessage BControlDriver::Frame_(int index, const juce::String& line) const
+{
+    std::vector<juce::uint8> data{0x00, 0x20, 0x32, 0x7F, //Behringer, any device id
+        static_cast<juce::uint8>(faders_ ? 0x14 : 0x15), 0x20, //BCL text
+        static_cast<juce::uint8>((index >> 7) & 0x7F), static_cast<juce::uint8>(index & 0x7F)};
+    for (const auto* c = line.toRawUTF8(); *c; ++c)
+        data.push_back(static_cast<juce::uint8>(*c & 0x7F));
+    return juce::MidiMessage::createSysExMessage(data.data(), static_cast<int>(data.size()));
+}
+
+std::vector<juce::MidiMessage> BControlDriver::Build(const RSJ::CompiledProfile& profile,
+    const juce::String& name) const
+{
+    // elements in type, channel and number order, the same whichever layers map them
+    std::map<std::tuple<RSJ::MsgIdEnum, int, int>, juce::String> elements;
+    for (const auto& message : profile.messages)
+        if (message.msg_id_type != RSJ::MsgIdEnum::PITCHBEND)
+            elements.emplace(std::make_tuple(message.msg_id_type, message.channel,
+                message.controller), juce::String{});
+    const auto encoders = faders_ ? 32 : 56;
+    auto fader = 0;
+    auto encoder = 0;
+    auto button = 0;
+    auto unplaced = 0;
+    for (auto& element : elements) {
+        const auto& key = element.first;
+        if (std::get<0>(key) == RSJ::MsgIdEnum::NOTE) {
+            if (button < kButtons) {
+                element.second = "$button " + juce::String(button < 16 ? 33 + button : button - 15);
+                ++button;
+            }
+        }
+        else {
+            const RSJ::MidiMessageId message{std::get<1>(key), std::get<2>(key), RSJ::MsgIdEnum::CC};
+            const auto settings = Settings(profile, message);
+            if (faders_ && fader < kFaders &&
+                (!settings || settings->method == RSJ::CCmethod::absolute))
+                element.second = "$fader " + juce::String(++fader);
+            else if (encoder < encoders)
+                element.second = "$encoder " + juce::String(++encoder);
+        }
+        if (element.second.isEmpty())
+            ++unplaced;
+    }
+    if (unplaced)
+        AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::warning,
+            "%d controls of %s have no %s element", unplaced, name.toRawUTF8(),
+            faders_ ? "BCF2000" : "BCR2000");
+
+    std::vector<juce::MidiMessage> frames;
+    const auto line = [this, &frames](const juce::String& text) {
+        frames.push_back(Frame_(static_cast<int>(frames.size()), text));
+    };
+    line(faders_ ? "$rev F1" : "$rev R1");
+    auto message = profile.messages.begin(); //sorted by layer first
+    for (auto layer = 0; layer < RSJ::kLayers && first_preset_ + layer <= kMaxPresets; ++layer) {
+        if (message == profile.messages.end() || message->layer != layer)
+            continue;
+        line("$preset");
+        line("  .init");
+        line("  .name '" + PresetName(name, layer) + "'");
+        line("  .egroups 4");
+        line("  .fkeys on");
+        line("  .lock off");
+        std::set<juce::String> defined; //a control mapped for several sources is one element
+        for (; message != profile.messages.end() && message->layer == layer; ++message) {
+            const auto found = elements.find(std::make_tuple(message->msg_id_type,
+                message->channel, message->controller));
+            if (found == elements.end() || found->second.isEmpty() ||
+                !defined.insert(found->second).second)
+                continue;
+            line(found->second);
+            line(EasyPar(profile, *message));
+            line("  .showvalue on");
+            if (found->second.startsWith("$encoder"))
+                line("  .mode 1dot");
+            else if (found->second.startsWith("$fader"))
+                line("  .motor on");
+        }
+        line("$store " + juce::String(first_preset_ + layer));
+    }
+    line("$end");
+    return frames;
+}
+
+void ControllerPresets::Init(int first_preset, ProfileManager* const profile_manager,
+    MIDIProcessor* const midi_processor, std::weak_ptr<MIDISender>&& midi_sender)
+{
+    if (first_preset <= 0 || first_preset > kMaxPresets)
+        return;
+    profile_manager_ = profile_manager;
+    midi_processor_ = midi_processor;
+    midi_sender_ = std::move(midi_sender);
+    drivers_.push_back(std::make_unique<BControlDriver>(true, first_preset));
+    drivers_.push_back(std::make_unique<BControlDriver>(false, first_preset));
+    frames_.resize(drivers_.size());
+    hashes_.resize(drivers_.size());
+    profile_manager_->addCallback<ControllerPresets, &ControllerPresets::ProfileCallback>(this);
+    midi_processor_->SetBankChanges(true);
+    midi_processor_->addBankCallback<ControllerPresets, &ControllerPresets::BankCallback>(this);
+    if (const auto sender = midi_sender_.lock())
+        sender->addDeviceCallback<ControllerPresets, &ControllerPresets::DeviceCallback>(this);
+}
+
+void ControllerPresets::ProfileCallback(const RSJ::CompiledProfile& profile,
+    const juce::String& name)
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    for (size_t i = 0; i < drivers_.size(); ++i) {
+        frames_[i] = drivers_[i]->Build(profile, name);
+        hashes_[i] = Hash(frames_[i]);
+    }
+    for (const auto& output : outputs_)
+        Upload_(output);
+}
+
+void ControllerPresets::DeviceCallback(const juce::String& device)
+{
+    if (!Driver_(device))
+        return;
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    outputs_.addIfNotAlreadyThere(device);
+    Upload_(device); //a replugged device still holds what it was sent
+}
+
+void ControllerPresets::BankCallback(RSJ::MidiMessage message)
+{
+    const auto driver = Driver_(midi_processor_->getInputName(message.device));
+    if (!driver)
+        return;
+    const auto layer = driver->BankChange(message);
+    if (layer < 0)
+        return;
+    static auto& changes = Instrumentation::Counter("device bank changes");
+    changes.fetch_add(1, std::memory_order_relaxed);
+    profile_manager_->switchToLayer(layer);
+}
+
+const PresetDriver* ControllerPresets::Driver_(const juce::String& device) const
+{
+    for (const auto& driver : drivers_)
+        if (driver->Matches(device))
+            return driver.get();
+    return nullptr;
+}
+
+void ControllerPresets::Upload_(const juce::String& device)
+{
+    for (size_t i = 0; i < drivers_.size(); ++i)
+        if (drivers_[i]->Matches(device)) {
+            auto& held = uploaded_[device];
+            if (frames_[i].empty() || held == hashes_[i])
+                return;
+            if (const auto sender = midi_sender_.lock())
+                if (sender->Upload(frames_[i], device)) {
+                    held = hashes_[i];
+                    static auto& uploads = Instrumentation::Counter("controller preset uploads");
+                    uploads.fetch_add(1, std::memory_order_relaxed);
+                    AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::info,
+                        "%d preset frames queued to %s", static_cast<int>(frames_[i].size()),
+                        device.toRawUTF8());
+                }
+            return;
+        }
+}
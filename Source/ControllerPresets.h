@@ -0,0 +1,84 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ControllerPresets.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_CONTROLLERPRESETS_H_INCLUDED
+#define MIDI2LR_CONTROLLERPRESETS_H_INCLUDED
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "CommandMap.h"
+#include "MidiUtilities.h"
+class MIDIProcessor;
+class MIDISender;
+class ProfileManager;
+
+// builds presets a controller stores itself from a profile, one per layer, so the
+// controller's own bank buttons change layer: the device recalls the preset and tells
+// MIDI2LR, which only swaps its layer instead of switching profile
+class PresetDriver {
+public:
+    virtual ~PresetDriver() = default;
+    // true if this driver handles the input or output named device
+    virtual bool Matches(const juce::String& device) const = 0;
+    // the SysEx frames storing profile's layers in the device, in sending order
+    virtual std::vector<juce::MidiMessage> Build(const RSJ::CompiledProfile& profile,
+        const juce::String& name) const = 0;
+    // the layer a message from the device selects, -1 if it isn't a bank change
+    virtual int BankChange(const RSJ::MidiMessage& message) const noexcept = 0;
+};
+
+// uploads each profile's presets to the matching controllers, once per content and
+// device, and follows bank changes made on them
+class ControllerPresets {
+public:
+    ControllerPresets() = default;
+    ~ControllerPresets() = default;
+    ControllerPresets(const ControllerPresets&) = delete;
+    ControllerPresets& operator=(const ControllerPresets&) = delete;
+    // first_preset is the device preset (1-based) holding the base layer, later layers
+    // taking the presets after it; 0 turns presets off. Message thread, before the MIDI
+    // devices are started
+    void Init(int first_preset, ProfileManager* const profile_manager,
+        MIDIProcessor* const midi_processor, std::weak_ptr<MIDISender>&& midi_sender);
+
+    void ProfileCallback(const RSJ::CompiledProfile& profile, const juce::String& name);
+    void DeviceCallback(const juce::String& device);
+    void BankCallback(RSJ::MidiMessage message);
+
+private:
+    const PresetDriver* Driver_(const juce::String& device) const;
+    void Upload_(const juce::String& device); //call with mutex_ held
+
+    std::vector<std::unique_ptr<PresetDriver>> drivers_;
+    ProfileManager* profile_manager_{nullptr};
+    MIDIProcessor* midi_processor_{nullptr};
+    std::weak_ptr<MIDISender> midi_sender_;
+    std::mutex mutex_; //profile callbacks and rescans run on different threads
+    std::vector<std::vector<juce::MidiMessage>> frames_; //the profile's, by driver
+    std::vector<juce::uint64> hashes_; //of frames_
+    juce::StringArray outputs_; //outputs a driver matches, seen by rescans
+    std::map<juce::String, juce::uint64> uploaded_; //hash of the frames each output holds
+};
+
+#endif  // CONTROLLERPRESETS_H_INCLUDED
@@ -21,39 +21,161 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 ==============================================================================
 */
 #include "ControlsModel.h"
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <type_traits>
+#include <unordered_set>
 #include "MidiUtilities.h"
 
-double ChannelModel::ControllerToPlugin(short controltype, size_t controlnumber, short value) noexcept(ndebug)
+namespace {
+    // settings.bin: header, one ChannelImage per channel, every channel's ControlImage
+    // records, then all custom curve points. Fixed-width fields in native byte order,
+    // each record a multiple of 4 bytes so a mapped file can be read without copying
+    constexpr char kImageMagic[8]{'M', 'I', 'D', 'I', '2', 'L', 'R', 'S'};
+    constexpr juce::uint32 kImageVersion = 2; //version 1 lacked the deadband
+    struct ImageHeader {
+        char magic[8];
+        juce::uint32 version;
+        juce::uint32 channels;
+        juce::uint32 controls;
+        juce::uint32 points;
+    };
+    struct ImageRange {
+        juce::int16 low;
+        juce::int16 high;
+        juce::int32 method;
+    };
+    struct ChannelImage {
+        ImageRange cc_default;
+        ImageRange nrpn_default;
+        juce::int16 pitch_wheel_max;
+        juce::int16 pitch_wheel_min;
+        juce::uint32 first_control;
+        juce::uint32 control_count;
+    };
+    struct ControlImageV1 {
+        juce::int16 number;
+        juce::int16 low;
+        juce::int16 high;
+        juce::int8 method;
+        juce::int8 curve_type;
+        float amount;
+        juce::uint32 first_point;
+        juce::uint32 point_count;
+    };
+    struct ControlImage: ControlImageV1 {
+        juce::int16 deadband;
+        juce::int8 acceleration; //zero in files written before it was added
+        juce::uint8 touch; //note + 1, likewise zero for none
+    };
+    static_assert(sizeof(ImageHeader) == 24 && sizeof(ChannelImage) == 28 &&
+        sizeof(ControlImageV1) == 20 && sizeof(ControlImage) == 24 && sizeof(float) == 4,
+        "settings.bin layout changed");
+    static_assert(std::is_trivially_copyable<ChannelImage>::value &&
+        std::is_trivially_copyable<ControlImage>::value, "image records must be plain data");
+
+    constexpr auto kMaxMethod = static_cast<juce::int32>(RSJ::CCmethod::signmagnitude);
+    constexpr auto kMaxCurve = static_cast<juce::int8>(RSJ::CurveType::custom);
+    constexpr auto kMaxAcceleration = static_cast<juce::int8>(RSJ::Acceleration::strong);
+}
+
+double RSJ::ResponseCurve::Apply(double x) const noexcept
 {
-    Expects((controltype == RSJ::kCCFlag && ccMethod_[controlnumber] == RSJ::CCmethod::absolute) ? (ccLow_[controlnumber] < ccHigh_[controlnumber]) : 1);
-    Expects((controltype == RSJ::kPWFlag) ? (pitchWheelMax_ > pitchWheelMin_) : 1);
-    Expects((controltype == RSJ::kPWFlag) ? value >= pitchWheelMin_ && value <= pitchWheelMax_ : 1);
+    switch (type) {
+    case CurveType::logarithmic:
+        return amount > 0.0f ? std::log1p(amount * x) / std::log1p(amount) : x;
+    case CurveType::gamma:
+        return amount > 0.0f ? std::pow(x, amount) : x;
+    case CurveType::scurve:
+    {
+        if (amount <= 0.0f)
+            return x;
+        const auto rising = std::pow(x, amount);
+        const auto falling = std::pow(1.0 - x, amount);
+        return rising / (rising + falling);
+    }
+    case CurveType::custom:
+    {
+        auto x0 = 0.0;
+        auto y0 = 0.0;
+        for (size_t i = 0; i + 1 < points.size(); i += 2) {
+            const double x1 = points[i];
+            const double y1 = points[i + 1];
+            if (x <= x1)
+                return (x1 > x0) ? y0 + (y1 - y0) * (x - x0) / (x1 - x0) : y1;
+            x0 = x1;
+            y0 = y1;
+        }
+        return (x0 < 1.0) ? y0 + (1.0 - y0) * (x - x0) / (1.0 - x0) : y0;
+    }
+    default:
+        return x;
+    }
+}
+
+RSJ::ResponseCurve RSJ::ResponseCurve::Normalized() const
+{
+    auto result = *this;
+    if (type != CurveType::custom)
+        return result;
+    const auto unit = [](float v) noexcept {return std::min(std::max(v, 0.0f), 1.0f); };
+    std::vector<std::pair<float, float>> pairs;
+    for (size_t i = 0; i + 1 < points.size(); i += 2)
+        if (std::isfinite(points[i]) && std::isfinite(points[i + 1]))
+            pairs.emplace_back(unit(points[i]), unit(points[i + 1]));
+    std::stable_sort(pairs.begin(), pairs.end(),
+        [](const std::pair<float, float>& a, const std::pair<float, float>& b) noexcept {
+        return a.first < b.first; });
+    result.points.clear();
+    auto y = 0.0f;
+    for (const auto& pair : pairs) {
+        y = std::max(y, pair.second);
+        result.points.push_back(pair.first);
+        result.points.push_back(y);
+    }
+    return result;
+}
+
+bool ChannelModel::Jittered(short controltype, size_t controlnumber, short value,
+    size_t device) noexcept(ndebug)
+{
+    if (controltype != RSJ::kCCFlag)
+        return false;
+    const auto config = Current_();
+    const auto& control = config->Get(controlnumber);
+    if (control.deadband <= 0 || control.method != RSJ::CCmethod::absolute)
+        return false;
+    auto& state = State_(controlnumber, device);
+    const auto accepted = state.accepted.load(std::memory_order_relaxed);
+    if (accepted >= 0 && (value == accepted || (std::abs(value - accepted) <= control.deadband &&
+        value != control.low && value != control.high)))
+        return true;
+    state.accepted.store(value, std::memory_order_relaxed);
+    return false;
+}
+
+double ChannelModel::ControllerToPlugin(short controltype, size_t controlnumber, short value,
+    size_t device) noexcept(ndebug)
+{
+    const auto held = Current_();
+    const auto& config = *held;
+    Expects((controltype == RSJ::kCCFlag && config.Get(controlnumber).method == RSJ::CCmethod::absolute) ? (config.Get(controlnumber).low < config.Get(controlnumber).high) : 1);
+    Expects((controltype == RSJ::kPWFlag) ? (config.pitch_wheel_max > config.pitch_wheel_min) : 1);
+    Expects((controltype == RSJ::kPWFlag) ? value >= config.pitch_wheel_min && value <= config.pitch_wheel_max : 1);
     //note that the value is not msb,lsb, but rather the calculated value. Since lsb is only 7 bits, high bits are shifted one right when placed into short.
     switch (controltype) {
     case RSJ::kPWFlag:
-        return static_cast<double>(value - pitchWheelMin_) / static_cast<double>(pitchWheelMax_ - pitchWheelMin_);
+        return static_cast<double>(value - config.pitch_wheel_min) /
+            static_cast<double>(config.pitch_wheel_max - config.pitch_wheel_min);
     case RSJ::kCCFlag:
-        switch (ccMethod_[controlnumber]) {
-        case RSJ::CCmethod::absolute:
-            return static_cast<double>(value - ccLow_[controlnumber]) / static_cast<double>(ccHigh_[controlnumber] - ccLow_[controlnumber]);
-        case RSJ::CCmethod::binaryoffset:
-            if (IsNRPN_(controlnumber))
-                return OffsetResult_(value - kBit14, controlnumber);
-            return OffsetResult_(value - kBit7, controlnumber);
-        case RSJ::CCmethod::signmagnitude:
-            if (IsNRPN_(controlnumber))
-                return OffsetResult_((value & kBit14) ? -(value & kLow13Bits) : value, controlnumber);
-            return OffsetResult_((value & kBit7) ? -(value & kLow6Bits) : value, controlnumber);
-        case RSJ::CCmethod::twoscomplement: //see https://en.wikipedia.org/wiki/Signed_number_representations#Two.27s_complement
-            if (IsNRPN_(controlnumber)) //flip twos comp and subtract--independent of processor architecture
-                return OffsetResult_((value & kBit14) ? -((value ^ kMaxNRPN) + 1) : value, controlnumber);
-            return OffsetResult_((value & kBit7) ? -((value ^ kMaxMIDI) + 1) : value, controlnumber);
-        default:
-            Expects(!"Should be unreachable code in ControllerToPlugin--unknown CCmethod");
-            return 0.0;
-        }
+    {
+        const auto& control = config.Get(controlnumber);
+        return control.convert(*this, control, controlnumber, value, device);
+    }
     case RSJ::kNoteOnFlag:
-        return static_cast<double>(value) / static_cast<double>((IsNRPN_(controlnumber) ? kMaxNRPN : kMaxMIDI));
+        return static_cast<double>(value) / static_cast<double>((config.Is14bit(controlnumber) ? kMaxNRPN : kMaxMIDI));
     case RSJ::kNoteOffFlag:
         return 0.0;
     default:
@@ -62,21 +184,101 @@ double ChannelModel::ControllerToPlugin(short controltype, size_t controlnumber,
     }
 }
 
-short ChannelModel::PluginToController(short controltype, size_t controlnumber, double pluginV) noexcept(ndebug)
+double ChannelModel::Absolute_(ChannelModel& /*model*/, const ControlConfig& control,
+    size_t /*controlnumber*/, short value, size_t /*device*/)
+{
+    return (value - control.low) * control.scale;
+}
+
+double ChannelModel::Curved_(ChannelModel& /*model*/, const ControlConfig& control,
+    size_t /*controlnumber*/, short value, size_t /*device*/)
+{
+    const auto& values = control.curve->values;
+    const auto last = static_cast<int>(values.size()) - 1;
+    return values[static_cast<size_t>(std::min(std::max(value - control.low, 0), last))];
+}
+
+template<RSJ::CCmethod Method, bool Wide>
+double ChannelModel::Relative_(ChannelModel& model, const ControlConfig& control,
+    size_t controlnumber, short value, size_t device)
+{
+    //Method and Wide are constants here, so each instance keeps one line of this
+    constexpr short sign = Wide ? kBit14 : kBit7;
+    constexpr short magnitude = Wide ? kLow13Bits : kLow6Bits;
+    constexpr short all = Wide ? kMaxNRPN : kMaxMIDI;
+    short diff;
+    switch (Method) {
+    case RSJ::CCmethod::binaryoffset:
+        diff = value - sign;
+        break;
+    case RSJ::CCmethod::signmagnitude:
+        diff = (value & sign) ? -(value & magnitude) : value;
+        break;
+    default: //twoscomplement, see https://en.wikipedia.org/wiki/Signed_number_representations#Two.27s_complement
+        //flip twos comp and subtract--independent of processor architecture
+        diff = (value & sign) ? -((value ^ all) + 1) : value;
+    }
+    return model.OffsetResult_(diff, control, model.State_(controlnumber, device));
+}
+
+ChannelModel::Converter ChannelModel::Converter_(const ControlConfig& control, bool wide) noexcept
+{
+    switch (control.method) {
+    case RSJ::CCmethod::binaryoffset:
+        return wide ? &Relative_<RSJ::CCmethod::binaryoffset, true> :
+            &Relative_<RSJ::CCmethod::binaryoffset, false>;
+    case RSJ::CCmethod::signmagnitude:
+        return wide ? &Relative_<RSJ::CCmethod::signmagnitude, true> :
+            &Relative_<RSJ::CCmethod::signmagnitude, false>;
+    case RSJ::CCmethod::twoscomplement:
+        return wide ? &Relative_<RSJ::CCmethod::twoscomplement, true> :
+            &Relative_<RSJ::CCmethod::twoscomplement, false>;
+    default:
+        return (control.curve && !control.curve->values.empty()) ? &Curved_ : &Absolute_;
+    }
+}
+
+void ChannelModel::Bind_(Config& config) noexcept
+{
+    for (size_t a = 0; a <= kMaxMIDI; ++a)
+        config.cc[a].convert = Converter_(config.cc[a], config.Is14bit(a));
+    config.cc_default.convert = Converter_(config.cc_default, false);
+    config.nrpn_default.convert = Converter_(config.nrpn_default, true);
+    for (auto& entry : config.nrpn)
+        entry.second.convert = Converter_(entry.second, true);
+    config.touched.fill(0);
+    for (size_t a = 0; a <= kMaxMIDI; ++a)
+        if (config.cc[a].touch >= 0)
+            config.touched[static_cast<size_t>(config.cc[a].touch)] = static_cast<juce::uint8>(a + 1);
+}
+
+short ChannelModel::PluginToController(short controltype, size_t controlnumber, double pluginV,
+    size_t device) noexcept(ndebug)
 {
     Expects(controlnumber <= kMaxNRPN);
     Expects(pluginV >= 0.0 && pluginV <= 1.0);
+    const auto held = Current_();
+    const auto& config = *held;
     switch (controltype) {
     case RSJ::kPWFlag:
-        return static_cast<short>(round(pluginV * (pitchWheelMax_ - pitchWheelMin_))) + pitchWheelMin_;
+        pw_state_[device].mirror.store(static_cast<float>(pluginV), std::memory_order_relaxed);
+        return static_cast<short>(round(pluginV * (config.pitch_wheel_max - config.pitch_wheel_min))) +
+            config.pitch_wheel_min;
     case RSJ::kCCFlag:
     {
-        if (ccMethod_[controlnumber] == RSJ::CCmethod::absolute)
-            return static_cast<short>(round(pluginV *
-            (ccHigh_[controlnumber] - ccLow_[controlnumber]))) + ccLow_[controlnumber];
-        const auto cv = static_cast<short>(round(pluginV * ccHigh_[controlnumber])); //ccLow == 0 for non-absolute
-        if (RSJ::now_ms() - kUpdateDelay > lastUpdate_.load(std::memory_order_acquire))
-            currentV_[controlnumber].store(cv, std::memory_order_release);
+        const auto& control = config.Get(controlnumber);
+        if (control.method == RSJ::CCmethod::absolute) {
+            State_(controlnumber, device).mirror.store(static_cast<float>(pluginV), std::memory_order_relaxed);
+            if (control.curve && !control.curve->values.empty())
+                return CurveToController_(control, *control.curve, pluginV);
+            return static_cast<short>(pluginV * (control.high - control.low) + 0.5) + control.low;
+        }
+        const auto cv = static_cast<short>(pluginV * control.high + 0.5); //ccLow == 0 for non-absolute
+        auto& state = State_(controlnumber, device);
+        // sending deltas, the position only matters for local echo, so it follows at once
+        if (deltas_.load(std::memory_order_relaxed) ||
+            RSJ::now_ms() - kUpdateDelay > state.last_update.load(std::memory_order_acquire))
+            state.current.store(cv, std::memory_order_release);
         return cv;
     }
     case RSJ::kNoteOnFlag:
@@ -87,113 +289,711 @@ short ChannelModel::PluginToController(short controltype, size_t controlnumber,
     return 0;
 }
 
-void ChannelModel::setCC(size_t controlnumber, short min, short max, RSJ::CCmethod controltype) noexcept(ndebug)
+bool ChannelModel::PickedUp(short controltype, size_t controlnumber, double value,
+    size_t device) noexcept(ndebug)
 {
-    setCCmethod(controlnumber, controltype); //has to be set before others or ranges won't be correct
-    setCCmin(controlnumber, min);
-    setCCmax(controlnumber, max);
+    ControlState* state{nullptr};
+    if (controltype == RSJ::kPWFlag)
+        state = &pw_state_[device];
+    else if (controltype == RSJ::kCCFlag &&
+        Current_()->Get(controlnumber).method == RSJ::CCmethod::absolute)
+        state = &State_(controlnumber, device);
+    else
+        return true;
+    const auto now = RSJ::now_ms();
+    const auto mirror = state->mirror.load(std::memory_order_relaxed);
+    //a control that just took over keeps it, as Lightroom's feedback lags fast moves
+    if (mirror >= 0.0f && std::abs(value - mirror) > kPickupThreshold &&
+        now - state->picked.load(std::memory_order_relaxed) > kPickupHold)
+        return false;
+    state->picked.store(now, std::memory_order_relaxed);
+    state->mirror.store(static_cast<float>(value), std::memory_order_relaxed);
+    return true;
 }
 
-void ChannelModel::setCCall(size_t controlnumber, short min, short max, RSJ::CCmethod controltype) noexcept(ndebug)
+ChannelModel::ControlConfig& ChannelModel::Config::Edit(size_t controlnumber)
 {
-    if (IsNRPN_(controlnumber))
-        for (short a = kMaxMIDI + 1; a <= kMaxNRPN; ++a)
-            setCC(a, min, max, controltype);
+    Expects(controlnumber <= kMaxNRPN);
+    if (!IsNRPN_(controlnumber))
+        return cc[controlnumber];
+    const auto number = static_cast<short>(controlnumber);
+    auto found = std::lower_bound(nrpn.begin(), nrpn.end(), number,
+        [](const std::pair<short, ControlConfig>& a, short b) noexcept {return a.first < b; });
+    if (found == nrpn.end() || found->first != number)
+        found = nrpn.emplace(found, number, nrpn_default);
+    return found->second;
+}
+
+std::unique_ptr<ChannelModel::Config> ChannelModel::Copy_() const
+{
+    return std::make_unique<Config>(*Current_());
+}
+
+void ChannelModel::Publish_(std::unique_ptr<Config> next)
+{
+    Bind_(*next); //every edit publishes, so converters always match what they convert
+    //the MIDI thread may still be converting with the old snapshot, so it is retired
+    config_.Publish(std::shared_ptr<const Config>(std::move(next)));
+    changes_.fetch_add(1, std::memory_order_release);
+}
+
+ChannelModel::ControlState* ChannelModel::FindOrAddState_(size_t controlnumber, size_t device) noexcept
+{
+    const auto number = static_cast<int>(device * kMaxControls + controlnumber);
+    auto table = nrpn_.load(std::memory_order_acquire);
+    if (!table) {
+        const auto fresh = new(std::nothrow) NrpnTable;
+        if (!fresh)
+            return nullptr;
+        if (nrpn_.compare_exchange_strong(table, fresh, std::memory_order_acq_rel,
+            std::memory_order_acquire))
+            table = fresh;
+        else
+            delete fresh; //another thread got there first
+    }
+    const auto start = (static_cast<juce::uint32>(number) * 0x9E3779B1u) >> (32 - kNrpnBits);
+    for (size_t i = 0; i < kNrpnCapacity; ++i) {
+        auto& entry = (*table)[(start + i) & (kNrpnCapacity - 1)];
+        auto key = entry.number.load(std::memory_order_acquire);
+        if (key == kNrpnEmpty && entry.number.compare_exchange_strong(key, number,
+            std::memory_order_acq_rel, std::memory_order_acquire)) {
+            const auto config = Current_();
+            const auto& control = config->Get(controlnumber);
+            entry.state.last_update.store(0, std::memory_order_relaxed);
+            entry.state.current.store((control.high - control.low) / 2, std::memory_order_relaxed);
+            entry.state.mirror.store(-1.0f, std::memory_order_relaxed);
+            entry.state.picked.store(0, std::memory_order_relaxed);
+            entry.state.accepted.store(-1, std::memory_order_relaxed);
+            entry.ready.store(true, std::memory_order_release);
+            return &entry.state;
+        }
+        if (key == number) { //possibly still being filled in by another thread
+            while (!entry.ready.load(std::memory_order_acquire))
+                CPU_RELAX;
+            return &entry.state;
+        }
+    }
+    return nullptr;
+}
+
+void ChannelModel::ResetState_(size_t controlnumber, const ControlConfig& control) noexcept(ndebug)
+{
+    const auto half = static_cast<short>((control.high - control.low) / 2);
+    if (!IsNRPN_(controlnumber)) {
+        for (auto& device : cc_state_)
+            device[controlnumber].current.store(half, std::memory_order_release);
+        return;
+    }
+    State_(controlnumber).current.store(half, std::memory_order_release);
+    // other devices' positions for this number, only where they already exist
+    if (const auto table = nrpn_.load(std::memory_order_acquire))
+        for (auto& entry : *table)
+            if (entry.ready.load(std::memory_order_acquire) &&
+                static_cast<size_t>(entry.number.load(std::memory_order_relaxed)) % kMaxControls == controlnumber)
+                entry.state.current.store(half, std::memory_order_release);
+}
+
+void ChannelModel::SetCC_(ControlConfig& control, short min, short max, RSJ::CCmethod controltype,
+    short limit)
+{
+    control.method = controltype; //has to be set before others or ranges won't be correct
+    SetCCmin_(control, min);
+    SetCCmax_(control, max, limit);
+    Rerange_(control);
+}
+
+void ChannelModel::SetCCmax_(ControlConfig& control, short value, short limit) noexcept(ndebug)
+{
+    Expects(value <= kMaxNRPN);
+    Expects(value >= 0);
+    if (control.method != RSJ::CCmethod::absolute)
+        control.high = (value < 0) ? 1000 : value;
     else
-        for (short a = 0; a <= kMaxMIDI; ++a)
-            setCC(a, min, max, controltype);
+        control.high = (value <= control.low || value > limit) ? limit : value;
 }
 
-void ChannelModel::setCCmax(size_t controlnumber, short value) noexcept(ndebug)
+void ChannelModel::SetCCmin_(ControlConfig& control, short value) noexcept(ndebug)
 {
-    Expects(controlnumber <= kMaxNRPN);
     Expects(value <= kMaxNRPN);
     Expects(value >= 0);
-    if (ccMethod_[controlnumber] != RSJ::CCmethod::absolute)
-        ccHigh_[controlnumber] = (value < 0) ? 1000 : value;
+    if (control.method != RSJ::CCmethod::absolute)
+        control.low = 0;
+    else
+        control.low = (value < 0 || value >= control.high) ? 0 : value;
+}
+
+void ChannelModel::Rerange_(ControlConfig& control)
+{
+    control.scale = (control.high > control.low) ? 1.0 / (control.high - control.low) : 0.0;
+    if (!control.curve)
+        return;
+    //compile the curve so the MIDI thread only does a lookup
+    auto table = std::make_shared<CurveTable>();
+    table->definition = control.curve->definition;
+    if (control.method == RSJ::CCmethod::absolute && control.high > control.low) {
+        const auto range = control.high - control.low;
+        table->values.resize(static_cast<size_t>(range) + 1);
+        for (auto i = 0; i <= range; ++i)
+            table->values[static_cast<size_t>(i)] =
+            std::min(std::max(table->definition.Apply(static_cast<double>(i) / range), 0.0), 1.0);
+    }
+    control.curve = std::move(table);
+}
+
+void ChannelModel::CompactNrpn_(Config& config)
+{
+    //drop NRPN entries that no longer differ from the shared default
+    const auto& d = config.nrpn_default;
+    config.nrpn.erase(std::remove_if(config.nrpn.begin(), config.nrpn.end(),
+        [&d](const std::pair<short, ControlConfig>& e) noexcept {
+        return !e.second.curve && e.second.method == d.method && e.second.low == d.low &&
+            e.second.high == d.high && e.second.deadband == d.deadband &&
+            e.second.acceleration == d.acceleration && e.second.touch == d.touch; }),
+        config.nrpn.end());
+}
+
+short ChannelModel::CurveToController_(const ControlConfig& control, const CurveTable& table,
+    double value) noexcept
+{
+    //feedback: nearest table entry, assuming the curve does not fall
+    const auto& values = table.values;
+    auto found = std::lower_bound(values.begin(), values.end(), value);
+    if (found == values.end())
+        --found;
+    else if (found != values.begin() && value - *(found - 1) < *found - value)
+        --found;
+    return static_cast<short>((found - values.begin()) + control.low);
+}
+
+void ChannelModel::setCC(size_t controlnumber, short min, short max, RSJ::CCmethod controltype)
+{
+    auto next = Copy_();
+    auto& control = next->Edit(controlnumber);
+    SetCC_(control, min, max, controltype, next->Is14bit(controlnumber) ? kMaxNRPN : kMaxMIDI);
+    const auto updated = control;
+    if (IsNRPN_(controlnumber))
+        CompactNrpn_(*next);
+    Publish_(std::move(next));
+    ResetState_(controlnumber, updated);
+}
+
+void ChannelModel::setCCall(size_t controlnumber, short min, short max, RSJ::CCmethod controltype)
+{
+    //one publish for the whole group
+    auto next = Copy_();
+    if (IsNRPN_(controlnumber)) {
+        SetCC_(next->nrpn_default, min, max, controltype, kMaxNRPN);
+        for (auto& entry : next->nrpn)
+            SetCC_(entry.second, min, max, controltype, kMaxNRPN);
+        CompactNrpn_(*next);
+        Publish_(std::move(next));
+        const auto config = Current_();
+        const auto half = static_cast<short>((config->nrpn_default.high - config->nrpn_default.low) / 2);
+        nrpn_state_.current.store(half, std::memory_order_release);
+        if (const auto table = nrpn_.load(std::memory_order_acquire))
+            for (auto& entry : *table)
+                if (entry.ready.load(std::memory_order_acquire))
+                    entry.state.current.store(half, std::memory_order_release);
+    }
     else {
-        const auto max = (IsNRPN_(controlnumber) ? kMaxNRPN : kMaxMIDI);
-        ccHigh_[controlnumber] = (value <= ccLow_[controlnumber] || value > max) ? max : value;
+        SetCC_(next->cc_default, min, max, controltype, kMaxMIDI);
+        for (size_t a = 0; a <= kMaxMIDI; ++a)
+            SetCC_(next->cc[a], min, max, controltype, next->Is14bit(a) ? kMaxNRPN : kMaxMIDI);
+        Publish_(std::move(next));
+        const auto config = Current_();
+        for (size_t a = 0; a <= kMaxMIDI; ++a)
+            ResetState_(a, config->cc[a]);
     }
-    currentV_[controlnumber].store((ccHigh_[controlnumber] - ccLow_[controlnumber]) / 2, std::memory_order_release);
 }
 
-void ChannelModel::setCCmethod(size_t controlnumber, RSJ::CCmethod value) noexcept(ndebug)
+void ChannelModel::setCCmax(size_t controlnumber, short value)
 {
-    Expects(controlnumber <= kMaxNRPN);
-    ccMethod_[controlnumber] = value;
+    auto next = Copy_();
+    auto& control = next->Edit(controlnumber);
+    SetCCmax_(control, value, next->Is14bit(controlnumber) ? kMaxNRPN : kMaxMIDI);
+    Rerange_(control);
+    const auto updated = control;
+    if (IsNRPN_(controlnumber))
+        CompactNrpn_(*next);
+    Publish_(std::move(next));
+    ResetState_(controlnumber, updated);
 }
 
-void ChannelModel::setCCmin(size_t controlnumber, short value) noexcept(ndebug)
+void ChannelModel::setCCmethod(size_t controlnumber, RSJ::CCmethod value)
 {
-    Expects(controlnumber <= kMaxNRPN);
-    Expects(value <= kMaxNRPN);
-    Expects(value >= 0);
-    if (ccMethod_[controlnumber] != RSJ::CCmethod::absolute)
-        ccLow_[controlnumber] = 0;
+    auto next = Copy_();
+    auto& control = next->Edit(controlnumber);
+    control.method = value;
+    Rerange_(control);
+    if (IsNRPN_(controlnumber))
+        CompactNrpn_(*next);
+    Publish_(std::move(next));
+}
+
+void ChannelModel::setCCmin(size_t controlnumber, short value)
+{
+    auto next = Copy_();
+    auto& control = next->Edit(controlnumber);
+    SetCCmin_(control, value);
+    Rerange_(control);
+    const auto updated = control;
+    if (IsNRPN_(controlnumber))
+        CompactNrpn_(*next);
+    Publish_(std::move(next));
+    ResetState_(controlnumber, updated);
+}
+
+void ChannelModel::setCC14bit(size_t controlnumber, bool enabled)
+{
+    Expects(controlnumber < kCC14Controls);
+    auto next = Copy_();
+    if (enabled)
+        next->cc14 |= 1u << controlnumber;
     else
-        ccLow_[controlnumber] = (value < 0 || value >= ccHigh_[controlnumber]) ? 0 : value;
-    currentV_[controlnumber].store((ccHigh_[controlnumber] - ccLow_[controlnumber]) / 2, std::memory_order_release);
+        next->cc14 &= ~(1u << controlnumber);
+    auto& control = next->cc[controlnumber];
+    if (control.method == RSJ::CCmethod::absolute) {
+        control.low = 0;
+        control.high = enabled ? kMaxNRPN : kMaxMIDI;
+    }
+    Rerange_(control);
+    const auto updated = control;
+    Publish_(std::move(next));
+    ResetState_(controlnumber, updated);
 }
 
-void ChannelModel::setPWmax(short value) noexcept(ndebug)
+void ChannelModel::setPWmax(short value)
 {
     Expects(value <= kMaxNRPN);
     Expects(value >= 0);
-    if (value > kMaxNRPN || value <= pitchWheelMin_)
-        pitchWheelMax_ = kMaxNRPN;
+    auto next = Copy_();
+    if (value > kMaxNRPN || value <= next->pitch_wheel_min)
+        next->pitch_wheel_max = kMaxNRPN;
     else
-        pitchWheelMax_ = value;
+        next->pitch_wheel_max = value;
+    Publish_(std::move(next));
 }
 
-void ChannelModel::setPWmin(short value) noexcept(ndebug)
+void ChannelModel::setPWmin(short value)
 {
     Expects(value <= kMaxNRPN);
     Expects(value >= 0);
-    if (value < 0 || value >= pitchWheelMax_)
-        pitchWheelMin_ = 0;
+    auto next = Copy_();
+    if (value < 0 || value >= next->pitch_wheel_max)
+        next->pitch_wheel_min = 0;
     else
-        pitchWheelMin_ = value;
+        next->pitch_wheel_min = value;
+    Publish_(std::move(next));
 }
 
-void ChannelModel::activeToSaved()  const
+void ChannelModel::setCurve(size_t controlnumber, const RSJ::ResponseCurve& curve)
+{
+    auto next = Copy_();
+    auto& control = next->Edit(controlnumber);
+    auto checked = curve.Normalized();
+    if (checked.IsLinear())
+        control.curve.reset();
+    else {
+        auto table = std::make_shared<CurveTable>();
+        table->definition = std::move(checked);
+        control.curve = std::move(table);
+    }
+    Rerange_(control);
+    if (IsNRPN_(controlnumber))
+        CompactNrpn_(*next);
+    Publish_(std::move(next));
+}
+
+RSJ::ResponseCurve ChannelModel::getCurve(size_t controlnumber) const
+{
+    const auto config = Current_();
+    const auto& curve = config->Get(controlnumber).curve;
+    return curve ? curve->definition : RSJ::ResponseCurve{};
+}
+
+void ChannelModel::setCCdeadband(size_t controlnumber, short value)
+{
+    auto next = Copy_();
+    auto& control = next->Edit(controlnumber);
+    control.deadband = (value < 0) ? short{0} : (value > kMaxMIDIHalf) ? kMaxMIDIHalf : value;
+    if (IsNRPN_(controlnumber))
+        CompactNrpn_(*next);
+    Publish_(std::move(next));
+}
+
+void ChannelModel::setCCacceleration(size_t controlnumber, RSJ::Acceleration value)
+{
+    auto next = Copy_();
+    next->Edit(controlnumber).acceleration = value;
+    if (IsNRPN_(controlnumber))
+        CompactNrpn_(*next);
+    Publish_(std::move(next));
+}
+
+void ChannelModel::setCCtouch(size_t controlnumber, short note)
 {
-    settingsToSave_.clear();
-    for (short i = 0; i <= kMaxMIDI; ++i)
-        if (ccMethod_[i] != RSJ::CCmethod::absolute || ccHigh_[i] != kMaxMIDI || ccLow_[i] != 0)
-            settingsToSave_.emplace_back(i, ccLow_[i], ccHigh_[i], ccMethod_[i]);
-    for (short i = kMaxMIDI + 1; i <= kMaxNRPN; ++i)
-        if (ccMethod_[i] != RSJ::CCmethod::absolute || ccHigh_[i] != kMaxNRPN || ccLow_[i] != 0)
-            settingsToSave_.emplace_back(i, ccLow_[i], ccHigh_[i], ccMethod_[i]);
+    //only CC 0-127 have feedback to hold, and a note senses one fader
+    if (IsNRPN_(controlnumber))
+        return;
+    auto next = Copy_();
+    if (note < 0 || note > kMaxMIDI)
+        note = -1;
+    else
+        for (auto& control : next->cc)
+            if (control.touch == note)
+                control.touch = -1;
+    next->Edit(controlnumber).touch = note;
+    Publish_(std::move(next));
 }
 
-void ChannelModel::savedToActive() noexcept(ndebug)
+std::vector<RSJ::SettingsStruct> ChannelModel::Differing_(const Config& config)
 {
-    //program defaults
-    ccLow_.fill(0);
-    ccHigh_.fill(0x3FFF);//XCode throws linker error when use ChannelModel::kMaxNRPN here
-    ccMethod_.fill(RSJ::CCmethod::absolute);
-    for (auto &v : currentV_) //can't use fill as copy/assign deleted for atomic
-        v.store(kMaxNRPNHalf, std::memory_order_relaxed);
-    for (size_t a = 0; a <= kMaxMIDI; ++a) {
-        ccHigh_[a] = kMaxMIDI;
-        currentV_[a].store(kMaxMIDIHalf, std::memory_order_relaxed);
+    std::vector<RSJ::SettingsStruct> settings;
+    const auto& d = config.cc_default;
+    for (short i = 0; i <= kMaxMIDI; ++i) {
+        const auto& control = config.cc[static_cast<size_t>(i)];
+        if (control.method != d.method || control.high != d.high || control.low != d.low ||
+            control.curve || control.deadband != d.deadband ||
+            control.acceleration != d.acceleration || control.touch != d.touch)
+            settings.emplace_back(i, control.low, control.high, control.method,
+                control.curve ? control.curve->definition : RSJ::ResponseCurve{}, control.deadband,
+                control.acceleration, control.touch);
     }
-    for (const auto set : settingsToSave_)
-        setCC(set.number, set.low, set.high, set.method);
+    //NRPN controls matching nrpn_default aren't in the list; it is archived separately
+    for (const auto& entry : config.nrpn) {
+        const auto& control = entry.second;
+        settings.emplace_back(entry.first, control.low, control.high, control.method,
+            control.curve ? control.curve->definition : RSJ::ResponseCurve{}, control.deadband,
+            control.acceleration, control.touch);
+    }
+    return settings;
 }
 
-ChannelModel::ChannelModel()
+void ChannelModel::activeToSaved()  const
 {
-    //program defaults
-    ccLow_.fill(0);
-    ccHigh_.fill(0x3FFF);//XCode throws linker error when use ChannelModel::kMaxNRPN here
-    ccMethod_.fill(RSJ::CCmethod::absolute);
-    for (auto &v : currentV_) //can't use fill as copy/assign deleted for atomic
-        v.store(kMaxNRPNHalf, std::memory_order_relaxed);
-    for (size_t a = 0; a <= kMaxMIDI; ++a) {
-        ccHigh_[a] = kMaxMIDI;
-        currentV_[a].store(kMaxMIDIHalf, std::memory_order_relaxed);
+    //unchanged channels reuse the list from the last save
+    const auto changes = changes_.load(std::memory_order_acquire);
+    if (changes == saved_changes_ && changes)
+        return;
+    saved_changes_ = changes;
+    settingsToSave_ = Differing_(*Current_());
+}
+
+std::vector<RSJ::SettingsStruct> ChannelModel::getSettings() const
+{
+    return Differing_(*Current_());
+}
+
+void ChannelModel::setSettings(const std::vector<RSJ::SettingsStruct>& settings)
+{
+    const auto held = Current_();
+    const auto& current = *held;
+    const auto previous = Differing_(current);
+    if (previous.empty() && settings.empty())
+        return; //nothing to undo or apply
+    Publish_(Build_(current, current.cc14, settings));
+    //only the controls that were or now are configured restart their relative position
+    const auto published = Current_();
+    const auto& next = *published;
+    for (const auto& set : previous)
+        ResetState_(static_cast<size_t>(set.number), next.Get(static_cast<size_t>(set.number)));
+    for (const auto& set : settings)
+        ResetState_(static_cast<size_t>(set.number), next.Get(static_cast<size_t>(set.number)));
+}
+
+void ChannelModel::ResetStates_() noexcept
+{
+    const auto held = Current_();
+    const auto& config = *held;
+    for (auto& device : cc_state_)
+        for (size_t a = 0; a <= kMaxMIDI; ++a) {
+            device[a].last_update.store(0, std::memory_order_relaxed);
+            device[a].current.store((config.cc[a].high - config.cc[a].low) / 2, std::memory_order_relaxed);
+            device[a].mirror.store(-1.0f, std::memory_order_relaxed); //ranges may have changed
+            device[a].accepted.store(-1, std::memory_order_relaxed);
+        }
+    for (auto& device : pw_state_)
+        device.mirror.store(-1.0f, std::memory_order_relaxed);
+    delete nrpn_.exchange(nullptr, std::memory_order_acq_rel); //only while no other thread uses the model
+    nrpn_state_.current.store((config.nrpn_default.high - config.nrpn_default.low) / 2,
+        std::memory_order_relaxed);
+}
+
+void ChannelModel::savedToActive(const Config& defaults)
+{
+    //build the whole configuration before publishing it once. 14-bit pairs are kept
+    Publish_(Build_(defaults, Current_()->cc14, settingsToSave_));
+    ResetStates_();
+}
+
+std::unique_ptr<ChannelModel::Config> ChannelModel::Build_(const Config& defaults,
+    juce::uint32 cc14, const std::vector<RSJ::SettingsStruct>& settings)
+{
+    auto next = std::make_unique<Config>();
+    next->cc14 = cc14;
+    const auto& cc = defaults.cc_default;
+    SetCC_(next->cc_default, cc.low, cc.high, cc.method, kMaxMIDI);
+    for (size_t a = 0; a <= kMaxMIDI; ++a)
+        if (next->Is14bit(a)) {
+            next->cc[a].high = kMaxNRPN;
+            Rerange_(next->cc[a]);
+        }
+        else
+            SetCC_(next->cc[a], cc.low, cc.high, cc.method, kMaxMIDI);
+    const auto& nrpn = defaults.nrpn_default;
+    SetCC_(next->nrpn_default, nrpn.low, nrpn.high, nrpn.method, kMaxNRPN);
+    next->pitch_wheel_max = defaults.pitch_wheel_max;
+    next->pitch_wheel_min = defaults.pitch_wheel_min;
+    for (const auto& set : settings) {
+        const auto number = static_cast<size_t>(set.number);
+        auto& control = next->Edit(number);
+        auto checked = set.curve.Normalized(); //profiles may be edited by hand
+        if (!checked.IsLinear()) {
+            auto table = std::make_shared<CurveTable>();
+            table->definition = std::move(checked);
+            control.curve = std::move(table);
+        }
+        control.deadband = set.deadband;
+        control.acceleration = set.acceleration;
+        control.touch = !IsNRPN_(number) && set.touch <= kMaxMIDI ? set.touch : short{-1};
+        SetCC_(control, set.low, set.high, set.method, next->Is14bit(number) ? kMaxNRPN : kMaxMIDI);
     }
+    CompactNrpn_(*next);
+    return next;
+}
+
+const ChannelModel::Config& ChannelModel::DefaultConfig_()
+{
+    static const Config kDefault{};
+    return kDefault;
+}
+
+ChannelModel::ChannelModel():
+    //defaults are shared until a channel is configured; accumulators are made on first use
+    config_{std::shared_ptr<const Config>(&DefaultConfig_(), [](const Config*) noexcept {})}
+{
     //load settings
+}
+
+ChannelModel::~ChannelModel()
+{
+    delete nrpn_.load(std::memory_order_acquire);
+}
+
+size_t ChannelModel::MemoryUse_() const
+{
+    std::unordered_set<const CurveTable*> curves; //controls and configs share tables
+    size_t bytes = 0;
+    const auto add_config = [&bytes, &curves](const Config& config) {
+        bytes += sizeof(Config) + RSJ::HeapBytes(config.nrpn);
+        const auto add_curve = [&bytes, &curves](const ControlConfig& control) {
+            if (control.curve && curves.insert(control.curve.get()).second)
+                bytes += sizeof(CurveTable) + RSJ::HeapBytes(control.curve->values) +
+                RSJ::HeapBytes(control.curve->definition.points);
+        };
+        for (const auto& control : config.cc)
+            add_curve(control);
+        for (const auto& control : config.nrpn)
+            add_curve(control.second);
+    };
+    const auto config = Current_();
+    if (config.get() != &DefaultConfig_()) //not counted, it's shared
+        add_config(*config);
+    if (nrpn_.load(std::memory_order_acquire))
+        bytes += sizeof(NrpnTable);
+    std::lock_guard<decltype(save_mutex_)> lock(save_mutex_);
+    return bytes + RSJ::HeapBytes(settingsToSave_);
+}
+
+std::vector<std::pair<size_t, RSJ::SettingsStruct>> ControlsModel::getSettings() const
+{
+    std::vector<std::pair<size_t, RSJ::SettingsStruct>> settings;
+    for (size_t channel = 0; channel < allControls_.size(); ++channel)
+        for (auto& set : allControls_[channel].getSettings())
+            settings.emplace_back(channel, std::move(set));
+    return settings;
+}
+
+void ControlsModel::setSettings(const std::vector<std::pair<size_t, RSJ::SettingsStruct>>& settings)
+{
+    std::array<std::vector<RSJ::SettingsStruct>, 16> by_channel;
+    for (const auto& set : settings)
+        if (set.first < by_channel.size())
+            by_channel[set.first].push_back(set.second);
+    for (size_t channel = 0; channel < allControls_.size(); ++channel)
+        allControls_[channel].setSettings(by_channel[channel]);
+}
+
+size_t ControlsModel::MemoryUse_() const
+{
+    auto bytes = sizeof(ControlsModel);
+    for (const auto& channel : allControls_)
+        bytes += channel.MemoryUse_();
+    return bytes;
+}
+
+juce::MemoryBlock ControlsModel::getImage() const
+{
+    std::vector<ChannelImage> channels;
+    std::vector<ControlImage> controls;
+    std::vector<float> points;
+    for (const auto& channel : allControls_) {
+        std::vector<RSJ::SettingsStruct> settings;
+        {//unchanged channels reuse the list from the last save
+            std::lock_guard<std::mutex> lock(channel.save_mutex_);
+            channel.activeToSaved();
+            settings = channel.settingsToSave_;
+        }
+        const auto held = channel.Current_();
+        const auto& config = *held;
+        const auto& cc = config.cc_default;
+        const auto& nrpn = config.nrpn_default;
+        channels.push_back({{cc.low, cc.high, static_cast<juce::int32>(cc.method)},
+            {nrpn.low, nrpn.high, static_cast<juce::int32>(nrpn.method)},
+            config.pitch_wheel_max, config.pitch_wheel_min,
+            static_cast<juce::uint32>(controls.size()), static_cast<juce::uint32>(settings.size())});
+        for (const auto& set : settings) {
+            ControlImage control{};
+            static_cast<ControlImageV1&>(control) = {set.number, set.low, set.high,
+                static_cast<juce::int8>(set.method), static_cast<juce::int8>(set.curve.type),
+                set.curve.amount, static_cast<juce::uint32>(points.size()),
+                static_cast<juce::uint32>(set.curve.points.size())};
+            control.deadband = set.deadband;
+            control.acceleration = static_cast<juce::int8>(set.acceleration);
+            control.touch = static_cast<juce::uint8>(set.touch + 1);
+            controls.push_back(control);
+            points.insert(points.end(), set.curve.points.begin(), set.curve.points.end());
+        }
+    }
+    ImageHeader header{{}, kImageVersion, static_cast<juce::uint32>(channels.size()),
+        static_cast<juce::uint32>(controls.size()), static_cast<juce::uint32>(points.size())};
+    std::memcpy(header.magic, kImageMagic, sizeof(kImageMagic));
+    juce::MemoryBlock image;
+    image.append(&header, sizeof(header));
+    image.append(channels.data(), channels.size() * sizeof(ChannelImage));
+    image.append(controls.data(), controls.size() * sizeof(ControlImage));
+    image.append(points.data(), points.size() * sizeof(float));
+    return image;
+}
+
+bool ControlsModel::setImage(const void* data, size_t size)
+{
+    if (!data || size < sizeof(ImageHeader))
+        return false;
+    const auto bytes = static_cast<const char*>(data);
+    const auto& header = *static_cast<const ImageHeader*>(data);
+    if (std::memcmp(header.magic, kImageMagic, sizeof(kImageMagic)) != 0 ||
+        header.version < 1 || header.version > kImageVersion ||
+        header.channels != allControls_.size())
+        return false;
+    //version 1 records are the leading part of the current ones
+    const auto stride = header.version == 1 ? sizeof(ControlImageV1) : sizeof(ControlImage);
+    const auto channels_offset = sizeof(ImageHeader);
+    const auto controls_offset = channels_offset + header.channels * sizeof(ChannelImage);
+    const auto points_offset = controls_offset + size_t{header.controls} * stride;
+    if (points_offset + size_t{header.points} * sizeof(float) > size)
+        return false;
+    const auto channels = reinterpret_cast<const ChannelImage*>(bytes + channels_offset);
+    const auto control_at = [bytes, controls_offset, stride](size_t i) noexcept {
+        return reinterpret_cast<const ControlImageV1*>(bytes + controls_offset + i * stride);
+    };
+    static const ControlImage kUnset{}; //what version 1 records lack
+    const auto extended_at = [&header, control_at](size_t i) noexcept {
+        return header.version == 1 ? &kUnset : static_cast<const ControlImage*>(control_at(i));
+    };
+    const auto points = reinterpret_cast<const float*>(bytes + points_offset);
+    //check everything before applying anything, so a damaged file changes nothing
+    const auto range_ok = [](const ImageRange& r) noexcept {
+        return r.method >= 0 && r.method <= kMaxMethod;
+    };
+    for (size_t c = 0; c < header.channels; ++c) {
+        const auto& channel = channels[c];
+        if (!range_ok(channel.cc_default) || !range_ok(channel.nrpn_default) ||
+            channel.first_control > header.controls ||
+            channel.control_count > header.controls - channel.first_control)
+            return false;
+        for (size_t i = 0; i < channel.control_count; ++i) {
+            const auto& control = *control_at(channel.first_control + i);
+            const auto& extended = *extended_at(channel.first_control + i);
+            if (extended.deadband < 0 || extended.deadband > ChannelModel::kMaxMIDIHalf ||
+                extended.acceleration < 0 || extended.acceleration > kMaxAcceleration ||
+                extended.touch > ChannelModel::kMaxMIDI + 1 ||
+                control.number < 0 || control.number > ChannelModel::kMaxNRPN ||
+                control.method < 0 || control.method > kMaxMethod ||
+                control.curve_type < 0 || control.curve_type > kMaxCurve ||
+                control.first_point > header.points ||
+                control.point_count > header.points - control.first_point)
+                return false;
+        }
+    }
+    for (size_t c = 0; c < header.channels; ++c) {
+        const auto& image = channels[c];
+        ChannelModel::Config defaults{};
+        defaults.cc_default.low = image.cc_default.low;
+        defaults.cc_default.high = image.cc_default.high;
+        defaults.cc_default.method = static_cast<RSJ::CCmethod>(image.cc_default.method);
+        defaults.nrpn_default.low = image.nrpn_default.low;
+        defaults.nrpn_default.high = image.nrpn_default.high;
+        defaults.nrpn_default.method = static_cast<RSJ::CCmethod>(image.nrpn_default.method);
+        defaults.pitch_wheel_max = image.pitch_wheel_max;
+        defaults.pitch_wheel_min = image.pitch_wheel_min;
+        std::vector<RSJ::SettingsStruct> settings;
+        settings.reserve(image.control_count);
+        for (size_t i = 0; i < image.control_count; ++i) {
+            const auto& control = *control_at(image.first_control + i);
+            const auto& extended = *extended_at(image.first_control + i);
+            const auto first = points + control.first_point;
+            settings.emplace_back(control.number, control.low, control.high,
+                static_cast<RSJ::CCmethod>(control.method), RSJ::ResponseCurve{
+                static_cast<RSJ::CurveType>(control.curve_type), control.amount,
+                std::vector<float>(first, first + control.point_count)},
+                extended.deadband, static_cast<RSJ::Acceleration>(extended.acceleration),
+                static_cast<short>(extended.touch - 1));
+        }
+        auto& channel = allControls_[c];
+        channel.Publish_(ChannelModel::Build_(defaults, channel.Current_()->cc14, settings));
+        channel.ResetStates_();
+    }
+    return true;
+}
+
+void ControlsModel::ControllerToPlugin(gsl::span<const RSJ::MidiMessage> messages,
+    gsl::span<double> results) noexcept(ndebug)
+{
+    Expects(results.size() >= messages.size());
+    //absolute CCs have no side effects, so gather their offsets and scales and
+    //convert a block at a time in a loop the compiler can vectorize. Everything else
+    //goes through the single-message path immediately so accumulators stay in order
+    constexpr std::ptrdiff_t kBlock = 64;
+    std::array<double, kBlock> offsets;
+    std::array<double, kBlock> scales;
+    std::array<std::ptrdiff_t, kBlock> slots;
+    std::ptrdiff_t pending = 0;
+    const auto flush = [&]() noexcept {
+        for (std::ptrdiff_t k = 0; k < pending; ++k)
+            offsets[k] *= scales[k];
+        for (std::ptrdiff_t k = 0; k < pending; ++k)
+            results[slots[k]] = offsets[k];
+        pending = 0;
+    };
+    for (std::ptrdiff_t i = 0; i < messages.size(); ++i) {
+        const auto& mm = messages[i];
+        Expects(mm.channel <= 15);
+        auto& channel = allControls_[mm.channel];
+        if (mm.message_type_byte == RSJ::kCCFlag) {
+            const auto config = channel.Current_();
+            const auto& control = config->Get(mm.number);
+            if (control.convert == &ChannelModel::Absolute_) {
+                offsets[pending] = mm.value - control.low;
+                scales[pending] = control.scale;
+                slots[pending] = i;
+                if (++pending == kBlock)
+                    flush();
+                continue;
+            }
+        }
+        results[i] = channel.ControllerToPlugin(mm.message_type_byte, mm.number, mm.value,
+            static_cast<size_t>(mm.source));
+    }
+    flush();
 }
\ No newline at end of file
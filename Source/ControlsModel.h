@@ -22,17 +22,24 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_CONTROLSMODEL_H_INCLUDED
 #define MIDI2LR_CONTROLSMODEL_H_INCLUDED
 
+#include <algorithm>
 #include <array>
 #include <atomic>
 #include <chrono>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include <cereal/access.hpp>
 #include <cereal/types/array.hpp>
 #include <cereal/types/vector.hpp>
 #include <gsl/gsl>
+#include "Instrumentation.h"
 #include "MidiUtilities.h"
 #include "Misc.h"
+#include "Utilities/Utilities.h"
 
 namespace RSJ {
     enum struct CCmethod: char {
@@ -45,13 +52,47 @@ namespace RSJ {
     }
     using timetype = decltype(now_ms());
 
+    enum struct CurveType: char {
+        linear, logarithmic, gamma, scurve, custom
+    };
+
+    // how much faster a relative control moves when turned quickly
+    enum struct Acceleration: char {
+        none, mild, strong
+    };
+
+    // response of an absolute control, mapping 0-1 controller position to 0-1 plugin value.
+    // amount is the curve strength (log base-1, gamma exponent or s-curve slope); custom
+    // uses points as x,y pairs, joined linearly and implicitly anchored at 0,0 and 1,1
+    struct ResponseCurve {
+        CurveType type{CurveType::linear};
+        float amount{1.0f};
+        std::vector<float> points{};
+        bool IsLinear() const noexcept
+        {
+            return type == CurveType::linear || (type == CurveType::custom && points.size() < 2) ||
+                ((type == CurveType::gamma || type == CurveType::scurve) && amount == 1.0f);
+        }
+        double Apply(double x) const noexcept;
+        // custom points clamped to 0-1 and sorted by x, each y raised to the one before
+        // it, as feedback needs a curve that never falls. Unpaired and non-finite
+        // values are dropped
+        ResponseCurve Normalized() const;
+    };
+
     struct SettingsStruct {
         short number;//not using size_t so serialized data won't vary if size_t varies
         short low;
         short high;
         RSJ::CCmethod method;
-        SettingsStruct(short n = 0, short l = 0, short h = 0x7F, RSJ::CCmethod m = RSJ::CCmethod::absolute):
-            number{n}, low{l}, high{h}, method{m}
+        ResponseCurve curve;
+        short deadband{0};
+        Acceleration acceleration{Acceleration::none};
+        short touch{-1}; //note the controller sends while the fader is touched, -1 for none
+        SettingsStruct(short n = 0, short l = 0, short h = 0x7F, RSJ::CCmethod m = RSJ::CCmethod::absolute,
+            ResponseCurve c = {}, short d = 0, Acceleration a = Acceleration::none, short t = -1):
+            number{n}, low{l}, high{h}, method{m}, curve(std::move(c)), deadband{d}, acceleration{a},
+            touch{t}
         {}
 
         template<class Archive> void serialize(Archive& archive, uint32_t const version)
@@ -60,6 +101,20 @@ namespace RSJ {
             case 1:
                 archive(number, high, low, method);//keep this order for compatibility with earlier versions
                 break;
+            case 2:
+                archive(number, high, low, method, curve.type, curve.amount, curve.points);
+                break;
+            case 3:
+                archive(number, high, low, method, curve.type, curve.amount, curve.points, deadband);
+                break;
+            case 4:
+                archive(number, high, low, method, curve.type, curve.amount, curve.points, deadband,
+                    acceleration);
+                break;
+            case 5:
+                archive(number, high, low, method, curve.type, curve.amount, curve.points, deadband,
+                    acceleration, touch);
+                break;
             default:
                 Expects(!"Wrong archive number for SettingsStruct");
             }
@@ -78,46 +133,195 @@ class ChannelModel {
     constexpr static short kMaxNRPN = 0x3FFF;
     constexpr static short kMaxNRPNHalf = kMaxNRPN / 2;
     constexpr static size_t kMaxControls = 0x4000;
+    constexpr static size_t kCC14Controls = 32; //CC 0-31 may pair with LSB on CC 32-63
+    constexpr static int kNrpnBits = 10;
+    constexpr static size_t kNrpnCapacity = 1 << kNrpnBits; //relative NRPN controls per channel
+    constexpr static short kNrpnEmpty = -1;
     constexpr static RSJ::timetype kUpdateDelay = 250;
+    constexpr static RSJ::timetype kPickupHold = 500; //ms a picked up control keeps control
+    constexpr static float kPickupThreshold = 0.03f; //roughly 4/127
+    constexpr static RSJ::timetype kAccelerationWindow = 120; //ms between moves that start speeding up
 public:
     ChannelModel();
-    ~ChannelModel() = default;
+    ~ChannelModel();
     //Can write copy and move with special handling for atomics, but in lieu of that, delete
     ChannelModel(const ChannelModel&) = delete; //can't copy atomics
     ChannelModel& operator= (const ChannelModel&) = delete;
     ChannelModel(ChannelModel&&) = delete; //can't move atomics
     ChannelModel& operator=(ChannelModel&&) = delete;
-    double ControllerToPlugin(short controltype, size_t controlnumber, short value) noexcept(ndebug);
+    // device is the message's RSJ::DeviceIndex: told-apart devices share the channel's
+    // settings but each keeps its own relative and pickup state
+    double ControllerToPlugin(short controltype, size_t controlnumber, short value,
+        size_t device = 0) noexcept(ndebug);
     RSJ::CCmethod getCCmethod(size_t controlnumber) const noexcept(ndebug);
     short getCCmax(size_t controlnumber) const noexcept(ndebug);
     short getCCmin(size_t controlnumber) const noexcept(ndebug);
     short getPWmax() const noexcept;
     short getPWmin() const noexcept;
-    short PluginToController(short controltype, size_t controlnumber, double value) noexcept(ndebug);
-    void setCC(size_t controlnumber, short min, short max, RSJ::CCmethod controltype) noexcept(ndebug);
-    void setCCall(size_t controlnumber, short min, short max, RSJ::CCmethod controltype) noexcept(ndebug);
-    void setCCmax(size_t controlnumber, short value) noexcept(ndebug);
-    void setCCmethod(size_t controlnumber, RSJ::CCmethod value) noexcept(ndebug);
-    void setCCmin(size_t controlnumber, short value) noexcept(ndebug);
-    void setPWmax(short value) noexcept(ndebug);
-    void setPWmin(short value) noexcept(ndebug);
+    short PluginToController(short controltype, size_t controlnumber, double value,
+        size_t device = 0) noexcept(ndebug);
+    // pickup mode: whether an absolute control or pitch wheel moved to value (plugin
+    // units) is close enough to the Lightroom value last fed back to take it over.
+    // Buttons, relative controls and controls without feedback yet always pass
+    bool PickedUp(short controltype, size_t controlnumber, double value,
+        size_t device = 0) noexcept(ndebug);
+    // whether an absolute control moved no more than its deadband from the last value
+    // let through, so a jittering pot stays quiet. The ends of the range always pass
+    bool Jittered(short controltype, size_t controlnumber, short value,
+        size_t device = 0) noexcept(ndebug);
+    // the last move of a relative control in plugin units, signed and before its
+    // position was clamped
+    double LastStep(size_t controlnumber, size_t device = 0) noexcept(ndebug);
+    // relative controls send their moves for the plugin to add to Lightroom's value, so
+    // their positions follow feedback at once instead of after kUpdateDelay
+    void setRelativeDeltas(bool enabled) noexcept;
+    bool getRelativeDeltas() const noexcept;
+    void setCC(size_t controlnumber, short min, short max, RSJ::CCmethod controltype);
+    void setCCall(size_t controlnumber, short min, short max, RSJ::CCmethod controltype);
+    void setCCmax(size_t controlnumber, short value);
+    void setCCmethod(size_t controlnumber, RSJ::CCmethod value);
+    void setCCmin(size_t controlnumber, short value);
+    // controlnumber (0-31) receives 14-bit values assembled from the MSB/LSB pair
+    void setCC14bit(size_t controlnumber, bool enabled);
+    bool getCC14bit(size_t controlnumber) const noexcept(ndebug);
+    void setPWmax(short value);
+    void setPWmin(short value);
+    void setCurve(size_t controlnumber, const RSJ::ResponseCurve& curve);
+    RSJ::ResponseCurve getCurve(size_t controlnumber) const;
+    void setCCdeadband(size_t controlnumber, short value);
+    short getCCdeadband(size_t controlnumber) const noexcept(ndebug);
+    void setCCacceleration(size_t controlnumber, RSJ::Acceleration value);
+    RSJ::Acceleration getCCacceleration(size_t controlnumber) const noexcept(ndebug);
+    // note (0-127) the controller sends while the fader is touched, -1 for none
+    void setCCtouch(size_t controlnumber, short note);
+    short getCCtouch(size_t controlnumber) const noexcept(ndebug);
+    // the CC (0-127) whose touch note is note, -1 if none
+    short TouchedFader(short note) const noexcept;
+    // controls differing from the channel defaults
+    std::vector<RSJ::SettingsStruct> getSettings() const;
+    // gives every control the channel defaults except these, in one publish. Defaults,
+    // pitch wheel range and 14-bit pairs are kept. Safe while MIDI is being converted
+    void setSettings(const std::vector<RSJ::SettingsStruct>& settings);
+    // bumped on every configuration change
+    juce::uint32 getChangeCount() const noexcept
+    {
+        return changes_.load(std::memory_order_acquire);
+    }
 
 private:
     friend class cereal::access;
-    bool IsNRPN_(size_t controlnumber) const noexcept(ndebug);
-    double OffsetResult_(short diff, size_t controlnumber) noexcept(ndebug);
-    mutable std::atomic<RSJ::timetype> lastUpdate_{0};
+    friend class ControlsModel; //batch conversion reads the Config directly
+    // curve compiled to the absolute-mode result for each value from low to high;
+    // values is empty if the control isn't absolute
+    struct CurveTable {
+        RSJ::ResponseCurve definition;
+        std::vector<double> values;
+    };
+    struct ControlConfig;
+    // converts one CC message for a control. Chosen for the control's method, curve and
+    // width whenever a Config is published, so ControllerToPlugin branches on none of them
+    using Converter = double (*)(ChannelModel& model, const ControlConfig& control,
+        size_t controlnumber, short value, size_t device);
+    // configuration of one control. scale caches 1/(high-low) so the hot path
+    // multiplies instead of divides
+    struct ControlConfig {
+        double scale{1.0 / kMaxMIDI};
+        std::shared_ptr<const CurveTable> curve{};
+        RSJ::CCmethod method{RSJ::CCmethod::absolute};
+        short low{0};
+        short high{kMaxMIDI};
+        short deadband{0}; //absolute changes this small or smaller are dropped
+        RSJ::Acceleration acceleration{RSJ::Acceleration::none}; //relative controls only
+        short touch{-1}; //touch note, CC 0-127 only
+        Converter convert{&ChannelModel::Absolute_}; //set by Bind_
+    };
+    // everything the conversions read. The message thread copies the current Config,
+    // edits the copy and publishes it with one pointer store, so the MIDI thread always
+    // sees a consistent snapshot without locking. A replaced Config is freed once no
+    // reader's RSJ::EpochGuard can still see it. NRPN controls only appear in nrpn
+    // (sorted by number) once they differ from nrpn_default. cc_default is what "apply
+    // to all" last set for 0-127, so only controls differing from it are saved
+    struct Config {
+        std::array<ControlConfig, kMaxMIDI + 1> cc{};
+        ControlConfig cc_default{};
+        ControlConfig nrpn_default{1.0 / kMaxNRPN, {}, RSJ::CCmethod::absolute, 0, kMaxNRPN};
+        std::vector<std::pair<short, ControlConfig>> nrpn{};
+        short pitch_wheel_max{kMaxNRPN};
+        short pitch_wheel_min{0};
+        juce::uint32 cc14{0}; //bit n set if CC n is a 14-bit pair
+        std::array<juce::uint8, kMaxMIDI + 1> touched{}; //by note, its fader + 1, set by Bind_
+        const ControlConfig& Get(size_t controlnumber) const noexcept(ndebug);
+        ControlConfig& Edit(size_t controlnumber);
+        bool Is14bit(size_t controlnumber) const noexcept(ndebug);
+    };
+    // relative-mode position, written by the MIDI thread so kept out of Config.
+    // last_update is per control so feedback is suppressed only for the encoder that moved,
+    // and the time since it sets the acceleration.
+    // mirror and picked are the pickup state of absolute controls, accepted their deadband
+    struct alignas(16) ControlState {
+        std::atomic<RSJ::timetype> last_update{0};
+        std::atomic<short> current{kMaxMIDIHalf};
+        std::atomic<float> mirror{-1.0f}; //Lightroom value fed back, negative until known
+        std::atomic<RSJ::timetype> picked{0}; //last move that passed pickup
+        std::atomic<short> accepted{-1}; //last value past the deadband, negative until known
+        std::atomic<float> step{0.0f}; //last relative move, see LastStep
+    };
+    // NRPN positions are created on first use in an open-addressing table, keyed by
+    // device and number; the rest share nrpn_state_. Entries are never removed while
+    // running, so lookups need no lock
+    struct NrpnState {
+        std::atomic<int> number{kNrpnEmpty};
+        std::atomic<bool> ready{false};
+        ControlState state;
+    };
+    static bool IsNRPN_(size_t controlnumber) noexcept(ndebug);
+    static double Absolute_(ChannelModel& model, const ControlConfig& control,
+        size_t controlnumber, short value, size_t device);
+    static double Curved_(ChannelModel& model, const ControlConfig& control,
+        size_t controlnumber, short value, size_t device);
+    template<RSJ::CCmethod Method, bool Wide>
+    static double Relative_(ChannelModel& model, const ControlConfig& control,
+        size_t controlnumber, short value, size_t device);
+    static Converter Converter_(const ControlConfig& control, bool wide) noexcept;
+    static void Bind_(Config& config) noexcept;
+    double OffsetResult_(short diff, const ControlConfig& control, ControlState& state) noexcept(ndebug);
+    RSJ::Published<Config>::Reader Current_() const noexcept;
+    std::unique_ptr<Config> Copy_() const;
+    void Publish_(std::unique_ptr<Config> next);
+    ControlState& State_(size_t controlnumber, size_t device = 0) noexcept(ndebug);
+    ControlState* FindOrAddState_(size_t controlnumber, size_t device) noexcept;
+    void ResetState_(size_t controlnumber, const ControlConfig& control) noexcept(ndebug);
+    static void SetCC_(ControlConfig& control, short min, short max, RSJ::CCmethod controltype,
+        short limit);
+    static void SetCCmax_(ControlConfig& control, short value, short limit) noexcept(ndebug);
+    static void SetCCmin_(ControlConfig& control, short value) noexcept(ndebug);
+    static void Rerange_(ControlConfig& control);
+    static void CompactNrpn_(Config& config);
+    static short CurveToController_(const ControlConfig& control, const CurveTable& table,
+        double value) noexcept;
+    void ResetStates_() noexcept;
+    static const Config& DefaultConfig_();
+    static std::vector<RSJ::SettingsStruct> Differing_(const Config& config);
+    // defaults' channel-wide settings with settings applied on top
+    static std::unique_ptr<Config> Build_(const Config& defaults, juce::uint32 cc14,
+        const std::vector<RSJ::SettingsStruct>& settings);
     mutable std::vector<RSJ::SettingsStruct> settingsToSave_{};
-    short pitchWheelMax_{kMaxNRPN};
-    short pitchWheelMin_{0};
-    std::array<RSJ::CCmethod, kMaxControls> ccMethod_;
-    std::array<short, kMaxControls> ccHigh_;
-    std::array<short, kMaxControls> ccLow_;
-    std::array<std::atomic<short>, kMaxControls> currentV_;
+    mutable std::mutex save_mutex_; //saves may run on a background thread
+    mutable juce::uint32 saved_changes_{0}; //change count settingsToSave_ reflects
+    std::atomic<juce::uint32> changes_{0};
+    std::atomic<bool> deltas_{false};
+    RSJ::Published<Config> config_;
+    std::array<std::array<ControlState, kMaxMIDI + 1>, RSJ::kDeviceIds> cc_state_;
+    ControlState nrpn_state_; //accumulator if the NRPN table is full
+    std::array<ControlState, RSJ::kDeviceIds> pw_state_; //pitch wheel pickup
+    using NrpnTable = std::array<NrpnState, kNrpnCapacity>;
+    std::atomic<NrpnTable*> nrpn_{nullptr}; //allocated on first relative NRPN use
     template<class Archive> void load(Archive& archive, uint32_t const version);
     template<class Archive> void save(Archive& archive, uint32_t const version) const;
     void activeToSaved() const;
-    void savedToActive() noexcept(ndebug);
+    void savedToActive(const Config& defaults);
+    // heap bytes, the states are part of the object. Message thread
+    size_t MemoryUse_() const;
 };
 
 class ControlsModel {
@@ -131,12 +335,26 @@ class ControlsModel {
     ControlsModel& operator= (const ControlsModel&) = delete;
     ControlsModel(ControlsModel&&) = delete; //can't move atomics
     ControlsModel& operator=(ControlsModel&&) = delete;
+    // total configuration changes, compare against a previous value to see if a save is due
+    juce::uint64 getChangeCount() const noexcept
+    {
+        juce::uint64 changes{0};
+        for (const auto& channel : allControls_)
+            changes += channel.getChangeCount();
+        return changes;
+    }
+
     double ControllerToPlugin(const RSJ::MidiMessage& mm) noexcept(ndebug)
     {
         Expects(mm.channel <= 15);
-        return allControls_[mm.channel].ControllerToPlugin(mm.message_type_byte, mm.number, mm.value);
+        return allControls_[mm.channel].ControllerToPlugin(mm.message_type_byte, mm.number, mm.value,
+            static_cast<size_t>(mm.source));
     }
 
+    //converts messages[i] into results[i], applying relative moves in message order
+    void ControllerToPlugin(gsl::span<const RSJ::MidiMessage> messages,
+        gsl::span<double> results) noexcept(ndebug);
+
     RSJ::CCmethod getCCmethod(size_t channel, short controlnumber) const noexcept(ndebug)
     {
         Expects(channel <= 15);
@@ -167,53 +385,177 @@ class ControlsModel {
         return allControls_[channel].getPWmin();
     }
 
-    short PluginToController(short controltype, size_t channel, short controlnumber, double value) noexcept(ndebug)
+    short PluginToController(short controltype, size_t channel, short controlnumber, double value,
+        short device = 0) noexcept(ndebug)
     {
         Expects(channel <= 15);
-        return allControls_[channel].PluginToController(controltype, controlnumber, value);
+        return allControls_[channel].PluginToController(controltype, controlnumber, value,
+            static_cast<size_t>(device));
     }
 
-    void setCC(size_t channel, short controlnumber, short min, short max, RSJ::CCmethod controltype) noexcept(ndebug)
+    bool PickedUp(const RSJ::MidiMessage& mm, double value) noexcept(ndebug)
+    {
+        Expects(mm.channel <= 15);
+        return allControls_[mm.channel].PickedUp(mm.message_type_byte, mm.number, value,
+            static_cast<size_t>(mm.source));
+    }
+
+    void setCC(size_t channel, short controlnumber, short min, short max, RSJ::CCmethod controltype)
     {
         Expects(channel <= 15);
         allControls_[channel].setCC(controlnumber, min, max, controltype);
     }
-    void setCCall(size_t channel, short controlnumber, short min, short max, RSJ::CCmethod controltype) noexcept(ndebug)
+    void setCCall(size_t channel, short controlnumber, short min, short max, RSJ::CCmethod controltype)
     {
         Expects(channel <= 15);
         allControls_[channel].setCCall(controlnumber, min, max, controltype);
     }
 
-    void setCCmax(size_t channel, short controlnumber, short value) noexcept(ndebug)
+    bool Jittered(const RSJ::MidiMessage& mm) noexcept(ndebug)
+    {
+        Expects(mm.channel <= 15);
+        return allControls_[mm.channel].Jittered(mm.message_type_byte, mm.number, mm.value,
+            static_cast<size_t>(mm.source));
+    }
+
+    // whether mm is a move of a relative control, and how far it last moved
+    bool IsRelative(const RSJ::MidiMessage& mm) const noexcept(ndebug)
+    {
+        Expects(mm.channel <= 15);
+        return mm.message_type_byte == RSJ::kCCFlag &&
+            allControls_[mm.channel].getCCmethod(static_cast<size_t>(mm.number)) !=
+            RSJ::CCmethod::absolute;
+    }
+    double LastStep(const RSJ::MidiMessage& mm) noexcept(ndebug)
+    {
+        Expects(mm.channel <= 15);
+        return allControls_[mm.channel].LastStep(static_cast<size_t>(mm.number),
+            static_cast<size_t>(mm.source));
+    }
+
+    void setRelativeDeltas(bool enabled) noexcept
+    {
+        for (auto& channel : allControls_)
+            channel.setRelativeDeltas(enabled);
+    }
+    bool getRelativeDeltas() const noexcept
+    {
+        return allControls_[0].getRelativeDeltas();
+    }
+
+    void setCCmax(size_t channel, short controlnumber, short value)
     {
         Expects(channel <= 15);
         allControls_[channel].setCCmax(controlnumber, value);
     }
 
-    void setCCmethod(size_t channel, short controlnumber, RSJ::CCmethod value) noexcept(ndebug)
+    void setCCmethod(size_t channel, short controlnumber, RSJ::CCmethod value)
     {
         Expects(channel <= 15);
         allControls_[channel].setCCmethod(controlnumber, value);
     }
 
-    void setCCmin(size_t channel, short controlnumber, short value) noexcept(ndebug)
+    void setCCmin(size_t channel, short controlnumber, short value)
     {
         Expects(channel <= 15);
         allControls_[channel].setCCmin(controlnumber, value);
     }
 
-    void setPWmax(size_t channel, short value) noexcept(ndebug)
+    void setCC14bit(size_t channel, short controlnumber, bool enabled)
+    {
+        Expects(channel <= 15);
+        allControls_[channel].setCC14bit(controlnumber, enabled);
+    }
+
+    bool getCC14bit(size_t channel, short controlnumber) const noexcept(ndebug)
+    {
+        Expects(channel <= 15);
+        return allControls_[channel].getCC14bit(controlnumber);
+    }
+
+    void setPWmax(size_t channel, short value)
     {
         Expects(channel <= 15);
         allControls_[channel].setPWmax(value);
     }
 
-    void setPWmin(size_t channel, short value) noexcept(ndebug)
+    void setPWmin(size_t channel, short value)
     {
         Expects(channel <= 15);
         allControls_[channel].setPWmin(value);
     }
 
+    void setCurve(size_t channel, short controlnumber, const RSJ::ResponseCurve& curve)
+    {
+        Expects(channel <= 15);
+        allControls_[channel].setCurve(controlnumber, curve);
+    }
+
+    RSJ::ResponseCurve getCurve(size_t channel, short controlnumber) const
+    {
+        Expects(channel <= 15);
+        return allControls_[channel].getCurve(controlnumber);
+    }
+
+    void setCCdeadband(size_t channel, short controlnumber, short value)
+    {
+        Expects(channel <= 15);
+        allControls_[channel].setCCdeadband(controlnumber, value);
+    }
+
+    short getCCdeadband(size_t channel, short controlnumber) const noexcept(ndebug)
+    {
+        Expects(channel <= 15);
+        return allControls_[channel].getCCdeadband(controlnumber);
+    }
+
+    void setCCacceleration(size_t channel, short controlnumber, RSJ::Acceleration value)
+    {
+        Expects(channel <= 15);
+        allControls_[channel].setCCacceleration(controlnumber, value);
+    }
+
+    RSJ::Acceleration getCCacceleration(size_t channel, short controlnumber) const noexcept(ndebug)
+    {
+        Expects(channel <= 15);
+        return allControls_[channel].getCCacceleration(controlnumber);
+    }
+
+    void setCCtouch(size_t channel, short controlnumber, short note)
+    {
+        Expects(channel <= 15);
+        allControls_[channel].setCCtouch(controlnumber, note);
+    }
+
+    short getCCtouch(size_t channel, short controlnumber) const noexcept(ndebug)
+    {
+        Expects(channel <= 15);
+        return allControls_[channel].getCCtouch(controlnumber);
+    }
+
+    // the fader (CC 0-127 on the same channel) a note or note off senses the touch of,
+    // -1 if it isn't a touch note
+    short TouchedFader(const RSJ::MidiMessage& mm) const noexcept
+    {
+        if (mm.channel > 15 || (mm.message_type_byte != RSJ::kNoteOnFlag &&
+            mm.message_type_byte != RSJ::kNoteOffFlag))
+            return -1;
+        return allControls_[static_cast<size_t>(mm.channel)].TouchedFader(mm.number);
+    }
+
+    // controls differing from their channel defaults, as channel (0-15) and settings
+    std::vector<std::pair<size_t, RSJ::SettingsStruct>> getSettings() const;
+
+    // a profile's control settings: every channel gets its defaults plus these
+    void setSettings(const std::vector<std::pair<size_t, RSJ::SettingsStruct>>& settings);
+
+    // settings.bin contents: a fixed-layout, versioned image that a memory-mapped file
+    // can be read from in place. Older cereal archives still load through serialize
+    juce::MemoryBlock getImage() const;
+    // applies an image from getImage, returning false with nothing changed if data isn't
+    // a valid one. data must be 4-byte aligned, as a mapped file is
+    bool setImage(const void* data, size_t size);
+
 private:
     friend class cereal::access;
     template<class Archive>
@@ -222,61 +564,144 @@ class ControlsModel {
         if (version == 1)// serialize things by passing them to the archive
             archive(allControls_);
     }
+    size_t MemoryUse_() const;
     std::array<ChannelModel, 16> allControls_;
+    MemoryAccount memory_{"ControlsModel", [this] {return MemoryUse_(); }}; //last, goes first
 };
 
+inline RSJ::Published<ChannelModel::Config>::Reader ChannelModel::Current_() const noexcept
+{
+    return config_.Read();
+}
+
 inline RSJ::CCmethod ChannelModel::getCCmethod(size_t controlnumber) const noexcept(ndebug)
 {
-    Expects(controlnumber <= kMaxNRPN);
-    return ccMethod_[controlnumber];
+    return Current_()->Get(controlnumber).method;
+}
+
+inline double ChannelModel::LastStep(size_t controlnumber, size_t device) noexcept(ndebug)
+{
+    return State_(controlnumber, device).step.load(std::memory_order_relaxed);
+}
+
+inline void ChannelModel::setRelativeDeltas(bool enabled) noexcept
+{
+    deltas_.store(enabled, std::memory_order_relaxed);
+}
+
+inline bool ChannelModel::getRelativeDeltas() const noexcept
+{
+    return deltas_.load(std::memory_order_relaxed);
 }
 
 inline short ChannelModel::getCCmax(size_t controlnumber) const noexcept(ndebug)
 {
-    Expects(controlnumber <= kMaxNRPN);
-    return ccHigh_[controlnumber];
+    return Current_()->Get(controlnumber).high;
 }
 
 inline short ChannelModel::getCCmin(size_t controlnumber) const noexcept(ndebug)
 {
-    Expects(controlnumber <= kMaxNRPN);
-    return ccLow_[controlnumber];
+    return Current_()->Get(controlnumber).low;
+}
+
+inline short ChannelModel::getCCdeadband(size_t controlnumber) const noexcept(ndebug)
+{
+    return Current_()->Get(controlnumber).deadband;
+}
+
+inline RSJ::Acceleration ChannelModel::getCCacceleration(size_t controlnumber) const noexcept(ndebug)
+{
+    return Current_()->Get(controlnumber).acceleration;
+}
+
+inline short ChannelModel::getCCtouch(size_t controlnumber) const noexcept(ndebug)
+{
+    return Current_()->Get(controlnumber).touch;
+}
+
+inline short ChannelModel::TouchedFader(short note) const noexcept
+{
+    return note < 0 || note > kMaxMIDI ? short{-1} :
+        static_cast<short>(Current_()->touched[static_cast<size_t>(note)] - 1);
 }
 
 inline short ChannelModel::getPWmax() const noexcept
 {
-    return pitchWheelMax_;
+    return Current_()->pitch_wheel_max;
 }
 
 inline short ChannelModel::getPWmin() const noexcept
 {
-    return pitchWheelMin_;
+    return Current_()->pitch_wheel_min;
 }
 
-inline bool ChannelModel::IsNRPN_(size_t controlnumber) const noexcept(ndebug)
+inline bool ChannelModel::IsNRPN_(size_t controlnumber) noexcept(ndebug)
 {
     Expects(controlnumber <= kMaxNRPN);
     return controlnumber > kMaxMIDI;
 }
 
-inline double ChannelModel::OffsetResult_(short diff, size_t controlnumber) noexcept(ndebug)
+inline bool ChannelModel::getCC14bit(size_t controlnumber) const noexcept(ndebug)
+{
+    Expects(controlnumber <= kMaxNRPN);
+    return controlnumber < kCC14Controls && (Current_()->cc14 & (1u << controlnumber));
+}
+
+inline bool ChannelModel::Config::Is14bit(size_t controlnumber) const noexcept(ndebug)
 {
-    Expects(ccHigh_[controlnumber] > 0); //CCLow will always be 0 for offset controls
-    Expects(diff <= kMaxNRPN && diff >= -kMaxNRPN);
     Expects(controlnumber <= kMaxNRPN);
-    lastUpdate_.store(RSJ::now_ms(), std::memory_order_release);
-    short cv = currentV_[controlnumber].fetch_add(diff, std::memory_order_relaxed) + diff;
+    return controlnumber > kMaxMIDI || (controlnumber < kCC14Controls && (cc14 & (1u << controlnumber)));
+}
+
+inline const ChannelModel::ControlConfig& ChannelModel::Config::Get(size_t controlnumber) const noexcept(ndebug)
+{
+    Expects(controlnumber <= kMaxNRPN);
+    if (!IsNRPN_(controlnumber))
+        return cc[controlnumber];
+    const auto number = static_cast<short>(controlnumber);
+    const auto found = std::lower_bound(nrpn.begin(), nrpn.end(), number,
+        [](const std::pair<short, ControlConfig>& a, short b) noexcept {return a.first < b; });
+    return (found != nrpn.end() && found->first == number) ? found->second : nrpn_default;
+}
+
+inline ChannelModel::ControlState& ChannelModel::State_(size_t controlnumber, size_t device) noexcept(ndebug)
+{
+    Expects(controlnumber <= kMaxNRPN);
+    Expects(device < cc_state_.size());
+    if (!IsNRPN_(controlnumber))
+        return cc_state_[device][controlnumber];
+    const auto state = FindOrAddState_(controlnumber, device);
+    return state ? *state : nrpn_state_;
+}
+
+inline double ChannelModel::OffsetResult_(short diff, const ControlConfig& control,
+    ControlState& state) noexcept(ndebug)
+{
+    Expects(control.high > 0); //CCLow will always be 0 for offset controls
+    Expects(diff <= kMaxNRPN && diff >= -kMaxNRPN);
+    const auto now = RSJ::now_ms();
+    const auto interval = now - state.last_update.exchange(now, std::memory_order_acq_rel);
+    if (control.acceleration != RSJ::Acceleration::none && interval < kAccelerationWindow) {
+        //squared so that moderate speeds stay close to one step per detent
+        const auto speed = 1.0 - static_cast<double>(interval) / kAccelerationWindow;
+        const auto gain = control.acceleration == RSJ::Acceleration::strong ? 15.0 : 5.0;
+        const auto step = diff * (1.0 + gain * speed * speed);
+        diff = static_cast<short>(std::max(std::min(step, static_cast<double>(control.high)),
+            -static_cast<double>(control.high)));
+    }
+    state.step.store(static_cast<float>(diff * control.scale), std::memory_order_relaxed);
+    short cv = state.current.fetch_add(diff, std::memory_order_relaxed) + diff;
     if (cv < 0) {//fix currentV unless another thread has already altered it
-        currentV_[controlnumber].compare_exchange_strong(cv, static_cast<short>(0),
+        state.current.compare_exchange_strong(cv, static_cast<short>(0),
             std::memory_order_relaxed, std::memory_order_relaxed);
         return 0.0;
     }
-    if (cv > ccHigh_[controlnumber]) {//fix currentV unless another thread has already altered it
-        currentV_[controlnumber].compare_exchange_strong(cv, ccHigh_[controlnumber],
+    if (cv > control.high) {//fix currentV unless another thread has already altered it
+        state.current.compare_exchange_strong(cv, control.high,
             std::memory_order_relaxed, std::memory_order_relaxed);
         return 1.0;
     }
-    return static_cast<double>(cv) / static_cast<double>(ccHigh_[controlnumber]);
+    return cv * control.scale;
 }
 
 template<class Archive>
@@ -284,12 +709,42 @@ void ChannelModel::load(Archive& archive, uint32_t const version)
 {
     switch (version) {
     case 1:
-        archive(ccMethod_, ccHigh_, ccLow_, pitchWheelMax_, pitchWheelMin_);
+    {
+        auto methods = std::make_unique<std::array<RSJ::CCmethod, kMaxControls>>();
+        auto highs = std::make_unique<std::array<short, kMaxControls>>();
+        auto lows = std::make_unique<std::array<short, kMaxControls>>();
+        Config defaults{};
+        archive(*methods, *highs, *lows, defaults.pitch_wheel_max, defaults.pitch_wheel_min);
+        settingsToSave_.clear();
+        for (size_t i = 0; i < kMaxControls; ++i)
+            if ((*methods)[i] != RSJ::CCmethod::absolute || (*lows)[i] != 0 ||
+                (*highs)[i] != (IsNRPN_(i) ? kMaxNRPN : kMaxMIDI))
+                settingsToSave_.emplace_back(static_cast<short>(i), (*lows)[i], (*highs)[i],
+                (*methods)[i]);
+        savedToActive(defaults);
         break;
+    }
     case 2:
         archive(settingsToSave_);
-        savedToActive();
+        savedToActive(Config{});
+        break;
+    case 3:
+    {
+        Config defaults{};
+        auto& nrpn = defaults.nrpn_default;
+        archive(settingsToSave_, nrpn.method, nrpn.low, nrpn.high);
+        savedToActive(defaults);
+        break;
+    }
+    case 4:
+    {
+        Config defaults{};
+        auto& nrpn = defaults.nrpn_default;
+        auto& cc = defaults.cc_default;
+        archive(settingsToSave_, nrpn.method, nrpn.low, nrpn.high, cc.method, cc.low, cc.high);
+        savedToActive(defaults);
         break;
+    }
     default:
         Expects(!"Archive version not acceptable");
     }
@@ -298,20 +753,30 @@ void ChannelModel::load(Archive& archive, uint32_t const version)
 template<class Archive>
 void ChannelModel::save(Archive& archive, uint32_t const version) const
 {
+    std::lock_guard<std::mutex> lock(save_mutex_);
+    const auto config = Current_();
+    const auto& nrpn_default = config->nrpn_default;
+    const auto& cc_default = config->cc_default;
     switch (version) {
-    case 1:
-        archive(ccMethod_, ccHigh_, ccLow_, pitchWheelMax_, pitchWheelMin_);
-        break;
     case 2:
         activeToSaved();
         archive(settingsToSave_);
         break;
+    case 3:
+        activeToSaved();
+        archive(settingsToSave_, nrpn_default.method, nrpn_default.low, nrpn_default.high);
+        break;
+    case 4:
+        activeToSaved();
+        archive(settingsToSave_, nrpn_default.method, nrpn_default.low, nrpn_default.high,
+            cc_default.method, cc_default.low, cc_default.high);
+        break;
     default:
         Expects(!"Wrong archive version specified for save");
     }
 }
 
-CEREAL_CLASS_VERSION(ChannelModel, 2);
+CEREAL_CLASS_VERSION(ChannelModel, 4);
 CEREAL_CLASS_VERSION(ControlsModel, 1);
-CEREAL_CLASS_VERSION(RSJ::SettingsStruct, 1);
+CEREAL_CLASS_VERSION(RSJ::SettingsStruct, 5);
 #endif
\ No newline at end of file
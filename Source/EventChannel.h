@@ -0,0 +1,183 @@
+#pragma once
+/*
+  ==============================================================================
+
+    EventChannel.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_EVENTCHANNEL_H_INCLUDED
+#define MIDI2LR_EVENTCHANNEL_H_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Instrumentation.h"
+#include "Misc.h"
+#include "Utilities/Utilities.h"
+
+// how an EventChannel's event reaches one subscriber
+enum class Delivery {
+    immediate, //on the publishing thread, before Publish returns
+    worker, //in order on the channel's own thread, so Publish never waits for it
+    message_thread, //on the message thread, only the latest event of a burst
+};
+
+// Typed publish/subscribe with a delivery policy per subscriber. Subscribers are
+// object and member function pairs as in RSJ::callback_list, and may be added while
+// another thread publishes; they must outlive the channel. The channel's counters
+// (events, ns spent in immediate subscribers, events the worker had no room for)
+// appear in the diagnostics report under its name
+template<size_t Capacity, typename Arg>
+class EventChannel {
+public:
+    explicit EventChannel(const juce::String& name): name_{name},
+        events_(Instrumentation::Counter(name + " events")),
+        dispatch_time_(Instrumentation::Counter(name + " dispatch ns")),
+        dropped_(Instrumentation::Counter(name + " worker drops"))
+    {}
+    EventChannel(const EventChannel&) = delete;
+    EventChannel& operator=(const EventChannel&) = delete;
+    ~EventChannel() = default;
+
+    template<class T, void (T::*MF)(Arg)>
+    void Subscribe(T* const object, Delivery delivery = Delivery::immediate)
+    {
+        switch (delivery) {
+        case Delivery::immediate:
+            immediate_.template add<T, MF>(object);
+            break;
+        case Delivery::worker:
+            if (!worker_owner_) {
+                worker_owner_ = std::make_unique<Worker_>(name_);
+                worker_.store(worker_owner_.get(), std::memory_order_release);
+            }
+            worker_owner_->template Add<T, MF>(object);
+            break;
+        case Delivery::message_thread:
+        {
+            const auto count = latest_count_.load(std::memory_order_relaxed);
+            if (count == Capacity)
+                throw std::length_error("Too many message thread subscribers in EventChannel");
+            latest_[count] = std::make_unique<Latest_>();
+            latest_[count]->subscriber.template add<T, MF>(object);
+            latest_count_.store(count + 1, std::memory_order_release);
+            break;
+        }
+        }
+    }
+
+    void Publish(Arg event)
+    {
+        events_.fetch_add(1, std::memory_order_relaxed);
+        const auto start = std::chrono::steady_clock::now();
+        immediate_(event);
+        dispatch_time_.fetch_add(std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - start).count(), std::memory_order_relaxed);
+        if (auto* const worker = worker_.load(std::memory_order_acquire))
+            if (!worker->Push(event))
+                dropped_.fetch_add(1, std::memory_order_relaxed);
+        const auto latest_count = latest_count_.load(std::memory_order_acquire);
+        for (size_t i = 0; i < latest_count; ++i)
+            latest_[i]->Set(event);
+    }
+
+private:
+    using Value = typename std::decay<Arg>::type;
+    constexpr static size_t kWorkerQueue = 1024;
+    constexpr static size_t kWorkerBatch = 64;
+
+    class Worker_ final: private juce::Thread {
+    public:
+        explicit Worker_(const juce::String& name): juce::Thread{name}
+        {
+            juce::Thread::startThread();
+        }
+        ~Worker_()
+        {
+            juce::Thread::signalThreadShouldExit();
+            queue_.wake();
+            juce::Thread::stopThread(kStopWait);
+        }
+        template<class T, void (T::*MF)(Arg)> void Add(T* const object)
+        {
+            subscribers_.template add<T, MF>(object);
+        }
+        bool Push(const Value& event) noexcept
+        {
+            return queue_.try_push(event);
+        }
+    private:
+        constexpr static int kStopWait = 1000;
+        void run() override
+        {
+            std::array<Value, kWorkerBatch> batch;
+            while (!juce::Thread::threadShouldExit()) {
+                const auto count = queue_.wait_pop_bulk(batch); //woken on exit
+                for (size_t i = 0; i < count; ++i)
+                    subscribers_(batch[i]);
+            }
+        }
+        RSJ::callback_list<Capacity, Arg> subscribers_;
+        RSJ::mpsc_queue<Value, kWorkerQueue> queue_;
+    };
+
+    // keeps the latest event and delivers it once the message thread gets round to it
+    class Latest_ final: private juce::AsyncUpdater {
+    public:
+        ~Latest_()
+        {
+            cancelPendingUpdate();
+        }
+        void Set(const Value& event)
+        {
+            {
+                std::lock_guard<decltype(mutex_)> lock(mutex_);
+                value_ = event;
+            }
+            triggerAsyncUpdate(); //does nothing if already pending
+        }
+        RSJ::callback_list<1, Arg> subscriber;
+    private:
+        void handleAsyncUpdate() override
+        {
+            Value event;
+            {
+                std::lock_guard<decltype(mutex_)> lock(mutex_);
+                event = value_;
+            }
+            subscriber(event);
+        }
+        RSJ::RelaxTTasSpinLock mutex_;
+        Value value_{};
+    };
+
+    const juce::String name_;
+    Instrumentation::Metric& events_;
+    Instrumentation::Metric& dispatch_time_;
+    Instrumentation::Metric& dropped_;
+    RSJ::callback_list<Capacity, Arg> immediate_;
+    std::unique_ptr<Worker_> worker_owner_; //subscribing thread only
+    std::atomic<Worker_*> worker_{nullptr};
+    std::array<std::unique_ptr<Latest_>, Capacity> latest_;
+    std::atomic<size_t> latest_count_{0};
+};
+
+#endif  // EVENTCHANNEL_H_INCLUDED
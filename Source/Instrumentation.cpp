@@ -0,0 +1,287 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    Instrumentation.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "Instrumentation.h"
+#include <algorithm>
+#include <deque>
+#include <mutex>
+#ifdef MIDI2LR_ALLOCATION_HOOKS
+#include <cstdlib>
+#include <new>
+#endif
+
+namespace {
+    struct Entry {
+        Entry(const juce::String& entry_name, bool is_gauge): name{entry_name}, gauge{is_gauge}
+        {}
+        juce::String name;
+        bool gauge;
+        Instrumentation::Metric value{0};
+    };
+    struct ObjectEntry {
+        juce::String name;
+        const std::atomic_int* alive;
+        const std::atomic_int* created;
+    };
+    // entries are never removed, and a deque doesn't move them as it grows
+    struct Registry {
+        std::mutex mutex;
+        std::deque<Entry> metrics;
+        std::deque<ObjectEntry> objects;
+    };
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+    // separate from Registry, as measures may use metrics
+    struct MemoryRegistry {
+        std::mutex mutex;
+        std::vector<const MemoryAccount*> accounts;
+        std::map<juce::String, juce::int64> budgets; //bytes
+    };
+    MemoryRegistry& GetMemoryRegistry()
+    {
+        static MemoryRegistry registry;
+        return registry;
+    }
+#ifdef MIDI2LR_ALLOCATION_HOOKS
+    thread_local juce::uint64 thread_allocations{0};
+    std::atomic<juce::uint64> allocations{0};
+    std::atomic<juce::uint64> frees{0};
+#endif
+}
+
+juce::uint64 RSJ::ThreadAllocations() noexcept
+{
+#ifdef MIDI2LR_ALLOCATION_HOOKS
+    return thread_allocations;
+#else
+    return 0;
+#endif
+}
+
+Instrumentation::Metric& Instrumentation::Counter(const juce::String& name)
+{
+    return Metric_(name, false);
+}
+
+Instrumentation::Metric& Instrumentation::Gauge(const juce::String& name)
+{
+    return Metric_(name, true);
+}
+
+Instrumentation::Metric& Instrumentation::Metric_(const juce::String& name, bool gauge)
+{
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    for (auto& entry : registry.metrics)
+        if (entry.name == name && entry.gauge == gauge)
+            return entry.value;
+    registry.metrics.emplace_back(name, gauge);
+    return registry.metrics.back().value;
+}
+
+void Instrumentation::Objects_(const juce::String& name, const std::atomic_int& alive,
+    const std::atomic_int& created)
+{
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    for (const auto& entry : registry.objects)
+        if (entry.alive == &alive)
+            return;
+    registry.objects.push_back({name, &alive, &created});
+}
+
+juce::String Instrumentation::Report()
+{
+    juce::String report{"metric, value\n"};
+#ifdef MIDI2LR_ALLOCATION_HOOKS
+    report << "allocations, " << juce::String(allocations.load(std::memory_order_relaxed)) << "\n"
+        << "frees, " << juce::String(frees.load(std::memory_order_relaxed)) << "\n";
+#endif
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    for (const auto& entry : registry.metrics)
+        report << entry.name << ", " << juce::String(entry.value.load(std::memory_order_relaxed))
+        << "\n";
+    for (const auto& entry : registry.objects)
+        report << entry.name << " alive, " << juce::String(entry.alive->load()) << "\n"
+        << entry.name << " created, " << juce::String(entry.created->load()) << "\n";
+    return report;
+}
+
+std::vector<std::pair<juce::String, juce::int64>> Instrumentation::Values(bool gauges)
+{
+    std::vector<std::pair<juce::String, juce::int64>> values;
+#ifdef MIDI2LR_ALLOCATION_HOOKS
+    if (!gauges) {
+        values.emplace_back("allocations", static_cast<juce::int64>(allocations.load(
+            std::memory_order_relaxed)));
+        values.emplace_back("frees", static_cast<juce::int64>(frees.load(
+            std::memory_order_relaxed)));
+    }
+#endif
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    for (const auto& entry : registry.metrics)
+        if (entry.gauge == gauges)
+            values.emplace_back(entry.name, entry.value.load(std::memory_order_relaxed));
+    for (const auto& entry : registry.objects)
+        values.emplace_back(entry.name + (gauges ? " alive" : " created"),
+            (gauges ? entry.alive : entry.created)->load());
+    return values;
+}
+
+void Instrumentation::ResetCounters()
+{
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    for (auto& entry : registry.metrics)
+        if (!entry.gauge)
+            entry.value.store(0, std::memory_order_relaxed);
+}
+
+std::map<juce::String, juce::int64> Instrumentation::MemoryTotals()
+{
+    auto& registry = GetMemoryRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    std::map<juce::String, juce::int64> totals;
+    for (const auto account : registry.accounts)
+        totals[account->name_] += static_cast<juce::int64>(account->measure_());
+    return totals;
+}
+
+juce::String Instrumentation::MemoryReport()
+{
+    const auto totals = MemoryTotals();
+    auto& registry = GetMemoryRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    juce::String report{"memory, bytes, budget\n"};
+    juce::int64 total{0};
+    for (const auto& entry : totals) {
+        total += entry.second;
+        report << entry.first << ", " << juce::String(entry.second);
+        const auto budget = registry.budgets.find(entry.first);
+        if (budget != registry.budgets.end())
+            report << ", " << juce::String(budget->second) <<
+            (entry.second > budget->second ? " exceeded" : "");
+        report << "\n";
+    }
+    report << "total, " << juce::String(total) << "\n";
+    return report;
+}
+
+void Instrumentation::SetMemoryBudgets(const juce::String& budgets)
+{
+    auto& registry = GetMemoryRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    registry.budgets.clear();
+    for (const auto& entry : juce::StringArray::fromTokens(budgets, ";", "")) {
+        const auto name = entry.upToFirstOccurrenceOf("=", false, false).trim();
+        const auto kilobytes = entry.fromFirstOccurrenceOf("=", false, false).getLargeIntValue();
+        if (name.isNotEmpty() && kilobytes > 0)
+            registry.budgets[name] = kilobytes * 1024;
+    }
+}
+
+MemoryAccount::MemoryAccount(const juce::String& name, std::function<size_t()> measure):
+    name_{name}, measure_{std::move(measure)}
+{
+    auto& registry = GetMemoryRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    registry.accounts.push_back(this);
+}
+
+MemoryAccount::~MemoryAccount()
+{
+    auto& registry = GetMemoryRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    registry.accounts.erase(std::remove(registry.accounts.begin(), registry.accounts.end(), this),
+        registry.accounts.end());
+}
+
+#ifdef MIDI2LR_ALLOCATION_HOOKS
+// replacements for the global allocation functions, counting each call. The
+// remaining forms forward to these
+void* operator new(std::size_t size)
+{
+    ++thread_allocations;
+    allocations.fetch_add(1, std::memory_order_relaxed);
+    if (const auto memory = std::malloc(size ? size : 1))
+        return memory;
+    throw std::bad_alloc{};
+}
+
+void* operator new[](std::size_t size)
+{
+    return ::operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept
+{
+    try {
+        return ::operator new(size);
+    }
+    catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) noexcept
+{
+    return ::operator new(size, std::nothrow);
+}
+
+void operator delete(void* memory) noexcept
+{
+    if (memory) {
+        frees.fetch_add(1, std::memory_order_relaxed);
+        std::free(memory);
+    }
+}
+
+void operator delete[](void* memory) noexcept
+{
+    ::operator delete(memory);
+}
+
+void operator delete(void* memory, const std::nothrow_t&) noexcept
+{
+    ::operator delete(memory);
+}
+
+void operator delete[](void* memory, const std::nothrow_t&) noexcept
+{
+    ::operator delete(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    ::operator delete(memory);
+}
+
+void operator delete[](void* memory, std::size_t) noexcept
+{
+    ::operator delete(memory);
+}
+#endif
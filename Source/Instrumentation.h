@@ -0,0 +1,143 @@
+#pragma once
+/*
+  ==============================================================================
+
+    Instrumentation.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_INSTRUMENTATION_H_INCLUDED
+#define MIDI2LR_INSTRUMENTATION_H_INCLUDED
+
+#include <atomic>
+#include <functional>
+#include <map>
+#include <string>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Utilities/Utilities.h"
+
+namespace RSJ {
+#ifdef MIDI2LR_ALLOCATION_HOOKS
+    constexpr bool kAllocationHooks = true;
+#else
+    constexpr bool kAllocationHooks = false; //define MIDI2LR_ALLOCATION_HOOKS to count allocations
+#endif
+    // operator new calls made by the calling thread so far, 0 without the hooks
+    juce::uint64 ThreadAllocations() noexcept;
+
+    // heap bytes a container holds beyond its own object, for memory accounts. Node
+    // containers are estimates: the nodes' links and the bucket array
+    template<class T, class A>
+    size_t HeapBytes(const std::vector<T, A>& container) noexcept
+    {
+        return container.capacity() * sizeof(T);
+    }
+    inline size_t HeapBytes(const std::string& text) noexcept
+    {
+        return text.capacity() >= sizeof(std::string) ? text.capacity() + 1 : 0; //else inline
+    }
+    inline size_t HeapBytes(const juce::String& text) noexcept
+    {
+        return text.isEmpty() ? 0 : 2 * sizeof(size_t) + text.getNumBytesAsUTF8() + 1;
+    }
+    template<class K, class V, class C, class A>
+    size_t HeapBytes(const std::map<K, V, C, A>& container) noexcept
+    {
+        return container.size() *
+            (sizeof(typename std::map<K, V, C, A>::value_type) + 4 * sizeof(void*));
+    }
+    template<class K, class V, class H, class E, class A>
+    size_t HeapBytes(const std::unordered_map<K, V, H, E, A>& container) noexcept
+    {
+        return container.bucket_count() * sizeof(void*) + container.size() *
+            (sizeof(typename std::unordered_map<K, V, H, E, A>::value_type) + 2 * sizeof(void*));
+    }
+}
+
+// Named counters and gauges, and live-object counts of classes deriving from
+// RSJ::counter, for the diagnostics report. Register a metric once, usually into
+// a function-local static reference; updating it is then one relaxed atomic.
+// Any thread
+class Instrumentation {
+public:
+    using Metric = std::atomic<juce::int64>;
+    static Metric& Counter(const juce::String& name); //added to
+    static Metric& Gauge(const juce::String& name); //stored to
+    template<class T> static void Objects(const juce::String& name)
+    {
+        Objects_(name, RSJ::counter<T>::objects_alive, RSJ::counter<T>::objects_created);
+    }
+    static juce::String Report();
+    // the report's values as name and value, counters or gauges. Object counts are
+    // "name created" counters and "name alive" gauges
+    static std::vector<std::pair<juce::String, juce::int64>> Values(bool gauges);
+    // zeroes the counters; gauges and object counts are current values and stay
+    static void ResetCounters();
+    // bytes per subsystem from the live MemoryAccounts, against any budgets. Measures
+    // run on the calling thread, which should be the message thread
+    static juce::String MemoryReport();
+    // the memory report's bytes per subsystem, for comparing over time. Likewise
+    static std::map<juce::String, juce::int64> MemoryTotals();
+    // budgets as "subsystem=KB;...", marked in the memory report when exceeded
+    static void SetMemoryBudgets(const juce::String& budgets);
+
+private:
+    static Metric& Metric_(const juce::String& name, bool gauge);
+    static void Objects_(const juce::String& name, const std::atomic_int& alive,
+        const std::atomic_int& created);
+};
+
+// Adds the calling thread's allocations while in scope to counter, which stays 0
+// if the code in scope never allocates. Does nothing without the hooks
+// a subsystem's memory, measured when a memory report is made. Accounts with the same
+// name add up. Held as a member of what it measures, so the measure isn't called once
+// that has gone
+class MemoryAccount {
+public:
+    MemoryAccount(const juce::String& name, std::function<size_t()> measure);
+    ~MemoryAccount();
+    MemoryAccount(const MemoryAccount&) = delete;
+    MemoryAccount& operator=(const MemoryAccount&) = delete;
+
+private:
+    friend class Instrumentation;
+    const juce::String name_;
+    const std::function<size_t()> measure_;
+};
+
+class AllocationScope {
+public:
+    explicit AllocationScope(Instrumentation::Metric& counter) noexcept: counter_(counter),
+        start_{RSJ::ThreadAllocations()}
+    {}
+    ~AllocationScope()
+    {
+        if (RSJ::kAllocationHooks)
+            if (const auto count = RSJ::ThreadAllocations() - start_)
+                counter_.fetch_add(static_cast<juce::int64>(count), std::memory_order_relaxed);
+    }
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    Instrumentation::Metric& counter_;
+    const juce::uint64 start_;
+};
+
+#endif  // INSTRUMENTATION_H_INCLUDED
@@ -22,9 +22,11 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "LRCommands.h"
+#include <cstring>
 #include "CommandMap.h"
 
-const std::vector<std::string> LRCommandList::KeyShortcuts = {
+const std::array<const char*, LRCommandList::kReadableCount> LRCommandList::ReadableList = {{
+    /* Keyboard Shortcuts for User */
     "Key 1",
     "Key 2",
     "Key 3",
@@ -65,9 +67,7 @@ const std::vector<std::string> LRCommandList::KeyShortcuts = {
     "Key 38",
     "Key 39",
     "Key 40",
-};
-
-const std::vector<std::string> LRCommandList::Filters = {
+    /* Library filter */
     "Library filter 1",
     "Library filter 2",
     "Library filter 3",
@@ -80,9 +80,7 @@ const std::vector<std::string> LRCommandList::Filters = {
     "Library filter 10",
     "Library filter 11",
     "Library filter 12",
-};
-
-const std::vector<std::string> LRCommandList::General = {
+    /* General */
     "Primary Display Grid",
     "Primary Display Loupe",
     "Primary Display Compare",
@@ -105,9 +103,7 @@ const std::vector<std::string> LRCommandList::General = {
     "Series of commands 7",
     "Series of commands 8",
     "Series of commands 9",
-};
-
-const std::vector<std::string> LRCommandList::Library = {
+    /* Library */
     "Show Library",
     "Set Pick Flag",
     "Set Rejected Flag",
@@ -126,9 +122,7 @@ const std::vector<std::string> LRCommandList::Library = {
     "Label Purple Enable/Disable",
     "Label Yellow Enable/Disable",
     "Primary Display People",
-};
-
-const std::vector<std::string> LRCommandList::Develop = {
+    /* Develop */
     "Show Develop",
     "Lightroom Copy Settings",
     "Lightroom Paste Settings",
@@ -148,9 +142,7 @@ const std::vector<std::string> LRCommandList::Develop = {
     "Primary Display Reference View — Left/Right",
     "Primary Display Reference View — Top/Bottom",
     "Primary Display Loupe",
-};
-
-const std::vector<std::string> LRCommandList::BasicAdjustments = {
+    /* Basic */
     "Show Basic Tone",
     "White Balance As Shot",
     "White Balance Auto",
@@ -184,9 +176,7 @@ const std::vector<std::string> LRCommandList::BasicAdjustments = {
     "Reset Clarity",
     "Reset Vibrance",
     "Reset Saturation",
-};
-
-const std::vector<std::string> LRCommandList::ToneCurve = {
+    /* Tone Curve */
     "Show Tone Curve",
     "Enable Tone Curve",
     "Dark Tones",
@@ -206,9 +196,7 @@ const std::vector<std::string> LRCommandList::ToneCurve = {
     "Tone Curve Linear",
     "Tone Curve Medium Contrast",
     "Tone Curve Strong Contrast",
-};
-
-const std::vector<std::string> LRCommandList::Mixer = {
+    /* HSL / Color / B&W */
     "Show Color Adjustments",
     "Enable Color Adjustments",
     "Saturation Adjustment Red",
@@ -246,9 +234,7 @@ const std::vector<std::string> LRCommandList::Mixer = {
     "Gray Mixer Blue",
     "Gray Mixer Purple",
     "Gray Mixer Magenta",
-};
-
-const std::vector<std::string> LRCommandList::ResetMixer = {
+    /* Reset HSL / Color / B&W */
     "Reset Saturation Adjustment Red",
     "Reset Saturation Adjustment Orange",
     "Reset Saturation Adjustment Yellow",
@@ -282,9 +268,7 @@ const std::vector<std::string> LRCommandList::ResetMixer = {
     "Reset Gray Mixer Blue",
     "Reset Gray Mixer Purple",
     "Reset Gray Mixer Magenta",
-};
-
-const std::vector<std::string> LRCommandList::SplitToning = {
+    /* Split Toning */
     "Show Split Toning",
     "Enable Split Toning",
     "Shadow Hue",
@@ -297,9 +281,7 @@ const std::vector<std::string> LRCommandList::SplitToning = {
     "Reset Highlight Hue",
     "Reset Highlight Saturation",
     "Reset Split Toning Balance",
-};
-
-const std::vector<std::string> LRCommandList::Detail = {
+    /* Detail */
     "Show Detail",
     "Enable Detail",
     "Sharpness",
@@ -322,9 +304,7 @@ const std::vector<std::string> LRCommandList::Detail = {
     "Reset Color Noise Reduction",
     "Reset Color Noise Reduction Detail",
     "Reset Color Noise Reduction Smoothness",
-};
-
-const std::vector<std::string> LRCommandList::LensCorrections = {
+    /* Lens Corrections */
     "Show Lens Corrections",
     "Enable Lens Corrections",
     "Toggle Profile Corrections",
@@ -354,9 +334,7 @@ const std::vector<std::string> LRCommandList::LensCorrections = {
     "Reset Lens Manual Distortion Amount",
     "Reset Vignette Amount",
     "Reset Vignette Midpoint",
-};
-
-const std::vector<std::string> LRCommandList::Transform = {
+    /* Transform */
     "Show Transform",
     "Enable Transform",
     "Perspective Correction Off",
@@ -380,9 +358,7 @@ const std::vector<std::string> LRCommandList::Transform = {
     "Reset Perspective Aspect",
     "Reset Perspective X",
     "Reset Perspective Y",
-};
-
-const std::vector<std::string> LRCommandList::Effects = {
+    /* Effects */
     "Show Effects",
     "Enable Effects",
     "Dehaze Amount",
@@ -408,9 +384,7 @@ const std::vector<std::string> LRCommandList::Effects = {
     "Reset Grain Amount",
     "Reset Grain Size",
     "Reset Grain Roughness",
-};
-
-const std::vector<std::string> LRCommandList::Calibration = {
+    /* Camera Calibration */
     "Show Calibration",
     "Enable Calibration",
     "Adobe Standard",
@@ -448,9 +422,7 @@ const std::vector<std::string> LRCommandList::Calibration = {
     "Reset Green Saturation Calibration",
     "Reset Blue Hue Calibration",
     "Reset Blue Saturation Calibration",
-};
-
-const std::vector<std::string> LRCommandList::DevelopPresets = {
+    /* Develop Presets */
     "Develop Preset 1",
     "Develop Preset 2",
     "Develop Preset 3",
@@ -531,9 +503,7 @@ const std::vector<std::string> LRCommandList::DevelopPresets = {
     "Develop Preset 78",
     "Develop Preset 79",
     "Develop Preset 80",
-};
-
-const std::vector<std::string> LRCommandList::LocalAdjustments = {
+    /* Local Adjustments */
     "Show Graduated Filters",
     "Show Radial Filters",
     "Show Red-Eye Correction",
@@ -591,9 +561,7 @@ const std::vector<std::string> LRCommandList::LocalAdjustments = {
     "Local adjustments presets 6",
     "Local adjustments presets 7",
     "Local adjustments presets 8",
-};
-
-const std::vector<std::string> LRCommandList::Crop = {
+    /* Crop */
     "Straighten Angle",
     "Crop Angle",
     "Crop - Bottom",
@@ -603,18 +571,14 @@ const std::vector<std::string> LRCommandList::Crop = {
     "Reset Crop",
     "Reset Straighten Angle",
     "Show Crop",
-};
-
-const std::vector<std::string> LRCommandList::ToolModulePanel = {
+    /* Go to Tool, Module, or Panel */
     "Show Loupe",
     "Show Map",
     "Show Book",
     "Show Slideshow",
     "Show Print",
     "Show Web",
-};
-
-const std::vector<std::string> LRCommandList::SecondaryDisplay = {
+    /* Secondary Display */
     "Secondary Display Loupe",
     "Secondary Display Live Loupe",
     "Secondary Display Locked Loupe",
@@ -623,9 +587,7 @@ const std::vector<std::string> LRCommandList::SecondaryDisplay = {
     "Secondary Display Survey",
     "Secondary Display Slideshow",
     "Secondary Display Show",
-};
-
-const std::vector<std::string> LRCommandList::ProgramProfiles = {
+    /* Profiles */
     "Profile: 1",
     "Profile: 2",
     "Profile: 3",
@@ -637,7 +599,67 @@ const std::vector<std::string> LRCommandList::ProgramProfiles = {
     "Profile: 9",
     "Profile: 10",
     "Manual Update",
-};
+    /* Next/Prev Profile */
+    "Previous Profile",
+    "Next Profile",
+    /* Layers */
+    "Previous Layer",
+    "Next Layer",
+    "Base Layer",
+    "Layer 1",
+    "Layer 2",
+    "Layer 3",
+    "Modifier 1",
+    "Modifier 2",
+    /* Snapshots */
+    "Capture Snapshot A",
+    "Capture Snapshot B",
+    "Recall Snapshot A",
+    "Recall Snapshot B",
+    /* Reset Groups */
+    "Reset Group Basic",
+    "Reset Group Tone Curve",
+    "Reset Group Mixer",
+    "Reset Group Split Toning",
+    "Reset Group Detail",
+    "Reset Group Lens Corrections",
+    "Reset Group Transform",
+    "Reset Group Effects",
+    "Reset Group Camera Calibration",
+    /* Batch */
+    "Start Batch",
+    "Commit Batch to Selection",
+    "Discard Batch",
+}};
+
+const std::array<LRCommandList::MenuSection, LRCommandList::kMenuCount> LRCommandList::MenuSections = {{
+    {"Keyboard Shortcuts for User", 0, 40},
+    {"Library filter", 40, 12},
+    {"General", 52, 22},
+    {"Library", 74, 18},
+    {"Develop", 92, 19},
+    {"Basic", 111, 33},
+    {"Tone Curve", 144, 19},
+    {"HSL / Color / B&W", 163, 37},
+    {"Reset HSL / Color / B&W", 200, 33},
+    {"Split Toning", 233, 12},
+    {"Detail", 245, 22},
+    {"Lens Corrections", 267, 29},
+    {"Transform", 296, 23},
+    {"Effects", 319, 25},
+    {"Camera Calibration", 344, 37},
+    {"Develop Presets", 381, 80},
+    {"Local Adjustments", 461, 57},
+    {"Crop", 518, 9},
+    {"Go to Tool, Module, or Panel", 527, 6},
+    {"Secondary Display", 533, 8},
+    {"Profiles", 541, 11},
+    {"Next/Prev Profile", 552, 2},
+    {"Layers", 554, 8},
+    {"Snapshots", 562, 4},
+    {"Reset Groups", 566, 9},
+    {"Batch", 575, 3},
+}};
 
 const std::vector<std::string> LRCommandList::LRStringList = {
     "Unmapped",
@@ -1219,21 +1241,260 @@ const std::vector<std::string> LRCommandList::LRStringList = {
 const std::vector <std::string> LRCommandList::NextPrevProfile = {
     "Previous Profile",
     "Next Profile",
+    "Previous Layer",
+    "Next Layer",
+    "Base Layer",
+    "Layer 1",
+    "Layer 2",
+    "Layer 3",
+    "Modifier 1",
+    "Modifier 2",
+    "Capture Snapshot A",
+    "Capture Snapshot B",
+    "Recall Snapshot A",
+    "Recall Snapshot B",
+    "Reset Group Basic",
+    "Reset Group Tone Curve",
+    "Reset Group Mixer",
+    "Reset Group Split Toning",
+    "Reset Group Detail",
+    "Reset Group Lens Corrections",
+    "Reset Group Transform",
+    "Reset Group Effects",
+    "Reset Group Camera Calibration",
+    "Start Batch",
+    "Commit Batch to Selection",
+    "Discard Batch",
 };
 
-size_t LRCommandList::getIndexOfCommand(const std::string& command)
-{
-    static std::unordered_map<std::string, size_t> indexMap;
+namespace {
+    // minimal perfect hash over LRStringList followed by NextPrevProfile, generated
+    // by Build.lua. a key's bucket gives either its slot directly (negative entries)
+    // or the multiplier displacement that separates it from the bucket's other keys
+    constexpr size_t kCommandCount = 579;
+    const std::array<int, kCommandCount> kDisplacement = {{
+    -579, 2, -577, -576, 0, 0, 0, -573, 0, 6, 0, 0, 0, 0, 0, 0,
+    0, -571, 0, -570, 0, 0, -566, -562, -559, -555, 0, -554, 1, -552, -550, 0,
+    -549, -543, 2, 0, 1, -542, 2, 2, 2, 2, 0, 0, -539, 0, -538, 1,
+    -533, 0, 0, 0, -530, 0, 0, 0, 2, 0, 0, 0, 0, -520, 0, 3,
+    0, -519, 0, 1, 1, -518, -514, 0, -508, -507, 0, -505, -504, 0, 0, 0,
+    -503, 0, -498, 0, 0, -494, 9, 0, 0, 1, 0, 0, -492, 2, 0, -491,
+    -489, -486, -485, 0, 0, 0, -483, -480, 0, 1, 1, -477, 0, -472, 1, -470,
+    1, -469, 1, -468, -465, 0, 0, 0, -464, 1, 0, -458, -455, 1, 0, 2,
+    -452, 1, 2, -450, -449, 1, -448, -446, 0, -443, -439, 0, -437, 0, 0, 1,
+    1, 1, -428, -426, -425, 0, 1, 0, -423, -421, -420, -419, 6, 0, 1, -415,
+    2, -414, 3, -410, -409, 0, -406, 0, -404, 0, -403, -401, -399, 1, 0, 0,
+    0, 0, 0, 0, 0, -398, -397, 0, -396, -395, 0, -394, 5, 2, 0, 0,
+    0, 0, 0, -391, 0, 0, -390, 8, 0, 1, -385, 0, -381, 1, -380, 1,
+    1, -379, 1, 2, -374, 1, -373, 0, -372, -371, -370, 1, 0, 0, 0, 0,
+    0, 4, 0, -369, 3, -367, -365, 1, -364, -363, -361, -360, -358, 3, -355, 3,
+    0, -349, -348, -347, -345, 0, 0, -343, -340, -339, 0, -338, -336, 0, -332, -331,
+    -330, 0, 0, -329, -328, 6, -324, 2, 2, 2, 1, -310, 1, -306, -304, -302,
+    4, 1, 5, -301, 2, 1, 2, 0, 0, 1, 0, -295, 3, 0, -294, 0,
+    0, 0, 2, 0, 0, -291, 1, 4, 1, 4, 2, 3, 1, 1, 1, -289,
+    0, -288, 0, -286, 0, -285, -284, 0, 1, -282, -281, 1, 4, 1, -279, 1,
+    2, 0, -274, -272, -269, 0, 6, -267, -265, -264, 1, 6, -258, -257, 2, -251,
+    -250, 0, 0, 2, 4, 0, -249, 0, 0, -248, 0, 0, 0, 3, -236, 0,
+    3, 0, 0, -230, 0, 0, -229, -223, 1, -222, 2, 3, 1, 7, -221, 2,
+    -220, 3, 1, -219, 0, 0, 0, 0, 0, -218, 0, -217, 1, 0, 0, -215,
+    -214, 0, -213, 4, 0, 0, 0, 0, 0, 10, 2, -212, -208, -204, -193, 2,
+    -190, -186, -185, -176, 0, 0, 0, 4, 0, 0, 0, -175, 0, 0, -174, -173,
+    0, 0, -170, -169, -165, 0, 0, 0, 0, -163, 13, -160, 1, -159, -157, -153,
+    -152, 2, -148, -146, 0, -145, 0, 0, 0, 0, 0, -144, 0, -142, -141, -134,
+    0, -133, 0, -131, -129, 0, 4, 0, -126, -122, 0, 4, -120, -118, -114, -112,
+    -111, 2, -107, 2, -105, -104, 4, 3, -102, -99, -98, 2, 0, 0, 0, 0,
+    -94, -84, -81, 0, 3, 0, 0, 7, 3, 0, -79, -78, -76, -73, 4, 6,
+    2, 3, -72, 1, 2, 3, 0, 0, -71, -68, 0, -61, -58, 0, -57, 8,
+    -55, 0, 0, -53, 0, 0, -50, 1, -47, 4, 0, 0, 2, -44, 0, 7,
+    0, -42, 5, -35, -33, 2, 4, 4, 1, 2, 10, 0, 13, 0, 1, 1,
+    0, 11, -23, 0, -20, 0, 0, -14, 0, 0, 0, 6, 28, 3, -13, 4,
+    12, 10, 1, -12, 0, 0, 9, 0, 0, 0, 0, 0, -8, 0, -4, 1,
+    0, -1, 0,
+    }};
+    const std::array<unsigned short, kCommandCount> kSlotCommand = {{
+    194, 408, 366, 462, 248, 35, 43, 555, 11, 66, 530, 49, 44, 575, 498, 292,
+    553, 147, 372, 355, 155, 509, 206, 132, 193, 326, 209, 273, 565, 473, 236, 277,
+    68, 413, 67, 258, 495, 21, 418, 87, 431, 311, 245, 461, 232, 380, 502, 318,
+    319, 289, 503, 490, 190, 226, 347, 112, 310, 537, 381, 456, 576, 114, 506, 460,
+    63, 369, 544, 551, 257, 422, 115, 457, 452, 239, 427, 451, 94, 119, 286, 314,
+    274, 178, 205, 210, 266, 244, 309, 198, 512, 166, 416, 36, 516, 497, 315, 370,
+    62, 365, 219, 74, 298, 317, 192, 60, 450, 279, 448, 306, 478, 491, 446, 445,
+    438, 444, 377, 116, 267, 443, 163, 442, 359, 218, 135, 293, 181, 201, 40, 76,
+    295, 541, 103, 572, 207, 182, 77, 173, 532, 325, 86, 133, 525, 126, 221, 211,
+    276, 440, 220, 439, 447, 107, 449, 437, 436, 227, 349, 470, 435, 253, 434, 432,
+    141, 188, 105, 14, 275, 548, 378, 550, 333, 291, 282, 189, 96, 269, 136, 241,
+    146, 374, 186, 184, 134, 256, 200, 455, 430, 429, 539, 459, 250, 428, 75, 487,
+    426, 360, 568, 520, 2, 344, 4, 5, 26, 7, 28, 425, 339, 472, 172, 424,
+    215, 99, 261, 423, 260, 526, 55, 405, 197, 98, 302, 419, 417, 412, 562, 202,
+    124, 47, 305, 328, 561, 64, 31, 125, 33, 153, 364, 179, 37, 38, 39, 545,
+    203, 343, 129, 549, 577, 463, 484, 367, 368, 410, 409, 288, 216, 290, 161, 421,
+    407, 406, 346, 168, 330, 327, 534, 403, 402, 488, 401, 213, 160, 386, 278, 345,
+    0, 476, 573, 313, 109, 32, 388, 34, 384, 383, 574, 204, 357, 145, 271, 170,
+    400, 108, 30, 338, 139, 148, 157, 85, 559, 217, 307, 53, 547, 543, 91, 542,
+    499, 29, 519, 104, 392, 27, 394, 391, 480, 393, 130, 522, 334, 397, 398, 399,
+    223, 69, 144, 22, 554, 73, 312, 20, 528, 118, 350, 569, 301, 183, 113, 149,
+    78, 485, 351, 59, 88, 222, 540, 281, 464, 51, 228, 466, 142, 404, 533, 97,
+    174, 500, 285, 208, 42, 19, 154, 18, 17, 390, 16, 15, 13, 46, 12, 171,
+    10, 508, 246, 259, 156, 9, 567, 212, 70, 71, 6, 3, 1, 411, 340, 8,
+    342, 415, 238, 117, 162, 578, 150, 297, 247, 316, 252, 110, 564, 563, 191, 494,
+    92, 570, 373, 234, 396, 324, 123, 100, 102, 52, 79, 80, 81, 50, 180, 493,
+    335, 158, 336, 143, 505, 237, 284, 382, 84, 83, 385, 82, 387, 140, 389, 371,
+    199, 262, 57, 475, 120, 358, 481, 454, 341, 521, 479, 45, 465, 518, 557, 517,
+    515, 514, 151, 511, 566, 433, 299, 272, 61, 159, 375, 501, 72, 95, 468, 268,
+    263, 58, 513, 321, 169, 356, 233, 320, 231, 177, 376, 348, 529, 196, 283, 486,
+    414, 482, 167, 552, 255, 300, 420, 242, 524, 48, 235, 89, 93, 329, 127, 527,
+    264, 467, 510, 352, 225, 243, 106, 332, 536, 492, 254, 54, 523, 137, 214, 249,
+    441, 531, 362, 496, 138, 65, 471, 363, 361, 546, 507, 474, 128, 251, 164, 323,
+    458, 195, 322, 165, 560, 111, 294, 308, 187, 558, 483, 230, 395, 556, 571, 131,
+    379, 23, 24, 25, 331, 240, 504, 280, 41, 477, 304, 453, 90, 296, 122, 176,
+    469, 56, 489, 101, 121, 303, 265, 535, 287, 337, 224, 538, 152, 185, 354, 353,
+    229, 175, 270,
+    }};
+    // 1 for buttons and other discrete actions, 0 for continuous parameters
+    const std::array<unsigned char, kCommandCount> kAction = {{
+    0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 1,
+    1, 0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0,
+    0, 1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 0, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1,
+    1, 1, 1, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1, 0, 0, 0, 0, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 0, 0, 0, 0, 0, 0, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1, 1,
+    1, 1, 1,
+    }};
+    // values Lightroom distinguishes across the parameter's range, 0 if it doesn't round
+    const std::array<unsigned short, kCommandCount> kSteps = {{
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 300, 1000, 200, 200, 0,
+    200, 200, 200, 200, 200, 200, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 200, 200, 200, 200, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 200, 200, 200, 200, 200, 200, 200, 200, 0, 200,
+    200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 200, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 360, 100, 360, 100,
+    200, 0, 0, 0, 0, 0, 0, 0, 150, 25, 100, 100, 100, 100, 100, 100,
+    100, 100, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 200, 100, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 200, 200, 100, 100, 200, 0, 0, 0, 0, 100, 100, 100, 100, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    200, 200, 200, 200, 200, 200, 200, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+    0, 0, 0,
 
-    // better to check for empty then length, as empty has a constant run time behavior.
-    if (indexMap.empty()) {
-        size_t idx = 0;
-        for (const auto& str : LRStringList)
-            indexMap[str] = idx++;
+    }};
 
-        for (const auto& str : NextPrevProfile)
-            indexMap[str] = idx++;
+    juce::uint32 CommandHash(juce::uint32 displacement, const char* command,
+        size_t length) noexcept
+    {
+        juce::uint32 hash = 5381;
+        const auto multiplier = 33 + 2 * displacement;
+        for (size_t i = 0; i < length; ++i)
+            hash = hash * multiplier + static_cast<unsigned char>(command[i]);
+        return hash;
     }
+}
 
-    return indexMap[command];
+bool LRCommandList::isAction(size_t index) noexcept
+{
+    return index < kCommandCount && kAction[index] != 0;
+}
+
+unsigned LRCommandList::getSteps(size_t index) noexcept
+{
+    return index < kCommandCount ? kSteps[index] : 0u;
+}
+
+size_t LRCommandList::getTarget(size_t index)
+{
+    static const auto kTargets = [] {
+        const auto starts = [](const std::string& name, const char* prefix) noexcept {
+            return name.compare(0, std::strlen(prefix), prefix) == 0;
+        };
+        std::vector<size_t> targets(LRStringList.size(), kNotFound);
+        for (size_t i = 1; i < LRStringList.size(); ++i) {
+            const auto& name = LRStringList[i];
+            if (!isAction(i))
+                targets[i] = i;
+            else if (starts(name, "Reset")) {
+                const auto reset = getIndexOfCommand(name.substr(5));
+                targets[i] = reset != kNotFound && !isAction(reset) ? reset : kAllParameters;
+            }
+            else if (starts(name, "Preset_") || starts(name, "PasteSettings") ||
+                starts(name, "PasteSelectedSettings") || starts(name, "LRPaste") ||
+                starts(name, "Undo") || starts(name, "Redo") || starts(name, "AutoTone") ||
+                starts(name, "WhiteBalance"))
+                targets[i] = kAllParameters;
+        }
+        return targets;
+    }();
+    return index < kTargets.size() ? kTargets[index] : kNotFound;
+}
+
+bool LRCommandList::isDevelop(size_t index) noexcept
+{
+    // every Database parameter is a develop setting; MIDI2LR's own commands are actions
+    return index > 0 && index < LRStringList.size() && kAction[index] == 0;
+}
+
+size_t LRCommandList::getIndexOfCommand(const char* command, size_t length) noexcept
+{
+    // no runtime construction or mutation, so any thread may look up at any time
+    const auto displacement = kDisplacement[CommandHash(0, command, length) % kCommandCount];
+    const auto slot = displacement < 0 ? static_cast<size_t>(-displacement - 1) :
+        CommandHash(static_cast<juce::uint32>(displacement), command, length) % kCommandCount;
+    const size_t index = kSlotCommand[slot];
+    const auto list_size = LRStringList.size();
+    const auto& name = index < list_size ? LRStringList[index] : NextPrevProfile[index - list_size];
+    if (name.size() != length || name.compare(0, length, command, length) != 0)
+        return kNotFound;
+    return index;
 }
\ No newline at end of file
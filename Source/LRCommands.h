@@ -23,6 +23,8 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_LRCOMMANDS_H_INCLUDED
 #define MIDI2LR_LRCOMMANDS_H_INCLUDED
 
+#include <array>
+#include <limits>
 #include <string>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
@@ -32,33 +34,41 @@ class LRCommandList {
     // Strings that LR uses
     static const std::vector<std::string> LRStringList;
 
-    // Sectioned and readable develop param strings
-    static const std::vector<std::string> KeyShortcuts;
-    static const std::vector<std::string> Filters;
-    static const std::vector<std::string> General;
-    static const std::vector<std::string> Library;
-    static const std::vector<std::string> Develop;
-    static const std::vector<std::string> BasicAdjustments;
-    static const std::vector<std::string> ToneCurve;
-    static const std::vector<std::string> Mixer;
-    static const std::vector<std::string> ResetMixer;
-    static const std::vector<std::string> SplitToning;
-    static const std::vector<std::string> Detail;
-    static const std::vector<std::string> LensCorrections;
-    static const std::vector<std::string> Transform;
-    static const std::vector<std::string> Effects;
-    static const std::vector<std::string> Calibration;
-    static const std::vector<std::string> DevelopPresets;
-    static const std::vector<std::string> LocalAdjustments;
-    static const std::vector<std::string> Crop;
-    static const std::vector<std::string> ToolModulePanel;
-    static const std::vector<std::string> SecondaryDisplay;
-    static const std::vector<std::string> ProgramProfiles;
+    // Sectioned and readable command strings, in LRStringList order (less "Unmapped")
+    // followed by NextPrevProfile. constant-initialized, so nothing is built at startup
+    struct MenuSection {
+        const char* title;
+        size_t first; // index into ReadableList
+        size_t count;
+    };
+    constexpr static size_t kReadableCount = 578;
+    constexpr static size_t kMenuCount = 26;
+    static const std::array<const char*, kReadableCount> ReadableList;
+    static const std::array<MenuSection, kMenuCount> MenuSections;
+  // hash of LRStringList. The plugin sends its own on connect, and compact records,
+  // which carry LRStringList indices, are only used while the two match
+  constexpr static juce::uint32 kCommandHash = 2495353569u;
     // MIDI2LR commands
     static const std::vector<std::string> NextPrevProfile;
 
-    // Map of command strings to indices
-    static size_t getIndexOfCommand(const std::string& command);
+    // Map of command strings to indices, kNotFound for unknown strings
+    constexpr static size_t kNotFound = std::numeric_limits<size_t>::max();
+    static size_t getIndexOfCommand(const char* command, size_t length) noexcept;
+    static size_t getIndexOfCommand(const std::string& command) noexcept
+    {
+        return getIndexOfCommand(command.data(), command.size());
+    }
+    // buttons, keys, presets and other one-shot commands, as opposed to parameters
+    static bool isAction(size_t index) noexcept;
+    // values Lightroom keeps across the parameter's range, 0 for those it doesn't round
+    static unsigned getSteps(size_t index) noexcept;
+    // parameters the plugin sets through LrDevelopController, which need a target photo
+    static bool isDevelop(size_t index) noexcept;
+    // the parameter a command sets: a parameter itself, the one a "Reset" action resets,
+    // kAllParameters for actions that may set any (other resets, presets, paste, undo),
+    // else kNotFound
+    constexpr static size_t kAllParameters = kNotFound - 1;
+    static size_t getTarget(size_t index);
 
     LRCommandList() = delete;
 };
@@ -0,0 +1,133 @@
+--[[----------------------------------------------------------------------------
+
+Bench.lua
+
+Times the plugin's hot paths under plain Lua 5.1, without Lightroom:
+  lua Bench.lua [stream] [repeats]
+Client.lua is loaded against Stubs.lua and fed a message stream as MIDI2LR sends
+it, each line of the stream file being one socket message; '\n' within a line
+separates the lines of a coalesced message. Without a file a stream of fader
+moves over the develop parameters is made up. The stream is fed repeats times
+(default 10). ClientUtilities' conversions and Limits.GetMinMax are then timed on
+their own. Prints "benchmark, us/op, operations, sdk calls/op" CSV rows, so runs
+before and after a change can be compared line by line.
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+------------------------------------------------------------------------------]]
+
+local here = arg[0]:match('(.*)[/\\]') or '.'
+package.path = here .. '/?.lua;' .. package.path
+local Stubs = require 'Stubs'
+Stubs.Install(here .. '/../MIDI2LR.lrplugin')
+
+local SYNTHETIC = 4096 -- messages in the made-up stream
+local FRAME     = 8    -- lines per coalesced message in it
+local MICRO     = 100000 -- calls per conversion benchmark
+
+local function Row(name, seconds, operations, calls)
+  print(string.format('%s, %.3f, %d, %.2f', name, seconds * 1e6 / operations, operations,
+      calls / operations))
+end
+
+--------------------------------------------------------------------------------
+-- start the plugin: Client.lua's task binds its sockets and waits in its poll
+--------------------------------------------------------------------------------
+dofile(_PLUGIN.path .. '/Client.lua')
+Stubs.RunTasks()
+local receive = assert(Stubs.sockets.receive, 'Client.lua did not bind its receive socket')
+receive.params.onConnected(receive.socket)
+if Stubs.sockets.send then
+  Stubs.sockets.send.params.onConnected(Stubs.sockets.send.socket)
+end
+local CU        = require 'ClientUtilities'
+local Limits    = require 'Limits'
+local ParamList = require 'ParamList'
+
+--------------------------------------------------------------------------------
+-- the stream, from the file or made up
+--------------------------------------------------------------------------------
+local stream = {}
+local file = arg[1] and assert(io.open(arg[1]))
+if file then
+  for line in file:lines() do
+    if line ~= '' then
+      stream[#stream+1] = line:gsub('\\n', '\n') .. '\n'
+    end
+  end
+  file:close()
+else
+  local params = ParamList.SendToMidi
+  local lines = {}
+  for i = 1, SYNTHETIC * FRAME do
+    lines[#lines+1] = string.format('%s %g\n', params[i % #params + 1], (i % 128) / 127)
+    if #lines == FRAME then
+      stream[#stream+1] = table.concat(lines)
+      lines = {}
+    end
+  end
+end
+local repeats = tonumber(arg[2]) or 10
+
+--------------------------------------------------------------------------------
+-- message handling, per message and per command name
+--------------------------------------------------------------------------------
+print('benchmark, us/op, operations, sdk calls/op')
+local total, calls = 0, 0
+local bycommand = {} -- first command of the message -> {seconds, count, calls}
+for _ = 1, repeats do
+  for _, message in ipairs(stream) do
+    local before = Stubs.calls
+    local start = os.clock()
+    receive.params.onMessage(receive.socket, message)
+    Stubs.RunTasks() -- the develop values the message left to ApplySoon
+    local taken = os.clock() - start
+    total, calls = total + taken, calls + Stubs.calls - before
+    local command = message:match('^[^ \n]+')
+    local entry = bycommand[command] or {0, 0, 0}
+    entry[1], entry[2], entry[3] = entry[1] + taken, entry[2] + 1, entry[3] + Stubs.calls - before
+    bycommand[command] = entry
+  end
+  Stubs.sent = {}
+end
+Row('message', total, #stream * repeats, calls)
+local commands = {}
+for command in pairs(bycommand) do
+  commands[#commands+1] = command
+end
+table.sort(commands)
+for _, command in ipairs(commands) do
+  local entry = bycommand[command]
+  Row('message ' .. command, entry[1], entry[2], entry[3])
+end
+
+--------------------------------------------------------------------------------
+-- conversions, over the parameters MIDI2LR may send
+--------------------------------------------------------------------------------
+local params = ParamList.SendToMidi
+local function Time(name, operation)
+  local before = Stubs.calls
+  local start = os.clock()
+  for i = 1, MICRO do
+    operation(params[i % #params + 1], (i % 128) / 127)
+  end
+  Row(name, os.clock() - start, MICRO, Stubs.calls - before)
+end
+Time('MIDIValueToLRValue', CU.MIDIValueToLRValue)
+Time('LRValueToMIDIValue', function(param, value) CU.LRValueToMIDIValue(param, value * 100) end)
+Time('Limits.GetMinMax', Limits.GetMinMax)
+Time('Limits.GetMinMax after ClearRanges', function(param)
+    Limits.ClearRanges()
+    Limits.GetMinMax(param)
+  end)
+MIDI2LR.RUNNING = false -- the poll task ends
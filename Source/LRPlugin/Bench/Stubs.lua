@@ -0,0 +1,189 @@
+--[[----------------------------------------------------------------------------
+
+Stubs.lua
+
+Stands in for the parts of the Lightroom SDK the plugin's message handling uses,
+so Client.lua and its modules load under plain Lua 5.1. Develop values live in a
+table, sockets record what is sent, and tasks are coroutines run by RunTasks.
+Any SDK function not given here does nothing and returns nil.
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+------------------------------------------------------------------------------]]
+
+local Stubs = {
+  calls    = 0,  -- LrDevelopController.getValue/setValue/getRange calls
+  clock    = 0,  -- seconds, advanced only by Advance, so sleeping tasks stay asleep
+  observer = nil, -- the adjustment change observer Client.lua registers
+  sent     = {}, -- lines given to send sockets, cleared by the runner
+  sockets  = {}, -- bind parameters by mode, 'send' or 'receive'
+  values   = {}, -- develop values by parameter
+}
+
+-- an SDK namespace whose missing functions do nothing; calling it makes an object
+local function Namespace(fields)
+  return setmetatable(fields or {}, {
+      __index = function(t, key)
+        local f = function() end
+        rawset(t, key, f)
+        return f
+      end,
+      __call = function() return Namespace() end,
+    })
+end
+
+--------------------------------------------------------------------------------
+-- tasks: a coroutine per startAsyncTask, resumed by RunTasks once ready
+--------------------------------------------------------------------------------
+local tasks = {} -- coroutine -> clock at which it is ready
+
+local function Resume(task)
+  local ok, err = coroutine.resume(task)
+  if not ok then
+    error(debug.traceback(task, err), 0)
+  end
+  if coroutine.status(task) == 'dead' then
+    tasks[task] = nil
+  end
+end
+
+local function Suspend(seconds)
+  local task = coroutine.running()
+  if task and tasks[task] then -- outside a task there is nothing else to run
+    tasks[task] = Stubs.clock + (seconds or 0)
+    coroutine.yield()
+  end
+end
+
+local LrTasks = Namespace {
+  pcall = pcall,
+  sleep = Suspend,
+  yield = function() Suspend(0) end,
+  startAsyncTask = function(f)
+    tasks[coroutine.create(f)] = Stubs.clock -- runs at the next RunTasks, as in Lightroom
+  end,
+  canYield = function() return coroutine.running() ~= nil end,
+}
+
+-- resumes ready tasks until none is left ready
+function Stubs.RunTasks()
+  repeat
+    local ready = {}
+    for task, at in pairs(tasks) do
+      if at <= Stubs.clock then
+        ready[#ready+1] = task
+      end
+    end
+    for _, task in ipairs(ready) do
+      Resume(task)
+    end
+  until not ready[1]
+end
+
+-- moves the clock on, so tasks sleeping until then run at the next RunTasks
+function Stubs.Advance(seconds)
+  Stubs.clock = Stubs.clock + seconds
+end
+
+--------------------------------------------------------------------------------
+-- develop module with one photo, every parameter ranging 0 to 100 except those set
+--------------------------------------------------------------------------------
+Stubs.ranges = {Exposure = {-5, 5}, Temperature = {2000, 50000}, Tint = {-150, 150}}
+
+local photo = Namespace {
+  getDevelopSettings = function() return {} end,
+}
+local catalog = Namespace {
+  getTargetPhoto  = function() return photo end,
+  getTargetPhotos = function() return {photo} end,
+  withWriteAccessDo = function(_, _, f) f() end,
+}
+
+local LrDevelopController = Namespace {
+  getValue = function(param)
+    Stubs.calls = Stubs.calls + 1
+    return Stubs.values[param] or 0
+  end,
+  setValue = function(param, value)
+    Stubs.calls = Stubs.calls + 1
+    Stubs.values[param] = value
+  end,
+  getRange = function(param)
+    Stubs.calls = Stubs.calls + 1
+    local range = Stubs.ranges[param]
+    if range then return range[1], range[2] end
+    return 0, 100
+  end,
+  getSelectedTool = function() return 'loupe' end,
+  getProcessVersion = function() return 'Version 5' end,
+  addAdjustmentChangeObserver = function(_, observer, f)
+    Stubs.observer = function() f(observer) end
+  end,
+}
+
+--------------------------------------------------------------------------------
+-- sockets keep their bind parameters, so the runner can call onMessage
+--------------------------------------------------------------------------------
+local LrSocket = Namespace {
+  bind = function(params)
+    local socket = Namespace {
+      send = function(_, text) Stubs.sent[#Stubs.sent+1] = text end,
+    }
+    Stubs.sockets[params.mode] = {params = params, socket = socket}
+    return socket
+  end,
+}
+
+local prefs = {}
+local modules = {
+  LrApplication = Namespace {activeCatalog = function() return catalog end},
+  LrApplicationView = Namespace {getCurrentModuleName = function() return 'develop' end},
+  LrDevelopController = LrDevelopController,
+  LrFunctionContext = Namespace {
+    callWithContext = function(_, f, ...) return f(Namespace(), ...) end,
+  },
+  LrLocalization = Namespace {currentLanguage = function() return 'en' end},
+  LrPathUtils = Namespace {
+    child = function(parent, child) return parent .. '/' .. child end,
+    getStandardFilePath = function() return '.' end,
+    parent = function(path) return path:match('(.*)[/\\]') or '.' end,
+  },
+  LrPrefs = Namespace {prefsForPlugin = function() return prefs end},
+  LrRecursionGuard = function()
+    return {performWithGuard = function(_, f, ...) return f(...) end}
+  end,
+  LrSocket = LrSocket,
+  LrStringUtils = Namespace {
+    lower = string.lower,
+    trimWhitespace = function(s) return (s:gsub('^%s+', ''):gsub('%s+$', '')) end,
+  },
+  LrTasks = LrTasks,
+}
+
+--------------------------------------------------------------------------------
+-- Installs the SDK globals and module path for the plugin at path.
+--------------------------------------------------------------------------------
+function Stubs.Install(path)
+  _PLUGIN = {path = path, id = 'net.rsjaffe.midi2lr'}
+  WIN_ENV = package.config:sub(1, 1) == '\\'
+  MAC_ENV = not WIN_ENV
+  LOC = function(s) return s:match('=(.*)$') or s end
+  import = function(name)
+    modules[name] = modules[name] or Namespace()
+    return modules[name]
+  end
+  package.path = path .. '/?.lua;' .. package.path
+  package.loaded['Database'] = true -- ParamList.lua and MenuList.lua are not rewritten
+end
+
+return Stubs
@@ -25,9 +25,9 @@ local Database     = require 'Database'
 local LrPathUtils  = import 'LrPathUtils'       
 
 local menulocation = ""
-local menus_ = 'menus_({ '
-local menu_entries_ = 'menu_entries_({ '
-local lrcommandsh = ''
+local menusections = ''
+local readablecount = 0
+local menucount = 0
 
 
 local datafile = LrPathUtils.child(_PLUGIN.path, 'Commands.md')
@@ -85,26 +85,42 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "CommandMap.h"
   
 ]=])
+file:write("const std::array<const char*, LRCommandList::kReadableCount> LRCommandList::ReadableList = {{\n")
+local sectionfirst = 0
 for _,v in ipairs(Database.DataBase) do
   if v[4] then
     if v[9] ~= menulocation then
       if menulocation~="" then
-        file:write("};\n\n")
+        menusections = menusections .. '{"' .. Database.cppvectors[menulocation][2] .. '", ' .. sectionfirst .. ', ' .. (readablecount - sectionfirst) .. '},\n'
+        menucount = menucount + 1
       end
-      file:write("const std::vector<std::string> LRCommandList::"..Database.cppvectors[v[9]][1].." = {\n")
       menulocation = v[9]
-      menus_ = menus_ .. '"' .. Database.cppvectors[v[9]][2] .. '", '
-      menu_entries_ = menu_entries_ .. 'LRCommandList::' .. Database.cppvectors[v[9]][1] .. ', '
-      lrcommandsh = lrcommandsh .. '\nstatic const std::vector<std::string> ' .. Database.cppvectors[v[9]][1] ..';'
+      sectionfirst = readablecount
+      file:write("/* "..Database.cppvectors[v[9]][2].." */\n")
     end
     file:write('"'..v[8]..'",\n')
+    readablecount = readablecount + 1
   end
 end
-menus_ = menus_ .. '"Next/Prev Profile" })'
-menu_entries_ = menu_entries_ .. 'LRCommandList::NextPrevProfile })'
-lrcommandsh = lrcommandsh .. '\n'
-
-file:write("};\n\nconst std::vector<std::string> LRCommandList::LRStringList = {\n\"Unmapped\",\n")
+menusections = menusections .. '{"' .. Database.cppvectors[menulocation][2] .. '", ' .. sectionfirst .. ', ' .. (readablecount - sectionfirst) .. '},\n'
+menusections = menusections .. '{"Next/Prev Profile", ' .. readablecount .. ', 2},\n'
+menusections = menusections .. '{"Layers", ' .. (readablecount + 2) .. ', 8},\n'
+menusections = menusections .. '{"Snapshots", ' .. (readablecount + 10) .. ', 4},\n'
+menusections = menusections .. '{"Reset Groups", ' .. (readablecount + 14) .. ', 9},\n'
+menusections = menusections .. '{"Batch", ' .. (readablecount + 23) .. ', 3},\n'
+menucount = menucount + 6
+file:write('/* Next/Prev Profile */\n"Previous Profile",\n"Next Profile",\n')
+file:write('/* Layers */\n"Previous Layer",\n"Next Layer",\n"Base Layer",\n"Layer 1",\n"Layer 2",\n"Layer 3",\n"Modifier 1",\n"Modifier 2",\n')
+file:write('/* Snapshots */\n"Capture Snapshot A",\n"Capture Snapshot B",\n"Recall Snapshot A",\n"Recall Snapshot B",\n')
+file:write('/* Reset Groups */\n"Reset Group Basic",\n"Reset Group Tone Curve",\n"Reset Group Mixer",\n"Reset Group Split Toning",\n"Reset Group Detail",\n"Reset Group Lens Corrections",\n"Reset Group Transform",\n"Reset Group Effects",\n"Reset Group Camera Calibration",\n')
+file:write('/* Batch */\n"Start Batch",\n"Commit Batch to Selection",\n"Discard Batch",\n}};\n\n')
+readablecount = readablecount + 26
+file:write("const std::array<LRCommandList::MenuSection, LRCommandList::kMenuCount> LRCommandList::MenuSections = {{\n",menusections,"}};\n")
+
+file:write("\nconst std::vector<std::string> LRCommandList::LRStringList = {\n\"Unmapped\",\n")
+local commandkeys = {"Unmapped"}
+local actions = {[0] = 0}
+local steps = {[0] = 0}
 menulocation = ""
 for _,v in ipairs(Database.DataBase) do
   if v[4] then
@@ -113,29 +129,219 @@ for _,v in ipairs(Database.DataBase) do
       file:write("/* "..menulocation.." */\n")
     end
     file:write('"'..v[1]..'",\n')
+    commandkeys[#commandkeys + 1] = v[1]
+    actions[#commandkeys - 1] = v[6] and 1 or 0
+    steps[#commandkeys - 1] = Database.steps[v[1]] or 0
+  end
+end
+-- hash of LRStringList for kCommandHash. must match COMMAND_HASH in Client.lua
+local commandlisthash = 0
+for _,command in ipairs(commandkeys) do
+  local line = command .. '\n'
+  for i = 1, #line do
+    commandlisthash = (commandlisthash * 31 + line:byte(i)) % 4294967296
+  end
+end
+-- MIDI2LR's own commands, all one-shot
+for _,command in ipairs {"Previous Profile", "Next Profile", "Previous Layer", "Next Layer",
+  "Base Layer", "Layer 1", "Layer 2", "Layer 3", "Modifier 1", "Modifier 2",
+  "Capture Snapshot A", "Capture Snapshot B", "Recall Snapshot A", "Recall Snapshot B",
+  "Reset Group Basic", "Reset Group Tone Curve", "Reset Group Mixer", "Reset Group Split Toning",
+  "Reset Group Detail", "Reset Group Lens Corrections", "Reset Group Transform",
+  "Reset Group Effects", "Reset Group Camera Calibration",
+  "Start Batch", "Commit Batch to Selection", "Discard Batch"} do
+  commandkeys[#commandkeys + 1] = command
+  actions[#commandkeys - 1] = 1
+  steps[#commandkeys - 1] = 0
+end
+
+-- minimal perfect hash over commandkeys (hash and displace). must match
+-- CommandHash in the generated LRCommands.cpp
+local function commandhash(displacement, command)
+  local hash = 5381
+  local multiplier = 33 + 2 * displacement
+  for i = 1, #command do
+    hash = (hash * multiplier + command:byte(i)) % 4294967296
+  end
+  return hash
+end
+
+local function perfecthash(keys) -- key at keys[i] has command index i - 1
+  local count = #keys
+  local buckets, displacement, slotcommand = {}, {}, {}
+  for b = 0, count - 1 do
+    buckets[b] = {}
+    displacement[b] = 0
+    slotcommand[b] = -1
+  end
+  for i, key in ipairs(keys) do
+    local bucket = buckets[commandhash(0, key) % count]
+    bucket[#bucket + 1] = i - 1
+  end
+  -- place crowded buckets first, ties by bucket number so output is repeatable
+  local order = {}
+  for b = 0, count - 1 do
+    order[b + 1] = b
+  end
+  table.sort(order, function(a, b)
+      if #buckets[a] ~= #buckets[b] then
+        return #buckets[a] > #buckets[b]
+      end
+      return a < b
+    end)
+  local pos = 1
+  while pos <= count and #buckets[order[pos]] > 1 do
+    local bucket = buckets[order[pos]]
+    local d = 0
+    local slots
+    repeat
+      d = d + 1
+      slots = {}
+      local used = {}
+      for _, index in ipairs(bucket) do
+        local slot = commandhash(d, keys[index + 1]) % count
+        if slotcommand[slot] ~= -1 or used[slot] then
+          slots = nil
+          break
+        end
+        used[slot] = true
+        slots[#slots + 1] = slot
+      end
+    until slots
+    displacement[order[pos]] = d
+    for j, index in ipairs(bucket) do
+      slotcommand[slots[j]] = index
+    end
+    pos = pos + 1
   end
+  -- single-key buckets go straight to the remaining free slots
+  local free = {}
+  for s = 0, count - 1 do
+    if slotcommand[s] == -1 then
+      free[#free + 1] = s
+    end
+  end
+  while pos <= count and #buckets[order[pos]] == 1 do
+    local slot = table.remove(free)
+    displacement[order[pos]] = -slot - 1
+    slotcommand[slot] = buckets[order[pos]][1]
+    pos = pos + 1
+  end
+  for s = 0, count - 1 do
+    if slotcommand[s] == -1 then
+      slotcommand[s] = 0
+    end
+  end
+  return displacement, slotcommand
+end
+
+local function cpprows(values, count)
+  local rows = {}
+  for first = 0, count - 1, 16 do
+    local row = {}
+    for i = first, math.min(first + 15, count - 1) do
+      row[#row + 1] = tostring(values[i])
+    end
+    rows[#rows + 1] = '    ' .. table.concat(row, ', ') .. ','
+  end
+  return table.concat(rows, '\n')
 end
+
+local displacement, slotcommand = perfecthash(commandkeys)
 file:write([=[};
 
 const std::vector <std::string> LRCommandList::NextPrevProfile = {
   "Previous Profile",
   "Next Profile",
+  "Previous Layer",
+  "Next Layer",
+  "Base Layer",
+  "Layer 1",
+  "Layer 2",
+  "Layer 3",
+  "Modifier 1",
+  "Modifier 2",
+  "Capture Snapshot A",
+  "Capture Snapshot B",
+  "Recall Snapshot A",
+  "Recall Snapshot B",
+  "Reset Group Basic",
+  "Reset Group Tone Curve",
+  "Reset Group Mixer",
+  "Reset Group Split Toning",
+  "Reset Group Detail",
+  "Reset Group Lens Corrections",
+  "Reset Group Transform",
+  "Reset Group Effects",
+  "Reset Group Camera Calibration",
+  "Start Batch",
+  "Commit Batch to Selection",
+  "Discard Batch",
 };
 
-size_t LRCommandList::getIndexOfCommand(const std::string& command) {
-  static std::unordered_map<std::string, size_t> indexMap;
-
-  // better to check for empty then length, as empty has a constant run time behavior.
-  if (indexMap.empty()) {
-    size_t idx = 0;
-    for (const auto& str : LRStringList)
-      indexMap[str] = idx++;
-
-    for (const auto& str : NextPrevProfile)
-      indexMap[str] = idx++;
-  }
-
-  return indexMap[command];
+namespace {
+    // minimal perfect hash over LRStringList followed by NextPrevProfile, generated
+    // by Build.lua. a key's bucket gives either its slot directly (negative entries)
+    // or the multiplier displacement that separates it from the bucket's other keys
+    constexpr size_t kCommandCount = ]=],#commandkeys,[=[;
+    const std::array<int, kCommandCount> kDisplacement = {{
+]=],cpprows(displacement, #commandkeys),[=[
+
+    }};
+    const std::array<unsigned short, kCommandCount> kSlotCommand = {{
+]=],cpprows(slotcommand, #commandkeys),[=[
+
+    }};
+    // 1 for buttons and other discrete actions, 0 for continuous parameters
+    const std::array<unsigned char, kCommandCount> kAction = {{
+]=],cpprows(actions, #commandkeys),[=[
+
+    }};
+    // values Lightroom distinguishes across the parameter's range, 0 if it doesn't round
+    const std::array<unsigned short, kCommandCount> kSteps = {{
+]=],cpprows(steps, #commandkeys),[=[
+
+    }};
+
+    juce::uint32 CommandHash(juce::uint32 displacement, const char* command,
+        size_t length) noexcept
+    {
+        juce::uint32 hash = 5381;
+        const auto multiplier = 33 + 2 * displacement;
+        for (size_t i = 0; i < length; ++i)
+            hash = hash * multiplier + static_cast<unsigned char>(command[i]);
+        return hash;
+    }
+}
+
+bool LRCommandList::isAction(size_t index) noexcept
+{
+    return index < kCommandCount && kAction[index] != 0;
+}
+
+unsigned LRCommandList::getSteps(size_t index) noexcept
+{
+    return index < kCommandCount ? kSteps[index] : 0u;
+}
+
+bool LRCommandList::isDevelop(size_t index) noexcept
+{
+    // every Database parameter is a develop setting; MIDI2LR's own commands are actions
+    return index > 0 && index < LRStringList.size() && kAction[index] == 0;
+}
+
+size_t LRCommandList::getIndexOfCommand(const char* command, size_t length) noexcept
+{
+    // no runtime construction or mutation, so any thread may look up at any time
+    const auto displacement = kDisplacement[CommandHash(0, command, length) % kCommandCount];
+    const auto slot = displacement < 0 ? static_cast<size_t>(-displacement - 1) :
+        CommandHash(static_cast<juce::uint32>(displacement), command, length) % kCommandCount;
+    const size_t index = kSlotCommand[slot];
+    const auto list_size = LRStringList.size();
+    const auto& name = index < list_size ? LRStringList[index] : NextPrevProfile[index - list_size];
+    if (name.size() != length || name.compare(0, length, command, length) != 0)
+        return kNotFound;
+    return index;
 }]=])
 file:close()
 
@@ -148,16 +354,11 @@ file:write ([=[Running Build.lua generates several files that need to be
   Limits-Available-Parameters.md and Commands.md. These files need to replace the
   current files in the wiki.
   
-  Following are two items, first some code that may need to be pasted into
-  CommandMenu.cpp, and then test results for the database.
+  Following are the test results for the database. CommandMenu.cpp reads its
+  submenus from LRCommandList::MenuSections, so it needs no changes when the
+  sections change.
   
-  CommandMenu.cpp initializers. If the number of command menu submenus
-  have changed, the following 'menus_' and 'menu_entries_' statements should replace
-  the ones in CommandMenu.cpp. Because CommandMenu.cpp has so much other code,
-  Build.lua does not automatically generate CommandMenu.cpp, so the person
-  building the application needs to update CommandMenu.cpp as needed.
-  
-  ]=],menus_,',\n\n',menu_entries_)
+  ]=])
 file:write("\n\nRunning Tests\n\n",Database.RunTests(),"\nTests Completed")
 file:close()
 
@@ -188,6 +389,8 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_LRCOMMANDS_H_INCLUDED
 #define MIDI2LR_LRCOMMANDS_H_INCLUDED
 
+#include <array>
+#include <limits>
 #include <string>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
@@ -197,12 +400,36 @@ public:
     // Strings that LR uses
   static const std::vector<std::string> LRStringList;
 
-  // Sectioned and readable develop param strings]=],lrcommandsh,[=[
+  // Sectioned and readable command strings, in LRStringList order (less "Unmapped")
+  // followed by NextPrevProfile. constant-initialized, so nothing is built at startup
+  struct MenuSection {
+    const char* title;
+    size_t first; // index into ReadableList
+    size_t count;
+  };
+  constexpr static size_t kReadableCount = ]=],readablecount,[=[;
+  constexpr static size_t kMenuCount = ]=],menucount,[=[;
+  static const std::array<const char*, kReadableCount> ReadableList;
+  static const std::array<MenuSection, kMenuCount> MenuSections;
+  // hash of LRStringList. The plugin sends its own on connect, and compact records,
+  // which carry LRStringList indices, are only used while the two match
+  constexpr static juce::uint32 kCommandHash = ]=],string.format('%.0f', commandlisthash),[=[u;
   // MIDI2LR commands
   static const std::vector<std::string> NextPrevProfile;
 
-  // Map of command strings to indices
-  static size_t getIndexOfCommand(const std::string& command);
+  // Map of command strings to indices, kNotFound for unknown strings
+  constexpr static size_t kNotFound = std::numeric_limits<size_t>::max();
+  static size_t getIndexOfCommand(const char* command, size_t length) noexcept;
+  static size_t getIndexOfCommand(const std::string& command) noexcept
+  {
+    return getIndexOfCommand(command.data(), command.size());
+  }
+  // buttons, keys, presets and other one-shot commands, as opposed to parameters
+  static bool isAction(size_t index) noexcept;
+  // values Lightroom keeps across the parameter's range, 0 for those it doesn't round
+  static unsigned getSteps(size_t index) noexcept;
+  // parameters the plugin sets through LrDevelopController, which need a target photo
+  static bool isDevelop(size_t index) noexcept;
 
   LRCommandList() = delete;
 };
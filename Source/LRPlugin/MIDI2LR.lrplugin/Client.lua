@@ -45,6 +45,7 @@ LrTasks.startAsyncTask(
       local Info           = require 'Info'
       local appdatafile     = LrPathUtils.child(_PLUGIN.path, 'MenuList.lua')
       local plugindatafile  = LrPathUtils.child(_PLUGIN.path, 'ParamList.lua')
+      local pastedatafile   = LrPathUtils.child(_PLUGIN.path, 'PasteMenu.lua')
       local versionmismatch = false
 
       if ProgramPreferences.DataStructure == nil then
@@ -59,6 +60,7 @@ LrTasks.startAsyncTask(
       versionmismatch or
       LrFileUtils.exists(appdatafile) ~= 'file' or
       LrFileUtils.exists(plugindatafile) ~= 'file' or
+      LrFileUtils.exists(pastedatafile) ~= 'file' or
       ProgramPreferences.DataStructure.language ~= LrLocalization.currentLanguage()
       then
         require 'Database'
@@ -66,7 +68,7 @@ LrTasks.startAsyncTask(
         for k,v in pairs(Info.VERSION) do
           ProgramPreferences.DataStructure.version[k] = v
         end
-        Preferences.Save() --ensure that new version/language info saved
+        Preferences.SaveSections('DataStructure') --ensure that new version/language info saved
       end
     end --save localized file for app
 
@@ -82,20 +84,69 @@ LrTasks.startAsyncTask(
     local LrApplication       = import 'LrApplication'
     local LrApplicationView   = import 'LrApplicationView'
     local LrDevelopController = import 'LrDevelopController'
-    local LrDialogs           = import 'LrDialogs'
     local LrSelection         = import 'LrSelection'
-    local LrStringUtils       = import 'LrStringUtils'
     local LrUndo              = import 'LrUndo'
     --global variables
-    MIDI2LR = {PARAM_OBSERVER = {}, SERVER = {}, CLIENT = {}, RUNNING = true} --non-local but in MIDI2LR namespace
+    MIDI2LR = {PARAM_OBSERVER = {}, SERVER = {}, CLIENT = {}, RUNNING = true, IDLE = false} --non-local but in MIDI2LR namespace
     --local variables
     local LastParam           = ''
+    local WatchedParams       = ParamList.SendToMidi -- narrowed once MIDI2LR sends MappedParams
     local UpdateParamPickup, UpdateParamNoPickup, UpdateParam
+    local Prepare -- resolves a profile's mapped commands ahead of use, set by the task
+    -- handler timings, kept only while MIDI2LR asks for them (LuaTiming seconds): calls,
+    -- total and worst seconds per handler, reported every TimingInterval seconds and
+    -- started afresh. onMessage's time includes the handlers it calls
+    local Timings, TimingInterval, TimingSent = nil, 0, 0
+    local function Timed(name, start) -- start is Timings and os.clock() before the call
+      if start and Timings then
+        local taken = os.clock() - start
+        local entry = Timings[name]
+        if entry then
+          entry[1], entry[2] = entry[1] + 1, entry[2] + taken
+          if taken > entry[3] then
+            entry[3] = taken
+          end
+        else
+          Timings[name] = {1, taken, taken}
+        end
+      end
+    end
     --local constants--may edit these to change program behaviors
     local BUTTON_ON        = 0.40 -- sending 1.0, but use > BUTTON_ON because of note keypressess not hitting 100%
     local PICKUP_THRESHOLD = 0.03 -- roughly equivalent to 4/127
     local RECEIVE_PORT     = 58763
     local SEND_PORT        = 58764
+    -- the SDK has no module or tool change notification, so profiles are checked as
+    -- soon as controller input or a develop adjustment arrives, at most every
+    -- PROFILE_RECHECK seconds, and otherwise by a slow poll for an idle controller
+    local PROFILE_POLL     = 1.0
+    -- while MIDI2LR reports its controllers idle (PowerIdle 1) the poll only checks for
+    -- shutdown; the controller input that wakes MIDI2LR checks profiles again
+    local IDLE_POLL        = 5.0
+    local PROFILE_RECHECK  = 0.05
+    -- compact records from MIDI2LR: '#', command id in two 6-bit digits, value in three,
+    -- each digit offset by '0'. Ids index LRStringList, which Build.lua generates from
+    -- the same database, with 0 for Unmapped. COMMAND_HASH goes with the announcement,
+    -- and MIDI2LR keeps sending names unless it matches its kCommandHash
+    local COMPACT_MARK     = string.byte('#')
+    local DIGIT_BASE       = string.byte('0')
+    local COMPACT_SCALE    = 262143
+    local COMMAND_IDS      = {[0] = 'Unmapped'} -- ParamList holds them, so Database isn't run at start
+    for i,v in ipairs(ParamList.CommandIds or {}) do -- a stale file fails the hash check
+      COMMAND_IDS[i] = v
+    end
+    -- a relative control's move rather than a value always carries its sign,
+    -- e.g. 'Exposure +0.007874', and is added to Lightroom's value
+    local DELTA_PLUS       = string.byte('+')
+    local DELTA_MINUS      = string.byte('-')
+    local COMMAND_HASH     = 0 -- computed as Build.lua does for kCommandHash
+    for i = 0, #COMMAND_IDS do
+      local line = COMMAND_IDS[i] .. '\n'
+      for j = 1, #line do
+        COMMAND_HASH = (COMMAND_HASH * 31 + line:byte(j)) % 4294967296
+      end
+    end
+    local COMPACT_ANNOUNCE = string.format('CompactProtocol 1 %.0f\n', COMMAND_HASH)
 
     local ACTIONS = {
       AdjustmentBrush          = CU.fToggleTool('localized'),
@@ -138,46 +189,46 @@ LrTasks.startAsyncTask(
       GraduatedFilter                        = CU.fToggleTool('gradient'),
       IncreaseRating                         = LrSelection.increaseRating,
       IncrementLastDevelopParameter          = function() Ut.execFOM(LrDevelopController.increment,LastParam) end,
-      Key1  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(1))) end,
-      Key2  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(2))) end,
-      Key3  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(3))) end,
-      Key4  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(4))) end,
-      Key5  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(5))) end,
-      Key6  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(6))) end,
-      Key7  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(7))) end,
-      Key8  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(8))) end,
-      Key9  = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(9))) end,
-      Key10 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(10))) end,
-      Key11 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(11))) end,
-      Key12 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(12))) end,
-      Key13 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(13))) end,
-      Key14 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(14))) end,
-      Key15 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(15))) end,
-      Key16 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(16))) end,
-      Key17 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(17))) end,
-      Key18 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(18))) end,
-      Key19 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(19))) end,
-      Key20 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(20))) end,
-      Key21 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(21))) end,
-      Key22 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(22))) end,
-      Key23 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(23))) end,
-      Key24 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(24))) end,
-      Key25 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(25))) end,
-      Key26 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(26))) end,
-      Key27 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(27))) end,
-      Key28 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(28))) end,
-      Key29 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(29))) end,
-      Key30 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(30))) end,
-      Key31 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(31))) end,
-      Key32 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(32))) end,
-      Key33 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(33))) end,
-      Key34 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(34))) end,
-      Key35 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(35))) end,
-      Key36 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(36))) end,
-      Key37 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(37))) end,
-      Key38 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(38))) end,
-      Key39 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(39))) end,
-      Key40 = function() MIDI2LR.SERVER:send(string.format('SendKey %s\n', Keys.GetKey(40))) end,
+      Key1  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(1)) end,
+      Key2  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(2)) end,
+      Key3  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(3)) end,
+      Key4  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(4)) end,
+      Key5  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(5)) end,
+      Key6  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(6)) end,
+      Key7  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(7)) end,
+      Key8  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(8)) end,
+      Key9  = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(9)) end,
+      Key10 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(10)) end,
+      Key11 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(11)) end,
+      Key12 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(12)) end,
+      Key13 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(13)) end,
+      Key14 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(14)) end,
+      Key15 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(15)) end,
+      Key16 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(16)) end,
+      Key17 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(17)) end,
+      Key18 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(18)) end,
+      Key19 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(19)) end,
+      Key20 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(20)) end,
+      Key21 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(21)) end,
+      Key22 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(22)) end,
+      Key23 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(23)) end,
+      Key24 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(24)) end,
+      Key25 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(25)) end,
+      Key26 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(26)) end,
+      Key27 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(27)) end,
+      Key28 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(28)) end,
+      Key29 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(29)) end,
+      Key30 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(30)) end,
+      Key31 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(31)) end,
+      Key32 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(32)) end,
+      Key33 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(33)) end,
+      Key34 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(34)) end,
+      Key35 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(35)) end,
+      Key36 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(36)) end,
+      Key37 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(37)) end,
+      Key38 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(38)) end,
+      Key39 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(39)) end,
+      Key40 = function() MIDI2LR.SERVER:send(Keys.GetKeyCommand(40)) end,
       LocalPreset1 = function() LocalPresets.ApplyLocalPreset(ProgramPreferences.LocalPresets[1]) end,
       LocalPreset2 = function() LocalPresets.ApplyLocalPreset(ProgramPreferences.LocalPresets[2]) end,
       LocalPreset3 = function() LocalPresets.ApplyLocalPreset(ProgramPreferences.LocalPresets[3]) end,
@@ -405,6 +456,55 @@ LrTasks.startAsyncTask(
       ChangedToDirectory = function(value) Profiles.setDirectory(value) end,
       ChangedToFile      = function(value) Profiles.setFile(value) end,
       ChangedToFullPath  = function(value) Profiles.setFullPath(value) end,
+      MappedParams       = function(value) -- comma separated, sent on connect and map changes
+        local mapped = {}
+        for name in value:gmatch('[^,]+') do
+          mapped[name] = true
+        end
+        local watched = {}
+        for _,param in ipairs(ParamList.SendToMidi) do
+          if mapped[param] then
+            watched[#watched+1] = param
+          end
+        end
+        WatchedParams = watched
+        if Prepare then
+          Prepare(mapped)
+        end
+      end,
+      PowerIdle          = function(idle) MIDI2LR.IDLE = tonumber(idle) == 1 end,
+      LuaTiming          = function(seconds) -- 0 stops timing
+        TimingInterval = tonumber(seconds) or 0
+        if TimingInterval > 0 then
+          Timings = Timings or {}
+          TimingSent = os.time()
+        else
+          Timings = nil
+        end
+      end,
+      Heartbeat          = function(sent) -- answered at once, so MIDI2LR can time the link
+        if MIDI2LR.SERVER and MIDI2LR.SERVER.send then
+          MIDI2LR.SERVER:send('Heartbeat ' .. sent .. '\n')
+        end
+      end,
+      Batch              = function(command)
+        if command == 'start' then
+          CU.BatchStart()
+        elseif command == 'commit' then
+          CU.BatchCommit()
+        elseif command == 'discard' then
+          CU.BatchDiscard()
+        end
+      end,
+      ResetGroup         = function(params) -- comma separated, a whole panel in one step
+        if LrApplication.activeCatalog():getTargetPhoto() == nil then return end
+        for param in params:gmatch('[^,]+') do
+          Ut.execFOM(LrDevelopController.resetToDefault,param)
+          local lrvalue = LrDevelopController.getValue(param)
+          MIDI2LR.PARAM_OBSERVER[param] = lrvalue -- the observer needn't send it again
+          Ut.queueFeedback(string.format('%s %g\n', param, CU.LRValueToMIDIValue(param, lrvalue)))
+        end
+      end, -- the frame's queued feedback goes back as one snapshot
       Pickup             = function(enabled)
         if tonumber(enabled) == 1 then -- state machine
           UpdateParam = UpdateParamPickup
@@ -432,7 +532,7 @@ LrTasks.startAsyncTask(
           if ProgramPreferences.ClientShowBezelOnChange then
             local bezelname = ParamList.ParamDisplay[resetparam] or resetparam
             local lrvalue = LrDevelopController.getValue(resetparam)
-            LrDialogs.showBezel(bezelname..'  '..LrStringUtils.numberToStringWithSeparators(lrvalue,Ut.precision(lrvalue)))
+            Ut.showValueBezel(bezelname, lrvalue)
           end
         else -- otherwise update a develop parameter
           guardsetting:performWithGuard(UpdateParam,i,tonumber(value))
@@ -455,7 +555,9 @@ LrTasks.startAsyncTask(
       local paramlastmoved = {}
       local lastfullrefresh = 0
       return function(param, midi_value, silent)
-        if LrApplication.activeCatalog():getTargetPhoto() == nil then return end--unable to update param
+        local photo = LrApplication.activeCatalog():getTargetPhoto()
+        if photo == nil then return end--unable to update param
+        Limits.SetTargetPhoto(photo)
         local value
         if LrApplicationView.getCurrentModuleName() ~= 'develop' then
           LrApplicationView.switchToModule('develop')
@@ -467,11 +569,12 @@ LrTasks.startAsyncTask(
           paramlastmoved[param] = os.clock()
           value = CU.MIDIValueToLRValue(param, midi_value)
           MIDI2LR.PARAM_OBSERVER[param] = value
+          CU.BatchRecord(param)
           LrDevelopController.setValue(param, value)
           LastParam = param
           if ProgramPreferences.ClientShowBezelOnChange and not silent then
             local bezelname = ParamList.ParamDisplay[param] or param
-            LrDialogs.showBezel(bezelname..'  '..LrStringUtils.numberToStringWithSeparators(value,Ut.precision(value)))
+            Ut.showValueBezel(bezelname, value)
           end
           if ParamList.ProfileMap[param] then
             Profiles.changeProfile(ParamList.ProfileMap[param])
@@ -480,9 +583,8 @@ LrTasks.startAsyncTask(
           if ProgramPreferences.ClientShowBezelOnChange then -- failed pickup. do I display bezel?
             value = CU.MIDIValueToLRValue(param, midi_value)
             local actualvalue = LrDevelopController.getValue(param)
-            local precision = Ut.precision(value)
             local bezelname = ParamList.ParamDisplay[param] or param
-            LrDialogs.showBezel(bezelname..'  '..LrStringUtils.numberToStringWithSeparators(value,precision)..'  '..LrStringUtils.numberToStringWithSeparators(actualvalue,precision))
+            Ut.showValueBezel(bezelname, value, nil, actualvalue)
           end
           if lastfullrefresh + 1 < os.clock() then --try refreshing controller once a second
             CU.FullRefresh()
@@ -494,7 +596,9 @@ LrTasks.startAsyncTask(
     UpdateParamPickup = UpdateParamPickup() --complete closure
     --called within LrRecursionGuard for setting
     function UpdateParamNoPickup(param, midi_value, silent)
-      if LrApplication.activeCatalog():getTargetPhoto() == nil then return end--unable to update param
+      local photo = LrApplication.activeCatalog():getTargetPhoto()
+      if photo == nil then return end--unable to update param
+      Limits.SetTargetPhoto(photo)
       local value
       if LrApplicationView.getCurrentModuleName() ~= 'develop' then
         LrApplicationView.switchToModule('develop')
@@ -503,11 +607,12 @@ LrTasks.startAsyncTask(
       --if value is outside limits range
       value = CU.MIDIValueToLRValue(param, midi_value)
       MIDI2LR.PARAM_OBSERVER[param] = value
+      CU.BatchRecord(param)
       LrDevelopController.setValue(param, value)
       LastParam = param
       if ProgramPreferences.ClientShowBezelOnChange and not silent then
         local bezelname = ParamList.ParamDisplay[param] or param
-        LrDialogs.showBezel(bezelname..'  '..LrStringUtils.numberToStringWithSeparators(value,Ut.precision(value)))
+        Ut.showValueBezel(bezelname, value)
       end
       if ParamList.ProfileMap[param] then
         Profiles.changeProfile(ParamList.ProfileMap[param])
@@ -528,19 +633,70 @@ LrTasks.startAsyncTask(
         local guardreading = LrRecursionGuard('reading')
         local guardsetting = LrRecursionGuard('setting')
         local CurrentObserver
+        local lastprofilecheck = 0
+        -- MIDI2LR drops develop values while there's no target photo to apply them to,
+        -- so tell it the module and photo state whenever that changes
+        local reportedstate
+        local function ReportModuleState()
+          local state = string.format('ModuleState %s %d\n', LrApplicationView.getCurrentModuleName(),
+            LrApplication.activeCatalog():getTargetPhoto() and 1 or 0)
+          if state ~= reportedstate and MIDI2LR.SERVER and MIDI2LR.SERVER.send then
+            reportedstate = state
+            MIDI2LR.SERVER:send(state)
+          end
+        end
+        local function CheckProfileSoon()
+          local now = os.clock()
+          if lastprofilecheck + PROFILE_RECHECK < now or lastprofilecheck > now then
+            lastprofilecheck = now
+            local start = Timings and os.clock()
+            guardsetting:performWithGuard(Profiles.checkProfile)
+            Timed('checkProfile', start)
+            ReportModuleState()
+          end
+        end
+        -- sends the handler timings once their interval has passed, one line per handler:
+        -- 'LuaTiming name calls total_ms worst_ms'
+        local function ReportTimings()
+          if Timings and os.time() - TimingSent >= TimingInterval and MIDI2LR.SERVER and MIDI2LR.SERVER.send then
+            local lines = {}
+            for name, entry in pairs(Timings) do
+              lines[#lines+1] = string.format('LuaTiming %s %d %.3f %.3f\n', name, entry[1],
+                entry[2] * 1000, entry[3] * 1000)
+            end
+            Timings, TimingSent = {}, os.time()
+            if lines[1] then
+              MIDI2LR.SERVER:send(table.concat(lines))
+            end
+          end
+        end
         --call following within guard for reading
         local function AdjustmentChangeObserver()
           local lastrefresh = 0
+          local processversion
+          local lastphoto
           return function(observer) -- closure
             if Limits.LimitsCanBeSet() and lastrefresh + 0.1 < os.clock() then
-              for _,param in ipairs(ParamList.SendToMidi) do
+              local photo = LrApplication.activeCatalog():getTargetPhoto()
+              if photo ~= lastphoto then -- refreshes from here on are for this photo
+                lastphoto = photo
+                Ut.newPhoto()
+              end
+              local version = LrDevelopController.getValue('ProcessVersion')
+              if version ~= processversion then -- ranges can differ between process versions
+                processversion = version
+                Limits.ClearRanges()
+              end
+              local lines = {}
+              for _,param in ipairs(WatchedParams) do -- only mapped parameters can give feedback
                 local lrvalue = LrDevelopController.getValue(param)
                 if observer[param] ~= lrvalue and type(lrvalue) == 'number' then
-                  MIDI2LR.SERVER:send(string.format('%s %g\n', param, CU.LRValueToMIDIValue(param)))
+                  lines[#lines+1] = string.format('%s %g\n', param, CU.LRValueToMIDIValue(param, lrvalue))
                   observer[param] = lrvalue
                   LastParam = param
                 end
               end
+              Ut.sendSnapshot(lines)
               lastrefresh = os.clock()
             end
           end
@@ -556,6 +712,10 @@ LrTasks.startAsyncTask(
             plugin = _PLUGIN,
             port = SEND_PORT,
             mode = 'send',
+            onConnected = function( socket )
+              socket:send(COMPACT_ANNOUNCE) -- MIDI2LR may send compact records
+              reportedstate = nil -- and report the module state again
+            end,
             onError = function( socket )
               if MIDI2LR.RUNNING then --
                 socket:reconnect()
@@ -564,40 +724,158 @@ LrTasks.startAsyncTask(
           }
         end
 
+        -- one table lookup per message. Handlers are made the first time a name arrives;
+        -- develop parameters map to false and are left to ApplySoon
+        local DISPATCH = setmetatable({}, {__index = function(t, param)
+          local handler = false
+          if(ACTIONS[param]) then -- perform a one time action
+            local action = ACTIONS[param]
+            handler = function(value)
+              if(tonumber(value) > BUTTON_ON) then
+                action()
+              end
+            end
+          elseif(SETTINGS[param]) then -- do something requiring the transmitted value to be known
+            handler = SETTINGS[param]
+          elseif(Virtual[param]) then -- handle a virtual command
+            local virtual = Virtual[param]
+            local name = 'Virtual.' .. param
+            handler = function(value)
+              local start = Timings and os.clock()
+              local lp = virtual(value, UpdateParam)
+              Timed(name, start)
+              if lp then
+                LastParam = lp
+              end
+            end
+          elseif(param:find('Reset') == 1) then -- perform a reset other than those explicitly coded in ACTIONS array
+            local resetparam = param:sub(6)
+            handler = function(value)
+              if(tonumber(value) > BUTTON_ON) then
+                Ut.execFOM(LrDevelopController.resetToDefault,resetparam)
+                if ProgramPreferences.ClientShowBezelOnChange then
+                  local bezelname = ParamList.ParamDisplay[resetparam] or resetparam
+                  local lrvalue = LrDevelopController.getValue(resetparam)
+                  Ut.showValueBezel(bezelname, lrvalue)
+                end
+              end
+            end
+          end
+          t[param] = handler
+          return handler
+        end})
+        -- MappedParams follows each profile switch: the new profile's handlers are made,
+        -- and its develop parameters' ranges read while there is a photo to read them
+        -- for, so the first move of each control costs no more than later ones
+        function Prepare(mapped)
+          for name in pairs(mapped) do
+            local _ = DISPATCH[name]
+          end
+          if Limits.LimitsCanBeSet() then
+            for _,param in ipairs(WatchedParams) do
+              Limits.GetMinMax(param)
+            end
+          end
+        end
+        -- latest develop value per parameter not yet applied. setValue makes Lightroom
+        -- render, so values arriving meanwhile replace each other here and only the
+        -- newest is applied, once per task yield
+        local pending_params, pending_values = {}, {}
+        -- relative controls may send signed moves instead; those not following a value
+        -- add up here and are added to Lightroom's value when applied
+        local pending_deltas = {}
+        local applying = false
+        local function ApplyPending(params, values, deltas)
+          for _,param in ipairs(params) do
+            local value = values[param]
+            if value == nil then
+              value = math.min(math.max(CU.LRValueToMIDIValue(param) + deltas[param], 0), 1)
+            end
+            local start = Timings and os.clock()
+            UpdateParam(param, value)
+            Timed('UpdateParam', start)
+          end
+        end
+        local function ApplyUpdates()
+          if pending_params[1] and not applying then
+            local params, values, deltas = pending_params, pending_values, pending_deltas
+            pending_params, pending_values, pending_deltas = {}, {}, {}
+            applying = true
+            guardsetting:performWithGuard(ApplyPending, params, values, deltas)
+            applying = false
+          end
+        end
+        local applier_running = false
+        local function ApplySoon()
+          if not applier_running then
+            applier_running = true
+            LrTasks.startAsyncTask(function()
+                while pending_params[1] and MIDI2LR.RUNNING do
+                  ApplyUpdates()
+                  LrTasks.yield() -- let newer values arrive before the next pass
+                end
+                applier_running = false
+              end)
+          end
+        end
+
         MIDI2LR.CLIENT = LrSocket.bind {
           functionContext = context,
           plugin = _PLUGIN,
           port = RECEIVE_PORT,
           mode = 'receive',
+          onConnected = function()
+            if MIDI2LR.SERVER.send then
+              MIDI2LR.SERVER:send(COMPACT_ANNOUNCE) -- announce again after MIDI2LR reconnects
+              reportedstate = nil
+            end
+          end,
           onMessage = function(_, message) --message processor
             if type(message) == 'string' then
-              local split = message:find(' ',1,true)
-              local param = message:sub(1,split-1)
-              local value = message:sub(split+1)
-              if(ACTIONS[param]) then -- perform a one time action
-                if(tonumber(value) > BUTTON_ON) then
-                  ACTIONS[param]()
-                end
-              elseif(SETTINGS[param]) then -- do something requiring the transmitted value to be known
-                SETTINGS[param](value)
-              elseif(Virtual[param]) then -- handle a virtual command
-                local lp = Virtual[param](value, UpdateParam)
-                if lp then
-                  LastParam = lp
+              local start = Timings and os.clock()
+              CheckProfileSoon() -- switch before acting if the module or tool changed
+              for line in message:gmatch('[^\r\n]+') do -- coalesced output sends several lines
+                local param, value
+                if line:byte(1) == COMPACT_MARK and #line >= 6 then
+                  local id1, id2, v1, v2, v3 = line:byte(2, 6)
+                  param = COMMAND_IDS[(id1 - DIGIT_BASE) * 64 + id2 - DIGIT_BASE]
+                  value = (((v1 - DIGIT_BASE) * 64 + v2 - DIGIT_BASE) * 64 + v3 - DIGIT_BASE) / COMPACT_SCALE
+                else
+                  local split = line:find(' ',1,true)
+                  if split then
+                    param = line:sub(1,split-1)
+                    value = line:sub(split+1)
+                  end
                 end
-              elseif(param:find('Reset') == 1) then -- perform a reset other than those explicitly coded in ACTIONS array
-                if(tonumber(value) > BUTTON_ON) then
-                  local resetparam = param:sub(6)
-                  Ut.execFOM(LrDevelopController.resetToDefault,resetparam)
-                  if ProgramPreferences.ClientShowBezelOnChange then
-                    local bezelname = ParamList.ParamDisplay[resetparam] or resetparam
-                    local lrvalue = LrDevelopController.getValue(resetparam)
-                    LrDialogs.showBezel(bezelname..'  '..LrStringUtils.numberToStringWithSeparators(lrvalue,Ut.precision(lrvalue)))
+                if param then
+                  local handler = DISPATCH[param]
+                  if handler then
+                    ApplyUpdates() -- keep develop values ahead of a later action
+                    handler(value)
+                  else -- otherwise update a develop parameter, with the rest of the frame
+                    local number = tonumber(value)
+                    if number then
+                      if pending_values[param] == nil and pending_deltas[param] == nil then
+                        pending_params[#pending_params+1] = param
+                      end
+                      local sign = type(value) == 'string' and value:byte(1)
+                      if sign == DELTA_PLUS or sign == DELTA_MINUS then -- a move, not a value
+                        if pending_values[param] then
+                          pending_values[param] = math.min(math.max(pending_values[param] + number, 0), 1)
+                        else
+                          pending_deltas[param] = (pending_deltas[param] or 0) + number
+                        end
+                      else
+                        pending_values[param] = number -- only the latest value is applied
+                        pending_deltas[param] = nil
+                      end
+                    end
                   end
                 end
-              else -- otherwise update a develop parameter
-                guardsetting:performWithGuard(UpdateParam,param,tonumber(value))
               end
+              ApplySoon()
+              Ut.sendSnapshot() -- feedback queued while handling the frame, in one write
+              Timed('onMessage', start)
             end
           end,
           onClosed = function( socket )
@@ -627,8 +905,11 @@ LrTasks.startAsyncTask(
         -- add an observer for develop param changes--needs to occur in develop module
         -- will drop out of loop if loadversion changes or if in develop module with selected photo
         while  MIDI2LR.RUNNING and ((LrApplicationView.getCurrentModuleName() ~= 'develop') or (LrApplication.activeCatalog():getTargetPhoto() == nil)) do
-          LrTasks.sleep ( .29 )
-          guardsetting:performWithGuard(Profiles.checkProfile)
+          LrTasks.sleep ( MIDI2LR.IDLE and IDLE_POLL or PROFILE_POLL )
+          if not MIDI2LR.IDLE then
+            CheckProfileSoon()
+          end
+          ReportTimings()
         end --sleep away until ended or until develop module activated
         if MIDI2LR.RUNNING then --didn't drop out of loop because of program termination
           if ProgramPreferences.RevealAdjustedControls then --may be nil or false
@@ -641,12 +922,18 @@ LrTasks.startAsyncTask(
             context,
             MIDI2LR.PARAM_OBSERVER,
             function ( observer )
+              CheckProfileSoon()
+              local start = Timings and os.clock()
               guardreading:performWithGuard(CurrentObserver,observer)
+              Timed('AdjustmentChangeObserver', start)
             end
           )
           while MIDI2LR.RUNNING do --detect halt or reload
-            LrTasks.sleep( .29 )
-            guardsetting:performWithGuard(Profiles.checkProfile)
+            LrTasks.sleep( MIDI2LR.IDLE and IDLE_POLL or PROFILE_POLL )
+            if not MIDI2LR.IDLE then
+              CheckProfileSoon()
+            end
+            ReportTimings()
           end
         end
       end
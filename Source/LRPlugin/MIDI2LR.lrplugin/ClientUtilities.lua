@@ -20,7 +20,6 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 ------------------------------------------------------------------------------]]
 local Limits     = require 'Limits'
 local ParamList  = require 'ParamList'
-local Paste      = require 'Paste'
 local Profiles   = require 'Profiles'
 local Ut         = require 'Utilities'
 local LrApplication       = import 'LrApplication'
@@ -29,40 +28,172 @@ local LrBinding           = import 'LrBinding'
 local LrDevelopController = import 'LrDevelopController'
 local LrDialogs           = import 'LrDialogs'
 local LrFunctionContext   = import 'LrFunctionContext'
+local LrProgressScope     = import 'LrProgressScope'
 local LrTasks             = import 'LrTasks'
 local LrView              = import 'LrView'
 
+-- filter names and preset handles are resolved once per ProgramPreferences.Filters
+-- or .Presets table. Loading preferences and closing either dialog replace the
+-- table, which empties the cache
+local filter_names, filter_source = {}, nil
+local presets, preset_source = {}, nil
+
 local function fApplyFilter(filternumber)
   return function()
+    if filter_source ~= ProgramPreferences.Filters then
+      filter_names, filter_source = {}, ProgramPreferences.Filters
+    end
     local filterUuid = ProgramPreferences.Filters[filternumber]
     if filterUuid == nil then return end
     if LrApplication.activeCatalog():setViewFilter(filterUuid) then --true if filter changed
-      local _,str = LrApplication.activeCatalog():getCurrentViewFilter()
-      if str then LrDialogs.showBezel(str) end -- str nil if not defined
+      local str = filter_names[filterUuid]
+      if str == nil then
+        str = select(2, LrApplication.activeCatalog():getCurrentViewFilter())
+        filter_names[filterUuid] = str or false -- str nil if not defined
+      end
+      if str then LrDialogs.showBezel(str) end
     end
   end
 end
 
+-- presses queue here and one task applies them in order, so a burst of presses
+-- doesn't start a task each
+local preset_queue = {}
+local preset_worker = false
+
+local function ApplyQueuedPresets()
+  while preset_queue[1] and MIDI2LR.RUNNING do
+    local entry = table.remove(preset_queue, 1)
+    local catalog = LrApplication.activeCatalog()
+    local photo = catalog:getTargetPhoto()
+    -- a preset deleted after it was cached fails here; forget it so the next press
+    -- resolves it again
+    if photo and not LrTasks.pcall(catalog.withWriteAccessDo, catalog,
+        entry.label,
+        function()
+          LrDialogs.showBezel(entry.name)
+          photo:applyDevelopPreset(entry.preset)
+        end,
+        { timeout = 4,
+          callback = function() LrDialogs.showError(LOC("$$$/AgCustomMetadataRegistry/UpdateCatalog/Error=The catalog could not be updated with additional module metadata.").. 'PastePreset.') end }
+      ) then
+      presets = {}
+    end
+  end
+  preset_worker = false
+end
+
 local function fApplyPreset(presetnumber)
   return function()
+    if preset_source ~= ProgramPreferences.Presets then
+      presets, preset_source = {}, ProgramPreferences.Presets
+    end
     local presetUuid = ProgramPreferences.Presets[presetnumber]
     if presetUuid == nil or LrApplication.activeCatalog():getTargetPhoto() == nil then return end
-    local preset = LrApplication.developPresetByUuid(presetUuid)
-    LrTasks.startAsyncTask ( function () 
-        LrApplication.activeCatalog():withWriteAccessDo(
-          'Apply preset '..preset:getName(), 
-          function()     
-            LrDialogs.showBezel(preset:getName())
-            LrApplication.activeCatalog():getTargetPhoto():applyDevelopPreset(preset) 
-          end,
-          { timeout = 4, 
-            callback = function() LrDialogs.showError(LOC("$$$/AgCustomMetadataRegistry/UpdateCatalog/Error=The catalog could not be updated with additional module metadata.").. 'PastePreset.') end, 
-            asynchronous = true }
-        ) 
-      end )
+    local entry = presets[presetUuid]
+    if entry == nil then
+      local preset = LrApplication.developPresetByUuid(presetUuid)
+      if preset == nil then return end -- deleted since it was chosen
+      local name = preset:getName()
+      entry = {preset = preset, name = name, label = 'Apply preset '..name}
+      presets[presetUuid] = entry
+    end
+    preset_queue[#preset_queue+1] = entry
+    if not preset_worker then
+      preset_worker = true
+      LrTasks.startAsyncTask(ApplyQueuedPresets)
+    end
   end
 end
 
+-- Batch mode. While recording, each develop parameter's value before its first move
+-- is kept; on commit the difference to its current value is added to the other
+-- selected photos. Settings are read a chunk at a time with yields between, then
+-- written in one catalog transaction
+local BATCH_CHUNK = 25 -- photos read between yields
+local batch = nil -- value before the first move, by parameter, while recording
+
+local function BatchRecord(param)
+  if batch and batch[param] == nil then
+    batch[param] = LrDevelopController.getValue(param)
+  end
+end
+
+local function BatchStart()
+  batch = {}
+  LrDialogs.showBezel(LOC("$$$/MIDI2LR/Batch/Start=Recording batch"))
+end
+
+local function BatchDiscard()
+  batch = nil
+  LrDialogs.showBezel(LOC("$$$/MIDI2LR/Batch/Discard=Batch discarded"))
+end
+
+local function BatchCommit()
+  if batch == nil then return end
+  local deltas, ranges = {}, {}
+  for param,before in pairs(batch) do
+    local delta = LrDevelopController.getValue(param) - before
+    if delta ~= 0 then
+      deltas[param] = delta
+      ranges[param] = {LrDevelopController.getRange(param)}
+    end
+  end
+  batch = nil
+  if next(deltas) == nil then return end
+  LrTasks.startAsyncTask(function()
+      LrFunctionContext.callWithContext('MIDI2LR batch', function(context)
+          local catalog = LrApplication.activeCatalog()
+          local active = catalog:getTargetPhoto() -- already has the moves
+          local photos = catalog:getTargetPhotos()
+          local progress = LrProgressScope {
+            title = LOC("$$$/MIDI2LR/Batch/Commit=Applying batch to selection"),
+            functionContext = context,
+          }
+          local updates = {}
+          for i,photo in ipairs(photos) do
+            if photo ~= active then
+              local settings = photo:getDevelopSettings()
+              local changed = {}
+              for param,delta in pairs(deltas) do
+                if type(settings[param]) == 'number' then
+                  local low, high = ranges[param][1], ranges[param][2]
+                  local value = settings[param] + delta
+                  if low and value < low then value = low end
+                  if high and value > high then value = high end
+                  changed[param] = value
+                end
+              end
+              updates[#updates+1] = {photo = photo, settings = changed}
+            end
+            if i % BATCH_CHUNK == 0 then
+              progress:setPortionComplete(i, 2 * #photos) -- reading is the first half
+              LrTasks.yield()
+              if progress:isCanceled() then return end
+            end
+          end
+          catalog:withWriteAccessDo(
+            'MIDI2LR: Apply batch',
+            function()
+              for i,update in ipairs(updates) do
+                update.photo:applyDevelopSettings(update.settings)
+                if i % BATCH_CHUNK == 0 then
+                  progress:setPortionComplete(#photos + i, 2 * #photos)
+                end
+              end
+            end,
+            { timeout = 30,
+              callback = function()
+                LrDialogs.showError(LOC("$$$/AgCustomMetadataRegistry/UpdateCatalog/Error=The catalog could not be updated with additional module metadata.")..' Batch')
+              end
+            }
+          )
+          progress:done()
+          LrDialogs.showBezel(LOC("$$$/MIDI2LR/Batch/Done=Batch applied to ^1 photos", #updates))
+        end)
+    end)
+end
+
 local function fChangePanel(panelname)
   return function()
     Ut.execFOM(LrDevelopController.revealPanel,panelname)
@@ -149,6 +280,7 @@ end
 local function PasteSelectedSettings ()
   if MIDI2LR.Copied_Settings == nil or LrApplication.activeCatalog():getTargetPhoto() == nil then return end 
   if ProgramPreferences.PastePopup then 
+    local Paste = require 'Paste' -- dialog only, so loaded on first use
     LrFunctionContext.callWithContext( "checkPaste", 
       function( context )
         local f = LrView.osFactory()
@@ -239,15 +371,17 @@ end
 
 local function FullRefresh()
   if Limits.LimitsCanBeSet() then
+    local lines = {}
     for _,param in ipairs(ParamList.SendToMidi) do
       local min,max = Limits.GetMinMax(param)
       local lrvalue = LrDevelopController.getValue(param)
       if type(min) == 'number' and type(max) == 'number' and type(lrvalue) == 'number' then
         local midivalue = (lrvalue-min)/(max-min)
-        MIDI2LR.SERVER:send(string.format('%s %g\n', param, midivalue))
+        lines[#lines+1] = string.format('%s %g\n', param, midivalue)
       end
       Profiles.resyncDeferred = false
     end
+    Ut.sendSnapshot(lines)
   else
     Profiles.resyncDeferred = true
   end
@@ -261,11 +395,11 @@ local function MIDIValueToLRValue(param, midi_value)
   return midi_value * (max-min) + min
 end
 
-local function LRValueToMIDIValue(param)
+local function LRValueToMIDIValue(param, lrvalue)
   -- needs to be called in Develop module with photo selected
-  -- map develop parameter range to midi range
+  -- map develop parameter range to midi range. lrvalue saves reading the value again
   local min,max = Limits.GetMinMax(param)
-  local retval = (LrDevelopController.getValue(param)-min)/(max-min)
+  local retval = ((lrvalue or LrDevelopController.getValue(param))-min)/(max-min)
   if retval > 1 then return 1 end
   if retval < 0 then return 0 end
   return retval
@@ -281,9 +415,10 @@ local function UpdateCameraProfile(name)
 end
 
 local function SimulateKeys(keys)
+  local command = 'SendKey '..keys..'\n'
   return function()
     if LrApplicationView.getCurrentModuleName() == 'develop' and LrApplication.activeCatalog():getTargetPhoto() ~= nil then
-      MIDI2LR.SERVER:send(string.format('SendKey %s\n', keys))
+      MIDI2LR.SERVER:send(command)
     end
   end
 end
@@ -310,6 +445,10 @@ return {
   PasteSelectedSettings = PasteSelectedSettings,
   PasteSettings = PasteSettings,
   ApplySettings = ApplySettings,
+  BatchCommit = BatchCommit,
+  BatchDiscard = BatchDiscard,
+  BatchRecord = BatchRecord,
+  BatchStart = BatchStart,
   MIDIValueToLRValue = MIDIValueToLRValue,
   LRValueToMIDIValue = LRValueToMIDIValue,
   UpdateCameraProfile = UpdateCameraProfile,
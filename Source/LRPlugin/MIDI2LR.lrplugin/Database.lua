@@ -763,9 +763,11 @@ local SelectivePasteGroups = {}
 local LimitEligible = {}
 local SendToMidi = {}
 local ProfileMap = {}
+local CommandIds = {} -- LRStringList order, index 0 (Unmapped) left out
 for i,v in ipairs(DataBase) do
   if v[4] then
     table.insert(MenuList,{v[1],v[8],v[9],v[6]})
+    table.insert(CommandIds,v[1])
     if v[5] then
       table.insert(SendToMidi,v[1])
       if v[6]==false then
@@ -854,13 +856,7 @@ file:write([=[
   You should have received a copy of the GNU General Public License along with
   MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ------------------------------------------------------------------------------]]
-  local SelectivePasteMenu = ]=],serpent.block(SelectivePasteMenu, {comment = false}), [==[
-
-  local SelectivePasteHidden = ]==],serpent.block(SelectivePasteHidden, {comment = false}), [==[
-
-  local SelectivePasteIteration = ]==],serpent.block(SelectivePasteIteration, {comment = false}), [==[
-
-  local SelectivePasteGroups = ]==],serpent.block(SelectivePasteGroups, {comment = false}), [==[
+  local SelectivePasteIteration = ]=],serpent.block(SelectivePasteIteration, {comment = false}), [==[
 
   local LimitEligible = ]==],serpent.block(LimitEligible, {comment = false}), [==[
 
@@ -869,16 +865,54 @@ file:write([=[
   local ProfileMap = ]==],serpent.block(ProfileMap, {comment = false}), [==[
   
   local ParamDisplay = ]==],serpent.block(paramdisp, {comment = false}), [==[
+
+  local CommandIds = ]==],serpent.block(CommandIds, {comment = false}), [==[
   
 return {
-    SelectivePasteMenu = SelectivePasteMenu,
-    SelectivePasteHidden = SelectivePasteHidden,
     SelectivePasteIteration = SelectivePasteIteration,
-    SelectivePasteGroups = SelectivePasteGroups,
     LimitEligible = LimitEligible,
     SendToMidi = SendToMidi,
     ProfileMap = ProfileMap,
     ParamDisplay = ParamDisplay,
+    CommandIds = CommandIds,
+    }]==])
+file:close()
+
+-- the paste dialog's tables are kept apart, so the plugin doesn't load them at start
+datafile = LrPathUtils.child(_PLUGIN.path, 'PasteMenu.lua')
+
+file = assert(io.open(datafile,'w'),'Error writing to PasteMenu.lua')
+file:write([=[
+  --[[----------------------------------------------------------------------------
+
+  PasteMenu.lua
+
+  This file was auto-generated by MIDI2LR and contains the selective paste menu
+  used by the plugin dialogs. Edits to this file will be lost any time MIDI2LR
+  is updated or the language used by Lightroom changes. Edit Database.lua if you
+  want to have persistent changes to the translations or menu structure.
+
+  This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+  MIDI2LR is free software: you can redistribute it and/or modify it under the
+  terms of the GNU General Public License as published by the Free Software
+  Foundation, either version 3 of the License, or (at your option) any later version.
+
+  MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License along with
+  MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ------------------------------------------------------------------------------]]
+  local SelectivePasteMenu = ]=],serpent.block(SelectivePasteMenu, {comment = false}), [==[
+
+  local SelectivePasteHidden = ]==],serpent.block(SelectivePasteHidden, {comment = false}), [==[
+
+  local SelectivePasteGroups = ]==],serpent.block(SelectivePasteGroups, {comment = false}), [==[
+
+return {
+    SelectivePasteMenu = SelectivePasteMenu,
+    SelectivePasteHidden = SelectivePasteHidden,
+    SelectivePasteGroups = SelectivePasteGroups,
     }]==])
 file:close()
 
@@ -967,9 +1001,45 @@ local cppvectors ={
 }
 
 
+--[[----------------------------------------------------------------------------
+Distinct values Lightroom keeps across each parameter's full default range, for
+parameters it rounds (most to whole numbers). MIDI2LR sends values normalized to
+the range, and doesn't send a value in the same step as the last one. Limits only
+narrow a range, so these are never coarser than Lightroom. Parameters not listed
+aren't rounded this way, and Temperature isn't listed as its range differs by file
+type.
+------------------------------------------------------------------------------]]
+local steps = {
+  Tint = 300, Exposure = 1000,
+  Contrast = 200, Highlights = 200, Shadows = 200, Whites = 200, Blacks = 200,
+  Clarity = 200, Vibrance = 200, Saturation = 200, Dehaze = 200,
+  ParametricDarks = 200, ParametricLights = 200, ParametricShadows = 200,
+  ParametricHighlights = 200,
+  SplitToningShadowHue = 360, SplitToningShadowSaturation = 100,
+  SplitToningHighlightHue = 360, SplitToningHighlightSaturation = 100,
+  SplitToningBalance = 200,
+  Sharpness = 150, SharpenRadius = 25, SharpenDetail = 100, SharpenEdgeMasking = 100,
+  LuminanceSmoothing = 100, LuminanceNoiseReductionDetail = 100,
+  LuminanceNoiseReductionContrast = 100, ColorNoiseReduction = 100,
+  ColorNoiseReductionDetail = 100, ColorNoiseReductionSmoothness = 100,
+  VignetteAmount = 200, VignetteMidpoint = 100,
+  PostCropVignetteAmount = 200, PostCropVignetteMidpoint = 100,
+  PostCropVignetteFeather = 100, PostCropVignetteRoundness = 200,
+  PostCropVignetteHighlightContrast = 100,
+  GrainAmount = 100, GrainSize = 100, GrainFrequency = 100,
+  ShadowTint = 200, RedHue = 200, RedSaturation = 200, GreenHue = 200,
+  GreenSaturation = 200, BlueHue = 200, BlueSaturation = 200,
+}
+for _,color in ipairs {'Red', 'Orange', 'Yellow', 'Green', 'Aqua', 'Blue', 'Purple', 'Magenta'} do
+  steps['HueAdjustment'..color] = 200
+  steps['SaturationAdjustment'..color] = 200
+  steps['LuminanceAdjustment'..color] = 200
+end
+
 return { --used in documentation module
   DataBase = DataBase,
   RunTests = RunTests,
   cppvectors = cppvectors,
+  steps = steps,
 }
 
@@ -89,11 +89,12 @@ end
 local function validate(_,value)
   if value == nil then return true end
   value = LrStringUtils.trimWhitespace(value)
+  if value:find('^#%d+$') then return true,value end -- key macro defined in MIDI2LR
   local _, count = value:gsub( "[^\128-\193]", "") -- UTF-8 characters
   if count < 2 then return true,value end --one key or empty string
   value = LrStringUtils.lower(value)
   if legalanswers[value] then return true,value end
-  return false, '', 'Value must be single character or spell out an F key (F1-F16) or: backspace (means delete in OS X), cursor down, cursor left, cursor right, cursor up, delete (means delete right in OS X), end, escape, home, page down, page up, return, space, tab, or numpad 0 (through numpad 9), numpad add (or decimal, divide, multiply, subtract).'
+  return false, '', 'Value must be single character or spell out an F key (F1-F16) or: backspace (means delete in OS X), cursor down, cursor left, cursor right, cursor up, delete (means delete right in OS X), end, escape, home, page down, page up, return, space, tab, or numpad 0 (through numpad 9), numpad add (or decimal, divide, multiply, subtract), or #n for MIDI2LR key macro n.'
 end
 
 
@@ -148,24 +149,44 @@ local function EndDialog(obstable, status)
   end
 end
 
-local function GetKey(i)
-  if i < 1 or i > 40 then return nil end
+local function ComposeKeyCommand(key)
+  local macro = key['key']:match('^#(%d+)$')
+  if macro then -- MIDI2LR sends the whole sequence
+    return 'SendMacro '..macro..'\n'
+  end
   local modifiers = 0x0
-  if ProgramPreferences.Keys[i]['alt'] then
+  if key['alt'] then
     modifiers = 0x1
   end
-  if ProgramPreferences.Keys[i]['control'] then
+  if key['control'] then
     modifiers = modifiers + 0x2
   end
-  if ProgramPreferences.Keys[i]['shift'] then
+  if key['shift'] then
     modifiers = modifiers + 0x4
   end
-  return string.format('%u',modifiers) .. ProgramPreferences.Keys[i]['key']
+  return 'SendKey '..string.format('%u',modifiers) .. key['key']..'\n'
 end
 
+-- payloads are composed once per ProgramPreferences.Keys table. Loading
+-- preferences and closing the dialog both replace that table, so comparing it
+-- is enough to notice a change
+local commands = {}
+local commands_source = nil
+
+local function GetKeyCommand(i)
+  if i < 1 or i > 40 then return nil end
+  if commands_source ~= ProgramPreferences.Keys then
+    commands = {}
+    for j = 1,40 do
+      commands[j] = ComposeKeyCommand(ProgramPreferences.Keys[j])
+    end
+    commands_source = ProgramPreferences.Keys
+  end
+  return commands[i]
+end
 
 return { --table of exports, setting table member name and module function it points to
   EndDialog   = EndDialog,
   StartDialog = StartDialog,
-  GetKey = GetKey,
+  GetKeyCommand = GetKeyCommand,
 }
\ No newline at end of file
@@ -36,6 +36,32 @@ local ParamList           = require 'ParamList'
 
 --hidden 
 local DisplayOrder           = {'Temperature','Tint','Exposure','straightenAngle'}
+local RangeMin, RangeMax     = {}, {} -- resolved by GetMinMax for RangePhoto and RangeLimits
+local RangePhoto, RangeLimits
+
+--------------------------------------------------------------------------------
+-- Forgets the ranges resolved by GetMinMax. Call when the process version or
+-- the limits preferences change; a change of photo, or preferences being loaded,
+-- is noticed by itself.
+-- @return nil.
+--------------------------------------------------------------------------------
+local function ClearRanges()
+  RangeMin, RangeMax = {}, {}
+  return nil
+end
+
+--------------------------------------------------------------------------------
+-- Notes the photo being adjusted, clearing the ranges if it changed.
+-- @param photo The target photo.
+-- @return nil.
+--------------------------------------------------------------------------------
+local function SetTargetPhoto(photo)
+  if photo ~= RangePhoto then
+    RangePhoto = photo
+    ClearRanges()
+  end
+  return nil
+end
 
 --public--each must be in table of exports
 
@@ -72,24 +98,36 @@ end
 -- @return bool as result of test
 --------------------------------------------------------------------------------
 local function LimitsCanBeSet()
-  return 
-  (LrApplication.activeCatalog():getTargetPhoto() ~= nil) and
-  (LrApplicationView.getCurrentModuleName() == 'develop')
+  local photo = LrApplication.activeCatalog():getTargetPhoto()
+  if photo == nil then
+    return false
+  end
+  SetTargetPhoto(photo)
+  return LrApplicationView.getCurrentModuleName() == 'develop'
 end
 
 --------------------------------------------------------------------------------
 -- Provides min and max for given parameter and mode. Must be called in Develop
--- module with photo selected.
+-- module with photo selected. Results are kept until ClearRanges or until
+-- another photo is targeted.
 -- @param param Which parameter is being adjusted.
 -- @return min for given param and mode.
 -- @return max for given param and mode.
 --------------------------------------------------------------------------------
 local function GetMinMax(param)
+  if RangeLimits ~= ProgramPreferences.Limits then -- preferences were loaded or reset
+    RangeLimits = ProgramPreferences.Limits
+    ClearRanges()
+  elseif RangeMin[param] then
+    return RangeMin[param], RangeMax[param]
+  end
   local low,rangemax = LrDevelopController.getRange(param)
   if LimitParameters[param] then --should have limits
     if type(ProgramPreferences.Limits[param]) == 'table' and rangemax ~= nil then -- B&W picture may not have temperature, tint. This avoids indexing a nil rangemax and blowing up the metatable _index
       if type(ProgramPreferences.Limits[param][rangemax]) == 'table' then
-        return ProgramPreferences.Limits[param][rangemax][1], ProgramPreferences.Limits[param][rangemax][2]
+        low, rangemax = ProgramPreferences.Limits[param][rangemax][1], ProgramPreferences.Limits[param][rangemax][2]
+        RangeMin[param], RangeMax[param] = low, rangemax
+        return low, rangemax
       else
         ProgramPreferences.Limits[param][rangemax] = {low, rangemax}
       end
@@ -98,6 +136,9 @@ local function GetMinMax(param)
         order = ParamList.LimitEligible[param][2], rangemax = {low,rangemax}}
     end
   end
+  if rangemax ~= nil then -- nothing kept for a parameter the photo lacks
+    RangeMin[param], RangeMax[param] = low, rangemax
+  end
   return low, rangemax
 end
 
@@ -208,15 +249,18 @@ local function EndDialog(obstable, status)
           ProgramPreferences.Limits[p][max] = {obstable['Limits'..p..'Low'], obstable['Limits'..p..'High']}
         end
       end
+      ClearRanges()
   end
 end
 
 --- @export
 return { --table of exports, setting table member name and module function it points to
   ClampValue  = ClampValue,
+  ClearRanges = ClearRanges,
   EndDialog   = EndDialog,
   GetMinMax   = GetMinMax,
   LimitsCanBeSet = LimitsCanBeSet,
   Parameters  = LimitParameters,
+  SetTargetPhoto = SetTargetPhoto,
   StartDialog = StartDialog,
 }
\ No newline at end of file
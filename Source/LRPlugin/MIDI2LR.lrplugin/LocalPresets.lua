@@ -42,7 +42,7 @@ local LrView        = import 'LrView'
 
 local LocalAdjustmentPresetsPath = LrPathUtils.child(LrPathUtils.parent(LrPathUtils.getStandardFilePath ('appPrefs')) , 'Local Adjustment Presets')
 
-local LocalPresets = {}  --Store presets in table when reqested by user : key = filename, value = preset values table
+local LocalPresets = {}  --Store presets in table when reqested by user : key = filename, value = {modified, values}
 
 local localPresetMap = {
   blacks2012 = "local_Blacks2012",
@@ -77,35 +77,60 @@ local function GetPresetFilenames()
   return filenames
 end
 
+local function LoadLocalPreset(LRLocalPresetFileName)
+  local f = io.open(LRLocalPresetFileName)
+  if f == nil then return nil end
+  local strPreset = f:read("*a")
+  f:close()
+
+  --I had to remove 'ZSTR' from the built-in .lrtemplate preset files as it would not load/execute file
+  local LRLocalPresetFile = loadstring(string.gsub(strPreset,'ZSTR',''))  --Loads into a function which is later called
+  if LRLocalPresetFile == nil then return nil end
+  local env = {}
+  setfenv(LRLocalPresetFile, env) --the file assigns 's', keep it out of the globals
+  LRLocalPresetFile() --Execute the loaded file string as lua code.  This will give access to the variable 's'
+  if type(env.s) ~= 'table' or type(env.s.value) ~= 'table' then return nil end
+
+  --resolve the develop values once, rather than on every press
+  local values = {}
+  for param, MappedParam in pairs(localPresetMap) do
+    if MappedParam ~= '' then
+      local value = env.s.value[param] or 0
+      if MappedParam == 'local_Exposure' then
+        value = value * 4
+      else
+        value = value * 100
+      end
+      values[#values+1] = {MappedParam, value}
+    end
+  end
+  return values
+end
+
 local function ApplyLocalPreset(LocalPresetName)  --LocalPresetName eg: 'Burn (Darken).lrtemplate'
   local LRLocalPresetFileName = LrPathUtils.child(LocalAdjustmentPresetsPath,LocalPresetName..".lrtemplate")
-  --Check to see if preset is already loaded by checking table... if so do not reload file.
-  --Reloading template file on each request would however allow the user to update and save local preset settings in lightroom.
-  if LocalPresets[tostring(LocalPresetName)] == nil then
-    local f = io.open(LRLocalPresetFileName)
-    local strPreset = f:read("*a")
-    f:close()
-
-    --I had to remove 'ZSTR' from the built-in .lrtemplate preset files as it would not load/execute file
-    local LRLocalPresetFile = loadstring(string.gsub(strPreset,'ZSTR',''))  --Loads into a function which is later called
-    LRLocalPresetFile() --Execute the loaded file string as lua code.  This will give access to the variable 's'
-
-    LocalPresets[tostring(LocalPresetName)] = s['value'] --Add the currently selected preset to the table of presets
+  --Reuse the loaded preset until the file changes, so a preset saved again in
+  --Lightroom is picked up without reading and compiling the file on every press.
+  local attributes = LrFileUtils.fileAttributes(LRLocalPresetFileName)
+  local modified = attributes and attributes.fileModificationDate
+  local cached = LocalPresets[tostring(LocalPresetName)]
+  if cached == nil or cached.modified ~= modified then
+    local values = LoadLocalPreset(LRLocalPresetFileName)
+    if values == nil then return end
+    cached = {modified = modified, values = values}
+    LocalPresets[tostring(LocalPresetName)] = cached --Add the currently selected preset to the table of presets
   end
 
   LrDialogs.showBezel (LrPathUtils.removeExtension(LocalPresetName))
 
-  --Apply preset to LR
-  for param, MappedParam in pairs(localPresetMap) do
-    local value = LocalPresets[LocalPresetName][param]
-    if value == nil then value=0; end
-    if MappedParam == 'local_Exposure' then
-      value = value * 4
-    else
-      value = value * 100
+  --Apply preset to LR. Local adjustments are only reachable through setValue, so skip
+  --those already at the preset's value rather than rendering for each of them
+  for _, entry in ipairs(cached.values) do
+    local MappedParam, value = entry[1], entry[2]
+    if LrDevelopController.getValue(MappedParam) ~= value then
+      MIDI2LR.PARAM_OBSERVER[MappedParam] = value
+      LrDevelopController.setValue(MappedParam, value)
     end
-    MIDI2LR.PARAM_OBSERVER[MappedParam] = value
-    LrDevelopController.setValue(MappedParam, value)
   end
 end
 
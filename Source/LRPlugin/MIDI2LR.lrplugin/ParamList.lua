@@ -18,596 +18,6 @@
   You should have received a copy of the GNU General Public License along with
   MIDI2LR.  If not, see <http://www.gnu.org/licenses/>. 
   ------------------------------------------------------------------------------]]
-  local SelectivePasteMenu = {
-  {
-    "ProcessVersion",
-    "Process Version"
-  },
-  {
-    "WhiteBalance",
-    "White Balance"
-  },
-  {
-    "AutoBrightness",
-    "Automatic Brightness"
-  },
-  {
-    "AutoContrast",
-    "Automatic Contrast"
-  },
-  {
-    "AutoExposure",
-    "Automatic Exposure"
-  },
-  {
-    "AutoShadows",
-    "Automatic Shadows"
-  },
-  {
-    "Temperature",
-    "Temperature"
-  },
-  {
-    "Tint",
-    "Tint"
-  },
-  {
-    "Exposure",
-    "Exposure"
-  },
-  {
-    "Contrast",
-    "Contrast"
-  },
-  {
-    "Highlights",
-    "Highlights (Highlight Recovery in PV2003 and PV2010)"
-  },
-  {
-    "Brightness",
-    "Brightness"
-  },
-  {
-    "HighlightRecovery",
-    "Highlight Recovery (PV2003 and PV2010)"
-  },
-  {
-    "Shadows2012",
-    "Shadows"
-  },
-  {
-    "FillLight",
-    "Fill Light (PV2003 and PV2010)"
-  },
-  {
-    "Whites2012",
-    "Whites (no effect in PV2003 and PV2010)"
-  },
-  {
-    "Blacks2012",
-    "Blacks"
-  },
-  {
-    "Clarity",
-    "Clarity"
-  },
-  {
-    "Vibrance",
-    "Vibrance"
-  },
-  {
-    "Saturation",
-    "Saturation"
-  },
-  {
-    "EnableToneCurve",
-    "Enable Tone Curve"
-  },
-  {
-    "ToneCurve",
-    "Tone Curve"
-  },
-  {
-    "ParametricDarks",
-    "Dark Tones"
-  },
-  {
-    "ParametricLights",
-    "Light Tones"
-  },
-  {
-    "ParametricShadows",
-    "Shadow Tones"
-  },
-  {
-    "ParametricHighlights",
-    "Highlight Tones"
-  },
-  {
-    "ParametricShadowSplit",
-    "Shadow Split"
-  },
-  {
-    "ParametricMidtoneSplit",
-    "Midtone Split"
-  },
-  {
-    "ParametricHighlightSplit",
-    "Highlight Split"
-  },
-  {
-    "EnableColorAdjustments",
-    "Enable Color Adjustments"
-  },
-  {
-    "SaturationAdjustmentRed",
-    "Saturation Adjustment Red"
-  },
-  {
-    "SaturationAdjustmentOrange",
-    "Saturation Adjustment Orange"
-  },
-  {
-    "SaturationAdjustmentYellow",
-    "Saturation Adjustment Yellow"
-  },
-  {
-    "SaturationAdjustmentGreen",
-    "Saturation Adjustment Green"
-  },
-  {
-    "SaturationAdjustmentAqua",
-    "Saturation Adjustment Aqua"
-  },
-  {
-    "SaturationAdjustmentBlue",
-    "Saturation Adjustment Blue"
-  },
-  {
-    "SaturationAdjustmentPurple",
-    "Saturation Adjustment Purple"
-  },
-  {
-    "SaturationAdjustmentMagenta",
-    "Saturation Adjustment Magenta"
-  },
-  {
-    "HueAdjustmentRed",
-    "Hue Adjustment Red"
-  },
-  {
-    "HueAdjustmentOrange",
-    "Hue Adjustment Orange"
-  },
-  {
-    "HueAdjustmentYellow",
-    "Hue Adjustment Yellow"
-  },
-  {
-    "HueAdjustmentGreen",
-    "Hue Adjustment Green"
-  },
-  {
-    "HueAdjustmentAqua",
-    "Hue Adjustment Aqua"
-  },
-  {
-    "HueAdjustmentBlue",
-    "Hue Adjustment Blue"
-  },
-  {
-    "HueAdjustmentPurple",
-    "Hue Adjustment Purple"
-  },
-  {
-    "HueAdjustmentMagenta",
-    "Hue Adjustment Magenta"
-  },
-  {
-    "LuminanceAdjustmentRed",
-    "Luminance Adjustment Red"
-  },
-  {
-    "LuminanceAdjustmentOrange",
-    "Luminance Adjustment Orange"
-  },
-  {
-    "LuminanceAdjustmentYellow",
-    "Luminance Adjustment Yellow"
-  },
-  {
-    "LuminanceAdjustmentGreen",
-    "Luminance Adjustment Green"
-  },
-  {
-    "LuminanceAdjustmentAqua",
-    "Luminance Adjustment Aqua"
-  },
-  {
-    "LuminanceAdjustmentBlue",
-    "Luminance Adjustment Blue"
-  },
-  {
-    "LuminanceAdjustmentPurple",
-    "Luminance Adjustment Purple"
-  },
-  {
-    "LuminanceAdjustmentMagenta",
-    "Luminance Adjustment Magenta"
-  },
-  {
-    "ConvertToGrayscale",
-    "Convert to Grayscale"
-  },
-  {
-    "EnableGrayscaleMix",
-    "Enable Grayscale Mix"
-  },
-  {
-    "GrayMixerRed",
-    "Gray Mixer Red"
-  },
-  {
-    "GrayMixerOrange",
-    "Gray Mixer Orange"
-  },
-  {
-    "GrayMixerYellow",
-    "Gray Mixer Yellow"
-  },
-  {
-    "GrayMixerGreen",
-    "Gray Mixer Green"
-  },
-  {
-    "GrayMixerAqua",
-    "Gray Mixer Aqua"
-  },
-  {
-    "GrayMixerBlue",
-    "Gray Mixer Blue"
-  },
-  {
-    "GrayMixerPurple",
-    "Gray Mixer Purple"
-  },
-  {
-    "GrayMixerMagenta",
-    "Gray Mixer Magenta"
-  },
-  {
-    "EnableSplitToning",
-    "Enable Split Toning"
-  },
-  {
-    "SplitToningShadowHue",
-    "Shadow Hue"
-  },
-  {
-    "SplitToningShadowSaturation",
-    "Shadow Saturation"
-  },
-  {
-    "SplitToningHighlightHue",
-    "Highlight Hue"
-  },
-  {
-    "SplitToningHighlightSaturation",
-    "Highlight Saturation"
-  },
-  {
-    "SplitToningBalance",
-    "Split Toning Balance"
-  },
-  {
-    "EnableDetail",
-    "Enable Detail"
-  },
-  {
-    "Sharpness",
-    "Sharpness"
-  },
-  {
-    "SharpenRadius",
-    "Sharpen Radius"
-  },
-  {
-    "SharpenDetail",
-    "Sharpen Detail"
-  },
-  {
-    "SharpenEdgeMasking",
-    "Sharpen Edge Masking"
-  },
-  {
-    "LuminanceSmoothing",
-    "Luminance Smoothing"
-  },
-  {
-    "LuminanceNoiseReductionDetail",
-    "Luminance Detail"
-  },
-  {
-    "LuminanceNoiseReductionContrast",
-    "Luminance Contrast"
-  },
-  {
-    "ColorNoiseReduction",
-    "Color Noise Reduction"
-  },
-  {
-    "ColorNoiseReductionDetail",
-    "Color Noise Reduction Detail"
-  },
-  {
-    "ColorNoiseReductionSmoothness",
-    "Color Noise Reduction Smoothness"
-  },
-  {
-    "EnableLensCorrections",
-    "Enable Lens Corrections"
-  },
-  {
-    "LensProfileEnable",
-    "Toggle Profile Corrections"
-  },
-  {
-    "LensProfileSetup",
-    "Lens Profile Setup"
-  },
-  {
-    "AutoLateralCA",
-    "Remove Chromatic Aberration"
-  },
-  {
-    "ChromaticAberrationB",
-    "Blue Chromatic Aberration"
-  },
-  {
-    "ChromaticAberrationR",
-    "Red Chromatic Aberration"
-  },
-  {
-    "LensProfileDistortionScale",
-    "Lens Profile Distortion Scale"
-  },
-  {
-    "LensProfileChromaticAberrationScale",
-    "Lens Profile Chromatic Aberration Scale"
-  },
-  {
-    "LensProfileVignettingScale",
-    "Lens Profile Vignetting Scale"
-  },
-  {
-    "CropConstrainToWarp",
-    "Constrain to Warp"
-  },
-  {
-    "DefringePurpleAmount",
-    "Defringe Purple Amount"
-  },
-  {
-    "DefringePurpleHueLo",
-    "Defringe Purple Hue - Low"
-  },
-  {
-    "DefringePurpleHueHi",
-    "Defringe Purple Hue - High"
-  },
-  {
-    "DefringeGreenAmount",
-    "Defringe Green Amount"
-  },
-  {
-    "DefringeGreenHueLo",
-    "Defringe Green Hue - Low"
-  },
-  {
-    "DefringeGreenHueHi",
-    "Defringe Green Hue - High"
-  },
-  {
-    "LensManualDistortionAmount",
-    "Lens Manual Distortion Amount"
-  },
-  {
-    "VignetteAmount",
-    "Vignette Amount"
-  },
-  {
-    "VignetteMidpoint",
-    "Vignette Midpoint"
-  },
-  {
-    "EnableTransform",
-    "Enable Transform"
-  },
-  {
-    "PerspectiveUpright",
-    "Perspective Upright"
-  },
-  {
-    "PerspectiveVertical",
-    "Perspective Vertical"
-  },
-  {
-    "PerspectiveHorizontal",
-    "Perspective Horizontal"
-  },
-  {
-    "PerspectiveRotate",
-    "Perspective Rotate"
-  },
-  {
-    "PerspectiveScale",
-    "Perspective Scale"
-  },
-  {
-    "PerspectiveAspect",
-    "Perspective Aspect"
-  },
-  {
-    "PerspectiveX",
-    "Perspective X"
-  },
-  {
-    "PerspectiveY",
-    "Perspective Y"
-  },
-  {
-    "EnableEffects",
-    "Enable Effects"
-  },
-  {
-    "Dehaze",
-    "Dehaze Amount"
-  },
-  {
-    "PostCropVignetteAmount",
-    "Post Crop Vignette Amount"
-  },
-  {
-    "PostCropVignetteMidpoint",
-    "Post Crop Vignette Midpoint"
-  },
-  {
-    "PostCropVignetteFeather",
-    "Post Crop Vignette Feather"
-  },
-  {
-    "PostCropVignetteRoundness",
-    "Post Crop Vignette Roundness"
-  },
-  {
-    "PostCropVignetteStyle",
-    "Post Crop Vignette Style"
-  },
-  {
-    "PostCropVignetteHighlightContrast",
-    "Post Crop Vignette Highlight Contrast"
-  },
-  {
-    "GrainAmount",
-    "Grain Amount"
-  },
-  {
-    "GrainSize",
-    "Grain Size"
-  },
-  {
-    "GrainFrequency",
-    "Grain Roughness"
-  },
-  {
-    "EnableCalibration",
-    "Enable Calibration"
-  },
-  {
-    "CameraProfile",
-    "Camera Profile"
-  },
-  {
-    "ShadowTint",
-    "Shadow Tint Calibration"
-  },
-  {
-    "RedHue",
-    "Red Hue Calibration"
-  },
-  {
-    "RedSaturation",
-    "Red Saturation Calibration"
-  },
-  {
-    "GreenHue",
-    "Green Hue Calibration"
-  },
-  {
-    "GreenSaturation",
-    "Green Saturation Calibration"
-  },
-  {
-    "BlueHue",
-    "Blue Hue Calibration"
-  },
-  {
-    "BlueSaturation",
-    "Blue Saturation Calibration"
-  },
-  {
-    "RedEyeInfo",
-    "Red-Eye Information"
-  },
-  {
-    "EnableCircularGradientBasedCorrections",
-    "Enable Radial Filter"
-  },
-  {
-    "EnableGradientBasedCorrections",
-    "Enable Graduated Filter"
-  },
-  {
-    "EnablePaintBasedCorrections",
-    "Enable Brush Adjustments"
-  },
-  {
-    "EnableRedEye",
-    "Enable Red-Eye"
-  },
-  {
-    "EnableRetouch",
-    "Enable Spot Removal"
-  },
-  {
-    "RetouchInfo",
-    "RetouchInfo"
-  },
-  {
-    "orientation",
-    "orientation"
-  },
-  {
-    "CropAngle",
-    "Crop Angle"
-  },
-  {
-    "CropBottom",
-    "Crop - Bottom"
-  },
-  {
-    "CropLeft",
-    "Crop - Left"
-  },
-  {
-    "CropRight",
-    "Crop - Right"
-  },
-  {
-    "CropTop",
-    "Crop - Top"
-  },
-  {
-    "TrimEnd",
-    "Set Trim End"
-  },
-  {
-    "TrimStart",
-    "Set Trim Start"
-  }
-}
-  local SelectivePasteHidden = {
-  Clarity2012 = "Clarity",
-  Contrast2012 = "Contrast",
-  Exposure2012 = "Exposure",
-  Highlights2012 = "Highlights",
-  ToneCurveName = "ToneCurve",
-  ToneCurveName2012 = "ToneCurve",
-  ToneCurvePV2012 = "ToneCurve",
-  ToneCurvePV2012Blue = "ToneCurve",
-  ToneCurvePV2012Green = "ToneCurve",
-  ToneCurvePV2012Red = "ToneCurve"
-}
   local SelectivePasteIteration = {
   "ProcessVersion",
   "WhiteBalance",
@@ -763,172 +173,6 @@
   "CropTop",
   "TrimEnd",
   "TrimStart"
-}
-  local SelectivePasteGroups = {
-  basicTone = {
-    "ProcessVersion",
-    "WhiteBalance",
-    "AutoBrightness",
-    "AutoContrast",
-    "AutoExposure",
-    "AutoShadows",
-    "Temperature",
-    "Tint",
-    "Exposure",
-    "Contrast",
-    "Highlights",
-    "Brightness",
-    "HighlightRecovery",
-    "Shadows2012",
-    "FillLight",
-    "Whites2012",
-    "Blacks2012",
-    "Clarity",
-    "Vibrance",
-    "Saturation"
-  },
-  calibratePanel = {
-    "EnableCalibration",
-    "CameraProfile",
-    "ShadowTint",
-    "RedHue",
-    "RedSaturation",
-    "GreenHue",
-    "GreenSaturation",
-    "BlueHue",
-    "BlueSaturation"
-  },
-  colorAdjustments = {
-    "EnableColorAdjustments",
-    "SaturationAdjustmentRed",
-    "SaturationAdjustmentOrange",
-    "SaturationAdjustmentYellow",
-    "SaturationAdjustmentGreen",
-    "SaturationAdjustmentAqua",
-    "SaturationAdjustmentBlue",
-    "SaturationAdjustmentPurple",
-    "SaturationAdjustmentMagenta",
-    "HueAdjustmentRed",
-    "HueAdjustmentOrange",
-    "HueAdjustmentYellow",
-    "HueAdjustmentGreen",
-    "HueAdjustmentAqua",
-    "HueAdjustmentBlue",
-    "HueAdjustmentPurple",
-    "HueAdjustmentMagenta",
-    "LuminanceAdjustmentRed",
-    "LuminanceAdjustmentOrange",
-    "LuminanceAdjustmentYellow",
-    "LuminanceAdjustmentGreen",
-    "LuminanceAdjustmentAqua",
-    "LuminanceAdjustmentBlue",
-    "LuminanceAdjustmentPurple",
-    "LuminanceAdjustmentMagenta",
-    "ConvertToGrayscale",
-    "EnableGrayscaleMix",
-    "GrayMixerRed",
-    "GrayMixerOrange",
-    "GrayMixerYellow",
-    "GrayMixerGreen",
-    "GrayMixerAqua",
-    "GrayMixerBlue",
-    "GrayMixerPurple",
-    "GrayMixerMagenta"
-  },
-  detailPanel = {
-    "EnableDetail",
-    "Sharpness",
-    "SharpenRadius",
-    "SharpenDetail",
-    "SharpenEdgeMasking",
-    "LuminanceSmoothing",
-    "LuminanceNoiseReductionDetail",
-    "LuminanceNoiseReductionContrast",
-    "ColorNoiseReduction",
-    "ColorNoiseReductionDetail",
-    "ColorNoiseReductionSmoothness"
-  },
-  effectsPanel = {
-    "EnableEffects",
-    "Dehaze",
-    "PostCropVignetteAmount",
-    "PostCropVignetteMidpoint",
-    "PostCropVignetteFeather",
-    "PostCropVignetteRoundness",
-    "PostCropVignetteStyle",
-    "PostCropVignetteHighlightContrast",
-    "GrainAmount",
-    "GrainSize",
-    "GrainFrequency"
-  },
-  lensCorrectionsPanel = {
-    "EnableLensCorrections",
-    "LensProfileEnable",
-    "LensProfileSetup",
-    "AutoLateralCA",
-    "ChromaticAberrationB",
-    "ChromaticAberrationR",
-    "LensProfileDistortionScale",
-    "LensProfileChromaticAberrationScale",
-    "LensProfileVignettingScale",
-    "CropConstrainToWarp",
-    "DefringePurpleAmount",
-    "DefringePurpleHueLo",
-    "DefringePurpleHueHi",
-    "DefringeGreenAmount",
-    "DefringeGreenHueLo",
-    "DefringeGreenHueHi",
-    "LensManualDistortionAmount",
-    "VignetteAmount",
-    "VignetteMidpoint"
-  },
-  localizedAdjustments = {
-    "RedEyeInfo",
-    "EnableCircularGradientBasedCorrections",
-    "EnableGradientBasedCorrections",
-    "EnablePaintBasedCorrections",
-    "EnableRedEye",
-    "EnableRetouch",
-    "RetouchInfo"
-  },
-  miscellaneous = {
-    "orientation",
-    "CropAngle",
-    "CropBottom",
-    "CropLeft",
-    "CropRight",
-    "CropTop"
-  },
-  splitToningPanel = {
-    "EnableSplitToning",
-    "SplitToningShadowHue",
-    "SplitToningShadowSaturation",
-    "SplitToningHighlightHue",
-    "SplitToningHighlightSaturation",
-    "SplitToningBalance"
-  },
-  toneCurve = {
-    "EnableToneCurve",
-    "ToneCurve",
-    "ParametricDarks",
-    "ParametricLights",
-    "ParametricShadows",
-    "ParametricHighlights",
-    "ParametricShadowSplit",
-    "ParametricMidtoneSplit",
-    "ParametricHighlightSplit"
-  },
-  transformPanel = {
-    "EnableTransform",
-    "PerspectiveUpright",
-    "PerspectiveVertical",
-    "PerspectiveHorizontal",
-    "PerspectiveRotate",
-    "PerspectiveScale",
-    "PerspectiveAspect",
-    "PerspectiveX",
-    "PerspectiveY"
-  }
 }
   local LimitEligible = {
   Blacks = {
@@ -1950,13 +1194,565 @@
   local_Whites2012 = "Local Adjustments Whites",
   straightenAngle = "Straighten Angle"
 }  
+  local CommandIds = {
+  "Key1",
+  "Key2",
+  "Key3",
+  "Key4",
+  "Key5",
+  "Key6",
+  "Key7",
+  "Key8",
+  "Key9",
+  "Key10",
+  "Key11",
+  "Key12",
+  "Key13",
+  "Key14",
+  "Key15",
+  "Key16",
+  "Key17",
+  "Key18",
+  "Key19",
+  "Key20",
+  "Key21",
+  "Key22",
+  "Key23",
+  "Key24",
+  "Key25",
+  "Key26",
+  "Key27",
+  "Key28",
+  "Key29",
+  "Key30",
+  "Key31",
+  "Key32",
+  "Key33",
+  "Key34",
+  "Key35",
+  "Key36",
+  "Key37",
+  "Key38",
+  "Key39",
+  "Key40",
+  "Filter_1",
+  "Filter_2",
+  "Filter_3",
+  "Filter_4",
+  "Filter_5",
+  "Filter_6",
+  "Filter_7",
+  "Filter_8",
+  "Filter_9",
+  "Filter_10",
+  "Filter_11",
+  "Filter_12",
+  "ShoVwgrid",
+  "ShoVwloupe",
+  "ShoVwcompare",
+  "ShoVwsurvey",
+  "ToggleZoomOffOn",
+  "ZoomInLargeStep",
+  "ZoomInSmallStep",
+  "ZoomOutSmallStep",
+  "ZoomOutLargeStep",
+  "Select1Left",
+  "Select1Right",
+  "Next",
+  "Prev",
+  "ActionSeries1",
+  "ActionSeries2",
+  "ActionSeries3",
+  "ActionSeries4",
+  "ActionSeries5",
+  "ActionSeries6",
+  "ActionSeries7",
+  "ActionSeries8",
+  "ActionSeries9",
+  "SwToMlibrary",
+  "Pick",
+  "Reject",
+  "RemoveFlag",
+  "SetRating0",
+  "SetRating1",
+  "SetRating2",
+  "SetRating3",
+  "SetRating4",
+  "SetRating5",
+  "IncreaseRating",
+  "DecreaseRating",
+  "ToggleBlue",
+  "ToggleGreen",
+  "ToggleRed",
+  "TogglePurple",
+  "ToggleYellow",
+  "ShoVwpeople",
+  "SwToMdevelop",
+  "LRCopy",
+  "LRPaste",
+  "CopySettings",
+  "PasteSettings",
+  "PasteSelectedSettings",
+  "VirtualCopy",
+  "ResetAll",
+  "ResetLast",
+  "IncrementLastDevelopParameter",
+  "DecrementLastDevelopParameter",
+  "Undo",
+  "Redo",
+  "ShoVwdevelop_before_after_horiz",
+  "ShoVwdevelop_before_after_vert",
+  "ShoVwdevelop_before",
+  "ShoVwRefHoriz",
+  "ShoVwRefVert",
+  "ShoVwdevelop_loupe",
+  "RevealPanelAdjust",
+  "WhiteBalanceAs_Shot",
+  "WhiteBalanceAuto",
+  "WhiteBalanceCloudy",
+  "WhiteBalanceDaylight",
+  "WhiteBalanceFlash",
+  "WhiteBalanceFluorescent",
+  "WhiteBalanceShade",
+  "WhiteBalanceTungsten",
+  "AutoTone",
+  "Temperature",
+  "Tint",
+  "Exposure",
+  "Contrast",
+  "Highlights",
+  "Brightness",
+  "Shadows",
+  "Whites",
+  "Blacks",
+  "Clarity",
+  "Vibrance",
+  "Saturation",
+  "ResetTemperature",
+  "ResetTint",
+  "ResetExposure",
+  "ResetContrast",
+  "ResetHighlights",
+  "ResetShadows",
+  "ResetWhites",
+  "ResetBlacks",
+  "ResetClarity",
+  "ResetVibrance",
+  "ResetSaturation",
+  "RevealPanelTone",
+  "EnableToneCurve",
+  "ParametricDarks",
+  "ParametricLights",
+  "ParametricShadows",
+  "ParametricHighlights",
+  "ParametricShadowSplit",
+  "ParametricMidtoneSplit",
+  "ParametricHighlightSplit",
+  "ResetParametricDarks",
+  "ResetParametricLights",
+  "ResetParametricShadows",
+  "ResetParametricHighlights",
+  "ResetParametricShadowSplit",
+  "ResetParametricMidtoneSplit",
+  "ResetParametricHighlightSplit",
+  "PointCurveLinear",
+  "PointCurveMediumContrast",
+  "PointCurveStrongContrast",
+  "RevealPanelMixer",
+  "EnableColorAdjustments",
+  "SaturationAdjustmentRed",
+  "SaturationAdjustmentOrange",
+  "SaturationAdjustmentYellow",
+  "SaturationAdjustmentGreen",
+  "SaturationAdjustmentAqua",
+  "SaturationAdjustmentBlue",
+  "SaturationAdjustmentPurple",
+  "SaturationAdjustmentMagenta",
+  "AllSaturationAdjustment",
+  "HueAdjustmentRed",
+  "HueAdjustmentOrange",
+  "HueAdjustmentYellow",
+  "HueAdjustmentGreen",
+  "HueAdjustmentAqua",
+  "HueAdjustmentBlue",
+  "HueAdjustmentPurple",
+  "HueAdjustmentMagenta",
+  "LuminanceAdjustmentRed",
+  "LuminanceAdjustmentOrange",
+  "LuminanceAdjustmentYellow",
+  "LuminanceAdjustmentGreen",
+  "LuminanceAdjustmentAqua",
+  "LuminanceAdjustmentBlue",
+  "LuminanceAdjustmentPurple",
+  "LuminanceAdjustmentMagenta",
+  "ConvertToGrayscale",
+  "EnableGrayscaleMix",
+  "GrayMixerRed",
+  "GrayMixerOrange",
+  "GrayMixerYellow",
+  "GrayMixerGreen",
+  "GrayMixerAqua",
+  "GrayMixerBlue",
+  "GrayMixerPurple",
+  "GrayMixerMagenta",
+  "ResetSaturationAdjustmentRed",
+  "ResetSaturationAdjustmentOrange",
+  "ResetSaturationAdjustmentYellow",
+  "ResetSaturationAdjustmentGreen",
+  "ResetSaturationAdjustmentAqua",
+  "ResetSaturationAdjustmentBlue",
+  "ResetSaturationAdjustmentPurple",
+  "ResetSaturationAdjustmentMagenta",
+  "ResetAllSaturationAdjustment",
+  "ResetHueAdjustmentRed",
+  "ResetHueAdjustmentOrange",
+  "ResetHueAdjustmentYellow",
+  "ResetHueAdjustmentGreen",
+  "ResetHueAdjustmentAqua",
+  "ResetHueAdjustmentBlue",
+  "ResetHueAdjustmentPurple",
+  "ResetHueAdjustmentMagenta",
+  "ResetLuminanceAdjustmentRed",
+  "ResetLuminanceAdjustmentOrange",
+  "ResetLuminanceAdjustmentYellow",
+  "ResetLuminanceAdjustmentGreen",
+  "ResetLuminanceAdjustmentAqua",
+  "ResetLuminanceAdjustmentBlue",
+  "ResetLuminanceAdjustmentPurple",
+  "ResetLuminanceAdjustmentMagenta",
+  "ResetGrayMixerRed",
+  "ResetGrayMixerOrange",
+  "ResetGrayMixerYellow",
+  "ResetGrayMixerGreen",
+  "ResetGrayMixerAqua",
+  "ResetGrayMixerBlue",
+  "ResetGrayMixerPurple",
+  "ResetGrayMixerMagenta",
+  "RevealPanelSplit",
+  "EnableSplitToning",
+  "SplitToningShadowHue",
+  "SplitToningShadowSaturation",
+  "SplitToningHighlightHue",
+  "SplitToningHighlightSaturation",
+  "SplitToningBalance",
+  "ResetSplitToningShadowHue",
+  "ResetSplitToningShadowSaturation",
+  "ResetSplitToningHighlightHue",
+  "ResetSplitToningHighlightSaturation",
+  "ResetSplitToningBalance",
+  "RevealPanelDetail",
+  "EnableDetail",
+  "Sharpness",
+  "SharpenRadius",
+  "SharpenDetail",
+  "SharpenEdgeMasking",
+  "LuminanceSmoothing",
+  "LuminanceNoiseReductionDetail",
+  "LuminanceNoiseReductionContrast",
+  "ColorNoiseReduction",
+  "ColorNoiseReductionDetail",
+  "ColorNoiseReductionSmoothness",
+  "ResetSharpness",
+  "ResetSharpenRadius",
+  "ResetSharpenDetail",
+  "ResetSharpenEdgeMasking",
+  "ResetLuminanceSmoothing",
+  "ResetLuminanceNoiseReductionDetail",
+  "ResetLuminanceNoiseReductionContrast",
+  "ResetColorNoiseReduction",
+  "ResetColorNoiseReductionDetail",
+  "ResetColorNoiseReductionSmoothness",
+  "RevealPanelLens",
+  "EnableLensCorrections",
+  "LensProfileEnable",
+  "AutoLateralCA",
+  "LensProfileDistortionScale",
+  "LensProfileChromaticAberrationScale",
+  "LensProfileVignettingScale",
+  "CropConstrainToWarp",
+  "ResetLensProfileDistortionScale",
+  "ResetLensProfileChromaticAberrationScale",
+  "ResetLensProfileVignettingScale",
+  "DefringePurpleAmount",
+  "DefringePurpleHueLo",
+  "DefringePurpleHueHi",
+  "DefringeGreenAmount",
+  "DefringeGreenHueLo",
+  "DefringeGreenHueHi",
+  "ResetDefringePurpleAmount",
+  "ResetDefringePurpleHueLo",
+  "ResetDefringePurpleHueHi",
+  "ResetDefringeGreenAmount",
+  "ResetDefringeGreenHueLo",
+  "ResetDefringeGreenHueHi",
+  "LensManualDistortionAmount",
+  "VignetteAmount",
+  "VignetteMidpoint",
+  "ResetLensManualDistortionAmount",
+  "ResetVignetteAmount",
+  "ResetVignetteMidpoint",
+  "RevealPanelTransform",
+  "EnableTransform",
+  "UprightOff",
+  "UprightAuto",
+  "UprightLevel",
+  "UprightVertical",
+  "UprightGuided",
+  "UprightFull",
+  "ResetPerspectiveUpright",
+  "PerspectiveVertical",
+  "PerspectiveHorizontal",
+  "PerspectiveRotate",
+  "PerspectiveScale",
+  "PerspectiveAspect",
+  "PerspectiveX",
+  "PerspectiveY",
+  "ResetPerspectiveVertical",
+  "ResetPerspectiveHorizontal",
+  "ResetPerspectiveRotate",
+  "ResetPerspectiveScale",
+  "ResetPerspectiveAspect",
+  "ResetPerspectiveX",
+  "ResetPerspectiveY",
+  "RevealPanelEffects",
+  "EnableEffects",
+  "Dehaze",
+  "PostCropVignetteAmount",
+  "PostCropVignetteMidpoint",
+  "PostCropVignetteFeather",
+  "PostCropVignetteRoundness",
+  "PostCropVignetteStyle",
+  "PostCropVignetteStyleHighlightPriority",
+  "PostCropVignetteStyleColorPriority",
+  "PostCropVignetteStylePaintOverlay",
+  "PostCropVignetteHighlightContrast",
+  "GrainAmount",
+  "GrainSize",
+  "GrainFrequency",
+  "ResetDehaze",
+  "ResetPostCropVignetteAmount",
+  "ResetPostCropVignetteMidpoint",
+  "ResetPostCropVignetteFeather",
+  "ResetPostCropVignetteRoundness",
+  "ResetPostCropVignetteStyle",
+  "ResetPostCropVignetteHighlightContrast",
+  "ResetGrainAmount",
+  "ResetGrainSize",
+  "ResetGrainFrequency",
+  "RevealPanelCalibrate",
+  "EnableCalibration",
+  "Profile_Adobe_Standard",
+  "Profile_Camera_Clear",
+  "Profile_Camera_Darker_Skin_Tone",
+  "Profile_Camera_Deep",
+  "Profile_Camera_Faithful",
+  "Profile_Camera_Flat",
+  "Profile_Camera_Landscape",
+  "Profile_Camera_Light",
+  "Profile_Camera_Lighter_Skin_Tone",
+  "Profile_Camera_Monochrome",
+  "Profile_Camera_Monotone",
+  "Profile_Camera_Muted",
+  "Profile_Camera_Natural",
+  "Profile_Camera_Neutral",
+  "Profile_Camera_Portrait",
+  "Profile_Camera_Positive_Film",
+  "Profile_Camera_Standard",
+  "Profile_Camera_Vivid",
+  "Profile_Camera_Vivid_Blue",
+  "Profile_Camera_Vivid_Green",
+  "Profile_Camera_Vivid_Red",
+  "ShadowTint",
+  "RedHue",
+  "RedSaturation",
+  "GreenHue",
+  "GreenSaturation",
+  "BlueHue",
+  "BlueSaturation",
+  "ResetShadowTint",
+  "ResetRedHue",
+  "ResetRedSaturation",
+  "ResetGreenHue",
+  "ResetGreenSaturation",
+  "ResetBlueHue",
+  "ResetBlueSaturation",
+  "Preset_1",
+  "Preset_2",
+  "Preset_3",
+  "Preset_4",
+  "Preset_5",
+  "Preset_6",
+  "Preset_7",
+  "Preset_8",
+  "Preset_9",
+  "Preset_10",
+  "Preset_11",
+  "Preset_12",
+  "Preset_13",
+  "Preset_14",
+  "Preset_15",
+  "Preset_16",
+  "Preset_17",
+  "Preset_18",
+  "Preset_19",
+  "Preset_20",
+  "Preset_21",
+  "Preset_22",
+  "Preset_23",
+  "Preset_24",
+  "Preset_25",
+  "Preset_26",
+  "Preset_27",
+  "Preset_28",
+  "Preset_29",
+  "Preset_30",
+  "Preset_31",
+  "Preset_32",
+  "Preset_33",
+  "Preset_34",
+  "Preset_35",
+  "Preset_36",
+  "Preset_37",
+  "Preset_38",
+  "Preset_39",
+  "Preset_40",
+  "Preset_41",
+  "Preset_42",
+  "Preset_43",
+  "Preset_44",
+  "Preset_45",
+  "Preset_46",
+  "Preset_47",
+  "Preset_48",
+  "Preset_49",
+  "Preset_50",
+  "Preset_51",
+  "Preset_52",
+  "Preset_53",
+  "Preset_54",
+  "Preset_55",
+  "Preset_56",
+  "Preset_57",
+  "Preset_58",
+  "Preset_59",
+  "Preset_60",
+  "Preset_61",
+  "Preset_62",
+  "Preset_63",
+  "Preset_64",
+  "Preset_65",
+  "Preset_66",
+  "Preset_67",
+  "Preset_68",
+  "Preset_69",
+  "Preset_70",
+  "Preset_71",
+  "Preset_72",
+  "Preset_73",
+  "Preset_74",
+  "Preset_75",
+  "Preset_76",
+  "Preset_77",
+  "Preset_78",
+  "Preset_79",
+  "Preset_80",
+  "GraduatedFilter",
+  "RadialFilter",
+  "RedEye",
+  "SpotRemoval",
+  "AdjustmentBrush",
+  "local_Temperature",
+  "local_Tint",
+  "local_Exposure",
+  "local_Contrast",
+  "local_Highlights",
+  "local_Shadows",
+  "local_Whites2012",
+  "local_Blacks2012",
+  "local_Clarity",
+  "local_Dehaze",
+  "local_Saturation",
+  "local_Sharpness",
+  "local_LuminanceNoise",
+  "local_Moire",
+  "local_Defringe",
+  "local_ToningLuminance",
+  "Resetlocal_Temperature",
+  "Resetlocal_Tint",
+  "Resetlocal_Exposure",
+  "Resetlocal_Contrast",
+  "Resetlocal_Highlights",
+  "Resetlocal_Shadows",
+  "Resetlocal_Whites2012",
+  "Resetlocal_Blacks2012",
+  "Resetlocal_Clarity",
+  "Resetlocal_Dehaze",
+  "Resetlocal_Saturation",
+  "Resetlocal_Sharpness",
+  "Resetlocal_LuminanceNoise",
+  "Resetlocal_Moire",
+  "Resetlocal_Defringe",
+  "Resetlocal_ToningLuminance",
+  "EnableCircularGradientBasedCorrections",
+  "EnableGradientBasedCorrections",
+  "EnablePaintBasedCorrections",
+  "EnableRedEye",
+  "EnableRetouch",
+  "ResetCircGrad",
+  "ResetGradient",
+  "ResetBrushing",
+  "ResetRedeye",
+  "ResetSpotRem",
+  "ShowMaskOverlay",
+  "CycleMaskOverlayColor",
+  "LocalPreset1",
+  "LocalPreset2",
+  "LocalPreset3",
+  "LocalPreset4",
+  "LocalPreset5",
+  "LocalPreset6",
+  "LocalPreset7",
+  "LocalPreset8",
+  "straightenAngle",
+  "CropAngle",
+  "CropBottom",
+  "CropLeft",
+  "CropRight",
+  "CropTop",
+  "ResetCrop",
+  "ResetstraightenAngle",
+  "CropOverlay",
+  "Loupe",
+  "SwToMmap",
+  "SwToMbook",
+  "SwToMslideshow",
+  "SwToMprint",
+  "SwToMweb",
+  "ShoScndVwloupe",
+  "ShoScndVwlive_loupe",
+  "ShoScndVwlocked_loupe",
+  "ShoScndVwgrid",
+  "ShoScndVwcompare",
+  "ShoScndVwsurvey",
+  "ShoScndVwslideshow",
+  "ToggleScreenTwo",
+  "profile1",
+  "profile2",
+  "profile3",
+  "profile4",
+  "profile5",
+  "profile6",
+  "profile7",
+  "profile8",
+  "profile9",
+  "profile10",
+  "FullRefresh"
+}
 return {
-    SelectivePasteMenu = SelectivePasteMenu,
-    SelectivePasteHidden = SelectivePasteHidden,
     SelectivePasteIteration = SelectivePasteIteration,
-    SelectivePasteGroups = SelectivePasteGroups,
     LimitEligible = LimitEligible,
     SendToMidi = SendToMidi,
     ProfileMap = ProfileMap,
     ParamDisplay = ParamDisplay,
+    CommandIds = CommandIds,
     }
\ No newline at end of file
@@ -17,7 +17,7 @@ PARTICULAR PURPOSE.  See the GNU General Public License for more details.
 You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>. 
 ------------------------------------------------------------------------------]]
-local ParamList  = require 'ParamList'
+local PasteMenu  = require 'PasteMenu'
 local LrView     = import 'LrView'
 
 
@@ -39,12 +39,12 @@ local function StartDialog(obstable,f)
   local selectivepastecol = {}
   do 
     local numberofcolumns = 4
-    local breakpoint = math.floor(#ParamList.SelectivePasteMenu / numberofcolumns)
+    local breakpoint = math.floor(#PasteMenu.SelectivePasteMenu / numberofcolumns)
     for col = 1,numberofcolumns do
       selectivepastecol[col] = {}
       for i = ((col-1)*breakpoint+1),(breakpoint*col) do
         selectivepastecol[col][#selectivepastecol[col]+1] = f:checkbox {
-          title = ParamList.SelectivePasteMenu[i][2], value = LrView.bind ('Paste'..ParamList.SelectivePasteMenu[i][1]) 
+          title = PasteMenu.SelectivePasteMenu[i][2], value = LrView.bind ('Paste'..PasteMenu.SelectivePasteMenu[i][1]) 
         } 
       end
       selectivepastecol[col] = f:column (selectivepastecol[col]) -- prepare for use in f:row below
@@ -57,7 +57,7 @@ local function StartDialog(obstable,f)
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/NamedSettingsControls/CheckNone=Check none"),
         action = function ()
-          for _,v in ipairs(ParamList.SelectivePasteMenu) do
+          for _,v in ipairs(PasteMenu.SelectivePasteMenu) do
             obstable['Paste'..v[1]] = false
           end 
         end,
@@ -66,54 +66,54 @@ local function StartDialog(obstable,f)
         title = LOC("$$$/AgCameraRawNamedSettings/NamedSettingsControls/CheckAll=Check all"
         ),
         action = function ()
-          for _,v in ipairs(ParamList.SelectivePasteMenu) do
+          for _,v in ipairs(PasteMenu.SelectivePasteMenu) do
             obstable['Paste'..v[1]] = true
           end 
         end,
       } ,-- push_button 
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/BasicTone=Basic Tone"),
-        action = set_reset (ParamList.SelectivePasteGroups.basicTone),
+        action = set_reset (PasteMenu.SelectivePasteGroups.basicTone),
       }, -- push button
       f:push_button {
         title = LOC("$$$/AgDevelop/CameraRawPanel/TargetName/ToneCurve=Tone Curve"),
-        action = set_reset (ParamList.SelectivePasteGroups.toneCurve),   
+        action = set_reset (PasteMenu.SelectivePasteGroups.toneCurve),   
       }, --push button      
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/Color=Color"),
-        action = set_reset (ParamList.SelectivePasteGroups.colorAdjustments),
+        action = set_reset (PasteMenu.SelectivePasteGroups.colorAdjustments),
       },
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/SplitToning=Split Toning"),
-        action = set_reset (ParamList.SelectivePasteGroups.splitToningPanel),   
+        action = set_reset (PasteMenu.SelectivePasteGroups.splitToningPanel),   
       }, --push button
       f:push_button {
         title = LOC("$$$/AgDevelop/Panel/Detail=Detail"),
-        action = set_reset (ParamList.SelectivePasteGroups.detailPanel),  
+        action = set_reset (PasteMenu.SelectivePasteGroups.detailPanel),  
       }, --push button
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/LensCorrections=Lens Corrections"),
-        action = set_reset (ParamList.SelectivePasteGroups.lensCorrectionsPanel),  
+        action = set_reset (PasteMenu.SelectivePasteGroups.lensCorrectionsPanel),  
       }, --push button      
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/Transform=Transform"),
-        action = set_reset (ParamList.SelectivePasteGroups.transformPanel),
+        action = set_reset (PasteMenu.SelectivePasteGroups.transformPanel),
       }, --push button
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/Effects=Effects"),
-        action = set_reset (ParamList.SelectivePasteGroups.effectsPanel),   
+        action = set_reset (PasteMenu.SelectivePasteGroups.effectsPanel),   
       }, --push button
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/Calibration=Calibration"),
-        action = set_reset (ParamList.SelectivePasteGroups.calibratePanel),   
+        action = set_reset (PasteMenu.SelectivePasteGroups.calibratePanel),   
       }, --push button      
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/LocalAdjustments=Local Adjustments"),
-        action = set_reset (ParamList.SelectivePasteGroups.localizedAdjustments),   
+        action = set_reset (PasteMenu.SelectivePasteGroups.localizedAdjustments),   
       }, --push button
       f:push_button {
         title = LOC("$$$/AgCameraRawNamedSettings/SaveNamedDialog/Crop=Crop"),
-        action = set_reset (ParamList.SelectivePasteGroups.miscellaneous),   
+        action = set_reset (PasteMenu.SelectivePasteGroups.miscellaneous),   
       }, --push button
 
 
@@ -126,10 +126,10 @@ local function EndDialog(obstable, status)
   if status == 'ok' then
     --assign PasteList
     ProgramPreferences.PasteList = {} -- empty out prior settings
-    for _,v in ipairs(ParamList.SelectivePasteMenu) do
+    for _,v in ipairs(PasteMenu.SelectivePasteMenu) do
       ProgramPreferences.PasteList[v[1]] = obstable['Paste'..v[1]]
     end 
-    for k,v in pairs(ParamList.SelectivePasteHidden) do
+    for k,v in pairs(PasteMenu.SelectivePasteHidden) do
       ProgramPreferences.PasteList[k] = ProgramPreferences.PasteList[v]
     end
     ProgramPreferences.PastePopup = obstable.PastePopup
@@ -0,0 +1,781 @@
+  --[[----------------------------------------------------------------------------
+
+  PasteMenu.lua
+
+  This file was auto-generated by MIDI2LR and contains the selective paste menu
+  used by the plugin dialogs. Edits to this file will be lost any time MIDI2LR
+  is updated or the language used by Lightroom changes. Edit Database.lua if you
+  want to have persistent changes to the translations or menu structure.
+
+  This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+  MIDI2LR is free software: you can redistribute it and/or modify it under the
+  terms of the GNU General Public License as published by the Free Software
+  Foundation, either version 3 of the License, or (at your option) any later version.
+
+  MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+  WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+  PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+  You should have received a copy of the GNU General Public License along with
+  MIDI2LR.  If not, see <http://www.gnu.org/licenses/>. 
+  ------------------------------------------------------------------------------]]
+  local SelectivePasteMenu = {
+  {
+    "ProcessVersion",
+    "Process Version"
+  },
+  {
+    "WhiteBalance",
+    "White Balance"
+  },
+  {
+    "AutoBrightness",
+    "Automatic Brightness"
+  },
+  {
+    "AutoContrast",
+    "Automatic Contrast"
+  },
+  {
+    "AutoExposure",
+    "Automatic Exposure"
+  },
+  {
+    "AutoShadows",
+    "Automatic Shadows"
+  },
+  {
+    "Temperature",
+    "Temperature"
+  },
+  {
+    "Tint",
+    "Tint"
+  },
+  {
+    "Exposure",
+    "Exposure"
+  },
+  {
+    "Contrast",
+    "Contrast"
+  },
+  {
+    "Highlights",
+    "Highlights (Highlight Recovery in PV2003 and PV2010)"
+  },
+  {
+    "Brightness",
+    "Brightness"
+  },
+  {
+    "HighlightRecovery",
+    "Highlight Recovery (PV2003 and PV2010)"
+  },
+  {
+    "Shadows2012",
+    "Shadows"
+  },
+  {
+    "FillLight",
+    "Fill Light (PV2003 and PV2010)"
+  },
+  {
+    "Whites2012",
+    "Whites (no effect in PV2003 and PV2010)"
+  },
+  {
+    "Blacks2012",
+    "Blacks"
+  },
+  {
+    "Clarity",
+    "Clarity"
+  },
+  {
+    "Vibrance",
+    "Vibrance"
+  },
+  {
+    "Saturation",
+    "Saturation"
+  },
+  {
+    "EnableToneCurve",
+    "Enable Tone Curve"
+  },
+  {
+    "ToneCurve",
+    "Tone Curve"
+  },
+  {
+    "ParametricDarks",
+    "Dark Tones"
+  },
+  {
+    "ParametricLights",
+    "Light Tones"
+  },
+  {
+    "ParametricShadows",
+    "Shadow Tones"
+  },
+  {
+    "ParametricHighlights",
+    "Highlight Tones"
+  },
+  {
+    "ParametricShadowSplit",
+    "Shadow Split"
+  },
+  {
+    "ParametricMidtoneSplit",
+    "Midtone Split"
+  },
+  {
+    "ParametricHighlightSplit",
+    "Highlight Split"
+  },
+  {
+    "EnableColorAdjustments",
+    "Enable Color Adjustments"
+  },
+  {
+    "SaturationAdjustmentRed",
+    "Saturation Adjustment Red"
+  },
+  {
+    "SaturationAdjustmentOrange",
+    "Saturation Adjustment Orange"
+  },
+  {
+    "SaturationAdjustmentYellow",
+    "Saturation Adjustment Yellow"
+  },
+  {
+    "SaturationAdjustmentGreen",
+    "Saturation Adjustment Green"
+  },
+  {
+    "SaturationAdjustmentAqua",
+    "Saturation Adjustment Aqua"
+  },
+  {
+    "SaturationAdjustmentBlue",
+    "Saturation Adjustment Blue"
+  },
+  {
+    "SaturationAdjustmentPurple",
+    "Saturation Adjustment Purple"
+  },
+  {
+    "SaturationAdjustmentMagenta",
+    "Saturation Adjustment Magenta"
+  },
+  {
+    "HueAdjustmentRed",
+    "Hue Adjustment Red"
+  },
+  {
+    "HueAdjustmentOrange",
+    "Hue Adjustment Orange"
+  },
+  {
+    "HueAdjustmentYellow",
+    "Hue Adjustment Yellow"
+  },
+  {
+    "HueAdjustmentGreen",
+    "Hue Adjustment Green"
+  },
+  {
+    "HueAdjustmentAqua",
+    "Hue Adjustment Aqua"
+  },
+  {
+    "HueAdjustmentBlue",
+    "Hue Adjustment Blue"
+  },
+  {
+    "HueAdjustmentPurple",
+    "Hue Adjustment Purple"
+  },
+  {
+    "HueAdjustmentMagenta",
+    "Hue Adjustment Magenta"
+  },
+  {
+    "LuminanceAdjustmentRed",
+    "Luminance Adjustment Red"
+  },
+  {
+    "LuminanceAdjustmentOrange",
+    "Luminance Adjustment Orange"
+  },
+  {
+    "LuminanceAdjustmentYellow",
+    "Luminance Adjustment Yellow"
+  },
+  {
+    "LuminanceAdjustmentGreen",
+    "Luminance Adjustment Green"
+  },
+  {
+    "LuminanceAdjustmentAqua",
+    "Luminance Adjustment Aqua"
+  },
+  {
+    "LuminanceAdjustmentBlue",
+    "Luminance Adjustment Blue"
+  },
+  {
+    "LuminanceAdjustmentPurple",
+    "Luminance Adjustment Purple"
+  },
+  {
+    "LuminanceAdjustmentMagenta",
+    "Luminance Adjustment Magenta"
+  },
+  {
+    "ConvertToGrayscale",
+    "Convert to Grayscale"
+  },
+  {
+    "EnableGrayscaleMix",
+    "Enable Grayscale Mix"
+  },
+  {
+    "GrayMixerRed",
+    "Gray Mixer Red"
+  },
+  {
+    "GrayMixerOrange",
+    "Gray Mixer Orange"
+  },
+  {
+    "GrayMixerYellow",
+    "Gray Mixer Yellow"
+  },
+  {
+    "GrayMixerGreen",
+    "Gray Mixer Green"
+  },
+  {
+    "GrayMixerAqua",
+    "Gray Mixer Aqua"
+  },
+  {
+    "GrayMixerBlue",
+    "Gray Mixer Blue"
+  },
+  {
+    "GrayMixerPurple",
+    "Gray Mixer Purple"
+  },
+  {
+    "GrayMixerMagenta",
+    "Gray Mixer Magenta"
+  },
+  {
+    "EnableSplitToning",
+    "Enable Split Toning"
+  },
+  {
+    "SplitToningShadowHue",
+    "Shadow Hue"
+  },
+  {
+    "SplitToningShadowSaturation",
+    "Shadow Saturation"
+  },
+  {
+    "SplitToningHighlightHue",
+    "Highlight Hue"
+  },
+  {
+    "SplitToningHighlightSaturation",
+    "Highlight Saturation"
+  },
+  {
+    "SplitToningBalance",
+    "Split Toning Balance"
+  },
+  {
+    "EnableDetail",
+    "Enable Detail"
+  },
+  {
+    "Sharpness",
+    "Sharpness"
+  },
+  {
+    "SharpenRadius",
+    "Sharpen Radius"
+  },
+  {
+    "SharpenDetail",
+    "Sharpen Detail"
+  },
+  {
+    "SharpenEdgeMasking",
+    "Sharpen Edge Masking"
+  },
+  {
+    "LuminanceSmoothing",
+    "Luminance Smoothing"
+  },
+  {
+    "LuminanceNoiseReductionDetail",
+    "Luminance Detail"
+  },
+  {
+    "LuminanceNoiseReductionContrast",
+    "Luminance Contrast"
+  },
+  {
+    "ColorNoiseReduction",
+    "Color Noise Reduction"
+  },
+  {
+    "ColorNoiseReductionDetail",
+    "Color Noise Reduction Detail"
+  },
+  {
+    "ColorNoiseReductionSmoothness",
+    "Color Noise Reduction Smoothness"
+  },
+  {
+    "EnableLensCorrections",
+    "Enable Lens Corrections"
+  },
+  {
+    "LensProfileEnable",
+    "Toggle Profile Corrections"
+  },
+  {
+    "LensProfileSetup",
+    "Lens Profile Setup"
+  },
+  {
+    "AutoLateralCA",
+    "Remove Chromatic Aberration"
+  },
+  {
+    "ChromaticAberrationB",
+    "Blue Chromatic Aberration"
+  },
+  {
+    "ChromaticAberrationR",
+    "Red Chromatic Aberration"
+  },
+  {
+    "LensProfileDistortionScale",
+    "Lens Profile Distortion Scale"
+  },
+  {
+    "LensProfileChromaticAberrationScale",
+    "Lens Profile Chromatic Aberration Scale"
+  },
+  {
+    "LensProfileVignettingScale",
+    "Lens Profile Vignetting Scale"
+  },
+  {
+    "CropConstrainToWarp",
+    "Constrain to Warp"
+  },
+  {
+    "DefringePurpleAmount",
+    "Defringe Purple Amount"
+  },
+  {
+    "DefringePurpleHueLo",
+    "Defringe Purple Hue - Low"
+  },
+  {
+    "DefringePurpleHueHi",
+    "Defringe Purple Hue - High"
+  },
+  {
+    "DefringeGreenAmount",
+    "Defringe Green Amount"
+  },
+  {
+    "DefringeGreenHueLo",
+    "Defringe Green Hue - Low"
+  },
+  {
+    "DefringeGreenHueHi",
+    "Defringe Green Hue - High"
+  },
+  {
+    "LensManualDistortionAmount",
+    "Lens Manual Distortion Amount"
+  },
+  {
+    "VignetteAmount",
+    "Vignette Amount"
+  },
+  {
+    "VignetteMidpoint",
+    "Vignette Midpoint"
+  },
+  {
+    "EnableTransform",
+    "Enable Transform"
+  },
+  {
+    "PerspectiveUpright",
+    "Perspective Upright"
+  },
+  {
+    "PerspectiveVertical",
+    "Perspective Vertical"
+  },
+  {
+    "PerspectiveHorizontal",
+    "Perspective Horizontal"
+  },
+  {
+    "PerspectiveRotate",
+    "Perspective Rotate"
+  },
+  {
+    "PerspectiveScale",
+    "Perspective Scale"
+  },
+  {
+    "PerspectiveAspect",
+    "Perspective Aspect"
+  },
+  {
+    "PerspectiveX",
+    "Perspective X"
+  },
+  {
+    "PerspectiveY",
+    "Perspective Y"
+  },
+  {
+    "EnableEffects",
+    "Enable Effects"
+  },
+  {
+    "Dehaze",
+    "Dehaze Amount"
+  },
+  {
+    "PostCropVignetteAmount",
+    "Post Crop Vignette Amount"
+  },
+  {
+    "PostCropVignetteMidpoint",
+    "Post Crop Vignette Midpoint"
+  },
+  {
+    "PostCropVignetteFeather",
+    "Post Crop Vignette Feather"
+  },
+  {
+    "PostCropVignetteRoundness",
+    "Post Crop Vignette Roundness"
+  },
+  {
+    "PostCropVignetteStyle",
+    "Post Crop Vignette Style"
+  },
+  {
+    "PostCropVignetteHighlightContrast",
+    "Post Crop Vignette Highlight Contrast"
+  },
+  {
+    "GrainAmount",
+    "Grain Amount"
+  },
+  {
+    "GrainSize",
+    "Grain Size"
+  },
+  {
+    "GrainFrequency",
+    "Grain Roughness"
+  },
+  {
+    "EnableCalibration",
+    "Enable Calibration"
+  },
+  {
+    "CameraProfile",
+    "Camera Profile"
+  },
+  {
+    "ShadowTint",
+    "Shadow Tint Calibration"
+  },
+  {
+    "RedHue",
+    "Red Hue Calibration"
+  },
+  {
+    "RedSaturation",
+    "Red Saturation Calibration"
+  },
+  {
+    "GreenHue",
+    "Green Hue Calibration"
+  },
+  {
+    "GreenSaturation",
+    "Green Saturation Calibration"
+  },
+  {
+    "BlueHue",
+    "Blue Hue Calibration"
+  },
+  {
+    "BlueSaturation",
+    "Blue Saturation Calibration"
+  },
+  {
+    "RedEyeInfo",
+    "Red-Eye Information"
+  },
+  {
+    "EnableCircularGradientBasedCorrections",
+    "Enable Radial Filter"
+  },
+  {
+    "EnableGradientBasedCorrections",
+    "Enable Graduated Filter"
+  },
+  {
+    "EnablePaintBasedCorrections",
+    "Enable Brush Adjustments"
+  },
+  {
+    "EnableRedEye",
+    "Enable Red-Eye"
+  },
+  {
+    "EnableRetouch",
+    "Enable Spot Removal"
+  },
+  {
+    "RetouchInfo",
+    "RetouchInfo"
+  },
+  {
+    "orientation",
+    "orientation"
+  },
+  {
+    "CropAngle",
+    "Crop Angle"
+  },
+  {
+    "CropBottom",
+    "Crop - Bottom"
+  },
+  {
+    "CropLeft",
+    "Crop - Left"
+  },
+  {
+    "CropRight",
+    "Crop - Right"
+  },
+  {
+    "CropTop",
+    "Crop - Top"
+  },
+  {
+    "TrimEnd",
+    "Set Trim End"
+  },
+  {
+    "TrimStart",
+    "Set Trim Start"
+  }
+}
+  local SelectivePasteHidden = {
+  Clarity2012 = "Clarity",
+  Contrast2012 = "Contrast",
+  Exposure2012 = "Exposure",
+  Highlights2012 = "Highlights",
+  ToneCurveName = "ToneCurve",
+  ToneCurveName2012 = "ToneCurve",
+  ToneCurvePV2012 = "ToneCurve",
+  ToneCurvePV2012Blue = "ToneCurve",
+  ToneCurvePV2012Green = "ToneCurve",
+  ToneCurvePV2012Red = "ToneCurve"
+}
+  local SelectivePasteGroups = {
+  basicTone = {
+    "ProcessVersion",
+    "WhiteBalance",
+    "AutoBrightness",
+    "AutoContrast",
+    "AutoExposure",
+    "AutoShadows",
+    "Temperature",
+    "Tint",
+    "Exposure",
+    "Contrast",
+    "Highlights",
+    "Brightness",
+    "HighlightRecovery",
+    "Shadows2012",
+    "FillLight",
+    "Whites2012",
+    "Blacks2012",
+    "Clarity",
+    "Vibrance",
+    "Saturation"
+  },
+  calibratePanel = {
+    "EnableCalibration",
+    "CameraProfile",
+    "ShadowTint",
+    "RedHue",
+    "RedSaturation",
+    "GreenHue",
+    "GreenSaturation",
+    "BlueHue",
+    "BlueSaturation"
+  },
+  colorAdjustments = {
+    "EnableColorAdjustments",
+    "SaturationAdjustmentRed",
+    "SaturationAdjustmentOrange",
+    "SaturationAdjustmentYellow",
+    "SaturationAdjustmentGreen",
+    "SaturationAdjustmentAqua",
+    "SaturationAdjustmentBlue",
+    "SaturationAdjustmentPurple",
+    "SaturationAdjustmentMagenta",
+    "HueAdjustmentRed",
+    "HueAdjustmentOrange",
+    "HueAdjustmentYellow",
+    "HueAdjustmentGreen",
+    "HueAdjustmentAqua",
+    "HueAdjustmentBlue",
+    "HueAdjustmentPurple",
+    "HueAdjustmentMagenta",
+    "LuminanceAdjustmentRed",
+    "LuminanceAdjustmentOrange",
+    "LuminanceAdjustmentYellow",
+    "LuminanceAdjustmentGreen",
+    "LuminanceAdjustmentAqua",
+    "LuminanceAdjustmentBlue",
+    "LuminanceAdjustmentPurple",
+    "LuminanceAdjustmentMagenta",
+    "ConvertToGrayscale",
+    "EnableGrayscaleMix",
+    "GrayMixerRed",
+    "GrayMixerOrange",
+    "GrayMixerYellow",
+    "GrayMixerGreen",
+    "GrayMixerAqua",
+    "GrayMixerBlue",
+    "GrayMixerPurple",
+    "GrayMixerMagenta"
+  },
+  detailPanel = {
+    "EnableDetail",
+    "Sharpness",
+    "SharpenRadius",
+    "SharpenDetail",
+    "SharpenEdgeMasking",
+    "LuminanceSmoothing",
+    "LuminanceNoiseReductionDetail",
+    "LuminanceNoiseReductionContrast",
+    "ColorNoiseReduction",
+    "ColorNoiseReductionDetail",
+    "ColorNoiseReductionSmoothness"
+  },
+  effectsPanel = {
+    "EnableEffects",
+    "Dehaze",
+    "PostCropVignetteAmount",
+    "PostCropVignetteMidpoint",
+    "PostCropVignetteFeather",
+    "PostCropVignetteRoundness",
+    "PostCropVignetteStyle",
+    "PostCropVignetteHighlightContrast",
+    "GrainAmount",
+    "GrainSize",
+    "GrainFrequency"
+  },
+  lensCorrectionsPanel = {
+    "EnableLensCorrections",
+    "LensProfileEnable",
+    "LensProfileSetup",
+    "AutoLateralCA",
+    "ChromaticAberrationB",
+    "ChromaticAberrationR",
+    "LensProfileDistortionScale",
+    "LensProfileChromaticAberrationScale",
+    "LensProfileVignettingScale",
+    "CropConstrainToWarp",
+    "DefringePurpleAmount",
+    "DefringePurpleHueLo",
+    "DefringePurpleHueHi",
+    "DefringeGreenAmount",
+    "DefringeGreenHueLo",
+    "DefringeGreenHueHi",
+    "LensManualDistortionAmount",
+    "VignetteAmount",
+    "VignetteMidpoint"
+  },
+  localizedAdjustments = {
+    "RedEyeInfo",
+    "EnableCircularGradientBasedCorrections",
+    "EnableGradientBasedCorrections",
+    "EnablePaintBasedCorrections",
+    "EnableRedEye",
+    "EnableRetouch",
+    "RetouchInfo"
+  },
+  miscellaneous = {
+    "orientation",
+    "CropAngle",
+    "CropBottom",
+    "CropLeft",
+    "CropRight",
+    "CropTop"
+  },
+  splitToningPanel = {
+    "EnableSplitToning",
+    "SplitToningShadowHue",
+    "SplitToningShadowSaturation",
+    "SplitToningHighlightHue",
+    "SplitToningHighlightSaturation",
+    "SplitToningBalance"
+  },
+  toneCurve = {
+    "EnableToneCurve",
+    "ToneCurve",
+    "ParametricDarks",
+    "ParametricLights",
+    "ParametricShadows",
+    "ParametricHighlights",
+    "ParametricShadowSplit",
+    "ParametricMidtoneSplit",
+    "ParametricHighlightSplit"
+  },
+  transformPanel = {
+    "EnableTransform",
+    "PerspectiveUpright",
+    "PerspectiveVertical",
+    "PerspectiveHorizontal",
+    "PerspectiveRotate",
+    "PerspectiveScale",
+    "PerspectiveAspect",
+    "PerspectiveX",
+    "PerspectiveY"
+  }
+}
+return {
+    SelectivePasteMenu = SelectivePasteMenu,
+    SelectivePasteHidden = SelectivePasteHidden,
+    SelectivePasteGroups = SelectivePasteGroups,
+    }
\ No newline at end of file
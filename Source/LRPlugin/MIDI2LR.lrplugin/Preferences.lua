@@ -10,11 +10,15 @@ ProgramPreferences.Limits metatables. undefined Value will set key of shortname
         {param=parameter short name, label = friendly name, order = rank order}
 ProgramPreferences.Limits metatables. undefined maxvalue will set 
          maxvalue={[1]=low,[2]=high} but will return nil if not in develop
-Preferences.Save function. Save to LR storage.
+Preferences.Save function. Save to LR storage, or export to a file with serpent.
+        Each top-level section is stored as its own Lua chunk and only rewritten
+        when it changed.
+Preferences.SaveSections function. Save only the named sections to LR storage.
 ProgramPreferences.Preferences table. Key = subtable name (e.g., 'Limits', 'Presets').
 ProgramPreferences.Presets table. 
 Preferences.Reset function. Sets Preferences.Preferences to default settings.
-Preferences.Load function. Load from LR storage.
+Preferences.Load function. Load from LR storage. Preferences saved by serpent
+        in an earlier version are read once and then stored as sections.
  
 This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
 
@@ -36,6 +40,61 @@ local prefs               = import 'LrPrefs'.prefsForPlugin()
 local serpent             = require 'serpent'
 -- hidden
 local version = 1
+local SECTIONS = 'sections' -- LrPrefs key listing the stored sections
+local SECTION = 'section_' -- prefix of each section's LrPrefs key
+local stored = {} -- chunk last written per section, to skip unchanged ones
+
+-- table constructor in Lua source. Keys and values are strings, numbers,
+-- booleans and tables, which is all ProgramPreferences holds. loadstring reads
+-- this back far faster than serpent.load checks its input
+local function Serialize(value, out)
+  local t = type(value)
+  if t == 'string' then
+    out[#out+1] = string.format('%q', value)
+  elseif t == 'number' then
+    if value ~= value then
+      out[#out+1] = '0/0'
+    elseif value == math.huge then
+      out[#out+1] = '1/0'
+    elseif value == -math.huge then
+      out[#out+1] = '-1/0'
+    elseif value == math.floor(value) and math.abs(value) < 2^31 then
+      out[#out+1] = string.format('%d', value)
+    else
+      out[#out+1] = string.format('%.17g', value)
+    end
+  elseif t == 'table' then
+    out[#out+1] = '{'
+    for k,v in pairs(value) do
+      local kt, vt = type(k), type(v)
+      if (kt == 'string' or kt == 'number' or kt == 'boolean') and
+      (vt == 'string' or vt == 'number' or vt == 'boolean' or vt == 'table') then
+        out[#out+1] = '['
+        Serialize(k, out)
+        out[#out+1] = ']='
+        Serialize(v, out)
+        out[#out+1] = ','
+      end
+    end
+    out[#out+1] = '}'
+  else
+    out[#out+1] = tostring(value)
+  end
+end
+
+local function Chunk(value)
+  local out = {'return '}
+  Serialize(value, out)
+  return table.concat(out)
+end
+
+local function Unchunk(chunk)
+  local f = type(chunk) == 'string' and loadstring(chunk)
+  if not f then return nil end
+  setfenv(f, {}) -- data only
+  local ok, value = pcall(f)
+  if ok then return value end
+end
 
 -- public
 -- preferences table
@@ -46,6 +105,41 @@ local function UseDefaults()
   Init.UseDefaultsAll()
 end
 
+-- arguments name the sections that changed; without any, every section is
+-- serialised and compared with what is stored
+local function SaveSections(...)
+  local only = nil
+  if select('#', ...) > 0 then
+    only = {}
+    for _,name in ipairs{...} do only[name] = true end
+  end
+  local names = {}
+  for name,value in pairs(ProgramPreferences) do
+    if type(name) == 'string' then
+      names[#names+1] = name
+      if only == nil or only[name] then
+        local chunk = Chunk(value)
+        if stored[name] ~= chunk then
+          prefs[SECTION..name] = chunk
+          stored[name] = chunk
+        end
+      end
+    end
+  end
+  table.sort(names)
+  local list = table.concat(names, ',')
+  if prefs[SECTIONS] ~= list then
+    for name in (prefs[SECTIONS] or ''):gmatch('[^,]+') do
+      if ProgramPreferences[name] == nil then
+        prefs[SECTION..name] = nil
+        stored[name] = nil
+      end
+    end
+    prefs[SECTIONS] = list
+    prefs[version] = nil -- serpent copy from an earlier version, now superseded
+  end
+end
+
 local function Save(filename)
   local argtype = type(filename)
   if argtype == 'string' then
@@ -57,13 +151,26 @@ local function Save(filename)
   elseif argtype ~= 'nil' then
     LrDialogs.message(LOC("$$$/AgNetIO/Exceptions/BAD_PARAMETERS=The entered parameters are invalid"))
   else
-    prefs[version] = serpent.dump(ProgramPreferences)
+    SaveSections()
   end
 end
 
 local function Load()
   local loaded = false
-  if type(prefs)=='table' and type(prefs[version])=='string' then
+  if type(prefs[SECTIONS]) == 'string' then
+    ProgramPreferences = {}
+    loaded = true
+    for name in prefs[SECTIONS]:gmatch('[^,]+') do
+      local chunk = prefs[SECTION..name]
+      local value = Unchunk(chunk)
+      if value == nil then
+        loaded = false
+        break
+      end
+      ProgramPreferences[name] = value
+      stored[name] = chunk
+    end
+  elseif type(prefs)=='table' and type(prefs[version])=='string' then
     loaded,ProgramPreferences = serpent.load(prefs[version])
   end
   if loaded ~= true then
@@ -104,4 +211,5 @@ end
 return { --commented out unused exports
   Load = LoadShell,
   Save = Save,
+  SaveSections = SaveSections,
 }
\ No newline at end of file
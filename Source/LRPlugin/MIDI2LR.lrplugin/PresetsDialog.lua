@@ -50,7 +50,7 @@ local function setOptions()
       Presets.EndDialog(properties,result)
       if result == 'ok' then
         --then save preferences
-        Preferences.Save()
+        Preferences.SaveSections('Presets')
       end -- if result ok
       -- finished with assigning values from dialog
     end
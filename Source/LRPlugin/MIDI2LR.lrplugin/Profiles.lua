@@ -21,6 +21,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 local Init                = require 'Init'
 local Limits              = require 'Limits'
 local ParamList           = require 'ParamList'
+local Ut                  = require 'Utilities'
 local LrApplicationView   = import 'LrApplicationView'
 local LrDevelopController = import 'LrDevelopController'
 local LrDialogs           = import 'LrDialogs'
@@ -44,14 +45,16 @@ local function doprofilechange(newprofile)
   resyncDeferred = true
   if Limits.LimitsCanBeSet() then
     -- refresh MIDI controller since mapping has changed
+    local lines = {}
     for _,param in ipairs(ParamList.SendToMidi) do
       local min,max = Limits.GetMinMax(param)
       local lrvalue = LrDevelopController.getValue(param)
       if type(min) == 'number' and type(max) == 'number' and type(lrvalue) == 'number' then
         local midivalue = (lrvalue-min)/(max-min)
-        MIDI2LR.SERVER:send(string.format('%s %g\n', param, midivalue))
+        lines[#lines+1] = string.format('%s %g\n', param, midivalue)
       end
     end
+    Ut.sendSnapshot(lines)
     resyncDeferred = false
   end
 end
@@ -92,7 +95,7 @@ local function changeProfile(profilename, ignoreCurrent)
 end
 
 local function checkProfile()
-  --as this runs 4X/second, doing check against currentTMP here to make it faster than always deferring to changeProfile
+  --as this runs on controller input as well as a poll, doing check against currentTMP here to make it faster than always deferring to changeProfile
   local newmod = LrApplicationView.getCurrentModuleName()
   if newmod == 'develop' then 
     local tool = LrDevelopController.getSelectedTool()
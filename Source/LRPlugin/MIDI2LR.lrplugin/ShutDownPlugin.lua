@@ -21,7 +21,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 if MIDI2LR and MIDI2LR.RUNNING then
   MIDI2LR.RUNNING = false
   if MIDI2LR.SERVER then
-    MIDI2LR.SERVER:send('TerminateApplication 1\n')
+    MIDI2LR.SERVER:send('TerminateApplication 0\n') -- 0: Lightroom quitting, a resident MIDI2LR stays
     MIDI2LR.SERVER:close()
   end
   if MIDI2LR.CLIENT then
@@ -30,8 +30,12 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 local LrApplication       = import 'LrApplication'
 local LrApplicationView   = import 'LrApplicationView'
 local LrDevelopController = import 'LrDevelopController'
+local LrDialogs           = import 'LrDialogs'
+local LrStringUtils       = import 'LrStringUtils'
+local LrTasks             = import 'LrTasks'
 
 --hidden 
+local BEZEL_INTERVAL = 0.1 -- seconds between bezel redraws while a control moves
 local needsModule = {
   [LrDevelopController.addAdjustmentChangeObserver]    = {module = 'develop', photoSelected = false },
   [LrDevelopController.decrement]                      = {module = 'develop', photoSelected = true },
@@ -234,6 +238,96 @@ local function precision(value)
   end
 end
 
+local lastbezel = 0
+local trailingbezel -- arguments of the latest bezel held back, or nil
+local bezelpending = false -- a task will show trailingbezel
+
+local function bezeltext(name, value, digits, actual)
+  digits = digits or precision(value)
+  local text = name..'  '..LrStringUtils.numberToStringWithSeparators(value,digits)
+  if actual then
+    text = text..'  '..LrStringUtils.numberToStringWithSeparators(actual,digits)
+  end
+  return text
+end
+
+--------------------------------------------------------------------------------
+-- Shows a parameter value in the bezel, at most once per BEZEL_INTERVAL
+-- Values arriving faster are not formatted; the last of them is shown once the
+-- interval ends, so the bezel settles on the final value.
+-- @tparam string name Displayed parameter name
+-- @tparam number value Value to show
+-- @tparam[opt] number digits Digits right of the decimal point, default precision(value)
+-- @tparam[opt] number actual Second value shown beside the first
+-- @treturn nil
+--------------------------------------------------------------------------------
+local function showValueBezel(name, value, digits, actual)
+  local now = os.clock()
+  if not bezelpending and (now - lastbezel >= BEZEL_INTERVAL or now < lastbezel) then
+    lastbezel = now
+    LrDialogs.showBezel(bezeltext(name, value, digits, actual))
+    return
+  end
+  trailingbezel = {name, value, digits, actual}
+  if not bezelpending then
+    bezelpending = true
+    LrTasks.startAsyncTask(function()
+        LrTasks.sleep(math.max(0, lastbezel + BEZEL_INTERVAL - os.clock()))
+        local latest = trailingbezel
+        trailingbezel, bezelpending = nil, false
+        lastbezel = os.clock()
+        LrDialogs.showBezel(bezeltext(latest[1], latest[2], latest[3], latest[4]))
+      end)
+  end
+end
+
+local queuedlines = {} -- feedback held by queueFeedback for the next sendSnapshot
+local photogeneration = 1 -- numbers snapshots by target photo, see newPhoto
+
+--------------------------------------------------------------------------------
+-- Holds a parameter line until the next sendSnapshot, so feedback produced
+-- while handling one message frame goes out in one write.
+-- @tparam string line Newline terminated parameter line
+-- @treturn nil
+--------------------------------------------------------------------------------
+local function queueFeedback(line)
+  queuedlines[#queuedlines+1] = line
+end
+
+--------------------------------------------------------------------------------
+-- Starts a new photo generation. Snapshots carry the generation, so MIDI2LR can
+-- skip those for a photo already left when several arrive together.
+-- @treturn nil
+--------------------------------------------------------------------------------
+local function newPhoto()
+  photogeneration = photogeneration + 1
+end
+
+--------------------------------------------------------------------------------
+-- Sends parameter lines to MIDI2LR in one write, after any queued feedback
+-- Several lines are framed as a snapshot so MIDI2LR sends their MIDI to each
+-- device in one pass.
+-- @tparam[opt] table lines Newline terminated parameter lines; omit to send
+-- only the queued feedback
+-- @treturn nil
+--------------------------------------------------------------------------------
+local function sendSnapshot(lines)
+  if queuedlines[1] then
+    for _,line in ipairs(lines or {}) do
+      queuedlines[#queuedlines+1] = line
+    end
+    lines, queuedlines = queuedlines, {}
+  elseif lines == nil then
+    return
+  end
+  if #lines == 1 then
+    MIDI2LR.SERVER:send(lines[1])
+  elseif #lines > 1 then
+    MIDI2LR.SERVER:send(string.format('Snapshot %d\n%sEndSnapshot %d\n', photogeneration,
+        table.concat(lines), photogeneration))
+  end
+end
+
 --- @export
 return { --table of exports, setting table member name and module function it points to
   wrapFOM = wrapFOM,
@@ -243,4 +337,8 @@ return { --table of exports, setting table member name and module function it po
   execFCM = execFCM,
   execFIM = execFIM,
   precision = precision,
+  newPhoto = newPhoto,
+  queueFeedback = queueFeedback,
+  showValueBezel = showValueBezel,
+  sendSnapshot = sendSnapshot,
 }
@@ -19,11 +19,10 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 ------------------------------------------------------------------------------]]
 
 local LrDevelopController = import 'LrDevelopController'
-local LrDialogs           = import 'LrDialogs'
-local LrStringUtils       = import 'LrStringUtils'
 
 local ParamList           = require 'ParamList'
 local CU                  = require 'ClientUtilities'
+local Ut                  = require 'Utilities'
 
 local SaturationAdjustments = {
   "SaturationAdjustmentRed",
@@ -45,7 +44,7 @@ return {
     if ProgramPreferences.ClientShowBezelOnChange then
       local value = CU.MIDIValueToLRValue("SaturationAdjustmentRed", midi_value)
       local bezelname = ParamList.ParamDisplay["AllSaturationAdjustment"] or "AllSaturationAdjustment"
-      LrDialogs.showBezel(bezelname .. '  ' .. LrStringUtils.numberToStringWithSeparators(value, 0))
+      Ut.showValueBezel(bezelname, value, 0)
     end
     return "AllSaturationAdjustment"
   end,
@@ -55,8 +54,8 @@ return {
     end
     if ProgramPreferences.ClientShowBezelOnChange then
       local bezelname = ParamList.ParamDisplay["AllSaturationAdjustment"] or "AllSaturationAdjustment"
-      LrDialogs.showBezel(bezelname .. '  ' .. LrStringUtils.numberToStringWithSeparators(0, 0))
+      Ut.showValueBezel(bezelname, 0, 0)
     end
-    MIDI2LR.SERVER:send(string.format('%s %g\n', "AllSaturationAdjustment", CU.LRValueToMIDIValue("SaturationAdjustmentRed")))
+    Ut.queueFeedback(string.format('%s %g\n', "AllSaturationAdjustment", CU.LRValueToMIDIValue("SaturationAdjustmentRed")))
   end
 }
@@ -21,33 +21,80 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "LR_IPC_In.h"
+#include <algorithm>
+#include <array>
 #include <bitset>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
 #include <gsl/gsl>
+#include "AsyncLog.h"
 #include "CommandMap.h"
 #include "ControlsModel.h"
+#include "LRCommands.h"
+#include "LR_IPC_Out.h"
+#include "OscController.h"
+#include "MIDIProcessor.h"
 #include "MIDISender.h"
 #include "MidiUtilities.h"
+#include "PipelineTrace.h"
+#include "PowerMonitor.h"
 #include "Misc.h"
 #include "ProfileManager.h"
 #include "SendKeys.h"
+#include "ThreadPriority.h"
+#include "ThreadStats.h"
 #include "Utilities/Utilities.h"
 using namespace std::literals::string_literals;
 
 namespace {
     constexpr auto kHost = "127.0.0.1";
-    constexpr int kBufferSize = 256;
+    constexpr size_t kBufferSize = 4096; //longest line from the plugin
     constexpr int kConnectTryTime = 100;
-    constexpr int kEmptyWait = 100;
     constexpr int kLrInPort = 58764;
-    constexpr int kNotConnectedWait = 333;
     constexpr int kReadyWait = 1000;
     constexpr int kStopWait = 1000;
     constexpr int kTimerInterval = 1000;
+    constexpr int kMinRetry = 5; //first connect retry, doubling up to kTimerInterval
+    constexpr int kMaxRing = 127; //encoder ring feedback is a 7-bit position
+
+    // menu sections whose Reset commands each "Reset Group" command sends, in command
+    // order. "Reset Group Mixer" takes the HSL / Color / B&W resets
+    constexpr std::array<const char*, RSJ::kResetGroups> kResetGroupSections{{"Basic",
+        "Tone Curve", "Reset HSL / Color / B&W", "Split Toning", "Detail",
+        "Lens Corrections", "Transform", "Effects", "Camera Calibration"}};
+
+    // "ResetGroup Temperature,Tint,...\n" for a group, built once from the command list
+    const std::string& ResetGroupLine(int group)
+    {
+        static const auto lines = [] {
+            std::array<std::string, RSJ::kResetGroups> built;
+            for (size_t g = 0; g < built.size(); ++g)
+                for (const auto& section : LRCommandList::MenuSections) {
+                    if (std::strcmp(section.title, kResetGroupSections[g]) != 0)
+                        continue;
+                    std::string params;
+                    // ReadableList index i is LRStringList index i + 1, past "Unmapped".
+                    // ResetAll... are virtual commands covering several of the others
+                    for (auto i = section.first + 1; i <= section.first + section.count; ++i) {
+                        const auto& command = LRCommandList::LRStringList[i];
+                        if (command.compare(0, 5, "Reset") || !command.compare(0, 8, "ResetAll"))
+                            continue;
+                        if (!params.empty())
+                            params += ',';
+                        params.append(command, 5, std::string::npos);
+                    }
+                    built[g] = "ResetGroup " + params + '\n';
+                }
+            return built;
+        }();
+        return lines[static_cast<size_t>(group)];
+    }
 }
 
 LR_IPC_IN::LR_IPC_IN(ControlsModel* const c_model, ProfileManager* const pmanager, CommandMap* const cmap):
-    juce::Thread{"LR_IPC_IN"}, command_map_{cmap},
-    controls_model_{c_model}, profile_manager_{pmanager}
+    juce::Thread{"LR_IPC_IN"}, command_map_{cmap}, controls_model_{c_model},
+    profile_manager_{pmanager}
 {}
 
 LR_IPC_IN::~LR_IPC_IN()
@@ -61,11 +108,372 @@ LR_IPC_IN::~LR_IPC_IN()
     socket_.close();
 }
 
-void LR_IPC_IN::Init(std::shared_ptr<MIDISender>& midi_sender) noexcept
+LR_IPC_IN::FeedbackSlot* LR_IPC_IN::FeedbackSlot_(short msgtype, int channel,
+    short controller) const noexcept
+{
+    if (channel < 0 || channel >= kChannels)
+        return nullptr;
+    auto& slots = feedback_[static_cast<size_t>(channel)];
+    switch (msgtype) {
+    case RSJ::kNoteOnFlag:
+    case RSJ::kNoteOffFlag:
+        return controller >= 0 && controller < kControllers ?
+            &slots[static_cast<size_t>(controller)] : nullptr;
+    case RSJ::kCCFlag: //NRPN and 14-bit numbers above 127 aren't cached
+        return controller >= 0 && controller < kControllers ?
+            &slots[static_cast<size_t>(kControllers + controller)] : nullptr;
+    case RSJ::kPWFlag:
+        return &slots[2 * kControllers];
+    default:
+        return nullptr;
+    }
+}
+
+bool LR_IPC_IN::FeedbackChanged_(FeedbackSlot* slot, short value) const noexcept
+{
+    // Lightroom resends every parameter on a photo change, usually to where the
+    // control already is. Skip those so motor faders don't twitch
+    if (!slot)
+        return true;
+    auto last = slot->sent.load(std::memory_order_relaxed);
+    if (last != kUnknownValue && std::abs(value - last) <= feedback_deadband_)
+        return false;
+    // only replaces what was read: if the control moved meanwhile, MIDIcmdCallback's
+    // kUnknownValue stays, and the next feedback isn't skipped either
+    slot->sent.compare_exchange_strong(last, value, std::memory_order_relaxed);
+    return true;
+}
+
+bool LR_IPC_IN::Touched_(const FeedbackSlot& slot, juce::uint32 now) const noexcept
+{
+    return slot.grabbed.load(std::memory_order_relaxed) || (echo_window_ > 0 &&
+        now - slot.touched.load(std::memory_order_relaxed) < static_cast<juce::uint32>(echo_window_));
+}
+
+void LR_IPC_IN::FlushHeld_() const
+{
+    // send what Lightroom last reported for each control that has come to rest
+    if (!held_)
+        return;
+    held_ = false;
+    const auto now = juce::Time::getMillisecondCounter();
+    for (auto channel = 0; channel < kChannels; ++channel)
+        for (auto index = 0; index <= 2 * kControllers; ++index) {
+            auto& slot = feedback_[static_cast<size_t>(channel)][static_cast<size_t>(index)];
+            const auto value = slot.held.load(std::memory_order_relaxed);
+            if (value == kUnknownValue)
+                continue;
+            if (Touched_(slot, now)) {
+                held_ = true; //still moving
+                continue;
+            }
+            slot.held.store(kUnknownValue, std::memory_order_relaxed);
+            const short msgtype = index < kControllers ? RSJ::kNoteOnFlag :
+                index < 2 * kControllers ? RSJ::kCCFlag : RSJ::kPWFlag;
+            const auto controller = gsl::narrow_cast<short>(index % kControllers);
+            if (FeedbackChanged_(&slot, value))
+                SendFeedback_(msgtype, channel + 1, controller, value, Route_(&slot));
+        }
+}
+
+void LR_IPC_IN::MIDIcmdCallback(RSJ::MidiMessage mm)
+{
+    // the control moved, so it may no longer be where feedback last put it
+    if (auto* const slot = FeedbackSlot_(mm.message_type_byte, mm.channel, mm.number)) {
+        slot->sent.store(kUnknownValue, std::memory_order_relaxed);
+        slot->touched.store(juce::Time::getMillisecondCounter(), std::memory_order_relaxed);
+        slot->device.store(mm.device, std::memory_order_relaxed);
+    }
+}
+
+void LR_IPC_IN::TouchCallback(RSJ::MidiMessage mm)
+{
+    const auto fader = controls_model_ ? controls_model_->TouchedFader(mm) : short{-1};
+    auto* const slot = FeedbackSlot_(RSJ::kCCFlag, mm.channel, fader);
+    if (!slot)
+        return;
+    if (mm.message_type_byte == RSJ::kNoteOnFlag && mm.value > 0) {
+        static auto& touches = Instrumentation::Counter("motor fader touches");
+        touches.fetch_add(1, std::memory_order_relaxed);
+        slot->grabbed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    // the hand is off, so the fader goes to Lightroom's latest value now rather than
+    // after the echo window
+    slot->grabbed.store(false, std::memory_order_relaxed);
+    slot->touched.store(0, std::memory_order_relaxed);
+    const auto value = slot->held.exchange(kUnknownValue, std::memory_order_relaxed);
+    if (value != kUnknownValue && FeedbackChanged_(slot, value))
+        SendFeedback_(RSJ::kCCFlag, mm.channel + 1, fader, value, Route_(slot));
+}
+
+void LR_IPC_IN::ResolvedCallback(const RSJ::ResolvedMessage& rm)
+{
+    if (rm.command_flags & RSJ::kCommandProfile) {
+        if (rm.value < 0.4) //as ProfileManager, notes may be < 1
+            return;
+        const auto capture = CommandMap::getCommandCapture(rm.command_id);
+        if (capture >= 0)
+            CaptureSnapshot_(capture);
+        const auto recall = CommandMap::getCommandRecall(rm.command_id);
+        if (recall >= 0)
+            RecallSnapshot_(recall);
+        const auto reset = CommandMap::getCommandResetGroup(rm.command_id);
+        if (reset >= 0)
+            ResetGroup_(reset);
+        const auto batch = CommandMap::getCommandBatch(rm.command_id);
+        if (batch >= 0)
+            Batch_(batch);
+        return;
+    }
+    if (local_echo_)
+        LocalEcho_(rm);
+}
+
+void LR_IPC_IN::CaptureSnapshot_(int snapshot)
+{
+    if (!command_map_)
+        return;
+    std::vector<std::pair<RSJ::CommandId, double>> values;
+    for (const auto command_id : command_map_->getMappedCommands()) {
+        const auto value = mirror_.Get(command_id);
+        if (value >= 0.0 && !(CommandMap::getCommandFlags(command_id) & RSJ::kCommandAction))
+            values.emplace_back(command_id, value);
+    }
+    std::lock_guard<decltype(snapshot_mutex_)> lock(snapshot_mutex_);
+    snapshots_[static_cast<size_t>(snapshot)] = std::move(values);
+}
+
+void LR_IPC_IN::RecallSnapshot_(int snapshot)
+{
+    std::vector<std::pair<RSJ::CommandId, double>> values;
+    {
+        std::lock_guard<decltype(snapshot_mutex_)> lock(snapshot_mutex_);
+        values = snapshots_[static_cast<size_t>(snapshot)];
+    }
+    const auto lr_ipc_out = lr_ipc_out_.lock();
+    if (values.empty() || !lr_ipc_out)
+        return;
+    std::string frame;
+    for (const auto& value : values)
+        LR_IPC_OUT::AppendLine(frame, value.first, value.second, false);
+    lr_ipc_out->sendCommand(frame);
+    // Lightroom's own feedback follows, and only goes out where it differs
+    if (!command_map_ || !midi_sender_)
+        return;
+    midi_sender_->BeginBatch();
+    for (const auto& value : values) {
+        mirror_.Set(value.first, value.second);
+        for (const auto& msg : command_map_->getMessagesForCommandId(value.first))
+            Feedback_(msg, value.second);
+    }
+    midi_sender_->EndBatch();
+}
+
+void LR_IPC_IN::ResetGroup_(int group) const
+{
+    if (const auto lr_ipc_out = lr_ipc_out_.lock())
+        lr_ipc_out->sendCommand(ResetGroupLine(group));
+}
+
+void LR_IPC_IN::Batch_(int command) const
+{
+    static const std::array<std::string, RSJ::kBatchCommands> kLines{{"Batch start\n",
+        "Batch commit\n", "Batch discard\n"}};
+    if (const auto lr_ipc_out = lr_ipc_out_.lock())
+        lr_ipc_out->sendCommand(kLines[static_cast<size_t>(command)]);
+}
+
+void LR_IPC_IN::LocalEcho_(const RSJ::ResolvedMessage& rm)
+{
+    // only relative encoders: their value is the new parameter value unless Lightroom
+    // clamps it, while absolute controls are already where the hand left them and
+    // buttons and macros can't be predicted
+    const auto& mm = rm.message;
+    if (rm.command_flags || rm.target_count || mm.message_type_byte != RSJ::kCCFlag ||
+        !command_map_ || !midi_sender_ || rm.command_id >= mirror_.size() ||
+        controls_model_->getCCmethod(mm.channel, mm.number) == RSJ::CCmethod::absolute)
+        return;
+    mirror_.Set(rm.command_id, rm.value);
+    for (const auto& msg : command_map_->getMessagesForCommandId(rm.command_id)) {
+        if (!command_map_->isVisible(msg) || msg.msg_id_type == RSJ::MsgIdEnum::NOTE)
+            continue;
+        const short msgtype = msg.msg_id_type == RSJ::MsgIdEnum::CC ? RSJ::kCCFlag : RSJ::kPWFlag;
+        const auto controller = gsl::narrow_cast<short>(msg.controller);
+        const auto value = controls_model_->PluginToController(msgtype,
+            static_cast<size_t>(msg.channel - 1), controller, rm.value,
+            static_cast<short>(msg.source));
+        if (msg.source) {
+            SendFeedback_(msgtype, msg.channel, controller, value,
+                RSJ::DeviceIdentifier(static_cast<short>(msg.source)));
+            continue;
+        }
+        // what the control now shows, so the same value from Lightroom isn't resent.
+        // Anything held from before the move is out of date
+        auto* const slot = FeedbackSlot_(msgtype, msg.channel - 1, controller);
+        if (slot) {
+            slot->sent.store(value, std::memory_order_relaxed);
+            slot->held.store(kUnknownValue, std::memory_order_relaxed);
+        }
+        SendFeedback_(msgtype, msg.channel, controller, value, Route_(slot));
+    }
+}
+
+juce::String LR_IPC_IN::Route_(const FeedbackSlot* slot) const
+{
+    // feedback goes back to the device the control is on; empty sends it to all
+    if (!slot || !midi_processor_)
+        return {};
+    return midi_processor_->getInputName(slot->device.load(std::memory_order_relaxed));
+}
+
+void LR_IPC_IN::ResetFeedback_() noexcept
+{
+    for (auto& channel : feedback_)
+        for (auto& slot : channel) {
+            slot.sent.store(kUnknownValue, std::memory_order_relaxed);
+            slot.held.store(kUnknownValue, std::memory_order_relaxed);
+        }
+}
+
+void LR_IPC_IN::SetKeyMacros(const juce::String& macros)
+{
+    key_macros_.clear();
+    for (const auto& entry : juce::StringArray::fromTokens(macros, ";", "")) {
+        const auto id = entry.upToFirstOccurrenceOf("=", false, false).trim().getIntValue();
+        if (!entry.contains("=") || id <= 0)
+            continue;
+        auto macro = RSJ::ParseKeyMacro(
+            entry.fromFirstOccurrenceOf("=", false, false).toStdString());
+        if (macro.empty()) {
+            DBG("LR_IPC_IN: unable to parse key macro " + entry);
+            AsyncLog::Write(RSJ::LogCategory::keys, RSJ::LogLevel::warning,
+                "unable to parse key macro %s", entry.toRawUTF8());
+            continue;
+        }
+        if (key_macros_.size() <= static_cast<size_t>(id))
+            key_macros_.resize(static_cast<size_t>(id) + 1);
+        key_macros_[static_cast<size_t>(id)] = std::move(macro);
+    }
+}
+
+void LR_IPC_IN::SetFeedbackDeadband(int deadband)
+{
+    feedback_deadband_ = std::max(0, deadband);
+}
+
+void LR_IPC_IN::SetEchoWindow(int window)
+{
+    echo_window_ = std::max(0, window);
+}
+
+void LR_IPC_IN::Init(std::shared_ptr<MIDISender>& midi_sender,
+    MIDIProcessor* const midi_processor, std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out) noexcept
 {
     midi_sender_ = midi_sender;
-    //start the timer
-    juce::Timer::startTimer(kTimerInterval);
+    midi_processor_ = midi_processor;
+    ResetFeedback_();
+    if (midi_processor) {
+        midi_processor->addCallback<LR_IPC_IN, &LR_IPC_IN::MIDIcmdCallback>(this);
+        midi_processor->addResolvedCallback<LR_IPC_IN, &LR_IPC_IN::ResolvedCallback>(this);
+        midi_processor->addTouchCallback<LR_IPC_IN, &LR_IPC_IN::TouchCallback>(this);
+    }
+    if (profile_manager_)
+        profile_manager_->addLayerCallback<LR_IPC_IN, &LR_IPC_IN::LayerCallback>(this);
+    if (midi_sender_)
+        midi_sender_->addDeviceCallback<LR_IPC_IN, &LR_IPC_IN::OutputCallback>(this);
+    lr_ipc_out_ = std::move(lr_ipc_out);
+    // the plugin opens both sockets together, so when one connects or drops, retry the
+    // other right away
+    if (const auto ptr = lr_ipc_out_.lock())
+        ptr->addCallback<LR_IPC_IN, &LR_IPC_IN::LRIpcOutCallback>(this);
+    retry_interval_ = kMinRetry;
+    timerCallback(); //try right away, then back off
+}
+
+void LR_IPC_IN::LRIpcOutCallback(bool connected)
+{
+    // a hung plugin keeps its socket open, so reconnect rather than wait on it
+    if (!connected && socket_.isConnected())
+        if (const auto ptr = lr_ipc_out_.lock())
+            if (ptr->Unresponsive())
+                socket_.close();
+    std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
+    retry_interval_ = kMinRetry;
+    if (!timer_off_ && !Connected_())
+        juce::Timer::startTimer(kMinRetry);
+}
+
+size_t LR_IPC_IN::MemoryUse_()
+{
+    // feedback slots are part of the object; the reader's line buffer is on its stack
+    auto bytes = sizeof(LR_IPC_IN) + mirror_.MemoryUse() + RSJ::HeapBytes(key_macros_);
+    std::lock_guard<decltype(snapshot_mutex_)> lock(snapshot_mutex_);
+    for (const auto& snapshot : snapshots_)
+        bytes += RSJ::HeapBytes(snapshot);
+    return bytes;
+}
+
+void LR_IPC_IN::SetIdle(bool idle)
+{
+    std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
+    if (timer_off_)
+        return;
+    if (idle) //the next message restarts connection checks
+        juce::Timer::stopTimer();
+    else {
+        if (!Connected_())
+            retry_interval_ = kMinRetry;
+        juce::Timer::startTimer(retry_interval_);
+    }
+}
+
+bool LR_IPC_IN::Connected_() const
+{
+    return socket_.isConnected();
+}
+
+int LR_IPC_IN::Read_(char* dest, int max_bytes, int wait)
+{
+    // bytes read, 0 when none arrived in time, -1 on failure
+    const auto wait_status = socket_.waitUntilReady(true, wait);
+    if (wait_status != 1)
+        return wait_status;
+    if (const auto read = socket_.read(dest, max_bytes, false))
+        return read;
+    if (!socket_.isConnected()) //closed for missed heartbeats, see LRIpcOutCallback
+        return -1;
+    // waitUntilReady returns 1 but read will is 0: it's an indication of a broken socket.
+    juce::JUCEApplication::getInstance()->systemRequestedQuit();
+    return 0;
+}
+
+void LR_IPC_IN::FlushSnapshot_() const
+{
+    snapshot_open_ = false;
+    if (midi_sender_)
+        midi_sender_->EndBatch();
+}
+
+void LR_IPC_IN::SetRemoteHost(const juce::String& host)
+{
+    remote_host_ = host;
+    keys_enabled_ = host.isEmpty(); //they would go to whatever window is in front here
+}
+
+void LR_IPC_IN::SetLineTap(std::function<void(const char*, const char*)> tap)
+{
+    line_tap_ = std::move(tap);
+}
+
+void LR_IPC_IN::SetOsc(std::shared_ptr<OscController> osc)
+{
+    osc_ = std::move(osc);
+}
+
+void LR_IPC_IN::SetThreadPriority(const RSJ::ThreadPriority& priority) noexcept
+{
+    thread_priority_ = priority;
 }
 
 void LR_IPC_IN::PleaseStopThread()
@@ -76,142 +484,409 @@ void LR_IPC_IN::PleaseStopThread()
 
 void LR_IPC_IN::run()
 {
+    RSJ::RaiseCurrentThread(thread_priority_);
+    const ThreadAccount account{"LR_IPC_IN reader"};
+    // each read takes as much as has arrived and complete lines are split off in place,
+    // so a full refresh from Lightroom costs a few reads rather than one per byte
+    std::array<char, kBufferSize> buffer;
+    size_t size_read = 0; //bytes in buffer, all belonging to an unfinished line
+    auto overlong = false; //skipping a line longer than the buffer
     while (!juce::Thread::threadShouldExit()) {
-        //if not connected, executes a wait 333 then goes back to while
-        //if connected, tries to read a line, checks thread status and connection
-        //status before each read attempt
         //doesn't terminate thread if disconnected, as currently don't have graceful
         //way to restart thread
-        if (!socket_.isConnected()) {
-            juce::Thread::wait(kNotConnectedWait);
-        } //end if (is not connected)
-        else {
-            char line[kBufferSize + 1] = {0};//plus one for \0 at end
-            auto size_read = 0;
-            // parse input until we have a line, then process that line, quit if
-            // connection lost
-            while (std::string(line).back() != '\n' && socket_.isConnected()) {
-                if (juce::Thread::threadShouldExit())
-                    goto threadExit;//break out of nested whiles
-                const auto wait_status = socket_.waitUntilReady(true, kReadyWait);
-                switch (wait_status) {
-                case -1:
-                    goto dumpLine; //read line failed, break out of switch and while
-                case 0:
-                    juce::Thread::wait(kEmptyWait);
-                    break; //try again to read until char shows up
-                case 1:
-                    if (size_read == kBufferSize)
-                        throw std::out_of_range("Buffer overflow in LR_IPC_IN");
-                    if (const auto read = socket_.read(line + size_read, 1, false))
-                        size_read += read;
-                    else
-                        // waitUntilReady returns 1 but read will is 0: it's an indication of a broken socket.
-                        juce::JUCEApplication::getInstance()->systemRequestedQuit();
-                    break;
-                default:
-                    Expects(!"Unexpected value for wait_status");
-                }
-            } // end while !\n and is connected
-
-            // if lose connection, line may not be terminated
-            {
-                std::string param{line};
-                if (param.back() == '\n')
-                    processLine(param);
-            } //scope param
-        dumpLine: /* empty statement */;
-        } //end else (is connected)
+        if (!Connected_()) {
+            size_read = 0; //if lose connection, line may not be terminated
+            FlushSnapshot_(); //EndSnapshot won't arrive
+            generation_ = 0; //a reloaded plugin counts photos from the start
+            photo_generation_ = 0;
+            juce::Thread::wait(-1); //notified on connection and on exit
+            continue;
+        }
+        if (size_read == buffer.size()) { //no valid line is this long, drop it
+            size_read = 0;
+            overlong = true;
+        }
+        // wake often enough to release held feedback soon after its control stops
+        const auto read = Read_(buffer.data() + size_read,
+            gsl::narrow_cast<int>(buffer.size() - size_read),
+            held_ ? std::min(echo_window_, kReadyWait) : kReadyWait);
+        FlushHeld_();
+        if (read < 0) {
+            size_read = 0; //read line failed, dump it
+            FlushSnapshot_();
+            continue;
+        }
+        if (read == 0) { //nothing within kReadyWait; the read blocks again after checking for exit
+            PowerMonitor::CountWakeUp();
+            FlushSnapshot_(); //a snapshot cut short still reaches the controller
+            continue;
+        }
+        const auto* const end = buffer.data() + size_read + read;
+        const auto* line_start = buffer.data();
+        if (overlong) {
+            const auto* const newline = std::find(line_start, end, '\n');
+            overlong = newline == end;
+            line_start = overlong ? end : newline + 1;
+        }
+        line_start = ProcessLines(line_start, end);
+        size_read = static_cast<size_t>(end - line_start);
+        std::copy(line_start, end, buffer.data()); //keep the unfinished line
     } //while not threadshouldexit
-threadExit: /* empty statement */;
+    FlushSnapshot_();
     std::lock_guard< decltype(timer_mutex_) > lock(timer_mutex_);
     timer_off_ = true;
     juce::Timer::stopTimer();
     //thread_started_ = false; //don't change flag while depending upon it
 }
 
+void LR_IPC_IN::InitForHarness(std::shared_ptr<MIDISender> midi_sender) noexcept
+{
+    midi_sender_ = std::move(midi_sender);
+    keys_enabled_ = false;
+    ResetFeedback_();
+}
+
+const char* LR_IPC_IN::ProcessLines(const char* begin, const char* end) const
+{
+    // the feedback for a whole chunk reaches each device's queue in one go, or
+    // for a whole snapshot if one is open
+    if (midi_sender_)
+        midi_sender_->BeginBatch();
+    ScanGenerations_(begin, end);
+    for (auto* newline = std::find(begin, end, '\n'); newline != end;
+        newline = std::find(begin, end, '\n')) {
+        processLine(begin, newline + 1);
+        begin = newline + 1;
+    }
+    if (midi_sender_ && !snapshot_open_)
+        midi_sender_->EndBatch();
+    return begin;
+}
+
+void LR_IPC_IN::ScanGenerations_(const char* begin, const char* end) const noexcept
+{
+    // arrowing through photos faster than the reader keeps up puts several photos'
+    // snapshots in one chunk; only the last photo's values should reach the controller
+    constexpr char kHeader[] = "Snapshot ";
+    constexpr auto kHeaderLength = sizeof kHeader - 1;
+    for (auto* found = std::search(begin, end, kHeader, kHeader + kHeaderLength); found != end;
+        found = std::search(found + kHeaderLength, end, kHeader, kHeader + kHeaderLength)) {
+        if (found != begin && found[-1] != '\n')
+            continue;
+        juce::uint32 generation{0};
+        auto* digit = found + kHeaderLength;
+        for (; digit != end && *digit >= '0' && *digit <= '9'; ++digit)
+            generation = generation * 10 + static_cast<juce::uint32>(*digit - '0');
+        if (digit != end && (*digit == '\n' || *digit == '\r') && (generation_ == 0 ||
+            static_cast<juce::int32>(generation - generation_) > 0))
+            generation_ = generation;
+    }
+}
+
 void LR_IPC_IN::timerCallback()
 {
-    std::lock_guard< decltype(timer_mutex_) > lock(timer_mutex_);
-    if (!timer_off_ && !socket_.isConnected() && !juce::Thread::threadShouldExit()) {
-        if (socket_.connect(kHost, kLrInPort, kConnectTryTime))
-            if (!thread_started_) {
-                juce::Thread::startThread(); //avoid starting thread during shutdown
-                thread_started_ = true;
+    PowerMonitor::CountWakeUp();
+    auto connected = false;
+    {
+        std::lock_guard< decltype(timer_mutex_) > lock(timer_mutex_);
+        if (timer_off_ || juce::Thread::threadShouldExit())
+            return;
+        if (!Connected_()) {
+            connected = remote_host_.isNotEmpty() ?
+                socket_.connect(remote_host_, RSJ::kRelayInPort, kConnectTryTime) :
+                socket_.connect(kHost, kLrInPort, kConnectTryTime);
+            if (connected) {
+                ResetFeedback_(); //controllers may have changed while disconnected
+                mirror_.Clear(); //Lightroom resends everything once connected
+                // Lightroom may have restarted; scan for it on the keystroke thread
+                key_pool_.addJob([] {RSJ::RefreshLightroomProcess(); });
+                retry_interval_ = kTimerInterval;
+                if (!thread_started_) {
+                    juce::Thread::startThread(); //avoid starting thread during shutdown
+                    thread_started_ = true;
+                }
+                else
+                    juce::Thread::notify(); //reader is waiting for a connection
             }
+            else // Lightroom may be slow to start the plugin, so back off from a few ms
+                retry_interval_ = std::min(retry_interval_ * 2, kTimerInterval);
+        }
+        juce::Timer::startTimer(retry_interval_);
     }
+    if (connected)
+        if (const auto ptr = lr_ipc_out_.lock())
+            ptr->ConnectSoon();
 }
 
-void LR_IPC_IN::processLine(const std::string& line) const
+void LR_IPC_IN::processLine(const char* begin, const char* end) const
 {
-    const static std::unordered_map<std::string, int> cmds = {
-        {"SwitchProfile"s, 1},
-        {"SendKey"s, 2},
-        {"TerminateApplication"s, 3},
-    };
+    // parsed in place, so the parameter bursts Lightroom sends on each photo change
+    // don't allocate. [begin, end) ends with the line's newline, which stops strtod
+    const TraceScope trace{"feedback receive"};
+    const auto* const line_begin = begin; //with its newline, for line_tap_
+    const auto* const line_end = end;
+    const static std::array<std::pair<const char*, int>, 11> cmds{{
+        {"SwitchProfile", 1},
+        {"SendKey", 2},
+        {"TerminateApplication", 3},
+        {"CompactProtocol", 4},
+        {"Snapshot", 5},
+        {"EndSnapshot", 6},
+        {"SendMacro", 7},
+        {"RelayPong", 8},
+        {"ModuleState", 9},
+        {"Heartbeat", 10},
+        {"LuaTiming", 11},
+    }};
+    const auto is_space = [](char c) {return RSJ::space.find(c) != std::string::npos; };
     // process input into [parameter] [Value]
-    const auto trimmed_line = RSJ::trim(line);
-    const auto command = trimmed_line.substr(0, trimmed_line.find(' '));
-    const auto value_string = trimmed_line.substr(trimmed_line.find(' ') + 1);
+    while (begin != end && is_space(*begin))
+        ++begin;
+    while (end != begin && is_space(*(end - 1)))
+        --end;
+    const auto* const separator = std::find(begin, end, ' ');
+    const auto command_length = static_cast<size_t>(separator - begin);
+    const auto* const value = separator == end ? begin : separator + 1;
+    auto command_type = 0;
+    for (const auto& cmd : cmds)
+        if (std::strlen(cmd.first) == command_length &&
+            std::memcmp(cmd.first, begin, command_length) == 0)
+            command_type = cmd.second;
+    // values and what frames them cross a relay; SwitchProfile, SendKey,
+    // TerminateApplication and SendMacro act on this machine only
+    constexpr auto kRelayed = 1u << 0 | 1u << 4 | 1u << 5 | 1u << 6 | 1u << 9 | 1u << 10 |
+        1u << 11;
+    if (line_tap_ && (kRelayed & (1u << command_type)))
+        line_tap_(line_begin, line_end);
 
-    switch (cmds.count(command) ? cmds.at(command) : 0) {
+    switch (command_type) {
     case 1: //SwitchProfile
         if (profile_manager_)
-            profile_manager_->switchToProfile(value_string);
+            profile_manager_->switchToProfile(std::string(value, end));
         break;
     case 2: //SendKey
     {
+        if (!keys_enabled_)
+            break;
         // ReSharper disable once CppUseAuto
         std::bitset<3> modifiers{static_cast<decltype(modifiers)>
-            (std::stoi(value_string))};
-        RSJ::SendKeyDownUp(RSJ::ltrim(RSJ::ltrim(value_string, RSJ::digit)),
-            modifiers[0], modifiers[1], modifiers[2]);//ltrim twice on purpose: first digits, then spaces
+            (std::strtol(value, nullptr, 10))};
+        auto key = value; //skip first digits, then spaces
+        while (key != end && RSJ::digit.find(*key) != std::string::npos)
+            ++key;
+        while (key != end && is_space(*key))
+            ++key;
+        // keystroke synthesis can take a while, so it runs in order on its own thread
+        // rather than holding up the feedback behind it
+        key_pool_.addJob([key_string = std::string(key, end), modifiers] {
+            RSJ::SendKeyDownUp(key_string, modifiers[0], modifiers[1], modifiers[2]);
+        });
         break;
     }
-    case 3: //TerminateApplication
-        juce::JUCEApplication::getInstance()->systemRequestedQuit();
+    case 7: //SendMacro
+    {
+        if (!keys_enabled_)
+            break;
+        const auto id = std::strtol(value, nullptr, 10);
+        if (id > 0 && static_cast<size_t>(id) < key_macros_.size() &&
+            !key_macros_[static_cast<size_t>(id)].empty()) {
+            const auto* const macro = &key_macros_[static_cast<size_t>(id)];
+            key_pool_.addJob([macro] {RSJ::SendKeyMacro(*macro); });
+        }
+        break;
+    }
+    case 8: //RelayPong, the RelayServer echoing a RelayPing
+        if (const auto ptr = lr_ipc_out_.lock())
+            ptr->getRelayStats().Pong(std::strtod(value, nullptr));
+        break;
+    case 9: //ModuleState, "module 0|1": Lightroom's module and whether it has a target photo
+        if (const auto ptr = lr_ipc_out_.lock()) {
+            const auto* const photo = std::find(value, end, ' ');
+            ptr->SetLightroomState(juce::String::fromUTF8(value, static_cast<int>(photo - value)),
+                photo == end || std::strtol(photo, nullptr, 10) != 0);
+        }
+        break;
+    case 10: //Heartbeat, the plugin answering LR_IPC_OUT's with the time it was sent
+        if (const auto ptr = lr_ipc_out_.lock())
+            ptr->HeartbeatEcho(std::strtod(value, nullptr));
+        break;
+    case 11: //LuaTiming, "handler calls total_ms worst_ms" since the plugin's last report
+    {
+        const auto* const handler_end = std::find(value, end, ' ');
+        if (handler_end == end)
+            break;
+        char* next = nullptr;
+        const auto calls = std::strtoull(handler_end, &next, 10);
+        const auto total_ms = std::strtod(next, &next);
+        const auto worst_ms = std::strtod(next, nullptr);
+        if (const auto ptr = lr_ipc_out_.lock())
+            ptr->getPluginStats().Record(juce::String::fromUTF8(value,
+                static_cast<int>(handler_end - value)), calls, total_ms, worst_ms);
+        break;
+    }
+    case 3: //TerminateApplication, 0 as Lightroom quits, which a resident MIDI2LR outlives
+        if (!resident_ || std::strtol(value, nullptr, 10) != 0)
+            juce::JUCEApplication::getInstance()->systemRequestedQuit();
+        break;
+    case 4: //CompactProtocol, "1 hash": compact ids only if both sides number commands alike
+        if (const auto ptr = lr_ipc_out_.lock()) {
+            char* hash = nullptr;
+            const auto enabled = std::strtol(value, &hash, 10) == 1 &&
+                std::strtoul(hash, nullptr, 10) == LRCommandList::kCommandHash;
+            ptr->setCompactProtocol(enabled); //otherwise commands are sent by name
+        }
+        break;
+    case 5: //Snapshot generation, the plugin's refresh lines follow until EndSnapshot
+    {
+        snapshot_open_ = true; //the batch stays open past the end of the chunk
+        const auto generation = static_cast<juce::uint32>(std::strtoul(value, nullptr, 10));
+        if (generation == 0 || generation_ == 0)
+            snapshot_stale_ = false;
+        else {
+            snapshot_stale_ = static_cast<juce::int32>(generation - generation_) < 0;
+            if (!snapshot_stale_ && generation != photo_generation_) {
+                mirror_.NewPhoto(); //values still held are the previous photo's
+                photo_generation_ = generation;
+            }
+        }
+        break;
+    }
+    case 6: //EndSnapshot
+        snapshot_open_ = false; //sent at the end of the chunk
+        snapshot_stale_ = false;
         break;
     case 0:
-        // send associated messages to MIDI OUT devices
-        if (command_map_ && midi_sender_) {
-            const auto original_value = std::stod(value_string);
-            for (const auto msg : command_map_->getMessagesForCommand(command)) {
-                short msgtype{0};
-                switch (msg->msg_id_type) {
-                case RSJ::MsgIdEnum::NOTE:
-                    msgtype = RSJ::kNoteOnFlag;
-                    break;
-                case RSJ::MsgIdEnum::CC:
-                    msgtype = RSJ::kCCFlag;
-                    break;
-                case RSJ::MsgIdEnum::PITCHBEND:
-                    msgtype = RSJ::kPWFlag;
-                }
-                const auto value = controls_model_->PluginToController(msgtype,
-                    static_cast<size_t>(msg->channel - 1),
-                    gsl::narrow_cast<short>(msg->controller), original_value);
-
-                if (midi_sender_) {
-                    switch (msgtype) {
-                    case RSJ::kNoteOnFlag:
-                        midi_sender_->sendNoteOn(msg->channel, msg->controller, value);
-                        break;
-                    case RSJ::kCCFlag:
-                        if (controls_model_->getCCmethod(static_cast<size_t>(msg->channel - 1),
-                            gsl::narrow_cast<short>(msg->controller)) == RSJ::CCmethod::absolute)
-                            midi_sender_->sendCC(msg->channel, msg->controller, value);
-                        break;
-                    case RSJ::kPWFlag:
-                        midi_sender_->sendPitchWheel(msg->channel, value);
-                        break;
-                    default:
-                        Expects(!"Unexpected result for msgtype");
-                    }
-                }
+        if (snapshot_open_ && (snapshot_stale_ ||
+            skip_refresh_feedback_.load(std::memory_order_relaxed))) {
+            if (snapshot_stale_) {
+                static auto& stale = Instrumentation::Counter("feedback for a photo already left");
+                stale.fetch_add(1, std::memory_order_relaxed);
             }
+            break;
+        }
+        if (osc_ || (command_map_ && midi_sender_)) {
+            // values are 0-1; a malformed line gives no feedback rather than a wild one
+            auto original_value = std::strtod(value, nullptr);
+            if (std::isnan(original_value))
+                break;
+            original_value = std::min(std::max(original_value, 0.0), 1.0);
+            const auto command_id = LRCommandList::getIndexOfCommand(begin, command_length);
+            if (osc_ && command_id != LRCommandList::kNotFound)
+                osc_->Feedback(static_cast<RSJ::CommandId>(command_id), original_value);
+            // refresh lines answer a photo change, not a value sent
+            if (!snapshot_open_ && command_id != LRCommandList::kNotFound)
+                if (const auto ptr = lr_ipc_out_.lock())
+                    ptr->EchoReceived(static_cast<RSJ::CommandId>(command_id));
+            if (!command_map_ || !midi_sender_)
+                break;
+            mirror_.Set(command_id, original_value);
+            // send associated messages to MIDI OUT devices
+            for (const auto& msg : command_map_->getMessagesForCommandId(command_id))
+                Feedback_(msg, original_value);
         }
         break;
     default:
         Expects(!"Unexpected result for cmds");
     }
+}
+
+void LR_IPC_IN::Feedback_(const RSJ::MidiMessageId& msg, double original_value) const
+{
+    // a control's messages on other layers are for when those are active
+    if (!command_map_->isVisible(msg))
+        return;
+    short msgtype{0};
+    switch (msg.msg_id_type) {
+    case RSJ::MsgIdEnum::NOTE:
+        msgtype = RSJ::kNoteOnFlag;
+        break;
+    case RSJ::MsgIdEnum::CC:
+        msgtype = RSJ::kCCFlag;
+        break;
+    case RSJ::MsgIdEnum::PITCHBEND:
+        msgtype = RSJ::kPWFlag;
+    }
+    const auto controller = gsl::narrow_cast<short>(msg.controller);
+    const auto value = controls_model_->PluginToController(msgtype,
+        static_cast<size_t>(msg.channel - 1), controller, original_value,
+        static_cast<short>(msg.source));
+    // a told-apart device's mapping goes to that device. Its controls share
+    // the channel's slots with its twins, so they skip the deadband and hold
+    if (msg.source) {
+        SendFeedback_(msgtype, msg.channel, controller, value,
+            RSJ::DeviceIdentifier(static_cast<short>(msg.source)));
+        return;
+    }
+    auto* const slot = FeedbackSlot_(msgtype, msg.channel - 1, controller);
+    if (slot && Touched_(*slot, juce::Time::getMillisecondCounter())) {
+        // most likely the echo of the move itself; keep only the latest
+        slot->held.store(value, std::memory_order_relaxed);
+        held_ = true;
+    }
+    else if (FeedbackChanged_(slot, value))
+        SendFeedback_(msgtype, msg.channel, controller, value, Route_(slot));
+}
+
+void LR_IPC_IN::LayerCallback(int previous, int layer)
+{
+    if (!command_map_ || !midi_sender_)
+        return;
+    // a message shown on both layers keeps its control's target, so it isn't resent
+    midi_sender_->BeginBatch();
+    for (const auto command_id : command_map_->getMappedCommands()) {
+        const auto value = mirror_.Get(command_id);
+        if (value < 0.0)
+            continue;
+        for (const auto& msg : command_map_->getMessagesForCommandId(command_id))
+            if (command_map_->isVisible(msg, layer) && !command_map_->isVisible(msg, previous))
+                Feedback_(msg, value);
+    }
+    midi_sender_->EndBatch();
+}
+
+void LR_IPC_IN::OutputCallback(const juce::String&)
+{
+    if (!command_map_ || !midi_sender_)
+        return;
+    // whatever the controller showed before it went away is gone
+    ResetFeedback_();
+    midi_sender_->BeginBatch();
+    for (const auto command_id : command_map_->getMappedCommands()) {
+        const auto value = mirror_.Get(command_id);
+        if (value < 0.0)
+            continue;
+        for (const auto& msg : command_map_->getMessagesForCommandId(command_id))
+            Feedback_(msg, value);
+    }
+    midi_sender_->EndBatch();
+}
+
+void LR_IPC_IN::SendFeedback_(short msgtype, int channel, short controller, short value,
+    const juce::String& device) const
+{
+    switch (msgtype) {
+    case RSJ::kNoteOnFlag:
+        midi_sender_->sendNoteOn(channel, controller, value, device);
+        break;
+    case RSJ::kCCFlag:
+        if (controls_model_->getCCmethod(static_cast<size_t>(channel - 1), controller) ==
+            RSJ::CCmethod::absolute) {
+            if (controls_model_->getCC14bit(static_cast<size_t>(channel - 1), controller))
+                midi_sender_->sendCC14bit(channel, controller, value, device);
+            else
+                midi_sender_->sendCC(channel, controller, value, device);
+        }
+        else if (local_echo_) { //the position on an encoder's ring, 0-127 over its range
+            const auto high = controls_model_->getCCmax(static_cast<size_t>(channel - 1), controller);
+            if (high > 0 && controller <= kMaxRing)
+                midi_sender_->sendCC(channel, controller,
+                    gsl::narrow_cast<short>(value * kMaxRing / high), device);
+        }
+        break;
+    case RSJ::kPWFlag:
+        midi_sender_->sendPitchWheel(channel, value, device);
+        break;
+    default:
+        Expects(!"Unexpected result for msgtype");
+    }
 }
\ No newline at end of file
@@ -22,15 +22,30 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_LR_IPC_IN_H_INCLUDED
 #define MIDI2LR_LR_IPC_IN_H_INCLUDED
 
+#include <array>
+#include <functional>
+#include <atomic>
 #include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "Instrumentation.h"
+#include "MidiUtilities.h"
+#include "ParameterMirror.h"
+#include "SendKeys.h"
+#include "ThreadPriority.h"
 class CommandMap;
 class ControlsModel;
+class LR_IPC_OUT;
+class MIDIProcessor;
 class MIDISender;
+class OscController;
 class ProfileManager;
 
+// the plugin's LrSocket connections are one-way ('send' or 'receive' mode), so
+// feedback arrives on its own socket rather than sharing LR_IPC_OUT's. The two
+// reconnect together (see LRIpcOutCallback)
 class LR_IPC_IN final:
     private juce::Timer,
     private juce::Thread {
@@ -38,25 +53,160 @@ class LR_IPC_IN final:
     LR_IPC_IN(ControlsModel* const c_model, ProfileManager* const profileManager,
         CommandMap* const commandMap);
     virtual ~LR_IPC_IN();
-    void Init(std::shared_ptr<MIDISender>& midiSender) noexcept;
+    void Init(std::shared_ptr<MIDISender>& midiSender, MIDIProcessor* const midi_processor,
+        std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out) noexcept;
+    // feedback within deadband of the value last sent to a control is skipped. Identical
+    // values are always skipped until the control sends MIDI. Call before Init
+    void SetFeedbackDeadband(int deadband);
+    // feedback for a control that sent MIDI within the last window ms is held and sent
+    // once the control has been still for window ms, so motor faders and LED rings
+    // don't fight the hand moving them. 0 sends feedback right away. Call before Init
+    void SetEchoWindow(int window);
+    // a relative encoder's move is fed back from the converted value right away, to its
+    // ring and the command's other controls, instead of after the Lightroom round trip.
+    // Lightroom's reply is then only sent where it differs. Call before Init
+    void SetLocalEcho(bool enabled) noexcept
+    {
+        local_echo_ = enabled;
+    }
+    // a resident MIDI2LR keeps running when Lightroom quits, with devices open and
+    // profiles loaded, and waits for the plugin to reconnect. Only the plugin's Stop
+    // command or --LRSHUTDOWN end it then. Call before Init
+    void SetResident(bool resident) noexcept
+    {
+        resident_ = resident;
+    }
+    // keyboard macros the plugin triggers by number, as "id=macro;..." with each macro
+    // in RSJ::ParseKeyMacro's form. Call before Init
+    void SetKeyMacros(const juce::String& macros);
+    // read from a RelayServer on host instead of the local plugin. Keystrokes are then
+    // left to the instance beside Lightroom. Call before Init
+    void SetRemoteHost(const juce::String& host);
+    // sees each feedback line from the plugin before it is processed, for a
+    // RelayServer. Keystrokes, profile switches and quitting aren't passed on, as they
+    // belong to this machine. Reader thread. Call before Init
+    void SetLineTap(std::function<void(const char*, const char*)> tap);
+    // Lightroom's values also go to the OSC controller. Call before Init
+    void SetOsc(std::shared_ptr<OscController> osc);
+    // how the reader thread runs. Call before Init
+    void SetThreadPriority(const RSJ::ThreadPriority& priority) noexcept;
+    // while set, values in the plugin's photo-change refreshes aren't fed back, only
+    // the parameters Lightroom reports changing on their own. Any thread
+    void SetSkipRefreshFeedback(bool skip) noexcept
+    {
+        skip_refresh_feedback_.store(skip, std::memory_order_relaxed);
+    }
+    // connection checks stop while idle, see PowerMonitor. Any thread
+    void SetIdle(bool idle);
     //signal exit to thread
     void PleaseStopThread();
+    // the parser on its own for the parser harness: feedback goes to midi_sender and
+    // keystrokes aren't sent. Instead of Init
+    void InitForHarness(std::shared_ptr<MIDISender> midi_sender) noexcept;
+    // processes the complete lines in [begin, end) as if read from the plugin, and
+    // returns the start of the unfinished line after them. Reader thread, or harness
+    const char* ProcessLines(const char* begin, const char* end) const;
+    // Lightroom's values as last reported. Any thread
+    const ParameterMirror& getMirror() const noexcept
+    {
+        return mirror_;
+    }
 private:
     juce::StreamingSocket socket_{};
+    juce::String remote_host_{};
+    std::function<void(const char*, const char*)> line_tap_;
+    std::shared_ptr<OscController> osc_{nullptr};
+    RSJ::ThreadPriority thread_priority_{};
+    bool Connected_() const;
+    int Read_(char* dest, int max_bytes, int wait);
+    void FlushSnapshot_() const; //sends feedback held for an unfinished snapshot
+    size_t MemoryUse_();
     // Thread interface
     void run() override;
     // Timer callback
     void timerCallback() override;
+    void LRIpcOutCallback(bool);
+    void MIDIcmdCallback(RSJ::MidiMessage);
+    // a motor fader's touch note: feedback to it is held while touched, and Lightroom's
+    // latest value sent on release
+    void TouchCallback(RSJ::MidiMessage);
+    // snapshot, reset group and batch commands, and local echo if enabled
+    void ResolvedCallback(const RSJ::ResolvedMessage& rm);
+    void LocalEcho_(const RSJ::ResolvedMessage& rm);
+    // stores the mirror's values of the mapped parameters in a snapshot
+    void CaptureSnapshot_(int snapshot);
+    // sends a snapshot's values to Lightroom in one write, so the plugin applies them
+    // in one pass, and to the controls in one feedback batch
+    void RecallSnapshot_(int snapshot);
+    // sends a panel's resets as one line, which the plugin applies in one step and
+    // answers with one feedback snapshot
+    void ResetGroup_(int group) const;
+    // batch commands: the plugin records develop moves as deltas from "Start Batch"
+    // and applies them to the other selected photos on commit
+    void Batch_(int command) const;
+    // sends Lightroom's last values in one batch to the controls whose command changed
+    // with the layer
+    void LayerCallback(int previous, int layer);
+    // a MIDI output appeared, most likely a controller plugged back in: send it every
+    // known value in one batch
+    void OutputCallback(const juce::String& device);
+    // last value sent to each note, CC 0-127 and pitch bend of each channel, with the
+    // feedback held back while the control is being moved
+    constexpr static int kChannels = 16;
+    constexpr static int kControllers = 128;
+    constexpr static short kUnknownValue = -1;
+    struct FeedbackSlot {
+        std::atomic<short> sent{kUnknownValue};
+        std::atomic<short> held{kUnknownValue}; //reader thread, taken on a touch release
+        std::atomic<juce::uint32> touched{0}; //ms counter of the control's last MIDI
+        std::atomic<short> device{-1}; //MIDIProcessor input the control was last heard on
+        std::atomic<bool> grabbed{false}; //its touch note is held, so feedback waits
+    };
+    FeedbackSlot* FeedbackSlot_(short msgtype, int channel, short controller) const noexcept;
+    bool FeedbackChanged_(FeedbackSlot* slot, short value) const noexcept;
+    // notes the newest photo generation among the chunk's snapshot headers
+    void ScanGenerations_(const char* begin, const char* end) const noexcept;
+    bool Touched_(const FeedbackSlot& slot, juce::uint32 now) const noexcept;
+    void FlushHeld_() const;
+    void ResetFeedback_() noexcept;
+    juce::String Route_(const FeedbackSlot* slot) const;
+    void SendFeedback_(short msgtype, int channel, short controller, short value,
+        const juce::String& device) const;
+    // feedback of a 0-1 value to one mapped message's control, if it is on the active layer
+    void Feedback_(const RSJ::MidiMessageId& msg, double value) const;
     // process a line received from the socket
-    void processLine(const std::string& line) const;
+    void processLine(const char* begin, const char* end) const;
 
     bool thread_started_{false};
+    bool keys_enabled_{true};
     bool timer_off_{false};
+    bool local_echo_{false};
+    bool resident_{false};
+    int retry_interval_{0}; //ms, guarded by timer_mutex_
+    int feedback_deadband_{0};
+    int echo_window_{0};
+    mutable std::atomic<bool> held_{false}; //some slot may hold feedback, cleared by the reader
+    mutable bool snapshot_open_{false}; //reader thread only
+    // the plugin numbers snapshots by target photo. A snapshot older than the newest
+    // seen is for a photo already left, so its lines are skipped. Reader thread only
+    mutable juce::uint32 generation_{0}; //0 until a snapshot arrives
+    mutable juce::uint32 photo_generation_{0}; //of the values in mirror_
+    mutable bool snapshot_stale_{false};
+    std::atomic<bool> skip_refresh_feedback_{false};
+    mutable std::array<std::array<FeedbackSlot, 2 * kControllers + 1>, kChannels> feedback_;
+    mutable ParameterMirror mirror_; //written by the reader thread and local echo
+    std::array<std::vector<std::pair<RSJ::CommandId, double>>, RSJ::kSnapshots> snapshots_;
+    std::mutex snapshot_mutex_; //snapshot commands may come from several input threads
+    std::vector<RSJ::KeyMacro> key_macros_; //by id, read by key_pool_ jobs
+    mutable juce::ThreadPool key_pool_{1}; //SendKey, one thread keeps keys in order
     CommandMap* const command_map_;
     ControlsModel* const controls_model_; //
     mutable std::mutex timer_mutex_;
     ProfileManager* const profile_manager_;
+    MIDIProcessor* midi_processor_{nullptr};
     std::shared_ptr<MIDISender> midi_sender_{nullptr};
+    std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
+    MemoryAccount memory_{"IPC buffers", [this] {return MemoryUse_(); }}; //last, goes first
 };
 
 #endif  // LR_IPC_IN_H_INCLUDED
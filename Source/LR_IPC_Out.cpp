@@ -20,104 +20,1013 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
+#include <algorithm>
+#include <cmath>
+#include <limits>
 #include <gsl/gsl>
 #include "LR_IPC_Out.h"
+#include "AsyncLog.h"
 #include "CommandMap.h"
 #include "ControlsModel.h"
+#include "Instrumentation.h"
+#include "LatencyStats.h"
 #include "LRCommands.h"
 #include "MIDIProcessor.h"
 #include "MidiUtilities.h"
+#include "PipelineTrace.h"
+#include "PowerMonitor.h"
+#include "ThreadStats.h"
 
 namespace {
     constexpr auto kHost = "127.0.0.1";
     constexpr int kConnectTryTime = 100;
     constexpr int kLrOutPort = 58763;
+    constexpr double kRelayPingInterval = 1000.0; //ms
+    constexpr double kHeartbeatInterval = 1000.0; //ms
     constexpr int kTimerInterval = 1000;
+    constexpr int kMinRetry = 5; //first connect retry, doubling up to kTimerInterval
+    constexpr int kConnectTimer = 0;
+    constexpr int kStopWait = 1000;
+    constexpr int kRetryWait = 10; //ms between writes while Lightroom isn't reading
+    constexpr size_t kMaxPending = 512; //values held while backlogged before dropping
+    constexpr size_t kMaxHeldActions = 64; //button presses held while disconnected
+    // this many handovers between controls within kLoopWindow is a feedback loop, and
+    // leaves the command with its current control for kLoopDamping
+    constexpr int kLoopHandovers = 4;
+    constexpr double kLoopWindow = 2000.0; //ms
+    constexpr double kLoopDamping = 3000.0; //ms
+    // a value in the step last sent is still sent after this, in case Lightroom moved
+    constexpr double kQuantumHold = 1000.0; //ms
+    // Client.lua's BUTTON_ON: one-shot commands act only above it
+    constexpr double kButtonOn = 0.40;
+    // compact record: kCompactMark, command id in two 6-bit digits, value in three, newline.
+    // digits are offset by '0' so a record never contains a line break
+    constexpr char kCompactMark = '#';
+    constexpr char kDigitBase = '0';
+    constexpr double kCompactScale = 262143.0; //2^18 - 1
+
+    void AppendCompact(std::string& out, RSJ::CommandId command_id, double value)
+    {
+        Expects(command_id < 4096);
+        const auto clamped = value < 0.0 ? 0.0 : value > 1.0 ? 1.0 : value;
+        const auto scaled = static_cast<unsigned>(clamped * kCompactScale + 0.5);
+        const char record[] = {kCompactMark,
+            static_cast<char>(kDigitBase + ((command_id >> 6) & 63)),
+            static_cast<char>(kDigitBase + (command_id & 63)),
+            static_cast<char>(kDigitBase + ((scaled >> 12) & 63)),
+            static_cast<char>(kDigitBase + ((scaled >> 6) & 63)),
+            static_cast<char>(kDigitBase + (scaled & 63)), '\n'};
+        out.append(record, sizeof record);
+    }
+
+    // six decimals like std::to_string, without a temporary string or the locale-aware
+    // printf behind it. Exact ties may round the last digit differently
+    void AppendFixed(std::string& out, double value)
+    {
+        const auto magnitude = std::fabs(value);
+        if (!(magnitude < 1e12)) { //too large to scale, or NaN
+            out += std::to_string(value);
+            return;
+        }
+        char buffer[24];
+        auto* const end = buffer + sizeof buffer;
+        auto* pos = end;
+        auto scaled = static_cast<unsigned long long>(std::llround(magnitude * 1e6));
+        for (auto i = 0; i < 6; ++i) {
+            *--pos = static_cast<char>('0' + scaled % 10);
+            scaled /= 10;
+        }
+        *--pos = '.';
+        do {
+            *--pos = static_cast<char>('0' + scaled % 10);
+            scaled /= 10;
+        } while (scaled);
+        if (std::signbit(value))
+            *--pos = '-';
+        out.append(pos, end);
+    }
 }
 
-LR_IPC_OUT::LR_IPC_OUT(ControlsModel* const c_model, const CommandMap * const mapCommand):
-    juce::InterprocessConnection(), command_map_{mapCommand}, controls_model_{c_model} {}
+LR_IPC_OUT::LR_IPC_OUT(ControlsModel* const c_model, const CommandMap * const mapCommand,
+    Scheduler* const scheduler):
+    juce::InterprocessConnection(), juce::Thread{"LR_IPC_OUT"}, command_map_{mapCommand},
+    controls_model_{c_model}, scheduler_{scheduler},
+    queued_(LRCommandList::LRStringList.size() + LRCommandList::NextPrevProfile.size(), false),
+    outbound_stats_{LRCommandList::LRStringList.size() + LRCommandList::NextPrevProfile.size(),
+        &command_mutex_}
+{
+    queued_ids_.reserve(queued_.size());
+    LRCommandList::getTarget(0); //builds its table here rather than on the MIDI thread
+}
 
 LR_IPC_OUT::~LR_IPC_OUT()
 {
+    {
+        std::lock_guard<decltype(flush_mutex_)> lock(flush_mutex_);
+        if (flush_task_)
+            scheduler_->Cancel(flush_task_);
+    }
+    if (ping_task_)
+        scheduler_->Cancel(ping_task_);
+    if (heartbeat_task_)
+        scheduler_->Cancel(heartbeat_task_);
     {
         std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
         timer_off_ = true;
-        juce::Timer::stopTimer();
+        juce::MultiTimer::stopTimer(kConnectTimer);
     }
+    juce::Thread::signalThreadShouldExit();
+    juce::Thread::notify();
+    juce::Thread::stopThread(kStopWait);
     juce::InterprocessConnection::disconnect();
 }
 
-void LR_IPC_OUT::Init(MIDIProcessor* const midi_processor)
+void LR_IPC_OUT::Init(MIDIProcessor* const midi_processor, int coalesce_interval)
 {
-    if (midi_processor)
-        midi_processor->addCallback(this, &LR_IPC_OUT::MIDIcmdCallback);
+    SetCoalesceInterval(coalesce_interval);
+    if (remote_host_.isNotEmpty()) //answered by the RelayServer, see LR_IPC_IN
+        ping_task_ = scheduler_->Schedule([this] {
+            if (juce::InterprocessConnection::isConnected())
+                sendCommand("RelayPing " +
+                    std::to_string(juce::Time::getMillisecondCounterHiRes()) + '\n');
+        }, kRelayPingInterval, kRelayPingInterval);
+    else if (heartbeat_timeout_ > 0) //the relay hop has its pings, the server its heartbeats
+        heartbeat_task_ = scheduler_->Schedule([this] {Heartbeat_(); }, kHeartbeatInterval,
+            kHeartbeatInterval);
 
-    //start the timer
-    juce::Timer::startTimer(kTimerInterval);
+    if (midi_processor) {
+        latency_stats_ = &midi_processor->getLatencyStats();
+        midi_processor->addResolvedCallback<LR_IPC_OUT, &LR_IPC_OUT::MIDIcmdCallback>(this);
+    }
+
+    juce::Thread::startThread();
+    state_changed_ = juce::Time::getMillisecondCounterHiRes();
+    state_changed_time_ = juce::Time::getCurrentTime();
+    retry_interval_ = kMinRetry;
+    Connect_(); //try right away, then back off
+}
+
+void LR_IPC_OUT::SetCoalesceInterval(int coalesce_interval)
+{
+    std::lock_guard<decltype(flush_mutex_)> lock(flush_mutex_);
+    coalesce_interval_ = coalesce_interval;
+    coalesce_.store(coalesce_interval > 0, std::memory_order_relaxed);
+    ScheduleFlush_();
+    if (coalesce_interval <= 0)
+        FlushPending_(); //values held under the previous interval
+}
+
+void LR_IPC_OUT::SetIdle(bool idle)
+{
+    {
+        std::lock_guard<decltype(flush_mutex_)> lock(flush_mutex_);
+        idle_ = idle;
+        ScheduleFlush_();
+    }
+    {
+        std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
+        if (!timer_off_) {
+            if (idle) //the next message restarts connection checks
+                juce::MultiTimer::stopTimer(kConnectTimer);
+            else {
+                if (!juce::InterprocessConnection::isConnected())
+                    retry_interval_ = kMinRetry;
+                juce::MultiTimer::startTimer(kConnectTimer, retry_interval_);
+            }
+        }
+    }
+    if (idle)
+        FlushPending_(); //anything held since the last flush
+    if (juce::InterprocessConnection::isConnected())
+        sendCommand(idle ? "PowerIdle 1\n" : "PowerIdle 0\n");
+}
+
+size_t LR_IPC_OUT::MemoryUse_() const
+{
+    // outgoing_ belongs to the writer thread and isn't counted
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    return sizeof(LR_IPC_OUT) + RSJ::HeapBytes(actions_) + RSJ::HeapBytes(command_) +
+        RSJ::HeapBytes(pending_index_) + RSJ::HeapBytes(pending_) +
+        RSJ::HeapBytes(rate_limits_) + RSJ::HeapBytes(rate_held_) + RSJ::HeapBytes(touches_) +
+        RSJ::HeapBytes(quanta_);
+}
+
+void LR_IPC_OUT::ScheduleFlush_()
+{
+    //call with flush_mutex_ held. On the scheduler's thread, so a busy message loop
+    //doesn't hold values back. Nothing arrives to hold while idle, so no flush then
+    if (flush_task_) {
+        scheduler_->Cancel(flush_task_);
+        flush_task_ = 0;
+    }
+    if (coalesce_interval_ > 0 && !idle_)
+        flush_task_ = scheduler_->Schedule([this] {
+            PowerMonitor::CountWakeUp();
+            FlushPending_();
+        }, coalesce_interval_, coalesce_interval_);
+}
+
+void LR_IPC_OUT::SetRemoteHost(const juce::String& host)
+{
+    remote_host_ = host;
+}
+
+void LR_IPC_OUT::SetThreadPriority(const RSJ::ThreadPriority& priority) noexcept
+{
+    thread_priority_ = priority;
+}
+
+void LR_IPC_OUT::ConnectSoon()
+{
+    std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
+    retry_interval_ = kMinRetry;
+    if (!timer_off_ && !juce::InterprocessConnection::isConnected())
+        juce::MultiTimer::startTimer(kConnectTimer, kMinRetry);
+}
+
+void LR_IPC_OUT::Connect_()
+{
+    std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
+    if (timer_off_)
+        return;
+    if (!juce::InterprocessConnection::isConnected()) {
+        const auto remote = remote_host_.isNotEmpty();
+        if (juce::InterprocessConnection::connectToSocket(remote ? remote_host_ : kHost,
+            remote ? RSJ::kRelayOutPort : kLrOutPort, kConnectTryTime))
+            retry_interval_ = kTimerInterval;
+        else // Lightroom may be slow to start the plugin, so back off from a few ms
+            retry_interval_ = std::min(retry_interval_ * 2, kTimerInterval);
+    }
+    juce::MultiTimer::startTimer(kConnectTimer, retry_interval_);
+}
+
+void LR_IPC_OUT::SetRateLimits(int max_rate, const juce::String& overrides)
+{
+    const auto command_count = LRCommandList::LRStringList.size() + LRCommandList::NextPrevProfile.size();
+    std::vector<double> rates(command_count, static_cast<double>(max_rate));
+    for (const auto& entry : juce::StringArray::fromTokens(overrides, ";", "")) {
+        const auto name = entry.upToFirstOccurrenceOf("=", false, false).trim();
+        const auto rate = entry.fromFirstOccurrenceOf("=", false, false).getDoubleValue();
+        if (!entry.contains("="))
+            continue;
+        const auto command = LRCommandList::getIndexOfCommand(name.toStdString());
+        if (command != LRCommandList::kNotFound) {
+            rates[command] = rate;
+            continue;
+        }
+        for (const auto& section : LRCommandList::MenuSections)
+            if (name == juce::String::fromUTF8(section.title))
+                //ReadableList skips Unmapped, so entry i is command i + 1
+                for (auto i = section.first; i < section.first + section.count; ++i)
+                    rates[i + 1] = rate;
+    }
+    rate_limits_.clear();
+    if (!congestion_ &&
+        std::none_of(rates.begin(), rates.end(), [](double r) noexcept {return r > 0.0; }))
+        return;
+    rate_limits_.resize(command_count);
+    for (size_t i = 0; i < command_count; ++i)
+        if (rates[i] > 0.0)
+            rate_limits_[i].interval = 1000.0 / rates[i];
+}
+
+void LR_IPC_OUT::SetAdaptiveRate(bool enabled)
+{
+    const auto command_count = LRCommandList::LRStringList.size() + LRCommandList::NextPrevProfile.size();
+    congestion_ = enabled ? std::make_unique<CongestionControl>(command_count) : nullptr;
+    if (congestion_ && rate_limits_.empty())
+        rate_limits_.resize(command_count); //no fixed limits
+}
+
+void LR_IPC_OUT::EchoReceived(RSJ::CommandId command_id)
+{
+    if (!congestion_)
+        return;
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    congestion_->Echoed(command_id, now);
+}
+
+juce::String LR_IPC_OUT::CongestionReport() const
+{
+    if (!congestion_)
+        return {};
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    return congestion_->Report();
+}
+
+void LR_IPC_OUT::SetTouchHold(int hold_ms)
+{
+    touch_hold_ = hold_ms;
+    touches_.assign(hold_ms > 0 ? LRCommandList::LRStringList.size() +
+        LRCommandList::NextPrevProfile.size() : 0, Touch{});
+}
+
+void LR_IPC_OUT::SetLightroomState(const juce::String& module, bool photo)
+{
+    if (photo_.exchange(photo, std::memory_order_relaxed) != photo)
+        AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::info,
+            "Lightroom in %s %s a photo, develop values %s", module.toRawUTF8(),
+            photo ? "with" : "without", photo ? "sent" : "dropped");
+}
+
+void LR_IPC_OUT::SetQuantize(bool enabled)
+{
+    quanta_.assign(enabled ? LRCommandList::LRStringList.size() +
+        LRCommandList::NextPrevProfile.size() : 0, Quantum{});
+}
+
+void LR_IPC_OUT::SetRelativeDeltas(bool enabled)
+{
+    deltas_ = enabled;
+    if (controls_model_)
+        controls_model_->setRelativeDeltas(enabled);
+}
+
+bool LR_IPC_OUT::Unchanged_(const RSJ::ResolvedMessage& rm)
+{
+    static auto& unchanged = Instrumentation::Counter("values within the step last sent");
+    if (rm.command_id >= quanta_.size())
+        return false;
+    const auto steps = LRCommandList::getSteps(rm.command_id);
+    if (!steps)
+        return false;
+    const auto step = std::lround(rm.value * steps);
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    auto& quantum = quanta_[rm.command_id];
+    if (quantum.step == step && now - quantum.sent < kQuantumHold) {
+        unchanged.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    quantum.step = step;
+    quantum.sent = now;
+    return false;
+}
+
+bool LR_IPC_OUT::Contended_(const RSJ::ResolvedMessage& rm)
+{
+    static auto& dropped = Instrumentation::Counter("touch arbitration drops");
+    static auto& damped = Instrumentation::Counter("touch loops damped");
+    if (rm.command_id >= touches_.size())
+        return false;
+    const RSJ::MidiMessageId message{rm.message};
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    auto& touch = touches_[rm.command_id];
+    if (touch.last == 0.0 || touch.owner == message) {
+        touch.owner = message;
+        touch.last = now;
+        return false;
+    }
+    if (now - touch.last < touch_hold_ || now < touch.damped_until) {
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    // a hand takes a while to move between controls, so quick turns are a loop
+    if (now - touch.window > kLoopWindow) {
+        touch.window = now;
+        touch.handovers = 0;
+    }
+    if (++touch.handovers >= kLoopHandovers) {
+        touch.handovers = 0;
+        touch.damped_until = now + kLoopDamping;
+        damped.fetch_add(1, std::memory_order_relaxed);
+        dropped.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+    touch.owner = message;
+    touch.last = now;
+    return false;
+}
+
+double LR_IPC_OUT::Interval_(RSJ::CommandId command) const noexcept
+{
+    const auto interval = rate_limits_[command].interval;
+    return congestion_ ? std::max(interval, congestion_->IntervalMs()) : interval;
 }
 
 void LR_IPC_OUT::sendCommand(const std::string& command)
 {
     {
         std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
-        command_ += command;
+        actions_ += command;
     }
-    juce::AsyncUpdater::triggerAsyncUpdate();
+    WakeWriter_();
+}
+
+void LR_IPC_OUT::SetHeartbeat(int timeout) noexcept
+{
+    heartbeat_timeout_ = timeout;
+}
+
+void LR_IPC_OUT::SetActionTtl(int ttl) noexcept
+{
+    action_ttl_ = ttl;
 }
 
-void LR_IPC_OUT::MIDIcmdCallback(RSJ::MidiMessage mm)
+void LR_IPC_OUT::Heartbeat_()
 {
-    const RSJ::MidiMessageId message{mm};
-    if (!command_map_->messageExistsInMap(message) ||
-        command_map_->getCommandforMessage(message) == "Unmapped" ||
-        find(LRCommandList::NextPrevProfile.begin(),
-            LRCommandList::NextPrevProfile.end(),
-            command_map_->getCommandforMessage(message)) != LRCommandList::NextPrevProfile.end()) {
+    if (!juce::InterprocessConnection::isConnected())
+        return;
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    // a plugin that hasn't answered yet this connection, or is too old to, isn't judged
+    const auto last = last_echo_.load(std::memory_order_relaxed);
+    if (last > 0.0 && now - last > heartbeat_timeout_) {
+        static auto& reconnects = Instrumentation::Counter("reconnects after missed heartbeats");
+        reconnects.fetch_add(1, std::memory_order_relaxed);
+        AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::warning,
+            "no heartbeat answered for %.0f ms, reconnecting", now - last);
+        unresponsive_.store(true, std::memory_order_relaxed);
+        juce::InterprocessConnection::disconnect(); //connectionLost reconnects
         return;
     }
-    auto command_to_send = command_map_->getCommandforMessage(message);
-    const auto computed_value = controls_model_->ControllerToPlugin(mm);
-    command_to_send += ' ' + std::to_string(computed_value) + '\n';
+    sendCommand("Heartbeat " + std::to_string(now) + '\n');
+}
+
+void LR_IPC_OUT::HeartbeatEcho(double sent) noexcept
+{
+    if (!heartbeat_task_) //a relayed plugin answering the server's heartbeats
+        return;
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    last_echo_.store(now, std::memory_order_relaxed);
+    link_stats_.Pong(sent);
+    static auto& round_trip = Instrumentation::Gauge("Lightroom link round trip us");
+    round_trip.store(std::llround((now - sent) * 1000.0), std::memory_order_relaxed);
+}
+
+void LR_IPC_OUT::setCompactProtocol(bool enabled) noexcept
+{
+    compact_.store(enabled, std::memory_order_relaxed);
+}
+
+void LR_IPC_OUT::setPickup(bool enabled) noexcept
+{
+    pickup_.store(enabled, std::memory_order_relaxed);
+}
+
+void LR_IPC_OUT::MIDIcmdCallback(const RSJ::ResolvedMessage& rm)
+{
+    static auto& allocations = Instrumentation::Counter("allocations in command send");
+    const AllocationScope scope{allocations};
+    const TraceScope trace{"command enqueue"};
+    if (!rm.command || (rm.command_flags & (RSJ::kCommandUnmapped | RSJ::kCommandProfile)))
+        return;
+    // the plugin ignores a one-shot command's release, so it isn't sent. a macro's
+    // targets take the release's value, so those still go
+    if ((rm.command_flags & RSJ::kCommandAction) && rm.value <= kButtonOn && !rm.target_count) {
+        static auto& releases = Instrumentation::Counter("button releases dropped");
+        releases.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // the plugin would discard a develop value with no photo to apply it to
+    if (!photo_.load(std::memory_order_relaxed) && LRCommandList::isDevelop(rm.command_id)) {
+        static auto& no_photo = Instrumentation::Counter("develop values without a photo");
+        no_photo.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    // a control that hasn't reached Lightroom's value yet moves nothing there
+    // OSC values have no control here, so take no pickup
+    if (pickup_.load(std::memory_order_relaxed) && controls_model_ &&
+        rm.message.channel != RSJ::kOscChannel && !controls_model_->PickedUp(rm.message, rm.value))
+        return;
+    // notes and action commands are button presses, so each one is sent, ahead of
+    // parameter values other than those for what it sets (LRCommandList::getTarget),
+    // so an older value can't undo a reset
+    const auto action = rm.message.message_type_byte == RSJ::kNoteOnFlag ||
+        (rm.command_flags & RSJ::kCommandAction);
+    const auto target = action ? LRCommandList::getTarget(rm.command_id) :
+        LRCommandList::kNotFound;
+    // a relative control on a develop parameter may instead send its move, which the
+    // plugin adds to Lightroom's value. Moves add up, so none is filtered or replaced
+    const auto delta = deltas_ && controls_model_ && LRCommandList::isDevelop(rm.command_id) &&
+        rm.message.channel != RSJ::kOscChannel && controls_model_->IsRelative(rm.message);
+    const auto step = delta ? controls_model_->LastStep(rm.message) : 0.0;
+    if (delta && step == 0.0)
+        return;
+    if (!touches_.empty() && !action && !delta && Contended_(rm))
+        return;
+    if (!quanta_.empty() && !action && !delta && Unchanged_(rm))
+        return;
+    if (!rate_limits_.empty() && !action && !delta && RateLimited_(rm))
+        return;
+    // the value of a relative control is already the accumulated position, so latest
+    // value wins for all methods. while the socket is backed up or Lightroom is
+    // disconnected, values coalesce here even without a coalesce interval, and are sent
+    // once the writer catches up or the connection is made
+    const auto offline = offline_.load(std::memory_order_relaxed);
+    if ((coalesce_ || backlogged_.load(std::memory_order_relaxed) || offline) &&
+        !action && !delta) {
+        const RSJ::MidiMessageId message{rm.message};
+        std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+        if (oldest_arrival_ == 0.0)
+            oldest_arrival_ = rm.time_stamp;
+        // a message's own command and its macro targets are queued as one block
+        const auto found = pending_index_.find(message);
+        auto same = found != pending_index_.end() &&
+            found->second + rm.target_count < pending_.size() &&
+            pending_[found->second].first == rm.command_id;
+        for (size_t i = 0; same && i < rm.target_count; ++i)
+            same = pending_[found->second + 1 + i].first == rm.targets[i].command_id;
+        if (same) {
+            outbound_stats_.Coalesced();
+            pending_[found->second].second = rm.value;
+            for (size_t i = 0; i < rm.target_count; ++i)
+                pending_[found->second + 1 + i].second = rm.targets[i].Apply(rm.value);
+        }
+        else {
+            if (pending_.size() >= kMaxPending)
+                DropOldestPending_();
+            pending_index_[message] = pending_.size();
+            pending_.emplace_back(rm.command_id, rm.value);
+            for (size_t i = 0; i < rm.target_count; ++i)
+                pending_.emplace_back(rm.targets[i].command_id, rm.targets[i].Apply(rm.value));
+        }
+        if (latency_stats_)
+            latency_stats_->Record(LatencyStats::kEnqueue, rm.time_stamp);
+        if (!coalesce_ && !offline) //no flush timer, the writer sends these once it catches up
+            WakeWriter_();
+        return;
+    }
+    // moves made while disconnected are lost with the plugin's state, but a press may
+    // still be meant when Lightroom is back
+    if (offline && !action)
+        return;
+    // format outside the lock into a buffer each producer thread keeps, so a steady
+    // stream of messages allocates nothing
+    thread_local std::string command_to_send;
+    command_to_send.clear();
+    if (delta)
+        AppendDelta_(command_to_send, rm.command_id, step);
+    else
+        AppendCommand_(command_to_send, rm.command_id, rm.value);
+    for (size_t i = 0; i < rm.target_count; ++i) //macro targets go out in the same write
+        AppendCommand_(command_to_send, rm.targets[i].command_id, rm.targets[i].Apply(rm.value));
     {
         std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
-        command_ += command_to_send;
+        if (action && offline) {
+            if (held_actions_.size() >= kMaxHeldActions) { //the press goes, its values stay
+                auto& next = held_actions_[1];
+                next.values.insert(0, held_actions_.front().values);
+                next.value_count += held_actions_.front().value_count;
+                held_actions_.pop_front();
+            }
+            HeldAction held{rm.time_stamp, {}, 0, command_to_send};
+            held.value_count = MovePending_(held.values, target);
+            held_actions_.push_back(std::move(held));
+            return;
+        }
+        auto* lane = &command_;
+        if (action) {
+            // presses overtake queued values, except that values for what the press
+            // sets go just ahead of it. If one is already queued, the press waits behind
+            if (!Queued_(target))
+                lane = &actions_;
+            MovePending_(*lane, target);
+            AppendRateHeld_(*lane, target);
+        }
+        else
+            AppendPending_(); //keep arrival order
+        *lane += command_to_send;
+        if (lane == &command_) {
+            Queue_(rm.command_id);
+            for (size_t i = 0; i < rm.target_count; ++i)
+                Queue_(rm.targets[i].command_id);
+        }
+        if (oldest_arrival_ == 0.0)
+            oldest_arrival_ = rm.time_stamp;
     }
-    juce::AsyncUpdater::triggerAsyncUpdate();
+    if (latency_stats_)
+        latency_stats_->Record(LatencyStats::kEnqueue, rm.time_stamp);
+    WakeWriter_();
 }
 
 void LR_IPC_OUT::connectionMade()
 {
-    for (const auto& cb : callbacks_)
-        cb(true);
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    connect_delay_ = now - state_changed_;
+    state_changed_ = now;
+    state_changed_time_ = juce::Time::getCurrentTime();
+    unresponsive_.store(false, std::memory_order_relaxed);
+    AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::info, "connected after %.0f ms",
+        connect_delay_);
+    SendMappedParams_();
+    Replay_();
+    callbacks_.Publish(true);
 }
 
 void LR_IPC_OUT::connectionLost()
 {
-    for (const auto& cb : callbacks_)
-        cb(false);
+    offline_.store(true, std::memory_order_relaxed); //hold values until connectionMade
+    compact_.store(false, std::memory_order_relaxed); //plugin announces again on reconnection
+    photo_.store(true, std::memory_order_relaxed); //likewise its Lightroom state
+    last_echo_.store(0.0, std::memory_order_relaxed);
+    state_changed_ = juce::Time::getMillisecondCounterHiRes();
+    state_changed_time_ = juce::Time::getCurrentTime();
+    AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::info, "connection lost");
+    ConnectSoon();
+    callbacks_.Publish(false);
 }
 
 void LR_IPC_OUT::messageReceived(const juce::MemoryBlock& /*msg*/)
 {}
 
-void LR_IPC_OUT::handleAsyncUpdate()
+void LR_IPC_OUT::WakeWriter_() noexcept
+{
+    // one notify per batch: producers after the first just add to command_
+    if (!wake_pending_.exchange(true, std::memory_order_acq_rel))
+        juce::Thread::notify();
+}
+
+void LR_IPC_OUT::run()
 {
-    std::string command_copy;
+    RSJ::RaiseCurrentThread(thread_priority_);
+    const ThreadAccount account{"LR_IPC_OUT writer"};
+    while (!juce::Thread::threadShouldExit()) {
+        //also wakes when a held value is due, or to retry a backed up socket
+        juce::Thread::wait(backlogged_.load(std::memory_order_relaxed) ?
+            kRetryWait : RateWait_());
+        // clear before draining, so anything queued after the drain notifies again
+        wake_pending_.store(false, std::memory_order_release);
+        if (!juce::Thread::threadShouldExit()) {
+            if (!backlogged_.load(std::memory_order_relaxed)) //else held values keep coalescing
+                FlushRateLimited_();
+            WriteCommands_();
+        }
+    }
+}
+
+bool LR_IPC_OUT::RateLimited_(const RSJ::ResolvedMessage& rm)
+{
+    // the leading edge goes straight out. Values inside the interval are held and only
+    // the latest is sent when it ends, so the final position always arrives
+    if (rm.command_id >= rate_limits_.size())
+        return false;
+    auto& limit = rate_limits_[rm.command_id];
+    if (limit.interval <= 0.0 && !congestion_)
+        return false;
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    auto first_held = false;
     {
         std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
-        command_copy.swap(command_);
+        if (!limit.held && now - limit.last_sent >= Interval_(rm.command_id)) {
+            limit.last_sent = now;
+            if (congestion_)
+                congestion_->Sent(rm.command_id, now);
+            return false;
+        }
+        if (!limit.held) {
+            limit.held = true;
+            rate_held_.push_back(rm.command_id);
+            first_held = rate_held_.size() == 1;
+        }
+        else
+            outbound_stats_.Coalesced();
+        limit.message = RSJ::MidiMessageId{rm.message};
+        limit.value = rm.value;
+    }
+    if (first_held)
+        WakeWriter_(); //so the writer starts timing the trailing edge
+    return true;
+}
+
+int LR_IPC_OUT::RateWait_()
+{
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    if (rate_held_.empty())
+        return -1;
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    auto wait = std::numeric_limits<double>::max();
+    for (const auto command : rate_held_)
+        wait = std::min(wait, rate_limits_[command].last_sent + Interval_(command) - now);
+    return std::max(1, static_cast<int>(std::ceil(wait)));
+}
+
+void LR_IPC_OUT::FlushRateLimited_()
+{
+    std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+    if (rate_held_.empty())
+        return;
+    AppendPending_(); //keep arrival order
+    AppendRateHeld_(command_, LRCommandList::kNotFound);
+}
+
+void LR_IPC_OUT::AppendRateHeld_(std::string& out, size_t target)
+{
+    //call with command_mutex_ held. A press sends the held values for what it sets
+    //first, as they came before it. kNotFound sends those whose interval has passed
+    if (rate_held_.empty())
+        return;
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    rate_held_.erase(std::remove_if(rate_held_.begin(), rate_held_.end(),
+        [this, now, &out, target](RSJ::CommandId command) {
+        auto& limit = rate_limits_[command];
+        if (target == LRCommandList::kNotFound ? now - limit.last_sent < Interval_(command) :
+            target != LRCommandList::kAllParameters && target != command)
+            return false;
+        if (congestion_)
+            congestion_->Sent(command, now);
+        AppendCommand_(out, command, limit.value);
+        for (const auto& macro : command_map_->getMacroTargets(limit.message))
+            AppendCommand_(out, macro.command_id, macro.Apply(limit.value));
+        limit.last_sent = now;
+        limit.held = false;
+        return true;
+    }), rate_held_.end());
+}
+
+void LR_IPC_OUT::WriteCommands_()
+{
+    // while disconnected values stay in pending_ and presses in held_actions_ for
+    // Replay_. Anything else, and a batch cut by the disconnection, is dropped
+    if (!juce::InterprocessConnection::isConnected()) {
+        outgoing_.clear();
+        written_ = 0;
+        oldest_arrival_batch_ = 0.0;
+        backlogged_.store(false, std::memory_order_relaxed);
+        std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+        //Replay_ may have run since the check. It clears offline_ under this lock, so
+        //only hold values here if the connection is still down
+        if (juce::InterprocessConnection::isConnected())
+            return;
+        offline_.store(true, std::memory_order_relaxed); //ahead of connectionLost
+        actions_.clear();
+        command_.clear();
+        ClearQueued_();
+        if (pending_.empty())
+            oldest_arrival_ = 0.0;
+        return;
+    }
+    // a partly written batch is finished before the next is taken, so lines are never
+    // cut. Meanwhile new values coalesce in pending_
+    if (written_ == outgoing_.size()) {
+        outgoing_.clear(); //swapped back next time, so buffers keep their capacity
+        written_ = 0;
+        std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+        if (!coalesce_ || backlogged_.load(std::memory_order_relaxed))
+            AppendPending_(); //values coalesced while backed up
+        backlogged_.store(false, std::memory_order_relaxed);
+        outgoing_.swap(actions_); //presses go first
+        outgoing_ += command_;
+        command_.clear();
+        ClearQueued_();
+        if (pending_.empty()) { //else the oldest message is still pending
+            oldest_arrival_batch_ = oldest_arrival_;
+            oldest_arrival_ = 0.0;
+        }
+        batch_taken_ = juce::Time::getMillisecondCounterHiRes();
     }
-    //check if there is a connection
-    if (juce::InterprocessConnection::isConnected()) {
-        juce::InterprocessConnection::getSocket()->
-            write(command_copy.c_str(), gsl::narrow_cast<int>(command_copy.length()));
+    while (written_ < outgoing_.size()) {
+        const auto sent = Write_(outgoing_.data() + written_,
+            gsl::narrow_cast<int>(outgoing_.size() - written_));
+        if (sent <= 0)
+            break; //Lightroom isn't reading, retry shortly, or connectionLost follows
+        written_ += static_cast<size_t>(sent);
     }
+    outbound_stats_.Queued(outgoing_.size() - written_);
+    if (written_ < outgoing_.size()) {
+        outbound_stats_.PartialWrite();
+        backlogged_.store(true, std::memory_order_relaxed);
+        return;
+    }
+    if (!outgoing_.empty())
+        outbound_stats_.RecordWrite(batch_taken_);
+    if (latency_stats_ && oldest_arrival_batch_ > 0.0)
+        latency_stats_->Record(LatencyStats::kSocketWrite, oldest_arrival_batch_);
+    oldest_arrival_batch_ = 0.0;
 }
 
-void LR_IPC_OUT::timerCallback()
+int LR_IPC_OUT::Write_(const char* data, int size)
 {
-    std::lock_guard<decltype(timer_mutex_)> lock(timer_mutex_);
-    if (!timer_off_ && !juce::InterprocessConnection::isConnected())
-        juce::InterprocessConnection::connectToSocket(kHost, kLrOutPort, kConnectTryTime);
+    // bytes sent, 0 if the socket can't take any now, -1 on failure
+    const TraceScope trace{"socket write"};
+    if (auto* const socket = juce::InterprocessConnection::getSocket()) {
+        const auto ready = socket->waitUntilReady(false, 0);
+        return ready == 1 ? socket->write(data, size) : ready;
+    }
+    return -1;
+}
+
+void LR_IPC_OUT::timerCallback(int /*timer_id*/)
+{
+    PowerMonitor::CountWakeUp();
+    Connect_();
+    SendMappedParams();
+}
+
+void LR_IPC_OUT::SendMappedParams()
+{
+    // the timer and a profile switch may both send one change, which the plugin takes twice
+    if (juce::InterprocessConnection::isConnected() &&
+        command_map_->getChangeCount() != mapped_changes_.load(std::memory_order_relaxed))
+        SendMappedParams_();
+}
+
+void LR_IPC_OUT::SendMappedParams_()
+{
+    mapped_changes_.store(command_map_->getChangeCount(), std::memory_order_relaxed);
+    std::string command{"MappedParams "};
+    auto first = true;
+    for (const auto id : command_map_->getMappedCommands()) {
+        if (!first)
+            command += ',';
+        command += CommandMap::getCommandString(id);
+        first = false;
+    }
+    sendCommand(command + '\n');
+}
+
+void LR_IPC_OUT::Replay_()
+{
+    // only final state crosses the gap: each control's latest value, and presses still
+    // recent enough to be meant, in one batch after MappedParams
+    size_t values{0};
+    size_t replayed{0};
+    size_t expired{0};
+    {
+        std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        for (const auto& held : held_actions_) {
+            actions_ += held.values;
+            values += held.value_count;
+            if (now - held.arrival <= action_ttl_) {
+                actions_ += held.action;
+                ++replayed;
+            }
+        }
+        expired = held_actions_.size() - replayed;
+        held_actions_.clear();
+        values += pending_index_.size();
+        offline_.store(false, std::memory_order_relaxed);
+        AppendPending_();
+    }
+    WakeWriter_();
+    if (!values && !replayed && !expired)
+        return;
+    static auto& replayed_values = Instrumentation::Counter("values replayed after reconnect");
+    static auto& replayed_actions = Instrumentation::Counter("actions replayed after reconnect");
+    static auto& expired_actions = Instrumentation::Counter("actions expired while disconnected");
+    replayed_values.fetch_add(values, std::memory_order_relaxed);
+    replayed_actions.fetch_add(replayed, std::memory_order_relaxed);
+    expired_actions.fetch_add(expired, std::memory_order_relaxed);
+    AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::info,
+        "replayed %d held values and %d presses, %d presses expired",
+        static_cast<int>(values), static_cast<int>(replayed), static_cast<int>(expired));
+}
+
+void LR_IPC_OUT::FlushPending_()
+{
+    {
+        std::lock_guard<decltype(command_mutex_)> lock(command_mutex_);
+        if (pending_.empty())
+            return;
+        AppendPending_();
+    }
+    WakeWriter_();
+}
+
+void LR_IPC_OUT::AppendPending_()
+{
+    //call with command_mutex_ held. While offline_ the values wait for Replay_
+    if (offline_.load(std::memory_order_relaxed))
+        return;
+    MovePending_(command_, LRCommandList::kAllParameters);
+}
+
+size_t LR_IPC_OUT::MovePending_(std::string& out, size_t target)
+{
+    //call with command_mutex_ held. Moves the controls whose values set target, all of
+    //them for kAllParameters. Later values for the same controls start new entries,
+    //after whatever out gets next
+    if (target == LRCommandList::kNotFound || pending_.empty())
+        return 0;
+    if (target == LRCommandList::kAllParameters) {
+        for (const auto& command : pending_)
+            AppendCommand_(out, command.first, command.second);
+        const auto moved = pending_index_.size();
+        pending_.clear();
+        pending_index_.clear();
+        return moved;
+    }
+    // a control's value and its macro targets are one block, moved or kept together.
+    // Values before the first indexed block belong to controls queued again since
+    struct Block {
+        size_t start;
+        RSJ::MidiMessageId message;
+        bool indexed;
+    };
+    thread_local std::vector<Block> blocks;
+    blocks.clear();
+    for (const auto& entry : pending_index_)
+        blocks.push_back({entry.second, entry.first, true});
+    std::sort(blocks.begin(), blocks.end(), [](const Block& a, const Block& b) noexcept {
+        return a.start < b.start; });
+    if (blocks.empty() || blocks.front().start != 0)
+        blocks.insert(blocks.begin(), Block{0, {}, false});
+    size_t kept{0};
+    size_t moved{0};
+    for (size_t b = 0; b < blocks.size(); ++b) {
+        const auto start = blocks[b].start;
+        const auto end = b + 1 < blocks.size() ? blocks[b + 1].start : pending_.size();
+        const auto first = pending_.begin() + gsl::narrow_cast<std::ptrdiff_t>(start);
+        const auto last = pending_.begin() + gsl::narrow_cast<std::ptrdiff_t>(end);
+        if (std::any_of(first, last, [target](const std::pair<RSJ::CommandId, double>& value)
+            noexcept { return value.first == target; })) {
+            for (auto value = first; value != last; ++value)
+                AppendCommand_(out, value->first, value->second);
+            if (blocks[b].indexed) {
+                pending_index_.erase(blocks[b].message);
+                ++moved;
+            }
+            continue;
+        }
+        if (blocks[b].indexed)
+            pending_index_[blocks[b].message] = kept;
+        if (kept != start)
+            std::move(first, last, pending_.begin() + gsl::narrow_cast<std::ptrdiff_t>(kept));
+        kept += end - start;
+    }
+    pending_.resize(kept);
+    return moved;
+}
+
+bool LR_IPC_OUT::Queued_(size_t target) const noexcept
+{
+    //call with command_mutex_ held
+    if (target == LRCommandList::kAllParameters)
+        return !command_.empty();
+    return target < queued_.size() && queued_[target];
+}
+
+void LR_IPC_OUT::Queue_(RSJ::CommandId command_id)
+{
+    //call with command_mutex_ held
+    if (command_id < queued_.size() && !queued_[command_id]) {
+        queued_[command_id] = true;
+        queued_ids_.push_back(command_id);
+    }
+}
+
+void LR_IPC_OUT::ClearQueued_() noexcept
+{
+    //call with command_mutex_ held, as command_ is emptied
+    for (const auto command_id : queued_ids_)
+        queued_[command_id] = false;
+    queued_ids_.clear();
+}
+
+void LR_IPC_OUT::DropOldestPending_()
+{
+    //call with command_mutex_ held. Overflow drops the control that has waited longest;
+    //buttons never reach pending_, so they are always kept
+    auto oldest = pending_index_.end();
+    auto block = pending_.size();
+    for (auto it = pending_index_.begin(); it != pending_index_.end(); ++it) {
+        if (it->second == 0)
+            oldest = it;
+        else
+            block = std::min(block, it->second);
+    }
+    if (oldest != pending_index_.end())
+        pending_index_.erase(oldest);
+    outbound_stats_.Dropped(block);
+    AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::warning,
+        "Lightroom backlogged, dropped %d held values", static_cast<int>(block));
+    pending_.erase(pending_.begin(), pending_.begin() + gsl::narrow_cast<std::ptrdiff_t>(block));
+    for (auto& entry : pending_index_)
+        entry.second -= block;
+}
+
+void LR_IPC_OUT::AppendLine(std::string& out, RSJ::CommandId command_id, double value,
+    bool compact)
+{
+    if (compact)
+        AppendCompact(out, command_id, value);
+    else {
+        out += CommandMap::getCommandString(command_id);
+        out += ' ';
+        AppendFixed(out, value);
+        out += '\n';
+    }
+}
+
+void LR_IPC_OUT::AppendCommand_(std::string& out, RSJ::CommandId command_id, double value)
+{
+    if (&out == &command_)
+        Queue_(command_id);
+    const auto start = out.size();
+    AppendLine(out, command_id, value, compact_.load(std::memory_order_relaxed));
+    outbound_stats_.Sent(command_id, out.size() - start);
+}
+
+void LR_IPC_OUT::AppendDelta_(std::string& out, RSJ::CommandId command_id, double step)
+{
+    //a text line even with the compact protocol, whose records have no sign. The sign
+    //is always written, telling the plugin this is a move and not a value
+    const auto start = out.size();
+    out += CommandMap::getCommandString(command_id);
+    out += std::signbit(step) ? " " : " +";
+    AppendFixed(out, step);
+    out += '\n';
+    outbound_stats_.Sent(command_id, out.size() - start);
 }
\ No newline at end of file
@@ -22,55 +22,284 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_LR_IPC_OUT_H_INCLUDED
 #define MIDI2LR_LR_IPC_OUT_H_INCLUDED
 
-#include <functional>
+#include <atomic>
+#include <deque>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "EventChannel.h"
+#include "Instrumentation.h"
+#include "LatencyStats.h"
 #include "Misc.h"
+#include "MidiUtilities.h"
+#include "Relay.h"
+#include "Scheduler.h"
+#include "ThreadPriority.h"
+#include "Utilities/Utilities.h"
 class CommandMap;
 class ControlsModel;
 class MIDIProcessor;
-namespace RSJ {
-    struct MidiMessage;
-}
 
 class LR_IPC_OUT final:
     private juce::InterprocessConnection,
-    private juce::AsyncUpdater,
-    private juce::Timer {
+    private juce::MultiTimer,
+    private juce::Thread {
 public:
-    LR_IPC_OUT(ControlsModel* const c_model, const CommandMap * const mapCommand);
+    // scheduler times the coalescing flush and must outlive this
+    LR_IPC_OUT(ControlsModel* const c_model, const CommandMap * const mapCommand,
+        Scheduler* const scheduler);
     virtual ~LR_IPC_OUT();
-    void Init(MIDIProcessor* const midi_processor);
+    // coalesce_interval: if > 0, CC and pitch bend values are held for this many ms
+    // and only the latest value for each control is sent
+    void Init(MIDIProcessor* const midi_processor, int coalesce_interval = 0);
+    // changes the coalesce interval after Init, sending any values held. Any thread
+    void SetCoalesceInterval(int coalesce_interval);
+    // while idle the coalescing flush and connection checks stop, and the plugin is
+    // told to poll less. See PowerMonitor. Any thread
+    void SetIdle(bool idle);
 
-    template<class T> void addCallback(T* const  object, void(T::* const mf)(bool))
+    // told of connection and disconnection, immediate callbacks on the message thread
+    template<class T, void(T::*MF)(bool)>
+    void addCallback(T* const object, Delivery delivery = Delivery::immediate)
     {
-        callbacks_.emplace_back(std::bind(mf, object, std::placeholders::_1));
+        callbacks_.Subscribe<T, MF>(object, delivery);
+    }
+
+    // caps how often each command's value is sent, in updates per second (0 is no cap).
+    // Values arriving faster are held and the latest is sent when the interval ends.
+    // overrides is "name=rate;..." where name is a command or a command menu section.
+    // Call before Init
+    void SetRateLimits(int max_rate, const juce::String& overrides);
+    // lowers each command's rate further while Lightroom is slow to echo values back,
+    // see CongestionControl. Call before Init
+    void SetAdaptiveRate(bool enabled);
+    // LR_IPC_IN tells of each value Lightroom sends, any thread
+    void EchoReceived(RSJ::CommandId command_id);
+    juce::String CongestionReport() const; //empty unless adaptive
+    // with several controls on one command, the last one touched drives it and the
+    // others are dropped until it has been still for hold_ms. Controls that keep taking
+    // turns are feeding each other back through Lightroom, so the current one then
+    // keeps the command longer. Counted in diagnostics. 0 is off. Call before Init
+    void SetTouchHold(int hold_ms);
+    // Lightroom rounds most parameters (LRCommandList::getSteps), so a value rounding
+    // to the step last sent for its command is dropped. Call before Init
+    void SetQuantize(bool enabled);
+    // relative controls on develop parameters send signed moves ("name +0.007874") for
+    // the plugin to add to Lightroom's current value, so an undo or preset applied in
+    // Lightroom leaves no stale encoder position. Call before Init
+    void SetRelativeDeltas(bool enabled);
+
+    // the plugin's report of Lightroom's module and whether it has a target photo.
+    // Without one the plugin can't apply develop values, so they are dropped here
+    // instead (LRCommandList::isDevelop). Until a report, values go through. Any thread
+    void SetLightroomState(const juce::String& module, bool photo);
+
+    // connect to a RelayServer on host instead of the local plugin, timing the hop
+    // (getRelayStats). Empty for the local plugin. Call before Init
+    void SetRemoteHost(const juce::String& host);
+    // the plugin answers a heartbeat line sent every second, timing the link
+    // (getLinkStats). A plugin that has answered but then stays silent for timeout ms is
+    // taken to be hung, and both sockets reconnect. 0 is off. Call before Init
+    void SetHeartbeat(int timeout) noexcept;
+    // while Lightroom is disconnected each control's latest value is held, within the
+    // coalescing bound, and sent when it connects. Button presses are held too and sent
+    // if no older than ttl ms; 0 drops them. Call before Init
+    void SetActionTtl(int ttl) noexcept;
+    // the plugin's answer to a heartbeat sent at sent (ms counter). Reader thread
+    void HeartbeatEcho(double sent) noexcept;
+    // whether the last connection was dropped for missed heartbeats, until the next
+    bool Unresponsive() const noexcept
+    {
+        return unresponsive_.load(std::memory_order_relaxed);
+    }
+    // how the writer thread runs. Call before Init
+    void SetThreadPriority(const RSJ::ThreadPriority& priority) noexcept;
+    // appends the line sending value for command_id, as a compact record or as text
+    static void AppendLine(std::string& out, RSJ::CommandId command_id, double value,
+        bool compact);
+    // retry the connection now and restart the backoff, e.g. when the other socket
+    // to the plugin connects or drops
+    void ConnectSoon();
+    // message thread: when the connection was last made or lost, and how long the
+    // last connection took from the previous loss (or Init)
+    juce::Time getStateChangeTime() const noexcept
+    {
+        return state_changed_time_;
+    }
+    double getConnectDelay() const noexcept
+    {
+        return connect_delay_;
     }
 
     // sends a command to the plugin
     void sendCommand(const std::string& command);
+    // tells the plugin the mapped commands now if the map changed since they were last
+    // sent, rather than at the next timer tick, so a profile switch can have the plugin
+    // resolve them before their controls move. Any thread
+    void SendMappedParams();
+
+    // the plugin decodes fixed-size compact records, so send MIDI-driven commands that
+    // way until the connection drops. Text lines stay valid either way
+    void setCompactProtocol(bool enabled) noexcept;
 
-    void MIDIcmdCallback(RSJ::MidiMessage);
+    // pickup mode: absolute controls and pitch wheels are only sent once they reach
+    // the value Lightroom last fed back, so the plugin applies values as they come
+    void setPickup(bool enabled) noexcept;
+
+    void MIDIcmdCallback(const RSJ::ResolvedMessage&);
+
+    OutboundStats& getOutboundStats() noexcept
+    {
+        return outbound_stats_;
+    }
+    RelayStats& getRelayStats() noexcept
+    {
+        return relay_stats_;
+    }
+    RelayStats& getLinkStats() noexcept
+    {
+        return link_stats_;
+    }
+    // the plugin's handler timings, recorded by LR_IPC_IN when the LuaTiming setting
+    // asks for them
+    PluginStats& getPluginStats() noexcept
+    {
+        return plugin_stats_;
+    }
 
 private:
     // IPC interface
     void connectionMade() override;
     void connectionLost() override;
     void messageReceived(const juce::MemoryBlock& msg) override;
-    // AsyncUpdater interface
-    void handleAsyncUpdate() override;
+    // writer thread: sends whatever has been queued, independent of the message thread
+    void run() override;
+    void WakeWriter_() noexcept;
+    void Heartbeat_(); //scheduler thread
+    void WriteCommands_();
+    int Write_(const char* data, int size);
+    bool RateLimited_(const RSJ::ResolvedMessage& rm);
+    bool Contended_(const RSJ::ResolvedMessage& rm); //another control drives the command
+    bool Unchanged_(const RSJ::ResolvedMessage& rm); //same step as last sent
+    int RateWait_();
+    void FlushRateLimited_();
+    // a press's held values for target (LRCommandList::getTarget), or those that are due
+    // for kNotFound, under command_mutex_
+    void AppendRateHeld_(std::string& out, size_t target);
+    double Interval_(RSJ::CommandId command) const noexcept; //under command_mutex_
     // Timer callback
-    void timerCallback() override;
+    void timerCallback(int timer_id) override;
+    void Connect_();
+    // tells the plugin which parameters are mapped, so it only watches those for
+    // feedback and prepares their handlers and ranges
+    void SendMappedParams_();
+    // sends what was held while disconnected. Message thread
+    void Replay_();
+    void FlushPending_();
+    void ScheduleFlush_();
+    void AppendPending_();
+    size_t MovePending_(std::string& out, size_t target); //controls moved
+    bool Queued_(size_t target) const noexcept; //a value for target is in command_
+    void Queue_(RSJ::CommandId command_id);
+    void ClearQueued_() noexcept;
+    void DropOldestPending_();
+    void AppendCommand_(std::string& out, RSJ::CommandId command_id, double value);
+    void AppendDelta_(std::string& out, RSJ::CommandId command_id, double step);
+    size_t MemoryUse_() const;
 
+    constexpr static size_t kMaxCallbacks = 8;
+    std::atomic<bool> coalesce_{false};
+    std::mutex flush_mutex_; //guards flush_task_, coalesce_interval_ and idle_
+    Scheduler::TaskId flush_task_{0};
+    int coalesce_interval_{0};
+    bool idle_{false};
+    Scheduler::TaskId ping_task_{0};
+    Scheduler::TaskId heartbeat_task_{0};
+    int heartbeat_timeout_{0};
+    juce::String remote_host_{};
     bool timer_off_{false};
+    int retry_interval_{0}; //ms, guarded by timer_mutex_
+    RSJ::ThreadPriority thread_priority_{};
+    double state_changed_{0.0}; //message thread
+    double connect_delay_{0.0}; //message thread
+    juce::Time state_changed_time_{}; //message thread
+    std::atomic<juce::uint32> mapped_changes_{0}; //map change count last sent
+    std::atomic<bool> wake_pending_{false}; //writer already notified, skip another notify
+    std::atomic<bool> compact_{false};
+    std::atomic<bool> pickup_{false};
+    bool deltas_{false};
+    std::atomic<bool> photo_{true}; //Lightroom has a target photo, as last reported
+    std::atomic<bool> backlogged_{false}; //socket couldn't take the whole batch
+    std::atomic<bool> offline_{true}; //values are held in pending_ until Replay_
+    std::atomic<double> last_echo_{0.0}; //heartbeat answered, 0 until one is this connection
+    std::atomic<bool> unresponsive_{false};
     const CommandMap * const command_map_;
     ControlsModel* const controls_model_;
+    Scheduler* const scheduler_;
     mutable RSJ::RelaxTTasSpinLock command_mutex_; //fast spinlock for brief use
     mutable std::mutex timer_mutex_; //fix race during shutdown
-    std::string command_;
-    std::vector<std::function<void(bool)>> callbacks_;
+    std::string actions_; //button presses and plugin commands, sent before command_
+    std::string command_; //parameter values, and presses that mustn't overtake them
+    std::vector<bool> queued_; //by CommandId, a value for it is in command_
+    std::vector<RSJ::CommandId> queued_ids_; //those set in queued_
+    std::string outgoing_; //writer thread only
+    size_t written_{0}; //bytes of outgoing_ already sent, writer thread only
+    double oldest_arrival_batch_{0.0}; //oldest_arrival_ for outgoing_, writer thread only
+    double batch_taken_{0.0}; //when outgoing_ was taken, writer thread only
+    double oldest_arrival_{0.0}; //MIDI arrival of the oldest message in command_ or pending_
+    LatencyStats* latency_stats_{nullptr};
+    OutboundStats outbound_stats_;
+    RelayStats relay_stats_;
+    RelayStats link_stats_{"Lightroom link"};
+    PluginStats plugin_stats_;
+    //latest value per control, in order of first arrival, guarded by command_mutex_
+    std::unordered_map<RSJ::MidiMessageId, size_t> pending_index_;
+    std::vector<std::pair<RSJ::CommandId, double>> pending_;
+    //button presses while offline_, guarded by command_mutex_. values are those held
+    //before the press for what it sets, so they replay ahead of it, even once it expires
+    struct HeldAction {
+        double arrival;
+        std::string values;
+        size_t value_count;
+        std::string action;
+    };
+    std::deque<HeldAction> held_actions_;
+    int action_ttl_{0}; //ms
+    //per command rate limiting, indexed by CommandId. Sized once before Init, the rest
+    //guarded by command_mutex_
+    struct RateLimit {
+        double interval{0.0}; //ms, 0 for no limit
+        double last_sent{0.0};
+        bool held{false};
+        RSJ::MidiMessageId message{};
+        double value{0.0};
+    };
+    std::vector<RateLimit> rate_limits_;
+    std::vector<RSJ::CommandId> rate_held_; //commands with a held value
+    std::unique_ptr<CongestionControl> congestion_{nullptr}; //guarded by command_mutex_
+    //last touch arbitration, indexed by CommandId. Sized once before Init, the rest
+    //guarded by command_mutex_
+    struct Touch {
+        RSJ::MidiMessageId owner{};
+        double last{0.0}; //0 until first touched
+        double window{0.0}; //start of the current handover count
+        int handovers{0};
+        double damped_until{0.0};
+    };
+    double touch_hold_{0.0}; //ms
+    std::vector<Touch> touches_;
+    //step last sent per CommandId, sized once before Init, guarded by command_mutex_
+    struct Quantum {
+        long step{-1};
+        double sent{0.0};
+    };
+    std::vector<Quantum> quanta_;
+    EventChannel<kMaxCallbacks, bool> callbacks_{"Lightroom connection"};
+    MemoryAccount memory_{"IPC buffers", [this] {return MemoryUse_(); }}; //last, goes first
 };
 
 #endif  // LR_IPC_OUT_H_INCLUDED
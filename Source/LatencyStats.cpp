@@ -0,0 +1,404 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    LatencyStats.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "LatencyStats.h"
+#include <algorithm>
+#include <functional>
+#include <numeric>
+#include "CommandMap.h"
+
+LatencyHistogram::LatencyHistogram() noexcept
+{
+    Reset();
+}
+
+int LatencyHistogram::BucketFor_(juce::int64 micros) noexcept
+{
+    if (micros < kSubBuckets)
+        return micros < 0 ? 0 : static_cast<int>(micros);
+    auto top_bit = 0;
+    for (auto v = micros; v > 1; v >>= 1)
+        ++top_bit;
+    const auto sub = static_cast<int>(micros >> (top_bit - kSubBits)) & (kSubBuckets - 1);
+    const auto bucket = (top_bit - kSubBits + 1) * kSubBuckets + sub;
+    return bucket < kBuckets ? bucket : kBuckets - 1;
+}
+
+juce::int64 LatencyHistogram::BucketLimit_(int bucket) noexcept
+{
+    if (bucket < kSubBuckets)
+        return bucket + 1;
+    const auto shift = bucket / kSubBuckets - 1;
+    const auto sub = bucket % kSubBuckets;
+    return static_cast<juce::int64>(kSubBuckets + sub + 1) << shift;
+}
+
+void LatencyHistogram::Record(double milliseconds) noexcept
+{
+    const auto micros = static_cast<juce::int64>(milliseconds * 1000.0);
+    counts_[static_cast<size_t>(BucketFor_(micros))].fetch_add(1, std::memory_order_relaxed);
+    auto max = max_micros_.load(std::memory_order_relaxed);
+    while (micros > max &&
+        !max_micros_.compare_exchange_weak(max, micros, std::memory_order_relaxed))
+        ; //max updated by compare_exchange_weak on failure
+}
+
+void LatencyHistogram::Reset() noexcept
+{
+    for (auto& count : counts_) //can't use fill as copy/assign deleted for atomic
+        count.store(0, std::memory_order_relaxed);
+    max_micros_.store(0, std::memory_order_relaxed);
+}
+
+juce::uint64 LatencyHistogram::Count() const noexcept
+{
+    juce::uint64 total{0};
+    for (const auto& count : counts_)
+        total += count.load(std::memory_order_relaxed);
+    return total;
+}
+
+double LatencyHistogram::MaxMs() const noexcept
+{
+    return static_cast<double>(max_micros_.load(std::memory_order_relaxed)) / 1000.0;
+}
+
+double LatencyHistogram::PercentileMs(double fraction) const noexcept
+{
+    const auto total = Count();
+    if (total == 0)
+        return 0.0;
+    const auto target = static_cast<juce::uint64>(fraction * static_cast<double>(total));
+    juce::uint64 seen{0};
+    for (auto bucket = 0; bucket < kBuckets; ++bucket) {
+        seen += counts_[static_cast<size_t>(bucket)].load(std::memory_order_relaxed);
+        if (seen > target)
+            return static_cast<double>(BucketLimit_(bucket)) / 1000.0;
+    }
+    return MaxMs();
+}
+
+LatencyHistogram::Recent LatencyHistogram::TakeRecent(double fraction) noexcept
+{
+    std::array<juce::uint32, kBuckets> recent;
+    juce::uint64 total{0};
+    for (size_t bucket = 0; bucket < counts_.size(); ++bucket) {
+        const auto count = counts_[bucket].load(std::memory_order_relaxed);
+        recent[bucket] = count >= taken_[bucket] ? count - taken_[bucket] : count; //Reset since
+        taken_[bucket] = count;
+        total += recent[bucket];
+    }
+    if (total == 0)
+        return {0, 0.0};
+    const auto target = static_cast<juce::uint64>(fraction * static_cast<double>(total));
+    juce::uint64 seen{0};
+    for (auto bucket = 0; bucket < kBuckets; ++bucket) {
+        seen += recent[static_cast<size_t>(bucket)];
+        if (seen > target)
+            return {total, static_cast<double>(BucketLimit_(bucket)) / 1000.0};
+    }
+    return {total, MaxMs()};
+}
+
+void LatencyStats::Reset() noexcept
+{
+    for (auto& histogram : histograms_)
+        histogram.Reset();
+}
+
+const char* LatencyStats::StageName(Stage stage) noexcept
+{
+    static const char* const stage_names[kStageCount]{"dispatch", "conversion", "enqueue",
+        "socket write"};
+    return stage_names[stage];
+}
+
+juce::String LatencyStats::Report() const
+{
+    juce::String report{"stage, count, p50 ms, p90 ms, p99 ms, max ms\n"};
+    for (auto stage = 0; stage < kStageCount; ++stage) {
+        const auto& histogram = histograms_[static_cast<size_t>(stage)];
+        report << StageName(static_cast<Stage>(stage)) << ", " << juce::String(histogram.Count()) << ", "
+            << juce::String(histogram.PercentileMs(0.5), 3) << ", "
+            << juce::String(histogram.PercentileMs(0.9), 3) << ", "
+            << juce::String(histogram.PercentileMs(0.99), 3) << ", "
+            << juce::String(histogram.MaxMs(), 3) << "\n";
+    }
+    return report;
+}
+
+bool LatencyStats::WriteReport(const juce::File& file) const
+{
+    return file.replaceWithText(Report());
+}
+
+namespace {
+    constexpr double kMinRate = 5.0; //values per second per parameter
+    constexpr double kMaxRate = 100.0;
+    constexpr double kIncrease = 1.0; //per echo on time
+    constexpr double kDecrease = 0.5; //on a late echo
+    constexpr double kCongestedFactor = 2.0; //late: over base round trip * this + slack
+    constexpr double kCongestedSlack = 20.0; //ms
+    constexpr double kBaseCreep = 0.002; //of the difference, so the base follows slowly
+    constexpr double kEchoTimeout = 2000.0; //ms, a value Lightroom didn't change
+    constexpr double kSmoothing = 0.125; //as TCP's SRTT
+}
+
+CongestionControl::CongestionControl(size_t command_count):
+    sent_(command_count, 0.0), rate_{kMaxRate}
+{}
+
+void CongestionControl::Sent(size_t command_id, double now) noexcept
+{
+    // one value in flight per parameter is timed, as TCP times one segment per round
+    if (command_id < sent_.size() &&
+        (sent_[command_id] == 0.0 || now - sent_[command_id] > kEchoTimeout))
+        sent_[command_id] = now;
+}
+
+void CongestionControl::Echoed(size_t command_id, double now) noexcept
+{
+    if (command_id >= sent_.size() || sent_[command_id] == 0.0)
+        return;
+    const auto rtt = now - sent_[command_id];
+    sent_[command_id] = 0.0;
+    if (rtt > kEchoTimeout)
+        return; //an echo of something else
+    ++samples_;
+    smoothed_rtt_ = samples_ == 1 ? rtt : smoothed_rtt_ + kSmoothing * (rtt - smoothed_rtt_);
+    base_rtt_ = samples_ == 1 || rtt < base_rtt_ ? rtt : base_rtt_ + kBaseCreep * (rtt - base_rtt_);
+    if (rtt <= base_rtt_ * kCongestedFactor + kCongestedSlack) {
+        rate_ = std::min(kMaxRate, rate_ + kIncrease);
+        return;
+    }
+    if (now - last_decrease_ < smoothed_rtt_)
+        return; //this round trip already cut the rate
+    rate_ = std::max(kMinRate, rate_ * kDecrease);
+    last_decrease_ = now;
+    ++decreases_;
+}
+
+juce::String CongestionControl::Report() const
+{
+    juce::String report{"adaptive rate, value\n"};
+    report << "values/s per parameter, " << juce::String(rate_, 1) << "\n"
+        << "echo base ms, " << juce::String(base_rtt_, 1) << "\n"
+        << "echo smoothed ms, " << juce::String(smoothed_rtt_, 1) << "\n"
+        << "echoes timed, " << juce::String(samples_) << "\n"
+        << "decreases, " << juce::String(decreases_) << "\n";
+    return report;
+}
+
+OutboundStats::OutboundStats(size_t command_count, const RSJ::RelaxTTasSpinLock* queue_lock):
+    sent_(command_count), sent_bytes_(command_count), queue_lock_{queue_lock}
+{
+    Reset();
+}
+
+void OutboundStats::Queued(size_t bytes) noexcept
+{
+    queued_.store(bytes, std::memory_order_relaxed);
+    auto peak = peak_queued_.load(std::memory_order_relaxed);
+    while (bytes > peak &&
+        !peak_queued_.compare_exchange_weak(peak, bytes, std::memory_order_relaxed))
+        ; //peak updated by compare_exchange_weak on failure
+}
+
+void OutboundStats::Reset() noexcept
+{
+    for (auto& count : sent_)
+        count.store(0, std::memory_order_relaxed);
+    for (auto& bytes : sent_bytes_)
+        bytes.store(0, std::memory_order_relaxed);
+    peak_queued_.store(queued_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+    partial_writes_.store(0, std::memory_order_relaxed);
+    coalesced_.store(0, std::memory_order_relaxed);
+    dropped_.store(0, std::memory_order_relaxed);
+    write_time_.Reset();
+    since_.store(juce::Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+}
+
+juce::String OutboundStats::Report() const
+{
+    constexpr size_t kTopCommands = 10;
+    const auto seconds = std::max(1e-3,
+        (juce::Time::getMillisecondCounterHiRes() - since_.load(std::memory_order_relaxed)) / 1000.0);
+    std::vector<std::pair<juce::uint32, size_t>> counts;
+    for (size_t id = 0; id < sent_.size(); ++id)
+        if (const auto count = sent_[id].load(std::memory_order_relaxed))
+            counts.emplace_back(count, id);
+    const auto total = std::accumulate(counts.begin(), counts.end(), juce::uint64{0},
+        [](juce::uint64 sum, const std::pair<juce::uint32, size_t>& c) {return sum + c.first; });
+    std::sort(counts.begin(), counts.end(), std::greater<std::pair<juce::uint32, size_t>>());
+    juce::String report{"outbound, value\n"};
+    report << "queued bytes, " << juce::String(queued_.load(std::memory_order_relaxed)) << "\n"
+        << "peak queued bytes, " << juce::String(peak_queued_.load(std::memory_order_relaxed)) << "\n"
+        << "messages, " << juce::String(total) << "\n"
+        << "messages/s, " << juce::String(static_cast<double>(total) / seconds, 1) << "\n"
+        << "write p50 ms, " << juce::String(write_time_.PercentileMs(0.5), 3) << "\n"
+        << "write p99 ms, " << juce::String(write_time_.PercentileMs(0.99), 3) << "\n"
+        << "write max ms, " << juce::String(write_time_.MaxMs(), 3) << "\n"
+        << "partial writes, " << juce::String(partial_writes_.load(std::memory_order_relaxed)) << "\n"
+        << "coalesced, " << juce::String(coalesced_.load(std::memory_order_relaxed)) << "\n"
+        << "dropped, " << juce::String(dropped_.load(std::memory_order_relaxed)) << "\n";
+    counts.resize(std::min(counts.size(), kTopCommands));
+    for (const auto& count : counts)
+        report << CommandMap::getCommandString(static_cast<CommandMap::CommandId>(count.second)).c_str()
+            << " messages/s, " << juce::String(static_cast<double>(count.first) / seconds, 1) << "\n";
+    std::vector<std::pair<juce::uint64, size_t>> bytes;
+    for (size_t id = 0; id < sent_bytes_.size(); ++id)
+        if (const auto sent = sent_bytes_[id].load(std::memory_order_relaxed))
+            bytes.emplace_back(sent, id);
+    std::sort(bytes.begin(), bytes.end(), std::greater<std::pair<juce::uint64, size_t>>());
+    bytes.resize(std::min(bytes.size(), kTopCommands));
+    for (const auto& sent : bytes)
+        report << CommandMap::getCommandString(static_cast<CommandMap::CommandId>(sent.second)).c_str()
+            << " bytes/s, " << juce::String(static_cast<double>(sent.first) / seconds, 1) << "\n";
+    if (RSJ::kSpinLockStats && queue_lock_) {
+        const auto lock = queue_lock_->stats();
+        report << "queue lock acquisitions, " << juce::String(lock.acquisitions) << "\n"
+            << "queue lock contended, " << juce::String(lock.contended) << "\n"
+            << "queue lock spins, " << juce::String(lock.spins) << "\n"
+            << "queue lock yields, " << juce::String(lock.yields) << "\n"
+            << "queue lock max wait us, " << juce::String(lock.max_wait, 1) << "\n";
+    }
+    return report;
+}
+
+ActivityStats::ActivityStats() noexcept
+{
+    Reset();
+}
+
+size_t ActivityStats::Control_(const RSJ::MidiMessage& message) noexcept
+{
+    switch (message.message_type_byte) {
+    case RSJ::kCCFlag:
+        return static_cast<size_t>(message.number);
+    case RSJ::kNoteOnFlag:
+    case RSJ::kNoteOffFlag:
+        return kNoteBase + static_cast<size_t>(message.number);
+    case RSJ::kPWFlag:
+        return kPitchBend;
+    default:
+        return kControls; //not counted
+    }
+}
+
+juce::String ActivityStats::ControlName(size_t channel, size_t control)
+{
+    const juce::String prefix{juce::String(static_cast<int>(channel) + 1) + " | "};
+    if (control < kNoteBase)
+        return prefix + "CC: " + juce::String(static_cast<int>(control));
+    if (control < kPitchBend)
+        return prefix + "Note: " + juce::String(static_cast<int>(control - kNoteBase));
+    return prefix + "Pitch";
+}
+
+void ActivityStats::Reset() noexcept
+{
+    for (auto& count : counts_)
+        count.store(0, std::memory_order_relaxed);
+    since_.store(juce::Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+}
+
+juce::String ActivityStats::Report() const
+{
+    constexpr size_t kTopControls = 10;
+    const auto seconds = std::max(1e-3,
+        (juce::Time::getMillisecondCounterHiRes() - since_.load(std::memory_order_relaxed)) / 1000.0);
+    std::vector<std::pair<juce::uint32, size_t>> counts;
+    for (size_t slot = 0; slot < counts_.size(); ++slot)
+        if (const auto count = counts_[slot].load(std::memory_order_relaxed))
+            counts.emplace_back(count, slot);
+    std::sort(counts.begin(), counts.end(), std::greater<std::pair<juce::uint32, size_t>>());
+    counts.resize(std::min(counts.size(), kTopControls));
+    juce::String report{"control, messages/s\n"};
+    for (const auto& count : counts)
+        report << ControlName(count.second / kControls, count.second % kControls) << ", "
+            << juce::String(static_cast<double>(count.first) / seconds, 1) << "\n";
+    return report;
+}
+
+
+void StartupTrace::Record(const char* phase, double began)
+{
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    std::lock_guard<decltype(mutex_phases_)> lock(mutex_phases_);
+    phases_.push_back({phase, began - start_, now - began});
+}
+
+juce::String StartupTrace::Report() const
+{
+    juce::String report{"start-up phase, began ms, took ms\n"};
+    {
+        std::lock_guard<decltype(mutex_phases_)> lock(mutex_phases_);
+        for (const auto& phase : phases_)
+            report << phase.name << ", " << juce::String(phase.began, 1) << ", "
+            << juce::String(phase.duration, 1) << "\n";
+    }
+    const auto at = [this](double time) {
+        return time == 0.0 ? juce::String{"not yet"} : juce::String(time - start_, 1);
+    };
+    report << "ready, " << at(ready_.load(std::memory_order_relaxed)) << "\n"
+        << "first MIDI message, " << at(first_message_.load(std::memory_order_relaxed)) << "\n";
+    return report;
+}
+
+void PluginStats::Record(const juce::String& handler, juce::uint64 calls, double total_ms,
+    double worst_ms)
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    auto& entry = handlers_[handler];
+    entry.calls += calls;
+    entry.total_ms += total_ms;
+    entry.worst_ms = std::max(entry.worst_ms, worst_ms);
+}
+
+void PluginStats::Reset()
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    handlers_.clear();
+    since_ = juce::Time::getMillisecondCounterHiRes();
+}
+
+juce::String PluginStats::Report() const
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    const auto seconds = std::max(1e-3, (juce::Time::getMillisecondCounterHiRes() - since_) / 1000.0);
+    // busiest first: the handler holding Lightroom's Lua thread longest
+    std::vector<std::pair<double, const juce::String*>> order;
+    for (const auto& entry : handlers_)
+        order.emplace_back(entry.second.total_ms, &entry.first);
+    std::sort(order.begin(), order.end(), std::greater<std::pair<double, const juce::String*>>());
+    juce::String report{"plugin handler, calls, mean ms, worst ms, busy %\n"};
+    if (handlers_.empty())
+        report << "none reported, , , , \n";
+    for (const auto& entry : order) {
+        const auto& handler = handlers_.at(*entry.second);
+        report << *entry.second << ", " << juce::String(handler.calls) << ", "
+            << juce::String(handler.calls ? handler.total_ms / static_cast<double>(handler.calls) :
+                0.0, 3) << ", " << juce::String(handler.worst_ms, 3) << ", "
+            << juce::String(handler.total_ms / (seconds * 10.0), 2) << "\n";
+    }
+    return report;
+}
\ No newline at end of file
@@ -0,0 +1,279 @@
+#pragma once
+/*
+  ==============================================================================
+
+    LatencyStats.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_LATENCYSTATS_H_INCLUDED
+#define MIDI2LR_LATENCYSTATS_H_INCLUDED
+
+#include <array>
+#include <atomic>
+#include <map>
+#include <mutex>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiUtilities.h"
+#include "Misc.h"
+
+// Log-linear histogram of latencies: each power-of-two range of microseconds is
+// split into kSubBuckets buckets, so resolution is within 1/8 of the value.
+// Record may be called from any thread.
+class LatencyHistogram {
+public:
+    LatencyHistogram() noexcept;
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+    void Record(double milliseconds) noexcept;
+    void Reset() noexcept;
+    juce::uint64 Count() const noexcept;
+    double MaxMs() const noexcept;
+    // upper bound of the bucket holding the fraction (0-1) of recorded values
+    double PercentileMs(double fraction) const noexcept;
+    // the values recorded since the previous call, for one caller watching recent
+    // latency rather than the whole run
+    struct Recent {
+        juce::uint64 count;
+        double percentile_ms; //0 if count is 0
+    };
+    Recent TakeRecent(double fraction) noexcept;
+
+private:
+    constexpr static int kSubBits = 3;
+    constexpr static int kSubBuckets = 1 << kSubBits;
+    constexpr static int kBuckets = 28 * kSubBuckets; //up to about 2^30 us
+    static int BucketFor_(juce::int64 micros) noexcept;
+    static juce::int64 BucketLimit_(int bucket) noexcept;
+    std::array<std::atomic<juce::uint32>, kBuckets> counts_;
+    std::array<juce::uint32, kBuckets> taken_{}; //counts_ at the last TakeRecent
+    std::atomic<juce::int64> max_micros_{0};
+};
+
+// latency from MIDI arrival to each point of the pipeline
+class LatencyStats {
+public:
+    enum Stage {
+        kDispatch, //callbacks start running (after any ingress queue wait)
+        kConversion, //command looked up and value converted
+        kEnqueue, //command added to LR_IPC_OUT's outgoing buffer
+        kSocketWrite, //buffer written to the socket, oldest message in the batch
+        kStageCount
+    };
+    LatencyStats() = default;
+    LatencyStats(const LatencyStats&) = delete;
+    LatencyStats& operator=(const LatencyStats&) = delete;
+    // arrival is juce::Time::getMillisecondCounterHiRes when the message arrived
+    void Record(Stage stage, double arrival) noexcept
+    {
+        histograms_[stage].Record(juce::Time::getMillisecondCounterHiRes() - arrival);
+    }
+    LatencyHistogram::Recent TakeRecent(Stage stage, double fraction) noexcept
+    {
+        return histograms_[stage].TakeRecent(fraction);
+    }
+    void Reset() noexcept;
+    juce::String Report() const;
+    bool WriteReport(const juce::File& file) const;
+    const LatencyHistogram& Histogram(Stage stage) const noexcept
+    {
+        return histograms_[stage];
+    }
+    static const char* StageName(Stage stage) noexcept;
+
+private:
+    std::array<LatencyHistogram, kStageCount> histograms_;
+};
+
+// LR_IPC_OUT's queue: how far behind the writer is and what it sent or gave up.
+// Counters may be updated from any thread
+class OutboundStats {
+public:
+    // queue_lock, if given, has its contention counters added to Report
+    explicit OutboundStats(size_t command_count,
+        const RSJ::RelaxTTasSpinLock* queue_lock = nullptr);
+    OutboundStats(const OutboundStats&) = delete;
+    OutboundStats& operator=(const OutboundStats&) = delete;
+    void Sent(size_t command_id, size_t bytes) noexcept
+    {
+        if (command_id < sent_.size()) {
+            sent_[command_id].fetch_add(1, std::memory_order_relaxed);
+            sent_bytes_[command_id].fetch_add(bytes, std::memory_order_relaxed);
+        }
+    }
+    size_t CommandCount() const noexcept
+    {
+        return sent_.size();
+    }
+    juce::uint64 SentBytes(size_t command_id) const noexcept
+    {
+        return sent_bytes_[command_id].load(std::memory_order_relaxed);
+    }
+    void Queued(size_t bytes) noexcept; //bytes waiting for the socket
+    void PartialWrite() noexcept
+    {
+        partial_writes_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void Coalesced() noexcept //a value replaced before it was sent
+    {
+        coalesced_.fetch_add(1, std::memory_order_relaxed);
+    }
+    void Dropped(size_t values) noexcept
+    {
+        dropped_.fetch_add(values, std::memory_order_relaxed);
+    }
+    void RecordWrite(double taken) noexcept //batch taken at taken, now fully written
+    {
+        write_time_.Record(juce::Time::getMillisecondCounterHiRes() - taken);
+    }
+    void Reset() noexcept;
+    juce::String Report() const;
+
+private:
+    std::vector<std::atomic<juce::uint32>> sent_; //by CommandId
+    std::vector<std::atomic<juce::uint64>> sent_bytes_; //by CommandId
+    std::atomic<size_t> queued_{0};
+    std::atomic<size_t> peak_queued_{0};
+    std::atomic<juce::uint64> partial_writes_{0};
+    std::atomic<juce::uint64> coalesced_{0};
+    std::atomic<juce::uint64> dropped_{0};
+    std::atomic<double> since_{0.0};
+    LatencyHistogram write_time_;
+    const RSJ::RelaxTTasSpinLock* const queue_lock_;
+};
+
+// AIMD control of how often each parameter's value goes to Lightroom, from the time
+// between sending a value and the plugin echoing Lightroom's new value. While echoes
+// come back close to the fastest seen the rate climbs additively; a much slower echo
+// halves it, at most once per round trip. Not thread safe, LR_IPC_OUT calls it under
+// its command lock
+class CongestionControl {
+public:
+    explicit CongestionControl(size_t command_count);
+    void Sent(size_t command_id, double now) noexcept;
+    void Echoed(size_t command_id, double now) noexcept;
+    double IntervalMs() const noexcept //between one parameter's values
+    {
+        return 1000.0 / rate_;
+    }
+    juce::String Report() const;
+
+private:
+    std::vector<double> sent_; //ms, by CommandId, 0 when no echo is awaited
+    double rate_; //values per second per parameter
+    double base_rtt_{0.0}; //fastest echo, creeping up slowly
+    double smoothed_rtt_{0.0};
+    double last_decrease_{0.0};
+    juce::uint64 samples_{0};
+    juce::uint64 decreases_{0};
+};
+
+// messages received for each channel and control, to find controls flooding the
+// pipeline. Record may be called from any thread
+class ActivityStats {
+public:
+    constexpr static size_t kChannels = 16;
+    constexpr static size_t kNoteBase = 128; //controls: CC 0-127, notes 0-127, pitch bend
+    constexpr static size_t kPitchBend = 256;
+    constexpr static size_t kControls = 257;
+    ActivityStats() noexcept;
+    ActivityStats(const ActivityStats&) = delete;
+    ActivityStats& operator=(const ActivityStats&) = delete;
+    void Record(const RSJ::MidiMessage& message) noexcept
+    {
+        const auto control = Control_(message);
+        const auto channel = static_cast<size_t>(message.channel);
+        if (control < kControls && channel < kChannels)
+            counts_[channel * kControls + control].fetch_add(1, std::memory_order_relaxed);
+    }
+    juce::uint32 Count(size_t channel, size_t control) const noexcept
+    {
+        return counts_[channel * kControls + control].load(std::memory_order_relaxed);
+    }
+    // as shown in the command table, e.g. "3 | CC: 7"
+    static juce::String ControlName(size_t channel, size_t control);
+    void Reset() noexcept;
+    juce::String Report() const;
+
+private:
+    static size_t Control_(const RSJ::MidiMessage& message) noexcept;
+    std::array<std::atomic<juce::uint32>, kChannels * kControls> counts_;
+    std::atomic<double> since_{0.0};
+};
+
+// how long each start-up phase took, and the time from start until the application
+// was ready and until the first MIDI message arrived. Any thread
+class StartupTrace {
+public:
+    StartupTrace() noexcept:
+        start_{juce::Time::getMillisecondCounterHiRes()}
+    {}
+    StartupTrace(const StartupTrace&) = delete;
+    StartupTrace& operator=(const StartupTrace&) = delete;
+    // began is juce::Time::getMillisecondCounterHiRes when the phase started
+    void Record(const char* phase, double began);
+    void Ready() noexcept
+    {
+        ready_.store(juce::Time::getMillisecondCounterHiRes(), std::memory_order_relaxed);
+    }
+    void FirstMessage() noexcept
+    {
+        if (first_message_.load(std::memory_order_relaxed) != 0.0)
+            return;
+        auto none = 0.0;
+        first_message_.compare_exchange_strong(none, juce::Time::getMillisecondCounterHiRes(),
+            std::memory_order_relaxed);
+    }
+    juce::String Report() const;
+
+private:
+    struct Phase {
+        const char* name;
+        double began; //ms after start_
+        double duration;
+    };
+    const double start_;
+    std::atomic<double> ready_{0.0};
+    std::atomic<double> first_message_{0.0};
+    mutable std::mutex mutex_phases_;
+    std::vector<Phase> phases_;
+};
+
+// where the plugin's time goes on Lightroom's side: its handlers' calls, total and worst
+// time, as it reports them every few seconds when asked to (the LuaTiming setting), added
+// up here so they read next to the MIDI2LR stages. Reader thread records, any thread
+// reports
+class PluginStats {
+public:
+    // one handler's figures since the plugin's previous report
+    void Record(const juce::String& handler, juce::uint64 calls, double total_ms,
+        double worst_ms);
+    void Reset();
+    juce::String Report() const;
+
+private:
+    struct Handler {
+        juce::uint64 calls{0};
+        double total_ms{0.0};
+        double worst_ms{0.0};
+    };
+    mutable std::mutex mutex_;
+    std::map<juce::String, Handler> handlers_;
+    double since_{juce::Time::getMillisecondCounterHiRes()};
+};
+
+#endif  // LATENCYSTATS_H_INCLUDED
\ No newline at end of file
@@ -0,0 +1,144 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    LatencyWatchdog.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "LatencyWatchdog.h"
+#include <algorithm>
+#include "LatencyStats.h"
+#include "LR_IPC_In.h"
+#include "LR_IPC_Out.h"
+#include "MIDIProcessor.h"
+#include "PowerMonitor.h"
+
+namespace {
+    constexpr double kCheckInterval = 1000.0; //ms
+    constexpr double kPercentile = 0.99;
+    constexpr juce::uint64 kMinSamples = 20; //fewer in a check says nothing either way
+    constexpr int kTripChecks = 2; //over budget this many checks running degrades
+    constexpr int kRecoverChecks = 5; //within kRecoverFraction of budget this many recovers
+    constexpr double kRecoverFraction = 0.8;
+    constexpr size_t kMaxTransitions = 16;
+}
+
+LatencyWatchdog::LatencyWatchdog(Scheduler* const scheduler): scheduler_{scheduler}
+{}
+
+LatencyWatchdog::~LatencyWatchdog()
+{
+    Stop();
+}
+
+void LatencyWatchdog::Init(std::weak_ptr<MIDIProcessor>&& midi_processor,
+    std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out, std::weak_ptr<LR_IPC_IN>&& lr_ipc_in,
+    double budget_ms, int coalesce_interval, int degraded_coalesce_interval)
+{
+    midi_processor_ = std::move(midi_processor);
+    lr_ipc_out_ = std::move(lr_ipc_out);
+    lr_ipc_in_ = std::move(lr_ipc_in);
+    budget_ms_ = budget_ms;
+    coalesce_interval_ = coalesce_interval;
+    degraded_interval_ = std::max(coalesce_interval, degraded_coalesce_interval);
+    if (budget_ms_ > 0.0)
+        check_task_ = scheduler_->Schedule([this] {Check_(); }, kCheckInterval, kCheckInterval);
+}
+
+void LatencyWatchdog::Stop()
+{
+    if (check_task_) {
+        scheduler_->Cancel(check_task_);
+        check_task_ = 0;
+    }
+}
+
+void LatencyWatchdog::SetIdle(bool idle)
+{
+    Stop();
+    if (!idle && budget_ms_ > 0.0)
+        check_task_ = scheduler_->Schedule([this] {Check_(); }, kCheckInterval, kCheckInterval);
+}
+
+void LatencyWatchdog::Check_()
+{
+    PowerMonitor::CountWakeUp();
+    const auto midi_processor = midi_processor_.lock();
+    if (!midi_processor)
+        return;
+    const auto recent = midi_processor->getLatencyStats().TakeRecent(LatencyStats::kSocketWrite,
+        kPercentile);
+    const auto degraded = IsDegraded();
+    // values wait up to the coalesce interval by design, only time beyond that counts
+    const auto hold = static_cast<double>(degraded ? degraded_interval_ : coalesce_interval_);
+    const auto beyond = recent.percentile_ms - hold;
+    const auto measured = "p99 MIDI to socket " + juce::String(recent.percentile_ms, 1) + " ms" +
+        (hold > 0.0 ? " with " + juce::String(hold, 0) + " ms coalescing" : juce::String{});
+    if (!degraded) {
+        over_budget_ = recent.count >= kMinSamples && beyond > budget_ms_ ? over_budget_ + 1 : 0;
+        if (over_budget_ >= kTripChecks)
+            Change_(true, measured + " over " + juce::String(budget_ms_, 1) + " ms budget");
+        return;
+    }
+    // quiet checks count as recovered: nothing is waiting
+    within_budget_ = recent.count < kMinSamples || beyond <= budget_ms_ * kRecoverFraction ?
+        within_budget_ + 1 : 0;
+    if (within_budget_ >= kRecoverChecks)
+        Change_(false, recent.count < kMinSamples ? juce::String{"traffic subsided"} :
+            measured + " within " + juce::String(budget_ms_, 1) + " ms budget");
+}
+
+void LatencyWatchdog::Change_(bool degraded, const juce::String& cause)
+{
+    over_budget_ = 0;
+    within_budget_ = 0;
+    degraded_.store(degraded, std::memory_order_relaxed);
+    if (const auto ptr = lr_ipc_out_.lock())
+        if (degraded_interval_ != coalesce_interval_)
+            ptr->SetCoalesceInterval(degraded ? degraded_interval_ : coalesce_interval_);
+    if (const auto ptr = lr_ipc_in_.lock())
+        ptr->SetSkipRefreshFeedback(degraded);
+    const auto entry = juce::Time::getCurrentTime().toString(true, true) +
+        (degraded ? " degraded: " : " normal: ") + cause;
+    DBG("LatencyWatchdog: " + entry);
+    {
+        std::lock_guard<decltype(mutex_)> lock(mutex_);
+        cause_ = cause;
+        transitions_.push_back(entry);
+        if (transitions_.size() > kMaxTransitions)
+            transitions_.pop_front();
+    }
+    callbacks_.Publish(degraded);
+}
+
+juce::String LatencyWatchdog::getCause() const
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    return cause_;
+}
+
+juce::String LatencyWatchdog::Report() const
+{
+    juce::String report{"latency watchdog, value\n"};
+    report << "state, " << (budget_ms_ <= 0.0 ? "off" : IsDegraded() ? "degraded" : "normal")
+        << "\n" << "budget p99 ms, " << juce::String(budget_ms_, 1) << "\n";
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    for (const auto& transition : transitions_)
+        report << "transition, " << transition << "\n";
+    return report;
+}
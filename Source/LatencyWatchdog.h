@@ -0,0 +1,92 @@
+#pragma once
+/*
+  ==============================================================================
+
+    LatencyWatchdog.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_LATENCYWATCHDOG_H_INCLUDED
+#define MIDI2LR_LATENCYWATCHDOG_H_INCLUDED
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "EventChannel.h"
+#include "Scheduler.h"
+class LR_IPC_IN;
+class LR_IPC_OUT;
+class MIDIProcessor;
+
+// Checks the latency from MIDI arrival to the socket each second against a budget.
+// While it is over budget the pipeline runs degraded: values coalesce over a longer
+// interval, photo-change refreshes aren't fed back to the controller and subscribers
+// (the main window) pause their updates. Normal running resumes once latency has
+// stayed well inside the budget for a few seconds
+class LatencyWatchdog {
+public:
+    explicit LatencyWatchdog(Scheduler* const scheduler);
+    ~LatencyWatchdog();
+    LatencyWatchdog(const LatencyWatchdog&) = delete;
+    LatencyWatchdog& operator=(const LatencyWatchdog&) = delete;
+    // budget_ms applies to p99 latency beyond the coalesce interval in use, 0 turns
+    // the watchdog off. Message thread
+    void Init(std::weak_ptr<MIDIProcessor>&& midi_processor,
+        std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out, std::weak_ptr<LR_IPC_IN>&& lr_ipc_in,
+        double budget_ms, int coalesce_interval, int degraded_coalesce_interval);
+    // no more checks or callbacks after this returns, call before subscribers go
+    void Stop();
+    // no checks while idle, as nothing flows to measure. Message thread
+    void SetIdle(bool idle);
+
+    // told true on entering degraded running and false on leaving it, from the
+    // scheduler's thread unless delivered elsewhere
+    template<class T, void(T::*MF)(bool)>
+    void addCallback(T* const object, Delivery delivery = Delivery::immediate)
+    {
+        callbacks_.Subscribe<T, MF>(object, delivery);
+    }
+    bool IsDegraded() const noexcept
+    {
+        return degraded_.load(std::memory_order_relaxed);
+    }
+    juce::String getCause() const; //of the latest change. Any thread
+    juce::String Report() const;
+
+private:
+    void Check_(); //scheduler thread
+    void Change_(bool degraded, const juce::String& cause);
+    constexpr static size_t kMaxCallbacks = 4;
+    Scheduler* const scheduler_;
+    Scheduler::TaskId check_task_{0};
+    std::weak_ptr<MIDIProcessor> midi_processor_;
+    std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
+    std::weak_ptr<LR_IPC_IN> lr_ipc_in_;
+    double budget_ms_{0.0};
+    int coalesce_interval_{0};
+    int degraded_interval_{0};
+    int over_budget_{0}; //consecutive checks, scheduler thread only
+    int within_budget_{0}; //consecutive checks, scheduler thread only
+    std::atomic<bool> degraded_{false};
+    mutable std::mutex mutex_; //guards cause_ and transitions_
+    juce::String cause_;
+    std::deque<juce::String> transitions_; //latest, oldest first
+    EventChannel<kMaxCallbacks, bool> callbacks_{"latency watchdog"};
+};
+
+#endif  // LATENCYWATCHDOG_H_INCLUDED
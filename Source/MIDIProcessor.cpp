@@ -21,60 +21,491 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "MIDIProcessor.h"
-#include "MidiUtilities.h"
+#include <vector>
+#include <gsl/gsl>
+#include "CommandMap.h"
+#include "ControlsModel.h"
+#include "Instrumentation.h"
+#include "MidiThru.h"
+#include "PipelineTrace.h"
+#include "PowerMonitor.h"
+#include "ThreadStats.h"
 
-MIDIProcessor::MIDIProcessor() noexcept
+namespace {
+    constexpr size_t kDispatchBatch = 64; //messages taken from the ingress queue at once
+    constexpr int kStopWait = 1000;
+
+    // only the message types dispatch acts on; clock, active sensing, aftertouch, program
+    // change (unless taken as bank changes) and SysEx are dropped on arrival without
+    // building a message
+    constexpr bool Wanted(unsigned char status) noexcept
+    {
+        return (status >> 4) == RSJ::kCCFlag || (status >> 4) == RSJ::kNoteOnFlag ||
+            (status >> 4) == RSJ::kNoteOffFlag || (status >> 4) == RSJ::kPWFlag;
+    }
+}
+
+class MIDIProcessor::DispatchShard final: public juce::Thread {
+public:
+    DispatchShard(MIDIProcessor& owner, int index):
+        juce::Thread{"MIDIProcessor shard " + juce::String(index)}, owner_{owner}
+    {}
+    ~DispatchShard()
+    {
+        signalThreadShouldExit();
+        queue.wake();
+        stopThread(kStopWait);
+    }
+    DispatchShard(const DispatchShard&) = delete;
+    DispatchShard& operator=(const DispatchShard&) = delete;
+    IngressQueue queue;
+
+private:
+    void run() override
+    {
+        owner_.Drain_(queue, *this);
+    }
+    MIDIProcessor& owner_;
+};
+
+MIDIProcessor::MIDIProcessor(const CommandMap* const command_map,
+    ControlsModel* const c_model) noexcept: juce::Thread{"MIDIProcessor"},
+    command_map_{command_map}, controls_model_{c_model}
 {}
 
 MIDIProcessor::~MIDIProcessor()
-{}
+{
+    juce::Timer::stopTimer();
+    replay_.reset();
+    recorder_.Stop();
+    for (auto& slot : inputs_)
+        CloseDevice_(slot);
+    shards_.clear(); //stops them
+    juce::Thread::signalThreadShouldExit();
+    ingress_.wake();
+    juce::Thread::stopThread(kStopWait);
+}
+
+void MIDIProcessor::Init(bool dispatch_thread, bool open_devices)
+{
+    dispatch_thread_ = dispatch_thread;
+    // configured once here: the filters may be in use by other threads later
+    for (auto& slot : inputs_)
+        for (short channel = 0; channel < 16; ++channel) {
+            if (nrpn_msb_channels_ & (1 << channel))
+                slot.nrpn_filter.SetCompletion(channel, RSJ::NrpnCompletion::on_msb,
+                    nrpn_lsb_window_);
+            slot.cc14_filter.SetControllers(channel, cc14_controllers_[static_cast<size_t>(channel)]);
+        }
+    if (dispatch_thread_ && shard_count_ > 1) {
+        for (auto i = 0; i < shard_count_; ++i)
+            shards_.push_back(std::make_unique<DispatchShard>(*this, i));
+        for (auto& shard : shards_)
+            shard->startThread();
+    }
+    else if (dispatch_thread_)
+        juce::Thread::startThread();
+    if (open_devices)
+        RescanDevices();
+}
+
+void MIDIProcessor::SetThreadPriority(const RSJ::ThreadPriority& priority) noexcept
+{
+    thread_priority_ = priority;
+}
+
+void MIDIProcessor::SetDispatchShards(int shards) noexcept
+{
+    shard_count_ = shards;
+}
+
+void MIDIProcessor::SetBackend(RSJ::MidiBackend backend, int rtmidi_api) noexcept
+{
+#ifdef MIDI2LR_RTMIDI
+    backend_ = backend;
+    rtmidi_api_ = static_cast<RtMidi::Api>(rtmidi_api);
+#else
+    (void)backend; //JUCE only
+    (void)rtmidi_api;
+#endif
+}
 
-void MIDIProcessor::Init()
+void MIDIProcessor::SetThru(MidiThru* thru) noexcept
 {
-    InitDevices_();
+    thru_ = thru;
 }
 
-void MIDIProcessor::handleIncomingMidiMessage(juce::MidiInput * /*device*/,
+void MIDIProcessor::SetCC14Controllers(short channel, juce::uint32 controllers) noexcept(ndebug)
+{
+    Expects(channel <= 15 && channel >= 0);
+    cc14_controllers_[static_cast<size_t>(channel)] = controllers;
+}
+
+void MIDIProcessor::SetDevicePollInterval(int interval)
+{
+    if (interval > 0)
+        juce::Timer::startTimer(interval);
+    else
+        juce::Timer::stopTimer();
+}
+
+void MIDIProcessor::timerCallback()
+{
+    PowerMonitor::CountWakeUp();
+    RescanDevices();
+}
+
+void MIDIProcessor::SetNrpnCompletion(int msb_channels, int lsb_window) noexcept
+{
+    nrpn_msb_channels_ = msb_channels;
+    nrpn_lsb_window_ = lsb_window;
+}
+
+void MIDIProcessor::SetBankChanges(bool enabled) noexcept
+{
+    bank_changes_ = enabled;
+}
+
+bool MIDIProcessor::Wanted_(unsigned char status) const noexcept
+{
+    return Wanted(status) || (bank_changes_ && (status >> 4) == RSJ::kPgmChangeFlag);
+}
+
+void MIDIProcessor::handleIncomingMidiMessage(juce::MidiInput * device,
     const juce::MidiMessage& message)
 {
-    const RSJ::MidiMessage mess{message};
+    ThreadStats::Register("MIDI input"); //the driver's thread, once
+    const auto wanted = message.getRawDataSize() >= 1 && Wanted_(message.getRawData()[0]);
+    if (!wanted && !thru_)
+        return;
+    for (auto& slot : inputs_)
+        if (slot.active.load(std::memory_order_acquire) == device) {
+            if (slot.thru.load(std::memory_order_relaxed))
+                thru_->Send(message); //everything, including what MIDI2LR ignores
+            if (wanted)
+                ReceiveRaw_(slot, message.getRawData(),
+                    static_cast<size_t>(message.getRawDataSize()));
+            return;
+        }
+}
+
+#ifdef MIDI2LR_RTMIDI
+void MIDIProcessor::RtMidiCallback_(double /*time_stamp*/, std::vector<unsigned char>* message,
+    void* slot)
+{
+    if (!message || message->empty() || !slot)
+        return;
+    auto& input = *static_cast<InputSlot*>(slot);
+    if (input.thru.load(std::memory_order_relaxed))
+        input.owner->thru_->Send(message->data(), message->size());
+    if (input.owner->Wanted_(message->front()))
+        input.owner->ReceiveRaw_(input, message->data(), message->size());
+}
+#endif
+
+void MIDIProcessor::ReceiveRaw_(InputSlot& slot, const juce::uint8* bytes, size_t size)
+{
+    const auto arrival = juce::Time::getMillisecondCounterHiRes();
+    RSJ::DecodeMidi(bytes, size, [this, &slot, arrival](const RSJ::MidiMessage& message) {
+        if (Wanted_(static_cast<unsigned char>(message.message_type_byte << 4)))
+            Receive_(slot, message, arrival);
+    });
+}
+
+void MIDIProcessor::Receive_(InputSlot& slot, const RSJ::MidiMessage& message, double arrival)
+{
+    const TraceScope trace{"MIDI arrival"};
+    if (message.message_type_byte == RSJ::kPgmChangeFlag) { //only let in for bank changes
+        auto bank = message;
+        bank.device = gsl::narrow_cast<short>(&slot - inputs_.data());
+        bank_callbacks_.Publish(bank);
+        return;
+    }
+    if (arrival == 0.0)
+        arrival = juce::Time::getMillisecondCounterHiRes();
+    activity_stats_.Record(message);
+    startup_trace_.FirstMessage();
+    auto mess = message;
+    mess.device = gsl::narrow_cast<short>(&slot - inputs_.data());
+    mess.source = slot.source.load(std::memory_order_relaxed);
+    recorder_.Record(mess);
+    if (!dispatch_thread_)
+        DispatchMessage_(mess, slot, arrival);
+    else {
+        // driver thread: queue and return as quickly as possible. Device and channel
+        // pick the shard, so NRPN and 14-bit assembly keep one writer per channel; 17
+        // spreads both many channels of one device and one channel of many devices
+        auto& queue = shards_.empty() ? ingress_ : shards_[(static_cast<size_t>(mess.device) *
+            17 + static_cast<size_t>(mess.channel)) % shards_.size()]->queue;
+        if (!queue.try_push({mess, arrival}))
+            dropped_messages_.fetch_add(1, std::memory_order_relaxed);
+    }
+}
+
+void MIDIProcessor::Inject(const RSJ::MidiMessage& message)
+{
+    const auto device = message.device >= 0 && static_cast<size_t>(message.device) < kMaxDevices ?
+        static_cast<size_t>(message.device) : 0;
+    Receive_(inputs_[device], message);
+}
+
+bool MIDIProcessor::Replay(const juce::File& capture, bool fast,
+    std::function<void(const juce::String&)> done)
+{
+    std::vector<CapturedMessage> messages;
+    if (!MidiRecorder::Load(capture, messages))
+        return false;
+    replay_.reset(); //stops any replay in progress
+    replay_ = std::make_unique<MidiReplay>(*this, std::move(messages), fast, std::move(done));
+    return true;
+}
+
+void MIDIProcessor::run()
+{
+    Drain_(ingress_, *this);
+}
+
+void MIDIProcessor::Drain_(IngressQueue& queue, const juce::Thread& thread)
+{
+    RSJ::RaiseCurrentThread(thread_priority_);
+    const ThreadAccount account{"MIDI dispatch"};
+    std::array<TimedMessage, kDispatchBatch> batch;
+    while (!thread.threadShouldExit()) {
+        const auto count = queue.wait_pop_bulk(batch); //woken on exit
+        ThreadStats::CountWakeUp();
+        ThreadStats::CountMessages(count);
+        for (size_t i = 0; i < count; ++i)
+            DispatchMessage_(batch[i].message, inputs_[static_cast<size_t>(batch[i].message.device)],
+                batch[i].time_stamp);
+    }
+}
+
+void MIDIProcessor::DispatchMessage_(const RSJ::MidiMessage& mess, InputSlot& slot,
+    double time_stamp)
+{
+    static auto& allocations = Instrumentation::Counter("allocations in MIDI dispatch");
+    const AllocationScope scope{allocations};
+    latency_stats_.Record(LatencyStats::kDispatch, time_stamp);
     switch (mess.message_type_byte) {
     case RSJ::kCCFlag:
-        if (nrpn_filter_.ProcessMidi(mess.channel, mess.number, mess.value)) { //true if nrpn piece
-            const auto nrpn = nrpn_filter_.GetNRPNifReady(mess.channel);
-            if (nrpn.isValid) //send when finished
-                for (const auto& cb : callbacks_)
-                    cb(RSJ::MidiMessage{RSJ::kCCFlag, mess.channel, nrpn.control, nrpn.value});
+    {
+        RSJ::NRPN nrpn;
+        const auto publish_assembled = [&] {
+            RSJ::MidiMessage assembled{RSJ::kCCFlag, mess.channel, nrpn.control, nrpn.value};
+            assembled.device = mess.device;
+            Publish_(assembled, time_stamp);
+        };
+        const auto piece = [&] { //true if nrpn or 14-bit piece
+            const TraceScope trace{"NRPN assembly"};
+            return slot.nrpn_filter.ProcessMidi(mess.channel, mess.number, mess.value, nrpn) ||
+                slot.cc14_filter.ProcessMidi(mess.channel, mess.number, mess.value, nrpn);
+        }();
+        if (piece) {
+            // send when finished. A relative control waits for the LSB refining an
+            // early MSB, as each value it sends is a step
+            if (nrpn.isValid && !(nrpn.partial && controls_model_ &&
+                controls_model_->getCCmethod(static_cast<size_t>(mess.channel), nrpn.control) !=
+                RSJ::CCmethod::absolute))
+                publish_assembled();
         }
         else //regular message
-            for (const auto& cb : callbacks_)
-                cb(mess);
+            Publish_(mess, time_stamp);
         break;
+    }
     case RSJ::kNoteOnFlag:
     case RSJ::kPWFlag:
-        for (const auto& cb : callbacks_)
-            cb(mess);
+    case RSJ::kNoteOffFlag: //only reaches modifiers, see Publish_
+        Publish_(mess, time_stamp);
         break;
     default:
         ; //no action if other type of MIDI message
     }
 }
 
+void MIDIProcessor::Publish_(const RSJ::MidiMessage& mess, double time_stamp)
+{
+    // a Note Off only matters as the release of a held modifier
+    const auto release = mess.message_type_byte == RSJ::kNoteOffFlag;
+    // pots wobbling within their deadband go no further, not even to learning
+    if (controls_model_ && controls_model_->Jittered(mess))
+        return;
+    // a hand on a motor fader is no button: not learned, mapped or counted as a move
+    if (controls_model_ && controls_model_->TouchedFader(mess) >= 0) {
+        touch_callbacks_.Publish(mess);
+        return;
+    }
+    if (!release)
+        callbacks_.Publish(mess); //learning in MainContentComponent sees everything
+    if (!command_map_ || !controls_model_)
+        return;
+    RSJ::ResolvedMessage resolved{mess};
+    {
+        const TraceScope trace{"CommandMap lookup"};
+        // messages that aren't mapped to a command stop here. The command map's id
+        // table already answers that in one lookup, so they cost no conversion or fan-out
+        // the told-apart device's own mapping, else the one for any device
+        const auto message = command_map_->getMappedKey(RSJ::MidiMessageId{mess});
+        const auto id = command_map_->getExactCommandId(message);
+        if (id == CommandMap::kNoCommand)
+            return;
+        const auto flags = CommandMap::getCommandFlags(id);
+        if ((flags & RSJ::kCommandUnmapped) || (release && !CommandMap::getCommandModifier(id)))
+            return;
+        // look up and convert once: ControllerToPlugin advances relative controls, so
+        // calling it per subscriber would apply the same movement several times
+        resolved.time_stamp = time_stamp;
+        resolved.command = &CommandMap::getCommandString(id);
+        resolved.command_id = id;
+        resolved.command_flags = flags;
+        resolved.value = controls_model_->ControllerToPlugin(mess);
+        const auto targets = command_map_->getMacroTargets(message);
+        resolved.targets = targets.data();
+        resolved.target_count = static_cast<size_t>(targets.size());
+        resolved.targets_owner = targets.owner();
+    }
+    latency_stats_.Record(LatencyStats::kConversion, time_stamp);
+    resolved_callbacks_.Publish(resolved);
+}
+
+juce::String MIDIProcessor::getInputName(short device) const
+{
+    if (device < 0 || static_cast<size_t>(device) >= kMaxDevices)
+        return {};
+    std::lock_guard<decltype(names_mutex_)> lock(names_mutex_);
+    return inputs_[static_cast<size_t>(device)].name;
+}
+
 void MIDIProcessor::RescanDevices()
 {
-    for (const auto& dev : devices_)
-        dev->stop();
-    devices_.clear();
-    InitDevices_();
+    const auto listed = GetDeviceNames_();
+    const auto names = RSJ::DeviceIdentifiers(listed);
+    std::vector<bool> present(static_cast<size_t>(names.size()), false);
+    // keep devices still listed (names may repeat, so match each entry once)
+    for (auto& slot : inputs_) {
+        if (!slot.IsOpen() || slot.external)
+            continue;
+        auto found = false;
+        for (auto idx = 0; idx < names.size() && !found; ++idx)
+            if (!present[static_cast<size_t>(idx)] && names[idx] == slot.name) {
+                present[static_cast<size_t>(idx)] = true;
+                found = true;
+            }
+        if (!found)
+            CloseDevice_(slot);
+    }
+    // the thru port, if it is listed, would loop copies back in
+    for (auto idx = 0; idx < names.size(); ++idx)
+        if (!present[static_cast<size_t>(idx)] && !(thru_ && thru_->IsOpen() &&
+            listed[idx] == thru_->PortName()))
+            OpenDevice_(idx, names[idx]);
+    // inputs sharing a name are told apart by identifier; the rest map as any device
+    for (auto& slot : inputs_) {
+        if (!slot.IsOpen() || slot.external)
+            continue;
+        juce::String name;
+        {
+            std::lock_guard<decltype(names_mutex_)> lock(names_mutex_);
+            name = slot.name;
+        }
+        const auto idx = names.indexOf(name);
+        const auto shared = idx >= 0 && (name != listed[idx] || names.contains(name + "#2"));
+        slot.source.store(shared ? RSJ::DeviceIndex(name) : short{0}, std::memory_order_relaxed);
+    }
+}
+
+void MIDIProcessor::OpenDevice_(int index, const juce::String& name)
+{
+    for (auto& slot : inputs_)
+        if (!slot.IsOpen()) {
+#ifdef MIDI2LR_RTMIDI
+            if (backend_ == RSJ::MidiBackend::rtmidi) {
+                try {
+                    auto dev = std::make_unique<RtMidiIn>(rtmidi_api_, "MIDI2LR");
+                    slot.owner = this;
+                    dev->setCallback(&MIDIProcessor::RtMidiCallback_, &slot);
+                    // sysex, timing and active sensing, unless copied thru
+                    const auto thru = thru_ && thru_->Wants(name);
+                    dev->ignoreTypes(!thru, !thru, !thru);
+                    slot.thru.store(thru, std::memory_order_relaxed);
+                    dev->openPort(gsl::narrow_cast<unsigned int>(index));
+                    slot.rt_device = std::move(dev);
+                    std::lock_guard<decltype(names_mutex_)> lock(names_mutex_);
+                    slot.name = name;
+                }
+                catch (const RtMidiError& e) {
+                    DBG("MIDIProcessor: unable to open " + name + ": " + e.getMessage());
+                }
+                return;
+            }
+#endif
+            slot.device.reset(juce::MidiInput::openDevice(index, this));
+            if (slot.device) {
+                slot.thru.store(thru_ && thru_->Wants(name), std::memory_order_relaxed);
+                {
+                    std::lock_guard<decltype(names_mutex_)> lock(names_mutex_);
+                    slot.name = name;
+                }
+                slot.active.store(slot.device.get(), std::memory_order_release);
+                slot.device->start();
+            }
+            return;
+        }
+    DBG("MIDIProcessor: no free slot for MIDI input " + name);
+}
+
+std::function<void(const RSJ::MidiMessage&)> MIDIProcessor::OpenExternalInput(
+    const juce::String& name)
+{
+    for (auto& slot : inputs_)
+        if (!slot.IsOpen()) {
+            slot.external = true;
+            {
+                std::lock_guard<decltype(names_mutex_)> lock(names_mutex_);
+                slot.name = name;
+            }
+            return [this, &slot](const RSJ::MidiMessage& message) { Receive_(slot, message); };
+        }
+    DBG("MIDIProcessor: no free slot for MIDI input " + name);
+    return {};
+}
+
+void MIDIProcessor::CloseDevice_(InputSlot& slot)
+{
+    slot.thru.store(false, std::memory_order_relaxed);
+#ifdef MIDI2LR_RTMIDI
+    if (slot.rt_device) {
+        slot.rt_device->closePort(); //waits for a running callback
+        slot.rt_device.reset();
+        std::lock_guard<decltype(names_mutex_)> lock(names_mutex_);
+        slot.name.clear();
+    }
+#endif
+    if (slot.device) {
+        slot.active.store(nullptr, std::memory_order_release);
+        slot.device->stop();
+        slot.device.reset();
+        std::lock_guard<decltype(names_mutex_)> lock(names_mutex_);
+        slot.name.clear();
+    }
 }
 
-void MIDIProcessor::InitDevices_()
+juce::StringArray MIDIProcessor::GetDeviceNames_()
 {
-    for (auto idx = 0; idx < juce::MidiInput::getDevices().size(); ++idx) {
-        const auto dev = juce::MidiInput::openDevice(idx, this);
-        if (dev != nullptr) {
-            devices_.emplace_back(dev);
-            dev->start();
+#ifdef MIDI2LR_RTMIDI
+    if (backend_ == RSJ::MidiBackend::rtmidi) {
+        juce::StringArray names;
+        try {
+            if (!rt_probe_)
+                rt_probe_ = std::make_unique<RtMidiIn>(rtmidi_api_, "MIDI2LR probe");
+            const auto count = rt_probe_->getPortCount();
+            for (unsigned int port = 0; port < count; ++port)
+                names.add(rt_probe_->getPortName(port));
+        }
+        catch (const RtMidiError& e) {
+            DBG("MIDIProcessor: unable to list RtMidi ports: " + e.getMessage());
         }
+        return names;
     }
+#endif
+    return juce::MidiInput::getDevices();
 }
\ No newline at end of file
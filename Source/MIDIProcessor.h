@@ -21,38 +21,245 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #ifndef MIDI2LR_MIDIPROCESSOR_H_INCLUDED
 #define MIDI2LR_MIDIPROCESSOR_H_INCLUDED
+#include <array>
+#include <atomic>
 #include <functional>
 #include <memory>
+#include <mutex>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "EventChannel.h"
+#include "LatencyStats.h"
+#include "MidiRecorder.h"
+#include "MidiUtilities.h"
 #include "NrpnMessage.h"
-namespace RSJ {
-    struct MidiMessage;
-}
+#include "ThreadPriority.h"
+#include "Utilities/Utilities.h"
+#ifdef MIDI2LR_RTMIDI
+#include "../rtmidi/RtMidi.h"
+#endif
+class CommandMap;
+class ControlsModel;
+class MidiThru;
 
-class MIDIProcessor final: private juce::MidiInputCallback {
+class MIDIProcessor final: private juce::MidiInputCallback, private juce::Thread,
+    private juce::Timer {
 public:
-    MIDIProcessor() noexcept;
+    MIDIProcessor(const CommandMap* const command_map, ControlsModel* const c_model) noexcept;
     virtual ~MIDIProcessor();
-    void Init();
+    // if dispatch_thread is true, the MIDI driver callback only queues messages
+    // and a dedicated thread runs the callbacks. Without open_devices only Inject and
+    // external inputs feed it, as in benchmarks
+    void Init(bool dispatch_thread = false, bool open_devices = true);
 
-    // re-enumerates MIDI IN devices
+    // channels whose bit is set in msb_channels complete NRPN messages on the value
+    // MSB, refined by an LSB arriving within lsb_window ms. Call before Init
+    void SetNrpnCompletion(int msb_channels, int lsb_window) noexcept;
+
+    // bit n of controllers set: CC n and CC n+32 on channel (0-based) are merged
+    // into one 14-bit value. Call before Init
+    void SetCC14Controllers(short channel, juce::uint32 controllers) noexcept(ndebug);
+
+    // rtmidi_api is an RtMidi::Api value, 0 picks the first one compiled. Call
+    // before Init
+    void SetBackend(RSJ::MidiBackend backend, int rtmidi_api) noexcept;
+
+    // how the dispatch thread runs. Driver callback threads are left as the driver
+    // made them. Call before Init
+    void SetThreadPriority(const RSJ::ThreadPriority& priority) noexcept;
+
+    // with the dispatch thread, more than one shard spreads dispatch over that many
+    // threads by device and channel, for several busy controllers at once. A control
+    // always lands on the same shard, so its messages stay in order. Call before Init
+    void SetDispatchShards(int shards) noexcept;
+
+    // program changes, otherwise dropped on arrival, go to the bank callbacks instead
+    // of dispatch. Call before Init
+    void SetBankChanges(bool enabled) noexcept;
+
+    // inputs thru wants are copied to it raw, as they arrive. thru must outlive this.
+    // Call before Init
+    void SetThru(MidiThru* thru) noexcept;
+
+    // re-enumerates MIDI IN devices, opening new ones and closing vanished ones.
+    // Devices still present keep running
     void RescanDevices();
 
-    template <class T> void addCallback(T* const object, void (T::* const mf)(RSJ::MidiMessage))
+    // rescan every interval ms; 0 stops polling
+    void SetDevicePollInterval(int interval);
+
+    // an input that isn't a driver device, such as an RtpMidiSession, shown as name.
+    // Its messages go through the returned function, on one thread at a time. Empty if
+    // no input is free. Message thread
+    std::function<void(const RSJ::MidiMessage&)> OpenExternalInput(const juce::String& name);
+
+    // name of the input a message's device refers to, empty if it has closed. Any thread
+    juce::String getInputName(short device) const;
+
+    template <class T, void (T::*MF)(RSJ::MidiMessage)>
+    void addCallback(T* const object, Delivery delivery = Delivery::immediate)
     {
-        callbacks_.emplace_back(std::bind(mf, object, std::placeholders::_1));
+        callbacks_.Subscribe<T, MF>(object, delivery);
+    }
+
+    // subscribers to program changes, when SetBankChanges enabled them
+    template <class T, void (T::*MF)(RSJ::MidiMessage)>
+    void addBankCallback(T* const object, Delivery delivery = Delivery::immediate)
+    {
+        bank_callbacks_.Subscribe<T, MF>(object, delivery);
+    }
+
+    // subscribers to the touch notes of motor faders (ControlsModel::TouchedFader),
+    // presses and releases, which go nowhere else
+    template <class T, void (T::*MF)(RSJ::MidiMessage)>
+    void addTouchCallback(T* const object, Delivery delivery = Delivery::immediate)
+    {
+        touch_callbacks_.Subscribe<T, MF>(object, delivery);
+    }
+
+    // subscribers to messages already looked up in the command map and converted
+    // to plugin values. Only messages mapped to a command other than Unmapped reach them
+    template <class T, void (T::*MF)(const RSJ::ResolvedMessage&)>
+    void addResolvedCallback(T* const object, Delivery delivery = Delivery::immediate)
+    {
+        resolved_callbacks_.Subscribe<T, MF>(object, delivery);
+    }
+
+    // arrival-to-stage latencies, shared with LR_IPC_OUT
+    LatencyStats& getLatencyStats() noexcept
+    {
+        return latency_stats_;
+    }
+
+    // messages received per channel and control, before NRPN or 14-bit assembly
+    const ActivityStats& getActivityStats() const noexcept
+    {
+        return activity_stats_;
+    }
+    // restarts the latency and activity counts. Any thread
+    void ResetStats() noexcept
+    {
+        latency_stats_.Reset();
+        activity_stats_.Reset();
+    }
+
+    // start-up phases, recorded by the application; this notes the first message
+    StartupTrace& getStartupTrace() noexcept
+    {
+        return startup_trace_;
+    }
+
+    // records what arrives from devices, see MidiRecorder
+    MidiRecorder& getRecorder() noexcept
+    {
+        return recorder_;
+    }
+
+    // feeds message through the pipeline as if it arrived from its device. Any thread
+    void Inject(const RSJ::MidiMessage& message);
+
+    // replays a MidiRecorder capture, see MidiReplay. False if it can't be read.
+    // Message thread
+    bool Replay(const juce::File& capture, bool fast, std::function<void(const juce::String&)> done);
+
+    // number of messages discarded because the ingress queue was full
+    int getDroppedMessageCount() const noexcept
+    {
+        return dropped_messages_.load(std::memory_order_relaxed);
     }
 
 private:
+    struct TimedMessage {
+        RSJ::MidiMessage message;
+        double time_stamp{0.0}; //juce::Time::getMillisecondCounterHiRes at arrival
+    };
+    constexpr static size_t kIngressCapacity = 4096;
+    using IngressQueue = RSJ::mpsc_queue<TimedMessage, kIngressCapacity>;
+    class DispatchShard; //a dispatch thread with its own queue
+    constexpr static size_t kMaxCallbacks = 8;
+    constexpr static size_t kMaxDevices = 16;
+    // slots are never moved or freed while running, so device callback threads and
+    // the dispatch thread can use them while other devices are opened or closed
+    struct InputSlot {
+        std::unique_ptr<juce::MidiInput> device;
+        std::atomic<juce::MidiInput*> active{nullptr}; //set while device is running
+#ifdef MIDI2LR_RTMIDI
+        std::unique_ptr<RtMidiIn> rt_device;
+        MIDIProcessor* owner{nullptr};
+#endif
+        juce::String name;
+        NRPN_Filter nrpn_filter; //single writer: device thread or dispatch thread
+        CC14_Filter cc14_filter; //as nrpn_filter
+        bool external{false}; //fed by OpenExternalInput's function, kept by rescans
+        std::atomic<short> source{0}; //RSJ::DeviceIndex while another input has its name
+        std::atomic<bool> thru{false}; //copied to thru_ before filtering
+        bool IsOpen() const noexcept
+        {
+            if (external)
+                return true;
+#ifdef MIDI2LR_RTMIDI
+            if (rt_device)
+                return true;
+#endif
+            return device != nullptr;
+        }
+    };
+
     // overridden from MidiInputCallback
     void handleIncomingMidiMessage(juce::MidiInput*, const juce::MidiMessage&) override;
+    // Thread interface
+    void run() override;
+    // dispatches what arrives in queue until thread is told to exit
+    void Drain_(IngressQueue& queue, const juce::Thread& thread);
+    // Timer interface
+    void timerCallback() override;
 
-    void InitDevices_();
+#ifdef MIDI2LR_RTMIDI
+    static void RtMidiCallback_(double time_stamp, std::vector<unsigned char>* message,
+        void* slot);
+#endif
+    bool Wanted_(unsigned char status) const noexcept;
+    // arrival is juce::Time::getMillisecondCounterHiRes, 0 for now
+    void Receive_(InputSlot& slot, const RSJ::MidiMessage& mess, double arrival = 0.0);
+    // a backend's packet straight from its bytes, without building juce::MidiMessages.
+    // Every message in it shares the packet's arrival
+    void ReceiveRaw_(InputSlot& slot, const juce::uint8* bytes, size_t size);
+    void DispatchMessage_(const RSJ::MidiMessage& mess, InputSlot& slot, double time_stamp);
+    void Publish_(const RSJ::MidiMessage& mess, double time_stamp);
+    void OpenDevice_(int index, const juce::String& name);
+    void CloseDevice_(InputSlot& slot);
 
-    NRPN_Filter nrpn_filter_;
-    std::vector <std::function <void(RSJ::MidiMessage)>> callbacks_;
-    std::vector <std::unique_ptr<juce::MidiInput>> devices_;
+    juce::StringArray GetDeviceNames_();
+    RSJ::MidiBackend backend_{RSJ::MidiBackend::juce};
+    bool dispatch_thread_{false};
+    bool bank_changes_{false};
+    int shard_count_{0};
+    RSJ::ThreadPriority thread_priority_{};
+    MidiThru* thru_{nullptr};
+    int nrpn_msb_channels_{0};
+    int nrpn_lsb_window_{0};
+    std::array<juce::uint32, 16> cc14_controllers_{};
+    const CommandMap* const command_map_;
+    ControlsModel* const controls_model_;
+    std::atomic<int> dropped_messages_{0};
+    LatencyStats latency_stats_;
+    ActivityStats activity_stats_;
+    StartupTrace startup_trace_;
+    EventChannel<kMaxCallbacks, RSJ::MidiMessage> callbacks_{"MIDI messages"};
+    EventChannel<kMaxCallbacks, const RSJ::ResolvedMessage&> resolved_callbacks_{"resolved MIDI"};
+    EventChannel<kMaxCallbacks, RSJ::MidiMessage> bank_callbacks_{"bank changes"};
+    EventChannel<kMaxCallbacks, RSJ::MidiMessage> touch_callbacks_{"fader touches"};
+    std::array<InputSlot, kMaxDevices> inputs_;
+    //one producer per device callback thread, arrival order kept across devices
+    IngressQueue ingress_;
+    std::vector<std::unique_ptr<DispatchShard>> shards_; //used instead of ingress_ if any
+    MidiRecorder recorder_;
+    std::unique_ptr<MidiReplay> replay_;
+    mutable std::mutex names_mutex_; //InputSlot::name, written on the message thread
+#ifdef MIDI2LR_RTMIDI
+    RtMidi::Api rtmidi_api_{RtMidi::UNSPECIFIED};
+    std::unique_ptr<RtMidiIn> rt_probe_; //port enumeration only
+#endif
 };
 
 #endif  // MIDIPROCESSOR_H_INCLUDED
@@ -21,63 +21,652 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "MIDISender.h"
-#include <gsl/gsl>
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <unordered_map>
+#include <utility>
+#include "Instrumentation.h"
+#include "MidiThru.h"
+#include "PipelineTrace.h"
+#include "PowerMonitor.h"
+#include "RtpMidi.h"
+#include "ThreadStats.h"
 
-MIDISender::MIDISender() noexcept
-{}
+namespace {
+    constexpr size_t kMaxBatch = 4096; //messages held before a batch is sent anyway
+    constexpr size_t kMaxQueue = 4096; //groups waiting for one device
+    constexpr size_t kMaxGroup = 4; //an NRPN
+    constexpr int kStopWait = 1000;
+    constexpr int kBurstTime = 50; //ms of a device's byte rate that may go out at once
+    constexpr double kMinBurst = 12.0; //bytes, so an NRPN always fits
+    constexpr juce::uint32 kRunningRefresh = 1000; //ms before an unchanged NRPN number or MSB is resent
+    constexpr int kCC14Controls = 32; //CC n pairs with LSB on CC n + 32
+    constexpr int kNrpnMsb = 99;
+    constexpr int kNrpnLsb = 98;
+    constexpr int kRpnLsb = 100;
+    constexpr int kRpnMsb = 101;
+    constexpr short kNoParameter = -1;
+}
+
+// owns one device and writes its queue, so sendMessageNow blocking on a slow
+// interface holds up only that device. The device is opened by this thread when it
+// first has something to send, so outputs nothing sends to are never opened. The
+// queue holds whole groups, and a group for a control that is already waiting
+// replaces it in place, so the device gets the latest value without the backlog
+// growing. With a byte rate set, groups are paced to it. When the queue is still
+// full the oldest groups are dropped. SysEx uploads wait in a queue of their own and
+// go out whenever no group is waiting
+class MIDISender::OutputWorker final: private juce::Thread, RSJ::counter<OutputWorker> {
+public:
+    OutputWorker(const MIDISender& sender, const juce::String& name, int index,
+        int bytes_per_second, const SurfaceDriver* driver,
+        std::shared_ptr<RtpMidiSession> network = nullptr):
+        juce::Thread{"MIDI OUT " + name}, sender_(sender), driver_{driver}, index_{index},
+        bytes_per_ms_{bytes_per_second / 1000.0},
+        burst_{std::max(kMinBurst, bytes_per_ms_ * kBurstTime)}, tokens_{burst_}
+    {
+        device_.name = name;
+        device_.network = std::move(network);
+        nrpn_parameter_.fill(kNoParameter);
+        for (auto& channel : cc14_msb_)
+            channel.fill(kNoParameter);
+        juce::Thread::startThread();
+    }
+    ~OutputWorker()
+    {
+        juce::Thread::signalThreadShouldExit();
+        juce::Thread::notify();
+        juce::Thread::stopThread(kStopWait);
+    }
+    OutputWorker(const OutputWorker&) = delete;
+    OutputWorker& operator=(const OutputWorker&) = delete;
+    const juce::String& Name() const noexcept
+    {
+        return device_.name;
+    }
+    bool Network() const noexcept
+    {
+        return device_.network != nullptr;
+    }
+    // the device's position in the latest enumeration, used if it hasn't opened yet
+    void SetIndex(int index) noexcept
+    {
+        index_.store(index, std::memory_order_relaxed);
+    }
+    void Post(gsl::span<const juce::MidiMessage> messages)
+    {
+        Group group;
+        for (const auto& message : messages)
+            if (group.size < kMaxGroup)
+                group.messages[group.size++] = message;
+        {
+            std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+            Enqueue_(group);
+        }
+        juce::Thread::notify();
+    }
+    // queued apart from feedback, and sent only when no feedback waits
+    void Upload(const std::vector<juce::MidiMessage>& frames)
+    {
+        {
+            std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+            bulk_.insert(bulk_.end(), frames.begin(), frames.end());
+        }
+        juce::Thread::notify();
+    }
+    // queues those of messages routed to this device or to all
+    void Post(const std::vector<QueuedMessage>& messages)
+    {
+        {
+            std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+            Group group;
+            for (const auto& queued : messages) {
+                if (queued.group_start && group.size) {
+                    Enqueue_(group);
+                    group.size = 0;
+                }
+                if (group.size < kMaxGroup &&
+                    (queued.route.isEmpty() || queued.route == device_.name))
+                    group.messages[group.size++] = queued.message;
+            }
+            if (group.size)
+                Enqueue_(group);
+        }
+        juce::Thread::notify();
+    }
+
+private:
+    struct Group {
+        std::array<juce::MidiMessage, kMaxGroup> messages;
+        size_t size{0};
+        juce::uint32 key{0};
+    };
+    // the control a group sets: its size, status byte and controller, or NRPN number
+    static juce::uint32 Key_(const Group& group) noexcept
+    {
+        const auto& first = group.messages[0];
+        const auto* const raw = first.getRawData();
+        auto data = first.getRawDataSize() > 1 && !first.isPitchWheel() ?
+            static_cast<juce::uint32>(raw[1]) : 0u;
+        if (group.size == kMaxGroup && first.isController() &&
+            first.getControllerNumber() == kNrpnMsb)
+            data = static_cast<juce::uint32>((first.getControllerValue() << 7) |
+                group.messages[1].getControllerValue());
+        return static_cast<juce::uint32>(group.size) << 24 |
+            static_cast<juce::uint32>(raw[0]) << 16 | data;
+    }
+    void Enqueue_(Group& group)
+    { //call with queue_mutex_ held
+        if (!group.size)
+            return;
+        group.key = Key_(group);
+        const auto found = positions_.find(group.key);
+        if (found != positions_.end()) {
+            queue_[found->second - front_] = group; //still waiting, so only the latest goes
+            return;
+        }
+        if (queue_.size() >= kMaxQueue)
+            PopFront_();
+        positions_[group.key] = front_ + queue_.size();
+        queue_.push_back(group);
+    }
+    void PopFront_()
+    { //call with queue_mutex_ held
+        positions_.erase(queue_.front().key);
+        queue_.pop_front();
+        ++front_;
+    }
+    bool Open_()
+    {
+        if (!opened_ && !failed_) {
+            [[maybe_unused]] const auto start = juce::Time::getMillisecondCounterHiRes();
+            opened_ = sender_.OpenOutput_(index_.load(std::memory_order_relaxed), device_);
+            failed_ = !opened_;
+            DBG("MIDISender: " + juce::String(opened_ ? "opened " : "unable to open ") +
+                device_.name + " in " +
+                juce::String(juce::Time::getMillisecondCounterHiRes() - start, 1) + " ms");
+        }
+        return opened_;
+    }
+    static int Bytes_(const Group& group) noexcept
+    {
+        auto bytes = 0;
+        for (size_t i = 0; i < group.size; ++i)
+            bytes += group.messages[i].getRawDataSize();
+        return bytes;
+    }
+    int Pace_(int bytes)
+    { //ms to wait until bytes may be sent, 0 if now
+        if (bytes_per_ms_ <= 0.0)
+            return 0;
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        tokens_ = std::min(burst_, tokens_ + (now - refilled_) * bytes_per_ms_);
+        refilled_ = now;
+        // a SysEx frame may be larger than the burst, so it goes once the bucket is full
+        // and the debt delays what follows
+        const auto needed = std::min(static_cast<double>(bytes), burst_);
+        if (tokens_ >= needed) {
+            tokens_ -= bytes;
+            return 0;
+        }
+        return std::max(1, static_cast<int>((needed - tokens_) / bytes_per_ms_ + 0.5));
+    }
+    void run() override
+    {
+        const ThreadAccount account{"MIDISender output"};
+        Group group;
+        while (!juce::Thread::threadShouldExit()) {
+            auto bulk = false;
+            {
+                std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+                if (!queue_.empty())
+                    group = queue_.front();
+                else
+                    group.size = 0;
+                bulk = !bulk_.empty();
+            }
+            if (!group.size && !bulk) {
+                juce::Thread::wait(-1); //notified by Post, Upload and on exit
+                continue;
+            }
+            if (!Open_()) { //unusable until a rescan finds it again
+                std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+                queue_.clear();
+                positions_.clear();
+                bulk_.clear();
+                continue;
+            }
+            if (!group.size) {
+                SendBulk_();
+                continue;
+            }
+            if (driver_ && SendFrame_())
+                continue;
+            // the group stays queued while pacing, so newer values still replace it
+            if (const auto wait = Pace_(Bytes_(group))) {
+                juce::Thread::wait(wait);
+                continue;
+            }
+            {
+                std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+                group = queue_.front(); //may have been replaced meanwhile
+                PopFront_();
+            }
+            for (auto i = SkipRunning_(group); i < group.size; ++i)
+                device_.Send(group.messages[i]);
+        }
+    }
+    bool SendFrame_()
+    {
+        // when several values are waiting, let the device's driver pack them into
+        // one SysEx frame. Returns false to send them as they are
+        juce::MidiMessage frame;
+        {
+            std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+            if (queue_.size() < 2)
+                return false;
+            frame_messages_.clear();
+            for (const auto& group : queue_)
+                frame_messages_.insert(frame_messages_.end(), group.messages.begin(),
+                    group.messages.begin() + static_cast<std::ptrdiff_t>(group.size));
+            if (!driver_->Pack(frame_messages_, frame))
+                return false;
+            front_ += queue_.size();
+            queue_.clear();
+            positions_.clear();
+        }
+        while (const auto wait = Pace_(frame.getRawDataSize())) {
+            if (juce::Thread::threadShouldExit())
+                return true;
+            juce::Thread::wait(wait);
+        }
+        device_.Send(frame);
+        for (auto& channel : cc14_msb_)
+            channel.fill(kNoParameter); //the frame may have set any control
+        return true;
+    }
+    void SendBulk_()
+    { //the next upload frame, once its bytes are due
+        juce::MidiMessage frame;
+        {
+            std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+            frame = bulk_.front(); //only this thread pops
+        }
+        if (const auto wait = Pace_(frame.getRawDataSize())) {
+            juce::Thread::wait(wait); //feedback arriving meanwhile goes first
+            return;
+        }
+        {
+            std::lock_guard<decltype(queue_mutex_)> lock(queue_mutex_);
+            bulk_.pop_front();
+        }
+        device_.Send(frame);
+    }
+    size_t SkipRunning_(const Group& group)
+    {
+        // the device keeps the NRPN number selected and the MSB of a 14-bit CC, so
+        // while a control sweeps only what changed needs sending: the data entry pair
+        // of an NRPN, or the LSB of a 14-bit CC when the MSB is unchanged. Both are
+        // resent now and then in case the device missed them. Returns the messages
+        // to skip
+        const auto& first = group.messages[0];
+        if (!first.isController())
+            return 0;
+        const auto channel = static_cast<size_t>(first.getChannel() - 1);
+        const auto number = first.getControllerNumber();
+        const auto now = juce::Time::getMillisecondCounter();
+        if (group.size == kMaxGroup && number == kNrpnMsb) {
+            const auto parameter = gsl::narrow_cast<short>(group.key & 0x3FFF);
+            if (nrpn_parameter_[channel] == parameter && now - nrpn_sent_[channel] < kRunningRefresh)
+                return 2;
+            nrpn_parameter_[channel] = parameter;
+            nrpn_sent_[channel] = now;
+            return 0;
+        }
+        if (number == kNrpnMsb || number == kNrpnLsb || number == kRpnLsb ||
+            number == kRpnMsb) //a plain CC selecting another parameter
+            nrpn_parameter_[channel] = kNoParameter;
+        if (number < kCC14Controls) {
+            auto& msb = cc14_msb_[channel][static_cast<size_t>(number)];
+            auto& sent = cc14_sent_[channel][static_cast<size_t>(number)];
+            const auto value = gsl::narrow_cast<short>(first.getControllerValue());
+            if (group.size != 2) { //a 7-bit value replaces the pair
+                msb = kNoParameter;
+                return 0;
+            }
+            if (msb == value && now - sent < kRunningRefresh)
+                return 1;
+            msb = value;
+            sent = now;
+        }
+        return 0;
+    }
+    const MIDISender& sender_;
+    const SurfaceDriver* const driver_; //nullptr if the device has none
+    std::vector<juce::MidiMessage> frame_messages_; //writer thread only
+    std::atomic<int> index_;
+    OutputDevice device_; //writer thread only, apart from name
+    bool opened_{false};
+    bool failed_{false};
+    // NRPN number last selected on each channel and when, writer thread only
+    std::array<short, 16> nrpn_parameter_;
+    std::array<juce::uint32, 16> nrpn_sent_{};
+    // MSB last sent to each 14-bit CC and when, writer thread only
+    std::array<std::array<short, kCC14Controls>, 16> cc14_msb_;
+    std::array<std::array<juce::uint32, kCC14Controls>, 16> cc14_sent_{};
+    // byte budget, writer thread only. bytes_per_ms_ 0 is unpaced
+    const double bytes_per_ms_;
+    const double burst_;
+    double tokens_;
+    double refilled_{juce::Time::getMillisecondCounterHiRes()};
+    std::mutex queue_mutex_;
+    std::deque<Group> queue_;
+    std::unordered_map<juce::uint32, size_t> positions_; //key to front_-based index
+    std::deque<juce::MidiMessage> bulk_; //upload frames, sent whole and in order
+    size_t front_{0}; //groups ever taken from queue_
+};
+
+MIDISender::MIDISender()
+{
+    Instrumentation::Objects<OutputWorker>("MIDI output workers");
+}
 
 MIDISender::~MIDISender()
-{}
+{
+    juce::Timer::stopTimer();
+}
 
 void MIDISender::Init()
 {
-    InitDevices_();
+    // outputs open on first use, so this only lists them
+    [[maybe_unused]] const auto start = juce::Time::getMillisecondCounterHiRes();
+    RescanDevices();
+    DBG("MIDISender: listed " + juce::String(static_cast<int>(output_devices_.size())) +
+        " outputs in " + juce::String(juce::Time::getMillisecondCounterHiRes() - start, 1) +
+        " ms");
 }
 
-void MIDISender::sendCC(int midi_channel, int controller, int value) const
+void MIDISender::SetDevicePollInterval(int interval)
 {
+    if (interval > 0)
+        juce::Timer::startTimer(interval);
+    else
+        juce::Timer::stopTimer();
+}
+
+void MIDISender::timerCallback()
+{
+    PowerMonitor::CountWakeUp();
+    RescanDevices();
+}
+
+void MIDISender::SetBackend(RSJ::MidiBackend backend, int rtmidi_api) noexcept
+{
+#ifdef MIDI2LR_RTMIDI
+    backend_ = backend;
+    rtmidi_api_ = static_cast<RtMidi::Api>(rtmidi_api);
+#else
+    (void)backend; //JUCE only
+    (void)rtmidi_api;
+#endif
+}
+
+void MIDISender::sendCC(int midi_channel, int controller, int value,
+    const juce::String& device) const
+{
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
     if (controller < 128) { // regular message
-        for (const auto& dev : output_devices_)
-            dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, controller, value));
+        const std::array<juce::MidiMessage, 1> message{{
+            juce::MidiMessage::controllerEvent(midi_channel, controller, value)}};
+        Send_(message, device);
     }
     else { // NRPN
         const auto parameterLSB = controller & 0x7f;
         const auto parameterMSB = (controller >> 7) & 0x7F;
         const auto valueLSB = value & 0x7f;
         const auto valueMSB = (value >> 7) & 0x7F;
-        for (const auto& dev : output_devices_) {
-            dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 99, parameterMSB));
-            dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 98, parameterLSB));
-            dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 6, valueMSB));
-            dev->sendMessageNow(juce::MidiMessage::controllerEvent(midi_channel, 38, valueLSB));
-        }
+        const std::array<juce::MidiMessage, 4> messages{{
+            juce::MidiMessage::controllerEvent(midi_channel, 99, parameterMSB),
+            juce::MidiMessage::controllerEvent(midi_channel, 98, parameterLSB),
+            juce::MidiMessage::controllerEvent(midi_channel, 6, valueMSB),
+            juce::MidiMessage::controllerEvent(midi_channel, 38, valueLSB)}};
+        Send_(messages, device);
     }
 }
 
-void MIDISender::sendNoteOn(int midi_channel, int controller, int value) const
+void MIDISender::sendCC14bit(int midi_channel, int controller, int value,
+    const juce::String& device) const
+{
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    const std::array<juce::MidiMessage, 2> messages{{
+        juce::MidiMessage::controllerEvent(midi_channel, controller, (value >> 7) & 0x7F),
+        juce::MidiMessage::controllerEvent(midi_channel, controller + 32, value & 0x7F)}};
+    Send_(messages, device);
+}
+
+void MIDISender::sendNoteOn(int midi_channel, int controller, int value,
+    const juce::String& device) const
+{
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    const std::array<juce::MidiMessage, 1> message{{
+        MidiMessage::noteOn(midi_channel, controller, gsl::narrow_cast<juce::uint8>(value))}};
+    Send_(message, device);
+}
+
+bool MIDISender::Upload(const std::vector<juce::MidiMessage>& frames,
+    const juce::String& device) const
 {
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    auto found = false;
     for (const auto& dev : output_devices_)
-        dev->sendMessageNow(MidiMessage::noteOn(midi_channel, controller,
-                                                gsl::narrow_cast<juce::uint8>(value)));
+        if (dev->Name() == device) {
+            dev->Upload(frames);
+            found = true;
+        }
+    return found;
+}
+
+void MIDISender::sendPitchWheel(int midi_channel, int value,
+    const juce::String& device) const
+{
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    const std::array<juce::MidiMessage, 1> message{{
+        MidiMessage::pitchWheel(midi_channel, value)}};
+    Send_(message, device);
+}
+
+void MIDISender::SetOutputRates(int bytes_per_second, const juce::String& overrides)
+{
+    output_rate_ = std::max(0, bytes_per_second);
+    output_rates_.clear();
+    for (const auto& entry : juce::StringArray::fromTokens(overrides, ";", ""))
+        if (entry.contains("="))
+            output_rates_.set(entry.upToFirstOccurrenceOf("=", false, false).trim(),
+                entry.fromFirstOccurrenceOf("=", false, false).trim());
+}
+
+int MIDISender::OutputRate_(const juce::String& name) const
+{
+    return output_rates_.containsKey(name) ?
+        std::max(0, output_rates_[name].getIntValue()) : output_rate_;
 }
 
-void MIDISender::sendPitchWheel(int midi_channel, int value) const
+void MIDISender::AddSurfaceDriver(std::unique_ptr<SurfaceDriver> driver)
 {
+    surface_drivers_.push_back(std::move(driver));
+}
+
+void MIDISender::BeginBatch() const
+{
+    Batch_().sender = this;
+}
+
+void MIDISender::EndBatch() const
+{
+    auto& batch = Batch_();
+    if (batch.sender != this)
+        return;
+    batch.sender = nullptr;
+    if (batch.messages.empty())
+        return;
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    for (const auto& dev : output_devices_)
+        dev->Post(batch.messages);
+    batch.messages.clear(); //keeps capacity for the next refresh
+}
+
+void MIDISender::Send_(gsl::span<const juce::MidiMessage> messages,
+    const juce::String& device) const
+{
+    if (thru_ && thru_->WantsFeedback())
+        for (const auto& message : messages)
+            thru_->Send(message);
+    // only route to a device that is open, so feedback isn't lost when names differ
+    const auto routed = device.isNotEmpty() && std::any_of(output_devices_.begin(),
+        output_devices_.end(), [&device](const std::unique_ptr<OutputWorker>& dev) {
+        return dev->Name() == device; });
+    auto& batch = Batch_();
+    if (batch.sender == this) {
+        auto group_start = true;
+        for (const auto& message : messages) {
+            batch.messages.push_back({message, group_start, routed ? device : juce::String{}});
+            group_start = false;
+        }
+        if (batch.messages.size() < kMaxBatch)
+            return;
+        for (const auto& dev : output_devices_)
+            dev->Post(batch.messages);
+        batch.messages.clear();
+        return;
+    }
     for (const auto& dev : output_devices_)
-        dev->sendMessageNow(MidiMessage::pitchWheel(midi_channel, value));
+        if (!routed || dev->Name() == device)
+            dev->Post(messages);
+}
+
+void MIDISender::OutputDevice::Send(const juce::MidiMessage& message) const
+{
+    const TraceScope trace{"MIDI send"};
+    if (network) {
+        network->Send(message);
+        return;
+    }
+#ifdef MIDI2LR_RTMIDI
+    if (rt_device) {
+        rt_device->sendMessage(message.getRawData(),
+            gsl::narrow_cast<size_t>(message.getRawDataSize()));
+        return;
+    }
+#endif
+    device->sendMessageNow(message);
+}
+
+void MIDISender::SetThru(MidiThru* thru) noexcept
+{
+    thru_ = thru;
 }
 
 void MIDISender::RescanDevices()
 {
-    output_devices_.clear();
-    InitDevices_();
+    const auto listed = GetDeviceNames_();
+    const auto names = RSJ::DeviceIdentifiers(listed); //as MIDIProcessor names inputs
+    std::vector<bool> present(static_cast<size_t>(names.size()), false);
+    std::vector<std::unique_ptr<OutputWorker>> closed; //destroyed outside the lock
+    {
+        // keep devices still listed (names may repeat, so match each entry once)
+        std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+        for (auto dev = output_devices_.begin(); dev != output_devices_.end();) {
+            if ((*dev)->Network()) {
+                ++dev;
+                continue;
+            }
+            auto found = -1;
+            for (auto idx = 0; idx < names.size() && found < 0; ++idx)
+                if (!present[static_cast<size_t>(idx)] && names[idx] == (*dev)->Name()) {
+                    present[static_cast<size_t>(idx)] = true;
+                    found = idx;
+                }
+            if (found >= 0) {
+                (*dev)->SetIndex(found);
+                ++dev;
+            }
+            else {
+                closed.emplace_back(std::move(*dev));
+                dev = output_devices_.erase(dev);
+            }
+        }
+    }
+    for (auto idx = 0; idx < names.size(); ++idx)
+        if (!present[static_cast<size_t>(idx)] && !(thru_ && thru_->IsOpen() &&
+            listed[idx] == thru_->PortName())) {
+            OpenDevice_(idx, names[idx]);
+            device_callbacks_(names[idx]);
+        }
+}
+
+void MIDISender::OpenDevice_(int index, const juce::String& name)
+{
+    const SurfaceDriver* driver{nullptr};
+    for (const auto& candidate : surface_drivers_)
+        if (candidate->Matches(name)) {
+            driver = candidate.get();
+            break;
+        }
+    auto worker = std::make_unique<OutputWorker>(*this, name, index, OutputRate_(name), driver);
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    output_devices_.push_back(std::move(worker));
 }
 
-void MIDISender::InitDevices_()
+void MIDISender::AddNetworkOutput(std::shared_ptr<RtpMidiSession> session)
 {
-    for (auto idx = 0; idx < juce::MidiOutput::getDevices().size(); ++idx) {
-        auto dev = juce::MidiOutput::openDevice(idx);
-        if (dev != nullptr)
-            output_devices_.emplace_back(dev);
+    const auto name = session->Name();
+    auto worker = std::make_unique<OutputWorker>(*this, name, -1, OutputRate_(name), nullptr,
+        std::move(session));
+    std::lock_guard<decltype(devices_mutex_)> lock(devices_mutex_);
+    output_devices_.push_back(std::move(worker));
+}
+
+bool MIDISender::OpenOutput_(int index, OutputDevice& output) const
+{
+    if (output.network)
+        return true; //the session is already listening
+#ifdef MIDI2LR_RTMIDI
+    if (backend_ == RSJ::MidiBackend::rtmidi) {
+        try {
+            output.rt_device = std::make_unique<RtMidiOut>(rtmidi_api_, "MIDI2LR");
+            output.rt_device->openPort(gsl::narrow_cast<unsigned int>(index));
+            return true;
+        }
+        catch (const RtMidiError& e) {
+            DBG("MIDISender: unable to open " + output.name + ": " + e.getMessage());
+            output.rt_device.reset();
+            return false;
+        }
+    }
+#endif
+    output.device.reset(juce::MidiOutput::openDevice(index));
+    return output.device != nullptr;
+}
+
+juce::StringArray MIDISender::GetDeviceNames_()
+{
+#ifdef MIDI2LR_RTMIDI
+    if (backend_ == RSJ::MidiBackend::rtmidi) {
+        juce::StringArray names;
+        try {
+            if (!rt_probe_)
+                rt_probe_ = std::make_unique<RtMidiOut>(rtmidi_api_, "MIDI2LR probe");
+            const auto count = rt_probe_->getPortCount();
+            for (unsigned int port = 0; port < count; ++port)
+                names.add(rt_probe_->getPortName(port));
+        }
+        catch (const RtMidiError& e) {
+            DBG("MIDISender: unable to list RtMidi ports: " + e.getMessage());
+        }
+        return names;
     }
+#endif
+    return juce::MidiOutput::getDevices();
 }
\ No newline at end of file
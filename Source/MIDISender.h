@@ -22,28 +22,149 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_MIDISENDER_H_INCLUDED
 #define MIDI2LR_MIDISENDER_H_INCLUDED
 #include <memory>
+#include <mutex>
 #include <vector>
+#include <gsl/gsl>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiUtilities.h"
+#include "Utilities/Utilities.h"
+#ifdef MIDI2LR_RTMIDI
+#include "../rtmidi/RtMidi.h"
+#endif
+class MidiThru;
+class RtpMidiSession;
 
-class MIDISender {
+// packs many control values into one SysEx frame for controllers that can set
+// several positions at once. MIDISender offers a device's driver the values that
+// have queued up, and sends them as ordinary messages if Pack returns false
+class SurfaceDriver {
 public:
-    MIDISender() noexcept;
+    virtual ~SurfaceDriver() = default;
+    // true if this driver handles the output named device
+    virtual bool Matches(const juce::String& device) const = 0;
+    // called on the device's writer thread
+    virtual bool Pack(const std::vector<juce::MidiMessage>& messages,
+        juce::MidiMessage& frame) const = 0;
+};
+
+class MIDISender: private juce::Timer {
+public:
+    MIDISender();
     virtual ~MIDISender();
     void Init();
 
-    // sends a CC message to all output devices
-    void sendCC(int midi_channel, int controller, int value) const;
-    // sends a PitchBend message to all output devices
-    void sendPitchWheel(int midi_channel, int value) const;
+    // rtmidi_api is an RtMidi::Api value, 0 picks the first one compiled. Call
+    // before Init
+    void SetBackend(RSJ::MidiBackend backend, int rtmidi_api) noexcept;
+
+    // each send goes to the outputs named device, normally the input the control was
+    // last heard on. If device is empty or no output has that name, it goes to all
+
+    // sends a CC message
+    void sendCC(int midi_channel, int controller, int value,
+        const juce::String& device = {}) const;
+    // sends a 14-bit value as CC controller (MSB) and controller + 32 (LSB)
+    void sendCC14bit(int midi_channel, int controller, int value,
+        const juce::String& device = {}) const;
+    // sends a PitchBend message
+    void sendPitchWheel(int midi_channel, int value, const juce::String& device = {}) const;
+
+    void sendNoteOn(int midi_channel, int controller, int value,
+        const juce::String& device = {}) const;
+
+    // queues SysEx frames, such as a preset upload, to the output named device only,
+    // after the feedback waiting for it and paced to its rate. They are sent in order,
+    // never replaced or dropped, and not copied to thru. False if no output has that name
+    bool Upload(const std::vector<juce::MidiMessage>& frames, const juce::String& device) const;
 
-    void sendNoteOn(int midi_channel, int controller, int value) const;
+    // messages sent between BeginBatch and EndBatch are held and then queued to each
+    // device in one go, so a burst of feedback takes each queue's lock and wakes each
+    // device's worker once. A batch belongs to the calling thread, so other threads'
+    // sends neither join nor flush it. Batches don't nest. EndBatch without BeginBatch
+    // does nothing
+    void BeginBatch() const;
+    void EndBatch() const;
 
-    // re-enumerates MIDI OUT devices
+    // re-enumerates MIDI OUT devices, adding new ones and closing vanished ones.
+    // Devices still present stay open. A device opens when first sent to
     void RescanDevices();
 
+    // rescan every interval ms; 0 stops polling
+    void SetDevicePollInterval(int interval);
+
+    // called with an output's name when a rescan opens it, on the rescanning thread
+    template<class T, void(T::*MF)(const juce::String&)>
+    void addDeviceCallback(T* const object)
+    {
+        device_callbacks_.add<T, MF>(object);
+    }
+
+    // drivers are matched to outputs in the order added. Call before Init
+    void AddSurfaceDriver(std::unique_ptr<SurfaceDriver> driver);
+
+    // an RTP-MIDI session as one more output, named as its input. Kept by rescans
+    void AddNetworkOutput(std::shared_ptr<RtpMidiSession> session);
+
+    // paces each output to bytes_per_second (0 is unpaced), about 3000 for 5-pin DIN.
+    // overrides is "device name=rate;...". Call before Init
+    void SetOutputRates(int bytes_per_second, const juce::String& overrides);
+
+    // feedback is copied to thru if it wants it, and its port isn't opened as an output.
+    // thru must outlive this. Call before Init
+    void SetThru(MidiThru* thru) noexcept;
+
 private:
-    void InitDevices_();
-    std::vector<std::unique_ptr<juce::MidiOutput>> output_devices_;
+    struct OutputDevice {
+        juce::String name;
+        std::unique_ptr<juce::MidiOutput> device;
+#ifdef MIDI2LR_RTMIDI
+        std::unique_ptr<RtMidiOut> rt_device;
+#endif
+        std::shared_ptr<RtpMidiSession> network;
+        void Send(const juce::MidiMessage& message) const;
+    };
+    // a message and whether it starts a group (such as the four CCs of an NRPN) that
+    // must reach the device whole. route is the output name, empty for all
+    struct QueuedMessage {
+        juce::MidiMessage message;
+        bool group_start;
+        juce::String route;
+    };
+    class OutputWorker;
+    // Timer interface
+    void timerCallback() override;
+    // queues one group of messages to every device. Call with devices_mutex_ held
+    void Send_(gsl::span<const juce::MidiMessage> messages, const juce::String& device) const;
+    juce::StringArray GetDeviceNames_();
+    void OpenDevice_(int index, const juce::String& name);
+    // opens the output at index, on its worker's thread
+    bool OpenOutput_(int index, OutputDevice& output) const;
+    int OutputRate_(const juce::String& name) const;
+
+    constexpr static size_t kMaxCallbacks = 4;
+    RSJ::MidiBackend backend_{RSJ::MidiBackend::juce};
+    RSJ::callback_list<kMaxCallbacks, const juce::String&> device_callbacks_;
+    int output_rate_{0};
+    MidiThru* thru_{nullptr};
+    std::vector<std::unique_ptr<SurfaceDriver>> surface_drivers_;
+    juce::StringPairArray output_rates_{false}; //device names compare case sensitively
+    mutable std::mutex devices_mutex_; //sends run on the LR_IPC_IN thread
+    // each device is written by its own thread, so a slow interface only delays itself
+    std::vector<std::unique_ptr<OutputWorker>> output_devices_;
+    // the calling thread's batch; sender is the MIDISender it is open on, else nullptr
+    struct Batch {
+        const MIDISender* sender{nullptr};
+        std::vector<QueuedMessage> messages;
+    };
+    static Batch& Batch_() noexcept
+    {
+        thread_local Batch batch;
+        return batch;
+    }
+#ifdef MIDI2LR_RTMIDI
+    RtMidi::Api rtmidi_api_{RtMidi::UNSPECIFIED};
+    std::unique_ptr<RtMidiOut> rt_probe_; //port enumeration only
+#endif
 };
 
 #endif  // MIDISENDER_H_INCLUDED
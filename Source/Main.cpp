@@ -29,30 +29,81 @@ You should have received a copy of the GNU General Public License along with
 MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
+#include <array>
 #include <exception>
 #include <fstream>
+#include <future>
 #include <memory>
+#include <mutex>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include <cereal/archives/binary.hpp>
+#include "AsyncLog.h"
+#include "Benchmark.h"
 #include "CCoptions.h"
 #include "CommandMap.h"
+#include "ControllerPresets.h"
 #include "ControlsModel.h"
+#include "Instrumentation.h"
+#include "LatencyWatchdog.h"
 #include "LR_IPC_In.h"
 #include "LR_IPC_Out.h"
 #include "MainComponent.h"
 #include "MainWindow.h"
+#include "MetricsServer.h"
 #include "MIDIProcessor.h"
 #include "MIDISender.h"
+#include "MidiThru.h"
+#include "MockLightroom.h"
+#include "OscController.h"
+#include "ParserHarness.h"
+#include "PipelineTrace.h"
+#include "PowerMonitor.h"
 #include "PWoptions.h"
 #include "ProfileManager.h"
+#include "ProfileSync.h"
+#include "Relay.h"
+#include "RtpMidi.h"
+#include "Scalability.h"
+#include "Scheduler.h"
+#include "SendKeys.h"
 #include "SettingsManager.h"
+#include "Soak.h"
+#include "ThreadPriority.h"
+#include "ThreadStats.h"
 #include "VersionChecker.h"
 
 namespace {
     const juce::String ShutDownString{"--LRSHUTDOWN"};
+    const juce::String HeadlessString{"--headless"};
+    const juce::String BenchmarkString{"--benchmark"};
+    const juce::String FuzzParserString{"--fuzz-parser"}; //optionally followed by count and seed
+    constexpr int kFuzzInputs = 100000; //of 64 lines each
+    const juce::String SoakString{"--soak"}; //optionally followed by seconds and baseline file
+    constexpr int kSoakSeconds = 600;
+    const juce::String ScaleString{"--scale"}; //optionally followed by controllers, seconds and rate
+    constexpr int kScaleControllers = 64;
+    constexpr int kScaleSeconds = 5; //per controller count and dispatch
+    constexpr int kScaleRate = 200; //messages/s per controller, a fader moved quickly
+    const juce::String RecordString{"--record"}; //followed by the capture file
+    const juce::String ReplayString{"--replay"}; //as is --replay-fast
+    const juce::String ReplayFastString{"--replay-fast"};
+    const juce::String MockString{"--mock-lightroom"}; //--mock-burst and --mock-interval take a value
+    const juce::String MockBurstString{"--mock-burst"};
+    const juce::String MockIntervalString{"--mock-interval"};
+    const juce::String MockCompactString{"--mock-compact"};
+    // a second launch with these queries the running instance, see statsQuery_
+    const juce::String StatsString{"--stats"}; //optionally followed by the file
+    const juce::String ResetStatsString{"--reset-stats"};
+    const juce::String TraceStartString{"--trace-start"};
+    const juce::String TraceDumpString{"--trace-dump"}; //optionally followed by the file
+    constexpr int kSaveTimeout = 5000; //ms to wait for a background save at quit
+    constexpr int kAutosaveTimer = 0;
+    constexpr int kDiagnosticsTimer = 1;
+    constexpr int kMetricsTimer = 2;
+    constexpr int kMetricsInterval = 5000; //ms between metrics snapshots
 }
 
-class MIDI2LRApplication final: public juce::JUCEApplication {
+class MIDI2LRApplication final: public juce::JUCEApplication, private juce::MultiTimer {
 public:
     MIDI2LRApplication()
     {
@@ -94,19 +145,213 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
         // start - up after all, it can just call the quit() method and the event
         // loop won't be run.
 
-        if (command_line != ShutDownString) {
-            cerealLoad_();
-            midi_processor_->Init();
-            midi_sender_->Init();
-            lr_ipc_out_->Init(midi_processor_.get());
+        ThreadStats::Register("message thread"); //timers, AsyncUpdaters and painting
+        if (command_line == BenchmarkString) {
+            // nothing else is started: time the hot path, write benchmark.csv and quit
+            juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile("benchmark.csv").replaceWithText(RunBenchmarks());
+            quit();
+        }
+        else if (command_line.startsWith(FuzzParserString)) {
+            // likewise for the inbound parser with generated input, writing fuzz.csv
+            // the report's seed repeats a run
+            const auto args = juce::StringArray::fromTokens(command_line, true);
+            const auto count = args[1].getIntValue();
+            const auto seed = args.size() > 2 ? args[2].getLargeIntValue() :
+                juce::Time::currentTimeMillis();
+            juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile("fuzz.csv").replaceWithText(RunParserFuzz(seed,
+                    count > 0 ? count : kFuzzInputs));
+            quit();
+        }
+        else if (command_line.startsWith(SoakString)) {
+            // a long mixed session compared with a stored baseline, writing soak.csv.
+            // The baseline is beside the executable unless given with a full path
+            const auto args = juce::StringArray::fromTokens(command_line, true);
+            const auto seconds = args[1].getIntValue();
+            const auto executable = juce::File::getSpecialLocation(juce::File::currentExecutableFile);
+            const auto baseline = args.size() > 2 ? executable.getSiblingFile(args[2].unquoted()) :
+                executable.getSiblingFile("soak_baseline.csv");
+            executable.getSiblingFile("soak.csv").replaceWithText(RunSoak(
+                seconds > 0 ? seconds : kSoakSeconds, baseline));
+            quit();
+        }
+        else if (command_line.startsWith(ScaleString)) {
+            // how many synthetic controllers the pipeline sustains, writing scale.csv.
+            // The Lightroom ports must be free
+            const auto args = juce::StringArray::fromTokens(command_line, true);
+            const auto value = [&args](int index, int fallback) {
+                return args[index].getIntValue() > 0 ? args[index].getIntValue() : fallback;
+            };
+            juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile("scale.csv").replaceWithText(RunScalability(
+                    value(1, kScaleControllers), value(2, kScaleSeconds), value(3, kScaleRate)));
+            quit();
+        }
+        else if (command_line != ShutDownString) {
+            auto& trace = midi_processor_->getStartupTrace();
+            auto began = juce::Time::getMillisecondCounterHiRes();
+            RSJ::InitKeyboardLayout();
+            trace.Record("keyboard layout", began);
+            Instrumentation::SetMemoryBudgets(settings_manager_.getMemoryBudgets());
+            AsyncLog::Start(juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile("MIDI2LR.log"), AsyncLog::ParseLevel(settings_manager_.getLogLevel()));
+            // settings.bin and the MIDI outputs don't depend on anything else started
+            // here, so they load on their own threads. The outputs are listed while the
+            // inputs open; the profile directory is scanned on ProfileManager's watcher
+            auto settings_loaded = std::async(std::launch::async, [this, &trace] {
+                const auto start = juce::Time::getMillisecondCounterHiRes();
+                settingsLoad_();
+                trace.Record("settings.bin load", start);
+            });
+            midi_sender_->SetBackend(settings_manager_.getMidiBackend(),
+                settings_manager_.getRtMidiApi());
+            midi_sender_->SetOutputRates(settings_manager_.getMidiOutRate(),
+                settings_manager_.getMidiOutRates());
+            const auto thru_port = settings_manager_.getThruPort();
+            if (thru_port.isNotEmpty()) {
+                if (midi_thru_.Open(thru_port, settings_manager_.getThruInputs(),
+                    settings_manager_.getThruFeedback())) {
+                    midi_sender_->SetThru(&midi_thru_);
+                    midi_processor_->SetThru(&midi_thru_);
+                }
+                else
+                    juce::Logger::writeToLog("MIDI thru port " + thru_port +
+                        " couldn't be opened");
+            }
+            // before either side opens devices, so presets reach controllers found then
+            controller_presets_.Init(settings_manager_.getControllerPresets(), &profile_manager_,
+                midi_processor_.get(), midi_sender_);
+            auto outputs_listed = std::async(std::launch::async, [this, &trace] {
+                const auto start = juce::Time::getMillisecondCounterHiRes();
+                midi_sender_->Init();
+                trace.Record("MIDI outputs", start);
+            });
+            began = juce::Time::getMillisecondCounterHiRes();
+            midi_processor_->SetBackend(settings_manager_.getMidiBackend(),
+                settings_manager_.getRtMidiApi());
+            midi_processor_->SetNrpnCompletion(settings_manager_.getNrpnMsbChannels(),
+                settings_manager_.getNrpnLsbWindow());
+            const auto cc14 = cc14Pairs_();
+            for (short channel = 0; channel < 16; ++channel)
+                midi_processor_->SetCC14Controllers(channel, cc14[static_cast<size_t>(channel)]);
+            // loading resets relative positions, which mustn't race MIDI conversion, and
+            // the model's 14-bit pairs publish after it
+            settings_loaded.wait();
+            for (size_t channel = 0; channel < 16; ++channel)
+                for (short controller = 0; controller < 32; ++controller)
+                    if (cc14[channel] & (1u << controller))
+                        controls_model_.setCC14bit(channel, controller, true);
+            const RSJ::ThreadPriority priority{settings_manager_.getRealtimeThreads(),
+                static_cast<juce::uint32>(settings_manager_.getThreadAffinity())};
+            midi_processor_->SetThreadPriority(priority);
+            midi_processor_->SetDispatchShards(settings_manager_.getDispatchShards());
+            midi_processor_->Init(settings_manager_.getMidiDispatchThread());
+            if (settings_manager_.getRtpMidiPort() > 0) {
+                rtp_midi_ = std::make_shared<RtpMidiSession>(settings_manager_.getRtpMidiPort());
+                if (rtp_midi_->IsListening()) {
+                    rtp_midi_->Start(midi_processor_->OpenExternalInput(rtp_midi_->Name()));
+                    midi_sender_->AddNetworkOutput(rtp_midi_);
+                }
+                else
+                    AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::error,
+                        "RTP-MIDI port %d is in use", settings_manager_.getRtpMidiPort());
+            }
+            trace.Record("MIDI inputs", began);
+            outputs_listed.wait();
+            began = juce::Time::getMillisecondCounterHiRes();
+            midi_processor_->SetDevicePollInterval(settings_manager_.getDevicePollInterval());
+            midi_sender_->SetDevicePollInterval(settings_manager_.getDevicePollInterval());
+            lr_ipc_out_->SetRateLimits(settings_manager_.getMaxUpdateRate(),
+                settings_manager_.getUpdateRates());
+            lr_ipc_out_->SetAdaptiveRate(settings_manager_.getAdaptiveRate());
+            lr_ipc_out_->SetTouchHold(settings_manager_.getTouchHold());
+            lr_ipc_out_->SetQuantize(settings_manager_.getQuantizeValues());
+            lr_ipc_out_->SetRelativeDeltas(settings_manager_.getRelativeDeltas());
+            lr_ipc_out_->SetHeartbeat(settings_manager_.getHeartbeatTimeout());
+            lr_ipc_out_->SetActionTtl(settings_manager_.getActionTtl());
+            lr_ipc_out_->SetRemoteHost(settings_manager_.getRelayHost());
+            lr_ipc_out_->SetThreadPriority(priority);
+            //the scheduler times the coalescing flush
+            scheduler_.Schedule([priority] {RSJ::RaiseCurrentThread(priority); }, 0.0);
+            mockStart_(command_line);
+            lr_ipc_out_->Init(midi_processor_.get(), settings_manager_.getCoalesceInterval());
             profile_manager_.Init(lr_ipc_out_, midi_processor_.get());
-            lr_ipc_in_->Init(midi_sender_);
+            lr_ipc_in_->SetRemoteHost(settings_manager_.getRelayHost());
+            if (settings_manager_.getRelayServer()) {
+                relay_server_ = std::make_shared<RelayServer>(lr_ipc_out_,
+                    settings_manager_.getRelayAddress());
+                if (!relay_server_->IsListening())
+                    AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::error,
+                        "relay server can't listen on %s, is another instance serving?",
+                        settings_manager_.getRelayAddress().toRawUTF8());
+                //the tap keeps the server alive for as long as the reader may call it
+                lr_ipc_in_->SetLineTap([server = relay_server_](const char* begin, const char* end) {
+                    server->Forward(begin, end);
+                });
+            }
+            if (settings_manager_.getMetricsPort() > 0) {
+                metrics_server_ = std::make_unique<MetricsServer>(settings_manager_.getMetricsPort(),
+                    settings_manager_.getMetricsAddress());
+                if (metrics_server_->IsListening()) {
+                    metricsPublish_();
+                    startTimer(kMetricsTimer, kMetricsInterval);
+                }
+                else
+                    AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::error,
+                        "metrics port %d is in use", settings_manager_.getMetricsPort());
+            }
+            if (settings_manager_.getOscPort() > 0) {
+                osc_controller_ = std::make_shared<OscController>(settings_manager_.getOscPort(),
+                    settings_manager_.getOscFeedbackPort(), lr_ipc_out_);
+                if (osc_controller_->IsListening())
+                    lr_ipc_in_->SetOsc(osc_controller_);
+                else
+                    AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::error,
+                        "OSC port %d is in use", settings_manager_.getOscPort());
+            }
+            lr_ipc_in_->SetThreadPriority(priority);
+            lr_ipc_in_->SetFeedbackDeadband(settings_manager_.getFeedbackDeadband());
+            lr_ipc_in_->SetEchoWindow(settings_manager_.getEchoWindow());
+            lr_ipc_in_->SetLocalEcho(settings_manager_.getLocalEcho());
+            lr_ipc_in_->SetKeyMacros(settings_manager_.getKeyMacros());
+            lr_ipc_in_->SetResident(settings_manager_.getResident());
+            lr_ipc_in_->Init(midi_sender_, midi_processor_.get(), lr_ipc_out_);
+            latency_watchdog_.Init(midi_processor_, lr_ipc_out_, lr_ipc_in_,
+                settings_manager_.getLatencyBudget(), settings_manager_.getCoalesceInterval(),
+                settings_manager_.getDegradedCoalesceInterval());
+            power_monitor_.Init(midi_processor_.get(), lr_ipc_out_, lr_ipc_in_,
+                settings_manager_.getIdleTimeout());
+            power_monitor_.addCallback<MIDI2LRApplication, &MIDI2LRApplication::PowerCallback>(
+                this, Delivery::message_thread);
+            power_monitor_.addCallback<ProfileManager, &ProfileManager::PowerCallback>(
+                &profile_manager_, Delivery::message_thread);
+            trace.Record("Lightroom link", began);
+            began = juce::Time::getMillisecondCounterHiRes();
+            if (settings_manager_.getProfileSyncSource().isNotEmpty()) //fills the mirror
+                profile_sync_ = std::make_unique<ProfileSync>(
+                    juce::File{settings_manager_.getProfileSyncSource()},
+                    settings_manager_.getProfileSyncInterval());
             settings_manager_.Init(lr_ipc_out_);
-            main_window_ = std::make_unique<MainWindow>(getApplicationName());
-            main_window_->Init(&command_map_, lr_ipc_out_, midi_processor_,
-                &profile_manager_, &settings_manager_, midi_sender_);
-            // Check for latest version
-            version_checker_.startThread();
+            trace.Record("profile directory", began);
+            began = juce::Time::getMillisecondCounterHiRes();
+            if (command_line.contains(HeadlessString) || settings_manager_.getHeadless())
+                headlessStart_();
+            else {
+                main_window_ = std::make_unique<MainWindow>(getApplicationName());
+                main_window_->Init(&command_map_, lr_ipc_out_, midi_processor_,
+                    &profile_manager_, &settings_manager_, midi_sender_, &latency_watchdog_,
+                    &power_monitor_);
+                // Check for latest version
+                version_checker_.startThread();
+            }
+            trace.Record("window", began);
+            captureStart_(command_line);
+            trace.Ready();
+            saved_change_count_ = controls_model_.getChangeCount();
+            saved_map_changes_ = command_map_.getChangeCount();
+            if (settings_manager_.getAutosaveInterval() > 0)
+                startTimer(kAutosaveTimer, settings_manager_.getAutosaveInterval() * 1000);
         }
         else {
             // apparently the application is already terminated
@@ -125,11 +370,30 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
         // Be careful that nothing happens in this method that might rely on
         // messages being sent, or any kind of window activity, because the
         // message loop is no longer running at this point.
+        latency_watchdog_.Stop(); //its subscribers go below
+        power_monitor_.Stop();
+        // while everything measured is still here, only for those watching memory use.
+        // Otherwise the report is in the diagnostics and --stats outputs
+        if (settings_manager_.getMemoryBudgets().isNotEmpty() ||
+            settings_manager_.getDiagnosticsInterval() > 0)
+            juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile("memory.csv").replaceWithText(Instrumentation::MemoryReport());
         lr_ipc_out_.reset();
         lr_ipc_in_.reset();
+        relay_server_.reset();
+        metrics_server_.reset();
+        profile_sync_.reset();
+        osc_controller_.reset();
+        if (rtp_midi_)
+            rtp_midi_->Stop(); //MIDI output workers may still hold it
+        if (mock_lightroom_) {
+            mockSave_();
+            mock_lightroom_.reset();
+        }
         midi_processor_.reset();
         midi_sender_.reset();
         main_window_.reset(); // (deletes our window)
+        AsyncLog::Stop(); //last, so it has everything the threads above wrote
     }
 
     //==========================================================================
@@ -140,8 +404,14 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
         // quit() to allow the application to close.
         if (lr_ipc_in_)
             lr_ipc_in_->PleaseStopThread();
+        version_checker_.Cancel();
+        stopTimer(kAutosaveTimer);
+        stopTimer(kDiagnosticsTimer);
+        stopTimer(kMetricsTimer);
+        save_pool_.removeAllJobs(false, kSaveTimeout);
         defaultProfileSave_();
-        cerealSave_();
+        settingsSave_(true);
+        settings_manager_.Flush();
         quit();
     }
 
@@ -153,6 +423,12 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
         if (command_line == ShutDownString)
             //shutting down
             systemRequestedQuit();
+        else if (command_line.contains("Info.lua") && lr_ipc_out_)
+            // the plugin starting up and launching MIDI2LR, which is still running if
+            // resident: try Lightroom now rather than at the next retry
+            lr_ipc_out_->ConnectSoon();
+        else if (midi_processor_ && lr_ipc_out_)
+            statsQuery_(command_line);
     }
 
     void unhandledException(const std::exception * e,
@@ -185,35 +461,235 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
     }
 
 private:
+    std::array<juce::uint32, 16> cc14Pairs_() const
+    {// "channel:controller" entries, channel 1-16, controller 0-31. Bit n set for CC n
+        std::array<juce::uint32, 16> controllers{};
+        const auto pairs = juce::StringArray::fromTokens(settings_manager_.getCC14Pairs(),
+            ", ", "");
+        for (const auto& pair : pairs) {
+            const auto channel = pair.upToFirstOccurrenceOf(":", false, false).getIntValue() - 1;
+            const auto controller = pair.fromFirstOccurrenceOf(":", false, false).getIntValue();
+            if (pair.contains(":") && channel >= 0 && channel < 16 &&
+                controller >= 0 && controller < 32)
+                controllers[static_cast<size_t>(channel)] |= 1u << controller;
+        }
+        return controllers;
+    }
     void defaultProfileSave_()
     {
-        const auto profilefile =
-            juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+        command_map_.toXMLDocument(defaultProfile_());
+    }
+    static juce::File defaultProfile_()
+    {
+        return juce::File::getSpecialLocation(juce::File::currentExecutableFile).
             getSiblingFile("default.xml");
-        command_map_.toXMLDocument(profilefile);
     }
-    void cerealSave_()
-    {//scoped so archive gets flushed
-        const auto controllerfile =
+    void captureStart_(const juce::String& command_line)
+    {// --record file captures MIDI input; --replay file or --replay-fast file plays a
+     // capture through the pipeline and writes replay.csv beside the executable
+        const auto args = juce::StringArray::fromTokens(command_line, true);
+        const auto argument = [&args](const juce::String& option) {
+            const auto index = args.indexOf(option);
+            return index >= 0 && index + 1 < args.size() ?
+                juce::File::getCurrentWorkingDirectory().getChildFile(args[index + 1].unquoted()) :
+                juce::File{};
+        };
+        const auto record = argument(RecordString);
+        if (record != juce::File{} && !midi_processor_->getRecorder().Start(record))
+            AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::error, "can't record to %s",
+                record.getFullPathName().toRawUTF8());
+        const auto fast = args.contains(ReplayFastString);
+        const auto replay = argument(fast ? ReplayFastString : ReplayString);
+        if (replay != juce::File{} && !midi_processor_->Replay(replay, fast, [](const juce::String& report) {
             juce::File::getSpecialLocation(juce::File::currentExecutableFile).
-            getSiblingFile("settings.bin").getFullPathName().toStdString();
-        std::ofstream outfile(controllerfile, std::ios::out |
-            std::ios::binary | std::ios::trunc);
-        if (outfile.is_open()) {
-            cereal::BinaryOutputArchive oarchive(outfile);
-            oarchive(controls_model_);
+                getSiblingFile("replay.csv").replaceWithText(report);
+        }))
+            AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::error, "can't replay %s",
+                replay.getFullPathName().toRawUTF8());
+    }
+
+    void mockStart_(const juce::String& command_line)
+    {// --mock-lightroom listens on the Lightroom ports in place of the plugin, so the
+     // link can be loaded without Lightroom. mock.csv is written beside the executable
+        const auto args = juce::StringArray::fromTokens(command_line, true);
+        if (!args.contains(MockString))
+            return;
+        MockLightroom::Options options;
+        const auto value = [&args](const juce::String& option, int fallback) {
+            const auto index = args.indexOf(option);
+            return index >= 0 && index + 1 < args.size() ? args[index + 1].getIntValue() : fallback;
+        };
+        options.burst = value(MockBurstString, options.burst);
+        options.interval = value(MockIntervalString, options.interval);
+        options.compact = args.contains(MockCompactString);
+        mock_lightroom_ = std::make_unique<MockLightroom>(options);
+        if (!mock_lightroom_->IsListening())
+            AsyncLog::Write(RSJ::LogCategory::ipc, RSJ::LogLevel::error,
+                "mock Lightroom can't listen, is Lightroom running?");
+    }
+    void mockSave_()
+    {
+        juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+            getSiblingFile("mock.csv").replaceWithText(mock_lightroom_->Report());
+    }
+
+    void headlessStart_()
+    {// no component tree: load the profile MainContentComponent would have
+        if (settings_manager_.getProfileDirectory().isEmpty()) {
+            const auto default_profile =
+                juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile("default.xml");
+            std::unique_ptr<juce::XmlElement> xml_element{juce::XmlDocument::parse(default_profile)};
+            if (xml_element && xml_element->getTagName() == "settings") {
+                const auto profile = CommandMap::CompileProfile(*xml_element);
+                command_map_.setMappings(profile.mappings, profile.macros);
+            }
         }
         else
+            profile_manager_.switchToProfile(0);
+        if (settings_manager_.getDiagnosticsInterval() > 0)
+            startTimer(kDiagnosticsTimer, settings_manager_.getDiagnosticsInterval() * 1000);
+    }
+    void statsQuery_(const juce::String& command_line)
+    {// --stats [file] writes the diagnostics report, --trace-dump [file] the pipeline
+     // trace since --trace-start (or start-up), and --reset-stats restarts the counts
+     // after any --stats. The launch that asked has exited by now, so results go to
+     // files: beside the executable unless given a full path
+        const auto args = juce::StringArray::fromTokens(command_line, true);
+        const auto file = [&args](const juce::String& option, const juce::String& fallback) {
+            const auto index = args.indexOf(option);
+            const auto named = index + 1 < args.size() && !args[index + 1].startsWith("--");
+            return juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile(named ? args[index + 1].unquoted() : fallback);
+        };
+        if (args.contains(StatsString))
+            file(StatsString, "stats.csv").replaceWithText(diagnosticsReport_());
+        if (args.contains(TraceDumpString))
+            file(TraceDumpString, "trace.json").replaceWithText(PipelineTrace::Dump());
+        if (args.contains(TraceStartString))
+            PipelineTrace::Clear();
+        if (args.contains(ResetStatsString)) {
+            midi_processor_->ResetStats();
+            lr_ipc_out_->getOutboundStats().Reset();
+            lr_ipc_out_->getPluginStats().Reset();
+            Instrumentation::ResetCounters();
+        }
+    }
+    juce::String diagnosticsReport_()
+    {// the report the Diagnostics button shows
+        auto report = midi_processor_->getLatencyStats().Report();
+        report << "\n" << ThreadStats::Report();
+        report << "\n" << lr_ipc_out_->getOutboundStats().Report();
+        if (settings_manager_.getAdaptiveRate())
+            report << "\n" << lr_ipc_out_->CongestionReport();
+        report << "\n" << midi_processor_->getActivityStats().Report();
+        report << "\n" << midi_processor_->getStartupTrace().Report();
+        report << "\n" << Instrumentation::Report();
+        report << "\n" << Instrumentation::MemoryReport();
+        report << "\n" << latency_watchdog_.Report();
+        report << "\n" << power_monitor_.Report();
+        if (settings_manager_.getRelayHost().isNotEmpty())
+            report << "\n" << lr_ipc_out_->getRelayStats().Report();
+        else if (settings_manager_.getHeartbeatTimeout() > 0)
+            report << "\n" << lr_ipc_out_->getLinkStats().Report();
+        if (settings_manager_.getLuaTiming() > 0)
+            report << "\n" << lr_ipc_out_->getPluginStats().Report();
+        if (relay_server_)
+            report << "\n" << relay_server_->Report();
+        if (mock_lightroom_)
+            report << "\n" << mock_lightroom_->Report();
+        return report;
+    }
+    void metricsPublish_()
+    {
+        if (metrics_server_ && midi_processor_)
+            metrics_server_->Publish(MetricsServer::Collect(midi_processor_->getLatencyStats()));
+    }
+    void diagnosticsSave_()
+    {
+        const auto report = diagnosticsReport_();
+        if (mock_lightroom_)
+            mockSave_();
+        juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+            getSiblingFile("diagnostics.csv").replaceWithText(report);
+        if (RSJ::kTracing)
+            juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+                getSiblingFile("trace.json").replaceWithText(PipelineTrace::Dump());
+    }
+    void timerCallback(int timer_id) override
+    {
+        PowerMonitor::CountWakeUp();
+        if (timer_id == kMetricsTimer) {
+            metricsPublish_();
+            return;
+        }
+        if (timer_id == kDiagnosticsTimer) {
+            if (midi_processor_ && lr_ipc_out_)
+                diagnosticsSave_();
+            return;
+        }
+        //save what changed off the message thread so a crash loses little. Each save
+        //replaces its file only once complete
+        const auto changes = controls_model_.getChangeCount();
+        if (changes != saved_change_count_) {
+            saved_change_count_ = changes;
+            save_pool_.addJob([this] { settingsSave_(false); });
+        }
+        const auto map_changes = command_map_.getChangeCount();
+        if (map_changes != saved_map_changes_) {
+            saved_map_changes_ = map_changes;
+            //a replaced map snapshot stays readable for a second, far longer than this takes
+            save_pool_.addJob([this] { command_map_.writeXml(defaultProfile_()); });
+        }
+    }
+    // device polls, autosave and latency checks stop while idle
+    void PowerCallback(bool idle)
+    {
+        const auto poll = idle ? 0 : settings_manager_.getDevicePollInterval();
+        if (midi_processor_)
+            midi_processor_->SetDevicePollInterval(poll);
+        if (midi_sender_)
+            midi_sender_->SetDevicePollInterval(poll);
+        latency_watchdog_.SetIdle(idle);
+        if (settings_manager_.getAutosaveInterval() > 0) {
+            if (idle) {
+                timerCallback(kAutosaveTimer); //whatever changed since the last autosave
+                stopTimer(kAutosaveTimer);
+            }
+            else
+                startTimer(kAutosaveTimer, settings_manager_.getAutosaveInterval() * 1000);
+        }
+    }
+    void settingsSave_(bool report_errors)
+    {
+        std::lock_guard<std::mutex> lock(save_mutex_);
+        const auto controllerfile =
+            juce::File::getSpecialLocation(juce::File::currentExecutableFile).
+            getSiblingFile("settings.bin");
+        //write beside the old file and swap, so an interrupted save keeps the last one
+        const auto tempfile = controllerfile.getSiblingFile("settings.bin.new");
+        const auto image = controls_model_.getImage();
+        auto saved = tempfile.replaceWithData(image.getData(), image.getSize());
+        if (saved)
+            saved = tempfile.moveFileTo(controllerfile);
+        if (!saved && report_errors)
             juce::AlertWindow::showNativeDialogBox("Error",
                 "Unable to save control settings. Unable to open file settings.bin.",
                 false);
     }
-    void cerealLoad_()
-    {//scoped so archive gets flushed
+    void settingsLoad_()
+    {
         const auto controllerfile =
             juce::File::getSpecialLocation(juce::File::currentExecutableFile).
-            getSiblingFile("settings.bin").getFullPathName().toStdString();
-        std::ifstream infile(controllerfile, std::ios::in | std::ios::binary);
+            getSiblingFile("settings.bin");
+        {//the image is read straight from the mapping
+            const juce::MemoryMappedFile mapped{controllerfile, juce::MemoryMappedFile::readOnly};
+            if (controls_model_.setImage(mapped.getData(), mapped.getSize()))
+                return;
+        }
+        //files from older versions are cereal archives, the next save replaces them
+        std::ifstream infile(controllerfile.getFullPathName().toStdString(),
+            std::ios::in | std::ios::binary);
         if (infile.is_open() && !infile.eof()) {
             cereal::BinaryInputArchive iarchive(infile);
             iarchive(controls_model_);
@@ -223,15 +699,31 @@ class MIDI2LRApplication final: public juce::JUCEApplication {
     ControlsModel controls_model_{};
     ProfileManager profile_manager_{&controls_model_, &command_map_};
     SettingsManager settings_manager_{&profile_manager_};
+    Scheduler scheduler_{}; //outlives the objects holding its tasks
+    LatencyWatchdog latency_watchdog_{&scheduler_};
+    PowerMonitor power_monitor_{&scheduler_};
+    std::unique_ptr<MockLightroom> mock_lightroom_{nullptr}; //listens before the link connects
     std::shared_ptr<LR_IPC_IN> lr_ipc_in_{std::make_shared<LR_IPC_IN>
         (&controls_model_, &profile_manager_, &command_map_)};
     std::shared_ptr<LR_IPC_OUT> lr_ipc_out_{std::make_shared<LR_IPC_OUT>
-        (&controls_model_, &command_map_)};
-    std::shared_ptr<MIDIProcessor> midi_processor_{std::make_shared<MIDIProcessor>()};
+        (&controls_model_, &command_map_, &scheduler_)};
+    MidiThru midi_thru_{}; //outlives midi_processor_ and midi_sender_, which send to it
+    std::shared_ptr<MIDIProcessor> midi_processor_{std::make_shared<MIDIProcessor>
+        (&command_map_, &controls_model_)};
     std::shared_ptr<MIDISender> midi_sender_{std::make_shared<MIDISender>()};
+    ControllerPresets controller_presets_{};
+    std::shared_ptr<RelayServer> relay_server_{nullptr};
+    std::unique_ptr<MetricsServer> metrics_server_{nullptr};
+    std::unique_ptr<ProfileSync> profile_sync_{nullptr};
+    std::shared_ptr<OscController> osc_controller_{nullptr};
+    std::shared_ptr<RtpMidiSession> rtp_midi_{nullptr}; //feeds midi_processor_
     std::unique_ptr<juce::LookAndFeel> look_feel{std::make_unique<juce::LookAndFeel_V3>()};
     std::unique_ptr<MainWindow> main_window_{nullptr};
     VersionChecker version_checker_{&settings_manager_};
+    juce::ThreadPool save_pool_{1};
+    std::mutex save_mutex_;
+    juce::uint64 saved_change_count_{0};
+    juce::uint32 saved_map_changes_{0};
 };
 
 //==============================================================================
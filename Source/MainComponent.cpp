@@ -21,17 +21,25 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "MainComponent.h"
+#include <algorithm>
 #include <string>
 #include <utility>
 #include <gsl/gsl>
+#include "ActivityComponent.h"
 #include "CommandMap.h"
+#include "CommandMenu.h"
+#include "Instrumentation.h"
+#include "LatencyWatchdog.h"
 #include "LR_IPC_Out.h" //base class
 #include "MIDIProcessor.h"
 #include "MIDISender.h"
 #include "MidiUtilities.h"
+#include "PipelineTrace.h"
+#include "PowerMonitor.h"
 #include "ProfileManager.h"
 #include "SettingsComponent.h"
 #include "SettingsManager.h"
+#include "ThreadStats.h"
 using namespace std::literals::string_literals;
 
 namespace {
@@ -47,7 +55,9 @@ namespace {
     constexpr int kFirstButtonX = kMainLeft;
     constexpr int kSecondButtonX = kMainLeft + kButtonXIncrement;
     constexpr int kThirdButtonX = kMainLeft + kButtonXIncrement * 2;
-    constexpr int kCommandTableHeight = kMainHeight - 210;
+    constexpr int kSearchY = 100;
+    constexpr int kCommandTableY = kSearchY + kStandardHeight + 5;
+    constexpr int kCommandTableHeight = kMainHeight - 110 - kCommandTableY;
     constexpr int kLabelWidth = kFullWidth / 2;
     constexpr int kProfileNameY = kMainHeight - 100;
     constexpr int kCommandLabelX = kMainLeft + kLabelWidth;
@@ -55,6 +65,12 @@ namespace {
     constexpr int kRemoveRowY = kMainHeight - 75;
     constexpr int kRescanY = kMainHeight - 50;
     constexpr int kCurrentStatusY = kMainHeight - 30;
+    constexpr int kColourTimer = 0; //command label highlight
+    constexpr int kRefreshTimer = 1; //throttled MIDI display
+    constexpr int kHighlightTime = 1000; //ms
+    constexpr juce::uint32 kRefreshInterval = 33; //ms, about 30 refreshes a second
+    constexpr int kHiddenPoll = 250; //ms between checks for the window showing again
+    constexpr size_t kNewRowLimit = 256; //unmapped messages waiting for a refresh
 }
 
 MainContentComponent::MainContentComponent(): ResizableLayout{this}
@@ -68,29 +84,44 @@ void MainContentComponent::Init(CommandMap* const command_map,
     std::shared_ptr<MIDIProcessor>& midi_processor,
     ProfileManager* const profile_manager,
     SettingsManager* const settings_manager,
-    std::shared_ptr<MIDISender>& midi_sender)
+    std::shared_ptr<MIDISender>& midi_sender,
+    LatencyWatchdog* const latency_watchdog,
+    PowerMonitor* const power_monitor)
 {
     //copy the pointers
     command_map_ = command_map;
+    profile_manager_ = profile_manager;
     lr_ipc_out_ = std::move(lr_ipc_out);
     settings_manager_ = settings_manager;
     midi_processor_ = midi_processor;
     midi_sender_ = midi_sender;
+    latency_watchdog_ = latency_watchdog;
+    power_monitor_ = power_monitor;
 
     //call the function of the sub component.
     command_table_model_.Init(command_map);
 
     if (midi_processor)
     // Add ourselves as a listener for MIDI commands
-        midi_processor->addCallback(this, &MainContentComponent::MIDIcmdCallback);
+        midi_processor->addCallback<MainContentComponent, &MainContentComponent::MIDIcmdCallback>(this);
 
     if (const auto ptr = lr_ipc_out_.lock())
     // Add ourselves as a listener for LR_IPC_OUT events
-        ptr->addCallback(this, &MainContentComponent::LRIpcOutCallback);
+        ptr->addCallback<MainContentComponent, &MainContentComponent::LRIpcOutCallback>(this);
 
-    if (profile_manager)
-    // Add ourselves as a listener for profile changes
-        profile_manager->addCallback(this, &MainContentComponent::profileChanged);
+    if (latency_watchdog)
+        latency_watchdog->addCallback<MainContentComponent, &MainContentComponent::WatchdogCallback>(
+            this, Delivery::message_thread);
+
+    if (power_monitor)
+        power_monitor->addCallback<MainContentComponent, &MainContentComponent::PowerCallback>(
+            this, Delivery::message_thread);
+
+    if (profile_manager) {
+        // Add ourselves as a listener for profile changes and loads
+        profile_manager->addCallback<MainContentComponent, &MainContentComponent::profileChanged>(this);
+        profile_manager->addLoadingCallback<MainContentComponent, &MainContentComponent::profileLoading>(this);
+    }
 
     //Set the component size
     setSize(kMainWidth, kMainHeight);
@@ -138,9 +169,17 @@ void MainContentComponent::Init(CommandMap* const command_map,
     addToLayout(&settings_button_, anchorMidLeft, anchorMidRight);
     addAndMakeVisible(settings_button_);
 
+    // Search box
+    search_box_.setTextToShowWhenEmpty("Filter by channel, cc/note/pitch or command",
+        juce::Colours::grey);
+    search_box_.addListener(this);
+    search_box_.setBounds(kMainLeft, kSearchY, kFullWidth, kStandardHeight);
+    addToLayout(&search_box_, anchorMidLeft, anchorMidRight);
+    addAndMakeVisible(search_box_);
+
     // Command Table
     command_table_.setModel(&command_table_model_);
-    command_table_.setBounds(kMainLeft, 100, kFullWidth, kCommandTableHeight);
+    command_table_.setBounds(kMainLeft, kCommandTableY, kFullWidth, kCommandTableHeight);
     addToLayout(&command_table_, anchorMidLeft, anchorMidRight);
     addAndMakeVisible(command_table_);
 
@@ -167,10 +206,17 @@ void MainContentComponent::Init(CommandMap* const command_map,
 
     // Rescan MIDI button
     rescan_button_.addListener(this);
-    rescan_button_.setBounds(kMainLeft, kRescanY, kFullWidth, kStandardHeight);
+    rescan_button_.setBounds(kMainLeft, kRescanY, kThirdButtonX - kSpaceBetweenButton - kMainLeft,
+        kStandardHeight);
     addToLayout(&rescan_button_, anchorMidLeft, anchorMidRight);
     addAndMakeVisible(rescan_button_);
 
+    // Diagnostics report button
+    latency_button_.addListener(this);
+    latency_button_.setBounds(kThirdButtonX, kRescanY, kButtonWidth, kStandardHeight);
+    addToLayout(&latency_button_, anchorMidLeft, anchorMidRight);
+    addAndMakeVisible(latency_button_);
+
     // adding the current status label, used for counting down.
     current_status_.setBounds(kMainLeft, kCurrentStatusY, kFullWidth, kStandardHeight);
     addToLayout(&current_status_, anchorMidLeft, anchorMidRight);
@@ -204,47 +250,78 @@ void MainContentComponent::paint(juce::Graphics& g)
 
 void MainContentComponent::MIDIcmdCallback(RSJ::MidiMessage mm)
 {
-    // Display the CC parameters and add/highlight row in table corresponding to the CC
+    // MIDI thread: keep the latest message and any new rows, the display catches up
+    // at most kRefreshInterval later
     RSJ::MsgIdEnum mt{RSJ::MsgIdEnum::CC};
-    juce::String commandtype{"CC"};
     switch (mm.message_type_byte) {//this is needed because mapping uses custom structure
-    case RSJ::kCCFlag: //this is default for mt and commandtype
+    case RSJ::kCCFlag: //this is default for mt
         break;
     case RSJ::kNoteOnFlag:
-        mt = RSJ::MsgIdEnum::NOTE;
-        commandtype = "NOTE ON";
-        break;
     case RSJ::kNoteOffFlag:
         mt = RSJ::MsgIdEnum::NOTE;
-        commandtype = "NOTE OFF";
         break;
     case RSJ::kPWFlag:
         mt = RSJ::MsgIdEnum::PITCHBEND;
-        commandtype = "PITCHBEND";
         break;
     default: //shouldn't receive any messages note categorized above
         Expects(0);
     }
-    mm.channel++; //used to 1-based channel numbers
-    last_command_ = juce::String(mm.channel) + ": " + commandtype +
-        juce::String(mm.number) + " [" + juce::String(mm.value) + "]";
-    command_table_model_.addRow(mm.channel, mm.number, mt);
-    row_to_select_ = static_cast<size_t>(command_table_model_.getRowForMessage(mm.channel, mm.number, mt));
-    triggerAsyncUpdate();
+    RSJ::MidiMessageId message{mm.channel + 1, mm.number, mt, mm.source}; //1-based channel
+    if (command_map_ && command_map_->getCommandIdforMessage(message) == CommandMap::kNoCommand) {
+        message.layer = command_map_->getLayer(); //learned onto the layer in use
+        std::lock_guard<decltype(mutex_new_rows_)> lock(mutex_new_rows_);
+        if (new_rows_.size() < kNewRowLimit &&
+            std::find(new_rows_.begin(), new_rows_.end(), message) == new_rows_.end())
+            new_rows_.push_back(message);
+    }
+    latest_message_.store(static_cast<juce::uint64>(static_cast<juce::uint16>(mm.message_type_byte |
+        mm.source << 8)) << 48 |
+        static_cast<juce::uint64>(static_cast<juce::uint16>(mm.channel)) << 32 |
+        static_cast<juce::uint64>(static_cast<juce::uint16>(mm.number)) << 16 |
+        static_cast<juce::uint16>(mm.value), std::memory_order_release);
+    if (!refresh_pending_.exchange(true, std::memory_order_acq_rel))
+        triggerAsyncUpdate();
 }
 
 void MainContentComponent::LRIpcOutCallback(bool connected)
 {
+    const auto ptr = lr_ipc_out_.lock();
     if (connected) {
-        connection_label_.setText("Connected to LR", juce::NotificationType::dontSendNotification);
+        auto text = juce::String{"Connected to LR"};
+        if (ptr)
+            text << " in " << juce::roundToInt(ptr->getConnectDelay()) << " ms";
+        connection_label_.setText(text, juce::NotificationType::dontSendNotification);
         connection_label_.setColour(juce::Label::backgroundColourId, juce::Colours::greenyellow);
     }
     else {
-        connection_label_.setText("Not connected to LR", juce::NotificationType::dontSendNotification);
+        auto text = juce::String{"Not connected to LR"};
+        if (ptr)
+            text << " since " << ptr->getStateChangeTime().toString(false, true);
+        connection_label_.setText(text, juce::NotificationType::dontSendNotification);
         connection_label_.setColour(juce::Label::backgroundColourId, juce::Colours::red);
     }
 }
 
+void MainContentComponent::WatchdogCallback(bool degraded)
+{
+    updates_paused_ = degraded;
+    degraded_text_ = degraded && latency_watchdog_ ?
+        "Degraded: " + latency_watchdog_->getCause() : juce::String{};
+    current_status_.setText(degraded_text_, juce::NotificationType::dontSendNotification);
+    current_status_.setColour(juce::Label::backgroundColourId,
+        degraded ? juce::Colours::orange : juce::Colours::white);
+    if (!degraded && refresh_pending_.load(std::memory_order_acquire))
+        Refresh_(); //catch up on what arrived while paused
+}
+
+void MainContentComponent::PowerCallback(bool idle)
+{
+    if (idle)
+        stopTimer(kRefreshTimer); //MIDI input posts nothing until the refresh it waits for
+    else if (refresh_pending_.load(std::memory_order_acquire))
+        Refresh_();
+}
+
 void MainContentComponent::buttonClicked(juce::Button* button)
 { //-V2009 overridden method
     if (button == &rescan_button_) {
@@ -259,6 +336,8 @@ void MainContentComponent::buttonClicked(juce::Button* button)
         if (const auto ptr = lr_ipc_out_.lock())
             ptr->sendCommand("FullRefresh 1\n"s);
     }
+    else if (button == &latency_button_)
+        ShowLatencyReport_();
     else if (button == &remove_row_button_) {
         if (command_table_.getNumRows() > 0) {
             command_table_model_.removeAllRows();
@@ -285,9 +364,12 @@ void MainContentComponent::buttonClicked(juce::Button* button)
             browser,
             true,
             juce::Colours::lightgrey};
-        if (dialog_box.show() && command_map_) {
+        if (dialog_box.show()) {
             const auto selected_file = browser.getSelectedFile(0).withFileExtension("xml");
-            command_map_->toXMLDocument(selected_file);
+            if (profile_manager_)
+                profile_manager_->saveProfile(selected_file);
+            else if (command_map_)
+                command_map_->toXMLDocument(selected_file);
         }
     }
     else if (button == &load_button_) {
@@ -337,11 +419,78 @@ void MainContentComponent::buttonClicked(juce::Button* button)
     }
 }
 
-void MainContentComponent::profileChanged(juce::XmlElement* xml_element, const juce::String& file_name)
+void MainContentComponent::ShowLatencyReport_()
+{
+    if (!midi_processor_)
+        return;
+    // latency since MIDI arrival, then how LR_IPC_OUT's queue is keeping up
+    auto report = midi_processor_->getLatencyStats().Report();
+    report << "\n" << ThreadStats::Report();
+    if (const auto ptr = lr_ipc_out_.lock()) {
+        report << "\n" << ptr->getOutboundStats().Report();
+        if (settings_manager_ && settings_manager_->getAdaptiveRate())
+            report << "\n" << ptr->CongestionReport();
+        if (settings_manager_ && settings_manager_->getRelayHost().isNotEmpty())
+            report << "\n" << ptr->getRelayStats().Report();
+        else if (settings_manager_ && settings_manager_->getHeartbeatTimeout() > 0)
+            report << "\n" << ptr->getLinkStats().Report();
+        if (settings_manager_ && settings_manager_->getLuaTiming() > 0)
+            report << "\n" << ptr->getPluginStats().Report();
+    }
+    report << "\n" << midi_processor_->getActivityStats().Report();
+    report << "\n" << midi_processor_->getStartupTrace().Report();
+    report << "\n" << Instrumentation::Report();
+    report << "\n" << Instrumentation::MemoryReport();
+    if (latency_watchdog_)
+        report << "\n" << latency_watchdog_->Report();
+    if (power_monitor_)
+        report << "\n" << power_monitor_->Report();
+    const auto choice = juce::AlertWindow::showYesNoCancelBox(juce::AlertWindow::InfoIcon,
+        "Diagnostics", report, "Save report", "Activity", "Close");
+    if (choice == 2) {
+        juce::DialogWindow::LaunchOptions dialog_options;
+        dialog_options.dialogTitle = "MIDI activity";
+        dialog_options.content.setOwned(new ActivityComponent{midi_processor_,
+            std::weak_ptr<LR_IPC_OUT>{lr_ipc_out_}});
+        dialog_options.escapeKeyTriggersCloseButton = true;
+        dialog_options.useNativeTitleBar = false;
+        dialog_options.resizable = false;
+        activity_dialog_.reset(dialog_options.create());
+        activity_dialog_->setVisible(true);
+        return;
+    }
+    if (choice != 1)
+        return;
+    juce::WildcardFileFilter wildcard_filter{"*.csv", juce::String::empty, "Diagnostics reports"};
+    juce::FileBrowserComponent browser{juce::FileBrowserComponent::canSelectFiles |
+        juce::FileBrowserComponent::saveMode |
+        juce::FileBrowserComponent::warnAboutOverwriting,
+        juce::File::getSpecialLocation(juce::File::userDocumentsDirectory),
+        &wildcard_filter, nullptr};
+    juce::FileChooserDialogBox dialog_box{"Save diagnostics report",
+        "Enter filename to save diagnostics report",
+        browser,
+        true,
+        juce::Colours::lightgrey};
+    if (dialog_box.show()) {
+        const auto file = browser.getSelectedFile(0).withFileExtension("csv");
+        file.replaceWithText(report);
+        if (RSJ::kTracing) //beside the report, for chrome://tracing or Perfetto
+            file.withFileExtension("json").replaceWithText(PipelineTrace::Dump());
+    }
+}
+
+void MainContentComponent::profileChanged(const RSJ::CompiledProfile& profile, const juce::String& file_name)
 { //-V2009 overridden method
-    command_table_model_.buildFromXml(xml_element);
+    // the table keeps the rows both profiles map, and the selection if it still exists
+    const auto selected = command_table_model_.showProfile(profile, command_table_.getSelectedRow());
     command_table_.updateContent();
+    if (selected >= 0)
+        command_table_.selectRow(selected, true);
+    else
+        command_table_.deselectAllRows();
     command_table_.repaint();
+    profile_name_ = file_name;
     profile_name_label_.setText(file_name, NotificationType::dontSendNotification);
     //  _systemTrayComponent.showInfoBubble(filename, "Profile loaded");
 
@@ -350,13 +499,19 @@ void MainContentComponent::profileChanged(juce::XmlElement* xml_element, const j
         ptr->sendCommand("FullRefresh 1\n"s);
 }
 
+void MainContentComponent::profileLoading(const juce::String& file_name, bool loading)
+{
+    profile_name_label_.setText(loading ? "Loading " + file_name + "..." : profile_name_,
+        NotificationType::dontSendNotification);
+}
+
 void MainContentComponent::SetTimerText(int time_value)
 {
     if (time_value > 0)
         current_status_.setText(juce::String::formatted("Hiding in %i Sec.", time_value),
             juce::NotificationType::dontSendNotification);
     else
-        current_status_.setText("", juce::NotificationType::dontSendNotification);
+        current_status_.setText(degraded_text_, juce::NotificationType::dontSendNotification);
 }
 
 void MainContentComponent::SetLabelSettings(juce::Label& label_to_set)
@@ -368,19 +523,87 @@ void MainContentComponent::SetLabelSettings(juce::Label& label_to_set)
 
 void MainContentComponent::handleAsyncUpdate()
 {
+    const auto elapsed = juce::Time::getMillisecondCounter() - last_refresh_;
+    if (elapsed >= kRefreshInterval)
+        Refresh_();
+    else
+        startTimer(kRefreshTimer, static_cast<int>(kRefreshInterval - elapsed));
+}
+
+void MainContentComponent::Refresh_()
+{
+    const TraceScope trace{"UI refresh"};
+    if (!isShowing() || updates_paused_) {
+        // leave refresh_pending_ set so MIDI input stops posting until we are seen
+        // and resumed
+        startTimer(kRefreshTimer, kHiddenPoll);
+        return;
+    }
+    stopTimer(kRefreshTimer);
+    refresh_pending_.store(false, std::memory_order_release); //later messages post again
+    last_refresh_ = juce::Time::getMillisecondCounter();
+    std::vector<RSJ::MidiMessageId> new_rows;
+    {
+        std::lock_guard<decltype(mutex_new_rows_)> lock(mutex_new_rows_);
+        new_rows.swap(new_rows_);
+    }
+    const auto rows = command_table_model_.getNumRows();
+    for (const auto& row : new_rows)
+        command_table_model_.addRow(row.channel, row.data, row.msg_id_type, row.source, row.layer);
+
+    const auto packed = latest_message_.load(std::memory_order_acquire);
+    const auto type = static_cast<short>(packed >> 48 & 0xFF);
+    const auto source = static_cast<short>(packed >> 56 & 0xFF);
+    const auto channel = static_cast<short>(packed >> 32 & 0xFFFF) + 1; //1-based channel numbers
+    const auto number = static_cast<short>(packed >> 16 & 0xFFFF);
+    const auto value = static_cast<short>(packed & 0xFFFF);
+    RSJ::MsgIdEnum mt{RSJ::MsgIdEnum::CC};
+    juce::String commandtype{"CC"};
+    switch (type) {
+    case RSJ::kNoteOnFlag:
+        mt = RSJ::MsgIdEnum::NOTE;
+        commandtype = "NOTE ON";
+        break;
+    case RSJ::kNoteOffFlag:
+        mt = RSJ::MsgIdEnum::NOTE;
+        commandtype = "NOTE OFF";
+        break;
+    case RSJ::kPWFlag:
+        mt = RSJ::MsgIdEnum::PITCHBEND;
+        commandtype = "PITCHBEND";
+        break;
+    default:
+        break;
+    }
     // Update the last command label and set its colour to green
-    command_label_.setText(last_command_, juce::NotificationType::dontSendNotification);
+    command_label_.setText(juce::String(channel) + ": " + commandtype + juce::String(number) +
+        " [" + juce::String(value) + "]", juce::NotificationType::dontSendNotification);
     command_label_.setColour(juce::Label::backgroundColourId, juce::Colours::greenyellow);
-    startTimer(1000);
+    startTimer(kColourTimer, kHighlightTime);
 
     // Update the command table to add and/or select row corresponding to midi command
+    if (command_table_model_.getNumRows() != rows)
+        command_table_.updateContent();
+    command_table_.selectRow(command_table_model_.getRowForMessage(channel, number, mt, source,
+        command_map_ ? command_map_->getLayer() : 0));
+}
+
+void MainContentComponent::textEditorTextChanged(juce::TextEditor& editor)
+{
+    command_table_model_.setFilter(editor.getText());
+    CommandMenu::setSearch(command_table_model_.getFilterCommands());
     command_table_.updateContent();
-    command_table_.selectRow(gsl::narrow_cast<int>(row_to_select_));
+    command_table_.repaint();
 }
 
-void MainContentComponent::timerCallback()
+void MainContentComponent::timerCallback(int timer_id)
 {
+    PowerMonitor::CountWakeUp();
+    if (timer_id == kRefreshTimer) {
+        Refresh_();
+        return;
+    }
     // reset the command label's background to white
     command_label_.setColour(juce::Label::backgroundColourId, juce::Colours::white);
-    juce::Timer::stopTimer();
+    stopTimer(kColourTimer);
 }
\ No newline at end of file
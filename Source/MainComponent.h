@@ -26,26 +26,33 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_MAINCOMPONENT_H_INCLUDED
 #define MIDI2LR_MAINCOMPONENT_H_INCLUDED
 
+#include <atomic>
 #include <memory>
+#include <mutex>
+#include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "CommandTable.h" //class member
 #include "CommandTableModel.h" //class member
 #include "ResizableLayout.h" //base class
 class CommandMap;
+class LatencyWatchdog;
 class LR_IPC_OUT;
 class MIDIProcessor;
 class MIDISender;
+class PowerMonitor;
 class ProfileManager;
 class SettingsManager;
 namespace RSJ {
+    struct CompiledProfile;
     struct MidiMessage;
 }
 
 class MainContentComponent final:
     public juce::Component,
     private juce::AsyncUpdater,
-    private juce::Timer,
+    private juce::MultiTimer,
     private juce::ButtonListener,
+    private juce::TextEditor::Listener,
     public ResizableLayout { //ResizableLayout.h
 public:
     MainContentComponent();
@@ -57,13 +64,22 @@ class MainContentComponent final:
         std::shared_ptr<MIDIProcessor>& midi_processor,
         ProfileManager* const profile_manager,
         SettingsManager* const settings_manager,
-        std::shared_ptr<MIDISender>& midi_sender);
+        std::shared_ptr<MIDISender>& midi_sender,
+        LatencyWatchdog* const latency_watchdog,
+        PowerMonitor* const power_monitor);
 
     void MIDIcmdCallback(RSJ::MidiMessage);
 
     void LRIpcOutCallback(bool);
 
-    void profileChanged(juce::XmlElement* elem, const juce::String& file_name);
+    // message thread: shows the watchdog's state and pauses updates while degraded
+    void WatchdogCallback(bool degraded);
+
+    // message thread: stops polling for the hidden window while idle
+    void PowerCallback(bool idle);
+
+    void profileChanged(const RSJ::CompiledProfile& profile, const juce::String& file_name);
+    void profileLoading(const juce::String& file_name, bool loading);
     void SetTimerText(int time_value);
 
 protected:
@@ -73,13 +89,20 @@ class MainContentComponent final:
     void paint(juce::Graphics&) override;
     // Button interface
     void buttonClicked(juce::Button* button) override;
+    void ShowLatencyReport_();
+    // TextEditor interface, filters the table and menus as the search is typed
+    void textEditorTextChanged(juce::TextEditor& editor) override;
     // AsyncUpdater interface
     void handleAsyncUpdate() override;
 
-    // Timer interface
-    void timerCallback() override;
+    // applies the latest MIDI input to the label and table, message thread
+    void Refresh_();
+
+    // MultiTimer interface
+    void timerCallback(int timer_id) override;
 
     CommandMap* command_map_{nullptr};
+    ProfileManager* profile_manager_{nullptr};
     CommandTable command_table_{"Table", nullptr};
     CommandTableModel command_table_model_{};
     juce::DropShadowEffect title_shadow_;
@@ -89,17 +112,30 @@ class MainContentComponent final:
     juce::Label profile_name_label_{"ProfileNameLabel", ""};
     juce::Label title_label_{"Title", "MIDI2LR"};
     juce::Label version_label_{"Version", "Version " + juce::String{ProjectInfo::versionString}};
-    juce::String last_command_;
+    juce::String profile_name_; //shown again if a profile fails to load
+    juce::TextButton latency_button_{"Diagnostics"};
     juce::TextButton load_button_{"Load"};
     juce::TextButton remove_row_button_{"Clear ALL rows"};
     juce::TextButton rescan_button_{"Rescan MIDI devices"};
     juce::TextButton save_button_{"Save"};
     juce::TextButton settings_button_{"Settings"};
+    juce::TextEditor search_box_{"Search"};
     SettingsManager* settings_manager_{nullptr};
-    size_t row_to_select_{0};
+    // from the MIDI thread: latest message packed as type, channel, number and value,
+    // and messages not yet in the table
+    std::atomic<juce::uint64> latest_message_{0};
+    std::atomic<bool> refresh_pending_{false};
+    std::mutex mutex_new_rows_;
+    std::vector<RSJ::MidiMessageId> new_rows_;
+    juce::uint32 last_refresh_{0};
+    bool updates_paused_{false}; //running degraded, message thread
+    juce::String degraded_text_; //shown in current_status_ when not counting down
+    LatencyWatchdog* latency_watchdog_{nullptr};
+    PowerMonitor* power_monitor_{nullptr};
     std::shared_ptr<MIDIProcessor> midi_processor_{nullptr};
     std::shared_ptr<MIDISender> midi_sender_{nullptr};
     std::unique_ptr<DialogWindow> settings_dialog_;
+    std::unique_ptr<DialogWindow> activity_dialog_;
     std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
 };
 
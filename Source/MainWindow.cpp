@@ -24,6 +24,7 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include "MainWindow.h"
 #include <utility>
 #include "MainComponent.h"
+#include "PowerMonitor.h"
 #include "SettingsManager.h"
 
 MainWindow::MainWindow(juce::String name): juce::DocumentWindow{name,
@@ -45,7 +46,9 @@ void MainWindow::Init(CommandMap* const command_map,
     std::shared_ptr<MIDIProcessor>& midi_processor,
     ProfileManager* const profile_manager,
     SettingsManager* const settings_manager,
-    std::shared_ptr<MIDISender>& midi_sender)
+    std::shared_ptr<MIDISender>& midi_sender,
+    LatencyWatchdog* const latency_watchdog,
+    PowerMonitor* const power_monitor)
 {
     // get the auto time setting
     auto_hide_counter_ = (settings_manager) ? settings_manager->getAutoHideTime() : 0;
@@ -55,11 +58,13 @@ void MainWindow::Init(CommandMap* const command_map,
 
     if (window_content_)
         window_content_->Init(command_map, std::move(lr_ipc_out),
-                              midi_processor, profile_manager, settings_manager, midi_sender);
+                              midi_processor, profile_manager, settings_manager, midi_sender,
+                              latency_watchdog, power_monitor);
 }
 
 void MainWindow::timerCallback()
 {
+    PowerMonitor::CountWakeUp();
     auto decreased_value = false;
 
     if (auto_hide_counter_ > 0) {
@@ -26,10 +26,12 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #include <memory>
 #include "../JuceLibraryCode/JuceHeader.h"
 class CommandMap;
+class LatencyWatchdog;
 class LR_IPC_OUT;
 class MIDIProcessor;
 class MIDISender;
 class MainContentComponent;
+class PowerMonitor;
 class ProfileManager;
 class SettingsManager;
 
@@ -43,7 +45,9 @@ class MainWindow final: private juce::DocumentWindow, private juce::Timer {
         std::shared_ptr<MIDIProcessor>& midi_processor,
         ProfileManager* const profile_manager,
         SettingsManager* const settings_manager,
-        std::shared_ptr<MIDISender>& midi_sender);
+        std::shared_ptr<MIDISender>& midi_sender,
+        LatencyWatchdog* const latency_watchdog,
+        PowerMonitor* const power_monitor);
 
     /* Note: Be careful if you override any DocumentWindow methods - the base
        class uses a lot of them, so by overriding you might break its functionality.
@@ -0,0 +1,133 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    MetricsServer.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "MetricsServer.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <utility>
+#include "Instrumentation.h"
+#include "LatencyStats.h"
+
+namespace {
+    constexpr int kStopWait = 1000;
+    constexpr int kAcceptWait = 250; //ms, also how soon the thread notices it should exit
+    constexpr int kReadWait = 1000; //for a scraper's request
+    constexpr size_t kRequestSize = 4096;
+    constexpr std::array<double, 3> kQuantiles{{0.5, 0.9, 0.99}};
+
+    // Prometheus label value: backslash, quote and newline escaped
+    std::string EscapeLabel(const juce::String& value)
+    {
+        std::string label;
+        for (const auto c : value.toStdString()) {
+            if (c == '\\' || c == '"')
+                label += '\\';
+            if (c == '\n')
+                label += "\\n";
+            else
+                label += c;
+        }
+        return label;
+    }
+}
+
+MetricsServer::MetricsServer(int port, const juce::String& address):
+    juce::Thread{"MetricsServer"}, snapshot_{std::make_shared<const std::string>()}
+{
+    listening_ = listener_.createListener(port, address);
+    if (listening_)
+        juce::Thread::startThread(2); //well below the MIDI and IPC threads
+}
+
+MetricsServer::~MetricsServer()
+{
+    juce::Thread::signalThreadShouldExit();
+    listener_.close(); //wakes the accept
+    juce::Thread::stopThread(kStopWait);
+}
+
+void MetricsServer::Publish(std::string text)
+{
+    std::atomic_store(&snapshot_, std::shared_ptr<const std::string>{
+        std::make_shared<const std::string>(std::move(text))});
+}
+
+std::string MetricsServer::Collect(const LatencyStats& latency)
+{
+    std::string text;
+    for (const auto gauges : {false, true}) {
+        const auto metric = gauges ? "midi2lr_gauge" : "midi2lr_counter";
+        text += std::string{"# TYPE "} + metric + (gauges ? " gauge\n" : " counter\n");
+        for (const auto& value : Instrumentation::Values(gauges))
+            text += std::string{metric} + "{name=\"" + EscapeLabel(value.first) + "\"} " +
+            std::to_string(value.second) + '\n';
+    }
+    text += "# TYPE midi2lr_latency_ms summary\n";
+    for (auto stage = 0; stage < LatencyStats::kStageCount; ++stage) {
+        const auto name = LatencyStats::StageName(static_cast<LatencyStats::Stage>(stage));
+        const auto& histogram = latency.Histogram(static_cast<LatencyStats::Stage>(stage));
+        for (const auto quantile : kQuantiles)
+            text += std::string{"midi2lr_latency_ms{stage=\""} + name + "\",quantile=\"" +
+            juce::String(quantile).toStdString() + "\"} " +
+            std::to_string(histogram.PercentileMs(quantile)) + '\n';
+        text += std::string{"midi2lr_latency_ms_count{stage=\""} + name + "\"} " +
+            std::to_string(histogram.Count()) + '\n';
+    }
+    text += "# TYPE midi2lr_memory_bytes gauge\n";
+    for (const auto& total : Instrumentation::MemoryTotals())
+        text += "midi2lr_memory_bytes{subsystem=\"" + EscapeLabel(total.first) + "\"} " +
+        std::to_string(total.second) + '\n';
+    return text;
+}
+
+void MetricsServer::run()
+{
+    while (!juce::Thread::threadShouldExit()) {
+        if (listener_.waitUntilReady(true, kAcceptWait) != 1)
+            continue;
+        const std::unique_ptr<juce::StreamingSocket> client{listener_.waitForNextConnection()};
+        if (client)
+            Serve_(*client);
+    }
+}
+
+void MetricsServer::Serve_(juce::StreamingSocket& client) const
+{
+    // one request per connection, answered and closed; only its first line matters
+    std::array<char, kRequestSize> request;
+    if (client.waitUntilReady(true, kReadWait) != 1)
+        return;
+    const auto read = client.read(request.data(), static_cast<int>(request.size()), false);
+    if (read <= 0)
+        return;
+    const std::string line{request.data(), std::find(request.data(), request.data() + read, '\n')};
+    std::string response;
+    if (line.compare(0, 13, "GET /metrics ") == 0 || line.compare(0, 6, "GET / ") == 0) {
+        const auto snapshot = std::atomic_load(&snapshot_);
+        response = "HTTP/1.0 200 OK\r\nContent-Type: text/plain; version=0.0.4\r\n"
+            "Content-Length: " + std::to_string(snapshot->size()) + "\r\n\r\n" + *snapshot;
+    }
+    else
+        response = "HTTP/1.0 404 Not Found\r\nContent-Length: 0\r\n\r\n";
+    client.write(response.data(), static_cast<int>(response.size()));
+}
@@ -0,0 +1,61 @@
+#pragma once
+/*
+  ==============================================================================
+
+    MetricsServer.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_METRICSSERVER_H_INCLUDED
+#define MIDI2LR_METRICSSERVER_H_INCLUDED
+
+#include <memory>
+#include <string>
+#include "../JuceLibraryCode/JuceHeader.h"
+class LatencyStats;
+
+// Serves the instrumentation counters and gauges, the pipeline latencies and the
+// memory accounts as Prometheus text on http://address:port/metrics, so many stations
+// can be watched from one place. The message thread collects a snapshot and publishes
+// it; the server's low-priority thread only reads the latest snapshot, so a scrape
+// never reaches the MIDI or IPC threads or anything they lock
+class MetricsServer final: private juce::Thread {
+public:
+    // address is the interface to listen on, 127.0.0.1 keeps it to this machine
+    MetricsServer(int port, const juce::String& address);
+    ~MetricsServer();
+    MetricsServer(const MetricsServer&) = delete;
+    MetricsServer& operator=(const MetricsServer&) = delete;
+    bool IsListening() const noexcept
+    {
+        return listening_;
+    }
+    // replaces what scrapes get. Any thread
+    void Publish(std::string text);
+    // the exposition text. Measures the memory accounts, so the message thread
+    static std::string Collect(const LatencyStats& latency);
+
+private:
+    // Thread interface
+    void run() override;
+    void Serve_(juce::StreamingSocket& client) const;
+
+    juce::StreamingSocket listener_;
+    bool listening_{false};
+    std::shared_ptr<const std::string> snapshot_; //only through std::atomic_load/store
+};
+
+#endif  // METRICSSERVER_H_INCLUDED
@@ -0,0 +1,161 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    MidiRecorder.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "MidiRecorder.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <utility>
+#include "MIDIProcessor.h"
+
+namespace {
+    // capture: kMagic, kVersion, then per message time (uint32), device, number and
+    // value (int16), type and channel (uint8). Little-endian
+    constexpr int kMagic = 0x524c324d; //"M2LR"
+    constexpr int kVersion = 1;
+    constexpr size_t kWriteBatch = 256;
+    constexpr std::chrono::milliseconds kIdleWait{100};
+    constexpr int kStopWait = 1000;
+    constexpr int kDrainWait = 200; //ms for the pipeline to finish the last messages
+    constexpr double kSpinWindow = 2.0; //ms before a message is due to stop sleeping
+}
+
+MidiRecorder::MidiRecorder(): juce::Thread{"MidiRecorder"}
+{}
+
+MidiRecorder::~MidiRecorder()
+{
+    Stop();
+}
+
+bool MidiRecorder::Start(const juce::File& file)
+{
+    Stop();
+    file.deleteFile();
+    auto stream = std::make_unique<juce::FileOutputStream>(file);
+    if (stream->failedToOpen() || !stream->writeInt(kMagic) || !stream->writeInt(kVersion))
+        return false;
+    stream_ = std::move(stream);
+    start_ = juce::Time::getMillisecondCounterHiRes();
+    recording_.store(true, std::memory_order_release);
+    juce::Thread::startThread();
+    return true;
+}
+
+void MidiRecorder::Stop()
+{
+    if (!recording_.exchange(false, std::memory_order_acq_rel))
+        return;
+    juce::Thread::signalThreadShouldExit();
+    queue_.wake();
+    juce::Thread::stopThread(kStopWait); //run writes what is queued before returning
+    if (stream_)
+        stream_->flush();
+    stream_.reset();
+}
+
+void MidiRecorder::run()
+{
+    std::array<CapturedMessage, kWriteBatch> batch;
+    for (;;) {
+        const auto exiting = juce::Thread::threadShouldExit();
+        const auto count = exiting ? queue_.pop_bulk(batch) : queue_.wait_pop_bulk(batch, kIdleWait);
+        for (size_t i = 0; i < count; ++i) {
+            const auto& captured = batch[i];
+            stream_->writeInt(static_cast<int>(captured.time));
+            stream_->writeShort(captured.message.device);
+            stream_->writeShort(captured.message.number);
+            stream_->writeShort(captured.message.value);
+            stream_->writeByte(static_cast<char>(captured.message.message_type_byte));
+            stream_->writeByte(static_cast<char>(captured.message.channel));
+        }
+        if (exiting && !count)
+            return;
+    }
+}
+
+bool MidiRecorder::Load(const juce::File& file, std::vector<CapturedMessage>& messages)
+{
+    juce::FileInputStream stream{file};
+    if (stream.failedToOpen() || stream.readInt() != kMagic || stream.readInt() != kVersion)
+        return false;
+    messages.clear();
+    constexpr juce::int64 kRecordSize = 12;
+    messages.reserve(static_cast<size_t>(stream.getNumBytesRemaining() / kRecordSize));
+    while (stream.getNumBytesRemaining() >= kRecordSize) {
+        CapturedMessage captured;
+        captured.time = static_cast<juce::uint32>(stream.readInt());
+        captured.message.device = stream.readShort();
+        captured.message.number = stream.readShort();
+        captured.message.value = stream.readShort();
+        captured.message.message_type_byte = static_cast<unsigned char>(stream.readByte());
+        captured.message.channel = static_cast<unsigned char>(stream.readByte());
+        if (captured.message.channel > 15)
+            return false; //not a capture of ours
+        messages.push_back(captured);
+    }
+    return true;
+}
+
+MidiReplay::MidiReplay(MIDIProcessor& processor, std::vector<CapturedMessage>&& messages,
+    bool fast, std::function<void(const juce::String&)> done): juce::Thread{"MidiReplay"},
+    processor_(processor), messages_{std::move(messages)}, fast_{fast}, done_{std::move(done)}
+{
+    juce::Thread::startThread();
+}
+
+MidiReplay::~MidiReplay()
+{
+    juce::Thread::stopThread(kStopWait);
+}
+
+void MidiReplay::run()
+{
+    processor_.getLatencyStats().Reset();
+    const auto dropped_before = processor_.getDroppedMessageCount();
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+    for (const auto& captured : messages_) {
+        if (juce::Thread::threadShouldExit())
+            return;
+        if (!fast_) {
+            const auto due = start + captured.time / 1000.0;
+            for (auto wait = due - juce::Time::getMillisecondCounterHiRes(); wait > 0.0;
+                wait = due - juce::Time::getMillisecondCounterHiRes())
+                if (wait > kSpinWindow)
+                    juce::Thread::wait(static_cast<int>(wait - kSpinWindow));
+                else
+                    juce::Thread::yield(); //sleeping is too coarse for the last ms
+        }
+        processor_.Inject(captured.message);
+    }
+    const auto seconds = std::max(1e-3, (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0);
+    juce::Thread::wait(kDrainWait);
+    juce::String report{"replay, value\n"};
+    report << "mode, " << (fast_ ? "as fast as possible" : "recorded pace") << "\n"
+        << "messages, " << juce::String(static_cast<juce::int64>(messages_.size())) << "\n"
+        << "seconds, " << juce::String(seconds, 3) << "\n"
+        << "messages/s, " << juce::String(static_cast<double>(messages_.size()) / seconds, 1) << "\n"
+        << "dropped, " << juce::String(processor_.getDroppedMessageCount() - dropped_before) << "\n"
+        << "\n" << processor_.getLatencyStats().Report();
+    if (done_)
+        done_(report);
+}
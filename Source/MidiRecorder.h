@@ -0,0 +1,96 @@
+#pragma once
+/*
+  ==============================================================================
+
+    MidiRecorder.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_MIDIRECORDER_H_INCLUDED
+#define MIDI2LR_MIDIRECORDER_H_INCLUDED
+
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiUtilities.h"
+#include "Utilities/Utilities.h"
+class MIDIProcessor;
+
+struct CapturedMessage {
+    juce::uint32 time{0}; //microseconds since recording started
+    RSJ::MidiMessage message{};
+};
+
+// Writes each message arriving from a MIDI device, with its arrival time, to a
+// compact binary capture, for replaying a session without the hardware. Device
+// threads only queue the message; the recorder's thread writes the file
+class MidiRecorder final: private juce::Thread {
+public:
+    MidiRecorder();
+    ~MidiRecorder();
+    MidiRecorder(const MidiRecorder&) = delete;
+    MidiRecorder& operator=(const MidiRecorder&) = delete;
+    // false if file can't be written. Replaces any recording in progress
+    bool Start(const juce::File& file);
+    void Stop();
+    // any thread, does nothing unless recording
+    void Record(const RSJ::MidiMessage& message) noexcept
+    {
+        if (recording_.load(std::memory_order_acquire) && !queue_.try_push({static_cast<juce::uint32>(
+            (juce::Time::getMillisecondCounterHiRes() - start_) * 1000.0), message}))
+            dropped_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // messages lost because the file writes fell behind
+    juce::uint64 Dropped() const noexcept
+    {
+        return dropped_.load(std::memory_order_relaxed);
+    }
+    static bool Load(const juce::File& file, std::vector<CapturedMessage>& messages);
+
+private:
+    constexpr static size_t kQueueCapacity = 4096;
+    // Thread interface
+    void run() override;
+    std::atomic<bool> recording_{false};
+    std::atomic<juce::uint64> dropped_{0};
+    double start_{0.0};
+    std::unique_ptr<juce::FileOutputStream> stream_; //recorder thread while recording
+    RSJ::mpsc_queue<CapturedMessage, kQueueCapacity> queue_;
+};
+
+// Feeds a capture back through MIDIProcessor as if from its devices, at the recorded
+// pace or as fast as it will go, then calls done on its own thread with the
+// throughput and latency report
+class MidiReplay final: private juce::Thread {
+public:
+    MidiReplay(MIDIProcessor& processor, std::vector<CapturedMessage>&& messages, bool fast,
+        std::function<void(const juce::String&)> done);
+    ~MidiReplay();
+    MidiReplay(const MidiReplay&) = delete;
+    MidiReplay& operator=(const MidiReplay&) = delete;
+
+private:
+    // Thread interface
+    void run() override;
+    MIDIProcessor& processor_;
+    const std::vector<CapturedMessage> messages_;
+    const bool fast_;
+    const std::function<void(const juce::String&)> done_;
+};
+
+#endif  // MIDIRECORDER_H_INCLUDED
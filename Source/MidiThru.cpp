@@ -0,0 +1,67 @@
+/*
+  ==============================================================================
+
+    MidiThru.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "MidiThru.h"
+#include <mutex>
+#include <gsl/gsl>
+#include "AsyncLog.h"
+
+bool MidiThru::Open(const juce::String& port_name, const juce::String& inputs, bool feedback)
+{
+    output_.reset();
+    port_name_ = port_name;
+    inputs_ = juce::StringArray::fromTokens(inputs, ";", "");
+    inputs_.trim();
+    inputs_.removeEmptyStrings();
+    all_inputs_ = inputs_.contains("*");
+    feedback_ = feedback;
+    if (port_name_.isEmpty())
+        return false;
+#ifdef _WIN32
+    const auto index = juce::MidiOutput::getDevices().indexOf(port_name_);
+    if (index >= 0)
+        output_.reset(juce::MidiOutput::openDevice(index));
+#else
+    output_.reset(juce::MidiOutput::createNewDevice(port_name_));
+#endif
+    if (!output_)
+        AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::error, "thru port %s can't be opened",
+            port_name_.toRawUTF8());
+    return output_ != nullptr;
+}
+
+bool MidiThru::Wants(const juce::String& input_name) const
+{
+    return output_ && input_name != port_name_ && (all_inputs_ || inputs_.contains(input_name));
+}
+
+void MidiThru::Send(const juce::MidiMessage& message)
+{
+    if (!output_)
+        return;
+    std::lock_guard<decltype(send_mutex_)> lock(send_mutex_);
+    output_->sendMessageNow(message);
+}
+
+void MidiThru::Send(const unsigned char* data, size_t size)
+{
+    if (output_ && size)
+        Send(juce::MidiMessage{data, gsl::narrow_cast<int>(size)});
+}
@@ -0,0 +1,72 @@
+#pragma once
+/*
+  ==============================================================================
+
+    MidiThru.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_MIDITHRU_H_INCLUDED
+#define MIDI2LR_MIDITHRU_H_INCLUDED
+
+#include <memory>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Misc.h"
+
+// Republishes what selected inputs receive, and optionally MIDI2LR's feedback, on
+// one output, so another application can use a controller MIDI2LR has open. On macOS
+// and Linux the output is a virtual port MIDI2LR creates. Windows has no virtual
+// ports, so there it is an existing output such as a loopMIDI cable. Inputs are
+// copied raw on their driver thread before anything else happens to them, so nothing
+// is queued in between
+class MidiThru {
+public:
+    MidiThru() = default;
+    MidiThru(const MidiThru&) = delete;
+    MidiThru& operator=(const MidiThru&) = delete;
+    // port_name: the virtual port to create, or on Windows the output to open. inputs:
+    // input names separated by ';', "*" for all. False if the port can't be opened.
+    // Call before MIDIProcessor and MIDISender Init
+    bool Open(const juce::String& port_name, const juce::String& inputs, bool feedback);
+    bool IsOpen() const noexcept
+    {
+        return output_ != nullptr;
+    }
+    // the port, which MIDIProcessor and MIDISender leave alone so nothing loops back
+    const juce::String& PortName() const noexcept
+    {
+        return port_name_;
+    }
+    // whether input_name's messages are copied
+    bool Wants(const juce::String& input_name) const;
+    bool WantsFeedback() const noexcept
+    {
+        return output_ && feedback_;
+    }
+    // any thread; inputs and feedback may send at once
+    void Send(const juce::MidiMessage& message);
+    void Send(const unsigned char* data, size_t size);
+
+private:
+    std::unique_ptr<juce::MidiOutput> output_{nullptr};
+    juce::String port_name_{};
+    juce::StringArray inputs_{};
+    bool all_inputs_{false};
+    bool feedback_{false};
+    RSJ::RelaxTTasSpinLock send_mutex_; //sends are brief, and the output isn't reentrant
+};
+
+#endif  // MIDITHRU_H_INCLUDED
@@ -21,46 +21,61 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 ==============================================================================
 */
 #include "MidiUtilities.h"
+#include <algorithm>
+#include <array>
+#include <mutex>
 #include <gsl/gsl>
 
-RSJ::MidiMessage::MidiMessage(const juce::MidiMessage& mm) noexcept(ndebug)
-{//anything not set below is set to zero by default constructor
-    const auto raw = mm.getRawData();
-    Expects(raw != nullptr);
-    message_type_byte = raw[0] >> 4;
-    channel = raw[0] & 0xF;
-    switch (message_type_byte) {
-    case kPWFlag:
-        value = (raw[2] << 7) | raw[1];
-        break;
-    case kCCFlag:
-    case kKeyPressureFlag:
-    case kNoteOffFlag:
-    case kNoteOnFlag:
-        value = raw[2];
-        number = raw[1];
-        break;
-    case kPgmChangeFlag:
-        number = raw[1];
-        break;
-    case kChanPressureFlag:
-        value = raw[1];
-        break;
-    case kSystemFlag:
-        break; //no action
-    default:
-        Expects(!"Default should be unreachable in ParseMidi");
+namespace {
+    // where a channel message's fields are, by status nibble: number is the first data
+    // byte times number, value the first times low plus the second times high. One
+    // table lookup decodes every type without branching on it
+    struct Layout {
+        short number;
+        short low;
+        short high;
+    };
+    constexpr std::array<Layout, 16> kLayouts{{{0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+        {0, 0, 0}, {0, 0, 0}, {0, 0, 0}, {0, 0, 0},
+        {1, 0, 1}, //note off
+        {1, 0, 1}, //note on
+        {1, 0, 1}, //key pressure
+        {1, 0, 1}, //CC
+        {1, 0, 0}, //program change
+        {0, 1, 0}, //channel pressure
+        {0, 1, 128}, //pitch wheel, 14 bits
+        {0, 0, 0}}}; //system, no action
+
+    std::array<juce::uint8, 3> Padded(const juce::MidiMessage& mm) noexcept(ndebug)
+    {
+        Expects(mm.getRawData() != nullptr);
+        std::array<juce::uint8, 3> raw{};
+        std::copy_n(mm.getRawData(), std::min(mm.getRawDataSize(), 3), raw.begin());
+        return raw;
     }
 }
 
+RSJ::MidiMessage::MidiMessage(const juce::MidiMessage& mm) noexcept(ndebug):
+    MidiMessage(Padded(mm).data())
+{}
+
+RSJ::MidiMessage::MidiMessage(const juce::uint8* raw) noexcept:
+    message_type_byte(static_cast<short>(raw[0] >> 4)), channel(static_cast<short>(raw[0] & 0xF))
+{
+    const auto& layout = kLayouts[static_cast<size_t>(message_type_byte)];
+    number = static_cast<short>(raw[1] * layout.number);
+    value = static_cast<short>(raw[1] * layout.low + raw[2] * layout.high);
+}
+
 RSJ::MidiMessageId::MidiMessageId(const MidiMessage& rhs) noexcept(ndebug):
-    channel(rhs.channel + 1), controller(rhs.number) //channel 1-based
+    channel(rhs.channel + 1), controller(rhs.number), source(rhs.source), layer(0) //channel 1-based
 {
     switch (rhs.message_type_byte) {//this is needed because mapping uses custom structure
     case kCCFlag:
         msg_id_type = MsgIdEnum::CC;
         break;
     case kNoteOnFlag:
+    case kNoteOffFlag: //a release, mapped as its note
         msg_id_type = MsgIdEnum::NOTE;
         break;
     case kPWFlag:
@@ -69,4 +84,45 @@ RSJ::MidiMessageId::MidiMessageId(const MidiMessage& rhs) noexcept(ndebug):
     default: //should be unreachable--MidiMessageId only handles a few message types
         Expects(0);
     }
-}
\ No newline at end of file
+}
+namespace {
+    std::mutex device_ids_mutex;
+    std::array<juce::String, RSJ::kDeviceIds> device_ids; //[0] stays empty, for any device
+}
+
+short RSJ::DeviceIndex(const juce::String& identifier)
+{
+    if (identifier.isEmpty())
+        return 0;
+    std::lock_guard<decltype(device_ids_mutex)> lock(device_ids_mutex);
+    for (size_t index = 1; index < device_ids.size(); ++index) {
+        if (device_ids[index] == identifier)
+            return static_cast<short>(index);
+        if (device_ids[index].isEmpty()) {
+            device_ids[index] = identifier;
+            return static_cast<short>(index);
+        }
+    }
+    return 0;
+}
+
+juce::String RSJ::DeviceIdentifier(short index)
+{
+    if (index <= 0 || index >= kDeviceIds)
+        return {};
+    std::lock_guard<decltype(device_ids_mutex)> lock(device_ids_mutex);
+    return device_ids[static_cast<size_t>(index)];
+}
+
+juce::StringArray RSJ::DeviceIdentifiers(const juce::StringArray& names)
+{
+    juce::StringArray identifiers;
+    for (auto idx = 0; idx < names.size(); ++idx) {
+        auto copies = 1;
+        for (auto earlier = 0; earlier < idx; ++earlier)
+            if (names[earlier] == names[idx])
+                ++copies;
+        identifiers.add(copies == 1 ? names[idx] : names[idx] + "#" + juce::String{copies});
+    }
+    return identifiers;
+}
@@ -24,7 +24,11 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #define MIDI2LR_MIDIUTILITIES_H_INCLUDED
 
 /* NOTE: Channel and Number are zero-based */
+#include <array>
+#include <cstdint>
 #include <functional>
+#include <memory>
+#include <string>
 #include "../JuceLibraryCode/JuceHeader.h"
 #include "Misc.h"
 
@@ -37,12 +41,43 @@ namespace RSJ {
     constexpr short kChanPressureFlag = 0xD; //Max Key Pressure
     constexpr short kPWFlag = 0xE;//Pitch Wheel
     constexpr short kSystemFlag = 0xF;
+    // channel of a ResolvedMessage from OSC, whose number is the CommandId: no MIDI
+    // control, and MidiMessageId channel 0, which no MIDI message has
+    constexpr short kOscChannel = -1;
+
+    // device I/O implementation. rtmidi requires building with MIDI2LR_RTMIDI, the
+    // RtMidi API macro for the platform (e.g. __WINDOWS_MM__, __MACOSX_CORE__) and
+    // rtmidi/RtMidi.cpp; otherwise JUCE is used
+    enum class MidiBackend {
+        juce, rtmidi
+    };
+
+    // compact indexes telling identical inputs apart, such as two of the same controller
+    // on its factory channel. 0 is any device; the rest are stable device identifiers,
+    // the input's name with "#n" on its nth copy, given an index on first use
+    constexpr short kDeviceIds = 8;
+    // index for identifier, 0 if it is empty or all indexes are taken. Any thread
+    short DeviceIndex(const juce::String& identifier);
+    // identifier for index, empty for 0 or one not given out. Any thread
+    juce::String DeviceIdentifier(short index);
+    // names as identifiers: the second and later copies of a name get "#2", "#3"...
+    juce::StringArray DeviceIdentifiers(const juce::StringArray& names);
+
+    // banks of mappings within one profile, switched by the layer commands without a
+    // reload. 0 is the base layer, whose mappings show through on every other layer
+    // that doesn't map the same control
+    constexpr short kLayers = 4;
+    constexpr int kSnapshots = 2; //"Capture Snapshot A" and B
+    constexpr int kResetGroups = 9; //"Reset Group Basic" to "Reset Group Camera Calibration"
+    constexpr int kBatchCommands = 3; //"Start Batch", "Commit Batch to Selection", "Discard Batch"
 
     struct MidiMessage {
         short message_type_byte{0};
         short channel{0};
         short number{0};
         short value{0};
+        short device{-1}; //MIDIProcessor input it arrived on, -1 if not known
+        short source{0}; //DeviceIndex of that input if it needs telling apart, else 0
         constexpr MidiMessage() noexcept
         {}
 
@@ -51,8 +86,51 @@ namespace RSJ {
         {}
 
         MidiMessage(const juce::MidiMessage& mm) noexcept(ndebug);
+
+        // from a message's status and data bytes without a juce::MidiMessage. raw
+        // points to three bytes; those past the message's length are ignored
+        explicit MidiMessage(const juce::uint8* raw) noexcept;
     };
 
+    // bytes in a channel message, status included, by status nibble. 0 for data
+    // bytes and for system messages, which aren't decoded
+    constexpr std::array<juce::uint8, 16> kMessageLength{{0, 0, 0, 0, 0, 0, 0, 0,
+        3, 3, 3, 3, 2, 2, 3, 0}};
+
+    // decodes a backend's packet of any number of channel messages, following running
+    // status, and calls receive with each. Real-time bytes, SysEx and other system
+    // messages are skipped, as is a message cut short by the end of the packet
+    template<class Receiver>
+    void DecodeMidi(const juce::uint8* bytes, size_t size, Receiver&& receive)
+    {
+        std::array<juce::uint8, 3> raw{};
+        for (size_t i = 0; i < size;) {
+            const auto byte = bytes[i];
+            if (byte >= 0xF8) { //real-time, may come between any two messages
+                ++i;
+                continue;
+            }
+            if (byte >= 0xF0) { //system common or SysEx: skip its data, ends running status
+                raw[0] = 0;
+                for (++i; i < size && bytes[i] < 0x80; ++i) {}
+                continue;
+            }
+            if (byte & 0x80)
+                raw[0] = bytes[i++];
+            else if (!raw[0]) { //data without a status
+                ++i;
+                continue;
+            }
+            const size_t data_bytes = kMessageLength[raw[0] >> 4] - 1u;
+            if (i + data_bytes > size)
+                return;
+            raw[1] = bytes[i];
+            raw[2] = data_bytes > 1 ? bytes[i + 1] : 0;
+            i += data_bytes;
+            receive(MidiMessage{raw.data()});
+        }
+    }
+
     enum class MsgIdEnum: short {
         NOTE, CC, PITCHBEND
     };
@@ -65,29 +143,38 @@ namespace RSJ {
             int pitch;
             int data;
         };
+        int source; //DeviceIndex, 0 for any device
+        int layer; //0 for the base layer
 
         constexpr MidiMessageId() noexcept:
         msg_id_type(MsgIdEnum::NOTE),
             channel(0),
-            data(0)
+            data(0),
+            source(0),
+            layer(0)
 
         {}
 
-        constexpr MidiMessageId(int ch, int dat, MsgIdEnum msgType) noexcept:
+        constexpr MidiMessageId(int ch, int dat, MsgIdEnum msgType, int src = 0, int lyr = 0) noexcept:
         msg_id_type(msgType),
             channel(ch),
-            data(dat)
+            data(dat),
+            source(src),
+            layer(lyr)
         {}
 
         MidiMessageId(const MidiMessage& rhs) noexcept(ndebug);
 
         constexpr bool operator==(const MidiMessageId &other) const noexcept
         {
-            return (msg_id_type == other.msg_id_type && channel == other.channel && data == other.data);
+            return (msg_id_type == other.msg_id_type && channel == other.channel && data == other.data &&
+                source == other.source && layer == other.layer);
         }
 
         constexpr bool operator<(const MidiMessageId& other) const noexcept
         {
+            if (layer != other.layer) return layer < other.layer;
+            if (source != other.source) return source < other.source;
             if (channel < other.channel) return true;
             if (channel == other.channel) {
                 if (data < other.data) return true;
@@ -96,6 +183,44 @@ namespace RSJ {
             return false;
         }
     };
+
+    // interned command: index into LRCommandList::LRStringList, continuing into
+    // NextPrevProfile. Flags are precomputed per id so subscribers needn't compare strings
+    using CommandId = juce::uint16;
+    enum CommandFlag: unsigned char {
+        kCommandUnmapped = 1, kCommandProfile = 2, kCommandPreviousProfile = 4, kCommandNextProfile = 8,
+        kCommandAction = 16, //buttons and other one-shot commands, not parameters
+        kCommandLayer = 32, kCommandPreviousLayer = 64, kCommandNextLayer = 128
+    };
+
+    // an extra command bound to a message (macro), sent along with the message's own
+    // command with value clamped to 0-1 after value * scale + offset
+    struct MacroTarget {
+        CommandId command_id{0};
+        float scale{1.0f};
+        float offset{0.0f};
+        double Apply(double value) const noexcept
+        {
+            const auto result = value * scale + offset;
+            return result < 0.0 ? 0.0 : result > 1.0 ? 1.0 : result;
+        }
+    };
+
+    // a message after the command map lookup and value conversion, computed once in
+    // MIDIProcessor and shared by every subscriber. command is nullptr if the message
+    // is not mapped. targets points into the command map's compiled macro table, which
+    // targets_owner keeps alive while the message is handled
+    struct ResolvedMessage {
+        MidiMessage message;
+        const std::string* command{nullptr};
+        CommandId command_id{0xFFFF};
+        unsigned char command_flags{0}; //RSJ::CommandFlag bits
+        const MacroTarget* targets{nullptr};
+        size_t target_count{0};
+        std::shared_ptr<const void> targets_owner{};
+        double value{0.0};
+        double time_stamp{0.0}; //juce::Time::getMillisecondCounterHiRes at arrival
+    };
 }
 // hash functions
 namespace std {
@@ -103,9 +228,19 @@ namespace std {
     struct hash<RSJ::MidiMessageId> {
         size_t operator()(const RSJ::MidiMessageId& k) const noexcept
         {
-            return hash<int_fast32_t>()((int_fast32_t(k.msg_id_type) << 8) |
-                int_fast32_t(k.channel) | (int_fast32_t(k.controller) << 16));
-        } //channel is one byte, messagetype is one byte, controller is two bytes
+            // each field in its own bits of a 64-bit key, so NRPN controllers keep their
+            // top bits where int_fast32_t is 32 bits, then mixed (SplitMix64's finalizer)
+            // so the neighbouring numbers a controller sends don't cluster in the buckets
+            auto key = static_cast<uint64_t>(static_cast<uint16_t>(k.msg_id_type)) |
+                static_cast<uint64_t>(static_cast<uint8_t>(k.channel)) << 16 |
+                static_cast<uint64_t>(static_cast<uint16_t>(k.controller)) << 24 |
+                static_cast<uint64_t>(static_cast<uint16_t>(k.source)) << 40 |
+                static_cast<uint64_t>(static_cast<uint8_t>(k.layer)) << 56;
+            key = (key ^ (key >> 30)) * 0xbf58476d1ce4e5b9;
+            key = (key ^ (key >> 27)) * 0x94d049bb133111eb;
+            return static_cast<size_t>(key ^ (key >> 31));
+        } //messagetype two bytes, channel one byte, controller two bytes, source two bytes,
+        //layer one byte
     };
 }
 
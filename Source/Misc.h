@@ -22,6 +22,8 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_MISC_H_INCLUDED
 #define MIDI2LR_MISC_H_INCLUDED
 #include <atomic>
+#include <chrono>
+#include <thread>
 
 #ifdef NDEBUG    // asserts disabled
 static constexpr bool ndebug = true;
@@ -37,6 +39,23 @@ static constexpr bool ndebug = false;
 #endif
 
 namespace RSJ {
+#ifdef MIDI2LR_SPINLOCK_STATS
+    constexpr bool kSpinLockStats = true;
+#else
+    constexpr bool kSpinLockStats = false; //define MIDI2LR_SPINLOCK_STATS to count contention
+#endif
+
+    struct SpinLockStats {
+        unsigned long long acquisitions{0};
+        unsigned long long contended{0}; //acquisitions that found the lock taken
+        unsigned long long spins{0}; //CPU_RELAX while waiting
+        unsigned long long yields{0}; //waits that gave up the time slice
+        double max_wait{0.0}; //longest wait for the lock, microseconds
+    };
+
+    // test-and-test-and-set lock for short critical sections. A waiter spins with
+    // doubling runs of CPU_RELAX, then yields, so a holder preempted on a busy
+    // 2-core machine gets the core back rather than the waiter burning it
     class RelaxTTasSpinLock {
     public:
         RelaxTTasSpinLock() = default;
@@ -47,17 +66,20 @@ namespace RSJ {
         RelaxTTasSpinLock& operator=(RelaxTTasSpinLock&& other) = delete;
         void lock() noexcept
         {
-            do {
-                while (flag.load(std::memory_order_relaxed))
-                    CPU_RELAX;//spin without expensive exchange
-            } while (flag.exchange(true, std::memory_order_acquire));
+            if (flag.load(std::memory_order_relaxed) || flag.exchange(true, std::memory_order_acquire))
+                LockContended_();
+            else
+                Count_();
         }
 
         bool try_lock() noexcept
         {
             if (flag.load(std::memory_order_relaxed)) //avoid cache invalidation if lock unavailable
                 return false;
-            return !flag.exchange(true, std::memory_order_acquire); //try to acquire lock
+            if (flag.exchange(true, std::memory_order_acquire)) //try to acquire lock
+                return false;
+            Count_();
+            return true;
         }
 
         void unlock() noexcept
@@ -65,8 +87,77 @@ namespace RSJ {
             flag.store(false, std::memory_order_release);
         }
 
+        // counters so far, all zero unless built with MIDI2LR_SPINLOCK_STATS. Any thread
+        SpinLockStats stats() const noexcept
+        {
+            SpinLockStats result;
+#ifdef MIDI2LR_SPINLOCK_STATS
+            result.acquisitions = acquisitions_.load(std::memory_order_relaxed);
+            result.contended = contended_.load(std::memory_order_relaxed);
+            result.spins = spins_.load(std::memory_order_relaxed);
+            result.yields = yields_.load(std::memory_order_relaxed);
+            result.max_wait = max_wait_.load(std::memory_order_relaxed);
+#endif
+            return result;
+        }
+
     private:
+        constexpr static unsigned kMaxBackoff = 64; //CPU_RELAX in the longest run before yielding
+
+        void LockContended_() noexcept
+        {
+#ifdef MIDI2LR_SPINLOCK_STATS
+            const auto start = std::chrono::steady_clock::now();
+#endif
+            unsigned long long spins{0};
+            unsigned long long yields{0};
+            unsigned backoff{1};
+            do {
+                while (flag.load(std::memory_order_relaxed)) { //spin without expensive exchange
+                    if (backoff <= kMaxBackoff) {
+                        for (unsigned i = 0; i < backoff; ++i)
+                            CPU_RELAX;
+                        spins += backoff;
+                        backoff *= 2;
+                    }
+                    else { //the holder is probably not running
+                        std::this_thread::yield();
+                        ++yields;
+                    }
+                }
+            } while (flag.exchange(true, std::memory_order_acquire));
+#ifdef MIDI2LR_SPINLOCK_STATS
+            //counters are only written while holding the lock, so need no read-modify-write
+            const auto wait = std::chrono::duration<double, std::micro>(
+                std::chrono::steady_clock::now() - start).count();
+            contended_.store(contended_.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+            spins_.store(spins_.load(std::memory_order_relaxed) + spins, std::memory_order_relaxed);
+            yields_.store(yields_.load(std::memory_order_relaxed) + yields, std::memory_order_relaxed);
+            if (wait > max_wait_.load(std::memory_order_relaxed))
+                max_wait_.store(wait, std::memory_order_relaxed);
+#else
+            static_cast<void>(spins);
+            static_cast<void>(yields);
+#endif
+            Count_();
+        }
+
+        void Count_() noexcept
+        {
+#ifdef MIDI2LR_SPINLOCK_STATS
+            acquisitions_.store(acquisitions_.load(std::memory_order_relaxed) + 1,
+                std::memory_order_relaxed);
+#endif
+        }
+
         std::atomic<bool> flag{false};
+#ifdef MIDI2LR_SPINLOCK_STATS
+        std::atomic<unsigned long long> acquisitions_{0};
+        std::atomic<unsigned long long> contended_{0};
+        std::atomic<unsigned long long> spins_{0};
+        std::atomic<unsigned long long> yields_{0};
+        std::atomic<double> max_wait_{0.0};
+#endif
     };
 }
 #endif  // MISC_H_INCLUDED
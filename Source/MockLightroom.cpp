@@ -0,0 +1,174 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    MockLightroom.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "MockLightroom.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include "LRCommands.h"
+
+namespace {
+    constexpr auto kHost = "127.0.0.1";
+    constexpr int kLrOutPort = 58763; //as LR_IPC_OUT and LR_IPC_IN
+    constexpr int kLrInPort = 58764;
+    constexpr int kStopWait = 1000;
+    constexpr int kPollWait = 1; //ms waiting for data on each pass
+    constexpr double kSecond = 1000.0;
+    constexpr size_t kReadSize = 65536;
+    constexpr char kCompactMark = '#';
+}
+
+MockLightroom::MockLightroom(const Options& options): juce::Thread{"MockLightroom"},
+    options_(options)
+{
+    listening_ = out_listener_.createListener(kLrOutPort, kHost) &&
+        in_listener_.createListener(kLrInPort, kHost);
+    if (listening_)
+        juce::Thread::startThread();
+}
+
+MockLightroom::~MockLightroom()
+{
+    juce::Thread::stopThread(kStopWait);
+}
+
+void MockLightroom::run()
+{
+    auto second_start = juce::Time::getMillisecondCounterHiRes();
+    auto last_burst = second_start;
+    while (!juce::Thread::threadShouldExit()) {
+        Accept_();
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        Receive_(now);
+        if (in_client_ && options_.interval > 0 && now - last_burst >= options_.interval) {
+            SendBurst_();
+            last_burst = now;
+        }
+        if (now - second_start >= kSecond) {
+            const auto lines = lines_this_second_.exchange(0, std::memory_order_relaxed);
+            lines_last_second_.store(lines, std::memory_order_relaxed);
+            if (lines > peak_lines_.load(std::memory_order_relaxed))
+                peak_lines_.store(lines, std::memory_order_relaxed);
+            second_start = now;
+            if (profile_.isNotEmpty() && ping_sent_ == 0.0 && in_client_) {
+                Send_("SwitchProfile " + profile_.toStdString() + "\n");
+                ping_sent_ = now;
+            }
+        }
+        if (!out_client_)
+            juce::Thread::wait(kPollWait);
+    }
+}
+
+void MockLightroom::Accept_()
+{
+    if (!out_client_ && out_listener_.waitUntilReady(true, 0) == 1) {
+        out_client_.reset(out_listener_.waitForNextConnection());
+        partial_.clear();
+    }
+    if (!in_client_ && in_listener_.waitUntilReady(true, 0) == 1) {
+        in_client_.reset(in_listener_.waitForNextConnection());
+        ping_sent_ = 0.0;
+        if (options_.compact)
+            Send_("CompactProtocol 1 " + std::to_string(LRCommandList::kCommandHash) + "\n");
+    }
+}
+
+void MockLightroom::Receive_(double now)
+{
+    if (!out_client_ || out_client_->waitUntilReady(true, kPollWait) != 1)
+        return;
+    std::array<char, kReadSize> buffer;
+    const auto read = out_client_->read(buffer.data(), static_cast<int>(buffer.size()), false);
+    if (read <= 0) { //closed
+        out_client_.reset();
+        return;
+    }
+    bytes_.fetch_add(static_cast<juce::uint64>(read), std::memory_order_relaxed);
+    partial_.append(buffer.data(), static_cast<size_t>(read));
+    size_t begin = 0;
+    for (auto end = partial_.find('\n'); end != std::string::npos; end = partial_.find('\n', begin)) {
+        Line_(partial_.data() + begin, partial_.data() + end, now);
+        begin = end + 1;
+    }
+    partial_.erase(0, begin);
+}
+
+void MockLightroom::Line_(const char* begin, const char* end, double now)
+{
+    lines_.fetch_add(1, std::memory_order_relaxed);
+    lines_this_second_.fetch_add(1, std::memory_order_relaxed);
+    if (begin != end && *begin == kCompactMark) {
+        compact_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    constexpr char kChangedToFile[] = "ChangedToFile ";
+    constexpr auto kPrefix = sizeof kChangedToFile - 1;
+    if (static_cast<size_t>(end - begin) > kPrefix && std::memcmp(begin, kChangedToFile, kPrefix) == 0) {
+        profile_ = juce::String::fromUTF8(begin + kPrefix, static_cast<int>(end - begin - kPrefix));
+        if (ping_sent_ != 0.0) {
+            round_trip_.Record(now - ping_sent_);
+            ping_sent_ = 0.0;
+        }
+    }
+}
+
+void MockLightroom::SendBurst_()
+{
+    // like the plugin's refresh after a photo change: one framed write
+    const auto& names = LRCommandList::LRStringList;
+    const auto count = std::min(static_cast<size_t>(std::max(options_.burst, 0)), names.size() - 1);
+    std::string burst{"Snapshot 1\n"};
+    for (size_t i = 1; i <= count; ++i) { //0 is Unmapped
+        const auto value = static_cast<double>((i * 37 + bursts_sent_ * 11) % 100) / 100.0;
+        burst += names[i] + ' ' + std::to_string(value) + '\n';
+    }
+    burst += "EndSnapshot 1\n";
+    ++bursts_sent_;
+    Send_(burst);
+    bursts_.fetch_add(1, std::memory_order_relaxed);
+    sent_lines_.fetch_add(count, std::memory_order_relaxed);
+}
+
+void MockLightroom::Send_(const std::string& text)
+{
+    if (in_client_ && in_client_->write(text.data(), static_cast<int>(text.size())) < 0)
+        in_client_.reset(); //closed
+}
+
+juce::String MockLightroom::Report() const
+{
+    juce::String report{"mock lightroom, value\n"};
+    report << "listening, " << (listening_ ? "yes" : "no, port in use") << "\n"
+        << "lines received, " << juce::String(lines_.load(std::memory_order_relaxed)) << "\n"
+        << "compact records, " << juce::String(compact_.load(std::memory_order_relaxed)) << "\n"
+        << "bytes received, " << juce::String(bytes_.load(std::memory_order_relaxed)) << "\n"
+        << "lines/s last second, " << juce::String(lines_last_second_.load(std::memory_order_relaxed)) << "\n"
+        << "lines/s peak, " << juce::String(peak_lines_.load(std::memory_order_relaxed)) << "\n"
+        << "feedback bursts, " << juce::String(bursts_.load(std::memory_order_relaxed)) << "\n"
+        << "feedback lines sent, " << juce::String(sent_lines_.load(std::memory_order_relaxed)) << "\n"
+        << "round trips, " << juce::String(round_trip_.Count()) << "\n"
+        << "round trip p50 ms, " << juce::String(round_trip_.PercentileMs(0.5), 3) << "\n"
+        << "round trip p99 ms, " << juce::String(round_trip_.PercentileMs(0.99), 3) << "\n"
+        << "round trip max ms, " << juce::String(round_trip_.MaxMs(), 3) << "\n";
+    return report;
+}
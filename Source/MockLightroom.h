@@ -0,0 +1,87 @@
+#pragma once
+/*
+  ==============================================================================
+
+    MockLightroom.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_MOCKLIGHTROOM_H_INCLUDED
+#define MIDI2LR_MOCKLIGHTROOM_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LatencyStats.h"
+
+// Stands in for the plugin on the Lightroom ports, so LR_IPC_OUT and LR_IPC_IN can
+// be load-tested without Lightroom. It counts what MIDI2LR sends, sends bursts of
+// feedback framed as the plugin frames a photo change, and times a round trip:
+// SwitchProfile to the current profile, answered by ChangedToFile
+class MockLightroom final: private juce::Thread {
+public:
+    struct Options {
+        int burst{150}; //feedback lines per burst, taken in command order
+        int interval{1000}; //ms between bursts, 0 for none
+        bool compact{false}; //announce the compact protocol
+    };
+    explicit MockLightroom(const Options& options);
+    ~MockLightroom();
+    MockLightroom(const MockLightroom&) = delete;
+    MockLightroom& operator=(const MockLightroom&) = delete;
+    // false if a port is taken, e.g. by Lightroom
+    bool IsListening() const noexcept
+    {
+        return listening_;
+    }
+    juce::String Report() const;
+    juce::uint64 LinesReceived() const noexcept
+    {
+        return lines_.load(std::memory_order_relaxed);
+    }
+
+private:
+    // Thread interface
+    void run() override;
+    void Accept_();
+    void Receive_(double now);
+    void Line_(const char* begin, const char* end, double now);
+    void SendBurst_();
+    void Send_(const std::string& text);
+    const Options options_;
+    bool listening_{false};
+    juce::StreamingSocket out_listener_; //LR_IPC_OUT connects here
+    juce::StreamingSocket in_listener_; //LR_IPC_IN connects here
+    std::unique_ptr<juce::StreamingSocket> out_client_; //mock thread only
+    std::unique_ptr<juce::StreamingSocket> in_client_; //mock thread only
+    std::string partial_; //unfinished line from out_client_, mock thread only
+    juce::String profile_; //latest ChangedToFile, mock thread only
+    double ping_sent_{0.0}; //0 when no round trip is outstanding, mock thread only
+    juce::uint32 bursts_sent_{0}; //varies the values, mock thread only
+    std::atomic<juce::uint64> lines_{0};
+    std::atomic<juce::uint64> bytes_{0};
+    std::atomic<juce::uint64> compact_{0};
+    std::atomic<juce::uint64> lines_this_second_{0};
+    std::atomic<juce::uint64> lines_last_second_{0};
+    std::atomic<juce::uint64> peak_lines_{0};
+    std::atomic<juce::uint64> sent_lines_{0};
+    std::atomic<juce::uint64> bursts_{0};
+    LatencyHistogram round_trip_;
+};
+
+#endif  // MOCKLIGHTROOM_H_INCLUDED
@@ -21,73 +21,90 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 ==============================================================================
 */
 #include "NrpnMessage.h"
+#include "AsyncLog.h"
 
-bool NRPN_Message::ProcessMidi(short control,
-    short value) noexcept(ndebug)
+bool NRPN_Message::ProcessMidi(short control, short value,
+    RSJ::NRPN& completed) noexcept(ndebug)
 {
     Expects(value <= 0x7Fu);
     Expects(control <= 0x7Fu);
-    auto ret_val = true;
+    completed = RSJ::invalidNRPN;
+    if (completion_ == RSJ::NrpnCompletion::on_msb)
+        return ProcessOnMsb_(control, value, completed);
     switch (control) {
     case 6:
-    {
-        std::lock(data_guard_, queue_guard_);
-        std::lock_guard<decltype(data_guard_)> dlock(data_guard_, std::adopt_lock);
-        std::lock_guard<decltype(queue_guard_)> qlock(queue_guard_, std::adopt_lock);
-        if (ready_ >= 0b11) {
-            SetValueMSB_(value);
-            if (IsReady_()) {
-                nrpn_queued_.emplace(true, GetControl_(), GetValue_());
-                Clear_();
-            }
+        if (ready_ < 0b11) {
+            AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::debug,
+                "NRPN data entry MSB %d without a parameter number, passed on as CC 6", value);
+            return false;
         }
-        else
-            ret_val = false;
+        SetValueMSB_(value);
         break;
-    }
     case 38u:
-    {
-        std::lock(data_guard_, queue_guard_);
-        std::lock_guard<decltype(data_guard_)> dlock(data_guard_, std::adopt_lock);
-        std::lock_guard<decltype(queue_guard_)> qlock(queue_guard_, std::adopt_lock);
-        if (ready_ >= 0b11) {
-            SetValueLSB_(value);
-            if (IsReady_()) {
-                nrpn_queued_.emplace(true, GetControl_(), GetValue_());
-                Clear_();
-            }
-        }
-        else
-            ret_val = false;
+        if (ready_ < 0b11)
+            return false;
+        SetValueLSB_(value);
         break;
-    }
     case 98u:
-    {
-        std::lock_guard<decltype(data_guard_)> lock(data_guard_);
         SetControlLSB_(value);
-    }
-    break;
+        return true;
     case 99u:
-    {
-        std::lock_guard<decltype(data_guard_)> lock(data_guard_);
         SetControlMSB_(value);
-    }
-    break;
+        return true;
     default: //not an expected nrpn control #, handle as typical midi message
-        ret_val = false;
+        return false;
     }
-    return ret_val;
+    if (IsReady_()) {
+        completed = {true, GetControl_(), GetValue_()};
+        Clear_();
+    }
+    return true;
 }
 
-RSJ::NRPN NRPN_Message::GetNRPNifReady() noexcept
+bool NRPN_Message::ProcessOnMsb_(short control, short value,
+    RSJ::NRPN& completed) noexcept(ndebug)
 {
-    std::lock_guard<decltype(queue_guard_)> lock(queue_guard_);
-    if (!nrpn_queued_.empty()) {
-        const auto retval{nrpn_queued_.front()};
-        nrpn_queued_.pop();
-        return retval;
+    switch (control) {
+    case 6:
+        if ((ready_ & 0b11) != 0b11)
+            return false;
+        if (ready_ & 0b100) //the previous MSB had no LSB
+            lsb_follows_ = false;
+        SetValueMSB_(value);
+        value_lsb_ = 0;
+        msb_time_ = juce::Time::getMillisecondCounter();
+        completed = {true, GetControl_(), GetValue_(), lsb_follows_};
+        break;
+    case 38u:
+        if ((ready_ & 0b11) != 0b11)
+            return false;
+        // refine the value just sent; a late or unpaired LSB is consumed silently
+        if ((ready_ & 0b100) && juce::Time::getMillisecondCounter() - msb_time_
+            <= static_cast<juce::uint32>(lsb_window_)) {
+            SetValueLSB_(value);
+            lsb_follows_ = true;
+            completed = {true, GetControl_(), GetValue_()};
+        }
+        else {
+            lsb_follows_ = false; //so the next MSB is sent whole
+            AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::debug,
+                "NRPN %d LSB %d unpaired or later than %d ms, dropped", GetControl_(), value,
+                lsb_window_);
+        }
+        ready_ = 0b11; //keep parameter number for running status
+        break;
+    case 98u:
+        SetControlLSB_(value);
+        ready_ &= 0b11;
+        break;
+    case 99u:
+        SetControlMSB_(value);
+        ready_ &= 0b11;
+        break;
+    default: //not an expected nrpn control #, handle as typical midi message
+        return false;
     }
-    return RSJ::invalidNRPN;
+    return true;
 }
 
 void NRPN_Message::Clear_() noexcept
@@ -24,9 +24,8 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #define MIDI2LR_NRPNMESSAGE_H_INCLUDED
 
 #include <array>
-#include <mutex>
-#include <queue>
 #include <gsl/gsl>
+#include "../JuceLibraryCode/JuceHeader.h"
 #include "Misc.h"
 
 namespace RSJ {
@@ -34,27 +33,44 @@ namespace RSJ {
         bool isValid{false};
         short control{0};
         short value{0};
+        bool partial{false}; //sent on its MSB, with an LSB expected to refine it
         constexpr NRPN() = default;
-        constexpr NRPN(bool validity, short controlno, short valueval) noexcept:
-        isValid{validity}, control{controlno}, value{valueval}
+        constexpr NRPN(bool validity, short controlno, short valueval,
+            bool partialval = false) noexcept:
+        isValid{validity}, control{controlno}, value{valueval}, partial{partialval}
         {}
     };
     static constexpr NRPN invalidNRPN{false, 0, 0};
+
+    // full: emit once parameter and both value bytes (99, 98, 6, 38) have arrived
+    // on_msb: emit on 6, emit again if 38 follows within the LSB window, and keep
+    // the parameter number for running-status data entry. Once the channel's LSBs
+    // are seen to follow, the value sent on 6 is marked partial, so relative controls
+    // can wait for the LSB instead of stepping twice
+    enum class NrpnCompletion {
+        full, on_msb
+    };
 }
 
 class NRPN_Message {
     // This is a simplified NRPN message class, and assumes that all NRPN messages
     // have 4 messages, though the NRPN standard allows omission of the 4th
     // message. If the 4th message is dropped, this class silently consumes the
-    // message without emitting anything.
+    // message without emitting anything. Use NrpnCompletion::on_msb for
+    // controllers that send only the value MSB.
+    // Single writer: no locking. Each MIDI input device has its own filter, and
+    // only that device's callback thread (or the dispatch thread) feeds it.
 public:
     NRPN_Message() = default;
     ~NRPN_Message() = default;
     bool IsInProcess() const noexcept;
-    bool ProcessMidi(short control, short value) noexcept(ndebug);
-    RSJ::NRPN GetNRPNifReady() noexcept;
+    // returns true if control is part of an NRPN sequence. completed is set to the
+    // assembled NRPN when the sequence finishes, else to invalidNRPN
+    bool ProcessMidi(short control, short value, RSJ::NRPN& completed) noexcept(ndebug);
+    void SetCompletion(RSJ::NrpnCompletion completion, int lsb_window) noexcept;
 
 private:
+    bool ProcessOnMsb_(short control, short value, RSJ::NRPN& completed) noexcept(ndebug);
     bool IsReady_() const noexcept;
     short GetControl_() const noexcept;
     short GetValue_() const noexcept;
@@ -64,24 +80,26 @@ class NRPN_Message {
     void SetValueLSB_(short val) noexcept(ndebug);
     void SetValueMSB_(short val) noexcept(ndebug);
 
-    mutable RSJ::RelaxTTasSpinLock data_guard_;
-    mutable RSJ::RelaxTTasSpinLock queue_guard_;
     short control_lsb_{0};
     short control_msb_{0};
     short value_lsb_{0};
     short value_msb_{0};
-    std::queue<RSJ::NRPN> nrpn_queued_{};
     unsigned char ready_{0};
+    RSJ::NrpnCompletion completion_{RSJ::NrpnCompletion::full};
+    int lsb_window_{0}; //ms after value MSB during which LSB refines the value
+    juce::uint32 msb_time_{0};
+    bool lsb_follows_{false}; //the last value MSB was refined by its LSB
 };
 
 class NRPN_Filter {
 public:
     NRPN_Filter() = default;
     ~NRPN_Filter() = default;
-    bool ProcessMidi(short channel, short control, short value) noexcept(ndebug)
+    bool ProcessMidi(short channel, short control, short value,
+        RSJ::NRPN& completed) noexcept(ndebug)
     {
         Expects(channel <= 15 && channel >= 0);
-        return nrpn_messages_[(channel) & 0xF].ProcessMidi(control, value);
+        return nrpn_messages_[(channel) & 0xF].ProcessMidi(control, value, completed);
     }
 
     bool IsInProcess(short channel) const noexcept(ndebug)
@@ -90,22 +108,74 @@ class NRPN_Filter {
         return nrpn_messages_[(channel) & 0xF].IsInProcess();
     }
 
-    RSJ::NRPN GetNRPNifReady(short channel) noexcept(ndebug)
+    void SetCompletion(short channel, RSJ::NrpnCompletion completion,
+        int lsb_window) noexcept(ndebug)
     {
         Expects(channel <= 15 && channel >= 0);
-        return nrpn_messages_[(channel) & 0xF].GetNRPNifReady();
+        nrpn_messages_[(channel) & 0xF].SetCompletion(completion, lsb_window);
     }
 
 private:
     std::array<NRPN_Message, 16> nrpn_messages_{};
 };
 
+class CC14_Filter {
+    // Pairs CC 0-31 (MSB) with CC 32-63 (LSB) on controllers enabled per channel,
+    // as one 14-bit value under the MSB's number. As the 14-bit CC spec allows, an
+    // MSB is emitted at once with its LSB 0 and marked partial, and the LSB that
+    // follows emits the refined value; an LSB alone reuses the last MSB. So a coarse
+    // move with no LSB still arrives. Single writer, like NRPN_Filter.
+public:
+    CC14_Filter() = default;
+    ~CC14_Filter() = default;
+    void SetControllers(short channel, juce::uint32 controllers) noexcept(ndebug)
+    {
+        Expects(channel <= 15 && channel >= 0);
+        controllers_[(channel) & 0xF] = controllers;
+    }
+
+    // returns true if control is part of an enabled pair. completed is set to the
+    // assembled value when one is ready, else to invalidNRPN
+    bool ProcessMidi(short channel, short control, short value,
+        RSJ::NRPN& completed) noexcept(ndebug);
+
+private:
+    constexpr static short kPairs = 32;
+    std::array<juce::uint32, 16> controllers_{};
+    std::array<std::array<short, kPairs>, 16> msb_{};
+};
+
+inline bool CC14_Filter::ProcessMidi(short channel, short control, short value,
+    RSJ::NRPN& completed) noexcept(ndebug)
+{
+    Expects(channel <= 15 && channel >= 0);
+    Expects(value <= 0x7F);
+    completed = RSJ::invalidNRPN;
+    const auto ch = channel & 0xF;
+    const auto number = control < kPairs ? control : static_cast<short>(control - kPairs);
+    if (control < 0 || control >= 2 * kPairs || !(controllers_[ch] & (1u << number)))
+        return false;
+    if (control < kPairs) { //MSB
+        msb_[ch][number] = value;
+        completed = {true, number, static_cast<short>(value << 7), true};
+    }
+    else //LSB
+        completed = {true, number, static_cast<short>((msb_[ch][number] << 7) | value)};
+    return true;
+}
+
 inline bool NRPN_Message::IsInProcess() const noexcept
 {
-    std::lock_guard<decltype(data_guard_)> lock(data_guard_);
     return ready_ != 0;
 }
 
+inline void NRPN_Message::SetCompletion(RSJ::NrpnCompletion completion, int lsb_window) noexcept
+{
+    completion_ = completion;
+    lsb_window_ = lsb_window;
+    Clear_();
+}
+
 inline bool NRPN_Message::IsReady_() const noexcept
 {
     return ready_ == 0b1111;
@@ -0,0 +1,252 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    OscController.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "OscController.h"
+#include <array>
+#include <cstring>
+#include <mutex>
+#include "CommandMap.h"
+#include "Instrumentation.h"
+#include "LRCommands.h"
+#include "LR_IPC_Out.h"
+
+namespace {
+    constexpr int kStopWait = 1000;
+    constexpr int kReadWait = 100; //ms between checks for exit
+    constexpr size_t kMaxPacket = 65536;
+    constexpr int kMaxBundleDepth = 8;
+    constexpr char kBundle[] = "#bundle"; //with its terminator, 8 bytes
+
+    size_t Padded(size_t size) noexcept
+    {
+        return (size + 4) & ~static_cast<size_t>(3); //terminator included
+    }
+
+    juce::uint32 ReadBig32(const char* data) noexcept
+    {
+        const auto* const bytes = reinterpret_cast<const juce::uint8*>(data);
+        return static_cast<juce::uint32>(bytes[0]) << 24 | static_cast<juce::uint32>(bytes[1]) << 16 |
+            static_cast<juce::uint32>(bytes[2]) << 8 | bytes[3];
+    }
+
+    // an OSC string in [data, end): its length without terminator, or end - data if it
+    // isn't terminated
+    size_t StringLength(const char* data, const char* end) noexcept
+    {
+        const auto* const terminator = static_cast<const char*>(
+            std::memchr(data, 0, static_cast<size_t>(end - data)));
+        return terminator ? static_cast<size_t>(terminator - data) : static_cast<size_t>(end - data);
+    }
+}
+
+OscController::OscController(int port, int feedback_port, std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out):
+    juce::Thread{"OscController"}, feedback_port_{feedback_port},
+    lr_ipc_out_{std::move(lr_ipc_out)},
+    addresses_(LRCommandList::LRStringList.size())
+{
+    listening_ = socket_.bindToPort(port);
+    if (listening_)
+        juce::Thread::startThread();
+}
+
+OscController::~OscController()
+{
+    juce::Thread::signalThreadShouldExit();
+    socket_.shutdown(); //wakes the reader
+    juce::Thread::stopThread(kStopWait);
+}
+
+void OscController::run()
+{
+    std::array<char, kMaxPacket> buffer;
+    juce::String sender;
+    auto sender_port = 0;
+    while (!juce::Thread::threadShouldExit()) {
+        if (socket_.waitUntilReady(true, kReadWait) != 1)
+            continue;
+        const auto read = socket_.read(buffer.data(), static_cast<int>(buffer.size()), false,
+            sender, sender_port);
+        if (read <= 0)
+            continue;
+        {
+            std::lock_guard<decltype(feedback_lock_)> lock(feedback_lock_);
+            if (feedback_host_ != sender)
+                feedback_host_ = sender; //the tablet replying to is the last one heard
+        }
+        ProcessPacket(buffer.data(), static_cast<size_t>(read),
+            juce::Time::getMillisecondCounterHiRes());
+    }
+}
+
+void OscController::ProcessPacket(const char* data, size_t size, double arrival)
+{
+    static auto& packets = Instrumentation::Counter("OSC packets");
+    packets.fetch_add(1, std::memory_order_relaxed);
+    static auto& dropped = Instrumentation::Counter("OSC elements dropped");
+    const auto is_bundle = [](const char* element, size_t length) noexcept {
+        return length >= sizeof kBundle && std::memcmp(element, kBundle, sizeof kBundle) == 0;
+    };
+    if (!is_bundle(data, size)) {
+        ProcessMessage_(data, size, arrival);
+        return;
+    }
+    // bundles nest; each element is a big-endian size and a message or bundle. They are
+    // walked in order with a cursor per open bundle, so only the nesting is bounded.
+    // Each cursor starts past the time tag: values act on arrival
+    struct Cursor {
+        const char* data;
+        size_t size;
+        size_t offset;
+    };
+    constexpr size_t kElements = sizeof kBundle + 8;
+    std::array<Cursor, kMaxBundleDepth> stack;
+    size_t depth = 0;
+    stack[depth++] = {data, size, kElements};
+    while (depth > 0) {
+        auto& bundle = stack[depth - 1];
+        if (bundle.offset + 4 > bundle.size) {
+            --depth;
+            continue;
+        }
+        const auto element_size = static_cast<size_t>(ReadBig32(bundle.data + bundle.offset));
+        bundle.offset += 4;
+        if (element_size > bundle.size - bundle.offset) { //truncated, the rest is lost
+            dropped.fetch_add(1, std::memory_order_relaxed);
+            --depth;
+            continue;
+        }
+        const auto* const element = bundle.data + bundle.offset;
+        bundle.offset += element_size;
+        if (element_size == 0)
+            continue;
+        if (!is_bundle(element, element_size))
+            ProcessMessage_(element, element_size, arrival);
+        else if (depth == stack.size()) //nested too deep
+            dropped.fetch_add(1, std::memory_order_relaxed);
+        else
+            stack[depth++] = {element, element_size, kElements};
+    }
+}
+
+void OscController::ProcessMessage_(const char* data, size_t size, double arrival)
+{
+    static auto& malformed = Instrumentation::Counter("OSC malformed");
+    const auto* const end = data + size;
+    if (size < 4 || *data != '/' || size % 4 != 0) {
+        malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const auto address_length = StringLength(data, end);
+    const auto tags_offset = Padded(address_length);
+    if (tags_offset >= size || data[tags_offset] != ',') {
+        malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    const auto* const tags = data + tags_offset;
+    const auto tags_length = StringLength(tags, end);
+    const auto* const argument = tags + Padded(tags_length);
+    // the command is the last part of the address
+    const auto* name = data + address_length;
+    while (name != data && *(name - 1) != '/')
+        --name;
+    const auto id = LRCommandList::getIndexOfCommand(name,
+        static_cast<size_t>(data + address_length - name));
+    if (id == LRCommandList::kNotFound || id == 0 || id >= LRCommandList::LRStringList.size())
+        return; //not a command, or Unmapped
+    double value;
+    switch (tags_length > 1 ? tags[1] : 'T') {
+    case 'f':
+    {
+        if (argument + 4 > end)
+            return;
+        const auto bits = ReadBig32(argument);
+        float result;
+        std::memcpy(&result, &bits, sizeof result);
+        value = result;
+        break;
+    }
+    case 'i':
+        if (argument + 4 > end)
+            return;
+        value = static_cast<double>(static_cast<juce::int32>(ReadBig32(argument)));
+        break;
+    case 'T':
+        value = 1.0;
+        break;
+    case 'F':
+        value = 0.0;
+        break;
+    default:
+        malformed.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (!(value >= 0.0)) //negative or NaN
+        value = 0.0;
+    else if (value > 1.0)
+        value = 1.0;
+    const auto command_id = static_cast<RSJ::CommandId>(id);
+    {
+        std::lock_guard<decltype(feedback_lock_)> lock(feedback_lock_);
+        auto& address = addresses_[id];
+        if (address.size() != address_length || address.compare(0, address_length, data, address_length) != 0)
+            address.assign(data, address_length);
+    }
+    const auto flags = CommandMap::getCommandFlags(command_id);
+    if ((flags & RSJ::kCommandAction) && value == 0.0)
+        return; //a button's release
+    if (const auto ptr = lr_ipc_out_.lock()) {
+        RSJ::ResolvedMessage resolved{{RSJ::kCCFlag, RSJ::kOscChannel,
+            static_cast<short>(command_id), 0}};
+        resolved.command = &CommandMap::getCommandString(command_id);
+        resolved.command_id = command_id;
+        resolved.command_flags = flags;
+        resolved.value = value;
+        resolved.time_stamp = arrival;
+        ptr->MIDIcmdCallback(resolved);
+    }
+}
+
+void OscController::Feedback(RSJ::CommandId command_id, double value)
+{
+    if (command_id >= addresses_.size())
+        return;
+    // built in a buffer the reader thread keeps, so feedback allocates nothing
+    thread_local std::string packet;
+    juce::String host;
+    {
+        std::lock_guard<decltype(feedback_lock_)> lock(feedback_lock_);
+        const auto& address = addresses_[command_id];
+        if (address.empty() || feedback_host_.isEmpty())
+            return; //the tablet hasn't used this command
+        packet.assign(address);
+        host = feedback_host_;
+    }
+    packet.append(Padded(packet.size()) - packet.size(), '\0');
+    packet.append(",f\0\0", 4);
+    const auto single = static_cast<float>(value);
+    juce::uint32 bits;
+    std::memcpy(&bits, &single, sizeof bits);
+    const char argument[] = {static_cast<char>(bits >> 24), static_cast<char>(bits >> 16),
+        static_cast<char>(bits >> 8), static_cast<char>(bits)};
+    packet.append(argument, sizeof argument);
+    sender_.write(host, feedback_port_, packet.data(), static_cast<int>(packet.size()));
+}
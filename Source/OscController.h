@@ -0,0 +1,69 @@
+#pragma once
+/*
+  ==============================================================================
+
+    OscController.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_OSCCONTROLLER_H_INCLUDED
+#define MIDI2LR_OSCCONTROLLER_H_INCLUDED
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Misc.h"
+#include "MidiUtilities.h"
+class LR_IPC_OUT;
+
+// OSC over UDP as a controller, without a MIDI bridge: a message whose address ends
+// in a command name ("/midi2lr/Exposure", "/1/Exposure") sends its float, int or
+// boolean argument (0-1) straight to Lightroom, coalesced like MIDI values. Feedback
+// for a command returns to the address it was last sent from, at the sender's
+// address and feedback_port
+class OscController final: private juce::Thread {
+public:
+    OscController(int port, int feedback_port, std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out);
+    ~OscController();
+    OscController(const OscController&) = delete;
+    OscController& operator=(const OscController&) = delete;
+    bool IsListening() const noexcept
+    {
+        return listening_;
+    }
+    // Lightroom's value for command_id, 0-1. LR_IPC_IN's reader thread
+    void Feedback(RSJ::CommandId command_id, double value);
+    // one datagram, parsed in place. Receiving thread, or a harness
+    void ProcessPacket(const char* data, size_t size, double arrival);
+
+private:
+    // Thread interface
+    void run() override;
+    void ProcessMessage_(const char* data, size_t size, double arrival);
+    bool listening_{false};
+    const int feedback_port_;
+    std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
+    juce::DatagramSocket socket_{false}; //receives, bound to the port
+    juce::DatagramSocket sender_{false}; //feedback
+    // the reverse index: address each command was last heard on, by CommandId, and
+    // where feedback goes. Guarded by feedback_lock_
+    mutable RSJ::RelaxTTasSpinLock feedback_lock_;
+    std::vector<std::string> addresses_;
+    juce::String feedback_host_;
+};
+
+#endif  // OSCCONTROLLER_H_INCLUDED
@@ -0,0 +1,38 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    ParameterMirror.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ParameterMirror.h"
+#include "LRCommands.h"
+
+constexpr double ParameterMirror::kUnknown;
+
+ParameterMirror::ParameterMirror(): entries_(LRCommandList::LRStringList.size())
+{}
+
+void ParameterMirror::Clear() noexcept
+{
+    for (auto& entry : entries_) {
+        entry.value.store(kUnknown, std::memory_order_relaxed);
+        entry.generation.store(0, std::memory_order_relaxed);
+    }
+    generation_.fetch_add(1, std::memory_order_relaxed);
+}
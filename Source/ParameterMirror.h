@@ -0,0 +1,96 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ParameterMirror.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_PARAMETERMIRROR_H_INCLUDED
+#define MIDI2LR_PARAMETERMIRROR_H_INCLUDED
+
+#include <atomic>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "Instrumentation.h"
+
+// Lightroom's last value of each command (LRStringList index), kept from the
+// plugin's feedback so values can be used without asking Lightroom again. Each value
+// is stamped with the photo generation it arrived in; the generation advances with
+// each photo change refresh. Written by the LR_IPC_IN reader, read from any thread
+class ParameterMirror {
+public:
+    ParameterMirror();
+    ParameterMirror(const ParameterMirror&) = delete;
+    ParameterMirror& operator=(const ParameterMirror&) = delete;
+    static constexpr double kUnknown = -1.0;
+
+    // value 0-1 of command_id, kUnknown until one arrives
+    double Get(size_t command_id) const noexcept
+    {
+        return command_id < entries_.size() ?
+            entries_[command_id].value.load(std::memory_order_relaxed) : kUnknown;
+    }
+    void Set(size_t command_id, double value) noexcept
+    {
+        if (command_id >= entries_.size())
+            return;
+        entries_[command_id].value.store(value, std::memory_order_relaxed);
+        entries_[command_id].generation.store(generation_.load(std::memory_order_relaxed),
+            std::memory_order_relaxed);
+    }
+    // generation command_id's value arrived in
+    juce::uint32 GetGeneration(size_t command_id) const noexcept
+    {
+        return command_id < entries_.size() ?
+            entries_[command_id].generation.load(std::memory_order_relaxed) : 0;
+    }
+    // whether command_id's value was reported for the photo now selected
+    bool IsCurrent(size_t command_id) const noexcept
+    {
+        return Get(command_id) >= 0.0 &&
+            GetGeneration(command_id) == generation_.load(std::memory_order_relaxed);
+    }
+    juce::uint32 Generation() const noexcept
+    {
+        return generation_.load(std::memory_order_relaxed);
+    }
+    // a photo change: values still held are from the previous photo until refreshed
+    void NewPhoto() noexcept
+    {
+        generation_.fetch_add(1, std::memory_order_relaxed);
+    }
+    // forgets every value, as when connecting to another Lightroom
+    void Clear() noexcept;
+    size_t size() const noexcept
+    {
+        return entries_.size();
+    }
+    size_t MemoryUse() const noexcept
+    {
+        return RSJ::HeapBytes(entries_);
+    }
+
+private:
+    struct Entry {
+        std::atomic<double> value{kUnknown};
+        std::atomic<juce::uint32> generation{0};
+    };
+    std::vector<Entry> entries_;
+    std::atomic<juce::uint32> generation_{1};
+};
+
+#endif  // MIDI2LR_PARAMETERMIRROR_H_INCLUDED
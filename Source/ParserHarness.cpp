@@ -0,0 +1,172 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    ParserHarness.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ParserHarness.h"
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <exception>
+#include <memory>
+#include <string>
+#include "CommandMap.h"
+#include "ControlsModel.h"
+#include "LR_IPC_In.h"
+#include "LRCommands.h"
+#include "MIDISender.h"
+
+namespace {
+    constexpr size_t kMappedCommands = 128; //each on a CC of channel 1
+    constexpr int kLinesPerInput = 64;
+    constexpr int kOverlongLine = 8192; //twice the reader's buffer
+
+    struct Harness {
+        Harness()
+        {
+            for (size_t i = 0; i < kMappedCommands; ++i)
+                command_map.addCommandforMessage(1 + i,
+                    RSJ::MidiMessageId{1, static_cast<int>(i), RSJ::MsgIdEnum::CC});
+            parser.InitForHarness(midi_sender);
+        }
+        CommandMap command_map;
+        ControlsModel controls_model;
+        std::shared_ptr<MIDISender> midi_sender{std::make_shared<MIDISender>()};
+        LR_IPC_IN parser{&controls_model, nullptr, &command_map};
+    };
+    Harness& GetHarness()
+    {
+        static Harness harness;
+        return harness;
+    }
+
+    void AppendValid(std::string& input, juce::Random& random)
+    {
+        const auto& names = LRCommandList::LRStringList;
+        switch (random.nextInt(16)) {
+        case 0:
+            input += "Snapshot 1\n";
+            break;
+        case 1:
+            input += "EndSnapshot 1\n";
+            break;
+        case 2:
+            input += "CompactProtocol 1 " + std::to_string(LRCommandList::kCommandHash) + "\n";
+            break;
+        case 3:
+            input += "SwitchProfile profile.xml\n";
+            break;
+        case 4:
+            input += random.nextBool() ? "ModuleState develop 1\n" : "ModuleState library 0\n";
+            break;
+        default: //mostly parameter values, mapped and not
+            input += names[1 + static_cast<size_t>(random.nextInt(static_cast<int>(names.size()) - 1))] +
+                ' ' + std::to_string(random.nextDouble()) + '\n';
+        }
+    }
+
+    void AppendInvalid(std::string& input, juce::Random& random)
+    {
+        static const std::array<const char*, 12> odd_values{{"", "-", "nan", "inf", "-inf",
+            "1e999", "-5", "2.5", "0x1p-3", "   ", "0.5.5", "\t0.5"}};
+        const auto& names = LRCommandList::LRStringList;
+        const auto& name = names[static_cast<size_t>(random.nextInt(static_cast<int>(names.size())))];
+        switch (random.nextInt(6)) {
+        case 0: //odd value
+            input += name + ' ' + odd_values[static_cast<size_t>(random.nextInt(static_cast<int>(odd_values.size())))] + '\n';
+            break;
+        case 1: //truncated name
+            input += name.substr(0, static_cast<size_t>(random.nextInt(static_cast<int>(name.size()) + 1))) + '\n';
+            break;
+        case 2: //corrupted valid line
+        {
+            auto line = name + ' ' + std::to_string(random.nextDouble());
+            for (auto flips = random.nextInt(4) + 1; flips > 0; --flips)
+                line[static_cast<size_t>(random.nextInt(static_cast<int>(line.size())))] =
+                static_cast<char>(random.nextInt(256));
+            input += line + '\n';
+            break;
+        }
+        case 3: //random bytes
+            for (auto length = random.nextInt(64); length > 0; --length)
+                input += static_cast<char>(random.nextInt(256));
+            input += '\n';
+            break;
+        case 4: //overlong
+            input.append(static_cast<size_t>(kOverlongLine), 'x');
+            input += '\n';
+            break;
+        default: //keywords with bad arguments
+            input += random.nextBool() ? "CompactProtocol x y\n" :
+                random.nextBool() ? "SendMacro -1\n" : "ModuleState\n";
+        }
+    }
+}
+
+int ParseInboundOnce(const juce::uint8* data, size_t size)
+{
+    const auto* const begin = reinterpret_cast<const char*>(data);
+    GetHarness().parser.ProcessLines(begin, begin + size);
+    return 0;
+}
+
+juce::String RunParserFuzz(juce::int64 seed, int count)
+{
+    juce::Random random{seed};
+    std::string input;
+    juce::int64 lines{0};
+    juce::int64 bytes{0};
+    auto exceptions = 0;
+    auto slowest = 0.0; //ns per byte
+    auto total = 0.0; //ns
+    for (auto i = 0; i < count; ++i) {
+        input.clear();
+        const auto invalid_share = random.nextInt(101); //percent, from clean to garbage
+        for (auto line = 0; line < kLinesPerInput; ++line)
+            if (random.nextInt(100) < invalid_share)
+                AppendInvalid(input, random);
+            else
+                AppendValid(input, random);
+        const auto start = std::chrono::steady_clock::now();
+        try {
+            ParseInboundOnce(reinterpret_cast<const juce::uint8*>(input.data()), input.size());
+        }
+        catch (const std::exception& e) {
+            ++exceptions;
+            DBG("RunParserFuzz: input " + juce::String(i) + " threw " + e.what());
+        }
+        const auto taken = std::chrono::duration<double, std::nano>(
+            std::chrono::steady_clock::now() - start).count();
+        total += taken;
+        slowest = std::max(slowest, taken / static_cast<double>(input.size()));
+        lines += kLinesPerInput;
+        bytes += static_cast<juce::int64>(input.size());
+    }
+    juce::String report{"fuzz, value\n"};
+    report << "seed, " << juce::String(seed) << "\n"
+        << "inputs, " << juce::String(count) << "\n"
+        << "lines, " << juce::String(lines) << "\n"
+        << "bytes, " << juce::String(bytes) << "\n"
+        << "exceptions, " << juce::String(exceptions) << "\n"
+        << "lines/s, " << juce::String(total > 0.0 ? static_cast<double>(lines) * 1e9 / total : 0.0, 0)
+        << "\n" << "mean ns/byte, " << juce::String(bytes > 0 ? total / static_cast<double>(bytes) : 0.0, 2)
+        << "\n" << "slowest input ns/byte, " << juce::String(slowest, 2) << "\n";
+    return report;
+}
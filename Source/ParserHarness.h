@@ -0,0 +1,40 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ParserHarness.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_PARSERHARNESS_H_INCLUDED
+#define MIDI2LR_PARSERHARNESS_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// LR_IPC_IN's line parser on its own, fed a fixed profile with feedback going to a
+// MIDISender without devices. Message thread, one caller at a time
+
+// one input in libFuzzer's LLVMFuzzerTestOneInput form, complete lines only, a final
+// line without a newline is dropped. Always returns 0
+int ParseInboundOnce(const juce::uint8* data, size_t size);
+
+// parses count generated inputs, valid refreshes mixed with corrupted, truncated,
+// overlong and random lines, for --fuzz-parser. Returns "fuzz, value" CSV rows:
+// inputs, lines, exceptions caught and the slowest input, so a crash or a perf
+// cliff shows either way
+juce::String RunParserFuzz(juce::int64 seed, int count);
+
+#endif  // PARSERHARNESS_H_INCLUDED
@@ -0,0 +1,144 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    PipelineTrace.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "PipelineTrace.h"
+#include <chrono>
+#ifdef MIDI2LR_TRACE
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+
+namespace {
+    constexpr size_t kEvents = 8192; //per thread, a power of two
+    struct Event {
+        std::atomic<const char*> name{nullptr};
+        std::atomic<juce::int64> begin{0};
+        std::atomic<juce::int64> duration{0};
+    };
+    struct ThreadBuffer {
+        juce::String thread_name;
+        int id;
+        std::atomic<juce::uint64> written{0};
+        std::atomic<juce::uint64> cleared{0}; //events before this aren't dumped
+        std::array<Event, kEvents> events;
+    };
+    // buffers outlive their threads, so a dump still shows threads that have ended
+    struct Registry {
+        std::mutex mutex;
+        std::deque<std::unique_ptr<ThreadBuffer>> buffers;
+    };
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+    ThreadBuffer& GetBuffer()
+    {
+        thread_local ThreadBuffer* buffer{nullptr};
+        if (!buffer) {
+            auto created = std::make_unique<ThreadBuffer>();
+            if (const auto thread = juce::Thread::getCurrentThread())
+                created->thread_name = thread->getThreadName();
+            else if (const auto manager = juce::MessageManager::getInstanceWithoutCreating())
+                created->thread_name = manager->isThisTheMessageThread() ?
+                "message thread" : "driver thread";
+            auto& registry = GetRegistry();
+            std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+            created->id = static_cast<int>(registry.buffers.size()) + 1;
+            buffer = created.get();
+            registry.buffers.push_back(std::move(created));
+        }
+        return *buffer;
+    }
+}
+#endif
+
+juce::int64 PipelineTrace::Now() noexcept
+{
+    return std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+void PipelineTrace::Record(const char* name, juce::int64 begin) noexcept
+{
+#ifdef MIDI2LR_TRACE
+    const auto end = Now();
+    auto& buffer = GetBuffer();
+    const auto index = buffer.written.load(std::memory_order_relaxed);
+    auto& event = buffer.events[index & (kEvents - 1)];
+    event.name.store(name, std::memory_order_relaxed);
+    event.begin.store(begin, std::memory_order_relaxed);
+    event.duration.store(end - begin, std::memory_order_relaxed);
+    buffer.written.store(index + 1, std::memory_order_release);
+#else
+    static_cast<void>(name);
+    static_cast<void>(begin);
+#endif
+}
+
+juce::String PipelineTrace::Dump()
+{
+    juce::String trace{"{\"traceEvents\":["};
+#ifdef MIDI2LR_TRACE
+    // an event the writer is overwriting during the dump may come out mixed with its
+    // successor; the ring is large enough that this only touches the oldest entries
+    auto separator = "";
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    for (const auto& buffer : registry.buffers) {
+        const auto tid = juce::String(buffer->id);
+        trace << separator << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << tid
+            << ",\"args\":{\"name\":\"" << juce::JSON::escapeString(buffer->thread_name) << "\"}}";
+        separator = ",";
+        const auto written = buffer->written.load(std::memory_order_acquire);
+        const auto first = std::max(written - std::min<juce::uint64>(written, kEvents),
+            buffer->cleared.load(std::memory_order_relaxed));
+        for (auto i = first; i < written; ++i) {
+            const auto& event = buffer->events[i & (kEvents - 1)];
+            const auto name = event.name.load(std::memory_order_relaxed);
+            if (!name)
+                continue;
+            // microseconds, as the format expects
+            trace << ",{\"name\":\"" << name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << tid
+                << ",\"ts\":" << juce::String(event.begin.load(std::memory_order_relaxed) / 1000.0, 3)
+                << ",\"dur\":" << juce::String(event.duration.load(std::memory_order_relaxed) / 1000.0, 3)
+                << "}";
+        }
+    }
+#endif
+    trace << "],\"displayTimeUnit\":\"ms\"}\n";
+    return trace;
+}
+
+void PipelineTrace::Clear()
+{
+#ifdef MIDI2LR_TRACE
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    for (const auto& buffer : registry.buffers)
+        buffer->cleared.store(buffer->written.load(std::memory_order_acquire),
+            std::memory_order_relaxed);
+#endif
+}
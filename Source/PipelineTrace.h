@@ -0,0 +1,72 @@
+#pragma once
+/*
+  ==============================================================================
+
+    PipelineTrace.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_PIPELINETRACE_H_INCLUDED
+#define MIDI2LR_PIPELINETRACE_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+namespace RSJ {
+#ifdef MIDI2LR_TRACE
+    constexpr bool kTracing = true;
+#else
+    constexpr bool kTracing = false; //define MIDI2LR_TRACE to record pipeline traces
+#endif
+}
+
+// Timed pipeline stages, kept in a ring buffer per thread and dumped as Chrome
+// trace JSON (chrome://tracing or ui.perfetto.dev). Any thread
+class PipelineTrace {
+public:
+    static juce::int64 Now() noexcept; //ns, steady clock
+    static void Record(const char* name, juce::int64 begin) noexcept; //name must be a literal
+    // the most recent events of every thread, an empty trace without MIDI2LR_TRACE
+    static juce::String Dump();
+    // later dumps leave out what has been recorded so far
+    static void Clear();
+};
+
+// Records the time spent in scope under name. Without MIDI2LR_TRACE it is empty
+// and compiles to nothing
+class TraceScope {
+public:
+#ifdef MIDI2LR_TRACE
+    explicit TraceScope(const char* name) noexcept: name_{name}, begin_{PipelineTrace::Now()}
+    {}
+    ~TraceScope()
+    {
+        PipelineTrace::Record(name_, begin_);
+    }
+#else
+    explicit TraceScope(const char* /*name*/) noexcept
+    {}
+#endif
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+#ifdef MIDI2LR_TRACE
+
+private:
+    const char* const name_;
+    const juce::int64 begin_;
+#endif
+};
+
+#endif  // PIPELINETRACE_H_INCLUDED
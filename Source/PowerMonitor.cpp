@@ -0,0 +1,153 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    PowerMonitor.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "PowerMonitor.h"
+#include "Instrumentation.h"
+#include "LR_IPC_In.h"
+#include "LR_IPC_Out.h"
+#include "MIDIProcessor.h"
+#include "ThreadStats.h"
+
+namespace {
+    Instrumentation::Metric& WakeUps()
+    {
+        static auto& wake_ups = Instrumentation::Counter("periodic wake-ups");
+        return wake_ups;
+    }
+}
+
+PowerMonitor::PowerMonitor(Scheduler* const scheduler): scheduler_{scheduler}
+{}
+
+PowerMonitor::~PowerMonitor()
+{
+    Stop();
+}
+
+void PowerMonitor::Init(MIDIProcessor* const midi_processor,
+    std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out, std::weak_ptr<LR_IPC_IN>&& lr_ipc_in,
+    int idle_seconds)
+{
+    lr_ipc_out_ = std::move(lr_ipc_out);
+    lr_ipc_in_ = std::move(lr_ipc_in);
+    if (idle_seconds <= 0 || !midi_processor)
+        return;
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    idle_ms_ = static_cast<juce::uint32>(idle_seconds) * 1000u;
+    stopped_ = false;
+    changed_ = juce::Time::getMillisecondCounterHiRes();
+    last_activity_.store(juce::Time::getMillisecondCounter());
+    check_task_ = scheduler_->Schedule([this] {Check_(); }, idle_ms_);
+    midi_processor->addCallback<PowerMonitor, &PowerMonitor::MIDIcmdCallback>(this);
+}
+
+void PowerMonitor::Stop()
+{
+    Scheduler::TaskId task;
+    {
+        std::lock_guard<decltype(mutex_)> lock(mutex_);
+        stopped_ = true;
+        task = check_task_;
+        check_task_ = 0;
+    }
+    if (task) //outside the lock, as a running check waits for it
+        scheduler_->Cancel(task);
+}
+
+void PowerMonitor::CountWakeUp() noexcept
+{
+    WakeUps().fetch_add(1, std::memory_order_relaxed);
+    ThreadStats::CountWakeUp();
+}
+
+void PowerMonitor::MIDIcmdCallback(RSJ::MidiMessage)
+{
+    // sequentially consistent with Check_: either it sees this message or we see idle
+    last_activity_.store(juce::Time::getMillisecondCounter());
+    if (idle_.load())
+        Wake_();
+}
+
+void PowerMonitor::Wake_()
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    if (stopped_ || !idle_.load())
+        return; //another message woke first
+    Change_(false);
+    check_task_ = scheduler_->Schedule([this] {Check_(); }, idle_ms_);
+}
+
+void PowerMonitor::Check_()
+{
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    if (stopped_)
+        return;
+    check_task_ = 0;
+    auto quiet = juce::Time::getMillisecondCounter() - last_activity_.load();
+    if (quiet >= idle_ms_) {
+        idle_.store(true);
+        quiet = juce::Time::getMillisecondCounter() - last_activity_.load();
+        if (quiet >= idle_ms_) {
+            Change_(true);
+            return;
+        }
+        idle_.store(false); //a message arrived meanwhile, its Wake_ will find us awake
+    }
+    check_task_ = scheduler_->Schedule([this] {Check_(); }, idle_ms_ - quiet);
+}
+
+void PowerMonitor::Change_(bool idle)
+{
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    if (idle)
+        ++idle_periods_;
+    else
+        idle_total_ += now - changed_;
+    changed_ = now;
+    idle_.store(idle);
+    DBG(juce::String{"PowerMonitor: "} + (idle ? "idle" : "awake"));
+    if (const auto ptr = lr_ipc_out_.lock())
+        ptr->SetIdle(idle);
+    if (const auto ptr = lr_ipc_in_.lock())
+        ptr->SetIdle(idle);
+    callbacks_.Publish(idle);
+}
+
+juce::String PowerMonitor::Report() const
+{
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    const auto wake_ups = WakeUps().load(std::memory_order_relaxed);
+    std::lock_guard<decltype(mutex_)> lock(mutex_);
+    const auto idle_total = idle_total_ + (IsIdle() ? now - changed_ : 0.0);
+    const auto minutes = (now - reported_) / 60000.0;
+    juce::String report{"power monitor, value\n"};
+    report << "state, " << (stopped_ ? "off" : IsIdle() ? "idle" : "active") << "\n"
+        << "idle timeout s, " << static_cast<int>(idle_ms_ / 1000u) << "\n"
+        << "idle periods, " << idle_periods_ << "\n"
+        << "time idle %, " << juce::String(now > started_ ?
+            100.0 * idle_total / (now - started_) : 0.0, 1) << "\n"
+        << "wake-ups per minute since last report, " << juce::String(minutes > 0.0 ?
+            static_cast<double>(wake_ups - reported_wake_ups_) / minutes : 0.0, 1) << "\n";
+    reported_ = now;
+    reported_wake_ups_ = wake_ups;
+    return report;
+}
@@ -0,0 +1,95 @@
+#pragma once
+/*
+  ==============================================================================
+
+    PowerMonitor.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_POWERMONITOR_H_INCLUDED
+#define MIDI2LR_POWERMONITOR_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "EventChannel.h"
+#include "MidiUtilities.h"
+#include "Scheduler.h"
+class LR_IPC_IN;
+class LR_IPC_OUT;
+class MIDIProcessor;
+
+// Idle power mode for laptops. Once no MIDI has arrived for the idle timeout,
+// subscribers stop whatever wakes the CPU periodically: device polls, autosave, the
+// profile directory watcher, latency checks, the coalescing flush and the plugin's
+// profile poll. The next MIDI message wakes them from its dispatch thread. Wake-ups
+// counted anywhere in the application are reported per minute
+class PowerMonitor {
+public:
+    explicit PowerMonitor(Scheduler* const scheduler);
+    ~PowerMonitor();
+    PowerMonitor(const PowerMonitor&) = delete;
+    PowerMonitor& operator=(const PowerMonitor&) = delete;
+    // idle_seconds 0 never goes idle. Message thread
+    void Init(MIDIProcessor* const midi_processor, std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out,
+        std::weak_ptr<LR_IPC_IN>&& lr_ipc_in, int idle_seconds);
+    // no more changes or callbacks after this returns, call before subscribers go
+    void Stop();
+
+    // told true on going idle, from the scheduler's thread, and false on waking, from
+    // the MIDI dispatch thread, unless delivered elsewhere
+    template<class T, void(T::*MF)(bool)>
+    void addCallback(T* const object, Delivery delivery = Delivery::immediate)
+    {
+        callbacks_.Subscribe<T, MF>(object, delivery);
+    }
+    bool IsIdle() const noexcept
+    {
+        return idle_.load(std::memory_order_relaxed);
+    }
+    // call each time a timer or timed wait fires, whether or not it finds work. Any
+    // thread
+    static void CountWakeUp() noexcept;
+    juce::String Report() const;
+
+    // MIDIProcessor callback
+    void MIDIcmdCallback(RSJ::MidiMessage);
+
+private:
+    void Check_(); //scheduler thread
+    void Wake_();
+    void Change_(bool idle); //with mutex_ held
+    constexpr static size_t kMaxCallbacks = 4;
+    Scheduler* const scheduler_;
+    std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
+    std::weak_ptr<LR_IPC_IN> lr_ipc_in_;
+    juce::uint32 idle_ms_{0};
+    std::atomic<juce::uint32> last_activity_{0}; //ms counter
+    std::atomic<bool> idle_{false};
+    mutable std::mutex mutex_; //guards the members below and serializes changes
+    bool stopped_{true};
+    Scheduler::TaskId check_task_{0};
+    int idle_periods_{0};
+    double changed_{0.0}; //ms counter, hi-res
+    double idle_total_{0.0}; //ms, not counting the current period
+    const double started_{juce::Time::getMillisecondCounterHiRes()};
+    mutable double reported_{started_}; //the previous report's time and count
+    mutable juce::int64 reported_wake_ups_{0};
+    EventChannel<kMaxCallbacks, bool> callbacks_{"power monitor"};
+};
+
+#endif  // POWERMONITOR_H_INCLUDED
@@ -21,21 +21,329 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "ProfileManager.h"
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <future>
+#include <istream>
+#include <streambuf>
 #include <string>
+#include <thread>
+#include <unordered_set>
 #include <utility>
+#include <vector>
+#include <cereal/archives/binary.hpp>
+#include <cereal/types/string.hpp>
+#include <cereal/types/vector.hpp>
 #include <gsl/gsl>
+#include "AsyncLog.h"
 #include "CommandMap.h"
 #include "ControlsModel.h"
 #include "LR_IPC_Out.h"
 #include "LRCommands.h"
 #include "MIDIProcessor.h"
 #include "MidiUtilities.h"
+#include "PowerMonitor.h"
+#ifdef _WIN32
+#include "Windows.h"
+#else
+#include <fcntl.h>
+#include <sys/event.h>
+#include <unistd.h>
+#endif
 using namespace std::literals::string_literals;
 
+namespace {
+    constexpr int kWatchSlice = 250; //ms between checks for thread exit while waiting
+    constexpr int kRescanInterval = 5000; //ms, also catches edits the OS doesn't report
+    constexpr int kWatcherStop = 2000; //ms to wait for the watcher to exit
+    constexpr juce::uint32 kSidecarVersion = 4;
+
+    // reads a memory-mapped file through an istream without copying it
+    class MappedBuffer final: public std::streambuf {
+    public:
+        MappedBuffer(const void* data, size_t size)
+        {
+            const auto begin = static_cast<char*>(const_cast<void*>(data));
+            setg(begin, begin, begin + size);
+        }
+    };
+
+    size_t ProfileBytes(const RSJ::CompiledProfile& profile)
+    {
+        auto bytes = sizeof(profile) + RSJ::HeapBytes(profile.mappings) +
+            RSJ::HeapBytes(profile.macros) + RSJ::HeapBytes(profile.messages) +
+            RSJ::HeapBytes(profile.controls);
+        for (const auto& macro : profile.macros)
+            bytes += RSJ::HeapBytes(macro.second);
+        for (const auto& control : profile.controls)
+            bytes += RSJ::HeapBytes(control.second.curve.points);
+        return bytes;
+    }
+
+    // compiled copy of a profile, beside it, so unchanged profiles skip the XML parse
+    juce::File Sidecar(const juce::File& profile)
+    {
+        return profile.getSiblingFile(profile.getFileName() + ".bin");
+    }
+
+    template<class Archive>
+    void SaveMessage(Archive& archive, const RSJ::MidiMessageId& message)
+    {
+        // device indexes are given out per run, so the identifier is what's kept
+        archive(static_cast<short>(message.msg_id_type), message.channel, message.data,
+            RSJ::DeviceIdentifier(static_cast<short>(message.source)).toStdString(), message.layer);
+    }
+
+    template<class Archive>
+    RSJ::MidiMessageId LoadMessage(Archive& archive)
+    {
+        short type;
+        int channel;
+        int data;
+        std::string device;
+        int layer;
+        archive(type, channel, data, device, layer);
+        if (type < 0 || type > static_cast<short>(RSJ::MsgIdEnum::PITCHBEND) || channel < 1 ||
+            channel > 16 || layer < 0 || layer >= RSJ::kLayers)
+            throw cereal::Exception("bad message in profile sidecar");
+        const auto source = RSJ::DeviceIndex(juce::String{device});
+        if (!device.empty() && !source)
+            throw cereal::Exception("too many devices in profile sidecar");
+        return {channel, data, static_cast<RSJ::MsgIdEnum>(type), source, layer};
+    }
+
+    // command ids are indices into this build's command list, so the sidecar is only
+    // good for the version that wrote it
+    void SaveSidecar(const juce::File& profile, const RSJ::CompiledProfile& compiled)
+    {
+        std::ofstream outfile(Sidecar(profile).getFullPathName().toStdString(),
+            std::ios::out | std::ios::binary | std::ios::trunc);
+        if (!outfile.is_open())
+            return;
+        cereal::BinaryOutputArchive archive(outfile);
+        archive(std::string{ProjectInfo::versionString}, kSidecarVersion,
+            static_cast<juce::uint32>(compiled.mappings.size()));
+        for (const auto& mapping : compiled.mappings) {
+            SaveMessage(archive, mapping.first);
+            archive(mapping.second);
+        }
+        archive(static_cast<juce::uint32>(compiled.macros.size()));
+        for (const auto& macro : compiled.macros) {
+            SaveMessage(archive, macro.first);
+            archive(static_cast<juce::uint32>(macro.second.size()));
+            for (const auto& target : macro.second)
+                archive(target.command_id, target.scale, target.offset);
+        }
+        archive(compiled.has_controls, static_cast<juce::uint32>(compiled.controls.size()));
+        for (const auto& control : compiled.controls)
+            archive(static_cast<juce::uint32>(control.first), control.second);
+    }
+
+    // nullptr if there is no sidecar newer than the profile, or it can't be read
+    std::shared_ptr<const RSJ::CompiledProfile> LoadSidecar(const juce::File& profile)
+    {
+        const auto sidecar = Sidecar(profile);
+        if (!sidecar.existsAsFile() ||
+            sidecar.getLastModificationTime() < profile.getLastModificationTime())
+            return nullptr;
+        juce::MemoryMappedFile mapped{sidecar, juce::MemoryMappedFile::readOnly};
+        if (mapped.getData() == nullptr)
+            return nullptr;
+        MappedBuffer buffer{mapped.getData(), mapped.getSize()};
+        std::istream stream{&buffer};
+        try {
+            cereal::BinaryInputArchive archive(stream);
+            std::string version;
+            juce::uint32 format;
+            juce::uint32 count;
+            archive(version, format, count);
+            if (version != ProjectInfo::versionString || format != kSidecarVersion)
+                return nullptr;
+            auto compiled = std::make_shared<RSJ::CompiledProfile>();
+            for (juce::uint32 i = 0; i < count; ++i) {
+                const auto message = LoadMessage(archive);
+                RSJ::CommandId command;
+                archive(command);
+                compiled->mappings.emplace_back(message, command);
+            }
+            archive(count);
+            for (juce::uint32 i = 0; i < count; ++i) {
+                auto& targets = compiled->macros[LoadMessage(archive)];
+                juce::uint32 target_count;
+                archive(target_count);
+                for (juce::uint32 j = 0; j < target_count; ++j) {
+                    RSJ::MacroTarget target;
+                    archive(target.command_id, target.scale, target.offset);
+                    targets.push_back(target);
+                }
+            }
+            archive(compiled->has_controls, count);
+            for (juce::uint32 i = 0; i < count; ++i) {
+                juce::uint32 channel;
+                RSJ::SettingsStruct settings;
+                archive(channel, settings);
+                if (channel > 15)
+                    throw cereal::Exception("bad channel in profile sidecar");
+                compiled->controls.emplace_back(channel, std::move(settings));
+            }
+            CommandMap::IndexProfile(*compiled);
+            return compiled;
+        }
+        catch (const std::exception& e) { //truncated or damaged, fall back to the XML
+            DBG(juce::String{"Profile sidecar unreadable: "} + e.what());
+            AsyncLog::Write(RSJ::LogCategory::profile, RSJ::LogLevel::warning,
+                "profile sidecar unreadable, using the XML: %s", e.what());
+            return nullptr;
+        }
+    }
+
+    // the compiled profile from its sidecar, or from the XML, refreshing the sidecar.
+    // nullptr if the file is not a profile
+    std::shared_ptr<const RSJ::CompiledProfile> LoadProfile(const juce::File& profile)
+    {
+        if (auto compiled = LoadSidecar(profile))
+            return compiled;
+        std::unique_ptr<juce::XmlElement> xml_element{juce::XmlDocument::parse(profile)};
+        if (!xml_element || !xml_element->hasTagName("settings"))
+            return nullptr;
+        auto compiled = std::make_shared<const RSJ::CompiledProfile>(
+            CommandMap::CompileProfile(*xml_element));
+        SaveSidecar(profile, *compiled);
+        return compiled;
+    }
+}
+
+// waits on the OS's change notification for the profile directory and rescans it
+// after each change, compiling only new or edited profiles
+class ProfileManager::DirectoryWatcher final: public juce::Thread {
+public:
+    DirectoryWatcher(ProfileManager& owner, const juce::File& directory, ProfileCache cache):
+        juce::Thread{"Profile directory watcher"}, owner_(owner), directory_{directory},
+        cache_{std::move(cache)}
+    {
+#ifdef _WIN32
+        change_ = FindFirstChangeNotificationW(directory_.getFullPathName().toWideCharPointer(),
+            FALSE, FILE_NOTIFY_CHANGE_FILE_NAME | FILE_NOTIFY_CHANGE_LAST_WRITE);
+#else
+        queue_ = kqueue();
+        directory_fd_ = open(directory_.getFullPathName().toRawUTF8(), O_EVTONLY);
+        if (queue_ != -1 && directory_fd_ != -1) {
+            struct kevent change;
+            EV_SET(&change, directory_fd_, EVFILT_VNODE, EV_ADD | EV_CLEAR,
+                NOTE_WRITE | NOTE_EXTEND | NOTE_DELETE | NOTE_RENAME, 0, nullptr);
+            kevent(queue_, &change, 1, nullptr, 0, nullptr);
+        }
+#endif
+    }
+    ~DirectoryWatcher()
+    {
+        signalThreadShouldExit();
+        notify(); //may be idle
+        stopThread(kWatcherStop);
+#ifdef _WIN32
+        if (change_ != INVALID_HANDLE_VALUE)
+            FindCloseChangeNotification(change_);
+#else
+        if (directory_fd_ != -1)
+            close(directory_fd_);
+        if (queue_ != -1)
+            close(queue_);
+#endif
+    }
+    DirectoryWatcher(const DirectoryWatcher&) = delete;
+    DirectoryWatcher& operator=(const DirectoryWatcher&) = delete;
+    // while idle the directory isn't watched; it is scanned again on waking
+    void SetIdle(bool idle)
+    {
+        idle_.store(idle, std::memory_order_relaxed);
+        if (!idle)
+            notify();
+    }
+
+private:
+    void run() override
+    {
+        //the first scan is always handed over, so the owner learns the directory was read
+        auto first = true;
+        while (!threadShouldExit()) {
+            // a first scan's profiles are handed over as they compile, so the first is
+            // usable before the rest are done
+            auto scanned = Scan_(directory_, cache_, [this, first](const ProfileCache& so_far) {
+                if (first) {
+                    std::lock_guard<decltype(owner_.mutex_scan_)> lock(owner_.mutex_scan_);
+                    owner_.scan_ = std::make_unique<ProfileCache>(so_far);
+                    owner_.triggerAsyncUpdate();
+                }
+                return !threadShouldExit();
+            });
+            if (first || !Same_(scanned)) {
+                first = false;
+                cache_ = scanned;
+                {
+                    std::lock_guard<decltype(owner_.mutex_scan_)> lock(owner_.mutex_scan_);
+                    owner_.scan_ = std::make_unique<ProfileCache>(std::move(scanned));
+                }
+                owner_.triggerAsyncUpdate();
+            }
+            for (auto waited = 0; waited < kRescanInterval && !threadShouldExit();
+                waited += kWatchSlice) {
+                if (idle_.load(std::memory_order_relaxed)) {
+                    wait(-1); //notified on waking and on exit
+                    break;
+                }
+                PowerMonitor::CountWakeUp();
+                if (Changed_())
+                    break;
+            }
+        }
+    }
+    // waits up to kWatchSlice ms for the directory to change
+    bool Changed_()
+    {
+#ifdef _WIN32
+        if (change_ == INVALID_HANDLE_VALUE) {
+            wait(kWatchSlice);
+            return false;
+        }
+        if (WaitForSingleObject(change_, kWatchSlice) != WAIT_OBJECT_0)
+            return false;
+        FindNextChangeNotification(change_);
+        return true;
+#else
+        if (queue_ == -1 || directory_fd_ == -1) {
+            wait(kWatchSlice);
+            return false;
+        }
+        struct kevent event;
+        const timespec timeout{0, kWatchSlice * 1000000L};
+        return kevent(queue_, nullptr, 0, &event, 1, &timeout) > 0;
+#endif
+    }
+    bool Same_(const ProfileCache& scanned) const
+    {
+        return scanned.size() == cache_.size() && std::equal(scanned.begin(), scanned.end(),
+            cache_.begin(), [](const ProfileCache::value_type& a, const ProfileCache::value_type& b) {
+            return a.first == b.first && a.second.modified == b.second.modified; });
+    }
+    ProfileManager& owner_;
+    const juce::File directory_;
+    ProfileCache cache_;
+    std::atomic<bool> idle_{false};
+#ifdef _WIN32
+    HANDLE change_{INVALID_HANDLE_VALUE};
+#else
+    int queue_{-1};
+    int directory_fd_{-1};
+#endif
+};
+
 ProfileManager::ProfileManager(ControlsModel* const c_model, CommandMap* const cmap) noexcept:
 command_map_{cmap}, controls_model_{c_model}
 {}
 
+ProfileManager::~ProfileManager() = default;
+
 void ProfileManager::Init(std::weak_ptr<LR_IPC_OUT>&& out,
     MIDIProcessor* const midiProcessor)
 {
@@ -45,26 +353,30 @@ void ProfileManager::Init(std::weak_ptr<LR_IPC_OUT>&& out,
     if (const auto ptr = lr_ipc_out_.lock())
     // add ourselves as a listener to LR_IPC_OUT so that we can send plugin
     // settings on connection
-        ptr->addCallback(this, &ProfileManager::ConnectionCallback);
+        ptr->addCallback<ProfileManager, &ProfileManager::ConnectionCallback>(this);
 
     if (midiProcessor)
-        midiProcessor->addCallback(this, &ProfileManager::MIDIcmdCallback);
+        midiProcessor->addResolvedCallback<ProfileManager, &ProfileManager::MIDIcmdCallback>(this);
 }
 
 void ProfileManager::setProfileDirectory(const juce::File& directory)
 {
     profile_location_ = directory;
 
-    juce::Array<juce::File> file_array;
-    directory.findChildFiles(file_array, juce::File::findFiles, false, "*.xml");
-
+    watcher_.reset();
+    {
+        std::lock_guard<decltype(mutex_scan_)> lock(mutex_scan_);
+        scan_.reset();
+    }
     current_profile_index_ = 0;
+    compiled_profiles_.clear();
     profiles_.clear();
-    for (const auto file : file_array)
-        profiles_.emplace_back(file.getFileName());
-
-    if (profiles_.size() > 0)
-        switchToProfile(profiles_[0]);
+    switch_after_scan_ = directory.isDirectory();
+    if (switch_after_scan_) {
+        watcher_ = std::make_unique<DirectoryWatcher>(*this, directory, ProfileCache{});
+        watcher_->SetIdle(idle_);
+        watcher_->startThread();
+    }
 }
 
 const std::vector<juce::String>& ProfileManager::getMenuItems() const noexcept
@@ -74,32 +386,219 @@ const std::vector<juce::String>& ProfileManager::getMenuItems() const noexcept
 
 void ProfileManager::switchToProfile(int profile_index)
 {
-    if (profile_index >= 0 && profile_index < gsl::narrow_cast<int>(profiles_.size())) {
+    if (profile_index >= 0 && profile_index < gsl::narrow_cast<int>(profiles_.size()))
         switchToProfile(profiles_[static_cast<size_t>(profile_index)]);
-        current_profile_index_ = profile_index;
+}
+
+ProfileManager::ProfileCache ProfileManager::Scan_(const juce::File& directory,
+    const ProfileCache& cache, const std::function<bool(const ProfileCache&)>& progress)
+{
+    juce::Array<juce::File> file_array;
+    directory.findChildFiles(file_array, juce::File::findFiles, false, "*.xml");
+    ProfileCache scanned;
+    std::vector<juce::File> to_compile;
+    for (const auto& file : file_array) {
+        const auto modified = file.getLastModificationTime();
+        const auto cached = scanned.emplace(file.getFileName(), CachedProfile{}).first;
+        const auto old = cache.find(file.getFileName());
+        if (old != cache.end() && old->second.modified == modified) {
+            cached->second = old->second;
+            continue;
+        }
+        cached->second = {modified, nullptr, true};
+        to_compile.push_back(file);
     }
+    if (to_compile.empty())
+        return scanned;
+    std::sort(to_compile.begin(), to_compile.end(), [](const juce::File& a, const juce::File& b) {
+        return a.getFileName() < b.getFileName(); });
+    // each worker takes the next file in name order, so the first profile, which is the
+    // one switched to, is among the first done
+    std::mutex mutex;
+    std::atomic<size_t> next{0};
+    std::atomic<bool> stop{false};
+    auto first_done = !scanned.begin()->second.pending;
+    const auto compile = [&] {
+        for (auto i = next++; i < to_compile.size() && !stop; i = next++) {
+            auto compiled = LoadProfile(to_compile[i]);
+            std::lock_guard<decltype(mutex)> lock(mutex);
+            auto& entry = scanned[to_compile[i].getFileName()];
+            entry.profile = std::move(compiled);
+            entry.pending = false;
+            first_done = first_done || i == 0;
+            if (first_done && !progress(scanned))
+                stop = true;
+        }
+    };
+    const auto workers = std::min<size_t>(to_compile.size(),
+        std::max(1u, std::thread::hardware_concurrency()));
+    std::vector<std::future<void>> running;
+    for (size_t i = 1; i < workers; ++i)
+        running.push_back(std::async(std::launch::async, compile));
+    compile();
+    for (auto& worker : running)
+        worker.get();
+    return scanned;
+}
+
+std::shared_ptr<const RSJ::CompiledProfile> ProfileManager::Compiled_(const juce::String& profile) const
+{
+    const auto cached = compiled_profiles_.find(profile);
+    return cached == compiled_profiles_.end() ? nullptr : cached->second.profile;
+}
+
+void ProfileManager::ApplyScan_()
+{
+    std::unique_ptr<ProfileCache> scan;
+    {
+        std::lock_guard<decltype(mutex_scan_)> lock(mutex_scan_);
+        scan = std::move(scan_);
+    }
+    if (!scan)
+        return;
+    // keep the index on the same profile if it is still there
+    const auto current = current_profile_index_ >= 0 &&
+        current_profile_index_ < gsl::narrow_cast<int>(profiles_.size()) ?
+        profiles_[static_cast<size_t>(current_profile_index_)] : juce::String{};
+    // neighbours still compiling in the last scan couldn't be prefetched then
+    const auto was_pending = std::any_of(compiled_profiles_.begin(), compiled_profiles_.end(),
+        [](const ProfileCache::value_type& entry) {return entry.second.pending; });
+    compiled_profiles_ = std::move(*scan);
+    profiles_.clear();
+    for (const auto& profile : compiled_profiles_)
+        profiles_.push_back(profile.first);
+    const auto found = std::find(profiles_.begin(), profiles_.end(), current);
+    current_profile_index_ = found == profiles_.end() ? 0 :
+        gsl::narrow_cast<int>(found - profiles_.begin());
+    if (switch_after_scan_) {
+        switch_after_scan_ = false;
+        if (!profiles_.empty())
+            Begin_(profiles_[0]);
+    }
+    else if (was_pending)
+        Prefetch_();
 }
 
 void ProfileManager::switchToProfile(const juce::String& profile)
 {
-    const auto profile_file = profile_location_.getChildFile(profile);
-
-    if (profile_file.exists()) {
-        std::unique_ptr<juce::XmlElement> xml_element{juce::XmlDocument::parse(profile_file)};
-        if (xml_element) {
-            for (const auto& cb : callbacks_)
-                cb(xml_element.get(), profile);
-
-            if (const auto ptr = lr_ipc_out_.lock()) {
-                auto command = "ChangedToDirectory "s +
-                    juce::File::addTrailingSeparator(profile_location_.getFullPathName()).toStdString() +
-                    '\n';
-                ptr->sendCommand(command);
-                command = "ChangedToFile "s + profile.toStdString() + '\n';
-                ptr->sendCommand(command);
-            }
+    if (juce::MessageManager::getInstance()->isThisTheMessageThread()) {
+        Begin_(profile);
+        return;
+    }
+    {
+        std::lock_guard<decltype(mutex_prepared_)> lock(mutex_prepared_);
+        requested_.push_back(profile);
+    }
+    triggerAsyncUpdate();
+}
+
+void ProfileManager::Begin_(const juce::String& profile)
+{
+    const auto cached = compiled_profiles_.find(profile);
+    if (cached != compiled_profiles_.end() && !cached->second.profile && !cached->second.pending)
+        return; //read already and not a profile
+    const auto compiled = Compiled_(profile);
+    const auto generation = ++generation_;
+    if (compiled) {
+        std::unique_ptr<CommandMap::Prepared> map{nullptr};
+        {
+            std::lock_guard<decltype(mutex_prepared_)> lock(mutex_prepared_);
+            const auto prepared = prepared_.find(profile);
+            if (prepared != prepared_.end() && prepared->second.profile == compiled)
+                map = std::move(prepared->second.map); //nullptr if still building
+        }
+        if (map) {
+            Finish_({profile, compiled, std::move(map), generation});
+            return;
         }
     }
+    // load and compile on the worker, keeping the current profile meanwhile
+    loading_callbacks_(profile, true);
+    const auto file = profile_location_.getChildFile(profile);
+    prefetch_pool_.addJob([this, profile, file, compiled, generation] {
+        auto loaded = compiled ? compiled :
+            file.existsAsFile() ? LoadProfile(file) : nullptr;
+        auto map = loaded ? CommandMap::Prepare(*loaded) : nullptr;
+        {
+            std::lock_guard<decltype(mutex_prepared_)> lock(mutex_prepared_);
+            loaded_.push_back({profile, std::move(loaded), std::move(map), generation});
+        }
+        triggerAsyncUpdate();
+    });
+}
+
+void ProfileManager::Finish_(LoadedProfile loaded)
+{
+    if (loaded.generation != generation_)
+        return; //a later switch replaced this one
+    if (!loaded.profile) {
+        loading_callbacks_(loaded.name, false);
+        return;
+    }
+    const auto& profile = loaded.name;
+    const auto& compiled = *loaded.profile;
+    command_map_->setPrepared(std::move(loaded.map));
+    command_map_->setLayer(0); //each profile starts on its base layer, modifiers held or not
+    if (compiled.has_controls)
+        controls_model_->setSettings(compiled.controls);
+    auto& cached = compiled_profiles_[profile]; //the watcher's next scan fills in a new one's time
+    if (!cached.profile)
+        cached = {cached.modified, loaded.profile};
+    const auto found = std::find(profiles_.begin(), profiles_.end(), profile);
+    if (found != profiles_.end())
+        current_profile_index_ = gsl::narrow_cast<int>(found - profiles_.begin());
+    callbacks_(compiled, profile);
+
+    if (const auto ptr = lr_ipc_out_.lock()) {
+        auto command = "ChangedToDirectory "s +
+            juce::File::addTrailingSeparator(profile_location_.getFullPathName()).toStdString() +
+            '\n';
+        ptr->sendCommand(command);
+        command = "ChangedToFile "s + profile.toStdString() + '\n';
+        ptr->sendCommand(command);
+        ptr->SendMappedParams(); //the plugin warms up for the new profile's commands
+    }
+    Prefetch_();
+}
+
+void ProfileManager::Prefetch_()
+{
+    const auto count = gsl::narrow_cast<int>(profiles_.size());
+    if (count < 2)
+        return;
+    std::map<juce::String, std::shared_ptr<const RSJ::CompiledProfile>> neighbours;
+    for (const auto step : {count - 1, 1}) {
+        const auto& name = profiles_[static_cast<size_t>((current_profile_index_ + step) % count)];
+        if (auto compiled = Compiled_(name))
+            neighbours.emplace(name, std::move(compiled));
+    }
+    std::lock_guard<decltype(mutex_prepared_)> lock(mutex_prepared_);
+    for (auto it = prepared_.begin(); it != prepared_.end();) {
+        const auto neighbour = neighbours.find(it->first);
+        if (neighbour == neighbours.end() || neighbour->second != it->second.profile)
+            it = prepared_.erase(it);
+        else
+            ++it;
+    }
+    for (const auto& neighbour : neighbours) {
+        if (prepared_.count(neighbour.first))
+            continue; //built or building
+        prepared_[neighbour.first] = {neighbour.second, nullptr};
+        const auto name = neighbour.first;
+        const auto compiled = neighbour.second;
+        prefetch_pool_.addJob([this, name, compiled] {
+            auto map = CommandMap::Prepare(*compiled);
+            std::lock_guard<decltype(mutex_prepared_)> job_lock(mutex_prepared_);
+            const auto entry = prepared_.find(name);
+            if (entry != prepared_.end() && entry->second.profile == compiled)
+                entry->second.map = std::move(map);
+        });
+    }
+}
+
+void ProfileManager::saveProfile(const juce::File& file) const
+{
+    command_map_->toXMLDocument(file, controls_model_);
 }
 
 void ProfileManager::switchToNextProfile()
@@ -118,9 +617,48 @@ void ProfileManager::switchToPreviousProfile()
     switchToProfile(current_profile_index_);
 }
 
-void ProfileManager::mapCommand(const RSJ::MidiMessageId& msg)
+void ProfileManager::switchToLayer(int layer)
+{
+    if (layer < 0 || layer >= RSJ::kLayers)
+        return;
+    const auto previous = command_map_->getLayer();
+    command_map_->setLayer(layer);
+    LayerChanged_(previous);
+}
+
+void ProfileManager::LayerChanged_(int previous)
+{
+    const auto layer = command_map_->getLayer();
+    if (layer != previous)
+        layer_callbacks_(previous, layer);
+}
+
+size_t ProfileManager::MemoryUse_()
+{
+    std::unordered_set<const RSJ::CompiledProfile*> counted; //caches share profiles
+    auto bytes = RSJ::HeapBytes(profiles_) + RSJ::HeapBytes(compiled_profiles_);
+    const auto add = [&bytes, &counted](const std::shared_ptr<const RSJ::CompiledProfile>& profile) {
+        if (profile && counted.insert(profile.get()).second)
+            bytes += ProfileBytes(*profile);
+    };
+    for (const auto& name : profiles_)
+        bytes += RSJ::HeapBytes(name);
+    for (const auto& entry : compiled_profiles_) {
+        bytes += RSJ::HeapBytes(entry.first);
+        add(entry.second.profile);
+    }
+    std::lock_guard<decltype(mutex_prepared_)> lock(mutex_prepared_);
+    bytes += RSJ::HeapBytes(prepared_);
+    for (const auto& entry : prepared_) {
+        add(entry.second.profile);
+        if (entry.second.map)
+            bytes += CommandMap::MemoryUse(*entry.second.map);
+    }
+    return bytes;
+}
+
+void ProfileManager::mapCommand(const std::string& cmd)
 {
-    const auto cmd = command_map_->getCommandforMessage(msg);
     if (cmd == "Previous Profile"s) {
         switch_state_ = SWITCH_STATE::PREV;
         triggerAsyncUpdate();
@@ -131,17 +669,36 @@ void ProfileManager::mapCommand(const RSJ::MidiMessageId& msg)
     }
 }
 
-void ProfileManager::MIDIcmdCallback(RSJ::MidiMessage mm)
+void ProfileManager::MIDIcmdCallback(const RSJ::ResolvedMessage& rm)
 {
-    if (command_map_) {
-        const RSJ::MidiMessageId cc = mm;
-        // return if the value isn't high enough (notes may be < 1), or the command isn't a valid
-        // profile-related command
-        if ((controls_model_->ControllerToPlugin(mm) < 0.4)
-            || !command_map_->messageExistsInMap(cc))
-            return;
-        mapCommand(cc);
+    if (!rm.command)
+        return;
+    // a modifier holds its layer from press to release, including Note Off
+    if (const auto modifier = CommandMap::getCommandModifier(rm.command_id)) {
+        const auto previous = command_map_->getLayer();
+        command_map_->setModifier(modifier, rm.value >= 0.4);
+        LayerChanged_(previous);
+        return;
+    }
+    // return if the value isn't high enough (notes may be < 1)
+    if (rm.value < 0.4)
+        return;
+    if (rm.command_flags & RSJ::kCommandPreviousProfile) {
+        switch_state_ = SWITCH_STATE::PREV;
+        triggerAsyncUpdate();
+    }
+    else if (rm.command_flags & RSJ::kCommandNextProfile) {
+        switch_state_ = SWITCH_STATE::NEXT;
+        triggerAsyncUpdate();
     }
+    // layers switch here on the MIDI thread, so the next message already uses the new one
+    else if (rm.command_flags & (RSJ::kCommandPreviousLayer | RSJ::kCommandNextLayer)) {
+        const auto count = command_map_->getLayerCount();
+        const auto step = rm.command_flags & RSJ::kCommandNextLayer ? 1 : count - 1;
+        switchToLayer((command_map_->getLatchedLayer() + step) % count);
+    }
+    else if (rm.command_flags & RSJ::kCommandLayer)
+        switchToLayer(CommandMap::getCommandLayer(rm.command_id));
 }
 
 void ProfileManager::ConnectionCallback(bool connected)
@@ -155,8 +712,27 @@ void ProfileManager::ConnectionCallback(bool connected)
     }
 }
 
+void ProfileManager::PowerCallback(bool idle)
+{
+    idle_ = idle;
+    if (watcher_)
+        watcher_->SetIdle(idle);
+}
+
 void ProfileManager::handleAsyncUpdate()
 {
+    ApplyScan_();
+    std::vector<juce::String> requested;
+    std::vector<LoadedProfile> loaded;
+    {
+        std::lock_guard<decltype(mutex_prepared_)> lock(mutex_prepared_);
+        requested.swap(requested_);
+        loaded.swap(loaded_);
+    }
+    for (auto& profile : loaded)
+        Finish_(std::move(profile));
+    for (const auto& profile : requested)
+        Begin_(profile);
     switch (switch_state_) {
     case SWITCH_STATE::PREV:
         switchToPreviousProfile();
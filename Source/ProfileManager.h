@@ -23,35 +23,56 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #define MIDI2LR_PROFILEMANAGER_H_INCLUDED
 
 #include <functional>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <string>
 #include <vector>
 #include "../JuceLibraryCode/JuceHeader.h"
-class CommandMap;
+#include "CommandMap.h"
+#include "Instrumentation.h"
+#include "Utilities/Utilities.h"
 class ControlsModel;
 class LR_IPC_OUT;
 class MIDIProcessor;
 namespace RSJ {
-    struct MidiMessage;
-    struct MidiMessageId;
+    struct ResolvedMessage;
 }
 
 class ProfileManager final: private juce::AsyncUpdater {
 public:
     ProfileManager(ControlsModel* const c_model, CommandMap* const cmap) noexcept;
-    virtual ~ProfileManager() = default;
+    virtual ~ProfileManager();
     ProfileManager(ProfileManager const&) = delete;
     void operator=(ProfileManager const&) = delete;
     void Init(std::weak_ptr<LR_IPC_OUT>&& out, MIDIProcessor* const midiProcessor);
 
-    template<class T>
-    void addCallback(T* const object,
-        void(T::* const mf)(juce::XmlElement*, const juce::String&))
+    // called after a switch, once the command map holds the new profile
+    template<class T, void(T::*MF)(const RSJ::CompiledProfile&, const juce::String&)>
+    void addCallback(T* const object)
     {
-        using namespace std::placeholders;
-        callbacks_.emplace_back(std::bind(mf, object, _1, _2));
+        callbacks_.add<T, MF>(object);
     }
 
-    // sets the default profile directory and scans its contents for profiles
+    // called with true when a switch has to wait for a profile to load, and with false
+    // if that load fails. The old profile stays active meanwhile
+    template<class T, void(T::*MF)(const juce::String&, bool)>
+    void addLoadingCallback(T* const object)
+    {
+        loading_callbacks_.add<T, MF>(object);
+    }
+
+    // called with the previous and new layer after a layer switch or a modifier press
+    // or release, on the thread that asked for it
+    template<class T, void(T::*MF)(int, int)>
+    void addLayerCallback(T* const object)
+    {
+        layer_callbacks_.add<T, MF>(object);
+    }
+
+    // sets the default profile directory. Its profiles are scanned and compiled in the
+    // background, switching to the first when done, and the directory is then watched
+    // so added or edited profiles are recompiled
     void setProfileDirectory(const juce::File& dir);
 
     // returns an array of profile names
@@ -60,23 +81,68 @@ class ProfileManager final: private juce::AsyncUpdater {
     // switches to a profile defined by an index
     void switchToProfile(int profileIdx);
 
-    // switches to a profile defined by a name
+    // switches to a profile defined by a name. Any thread; a profile not yet loaded
+    // and compiled is prepared on a worker and switched to once complete
     void switchToProfile(const juce::String& profile);
 
+    // saves the current mappings and control settings as a profile
+    void saveProfile(const juce::File& file) const;
+
     // switches to the next profile
     void switchToNextProfile();
 
     // switches to the previous profile
     void switchToPreviousProfile();
 
-    void MIDIcmdCallback(RSJ::MidiMessage);
+    // makes a layer of the current profile active, without reloading it. Held modifiers
+    // still win until released. Any thread
+    void switchToLayer(int layer);
+
+    void MIDIcmdCallback(const RSJ::ResolvedMessage&);
 
     void ConnectionCallback(bool);
 
+    // PowerMonitor callback, message thread: the directory isn't watched while idle
+    void PowerCallback(bool idle);
+
 private:
-    void mapCommand(const RSJ::MidiMessageId& msg);
+    class DirectoryWatcher;
+    // a compiled profile and the file time it was compiled from
+    struct CachedProfile {
+        juce::Time modified;
+        std::shared_ptr<const RSJ::CompiledProfile> profile;
+        bool pending{false}; //listed but still compiling, as opposed to not a profile
+    };
+    using ProfileCache = std::map<juce::String, CachedProfile>; //by file name
+    // compiles the profiles in a directory, reusing cache entries whose file is unchanged.
+    // New and edited profiles compile in parallel in name order; once the first is done
+    // progress gets the scan so far after each one, and returns false to stop
+    static ProfileCache Scan_(const juce::File& directory, const ProfileCache& cache,
+        const std::function<bool(const ProfileCache&)>& progress);
+    // the cached compiled profile for a file name, nullptr if none
+    std::shared_ptr<const RSJ::CompiledProfile> Compiled_(const juce::String& profile) const;
+    // takes the watcher's latest scan, message thread
+    void ApplyScan_();
+    // a profile load and compile finished on the worker
+    struct LoadedProfile {
+        juce::String name;
+        std::shared_ptr<const RSJ::CompiledProfile> profile; //nullptr if it failed
+        std::unique_ptr<CommandMap::Prepared> map;
+        unsigned generation;
+    };
+    // message thread parts of a switch: start it, and make a complete one active
+    void Begin_(const juce::String& profile);
+    void Finish_(LoadedProfile loaded);
+    // builds the command maps for the profiles either side of the current one in the
+    // background, so Next and Previous Profile only swap the map in
+    void Prefetch_();
+    // tells the layer callbacks if the layer lookups use has changed from previous
+    void LayerChanged_(int previous);
+    size_t MemoryUse_(); //message thread
+    void mapCommand(const std::string& cmd);
     // AsyncUpdate interface
     void handleAsyncUpdate() override;
+    constexpr static size_t kMaxCallbacks = 8;
     enum class SWITCH_STATE {
         NONE,
         PREV,
@@ -88,9 +154,29 @@ class ProfileManager final: private juce::AsyncUpdater {
     int current_profile_index_{0};
     juce::File profile_location_;
     std::vector<juce::String> profiles_;
-    std::vector<std::function<void(juce::XmlElement*, const juce::String&)>> callbacks_;
+    ProfileCache compiled_profiles_;
+    RSJ::callback_list<kMaxCallbacks, const RSJ::CompiledProfile&, const juce::String&> callbacks_;
+    RSJ::callback_list<kMaxCallbacks, const juce::String&, bool> loading_callbacks_;
+    RSJ::callback_list<kMaxCallbacks, int, int> layer_callbacks_;
+    unsigned generation_{0}; //latest switch requested, older loads are dropped
+    bool switch_after_scan_{false}; //go to the first profile once the directory is read
+    bool idle_{false}; //see PowerCallback
     std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
     SWITCH_STATE switch_state_{SWITCH_STATE::NONE};
+    std::mutex mutex_scan_;
+    std::unique_ptr<ProfileCache> scan_{nullptr}; //from the watcher, not yet applied
+    // a command map built from a compiled profile, nullptr while its job runs
+    struct PreparedProfile {
+        std::shared_ptr<const RSJ::CompiledProfile> profile;
+        std::unique_ptr<CommandMap::Prepared> map;
+    };
+    std::mutex mutex_prepared_;
+    std::map<juce::String, PreparedProfile> prepared_; //neighbours of the current profile
+    std::vector<juce::String> requested_; //switches asked for off the message thread
+    std::vector<LoadedProfile> loaded_; //from the worker, not yet applied
+    juce::ThreadPool prefetch_pool_{1}; //after what its jobs use
+    MemoryAccount memory_{"profile cache", [this] {return MemoryUse_(); }}; //after what it measures
+    std::unique_ptr<DirectoryWatcher> watcher_{nullptr}; //last, so it stops first
 };
 
 #endif  // PROFILEMANAGER_H_INCLUDED
@@ -0,0 +1,163 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    ProfileSync.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ProfileSync.h"
+#include <algorithm>
+#include "AsyncLog.h"
+#include "Instrumentation.h"
+#include "PowerMonitor.h"
+
+namespace {
+    constexpr int kStopWait = 2000; //a copy over the network may be under way
+    constexpr juce::uint64 kFnvOffset = 14695981039346656037ull;
+    constexpr juce::uint64 kFnvPrime = 1099511628211ull;
+    const juce::String kManifest{"sync_manifest.txt"}; //not *.xml, so never scanned as a profile
+
+    juce::uint64 Hash(const juce::MemoryBlock& data) noexcept
+    {
+        auto hash = kFnvOffset;
+        const auto bytes = static_cast<const juce::uint8*>(data.getData());
+        for (size_t i = 0; i < data.getSize(); ++i)
+            hash = (hash ^ bytes[i]) * kFnvPrime;
+        return hash;
+    }
+}
+
+ProfileSync::ProfileSync(const juce::File& source, int interval):
+    juce::Thread{"Profile sync"}, source_{source}, mirror_{Mirror()},
+    interval_{std::max(1, interval) * 1000}
+{
+    LoadManifest_();
+    juce::Thread::startThread(2); //well below the MIDI and IPC threads
+}
+
+ProfileSync::~ProfileSync()
+{
+    juce::Thread::signalThreadShouldExit();
+    juce::Thread::notify();
+    juce::Thread::stopThread(kStopWait);
+}
+
+juce::File ProfileSync::Mirror()
+{
+    const auto mirror = juce::File::getSpecialLocation(
+        juce::File::userApplicationDataDirectory).getChildFile("MIDI2LR").getChildFile("Profiles");
+    mirror.createDirectory();
+    return mirror;
+}
+
+void ProfileSync::run()
+{
+    while (!juce::Thread::threadShouldExit()) {
+        PowerMonitor::CountWakeUp();
+        Pass_();
+        juce::Thread::wait(interval_);
+    }
+}
+
+void ProfileSync::Pass_()
+{
+    static auto& fetched = Instrumentation::Counter("profiles fetched from the central directory");
+    static auto& removed = Instrumentation::Counter("synced profiles removed");
+    static auto& failures = Instrumentation::Counter("profile sync failures");
+    if (!source_.isDirectory()) { //share unreachable: switch from the mirror as it is
+        failures.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    juce::Array<juce::File> central;
+    source_.findChildFiles(central, juce::File::findFiles, false, "*.xml");
+    auto changed = false;
+    std::map<juce::String, Entry> listed;
+    for (const auto& file : central) {
+        if (juce::Thread::threadShouldExit())
+            return;
+        const auto name = file.getFileName();
+        const auto local = mirror_.getChildFile(name);
+        const Entry now{file.getSize(), file.getLastModificationTime().toMilliseconds(), 0};
+        const auto known = manifest_.find(name);
+        if (known != manifest_.end() && known->second.size == now.size &&
+            known->second.modified == now.modified && local.existsAsFile()) {
+            listed.emplace(name, known->second); //metadata alone: nothing read over the network
+            continue;
+        }
+        juce::MemoryBlock data;
+        if (!file.loadFileAsData(data)) {
+            failures.fetch_add(1, std::memory_order_relaxed);
+            if (known != manifest_.end())
+                listed.emplace(name, known->second); //keep the copy there is
+            continue;
+        }
+        auto entry = now;
+        entry.hash = Hash(data);
+        changed = true;
+        if (known == manifest_.end() || known->second.hash != entry.hash || !local.existsAsFile()) {
+            // written beside it and moved over, so the watcher never compiles half a file
+            const auto part = mirror_.getChildFile(name + ".part");
+            if (!part.replaceWithData(data.getData(), data.getSize()) || !part.moveFileTo(local)) {
+                part.deleteFile();
+                failures.fetch_add(1, std::memory_order_relaxed);
+                if (known != manifest_.end())
+                    listed.emplace(name, known->second); //tried again next pass
+                continue;
+            }
+            fetched.fetch_add(1, std::memory_order_relaxed);
+            AsyncLog::Write(RSJ::LogCategory::profile, RSJ::LogLevel::info,
+                "fetched profile %s", name.toRawUTF8());
+        }
+        listed.emplace(name, entry); //touched but unchanged: only the manifest is updated
+    }
+    for (const auto& entry : manifest_)
+        if (listed.find(entry.first) == listed.end()) {
+            const auto local = mirror_.getChildFile(entry.first);
+            local.deleteFile();
+            local.getSiblingFile(entry.first + ".bin").deleteFile(); //its compiled sidecar
+            removed.fetch_add(1, std::memory_order_relaxed);
+            changed = true;
+        }
+    if (changed) {
+        manifest_ = std::move(listed);
+        SaveManifest_();
+    }
+}
+
+void ProfileSync::LoadManifest_()
+{
+    // one "name<tab>size<tab>modified<tab>hash" line per profile fetched
+    juce::StringArray lines;
+    mirror_.getChildFile(kManifest).readLines(lines);
+    for (const auto& line : lines) {
+        const auto fields = juce::StringArray::fromTokens(line, "\t", "");
+        if (fields.size() == 4 && fields[0].isNotEmpty())
+            manifest_[fields[0]] = {fields[1].getLargeIntValue(), fields[2].getLargeIntValue(),
+                static_cast<juce::uint64>(fields[3].getHexValue64())};
+    }
+}
+
+void ProfileSync::SaveManifest_() const
+{
+    juce::String text;
+    for (const auto& entry : manifest_)
+        text << entry.first << "\t" << juce::String(entry.second.size) << "\t" <<
+        juce::String(entry.second.modified) << "\t" <<
+        juce::String::toHexString(static_cast<juce::int64>(entry.second.hash)) << "\n";
+    mirror_.getChildFile(kManifest).replaceWithText(text);
+}
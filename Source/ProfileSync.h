@@ -0,0 +1,64 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ProfileSync.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_PROFILESYNC_H_INCLUDED
+#define MIDI2LR_PROFILESYNC_H_INCLUDED
+
+#include <map>
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Keeps a local mirror of a central profile directory, such as a network share, so
+// profiles are managed in one place while switching only reads the local disk. A
+// low-priority thread lists the central directory every interval and fetches only
+// profiles whose size or time differ from the manifest kept in the mirror, copying
+// them only if their content hash changed too. ProfileManager watches the mirror and
+// compiles what arrives, so compiled sidecars stay local as well. Profiles saved into
+// the mirror by hand are left alone; only ones that came from the central directory
+// and have gone from it are removed
+class ProfileSync final: private juce::Thread {
+public:
+    // interval in seconds between passes over source
+    ProfileSync(const juce::File& source, int interval);
+    ~ProfileSync();
+    ProfileSync(const ProfileSync&) = delete;
+    ProfileSync& operator=(const ProfileSync&) = delete;
+    // the local directory profiles are switched from while syncing, created if missing
+    static juce::File Mirror();
+
+private:
+    struct Entry {
+        juce::int64 size{0};
+        juce::int64 modified{0}; //ms since 1970, as the central directory reports it
+        juce::uint64 hash{0}; //FNV-1a of the content
+    };
+    // Thread interface
+    void run() override;
+    void Pass_();
+    void LoadManifest_();
+    void SaveManifest_() const;
+
+    const juce::File source_;
+    const juce::File mirror_;
+    const int interval_; //ms
+    std::map<juce::String, Entry> manifest_; //by file name, the sync thread's only
+};
+
+#endif  // PROFILESYNC_H_INCLUDED
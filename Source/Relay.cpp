@@ -0,0 +1,166 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    Relay.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "Relay.h"
+#include <array>
+#include <cmath>
+#include <cstring>
+#include "LR_IPC_Out.h"
+
+namespace {
+    constexpr int kStopWait = 1000;
+    constexpr int kReadWait = 20; //ms, also how soon a new connection is accepted
+    constexpr size_t kReadSize = 16384;
+    constexpr size_t kMaxLine = 4096; //as LR_IPC_IN's buffer
+    constexpr char kPing[] = "RelayPing ";
+    constexpr char kPong[] = "RelayPong ";
+    constexpr size_t kPingLength = sizeof kPing - 1;
+}
+
+void RelayStats::Pong(double sent) noexcept
+{
+    const auto round_trip = juce::Time::getMillisecondCounterHiRes() - sent;
+    if (round_trip < 0.0)
+        return;
+    round_trip_.Record(round_trip);
+    const auto last = last_.exchange(round_trip, std::memory_order_relaxed);
+    if (last != 0.0) {
+        const auto jitter = jitter_.load(std::memory_order_relaxed);
+        jitter_.store(jitter + (std::abs(round_trip - last) - jitter) / 16.0,
+            std::memory_order_relaxed);
+    }
+}
+
+juce::String RelayStats::Report() const
+{
+    juce::String report{juce::String{name_} + ", value\n"};
+    report << "round trips, " << juce::String(round_trip_.Count()) << "\n"
+        << "round trip p50 ms, " << juce::String(round_trip_.PercentileMs(0.5), 3) << "\n"
+        << "round trip p99 ms, " << juce::String(round_trip_.PercentileMs(0.99), 3) << "\n"
+        << "round trip max ms, " << juce::String(round_trip_.MaxMs(), 3) << "\n"
+        << "jitter ms, " << juce::String(jitter_.load(std::memory_order_relaxed), 3) << "\n";
+    return report;
+}
+
+RelayServer::RelayServer(std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out, const juce::String& address):
+    juce::Thread{"RelayServer"}, lr_ipc_out_{std::move(lr_ipc_out)}
+{
+    listening_ = out_listener_.createListener(RSJ::kRelayOutPort, address) &&
+        in_listener_.createListener(RSJ::kRelayInPort, address);
+    if (listening_)
+        juce::Thread::startThread();
+}
+
+RelayServer::~RelayServer()
+{
+    juce::Thread::stopThread(kStopWait);
+}
+
+void RelayServer::run()
+{
+    while (!juce::Thread::threadShouldExit()) {
+        Accept_();
+        if (out_client_)
+            Receive_();
+        else
+            juce::Thread::wait(kReadWait);
+    }
+}
+
+void RelayServer::Accept_()
+{
+    if (!out_client_ && out_listener_.waitUntilReady(true, 0) == 1) {
+        out_client_.reset(out_listener_.waitForNextConnection());
+        partial_.clear();
+        connections_.fetch_add(1, std::memory_order_relaxed);
+    }
+    std::lock_guard<decltype(in_mutex_)> lock(in_mutex_);
+    if (!in_client_ && in_listener_.waitUntilReady(true, 0) == 1)
+        in_client_.reset(in_listener_.waitForNextConnection());
+}
+
+void RelayServer::Receive_()
+{
+    if (out_client_->waitUntilReady(true, kReadWait) != 1)
+        return;
+    std::array<char, kReadSize> buffer;
+    const auto read = out_client_->read(buffer.data(), static_cast<int>(buffer.size()), false);
+    if (read <= 0) { //the controller side went away; its feedback socket goes with it
+        out_client_.reset();
+        std::lock_guard<decltype(in_mutex_)> lock(in_mutex_);
+        in_client_.reset();
+        return;
+    }
+    partial_.append(buffer.data(), static_cast<size_t>(read));
+    const auto lr_ipc_out = lr_ipc_out_.lock();
+    size_t begin = 0;
+    for (auto end = partial_.find('\n'); end != std::string::npos; end = partial_.find('\n', begin)) {
+        const auto* const line = partial_.data() + begin;
+        const auto length = end + 1 - begin;
+        begin = end + 1;
+        if (length > kPingLength && std::memcmp(line, kPing, kPingLength) == 0) {
+            // answered here, so the round trip times the hop alone
+            std::string pong{kPong};
+            pong.append(line + kPingLength, length - kPingLength);
+            Send_(pong.data(), pong.size());
+        }
+        else if (lr_ipc_out) {
+            lr_ipc_out->sendCommand(std::string(line, length));
+            lines_in_.fetch_add(1, std::memory_order_relaxed);
+        }
+    }
+    partial_.erase(0, begin);
+    if (partial_.size() > kMaxLine) //no valid line is this long
+        partial_.clear();
+}
+
+void RelayServer::Forward(const char* begin, const char* end)
+{
+    Send_(begin, static_cast<size_t>(end - begin));
+}
+
+void RelayServer::Send_(const char* data, size_t size)
+{
+    std::lock_guard<decltype(in_mutex_)> lock(in_mutex_);
+    if (!in_client_)
+        return;
+    // a stalled controller side loses lines rather than holding up the plugin's reader
+    if (in_client_->waitUntilReady(false, 0) != 1) {
+        dropped_.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    if (in_client_->write(data, static_cast<int>(size)) < 0)
+        in_client_.reset();
+    else
+        lines_out_.fetch_add(1, std::memory_order_relaxed);
+}
+
+juce::String RelayServer::Report() const
+{
+    juce::String report{"relay server, value\n"};
+    report << "listening, " << (listening_ ? "yes" : "no, port in use") << "\n"
+        << "connections, " << juce::String(connections_.load(std::memory_order_relaxed)) << "\n"
+        << "lines to plugin, " << juce::String(lines_in_.load(std::memory_order_relaxed)) << "\n"
+        << "lines from plugin, " << juce::String(lines_out_.load(std::memory_order_relaxed)) << "\n"
+        << "lines dropped, " << juce::String(dropped_.load(std::memory_order_relaxed)) << "\n";
+    return report;
+}
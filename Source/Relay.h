@@ -0,0 +1,98 @@
+#pragma once
+/*
+  ==============================================================================
+
+    Relay.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_RELAY_H_INCLUDED
+#define MIDI2LR_RELAY_H_INCLUDED
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "LatencyStats.h"
+class LR_IPC_OUT;
+
+// Relaying between instances: one beside Lightroom runs a RelayServer, the other,
+// beside the controllers, points LR_IPC_OUT and LR_IPC_IN at it (relay_host). The
+// hop carries the plugin's own newline-framed protocol, so coalesced values and
+// compact records cross unchanged and the server adds no parsing of its own
+namespace RSJ {
+    constexpr int kRelayOutPort = 58765; //commands, controller side to server
+    constexpr int kRelayInPort = 58766; //plugin output, server to controller side
+}
+
+// round trip and jitter of the relay hop, from RelayPing lines the controller side
+// sends and the server answers with RelayPong, or of another hop named in the report.
+// Pong from one thread at a time
+class RelayStats {
+public:
+    explicit RelayStats(const char* name = "relay hop") noexcept: name_{name}
+    {}
+    RelayStats(const RelayStats&) = delete;
+    RelayStats& operator=(const RelayStats&) = delete;
+    // sent is juce::Time::getMillisecondCounterHiRes when the ping was sent
+    void Pong(double sent) noexcept;
+    juce::String Report() const;
+
+private:
+    const char* name_;
+    LatencyHistogram round_trip_;
+    std::atomic<double> last_{0.0};
+    std::atomic<double> jitter_{0.0}; //smoothed as RFC 3550 does
+};
+
+// accepts one controller-side instance, sends its lines to the local plugin through
+// lr_ipc_out and the plugin's lines back through Forward. Listens on address only
+class RelayServer final: private juce::Thread {
+public:
+    RelayServer(std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out, const juce::String& address);
+    ~RelayServer();
+    RelayServer(const RelayServer&) = delete;
+    RelayServer& operator=(const RelayServer&) = delete;
+    bool IsListening() const noexcept
+    {
+        return listening_;
+    }
+    // a line from the plugin, newline included. LR_IPC_IN's reader thread
+    void Forward(const char* begin, const char* end);
+    juce::String Report() const;
+
+private:
+    // Thread interface
+    void run() override;
+    void Accept_();
+    void Receive_();
+    void Send_(const char* data, size_t size);
+    std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
+    bool listening_{false};
+    juce::StreamingSocket out_listener_;
+    juce::StreamingSocket in_listener_;
+    std::unique_ptr<juce::StreamingSocket> out_client_; //relay thread only
+    std::string partial_; //unfinished line from out_client_, relay thread only
+    std::mutex in_mutex_; //guards in_client_, written from both threads
+    std::unique_ptr<juce::StreamingSocket> in_client_;
+    std::atomic<juce::uint64> lines_in_{0};
+    std::atomic<juce::uint64> lines_out_{0};
+    std::atomic<juce::uint64> dropped_{0};
+    std::atomic<juce::uint64> connections_{0};
+};
+
+#endif  // RELAY_H_INCLUDED
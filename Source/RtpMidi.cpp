@@ -0,0 +1,486 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    RtpMidi.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "RtpMidi.h"
+#include <algorithm>
+#include <array>
+#include <cstring>
+#include "Instrumentation.h"
+
+namespace {
+    constexpr int kStopWait = 1000;
+    constexpr int kReadWait = 20; //ms on each socket per turn
+    constexpr double kSessionTimeout = 60000.0; //ms without a packet before the session ends
+    constexpr double kFeedbackInterval = 1000.0; //ms between receiver feedback packets
+    constexpr size_t kMaxPacket = 2048;
+    constexpr juce::uint32 kProtocolVersion = 2;
+    constexpr juce::uint8 kPayloadType = 0x61;
+    constexpr char kSessionName[] = "MIDI2LR";
+
+    juce::uint32 Read16(const juce::uint8* data) noexcept
+    {
+        return static_cast<juce::uint32>(data[0]) << 8 | data[1];
+    }
+
+    juce::uint32 Read32(const juce::uint8* data) noexcept
+    {
+        return Read16(data) << 16 | Read16(data + 2);
+    }
+
+    void Write16(juce::uint8* data, juce::uint32 value) noexcept
+    {
+        data[0] = static_cast<juce::uint8>(value >> 8);
+        data[1] = static_cast<juce::uint8>(value);
+    }
+
+    void Write32(juce::uint8* data, juce::uint32 value) noexcept
+    {
+        Write16(data, value >> 16);
+        Write16(data + 2, value);
+    }
+
+    void Write64(juce::uint8* data, juce::uint64 value) noexcept
+    {
+        Write32(data, static_cast<juce::uint32>(value >> 32));
+        Write32(data + 4, static_cast<juce::uint32>(value));
+    }
+
+    // data bytes after a status byte, -1 for SysEx
+    int DataBytes(juce::uint8 status) noexcept
+    {
+        switch (status & 0xF0) {
+        case 0xC0:
+        case 0xD0:
+            return 1;
+        case 0xF0:
+            switch (status) {
+            case 0xF0:
+                return -1;
+            case 0xF1:
+            case 0xF3:
+                return 1;
+            case 0xF2:
+                return 2;
+            default:
+                return 0;
+            }
+        default:
+            return 2;
+        }
+    }
+}
+
+RtpMidiSession::RtpMidiSession(int control_port):
+    juce::Thread{"RTP-MIDI"}, ssrc_{static_cast<juce::uint32>(juce::Random::getSystemRandom().nextInt())}
+{
+    for (auto& channel : controllers_)
+        channel.fill(-1);
+    pitch_.fill(-1);
+    for (auto& channel : notes_)
+        channel.fill(false);
+    listening_ = control_.bindToPort(control_port) && data_.bindToPort(control_port + 1);
+}
+
+RtpMidiSession::~RtpMidiSession()
+{
+    Stop();
+}
+
+void RtpMidiSession::Stop()
+{
+    juce::Thread::signalThreadShouldExit();
+    End_(); //says goodbye, so the initiator doesn't wait for a timeout
+    control_.shutdown();
+    data_.shutdown();
+    juce::Thread::stopThread(kStopWait);
+}
+
+void RtpMidiSession::Start(std::function<void(const RSJ::MidiMessage&)> receiver)
+{
+    receiver_ = std::move(receiver);
+    if (listening_)
+        juce::Thread::startThread();
+}
+
+juce::uint64 RtpMidiSession::Now_() const noexcept
+{
+    return static_cast<juce::uint64>((juce::Time::getMillisecondCounterHiRes() - started_) * 10.0);
+}
+
+void RtpMidiSession::run()
+{
+    std::array<juce::uint8, kMaxPacket> buffer;
+    juce::String host;
+    auto port = 0;
+    while (!juce::Thread::threadShouldExit()) {
+        if (control_.waitUntilReady(true, kReadWait) == 1) {
+            const auto read = control_.read(buffer.data(), static_cast<int>(buffer.size()), false,
+                host, port);
+            if (read > 0)
+                Control_(control_, buffer.data(), static_cast<size_t>(read), host, port);
+        }
+        if (data_.waitUntilReady(true, kReadWait) == 1) {
+            const auto read = data_.read(buffer.data(), static_cast<int>(buffer.size()), false,
+                host, port);
+            if (read > 0)
+                Data_(buffer.data(), static_cast<size_t>(read), host, port);
+        }
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        std::lock_guard<decltype(peer_mutex_)> lock(peer_mutex_);
+        if (!connected_)
+            continue;
+        if (now - heard_ > kSessionTimeout) {
+            DBG("RTP-MIDI: session with " + peer_host_ + " timed out");
+            connected_ = false;
+            have_sequence_ = false;
+        }
+        else if (have_sequence_ && now - feedback_sent_ > kFeedbackInterval) {
+            // lets the initiator trim its journal to what is still unconfirmed
+            std::array<juce::uint8, 12> feedback{{0xFF, 0xFF, 'R', 'S'}};
+            Write32(feedback.data() + 4, ssrc_);
+            Write16(feedback.data() + 8, sequence_);
+            control_.write(peer_host_, peer_control_port_, feedback.data(),
+                static_cast<int>(feedback.size()));
+            feedback_sent_ = now;
+        }
+    }
+}
+
+void RtpMidiSession::Control_(juce::DatagramSocket& socket, const juce::uint8* data,
+    size_t size, const juce::String& host, int port)
+{
+    // session commands: 0xFFFF, two letters, then the command's fields
+    if (size < 8 || data[0] != 0xFF || data[1] != 0xFF)
+        return;
+    const auto command = Read16(data + 2);
+    if (command == ('I' << 8 | 'N') && size >= 16) {
+        const auto token = Read32(data + 8);
+        const auto ssrc = Read32(data + 12);
+        std::lock_guard<decltype(peer_mutex_)> lock(peer_mutex_);
+        const auto accept = !connected_ || ssrc == peer_ssrc_; //one initiator at a time
+        std::array<juce::uint8, 16 + sizeof kSessionName> reply{{0xFF, 0xFF,
+            static_cast<juce::uint8>(accept ? 'O' : 'N'), static_cast<juce::uint8>(accept ? 'K' : 'O')}};
+        Write32(reply.data() + 4, kProtocolVersion);
+        Write32(reply.data() + 8, token);
+        Write32(reply.data() + 12, ssrc_);
+        std::memcpy(reply.data() + 16, kSessionName, sizeof kSessionName);
+        socket.write(host, port, reply.data(), static_cast<int>(reply.size()));
+        if (!accept)
+            return;
+        // invited on the control port first, then on the data port
+        peer_ssrc_ = ssrc;
+        peer_host_ = host;
+        heard_ = juce::Time::getMillisecondCounterHiRes();
+        if (&socket == &control_)
+            peer_control_port_ = port;
+        else {
+            peer_data_port_ = port;
+            if (!connected_) {
+                connected_ = true;
+                have_sequence_ = false;
+                DBG("RTP-MIDI: session with " + host);
+            }
+        }
+    }
+    else if (command == ('B' << 8 | 'Y') && size >= 16) {
+        std::lock_guard<decltype(peer_mutex_)> lock(peer_mutex_);
+        if (Read32(data + 12) == peer_ssrc_) {
+            connected_ = false;
+            have_sequence_ = false;
+        }
+    }
+    else if (command == ('C' << 8 | 'K') && size >= 36) {
+        // the initiator's clock sync: count 0 is answered with count 1 and our time
+        if (data[8] != 0)
+            return;
+        std::array<juce::uint8, 36> reply;
+        std::memcpy(reply.data(), data, reply.size());
+        Write32(reply.data() + 4, ssrc_);
+        reply[8] = 1;
+        Write64(reply.data() + 20, Now_());
+        socket.write(host, port, reply.data(), static_cast<int>(reply.size()));
+        std::lock_guard<decltype(peer_mutex_)> lock(peer_mutex_);
+        heard_ = juce::Time::getMillisecondCounterHiRes();
+    }
+}
+
+void RtpMidiSession::Data_(const juce::uint8* data, size_t size, const juce::String& host,
+    int port)
+{
+    if (size >= 4 && data[0] == 0xFF && data[1] == 0xFF) {
+        Control_(data_, data, size, host, port);
+        return;
+    }
+    static auto& packets = Instrumentation::Counter("RTP-MIDI packets");
+    static auto& lost = Instrumentation::Counter("RTP-MIDI packets lost");
+    static auto& late = Instrumentation::Counter("RTP-MIDI packets late");
+    // RTP: version 2, payload type 0x61, then CSRCs and any extension
+    if (size < 12 || (data[0] & 0xC0) != 0x80 || (data[1] & 0x7F) != kPayloadType)
+        return;
+    const auto sequence = static_cast<juce::uint16>(Read16(data + 2));
+    {
+        std::lock_guard<decltype(peer_mutex_)> lock(peer_mutex_);
+        if (!connected_ || Read32(data + 8) != peer_ssrc_)
+            return;
+        heard_ = juce::Time::getMillisecondCounterHiRes();
+    }
+    auto offset = 12 + 4 * static_cast<size_t>(data[0] & 0x0F);
+    if ((data[0] & 0x10) && offset + 4 <= size)
+        offset += 4 + 4 * static_cast<size_t>(Read16(data + offset + 2));
+    if (offset >= size)
+        return;
+    packets.fetch_add(1, std::memory_order_relaxed);
+    auto gap = false;
+    if (have_sequence_) {
+        const auto ahead = static_cast<juce::int16>(sequence - sequence_);
+        if (ahead <= 0) {
+            late.fetch_add(1, std::memory_order_relaxed); //its values are already stale
+            return;
+        }
+        if (ahead > 1) {
+            lost.fetch_add(ahead - 1, std::memory_order_relaxed);
+            gap = true;
+        }
+    }
+    have_sequence_ = true;
+    sequence_ = sequence;
+    ProcessPayload(data + offset, size - offset, gap);
+}
+
+void RtpMidiSession::ProcessPayload(const juce::uint8* data, size_t size, bool gap)
+{
+    // MIDI command section: B J Z P LEN, LEN 12 bits when B is set
+    if (size < 1)
+        return;
+    const auto* const end = data + size;
+    auto length = static_cast<size_t>(data[0] & 0x0F);
+    auto list = data + 1;
+    if (data[0] & 0x80) {
+        if (size < 2)
+            return;
+        length = length << 8 | data[1];
+        ++list;
+    }
+    if (length > static_cast<size_t>(end - list))
+        return;
+    const auto* const list_end = list + length;
+    // the journal, after the list, holds the state before this packet
+    if (gap && (data[0] & 0x40))
+        Recover_(list_end, end);
+    Commands_(list, list_end, (data[0] & 0x20) != 0);
+}
+
+void RtpMidiSession::Commands_(const juce::uint8* data, const juce::uint8* end, bool delta_first)
+{
+    juce::uint8 running = 0;
+    auto delta = delta_first;
+    while (data < end) {
+        // every command but the first has a delta time of one to four bytes
+        if (delta)
+            for (auto count = 0; count < 4 && data < end; ++count)
+                if ((*data++ & 0x80) == 0)
+                    break;
+        delta = true;
+        if (data >= end)
+            break;
+        auto status = running;
+        if (*data & 0x80) {
+            status = *data++;
+            if (status < 0xF0)
+                running = status;
+            else if (status < 0xF8)
+                running = 0; //system common cancels running status
+        }
+        if (!status)
+            return; //data without a status
+        const auto bytes = DataBytes(status);
+        if (bytes < 0) { //SysEx, to its end or the end of its segment
+            while (data < end && *data != 0xF7 && *data != 0xF0 && *data != 0xF4)
+                ++data;
+            if (data < end)
+                ++data;
+            continue;
+        }
+        if (bytes > end - data)
+            return;
+        std::array<juce::uint8, 3> message{{status}};
+        for (auto i = 0; i < bytes; ++i) {
+            if (*data & 0x80)
+                return; //a status where data should be
+            message[static_cast<size_t>(i) + 1] = *data++;
+        }
+        if (status < 0xF0)
+            Deliver_(message.data(), bytes + 1);
+    }
+}
+
+void RtpMidiSession::Recover_(const juce::uint8* data, const juce::uint8* end)
+{
+    static auto& recovered = Instrumentation::Counter("RTP-MIDI values recovered");
+    // journal header: S Y A H TOTCHAN, checkpoint sequence number
+    if (end - data < 3)
+        return;
+    const auto flags = data[0];
+    const auto channels = (flags & 0x0F) + 1;
+    data += 3;
+    if (flags & 0x40) { //system journal, skipped
+        if (end - data < 2)
+            return;
+        data += ((data[0] & 0x03) << 8) | data[1];
+    }
+    if (!(flags & 0x20))
+        return;
+    const auto deliver = [this](juce::uint8 status, juce::uint8 first, juce::uint8 second) {
+        const std::array<juce::uint8, 3> message{{status, first, second}};
+        Deliver_(message.data(), 3);
+        recovered.fetch_add(1, std::memory_order_relaxed);
+    };
+    for (auto journal = 0; journal < channels && end - data >= 3; ++journal) {
+        // channel journal header: S CHAN H LENGTH, then the chapters present
+        const auto channel = static_cast<size_t>((data[0] >> 3) & 0x0F);
+        const auto length = ((data[0] & 0x03) << 8) | data[1];
+        const auto chapters = data[2];
+        if (length < 3 || length > end - data)
+            return;
+        const auto* const journal_end = data + length;
+        auto chapter = data + 3;
+        data = journal_end;
+        if (chapters & 0x80) //P, program change
+            chapter += 3;
+        if (chapters & 0x40) { //C, each controller's latest value
+            if (chapter >= journal_end)
+                continue;
+            const auto count = (*chapter++ & 0x7F) + 1;
+            for (auto i = 0; i < count && journal_end - chapter >= 2; ++i, chapter += 2) {
+                const auto number = static_cast<size_t>(chapter[0] & 0x7F);
+                const auto value = static_cast<short>(chapter[1] & 0x7F);
+                // A set is a toggle count rather than a value
+                if (!(chapter[1] & 0x80) && controllers_[channel][number] != value)
+                    deliver(static_cast<juce::uint8>(0xB0 | channel),
+                        static_cast<juce::uint8>(number), static_cast<juce::uint8>(value));
+            }
+        }
+        if (chapters & 0x20) { //M, parameter system, skipped
+            if (journal_end - chapter < 2)
+                continue;
+            chapter += ((chapter[0] & 0x03) << 8) | chapter[1];
+        }
+        if (chapters & 0x10) { //W, pitch wheel
+            if (journal_end - chapter < 2)
+                continue;
+            const auto value = (chapter[1] & 0x7F) << 7 | (chapter[0] & 0x7F);
+            if (pitch_[channel] != value)
+                deliver(static_cast<juce::uint8>(0xE0 | channel),
+                    static_cast<juce::uint8>(chapter[0] & 0x7F),
+                    static_cast<juce::uint8>(chapter[1] & 0x7F));
+            chapter += 2;
+        }
+        if (chapters & 0x08) { //N, notes on and notes since turned off
+            if (journal_end - chapter < 2)
+                continue;
+            const auto low = chapter[1] >> 4;
+            const auto high = chapter[1] & 0x0F;
+            auto logs = chapter[0] & 0x7F;
+            if (logs == 127 && low == 15 && high == 0)
+                logs = 128;
+            chapter += 2;
+            for (auto i = 0; i < logs && journal_end - chapter >= 2; ++i, chapter += 2) {
+                const auto note = static_cast<size_t>(chapter[0] & 0x7F);
+                const auto velocity = static_cast<juce::uint8>(chapter[1] & 0x7F);
+                if (velocity && !notes_[channel][note])
+                    deliver(static_cast<juce::uint8>(0x90 | channel),
+                        static_cast<juce::uint8>(note), velocity);
+            }
+            for (auto octet = low; octet <= high && chapter < journal_end; ++octet, ++chapter)
+                for (auto bit = 0; bit < 8; ++bit)
+                    if (*chapter & (0x80 >> bit))
+                        notes_[channel][static_cast<size_t>(octet * 8 + bit)] = false;
+        }
+    }
+}
+
+void RtpMidiSession::Deliver_(const juce::uint8* bytes, int size)
+{
+    const auto channel = static_cast<size_t>(bytes[0] & 0x0F);
+    switch (bytes[0] & 0xF0) {
+    case 0x80:
+        notes_[channel][bytes[1]] = false;
+        break;
+    case 0x90:
+        notes_[channel][bytes[1]] = bytes[2] != 0;
+        break;
+    case 0xB0:
+        controllers_[channel][bytes[1]] = bytes[2];
+        break;
+    case 0xE0:
+        pitch_[channel] = bytes[2] << 7 | bytes[1];
+        break;
+    default:
+        break;
+    }
+    if (receiver_) {
+        std::array<juce::uint8, 3> raw{};
+        std::copy_n(bytes, std::min(size, 3), raw.begin());
+        receiver_(RSJ::MidiMessage{raw.data()});
+    }
+}
+
+void RtpMidiSession::Send(const juce::MidiMessage& message)
+{
+    const auto size = message.getRawDataSize();
+    if (size <= 0 || size > 0x0FFF)
+        return;
+    std::array<juce::uint8, kMaxPacket> packet;
+    if (static_cast<size_t>(size) + 14 > packet.size())
+        return;
+    std::lock_guard<decltype(peer_mutex_)> lock(peer_mutex_);
+    if (!connected_)
+        return;
+    // RTP header, then a command section without journal
+    packet[0] = 0x80;
+    packet[1] = kPayloadType;
+    Write16(packet.data() + 2, ++send_sequence_);
+    Write32(packet.data() + 4, static_cast<juce::uint32>(Now_()));
+    Write32(packet.data() + 8, ssrc_);
+    auto offset = size_t{12};
+    if (size > 15) {
+        packet[offset++] = static_cast<juce::uint8>(0x80 | (size >> 8));
+        packet[offset++] = static_cast<juce::uint8>(size);
+    }
+    else
+        packet[offset++] = static_cast<juce::uint8>(size);
+    std::memcpy(packet.data() + offset, message.getRawData(), static_cast<size_t>(size));
+    data_.write(peer_host_, peer_data_port_, packet.data(),
+        static_cast<int>(offset + static_cast<size_t>(size)));
+}
+
+void RtpMidiSession::End_()
+{
+    std::lock_guard<decltype(peer_mutex_)> lock(peer_mutex_);
+    if (!connected_)
+        return;
+    std::array<juce::uint8, 16> goodbye{{0xFF, 0xFF, 'B', 'Y'}};
+    Write32(goodbye.data() + 4, kProtocolVersion);
+    Write32(goodbye.data() + 12, ssrc_);
+    control_.write(peer_host_, peer_control_port_, goodbye.data(), static_cast<int>(goodbye.size()));
+    connected_ = false;
+}
@@ -0,0 +1,100 @@
+#pragma once
+/*
+  ==============================================================================
+
+    RtpMidi.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_RTPMIDI_H_INCLUDED
+#define MIDI2LR_RTPMIDI_H_INCLUDED
+
+#include <array>
+#include <functional>
+#include <mutex>
+#include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiUtilities.h"
+
+// an RTP-MIDI (AppleMIDI) session endpoint: accepts one initiator (a wireless
+// controller, rtpMIDI or Audio MIDI Setup on another machine) on control_port and
+// control_port + 1, answers its clock sync and reports what it received. What arrives
+// goes to MIDIProcessor as one more input, and MIDISender sends feedback back through
+// Send. After lost packets the recovery journal of the next one restores controllers,
+// pitch wheels and notes; a packet older than one already taken is dropped, so a late
+// value never overwrites a newer one
+class RtpMidiSession final: private juce::Thread {
+public:
+    explicit RtpMidiSession(int control_port);
+    ~RtpMidiSession();
+    RtpMidiSession(const RtpMidiSession&) = delete;
+    RtpMidiSession& operator=(const RtpMidiSession&) = delete;
+    bool IsListening() const noexcept
+    {
+        return listening_;
+    }
+    // input and output name, which routes feedback to the session its control is on
+    const juce::String& Name() const noexcept
+    {
+        return name_;
+    }
+    // starts taking invitations; received messages go to receiver on the session's thread
+    void Start(std::function<void(const RSJ::MidiMessage&)> receiver);
+    // ends the session and stops receiving. Message thread
+    void Stop();
+    // one message to the connected initiator, dropped if there is none. Any one thread
+    void Send(const juce::MidiMessage& message);
+    // arrival of an RTP-MIDI payload (the RTP header removed), for the receiving
+    // thread or a harness. gap is packets lost just before it
+    void ProcessPayload(const juce::uint8* data, size_t size, bool gap);
+
+private:
+    // Thread interface
+    void run() override;
+    void Control_(juce::DatagramSocket& socket, const juce::uint8* data, size_t size,
+        const juce::String& host, int port);
+    void Data_(const juce::uint8* data, size_t size, const juce::String& host, int port);
+    void Commands_(const juce::uint8* data, const juce::uint8* end, bool delta_first);
+    void Recover_(const juce::uint8* data, const juce::uint8* end);
+    void Deliver_(const juce::uint8* bytes, int size);
+    void End_();
+    juce::uint64 Now_() const noexcept; //RTP-MIDI clock, 100 us units
+    bool listening_{false};
+    const juce::String name_{"RTP-MIDI"};
+    const juce::uint32 ssrc_;
+    const double started_{juce::Time::getMillisecondCounterHiRes()};
+    std::function<void(const RSJ::MidiMessage&)> receiver_;
+    juce::DatagramSocket control_{false};
+    juce::DatagramSocket data_{false};
+    // the initiator, guarded by peer_mutex_ as Send reads it on a MIDI output thread
+    std::mutex peer_mutex_;
+    bool connected_{false};
+    juce::uint32 peer_ssrc_{0};
+    juce::String peer_host_;
+    int peer_control_port_{0};
+    int peer_data_port_{0};
+    juce::uint16 send_sequence_{0};
+    // receiving thread only
+    bool have_sequence_{false};
+    juce::uint16 sequence_{0}; //latest taken
+    double heard_{0.0}; //ms, last packet from the initiator
+    double feedback_sent_{0.0}; //ms, last receiver feedback
+    // what the initiator last set, so recovery only delivers what the loss changed
+    std::array<std::array<short, 128>, 16> controllers_;
+    std::array<int, 16> pitch_;
+    std::array<std::array<bool, 128>, 16> notes_;
+};
+
+#endif  // RTPMIDI_H_INCLUDED
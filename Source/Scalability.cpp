@@ -0,0 +1,222 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    Scalability.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "Scalability.h"
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "CommandMap.h"
+#include "ControlsModel.h"
+#include "LatencyStats.h"
+#include "LR_IPC_Out.h"
+#include "LRCommands.h"
+#include "MIDIProcessor.h"
+#include "MidiUtilities.h"
+#include "MockLightroom.h"
+#include "Scheduler.h"
+
+namespace {
+    constexpr int kMaxControllers = 256; //16 devices by 16 channels
+    constexpr short kFaders = 32; //CC 0-31, absolute
+    constexpr short kEncoders = 16; //CC 32-47, two's complement
+    constexpr int kNrpnBase = 1000; //NRPN parameter of controller k is kNrpnBase + k
+    constexpr int kCoalesceInterval = 20; //ms, a typical coalesce_interval setting
+    constexpr int kSettle = 250; //ms for the link to connect before a step and drain after
+    constexpr double kBudgetMs = 10.0; //arrival to socket p99 within the ceiling
+    constexpr double kDelivered = 0.95; //share of offered messages within the ceiling
+
+    // counts what dispatch resolves, on the dispatching threads
+    class ResolvedCounter {
+    public:
+        void Resolved(const RSJ::ResolvedMessage&) noexcept
+        {
+            count.fetch_add(1, std::memory_order_relaxed);
+        }
+        std::atomic<juce::uint64> count{0};
+    };
+
+    // controller k is device k % 16 on channel k / 16, so each has its own NRPN and
+    // 14-bit assembly, and plays k % 3: a fader sweeping, an encoder turning back and
+    // forth or an NRPN sweeping, one value per message
+    void Play(MIDIProcessor& processor, int controller, int rate, const std::atomic<bool>& stop,
+        std::atomic<juce::uint64>& offered)
+    {
+        const auto device = static_cast<short>(controller % 16);
+        const auto channel = static_cast<short>(controller / 16 % 16);
+        const auto inject = [&processor, device, channel](short number, short value) {
+            RSJ::MidiMessage message{RSJ::kCCFlag, channel, number, value};
+            message.device = device;
+            processor.Inject(message);
+        };
+        const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(
+            std::chrono::duration<double>(1.0 / rate));
+        auto next = std::chrono::steady_clock::now();
+        for (size_t step = 0; !stop.load(std::memory_order_relaxed); ++step) {
+            switch (controller % 3) {
+            case 0:
+                inject(static_cast<short>(step / 128 % kFaders), static_cast<short>(step & 0x7F));
+                break;
+            case 1:
+                inject(static_cast<short>(kFaders + step / 64 % kEncoders),
+                    static_cast<short>(step & 64 ? 0x7F : 1));
+                break;
+            default:
+            {
+                const auto parameter = kNrpnBase + controller;
+                const auto value = static_cast<int>(step & 0x3FFF);
+                inject(99, static_cast<short>(parameter >> 7));
+                inject(98, static_cast<short>(parameter & 0x7F));
+                inject(6, static_cast<short>(value >> 7));
+                inject(38, static_cast<short>(value & 0x7F));
+            }
+            }
+            offered.fetch_add(1, std::memory_order_relaxed);
+            next += interval; //a late wake-up catches up, so the average rate holds
+            std::this_thread::sleep_until(next);
+        }
+    }
+
+    struct Row {
+        double offered; //messages/s
+        double delivered; //messages/s resolved by dispatch
+        double lines; //lines/s reaching the mock
+        double dispatch_p99; //ms, arrival to dispatch
+        double socket_p50; //ms, arrival to socket write
+        double socket_p99;
+        int dropped; //by the ingress queues
+        bool Within(double fraction) const noexcept
+        {
+            return !dropped && socket_p99 <= kBudgetMs && delivered >= offered * fraction;
+        }
+    };
+
+    Row Step(const CommandMap& map, ControlsModel& controls, Scheduler& scheduler,
+        const MockLightroom& mock, int controllers, bool sharded, int seconds, int rate)
+    {
+        auto processor = std::make_unique<MIDIProcessor>(&map, &controls);
+        ResolvedCounter counter;
+        processor->addResolvedCallback<ResolvedCounter, &ResolvedCounter::Resolved>(&counter);
+        if (sharded)
+            processor->SetDispatchShards(std::min(controllers,
+                static_cast<int>(std::max(1u, std::thread::hardware_concurrency()))));
+        processor->Init(true, false);
+        auto out = std::make_shared<LR_IPC_OUT>(&controls, &map, &scheduler);
+        out->Init(processor.get(), kCoalesceInterval);
+        juce::Thread::sleep(kSettle); //connected, and the mapped parameters sent
+        processor->ResetStats();
+        const auto lines_before = mock.LinesReceived();
+
+        std::atomic<bool> stop{false};
+        std::atomic<juce::uint64> offered{0};
+        const auto start = juce::Time::getMillisecondCounterHiRes();
+        std::vector<std::thread> threads;
+        for (auto controller = 0; controller < controllers; ++controller)
+            threads.emplace_back([&processor, controller, rate, &stop, &offered] {
+                Play(*processor, controller, rate, stop, offered);
+            });
+        juce::Thread::sleep(seconds * 1000);
+        stop.store(true, std::memory_order_relaxed);
+        for (auto& thread : threads)
+            thread.join();
+        const auto taken = (juce::Time::getMillisecondCounterHiRes() - start) / 1000.0;
+        const auto delivered = counter.count.load(std::memory_order_relaxed);
+        juce::Thread::sleep(kSettle); //held values flush and the socket drains
+
+        const auto& latency = processor->getLatencyStats();
+        const Row row{static_cast<double>(offered.load(std::memory_order_relaxed)) / taken,
+            static_cast<double>(delivered) / taken,
+            static_cast<double>(mock.LinesReceived() - lines_before) / taken,
+            latency.Histogram(LatencyStats::kDispatch).PercentileMs(0.99),
+            latency.Histogram(LatencyStats::kSocketWrite).PercentileMs(0.5),
+            latency.Histogram(LatencyStats::kSocketWrite).PercentileMs(0.99),
+            processor->getDroppedMessageCount()};
+        out.reset(); //as at shutdown, the link before its source
+        processor.reset();
+        return row;
+    }
+}
+
+juce::String RunScalability(int max_controllers, int seconds, int rate)
+{
+    MockLightroom::Options options;
+    options.interval = 0; //outbound only, feedback has its own benchmarks
+    const MockLightroom mock{options};
+    if (!mock.IsListening())
+        return "scale, result\nlightroom ports, in use\n";
+    // each control on a plain parameter command: no actions, profiles or layers
+    std::vector<RSJ::CommandId> commands;
+    for (RSJ::CommandId id = 1; id < LRCommandList::LRStringList.size(); ++id)
+        if (!CommandMap::getCommandFlags(id))
+            commands.push_back(id);
+    CommandMap map;
+    ControlsModel controls;
+    size_t next{0};
+    for (auto channel = 1; channel <= 16; ++channel) {
+        for (auto controller = 0; controller < kFaders + kEncoders; ++controller)
+            map.addCommandforMessage(commands[next++ % commands.size()],
+                RSJ::MidiMessageId{channel, controller, RSJ::MsgIdEnum::CC});
+        for (short encoder = 0; encoder < kEncoders; ++encoder)
+            controls.setCCmethod(static_cast<size_t>(channel - 1),
+                static_cast<short>(kFaders + encoder), RSJ::CCmethod::twoscomplement);
+    }
+    for (auto controller = 0; controller < kMaxControllers; ++controller)
+        map.addCommandforMessage(commands[next++ % commands.size()], RSJ::MidiMessageId{
+            controller / 16 % 16 + 1, kNrpnBase + controller, RSJ::MsgIdEnum::CC});
+    Scheduler scheduler;
+
+    max_controllers = std::min(max_controllers, kMaxControllers);
+    juce::String report{"controllers, dispatch, offered msg/s, delivered msg/s, lines/s, "
+        "dispatch p99 ms, socket p50 ms, socket p99 ms, dropped\n"};
+    // the ceiling is the last count within budget before the first one over it
+    std::array<int, 2> ceiling{{0, 0}};
+    std::array<bool, 2> over{{false, false}};
+    for (auto controllers = 1; controllers <= max_controllers; controllers *= 2)
+        for (const auto sharded : {false, true}) {
+            if (sharded && controllers == 1)
+                continue; //no different from one thread
+            const auto row = Step(map, controls, scheduler, mock, controllers, sharded, seconds,
+                std::max(1, rate));
+            report << juce::String(controllers) << ", " << (sharded ? "sharded" : "one thread")
+                << ", " << juce::String(row.offered, 0) << ", " << juce::String(row.delivered, 0)
+                << ", " << juce::String(row.lines, 0) << ", " << juce::String(row.dispatch_p99, 3)
+                << ", " << juce::String(row.socket_p50, 3) << ", "
+                << juce::String(row.socket_p99, 3) << ", " << juce::String(row.dropped) << "\n";
+            const auto record = [&row, &ceiling, &over, controllers](size_t dispatch) {
+                if (!row.Within(kDelivered))
+                    over[dispatch] = true;
+                else if (!over[dispatch])
+                    ceiling[dispatch] = controllers;
+            };
+            record(sharded ? 1 : 0);
+            if (controllers == 1)
+                record(1); //sharding starts from the one-thread run
+        }
+    report << "ceiling one thread, " << juce::String(ceiling[0]) << ", , , , , , , \n"
+        << "ceiling sharded, " << juce::String(ceiling[1]) << ", , , , , , , \n"
+        << "budget, socket p99 " << juce::String(kBudgetMs, 1) << " ms with "
+        << juce::String(kDelivered * 100.0, 0) << "% delivered and no drops, , , , , , , \n";
+    return report;
+}
@@ -0,0 +1,36 @@
+#pragma once
+/*
+  ==============================================================================
+
+    Scalability.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_SCALABILITY_H_INCLUDED
+#define MIDI2LR_SCALABILITY_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// Finds how many controllers one instance sustains, for --scale. Synthetic
+// controllers, each a thread injecting above the MIDI backend at rate messages per
+// second, play faders, encoders or NRPNs through MIDIProcessor and a coalescing
+// LR_IPC_OUT to a MockLightroom. Their number doubles up to max_controllers, each
+// count run for seconds with one dispatch thread and then sharded. Returns
+// "controllers, dispatch, ..." CSV rows and the largest count within the latency
+// budget for each. Fails if the Lightroom ports are taken
+juce::String RunScalability(int max_controllers, int seconds, int rate);
+
+#endif  // SCALABILITY_H_INCLUDED
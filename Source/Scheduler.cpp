@@ -0,0 +1,113 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    Scheduler.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "Scheduler.h"
+#include <algorithm>
+#include <utility>
+#include "ThreadStats.h"
+
+namespace {
+    constexpr int kStopWait = 1000;
+}
+
+Scheduler::Scheduler(): juce::Thread{"Scheduler"}
+{
+    juce::Thread::startThread();
+}
+
+Scheduler::~Scheduler()
+{
+    {
+        std::lock_guard<decltype(mutex_)> lock(mutex_);
+        exit_ = true;
+    }
+    wake_.notify_one();
+    juce::Thread::stopThread(kStopWait);
+}
+
+Scheduler::TaskId Scheduler::Schedule(std::function<void()> task, double delay, double period)
+{
+    const auto to_duration = [](double ms) {
+        return std::chrono::duration_cast<Clock::duration>(
+            std::chrono::duration<double, std::milli>(std::max(ms, 0.0)));
+    };
+    TaskId id;
+    {
+        std::lock_guard<decltype(mutex_)> lock(mutex_);
+        do
+            id = ++next_id_;
+        while (id == 0 || tasks_.count(id)); //0 is never a task
+        tasks_.emplace(id, Task{std::move(task), period > 0.0 ? to_duration(period) :
+            Clock::duration::zero()});
+        due_.push({Clock::now() + to_duration(delay), id});
+    }
+    wake_.notify_one();
+    return id;
+}
+
+void Scheduler::Cancel(TaskId id)
+{
+    std::unique_lock<decltype(mutex_)> lock(mutex_);
+    const auto found = tasks_.find(id);
+    if (found == tasks_.end())
+        return;
+    found->second.cancelled = true;
+    if (running_ == id) {
+        if (juce::Thread::getCurrentThreadId() == juce::Thread::getThreadId())
+            return; //run erases it once the task returns
+        finished_.wait(lock, [this, id] {return running_ != id; });
+        return; //erased by run
+    }
+    tasks_.erase(found);
+}
+
+void Scheduler::run()
+{
+    const ThreadAccount account{"Scheduler"};
+    std::unique_lock<decltype(mutex_)> lock(mutex_);
+    while (!exit_) {
+        if (due_.empty()) {
+            wake_.wait(lock);
+            continue;
+        }
+        const auto next = due_.top();
+        if (next.when > Clock::now()) {
+            wake_.wait_until(lock, next.when); //earlier tasks may be added meanwhile
+            continue;
+        }
+        due_.pop();
+        const auto found = tasks_.find(next.id);
+        if (found == tasks_.end())
+            continue; //cancelled
+        auto& task = found->second;
+        running_ = next.id;
+        lock.unlock();
+        task.function();
+        lock.lock();
+        running_ = 0;
+        if (task.cancelled || task.period == Clock::duration::zero())
+            tasks_.erase(next.id);
+        else //fixed rate, but a late task doesn't run several times to catch up
+            due_.push({std::max(next.when + task.period, Clock::now()), next.id});
+        finished_.notify_all();
+    }
+}
@@ -0,0 +1,77 @@
+#pragma once
+/*
+  ==============================================================================
+
+    Scheduler.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_SCHEDULER_H_INCLUDED
+#define MIDI2LR_SCHEDULER_H_INCLUDED
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <unordered_map>
+#include <vector>
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// One thread running timed tasks for the application, so that timing on the hot
+// path doesn't wait on the message loop. Tasks run on the scheduler's thread and
+// should be brief; anything touching components still belongs on a juce::Timer
+class Scheduler final: private juce::Thread {
+public:
+    using TaskId = juce::uint32;
+    Scheduler();
+    ~Scheduler();
+    Scheduler(const Scheduler&) = delete;
+    Scheduler& operator=(const Scheduler&) = delete;
+    // runs task after delay ms, then every period ms if period is positive. Any thread
+    TaskId Schedule(std::function<void()> task, double delay, double period = 0.0);
+    // the task doesn't run after this returns, unless Cancel was called by the task
+    // itself. Any thread
+    void Cancel(TaskId id);
+
+private:
+    using Clock = std::chrono::steady_clock;
+    struct Task {
+        std::function<void()> function;
+        Clock::duration period;
+        bool cancelled{false};
+    };
+    struct Due {
+        Clock::time_point when;
+        TaskId id;
+        bool operator>(const Due& other) const noexcept
+        {
+            return when > other.when;
+        }
+    };
+    // Thread interface
+    void run() override;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    std::condition_variable finished_; //running_ task returned
+    std::priority_queue<Due, std::vector<Due>, std::greater<Due>> due_; //may hold cancelled ids
+    std::unordered_map<TaskId, Task> tasks_; //entries don't move, so one can run unlocked
+    TaskId next_id_{0};
+    TaskId running_{0};
+    bool exit_{false};
+};
+
+#endif  // SCHEDULER_H_INCLUDED
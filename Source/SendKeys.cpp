@@ -22,9 +22,14 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "SendKeys.h"
 #include <algorithm>
+#include <atomic>
 #include <cctype>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
 #include <mutex>
 #include <stdexcept>
+#include <thread>
 #include <unordered_map>
 #include <vector>
 #include <gsl/gsl>
@@ -35,8 +40,9 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #import <CoreGraphics/CoreGraphics.h>
 #import <Carbon/Carbon.h>
 #include <cassert>
+#include <cerrno>
+#include <csignal>
 #include <libproc.h>
-#include <thread>
 #endif
 namespace {
 #ifndef _WIN32
@@ -65,6 +71,34 @@ namespace {
         return 0;
     }
 
+    // Lightroom's process, found with the full scan above only when the cached one
+    // has exited or LR_IPC_IN reconnects. lr_pid 0 is not found: keys then go to
+    // the front process and the next key scans again
+    std::mutex mutex_process_{};
+    pid_t lr_pid{0};
+    ProcessSerialNumber lr_psn{0};
+
+    void ResolveProcess() //call with mutex_process_ held
+    {
+        lr_pid = GetPID();
+        #pragma GCC diagnostic push
+        #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
+        if (lr_pid == 0 || GetProcessForPID(lr_pid, &lr_psn) != noErr) { //first deprecated in macOS 10.9, but no good replacement yet
+            lr_pid = 0;
+            GetFrontProcess(&lr_psn); //first deprecated in macOS 10.9, but no good replacement yet
+        }
+        #pragma GCC diagnostic pop
+    }
+
+    ProcessSerialNumber LightroomProcess()
+    {
+        std::lock_guard<decltype(mutex_process_)> lock(mutex_process_);
+        // kill with no signal only checks that the process still exists
+        if (lr_pid == 0 || (kill(lr_pid, 0) != 0 && errno == ESRCH))
+            ResolveProcess();
+        return lr_psn;
+    }
+
     /* From: https://stackoverflow.com/questions/1918841/how-to-convert-ascii-character-to-cgkeycode/1971027#1971027
      *
      * Returns string representation of key, if it is printable.
@@ -96,46 +130,46 @@ namespace {
         return CFStringCreateWithCharacters(kCFAllocatorDefault, chars, 1);
     }
 
-    /* From: https://stackoverflow.com/questions/1918841/how-to-convert-ascii-character-to-cgkeycode/1971027#1971027
-     *
-     * Returns key code for given character via the above function, or UINT16_MAX
-     * on error. */
-    CGKeyCode keyCodeForChar(const char c)
+    // character to key code for the current input source. Tables are built off the
+    // keystroke thread at start-up and on each input source change, then published
+    // with one shared_ptr store, so lookups never wait. A replaced table is freed
+    // once the last lookup reading it is done
+    using KeyTable = std::unordered_map<UniChar, CGKeyCode>;
+    std::shared_ptr<const KeyTable> key_table_{}; //only through std::atomic_load/store
+    std::mutex mutex_key_tables_{}; //one build at a time, so the newest layout is published last
+
+    std::shared_ptr<const KeyTable> BuildKeyTable()
     {
-        static CFMutableDictionaryRef charToCodeDict = NULL;
-        CGKeyCode code;
-        UniChar character = c;
-        CFStringRef charStr = NULL;
-
-        /* Generate table of keycodes and characters. */
-        if (charToCodeDict == NULL) {
-            size_t i;
-            charToCodeDict = CFDictionaryCreateMutable(kCFAllocatorDefault,
-                128,
-                &kCFCopyStringDictionaryKeyCallBacks,
-                NULL);
-            if (charToCodeDict == NULL) return UINT16_MAX;
-
-            /* Loop through every keycode (0 - 127) to find its current mapping. */
-            for (i = 0; i < 128; ++i) {
-                CFStringRef string = createStringForKey((CGKeyCode)i);
-                if (string != NULL) {
-                    CFDictionaryAddValue(charToCodeDict, string, (const void *)i);
-                    CFRelease(string);
-                }
+        std::lock_guard<decltype(mutex_key_tables_)> lock(mutex_key_tables_);
+        auto table = std::make_shared<KeyTable>();
+        /* Loop through every keycode (0 - 127) to find its current mapping. */
+        for (CGKeyCode i = 0; i < 128; ++i) {
+            CFStringRef string = createStringForKey(i);
+            if (string != NULL) {
+                if (CFStringGetLength(string) > 0)
+                    table->emplace(CFStringGetCharacterAtIndex(string, 0), i); //first code wins
+                CFRelease(string);
             }
         }
+        std::shared_ptr<const KeyTable> built{std::move(table)};
+        std::atomic_store_explicit(&key_table_, built, std::memory_order_release);
+        return built;
+    }
 
-        charStr = CFStringCreateWithCharacters(kCFAllocatorDefault, &character, 1);
-
-        /* Our values may be NULL (0), so we need to use this function. */
-        if (!CFDictionaryGetValueIfPresent(charToCodeDict, charStr,
-            (const void **)&code)) {
-            code = UINT16_MAX;
-        }
+    void KeyboardLayoutChanged(CFNotificationCenterRef, void*, CFStringRef, const void*,
+        CFDictionaryRef)
+    {
+        std::thread(BuildKeyTable).detach();
+    }
 
-        CFRelease(charStr);
-        return code;
+    /* Returns key code for given character, or UINT16_MAX on error. */
+    CGKeyCode keyCodeForChar(const char c)
+    {
+        auto table = std::atomic_load_explicit(&key_table_, std::memory_order_acquire);
+        if (!table) //a key before the start-up build finished
+            table = BuildKeyTable();
+        const auto found = table->find(static_cast<UniChar>(c));
+        return found == table->end() ? UINT16_MAX : found->second;
     }
 
 #endif
@@ -172,15 +206,41 @@ namespace {
 
     HKL GetLanguage(const std::string& program_name)
     {
-        const auto hLRWnd = FindWindow(nullptr, program_name.c_str());
-        if (hLRWnd) {
-            // get language that LR is using (if hLrWnd is found)
-            const auto thread_id = GetWindowThreadProcessId(hLRWnd, nullptr);
-            return GetKeyboardLayout(thread_id);
+        // FindWindow walks every top-level window, so keep the handle until the
+        // window goes away. Call with mutex_translation_ held
+        static HWND lr_window{nullptr};
+        static DWORD lr_thread{0};
+        if (!lr_window || !IsWindow(lr_window)) {
+            lr_window = FindWindow(nullptr, program_name.c_str());
+            lr_thread = lr_window ? GetWindowThreadProcessId(lr_window, nullptr) : 0;
         }
+        if (lr_window) // get language that LR is using (if hLrWnd is found)
+            return GetKeyboardLayout(lr_thread);
         // use keyboard of MIDI2LR application
         return GetKeyboardLayout(0);
     }
+
+    // VkKeyScanExW results for the layout Lightroom last used, dropped when it
+    // switches layout
+    std::mutex mutex_translation_{};
+    HKL translation_layout_{nullptr};
+    std::unordered_map<std::string, SHORT> translations_{};
+
+    SHORT TranslateKey(const std::string& key)
+    {
+        std::lock_guard<decltype(mutex_translation_)> lock(mutex_translation_);
+        const auto language_id = GetLanguage("Lightroom");
+        if (language_id != translation_layout_) {
+            translations_.clear();
+            translation_layout_ = language_id;
+        }
+        const auto found = translations_.find(key);
+        if (found != translations_.end())
+            return found->second;
+        const auto vk_code_and_shift = VkKeyScanExW(MBtoWChar(key), language_id);
+        translations_.emplace(key, vk_code_and_shift);
+        return vk_code_and_shift;
+    }
 #endif
 
     const std::unordered_map<std::string, unsigned char> key_map_ = {
@@ -291,12 +351,23 @@ namespace {
     };
 
     std::mutex mutex_sending_{};
+#ifndef _WIN32
+    struct KeyEvents {
+        CGEventRef down{nullptr}; //kept for the life of the application
+        CGEventRef up{nullptr};
+        uint64_t flags{0}; //flags the key code itself needs
+        uint64_t default_flags{0}; //as created, sent when no modifiers apply
+    };
+#endif
 }
 
 void RSJ::SendKeyDownUp(const std::string& key, const bool alt_opt,
     const bool control_cmd, const bool shift)
 {
-    const auto mapped_key = key_map_.find(to_lower(key));
+    // the plugin sends key names in lower case, so only fold case when that misses
+    auto mapped_key = key_map_.find(key);
+    if (mapped_key == key_map_.end())
+        mapped_key = key_map_.find(to_lower(key));
     const auto in_keymap = mapped_key != key_map_.end();
 
 #ifdef _WIN32
@@ -306,8 +377,7 @@ void RSJ::SendKeyDownUp(const std::string& key, const bool alt_opt,
     if (in_keymap)
         vk = mapped_key->second;
     else {// Translate key code to keyboard-dependent scan code, may be UTF-8
-        const auto language_id = GetLanguage("Lightroom");
-        const auto vk_code_and_shift = VkKeyScanExW(MBtoWChar(key), language_id);
+        const auto vk_code_and_shift = TranslateKey(key);
         vk = LOBYTE(vk_code_and_shift);
         vk_modifiers = HIBYTE(vk_code_and_shift);
     }
@@ -331,73 +401,126 @@ void RSJ::SendKeyDownUp(const std::string& key, const bool alt_opt,
             strokes.push_back(VK_MENU);
     }
 
-    // construct input event.
-    INPUT ip;
-    constexpr auto size_ip = sizeof(ip);
-    ip.type = INPUT_KEYBOARD;
-    //ki: wVk, wScan, dwFlags, time, dwExtraInfo
-    ip.ki = {0, 0, 0, 0, 0};
-
-    //send key down strokes
-    std::lock_guard<decltype(mutex_sending_)> lock(mutex_sending_);
-    for (auto it = strokes.crbegin(); it != strokes.crend(); ++it) {
-        ip.ki.wVk = *it;
-        SendInput(1, &ip, size_ip);
+    // the whole chord goes in one SendInput call, so other input can't land
+    // between its strokes: key down strokes (mods first), then key up strokes
+    std::vector<INPUT> inputs(strokes.size() * 2);
+    auto input = inputs.begin();
+    for (auto it = strokes.crbegin(); it != strokes.crend(); ++it, ++input) {
+        input->type = INPUT_KEYBOARD;
+        //ki: wVk, wScan, dwFlags, time, dwExtraInfo
+        input->ki = {*it, 0, 0, 0, 0};
     }
-    //send key up strokes
-    ip.ki.dwFlags = KEYEVENTF_KEYUP; // KEYEVENTF_KEYUP for key release
     for (const auto it : strokes) {
-        ip.ki.wVk = it;
-        SendInput(1, &ip, size_ip);
+        input->type = INPUT_KEYBOARD;
+        input->ki = {it, 0, KEYEVENTF_KEYUP, 0, 0}; // KEYEVENTF_KEYUP for key release
+        ++input;
     }
+    std::lock_guard<decltype(mutex_sending_)> lock(mutex_sending_);
+    SendInput(gsl::narrow_cast<UINT>(inputs.size()), inputs.data(), sizeof(INPUT));
 #else
-    static ProcessSerialNumber psn{0};
-    static pid_t lr_pid{0};
-    if (lr_pid == 0) {
-        lr_pid = GetPID();
-        #pragma GCC diagnostic push
-        #pragma GCC diagnostic ignored "-Wdeprecated-declarations"
-        if (lr_pid) {
-            GetProcessForPID(lr_pid, &psn); //first deprecated in macOS 10.9, but no good replacement yet
-        }
-        else {
-            lr_pid = -1; // cannot find LR pid, to try to find the forground process
-            GetFrontProcess(&psn); //first deprecated in macOS 10.9, but no good replacement yet
-        }
-        #pragma GCC diagnostic pop
-    }
+    auto psn = LightroomProcess();
 
-    CGEventRef d;
-    CGEventRef u;
-    uint64_t flags = 0;
+    // the events for each key code are created once and reused, setting the
+    // modifiers each time
+    static std::unordered_map<CGKeyCode, KeyEvents> key_events;
+    const CGKeyCode key_code = in_keymap ? mapped_key->second : keyCodeForChar(key[0]);
 
-    if (in_keymap) {
-        const auto vk = mapped_key->second;
-        d = CGEventCreateKeyboardEvent(NULL, vk, true);
-        u = CGEventCreateKeyboardEvent(NULL, vk, false);
-    }
-    else {
-        const CGKeyCode keyCode = keyCodeForChar(key[0]);
-        d = CGEventCreateKeyboardEvent(NULL, keyCode, true);
-        u = CGEventCreateKeyboardEvent(NULL, keyCode, false);
-        flags = CGEventGetFlags(d); //in case KeyCode has associated flag
+    std::lock_guard<decltype(mutex_sending_)> lock(mutex_sending_);
+    auto events = key_events.find(key_code);
+    if (events == key_events.end()) {
+        KeyEvents created;
+        created.down = CGEventCreateKeyboardEvent(NULL, key_code, true);
+        created.up = CGEventCreateKeyboardEvent(NULL, key_code, false);
+        created.default_flags = CGEventGetFlags(created.down);
+        if (!in_keymap)
+            created.flags = created.default_flags; //in case KeyCode has associated flag
+        events = key_events.emplace(key_code, created).first;
     }
-
+    auto flags = events->second.flags;
     if (control_cmd) flags |= kCGEventFlagMaskCommand;
     if (alt_opt) flags |= kCGEventFlagMaskAlternate;
     if (shift) flags |= kCGEventFlagMaskShift;
-    if (flags) {
-        CGEventSetFlags(d, static_cast<CGEventFlags>(flags));
-        CGEventSetFlags(u, static_cast<CGEventFlags>(flags));
+    if (!flags) //a reused event may still carry the last key's modifiers
+        flags = events->second.default_flags;
+    CGEventSetFlags(events->second.down, static_cast<CGEventFlags>(flags));
+    CGEventSetFlags(events->second.up, static_cast<CGEventFlags>(flags));
+    CGEventPostToPSN(&psn, events->second.down);
+    CGEventPostToPSN(&psn, events->second.up);
+#endif
+}
+
+void RSJ::RefreshLightroomProcess()
+{
+#ifndef _WIN32
+    std::lock_guard<decltype(mutex_process_)> lock(mutex_process_);
+    ResolveProcess();
+#endif // Windows looks up Lightroom's window, which is checked on every key
+}
+
+RSJ::KeyMacro RSJ::ParseKeyMacro(const std::string& text)
+{
+    const auto trim = [](const std::string& in) {
+        const auto first = in.find_first_not_of(" \t");
+        if (first == std::string::npos)
+            return std::string{};
+        return in.substr(first, in.find_last_not_of(" \t") - first + 1);
+    };
+    KeyMacro macro;
+    auto delay = 0;
+    std::string::size_type start = 0;
+    while (start <= text.size()) {
+        auto stop = text.find(',', start);
+        if (stop == std::string::npos)
+            stop = text.size();
+        const auto step = trim(text.substr(start, stop - start));
+        start = stop + 1;
+        const auto lower = to_lower(step);
+        if (lower.compare(0, 5, "wait ") == 0) {
+            delay += std::max(0, std::atoi(lower.c_str() + 5));
+            continue;
+        }
+        // modifiers are the '+' separated names before the key, which may itself be '+'
+        KeyStroke stroke;
+        auto key_start = std::string::size_type{0};
+        for (auto plus = step.find('+'); plus != std::string::npos && plus + 1 < step.size();
+            plus = step.find('+', key_start)) {
+            const auto modifier = to_lower(trim(step.substr(key_start, plus - key_start)));
+            if (modifier == "alt" || modifier == "option")
+                stroke.alt_opt = true;
+            else if (modifier == "ctrl" || modifier == "control" || modifier == "cmd" ||
+                modifier == "command")
+                stroke.control_cmd = true;
+            else if (modifier == "shift")
+                stroke.shift = true;
+            else
+                return {};
+            key_start = plus + 1;
+        }
+        stroke.key = trim(step.substr(key_start));
+        if (stroke.key.empty())
+            return {};
+        stroke.delay = delay;
+        delay = 0;
+        macro.push_back(std::move(stroke));
     }
+    return macro;
+}
 
-    {
-        std::lock_guard<decltype(mutex_sending_)> lock(mutex_sending_);
-        CGEventPostToPSN(&psn, d);
-        CGEventPostToPSN(&psn, u);
+void RSJ::SendKeyMacro(const KeyMacro& macro)
+{
+    for (const auto& stroke : macro) {
+        if (stroke.delay > 0)
+            std::this_thread::sleep_for(std::chrono::milliseconds(stroke.delay));
+        SendKeyDownUp(stroke.key, stroke.alt_opt, stroke.control_cmd, stroke.shift);
     }
+}
 
-    CFRelease(d);
-    CFRelease(u);
-#endif
-}
\ No newline at end of file
+void RSJ::InitKeyboardLayout()
+{
+#ifndef _WIN32
+    std::thread(BuildKeyTable).detach();
+    CFNotificationCenterAddObserver(CFNotificationCenterGetDistributedCenter(), nullptr,
+        KeyboardLayoutChanged, kTISNotifySelectedKeyboardInputSourceChanged, nullptr,
+        CFNotificationSuspensionBehaviorDeliverImmediately);
+#endif // Windows translates each key against Lightroom's layout, cached per layout
+}
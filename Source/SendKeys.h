@@ -24,10 +24,33 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #define MIDI2LR_SENDKEYS_H_INCLUDED
 
 #include <string>
+#include <vector>
 
 namespace RSJ {
+    // one chord of a keyboard macro, sent after waiting delay ms
+    struct KeyStroke {
+        std::string key;
+        bool alt_opt{false};
+        bool control_cmd{false};
+        bool shift{false};
+        int delay{0};
+    };
+    using KeyMacro = std::vector<KeyStroke>;
+
+    // compiles a macro written as comma separated steps, each a chord such as
+    // "ctrl+shift+c" (modifiers alt/option, ctrl/cmd, shift) or "wait 100" (ms).
+    // Returns an empty macro if any step doesn't parse
+    KeyMacro ParseKeyMacro(const std::string& text);
+    void SendKeyMacro(const KeyMacro& macro);
+
     void SendKeyDownUp(const std::string& key, const bool alt_opt,
         const bool control_cmd, const bool shift);
+    // finds Lightroom's process again, as after Lightroom restarts. Keys also
+    // find it again on their own once the cached process has exited
+    void RefreshLightroomProcess();
+    // builds the character to key code table in the background and rebuilds it
+    // when the input source changes. Call once at start-up
+    void InitKeyboardLayout();
 }
 
 #endif
\ No newline at end of file
@@ -21,14 +21,20 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
   ==============================================================================
 */
 #include "SettingsManager.h"
+#include <algorithm>
 #include <string>
 #include <utility>
 #include "LR_IPC_Out.h"
 #include "ProfileManager.h"
-using namespace std::literals::string_literals;
+#include "ProfileSync.h"
 
 const juce::String AutoHideSection{"autohide"};
 
+namespace {
+    constexpr int kSaveDelay = 500; //ms after the last change before writing
+    constexpr int kFlushTimeout = 5000; //ms to wait for a background write
+}
+
 SettingsManager::SettingsManager(ProfileManager* const pmanager):profile_manager_{pmanager}
 {
     juce::PropertiesFile::Options file_options;
@@ -40,13 +46,39 @@ SettingsManager::SettingsManager(ProfileManager* const pmanager):profile_manager
     properties_file_ = std::make_unique<juce::PropertiesFile>(file_options);
 }
 
+SettingsManager::~SettingsManager()
+{
+    Flush();
+}
+
+void SettingsManager::Flush()
+{
+    stopTimer();
+    save_pool_.removeAllJobs(false, kFlushTimeout);
+    properties_file_->saveIfNeeded();
+}
+
+void SettingsManager::SaveSoon_()
+{
+    startTimer(kSaveDelay); //restarting coalesces a burst of changes into one write
+}
+
+void SettingsManager::timerCallback()
+{
+    stopTimer();
+    //nothing is written if an earlier job already saved these changes
+    save_pool_.addJob([this] { properties_file_->saveIfNeeded(); });
+}
+
 void SettingsManager::Init(std::weak_ptr<LR_IPC_OUT>&& lr_ipc_out)
 {
     lr_ipc_out_ = std::move(lr_ipc_out);
-    if (const auto ptr = lr_ipc_out_.lock())
+    if (const auto ptr = lr_ipc_out_.lock()) {
     // add ourselves as a listener to LR_IPC_OUT so that we can send plugin
     // settings on connection
-        ptr->addCallback(this, &SettingsManager::ConnectionCallback);
+        ptr->addCallback<SettingsManager, &SettingsManager::ConnectionCallback>(this);
+        ptr->setPickup(getPickupEnabled());
+    }
     // set the profile directory
     profile_manager_->setProfileDirectory(getProfileDirectory());
 }
@@ -59,27 +91,35 @@ bool SettingsManager::getPickupEnabled() const noexcept
 void SettingsManager::setPickupEnabled(bool enabled)
 {
     properties_file_->setValue("pickup_enabled", enabled);
-    properties_file_->saveIfNeeded();
+    SaveSoon_();
     if (const auto ptr = lr_ipc_out_.lock())
-        ptr->sendCommand("Pickup "s + std::to_string(static_cast<unsigned>(enabled)) + '\n');
+        ptr->setPickup(enabled);
 }
 juce::String SettingsManager::getProfileDirectory() const noexcept
 {
+    // while syncing, profiles are switched from the local mirror
+    if (getProfileSyncSource().isNotEmpty())
+        return ProfileSync::Mirror().getFullPathName();
     return properties_file_->getValue("profile_directory");
 }
 
 void SettingsManager::setProfileDirectory(const juce::String& profile_directory_name)
 {
     properties_file_->setValue("profile_directory", profile_directory_name);
-    properties_file_->saveIfNeeded();
-    profile_manager_->setProfileDirectory(profile_directory_name);
+    SaveSoon_();
+    profile_manager_->setProfileDirectory(getProfileDirectory());
 }
 
 void SettingsManager::ConnectionCallback(bool connected)
 {
+    // pickup is decided here before values are sent, so the plugin's own pickup
+    // check stays off. The plugin times its handlers only when asked, and a plugin
+    // still timing for an earlier session is told to stop
     if (connected)
-        if (const auto ptr = lr_ipc_out_.lock())
-            ptr->sendCommand("Pickup "s + std::to_string(static_cast<unsigned>(getPickupEnabled())) + '\n');
+        if (const auto ptr = lr_ipc_out_.lock()) {
+            ptr->sendCommand("Pickup 0\n");
+            ptr->sendCommand("LuaTiming " + std::to_string(std::max(0, getLuaTiming())) + "\n");
+        }
 }
 
 int SettingsManager::getAutoHideTime() const noexcept
@@ -90,7 +130,7 @@ int SettingsManager::getAutoHideTime() const noexcept
 void SettingsManager::setAutoHideTime(int new_time)
 {
     properties_file_->setValue(AutoHideSection, new_time);
-    properties_file_->saveIfNeeded();
+    SaveSoon_();
 }
 
 int SettingsManager::getLastVersionFound() const noexcept
@@ -101,5 +141,280 @@ int SettingsManager::getLastVersionFound() const noexcept
 void SettingsManager::setLastVersionFound(int new_version)
 {
     properties_file_->setValue("LastVersionFound", new_version);
-    properties_file_->saveIfNeeded();
-}
\ No newline at end of file
+    SaveSoon_();
+}
+
+int SettingsManager::getVersionCheckInterval() const noexcept
+{
+    return properties_file_->getIntValue("version_check_interval", 24);
+}
+
+juce::int64 SettingsManager::getLastVersionCheck() const noexcept
+{
+    return properties_file_->getValue("last_version_check").getLargeIntValue();
+}
+
+juce::String SettingsManager::getVersionETag() const noexcept
+{
+    return properties_file_->getValue("version_etag");
+}
+
+juce::String SettingsManager::getVersionLastModified() const noexcept
+{
+    return properties_file_->getValue("version_last_modified");
+}
+
+void SettingsManager::setVersionCheck(juce::int64 checked, const juce::String& etag,
+    const juce::String& last_modified)
+{
+    properties_file_->setValue("last_version_check", juce::String{checked});
+    properties_file_->setValue("version_etag", etag);
+    properties_file_->setValue("version_last_modified", last_modified);
+    SaveSoon_();
+}
+
+bool SettingsManager::getMidiDispatchThread() const noexcept
+{
+    return properties_file_->getBoolValue("midi_dispatch_thread", false);
+}
+
+int SettingsManager::getDispatchShards() const noexcept
+{
+    return properties_file_->getIntValue("dispatch_shards", 0);
+}
+
+bool SettingsManager::getResident() const noexcept
+{
+    return properties_file_->getBoolValue("resident", false);
+}
+
+int SettingsManager::getMetricsPort() const noexcept
+{
+    return properties_file_->getIntValue("metrics_port", 0);
+}
+
+juce::String SettingsManager::getMetricsAddress() const
+{
+    return properties_file_->getValue("metrics_address", "127.0.0.1");
+}
+
+juce::String SettingsManager::getProfileSyncSource() const
+{
+    return properties_file_->getValue("profile_sync_source");
+}
+
+int SettingsManager::getProfileSyncInterval() const noexcept
+{
+    return properties_file_->getIntValue("profile_sync_interval", 60);
+}
+
+int SettingsManager::getCoalesceInterval() const noexcept
+{
+    return properties_file_->getIntValue("coalesce_interval", 0);
+}
+
+int SettingsManager::getNrpnMsbChannels() const noexcept
+{
+    return properties_file_->getIntValue("nrpn_msb_channels", 0); //bit mask, bit 0 is channel 1
+}
+
+int SettingsManager::getNrpnLsbWindow() const noexcept
+{
+    return properties_file_->getIntValue("nrpn_lsb_window", 10);
+}
+
+int SettingsManager::getDevicePollInterval() const noexcept
+{
+    return properties_file_->getIntValue("device_poll_interval", 0);
+}
+
+RSJ::MidiBackend SettingsManager::getMidiBackend() const noexcept
+{
+    return properties_file_->getValue("midi_backend") == "rtmidi" ?
+        RSJ::MidiBackend::rtmidi : RSJ::MidiBackend::juce;
+}
+
+int SettingsManager::getRtMidiApi() const noexcept
+{
+    return properties_file_->getIntValue("rtmidi_api", 0);
+}
+
+bool SettingsManager::getRealtimeThreads() const noexcept
+{
+    return properties_file_->getBoolValue("realtime_threads", false);
+}
+
+int SettingsManager::getThreadAffinity() const noexcept
+{
+    return properties_file_->getIntValue("thread_affinity", 0);
+}
+
+juce::String SettingsManager::getCC14Pairs() const noexcept
+{
+    return properties_file_->getValue("cc14_pairs");
+}
+
+int SettingsManager::getAutosaveInterval() const noexcept
+{
+    return properties_file_->getIntValue("autosave_interval", 30);
+}
+
+int SettingsManager::getMaxUpdateRate() const noexcept
+{
+    return properties_file_->getIntValue("max_update_rate", 0);
+}
+
+juce::String SettingsManager::getUpdateRates() const noexcept
+{
+    return properties_file_->getValue("update_rates");
+}
+
+bool SettingsManager::getAdaptiveRate() const noexcept
+{
+    return properties_file_->getBoolValue("adaptive_rate", false);
+}
+
+int SettingsManager::getTouchHold() const noexcept
+{
+    return properties_file_->getIntValue("touch_hold", 300);
+}
+
+bool SettingsManager::getQuantizeValues() const noexcept
+{
+    return properties_file_->getBoolValue("quantize_values", true);
+}
+
+bool SettingsManager::getRelativeDeltas() const noexcept
+{
+    return properties_file_->getBoolValue("relative_deltas", false);
+}
+
+int SettingsManager::getHeartbeatTimeout() const noexcept
+{
+    return properties_file_->getIntValue("heartbeat_timeout", 5000);
+}
+
+int SettingsManager::getActionTtl() const noexcept
+{
+    return properties_file_->getIntValue("action_ttl", 2000);
+}
+
+int SettingsManager::getLuaTiming() const noexcept
+{
+    return properties_file_->getIntValue("lua_timing", 0);
+}
+
+int SettingsManager::getControllerPresets() const noexcept
+{
+    return properties_file_->getIntValue("controller_presets", 0);
+}
+
+juce::String SettingsManager::getThruPort() const noexcept
+{
+    return properties_file_->getValue("thru_port");
+}
+
+juce::String SettingsManager::getThruInputs() const noexcept
+{
+    return properties_file_->getValue("thru_inputs", "*");
+}
+
+bool SettingsManager::getThruFeedback() const noexcept
+{
+    return properties_file_->getBoolValue("thru_feedback", false);
+}
+
+juce::String SettingsManager::getRelayHost() const noexcept
+{
+    return properties_file_->getValue("relay_host");
+}
+
+bool SettingsManager::getRelayServer() const noexcept
+{
+    return properties_file_->getBoolValue("relay_server", false);
+}
+
+juce::String SettingsManager::getRelayAddress() const
+{
+    return properties_file_->getValue("relay_address", "127.0.0.1");
+}
+
+int SettingsManager::getRtpMidiPort() const noexcept
+{
+    return properties_file_->getIntValue("rtpmidi_port", 0);
+}
+
+int SettingsManager::getOscPort() const noexcept
+{
+    return properties_file_->getIntValue("osc_port", 0);
+}
+
+int SettingsManager::getOscFeedbackPort() const noexcept
+{
+    return properties_file_->getIntValue("osc_feedback_port", 9000);
+}
+
+int SettingsManager::getFeedbackDeadband() const noexcept
+{
+    return properties_file_->getIntValue("feedback_deadband", 0);
+}
+
+int SettingsManager::getLatencyBudget() const noexcept
+{
+    return properties_file_->getIntValue("latency_budget", 0);
+}
+
+int SettingsManager::getDegradedCoalesceInterval() const noexcept
+{
+    return properties_file_->getIntValue("degraded_coalesce_interval", 50);
+}
+
+int SettingsManager::getEchoWindow() const noexcept
+{
+    return properties_file_->getIntValue("echo_window", 250);
+}
+
+bool SettingsManager::getLocalEcho() const noexcept
+{
+    return properties_file_->getBoolValue("local_echo", false);
+}
+
+int SettingsManager::getMidiOutRate() const noexcept
+{
+    return properties_file_->getIntValue("midi_out_rate", 0);
+}
+
+juce::String SettingsManager::getMidiOutRates() const noexcept
+{
+    return properties_file_->getValue("midi_out_rates");
+}
+
+juce::String SettingsManager::getKeyMacros() const noexcept
+{
+    return properties_file_->getValue("key_macros");
+}
+
+bool SettingsManager::getHeadless() const noexcept
+{
+    return properties_file_->getBoolValue("headless", false);
+}
+
+juce::String SettingsManager::getLogLevel() const noexcept
+{
+    return properties_file_->getValue("log_level", "warning");
+}
+
+int SettingsManager::getDiagnosticsInterval() const noexcept
+{
+    return properties_file_->getIntValue("diagnostics_interval", 0);
+}
+
+int SettingsManager::getIdleTimeout() const noexcept
+{
+    return properties_file_->getIntValue("idle_timeout", 0);
+}
+
+juce::String SettingsManager::getMemoryBudgets() const noexcept
+{
+    return properties_file_->getValue("memory_budgets");
+}
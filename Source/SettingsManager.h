@@ -24,14 +24,18 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 
 #include <memory>
 #include "../JuceLibraryCode/JuceHeader.h"
+#include "MidiUtilities.h"
 class LR_IPC_OUT;
 class ProfileManager;
 
-class SettingsManager final {
+class SettingsManager final: private juce::Timer {
 public:
     explicit SettingsManager(ProfileManager* const profile_manager);
-    ~SettingsManager() = default;
+    ~SettingsManager();
     void Init(std::weak_ptr<LR_IPC_OUT>&& lr_IPC_OUT);
+    // setters change the values at once and write the file shortly after the last
+    // change, off the message thread. Flush writes anything pending now
+    void Flush();
     bool getPickupEnabled() const noexcept;
     void setPickupEnabled(bool enabled);
     juce::String getProfileDirectory() const noexcept;
@@ -41,10 +45,120 @@ class SettingsManager final {
     void setAutoHideTime(int new_time);
     int getLastVersionFound() const noexcept;
     void setLastVersionFound(int version_number);
+    bool getMidiDispatchThread() const noexcept;
+    int getDispatchShards() const noexcept;
+    bool getResident() const noexcept;
+    int getMetricsPort() const noexcept;
+    juce::String getMetricsAddress() const;
+    // a central profile directory mirrored locally, see ProfileSync. Empty if not syncing
+    juce::String getProfileSyncSource() const;
+    int getProfileSyncInterval() const noexcept;
+    int getCoalesceInterval() const noexcept;
+    int getNrpnMsbChannels() const noexcept;
+    int getNrpnLsbWindow() const noexcept;
+    int getDevicePollInterval() const noexcept;
+    RSJ::MidiBackend getMidiBackend() const noexcept;
+    int getRtMidiApi() const noexcept;
+    // the MIDI dispatch and Lightroom link threads: raised priority (MMCSS "Pro Audio"
+    // on Windows) and the cores they may use, bit 0 the first, 0 for any
+    bool getRealtimeThreads() const noexcept;
+    int getThreadAffinity() const noexcept;
+    // 14-bit CC pairs as "channel:controller" list, channel 1-16, controller 0-31
+    juce::String getCC14Pairs() const noexcept;
+    // seconds between background saves of changed control settings, 0 saves only at quit
+    int getAutosaveInterval() const noexcept;
+    // most updates per second sent to Lightroom for each command, 0 for no limit
+    int getMaxUpdateRate() const noexcept;
+    // per command or command menu section rates as "name=rate;...", overriding the above
+    juce::String getUpdateRates() const noexcept;
+    // whether the rate above adapts to how quickly Lightroom echoes values back
+    bool getAdaptiveRate() const noexcept;
+    // ms the last control moved keeps a command shared by several, 0 for no arbitration
+    int getTouchHold() const noexcept;
+    // whether values Lightroom would round to the one last sent are dropped
+    bool getQuantizeValues() const noexcept;
+    // whether relative controls send their moves instead of accumulated positions
+    bool getRelativeDeltas() const noexcept;
+    // ms without a heartbeat answer before a hung plugin is reconnected, 0 for none
+    int getHeartbeatTimeout() const noexcept;
+    // ms a button press made while Lightroom is disconnected is still sent on
+    // reconnection, 0 to drop them
+    int getActionTtl() const noexcept;
+    // seconds between the plugin's reports of its handler timings, 0 for no timing
+    int getLuaTiming() const noexcept;
+    // B-Control preset (1-32) the base layer is uploaded to, later layers following;
+    // 0 for no controller presets
+    int getControllerPresets() const noexcept;
+    // MIDI thru: the port to republish on (empty for none), the inputs copied to it as
+    // "name;name" or "*", and whether feedback to controllers is copied too
+    juce::String getThruPort() const noexcept;
+    juce::String getThruInputs() const noexcept;
+    bool getThruFeedback() const noexcept;
+    // relaying over the network: the host of an instance running the relay server,
+    // which this instance uses in place of the local plugin (empty for none), and
+    // whether this instance serves its plugin to such an instance
+    juce::String getRelayHost() const noexcept;
+    bool getRelayServer() const noexcept;
+    // the interface the relay server listens on. Only this machine by default; the
+    // controller side's network needs its own address here, and the relay has no
+    // authentication, so pick one only trusted machines reach
+    juce::String getRelayAddress() const;
+    // UDP control port of the RTP-MIDI session (the data port is the next one), 0 for
+    // none. 5004 is usual
+    int getRtpMidiPort() const noexcept;
+    // UDP port for OSC control, 0 for none, and the port on the sender OSC feedback
+    // goes to
+    int getOscPort() const noexcept;
+    int getOscFeedbackPort() const noexcept;
+    // controller units Lightroom feedback must move before it is sent again, 0 skips
+    // only identical values
+    int getFeedbackDeadband() const noexcept;
+    // p99 ms from MIDI arrival to the socket, beyond any coalescing, above which the
+    // pipeline runs degraded until latency recovers. 0 for no watchdog
+    int getLatencyBudget() const noexcept;
+    // coalesce interval (ms) while degraded
+    int getDegradedCoalesceInterval() const noexcept;
+    // ms after a control sends MIDI during which its feedback is held back, 0 for none
+    int getEchoWindow() const noexcept;
+    // relative encoders' rings and the other controls on their command are fed back
+    // as soon as they move, not after Lightroom replies
+    bool getLocalEcho() const noexcept;
+    // bytes per second sent to each MIDI output, 0 for no limit
+    int getMidiOutRate() const noexcept;
+    // per output device rates as "name=rate;...", overriding the above
+    juce::String getMidiOutRates() const noexcept;
+    // keyboard macros as "id=step, step...;..." where a step is a chord such as
+    // "ctrl+shift+c" or "wait 100" (ms)
+    juce::String getKeyMacros() const noexcept;
+    // hours between checks for a new version, 0 checks at every start
+    int getVersionCheckInterval() const noexcept;
+    // when the version was last checked (ms since 1970), and the validators the server
+    // sent with that answer
+    juce::int64 getLastVersionCheck() const noexcept;
+    juce::String getVersionETag() const noexcept;
+    juce::String getVersionLastModified() const noexcept;
+    void setVersionCheck(juce::int64 checked, const juce::String& etag,
+        const juce::String& last_modified);
+    // run without a window, as does starting with --headless
+    bool getHeadless() const noexcept;
+    // seconds between writes of diagnostics.csv beside the executable when headless,
+    // 0 for none
+    int getDiagnosticsInterval() const noexcept;
+    // MIDI2LR.log beside the executable: "off", "error", "warning", "info" or "debug"
+    juce::String getLogLevel() const noexcept;
+    // seconds without MIDI before polls and timers stop until the next message, 0 to
+    // keep them running
+    int getIdleTimeout() const noexcept;
+    // memory budgets as "subsystem=KB;...", see Instrumentation::MemoryReport
+    juce::String getMemoryBudgets() const noexcept;
 
 private:
+    // Timer interface, starts the background write
+    void timerCallback() override;
+    void SaveSoon_();
     ProfileManager* const profile_manager_;
-    std::unique_ptr<juce::PropertiesFile> properties_file_;
+    std::unique_ptr<juce::PropertiesFile> properties_file_; //locks internally
+    juce::ThreadPool save_pool_{1};
     std::weak_ptr<LR_IPC_OUT> lr_ipc_out_;
 };
 
@@ -0,0 +1,305 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    Soak.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "Soak.h"
+#include <algorithm>
+#include <array>
+#include <cmath>
+#include <deque>
+#include <map>
+#include <string>
+#include <utility>
+#include <vector>
+#include "CommandMap.h"
+#include "CommandTableModel.h"
+#include "ControlsModel.h"
+#include "Instrumentation.h"
+#include "LatencyStats.h"
+#include "LR_IPC_Out.h"
+#include "LRCommands.h"
+#include "MidiUtilities.h"
+#include "ParserHarness.h"
+
+namespace {
+    constexpr size_t kBurst = 64; //messages timed together as one latency sample
+    constexpr short kFaders = 32; //CC 0-31, absolute
+    constexpr short kEncoders = 16; //CC 32-47, two's complement
+    constexpr short kButtons = 16; //notes 0-15
+    constexpr int kRefreshEvery = 16; //bursts between Lightroom refreshes
+    constexpr int kLearnEvery = 64; //bursts between MIDI learn edits
+    constexpr int kCycle = 8192; //bursts on one profile before switching to the other
+    constexpr size_t kLearnedRows = 32; //the oldest learned row is deleted past this
+    constexpr int kLearnNotes = 1024; //learned messages cycle through this many
+    constexpr int kSettle = 1500; //ms, longer than CommandMap keeps a replaced map
+    constexpr double kWarmUp = 0.1; //share of the run before growth is measured
+    volatile double sink{0.0}; //results land here so the optimizer keeps the work
+
+    struct Metric {
+        const char* name;
+        bool higher_is_better;
+        double tolerance; //percent, for a new baseline
+    };
+    // growth is a leak at any size, the rest depend on the machine
+    constexpr std::array<Metric, 8> kMetrics{{
+        {"messages/s", true, 10.0},
+        {"burst p50 us", false, 25.0},
+        {"burst p99 us", false, 50.0},
+        {"burst p99.9 us", false, 100.0},
+        {"hot path allocations per 1000 messages", false, 0.0},
+        {"table row growth", false, 0.0},
+        {"CommandMap growth bytes", false, 0.0},
+        {"UI rows growth bytes", false, 0.0}}};
+
+    // both profiles map the same messages, to different commands
+    RSJ::CompiledProfile Profile(size_t offset)
+    {
+        const auto commands = LRCommandList::LRStringList.size() - 1; //not Unmapped
+        RSJ::CompiledProfile profile;
+        for (short i = 0; i < kFaders + kEncoders; ++i)
+            profile.mappings.emplace_back(RSJ::MidiMessageId{1, i, RSJ::MsgIdEnum::CC},
+                static_cast<RSJ::CommandId>((offset + static_cast<size_t>(i)) % commands + 1));
+        for (short i = 0; i < kButtons; ++i)
+            profile.mappings.emplace_back(RSJ::MidiMessageId{1, i, RSJ::MsgIdEnum::NOTE},
+                static_cast<RSJ::CommandId>((offset * 2 + static_cast<size_t>(i)) % commands + 1));
+        CommandMap::IndexProfile(profile);
+        return profile;
+    }
+
+    // a burst's messages: faders moving, encoders turning both ways, buttons pressed
+    // and released
+    void Fill(std::array<RSJ::MidiMessage, kBurst>& burst, size_t round) noexcept
+    {
+        for (size_t i = 0; i < kBurst; ++i) {
+            const auto step = round * kBurst + i;
+            if (i < 40)
+                burst[i] = {RSJ::kCCFlag, 0, static_cast<short>(step % kFaders),
+                    static_cast<short>((step / kFaders) & 0x7F)};
+            else if (i < 56)
+                burst[i] = {RSJ::kCCFlag, 0, static_cast<short>(kFaders + step % kEncoders),
+                    static_cast<short>(step & 4 ? 0x7F : 1)};
+            else
+                burst[i] = {i & 1 ? RSJ::kNoteOffFlag : RSJ::kNoteOnFlag, 0,
+                    static_cast<short>(round % kButtons), static_cast<short>(i & 1 ? 0 : 0x7F)};
+        }
+    }
+
+    // what a message costs from lookup to outbound line
+    void Dispatch(const CommandMap& map, ControlsModel& controls, std::string& out,
+        const RSJ::MidiMessage& message)
+    {
+        const auto command = map.getCommandIdforMessage(RSJ::MidiMessageId{message});
+        const auto value = controls.ControllerToPlugin(message);
+        out.clear();
+        LR_IPC_OUT::AppendLine(out, command, value, false);
+        sink = sink + static_cast<double>(out.size());
+    }
+
+    // learns the next message as MIDI learn does, deleting the oldest learned row
+    // once there are kLearnedRows, so the table holds the profile and kLearnedRows.
+    // Learned commands are below the profiles' highest, so the map's size is the
+    // profile's
+    class Learner {
+    public:
+        Learner(CommandTableModel& table, CommandMap& map): table_(table), map_(map)
+        {}
+        void Learn()
+        {
+            const RSJ::MidiMessageId message{2, next_++ % kLearnNotes, RSJ::MsgIdEnum::NOTE};
+            table_.addRow(message.channel, message.data, message.msg_id_type);
+            map_.addCommandforMessage(static_cast<size_t>(next_) % kLearnedRows + 1, message);
+            learned_.push_back(message);
+            if (learned_.size() > kLearnedRows) {
+                const auto& oldest = learned_.front();
+                const auto row = table_.getRowForMessage(oldest.channel, oldest.data,
+                    oldest.msg_id_type);
+                if (row >= 0)
+                    table_.removeRow(static_cast<size_t>(row));
+                learned_.pop_front();
+            }
+        }
+        void Forget() noexcept //a profile switch replaced the table
+        {
+            learned_.clear();
+        }
+
+    private:
+        CommandTableModel& table_;
+        CommandMap& map_;
+        std::deque<RSJ::MidiMessageId> learned_;
+        int next_{0};
+    };
+
+    struct Sample {
+        int rows;
+        std::map<juce::String, juce::int64> memory;
+    };
+
+    // ends a cycle the same way each time: replaced maps expire, and one learn edit
+    // leaves the same number of them behind
+    Sample Measure(CommandTableModel& table, Learner& learner)
+    {
+        juce::Thread::sleep(kSettle);
+        learner.Learn();
+        return {table.getNumRows(), Instrumentation::MemoryTotals()};
+    }
+
+    // "metric, baseline, tolerance %" rows, lines starting with # are comments
+    std::map<juce::String, std::pair<double, double>> ReadBaseline(const juce::File& file)
+    {
+        std::map<juce::String, std::pair<double, double>> baseline;
+        juce::StringArray lines;
+        file.readLines(lines);
+        for (const auto& line : lines) {
+            if (line.trimStart().startsWithChar('#'))
+                continue;
+            const auto fields = juce::StringArray::fromTokens(line, ",", "");
+            if (fields.size() >= 2 && fields[1].trim().containsOnly("0123456789.-") &&
+                fields[1].trim().isNotEmpty())
+                baseline[fields[0].trim()] = {fields[1].getDoubleValue(),
+                    fields.size() > 2 ? fields[2].getDoubleValue() : 0.0};
+        }
+        return baseline;
+    }
+}
+
+juce::String RunSoak(int seconds, const juce::File& baseline)
+{
+    CommandMap map;
+    CommandTableModel table;
+    table.Init(&map);
+    ControlsModel controls;
+    for (short i = 0; i < kEncoders; ++i)
+        controls.setCCmethod(0, static_cast<short>(kFaders + i), RSJ::CCmethod::twoscomplement);
+    const std::array<RSJ::CompiledProfile, 2> profiles{{Profile(0), Profile(kFaders)}};
+    Learner learner{table, map};
+    std::string out;
+    out.reserve(256);
+    // the refresh Lightroom sends when the photo changes
+    const auto& names = LRCommandList::LRStringList;
+    std::string refresh{"Snapshot 1\n"};
+    for (size_t i = 1; i <= kBurst; ++i)
+        refresh += names[i * 5 % (names.size() - 1) + 1] + ' ' +
+        std::to_string(static_cast<double>(i) / kBurst) + '\n';
+    refresh += "EndSnapshot 1\n";
+    const auto* const refresh_data = reinterpret_cast<const juce::uint8*>(refresh.data());
+
+    std::array<RSJ::MidiMessage, kBurst> burst;
+    LatencyHistogram latency;
+    juce::uint64 messages{0};
+    juce::uint64 allocations{0};
+    int switches{0};
+    int learned{0};
+    double paused{0.0}; //ms measuring, left out of throughput
+    Sample warm{};
+    auto warm_cycle = -1;
+    const auto start = juce::Time::getMillisecondCounterHiRes();
+    const auto warm_up_end = start + seconds * 1000.0 * kWarmUp;
+    const auto end = start + seconds * 1000.0;
+    size_t round{0};
+    for (auto cycle = 0; ; ++cycle) {
+        table.buildFromProfile(profiles[static_cast<size_t>(cycle) & 1]);
+        learner.Forget();
+        ++switches;
+        for (auto b = 0; b < kCycle; ++b, ++round) {
+            Fill(burst, round);
+            const auto allocations_before = RSJ::ThreadAllocations();
+            const auto began = juce::Time::getMillisecondCounterHiRes();
+            for (const auto& message : burst)
+                Dispatch(map, controls, out, message);
+            latency.Record(juce::Time::getMillisecondCounterHiRes() - began);
+            allocations += RSJ::ThreadAllocations() - allocations_before;
+            messages += kBurst;
+            if (b % kRefreshEvery == 0) {
+                ParseInboundOnce(refresh_data, refresh.size());
+                for (short i = 0; i < kFaders; ++i)
+                    sink = sink + controls.PluginToController(RSJ::kCCFlag, 0, i,
+                        static_cast<double>(round % 256) / 255.0);
+            }
+            if (b % kLearnEvery == kLearnEvery - 1) {
+                learner.Learn();
+                ++learned;
+            }
+        }
+        // both measures end a cycle on the same profile
+        const auto now = juce::Time::getMillisecondCounterHiRes();
+        if (warm_cycle < 0 && now >= warm_up_end) {
+            warm = Measure(table, learner);
+            warm_cycle = cycle;
+            paused += juce::Time::getMillisecondCounterHiRes() - now;
+        }
+        else if (warm_cycle >= 0 && now >= end && ((cycle - warm_cycle) & 1) == 0)
+            break;
+    }
+    const auto active_seconds = std::max(1e-3,
+        (juce::Time::getMillisecondCounterHiRes() - start - paused) / 1000.0);
+    const auto last = Measure(table, learner);
+    const auto growth = [&warm, &last](const char* account) {
+        const auto before = warm.memory.find(account);
+        const auto after = last.memory.find(account);
+        return static_cast<double>((after == last.memory.end() ? 0 : after->second) -
+            (before == warm.memory.end() ? 0 : before->second));
+    };
+    std::map<juce::String, double> values{
+        {"messages/s", static_cast<double>(messages) / active_seconds},
+        {"burst p50 us", latency.PercentileMs(0.5) * 1000.0},
+        {"burst p99 us", latency.PercentileMs(0.99) * 1000.0},
+        {"burst p99.9 us", latency.PercentileMs(0.999) * 1000.0},
+        {"table row growth", static_cast<double>(last.rows - warm.rows)},
+        {"CommandMap growth bytes", growth("CommandMap")},
+        {"UI rows growth bytes", growth("UI rows")}};
+    if (RSJ::kAllocationHooks)
+        values["hot path allocations per 1000 messages"] =
+        static_cast<double>(allocations) * 1000.0 / static_cast<double>(messages);
+
+    const auto stored = ReadBaseline(baseline);
+    juce::String report{"soak, value, baseline, result\n"};
+    report << "seconds, " << juce::String(seconds) << ", , \n"
+        << "messages, " << juce::String(messages) << ", , \n"
+        << "profile switches, " << juce::String(switches) << ", , \n"
+        << "learn edits, " << juce::String(learned) << ", , \n";
+    auto passed = true;
+    juce::String recorded{"metric, baseline, tolerance %\n"};
+    for (const auto& metric : kMetrics) {
+        const auto value = values.find(metric.name);
+        if (value == values.end()) {
+            report << metric.name << ", n/a, , not measured\n"; //allocation hooks not built in
+            continue;
+        }
+        recorded << metric.name << ", " << juce::String(value->second, 2) << ", "
+            << juce::String(metric.tolerance, 0) << "\n";
+        report << metric.name << ", " << juce::String(value->second, 2) << ", ";
+        const auto base = stored.find(metric.name);
+        if (base == stored.end()) {
+            report << ", no baseline\n";
+            continue;
+        }
+        const auto margin = std::abs(base->second.first) * base->second.second / 100.0;
+        const auto pass = metric.higher_is_better ? value->second >= base->second.first - margin :
+            value->second <= base->second.first + margin;
+        passed = passed && pass;
+        report << juce::String(base->second.first, 2) << ", " << (pass ? "PASS" : "FAIL") << "\n";
+    }
+    if (!baseline.existsAsFile() && baseline.replaceWithText(recorded))
+        report << "baseline recorded, " << baseline.getFullPathName() << ", , \n";
+    report << "result, " << (passed ? "PASS" : "FAIL") << ", , \n";
+    return report;
+}
@@ -0,0 +1,35 @@
+#pragma once
+/*
+  ==============================================================================
+
+    Soak.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_SOAK_H_INCLUDED
+#define MIDI2LR_SOAK_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// A long session of mixed fader, encoder, button, MIDI learn and profile-switch
+// traffic through the hot-path components, for --soak. Measures throughput, burst
+// latency, hot-path allocations and memory and table growth from the end of the
+// warm-up to the end, and compares each with baseline ("metric, baseline,
+// tolerance %" rows). Returns "metric, value, baseline, result" CSV rows and an
+// overall result. If baseline doesn't exist, this run's values are written to it
+juce::String RunSoak(int seconds, const juce::File& baseline);
+
+#endif  // SOAK_H_INCLUDED
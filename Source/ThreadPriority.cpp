@@ -0,0 +1,66 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    ThreadPriority.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ThreadPriority.h"
+#include "AsyncLog.h"
+#ifdef _WIN32
+#include "Windows.h"
+#endif
+
+namespace {
+    constexpr int kHighestPriority = 10;
+#ifdef _WIN32
+    using AvSetMmThreadCharacteristicsType = HANDLE(WINAPI*)(LPCWSTR, LPDWORD);
+
+    AvSetMmThreadCharacteristicsType MmcssFunction() noexcept
+    {
+        // avrt.dll is loaded at run time so nothing is added to the link. Windows
+        // drops a thread's registration when the thread ends
+        static const auto function = [] {
+            const auto library = LoadLibraryW(L"avrt.dll");
+            return library ? reinterpret_cast<AvSetMmThreadCharacteristicsType>(
+                GetProcAddress(library, "AvSetMmThreadCharacteristicsW")) : nullptr;
+        }();
+        return function;
+    }
+#endif
+}
+
+void RSJ::RaiseCurrentThread(const ThreadPriority& priority) noexcept
+{
+    AsyncLog::RegisterThread();
+    if (priority.affinity)
+        juce::Thread::setCurrentThreadAffinityMask(priority.affinity);
+    if (!priority.raise)
+        return;
+    if (!juce::Thread::setCurrentThreadPriority(kHighestPriority))
+        AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::warning,
+            "thread priority couldn't be raised");
+#ifdef _WIN32
+    if (const auto set_characteristics = MmcssFunction()) {
+        DWORD task_index = 0;
+        if (!set_characteristics(L"Pro Audio", &task_index))
+            AsyncLog::Write(RSJ::LogCategory::midi, RSJ::LogLevel::warning,
+                "thread couldn't join the MMCSS Pro Audio task");
+    }
+#endif
+}
@@ -0,0 +1,38 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ThreadPriority.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_THREADPRIORITY_H_INCLUDED
+#define MIDI2LR_THREADPRIORITY_H_INCLUDED
+
+#include "../JuceLibraryCode/JuceHeader.h"
+
+namespace RSJ {
+    // how a latency-critical thread should run, so Lightroom busy exporting on
+    // every core doesn't starve it
+    struct ThreadPriority {
+        bool raise{false}; //highest JUCE priority, and MMCSS "Pro Audio" on Windows
+        juce::uint32 affinity{0}; //cores it may run on, bit 0 is the first. 0 for any
+    };
+    // applies priority to the calling thread until it ends, and registers it with AsyncLog
+    void RaiseCurrentThread(const ThreadPriority& priority) noexcept;
+}
+
+#endif  // THREADPRIORITY_H_INCLUDED
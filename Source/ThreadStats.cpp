@@ -0,0 +1,213 @@
+// This is an open source non-commercial project. Dear PVS-Studio, please check it.
+// PVS-Studio Static Code Analyzer for C, C++ and C#: http://www.viva64.com
+/*
+  ==============================================================================
+
+    ThreadStats.cpp
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#include "ThreadStats.h"
+#include <algorithm>
+#include <atomic>
+#include <deque>
+#include <map>
+#include <mutex>
+#ifdef _WIN32
+#include "Windows.h"
+#elif defined(__APPLE__)
+#include <mach/mach.h>
+#else
+#include <fstream>
+#include <pthread.h>
+#include <string>
+#include <sys/syscall.h>
+#include <time.h>
+#include <unistd.h>
+#endif
+
+namespace {
+    struct Sample {
+        double cpu_ms{0.0};
+        juce::int64 switches{-1}; //-1 where the OS doesn't keep them per thread
+    };
+    struct Entry {
+        explicit Entry(const juce::String& thread_name): name{thread_name}
+        {}
+        juce::String name;
+#ifdef _WIN32
+        HANDLE handle{nullptr}; //stays readable after the thread ends
+#elif defined(__APPLE__)
+        mach_port_t port{MACH_PORT_NULL};
+#else
+        clockid_t clock{};
+        pid_t tid{0};
+#endif
+        bool ended{false};
+        Sample last{}; //at the previous report, or final once ended
+        Sample reported{}; //what the previous report counted from
+        std::atomic<juce::int64> wake_ups{0};
+        juce::int64 reported_wake_ups{0};
+    };
+    // entries are never removed, and a deque doesn't move them as it grows
+    struct Registry {
+        std::mutex mutex;
+        std::deque<Entry> threads;
+        double reported{juce::Time::getMillisecondCounterHiRes()};
+        juce::int64 reported_messages{0};
+    };
+    Registry& GetRegistry()
+    {
+        static Registry registry;
+        return registry;
+    }
+    thread_local Entry* current{nullptr};
+    std::atomic<juce::int64> messages{0};
+
+    void Open(Entry& entry)
+    {
+        //the calling thread
+#ifdef _WIN32
+        entry.handle = OpenThread(THREAD_QUERY_LIMITED_INFORMATION, FALSE, GetCurrentThreadId());
+#elif defined(__APPLE__)
+        entry.port = mach_thread_self();
+#else
+        pthread_getcpuclockid(pthread_self(), &entry.clock);
+        entry.tid = static_cast<pid_t>(syscall(SYS_gettid));
+#endif
+    }
+
+    // false if the thread can no longer be read
+    bool Read(const Entry& entry, Sample& sample)
+    {
+#ifdef _WIN32
+        FILETIME created, exited, kernel, user;
+        if (!entry.handle || !GetThreadTimes(entry.handle, &created, &exited, &kernel, &user))
+            return false;
+        const auto ticks = [](const FILETIME& time) { //100 ns
+            return static_cast<double>((static_cast<juce::uint64>(time.dwHighDateTime) << 32) |
+                time.dwLowDateTime);
+        };
+        sample.cpu_ms = (ticks(kernel) + ticks(user)) / 10000.0;
+        return true;
+#elif defined(__APPLE__)
+        thread_basic_info_data_t info;
+        mach_msg_type_number_t count = THREAD_BASIC_INFO_COUNT;
+        if (entry.port == MACH_PORT_NULL || thread_info(entry.port, THREAD_BASIC_INFO,
+            reinterpret_cast<thread_info_t>(&info), &count) != KERN_SUCCESS)
+            return false;
+        sample.cpu_ms = (info.user_time.seconds + info.system_time.seconds) * 1000.0 +
+            (info.user_time.microseconds + info.system_time.microseconds) / 1000.0;
+        return true;
+#else
+        timespec time;
+        if (!entry.tid || clock_gettime(entry.clock, &time))
+            return false;
+        sample.cpu_ms = time.tv_sec * 1000.0 + time.tv_nsec / 1e6;
+        std::ifstream status{"/proc/self/task/" + std::to_string(entry.tid) + "/status"};
+        juce::int64 switches{0};
+        for (std::string line; std::getline(status, line);)
+            if (line.find("ctxt_switches:") != std::string::npos) //voluntary and not
+                switches += std::stoll(line.substr(line.find(':') + 1));
+        sample.switches = switches;
+        return true;
+#endif
+    }
+}
+
+void ThreadStats::Register(const juce::String& name)
+{
+    if (current)
+        return;
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    registry.threads.emplace_back(name);
+    auto& entry = registry.threads.back();
+    Open(entry);
+    Read(entry, entry.last);
+    entry.reported = entry.last; //counted from registration
+    current = &entry;
+}
+
+void ThreadStats::Ended()
+{
+    if (!current)
+        return;
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    Read(*current, current->last);
+    current->ended = true;
+    current = nullptr;
+}
+
+void ThreadStats::CountWakeUp() noexcept
+{
+    if (current)
+        current->wake_ups.fetch_add(1, std::memory_order_relaxed);
+}
+
+void ThreadStats::CountMessages(size_t count) noexcept
+{
+    messages.fetch_add(static_cast<juce::int64>(count), std::memory_order_relaxed);
+}
+
+juce::String ThreadStats::Report()
+{
+    struct Total {
+        int threads{0};
+        double cpu_ms{0.0};
+        juce::int64 switches{-1};
+        juce::int64 wake_ups{0};
+    };
+    auto& registry = GetRegistry();
+    std::lock_guard<decltype(registry.mutex)> lock(registry.mutex);
+    const auto now = juce::Time::getMillisecondCounterHiRes();
+    const auto elapsed = now - registry.reported;
+    std::map<juce::String, Total> totals; //threads sharing a name add up
+    for (auto& entry : registry.threads) {
+        if (!entry.ended)
+            Read(entry, entry.last);
+        const auto wake_ups = entry.wake_ups.load(std::memory_order_relaxed);
+        auto& total = totals[entry.name];
+        ++total.threads;
+        total.cpu_ms += entry.last.cpu_ms - entry.reported.cpu_ms;
+        if (entry.last.switches >= 0)
+            total.switches = std::max(total.switches, juce::int64{0}) +
+            entry.last.switches - entry.reported.switches;
+        total.wake_ups += wake_ups - entry.reported_wake_ups;
+        entry.reported = entry.last;
+        entry.reported_wake_ups = wake_ups;
+    }
+    const auto dispatched = messages.load(std::memory_order_relaxed);
+    const auto new_messages = dispatched - registry.reported_messages;
+    registry.reported = now;
+    registry.reported_messages = dispatched;
+
+    juce::String report{"thread since last report, threads, cpu ms, cpu %, context switches, "
+        "wake-ups\n"};
+    auto cpu_ms = 0.0;
+    for (const auto& total : totals) {
+        cpu_ms += total.second.cpu_ms;
+        report << total.first << ", " << total.second.threads << ", "
+            << juce::String(total.second.cpu_ms, 1) << ", "
+            << juce::String(elapsed > 0.0 ? 100.0 * total.second.cpu_ms / elapsed : 0.0, 1) << ", "
+            << (total.second.switches >= 0 ? juce::String(total.second.switches) : "n/a") << ", "
+            << juce::String(total.second.wake_ups) << "\n";
+    }
+    report << "cpu ms per 1000 messages, , " << (new_messages > 0 ?
+        juce::String(cpu_ms * 1000.0 / static_cast<double>(new_messages), 3) : "n/a") << ", , , \n";
+    return report;
+}
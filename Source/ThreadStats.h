@@ -0,0 +1,62 @@
+#pragma once
+/*
+  ==============================================================================
+
+    ThreadStats.h
+
+This file is part of MIDI2LR. Copyright 2015 by Rory Jaffe.
+
+MIDI2LR is free software: you can redistribute it and/or modify it under the
+terms of the GNU General Public License as published by the Free Software
+Foundation, either version 3 of the License, or (at your option) any later
+version.
+
+MIDI2LR is distributed in the hope that it will be useful, but WITHOUT ANY
+WARRANTY; without even the implied warranty of MERCHANTABILITY or FITNESS FOR A
+PARTICULAR PURPOSE.  See the GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License along with
+MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
+  ==============================================================================
+*/
+#ifndef MIDI2LR_THREADSTATS_H_INCLUDED
+#define MIDI2LR_THREADSTATS_H_INCLUDED
+
+#include <cstddef>
+#include "../JuceLibraryCode/JuceHeader.h"
+
+// CPU time, context switches and wake-ups of MIDI2LR's threads, for the diagnostics
+// report. A thread registers itself under a name, and the report samples each one
+// through the OS, giving the change since the previous report by name, and the CPU
+// they used together per 1,000 MIDI messages dispatched. Wake-ups are those counted by
+// PowerMonitor::CountWakeUp and dispatch batches. Context switches are per thread only
+// where the OS keeps them (Linux). Any thread
+class ThreadStats {
+public:
+    // registers the calling thread, once; later calls from it do nothing. A thread
+    // that ends without Ended keeps its sample from the previous report
+    static void Register(const juce::String& name);
+    // takes the calling thread's final sample, as it ends
+    static void Ended();
+    // counts a wake-up of the calling thread, if registered
+    static void CountWakeUp() noexcept;
+    static void CountMessages(size_t count) noexcept;
+    static juce::String Report();
+};
+
+// registers the calling thread for the scope, usually a thread's run
+class ThreadAccount {
+public:
+    explicit ThreadAccount(const juce::String& name)
+    {
+        ThreadStats::Register(name);
+    }
+    ~ThreadAccount()
+    {
+        ThreadStats::Ended();
+    }
+    ThreadAccount(const ThreadAccount&) = delete;
+    ThreadAccount& operator=(const ThreadAccount&) = delete;
+};
+
+#endif  // THREADSTATS_H_INCLUDED
@@ -21,6 +21,46 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "Utilities.h"
 
+std::atomic<std::uint64_t> RSJ::EpochGuard::epoch_{1};
+std::atomic<size_t> RSJ::EpochGuard::overflow_{0};
+std::array<RSJ::EpochGuard::Slot, RSJ::EpochGuard::kSlots> RSJ::EpochGuard::slots_{};
+
+RSJ::EpochGuard::ThreadState::ThreadState() noexcept
+{
+    for (auto& candidate : slots_) {
+        auto claimed = false;
+        if (candidate.claimed.compare_exchange_strong(claimed, true,
+            std::memory_order_acq_rel)) {
+            slot = &candidate;
+            return;
+        }
+    }
+}
+
+RSJ::EpochGuard::ThreadState::~ThreadState()
+{
+    if (slot)
+        slot->claimed.store(false, std::memory_order_release);
+}
+
+std::uint64_t RSJ::EpochGuard::Advance() noexcept
+{
+    return epoch_.fetch_add(1, std::memory_order_seq_cst);
+}
+
+bool RSJ::EpochGuard::Passed(std::uint64_t epoch) noexcept
+{
+    //a reader without a slot could be in any epoch
+    if (overflow_.load(std::memory_order_seq_cst))
+        return false;
+    for (const auto& slot : slots_) {
+        const auto entered = slot.epoch.load(std::memory_order_seq_cst);
+        if (entered && entered <= epoch)
+            return false;
+    }
+    return true;
+}
+
 std::string RSJ::trim(const std::string& str, const std::string& what)
 {
     const auto front = str.find_first_not_of(what);
@@ -22,13 +22,21 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #ifndef MIDI2LR_UTILITIES_H_INCLUDED
 #define MIDI2LR_UTILITIES_H_INCLUDED
 
+#include <algorithm>
+#include <array>
 #include <atomic>
 #include <cctype>
+#include <chrono>
 #include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <stdexcept>
 #include <string>
 #include <utility>
+#include <vector>
+#include <gsl/gsl>
 namespace RSJ {
     template <typename T>
     struct counter {
@@ -79,67 +87,353 @@ namespace RSJ {
 
     */
 
-    template<typename T>
-    class threadsafe_queue {
-    private:
-        bool other_notification_{false};
-        mutable std::mutex mut_;
-        std::condition_variable data_cond_;
-        std::queue<T> data_queue_;
+    // Fixed-capacity lock-free ring for exactly one producer thread and one
+    // consumer thread. Never allocates after construction, so it is safe to push
+    // from real-time callbacks. try_push fails (and the caller may count the drop)
+    // when the ring is full.
+    template<typename T, size_t Capacity>
+    class spsc_queue {
+        static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+            "spsc_queue capacity must be a power of two");
     public:
-        threadsafe_queue()
-        {}
-        void NotifyOther()
+        spsc_queue() = default;
+        spsc_queue(const spsc_queue&) = delete;
+        spsc_queue& operator=(const spsc_queue&) = delete;
+        bool try_push(const T& value) noexcept
         {
-            other_notification_ = true;
-            data_cond_.notify_all();
+            const auto tail = tail_.load(std::memory_order_relaxed);
+            if (tail - head_.load(std::memory_order_acquire) == Capacity)
+                return false; //full
+            buffer_[tail & kMask] = value;
+            tail_.store(tail + 1, std::memory_order_release);
+            return true;
         }
-        void push(T new_value)
+        bool try_pop(T& value) noexcept
         {
-            std::lock_guard<std::mutex> lk(mut_);
-            data_queue_.push(std::move(new_value))
-                ; data_cond_.notify_one();
+            const auto head = head_.load(std::memory_order_relaxed);
+            if (head == tail_.load(std::memory_order_acquire))
+                return false; //empty
+            value = buffer_[head & kMask];
+            head_.store(head + 1, std::memory_order_release);
+            return true;
         }
-        void wait_and_pop(T& value)
+        // moves up to out.size() values into out, returns how many
+        size_t pop_bulk(gsl::span<T> out) noexcept
         {
-            std::unique_lock<std::mutex> lk(mut_);
-            data_cond_.wait(lk, [this] {return !data_queue_.empty(); });
-            value = std::move(data_queue_.front());
-            data_queue_.pop();
+            const auto head = head_.load(std::memory_order_relaxed);
+            const auto available = tail_.load(std::memory_order_acquire) - head;
+            const auto count = std::min(available, static_cast<size_t>(out.size()));
+            for (size_t i = 0; i < count; ++i)
+                out[static_cast<std::ptrdiff_t>(i)] = std::move(buffer_[(head + i) & kMask]);
+            head_.store(head + count, std::memory_order_release);
+            return count;
         }
-        std::shared_ptr<T> wait_and_pop()
+        bool empty() const noexcept
         {
-            std::unique_lock<std::mutex> lk(mut_);
-            data_cond_.wait(lk, [this] {return !data_queue_.empty(); });
-            std::shared_ptr<T> res(
-                std::make_shared<T>(std::move(data_queue_.front())));
-            data_queue_.pop();
-            return res;
+            return head_.load(std::memory_order_acquire) == tail_.load(std::memory_order_acquire);
         }
-        bool try_pop(T& value)
+    private:
+        static constexpr size_t kMask = Capacity - 1;
+        static constexpr size_t kCacheLine = 64;
+        //padding rather than alignas: over-aligned heap allocation needs C++17
+        std::atomic<size_t> head_{0}; //written only by consumer
+        char pad_head_[kCacheLine - sizeof(std::atomic<size_t>)];
+        std::atomic<size_t> tail_{0}; //written only by producer
+        char pad_tail_[kCacheLine - sizeof(std::atomic<size_t>)];
+        std::array<T, Capacity> buffer_{};
+    };
+
+    // Fixed-capacity ring for any number of producer threads and one consumer
+    // thread. Each slot carries a sequence number, so producers claim slots with
+    // one compare-exchange and never wait for each other. Nothing allocates after
+    // construction. The consumer may block in wait_pop_bulk; producers then take a
+    // mutex to wake it, but only while it is actually asleep.
+    template<typename T, size_t Capacity>
+    class mpsc_queue {
+        static_assert(Capacity > 1 && (Capacity & (Capacity - 1)) == 0,
+            "mpsc_queue capacity must be a power of two");
+    public:
+        mpsc_queue() noexcept
+        {
+            for (size_t i = 0; i < Capacity; ++i)
+                cells_[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        mpsc_queue(const mpsc_queue&) = delete;
+        mpsc_queue& operator=(const mpsc_queue&) = delete;
+        bool try_push(const T& value) noexcept
         {
-            std::lock_guard<std::mutex> lk(mut_);
-            if (data_queue_.empty())
-                return false;
-            value = std::move(data_queue_.front());
-            data_queue_.pop();
+            auto tail = tail_.load(std::memory_order_relaxed);
+            for (;;) {
+                auto& cell = cells_[tail & kMask];
+                const auto sequence = cell.sequence.load(std::memory_order_acquire);
+                const auto lag = static_cast<std::ptrdiff_t>(sequence - tail);
+                if (lag == 0) {
+                    if (tail_.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed))
+                        break;
+                }
+                else if (lag < 0)
+                    return false; //full
+                else
+                    tail = tail_.load(std::memory_order_relaxed);
+            }
+            auto& cell = cells_[tail & kMask];
+            cell.value = value;
+            cell.sequence.store(tail + 1, std::memory_order_release);
+            //pairs with the fence in wait_pop_bulk: either it sees this value or we see it waiting
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (waiting_.load(std::memory_order_relaxed)) {
+                std::lock_guard<std::mutex> lock(mutex_);
+                wake_.notify_one();
+            }
             return true;
         }
-        std::shared_ptr<T> try_pop()
+        // consumer only: moves up to out.size() values into out, returns how many
+        size_t pop_bulk(gsl::span<T> out) noexcept
+        {
+            std::ptrdiff_t count = 0;
+            for (; count < out.size(); ++count, ++head_) {
+                auto& cell = cells_[head_ & kMask];
+                if (cell.sequence.load(std::memory_order_acquire) != head_ + 1)
+                    break; //empty, or a producer hasn't finished writing
+                out[count] = std::move(cell.value);
+                cell.sequence.store(head_ + Capacity, std::memory_order_release);
+            }
+            return static_cast<size_t>(count);
+        }
+        // consumer only: as pop_bulk, but first waits up to timeout for a value.
+        // Returns 0 on timeout or after wake
+        template<class Rep, class Period>
+        size_t wait_pop_bulk(gsl::span<T> out, const std::chrono::duration<Rep, Period>& timeout)
         {
-            std::lock_guard<std::mutex> lk(mut_);
-            if (data_queue_.empty())
-                return std::shared_ptr<T>();
-            std::shared_ptr<T> res(
-                std::make_shared<T>(std::move(data_queue_.front())));
-            data_queue_.pop();
-            return res;
+            auto count = pop_bulk(out);
+            if (count)
+                return count;
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            count = pop_bulk(out);
+            if (!count && !woken_) {
+                wake_.wait_for(lock, timeout);
+                count = pop_bulk(out);
+            }
+            woken_ = false;
+            waiting_.store(false, std::memory_order_relaxed);
+            return count;
         }
-        bool empty() const
+        // consumer only: as pop_bulk, but first waits for a value or a wake, however
+        // long that takes. Returns 0 after wake
+        size_t wait_pop_bulk(gsl::span<T> out)
+        {
+            auto count = pop_bulk(out);
+            if (count)
+                return count;
+            std::unique_lock<std::mutex> lock(mutex_);
+            waiting_.store(true, std::memory_order_relaxed);
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            count = pop_bulk(out);
+            while (!count && !woken_) {
+                wake_.wait(lock);
+                count = pop_bulk(out);
+            }
+            woken_ = false;
+            waiting_.store(false, std::memory_order_relaxed);
+            return count;
+        }
+        // wakes a waiting consumer without a value, e.g. to let it exit. A wake before
+        // the consumer waits is kept for its next wait
+        void wake()
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            woken_ = true;
+            wake_.notify_one();
+        }
+    private:
+        struct Cell {
+            std::atomic<size_t> sequence{0}; //position + 1 when full, position + Capacity when free again
+            T value{};
+        };
+        static constexpr size_t kMask = Capacity - 1;
+        static constexpr size_t kCacheLine = 64;
+        std::atomic<size_t> tail_{0}; //claimed by producers
+        char pad_tail_[kCacheLine - sizeof(std::atomic<size_t>)];
+        size_t head_{0}; //consumer only
+        std::atomic<bool> waiting_{false};
+        std::mutex mutex_; //only for sleeping and waking
+        bool woken_{false}; //guarded by mutex_
+        std::condition_variable wake_;
+        std::array<Cell, Capacity> cells_;
+    };
+
+    // Fixed-capacity list of (object, member function) subscribers. The member
+    // function is a template argument, so each entry is just an object pointer and
+    // a plain function pointer: no std::function, std::bind or heap allocation.
+    // Entries may be added while another thread is invoking the list.
+    template<size_t Capacity, typename... Args>
+    class callback_list {
+    public:
+        callback_list() = default;
+        callback_list(const callback_list&) = delete;
+        callback_list& operator=(const callback_list&) = delete;
+        template<class T, void (T::*MF)(Args...)> void add(T* const object)
+        {
+            const auto size = size_.load(std::memory_order_relaxed);
+            if (size == Capacity)
+                throw std::length_error("Too many callbacks registered in callback_list");
+            entries_[size] = {object, &Invoke_<T, MF>};
+            size_.store(size + 1, std::memory_order_release);
+        }
+        void operator()(Args... args) const
+        {
+            const auto size = size_.load(std::memory_order_acquire);
+            for (size_t i = 0; i < size; ++i)
+                entries_[i].invoke(entries_[i].object, args...);
+        }
+    private:
+        template<class T, void (T::*MF)(Args...)> static void Invoke_(void* object, Args... args)
         {
-            std::lock_guard<std::mutex> lk(mut_);
-            return data_queue_.empty();
+            (static_cast<T*>(object)->*MF)(args...);
         }
+        struct Entry {
+            void* object;
+            void(*invoke)(void*, Args...);
+        };
+        std::array<Entry, Capacity> entries_{};
+        std::atomic<size_t> size_{0};
+    };
+
+    // Epoch-based reclamation for objects a writer replaces while real-time threads read
+    // them. A reader holds an EpochGuard while it uses what it loaded from a Published.
+    // Entering stores the current epoch in the calling thread's own slot, so readers take
+    // no lock, wait for nothing and share no counter. A replaced object is freed only once
+    // no slot is still in the epoch it was replaced in. Guards nest, and stay on the
+    // thread that made them
+    class EpochGuard {
+    public:
+        EpochGuard() noexcept
+        {
+            auto& state = State_();
+            if (state.depth++)
+                return;
+            if (state.slot)
+                state.slot->epoch.store(epoch_.load(std::memory_order_seq_cst),
+                    std::memory_order_seq_cst);
+            else //more reader threads than slots
+                overflow_.fetch_add(1, std::memory_order_seq_cst);
+        }
+        ~EpochGuard()
+        {
+            if (!active_)
+                return;
+            auto& state = State_();
+            if (--state.depth)
+                return;
+            if (state.slot)
+                state.slot->epoch.store(0, std::memory_order_release);
+            else
+                overflow_.fetch_sub(1, std::memory_order_release);
+        }
+        EpochGuard(EpochGuard&& other) noexcept: active_{other.active_}
+        {
+            other.active_ = false;
+        }
+        EpochGuard(const EpochGuard&) = delete;
+        EpochGuard& operator=(const EpochGuard&) = delete;
+        EpochGuard& operator=(EpochGuard&&) = delete;
+        // starts a new epoch, returning the one that ended. Writers only
+        static std::uint64_t Advance() noexcept;
+        // true if no reader can still be in epoch or an older one. Writers only
+        static bool Passed(std::uint64_t epoch) noexcept;
+    private:
+        static constexpr size_t kSlots = 128;
+        static constexpr size_t kCacheLine = 64;
+        struct Slot {
+            std::atomic<std::uint64_t> epoch{0}; //0 while the thread isn't reading
+            std::atomic<bool> claimed{false};
+            char pad_[kCacheLine - sizeof(std::atomic<std::uint64_t>) - sizeof(std::atomic<bool>)];
+        };
+        // a thread claims a slot on its first read and frees it when it ends
+        struct ThreadState {
+            ThreadState() noexcept;
+            ~ThreadState();
+            Slot* slot{nullptr};
+            size_t depth{0};
+        };
+        static ThreadState& State_() noexcept
+        {
+            thread_local ThreadState state;
+            return state;
+        }
+        static std::atomic<std::uint64_t> epoch_;
+        static std::atomic<size_t> overflow_; //readers without a slot
+        static std::array<Slot, kSlots> slots_;
+        bool active_{true};
+    };
+
+    // An immutable object readers load under an EpochGuard while writers replace it.
+    // Replaced objects wait until EpochGuard says no reader can still have them, and
+    // each Publish frees those it can. Objects are held by shared_ptr, so a T deriving
+    // from std::enable_shared_from_this can be kept past the guard by the few readers
+    // that need to
+    template<typename T>
+    class Published {
+    public:
+        // what a reader loaded, valid while it lives
+        class Reader {
+        public:
+            Reader() noexcept:
+                object_{nullptr}
+            {}
+            explicit Reader(const Published& published) noexcept:
+                object_{published.current_.load(std::memory_order_seq_cst)}
+            {}
+            const T& operator*() const noexcept
+            {
+                return *object_;
+            }
+            const T* operator->() const noexcept
+            {
+                return object_;
+            }
+            const T* get() const noexcept
+            {
+                return object_;
+            }
+        private:
+            EpochGuard guard_{}; //entered before object_ is loaded
+            const T* object_;
+        };
+
+        explicit Published(std::shared_ptr<const T> initial) noexcept:
+            current_{initial.get()}, owner_{std::move(initial)}
+        {}
+        Published(const Published&) = delete;
+        Published& operator=(const Published&) = delete;
+        Reader Read() const noexcept
+        {
+            return Reader{*this};
+        }
+        void Publish(std::shared_ptr<const T> next)
+        {
+            std::lock_guard<decltype(writer_mutex_)> lock(writer_mutex_);
+            current_.store(next.get(), std::memory_order_seq_cst);
+            retired_.emplace_back(EpochGuard::Advance(), std::move(owner_));
+            owner_ = std::move(next);
+            retired_.erase(std::remove_if(retired_.begin(), retired_.end(),
+                [](const std::pair<std::uint64_t, std::shared_ptr<const T>>& retired) noexcept {
+                return EpochGuard::Passed(retired.first);
+            }), retired_.end());
+        }
+        // replaced objects still waiting for readers
+        size_t Retired() const
+        {
+            std::lock_guard<decltype(writer_mutex_)> lock(writer_mutex_);
+            return retired_.size();
+        }
+    private:
+        std::atomic<const T*> current_;
+        mutable std::mutex writer_mutex_; //writers only
+        std::shared_ptr<const T> owner_; //of current_
+        std::vector<std::pair<std::uint64_t, std::shared_ptr<const T>>> retired_{};
     };
 
     static const std::string space = " \t\n\v\f\r";
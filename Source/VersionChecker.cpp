@@ -22,19 +22,74 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 */
 #include "VersionChecker.h"
 #include "SettingsManager.h"
+#include "ThreadStats.h"
+
+namespace {
+    constexpr int kConnectTimeout = 3000; //ms
+    constexpr int kMaxRedirects = 3;
+    constexpr int kStopWait = 500; //ms, the request is cancelled first
+    constexpr juce::int64 kMsPerHour = 60 * 60 * 1000;
+}
 
 VersionChecker::VersionChecker(SettingsManager* const setmgr) noexcept :
 juce::Thread{"VersionChecker"}, settings_manager_{setmgr}{}
 
 VersionChecker::~VersionChecker()
 {
-    stopThread(100);
+    Cancel();
+}
+
+void VersionChecker::Cancel()
+{
+    signalThreadShouldExit();
+    {
+        std::lock_guard<decltype(mutex_stream_)> lock(mutex_stream_);
+        if (stream_)
+            stream_->cancel();
+    }
+    stopThread(kStopWait);
 }
 
 void VersionChecker::run()
 {
+    const ThreadAccount account{"VersionChecker"};
+    const auto now = juce::Time::currentTimeMillis();
+    const auto last_check = settings_manager_->getLastVersionCheck();
+    if (now - last_check < settings_manager_->getVersionCheckInterval() * kMsPerHour &&
+        now >= last_check)
+        return; //checked recently enough
     const juce::URL version_url{"http://rsjaffe.github.io/MIDI2LR/version.xml"};
-    const std::unique_ptr<juce::XmlElement> version_xml_element{version_url.readEntireXmlStream()};
+    juce::WebInputStream stream{version_url, false};
+    // conditional request: an unchanged file costs the server a 304 and us nothing
+    juce::String headers;
+    const auto etag = settings_manager_->getVersionETag();
+    const auto modified = settings_manager_->getVersionLastModified();
+    if (etag.isNotEmpty())
+        headers << "If-None-Match: " << etag << "\r\n";
+    if (modified.isNotEmpty())
+        headers << "If-Modified-Since: " << modified << "\r\n";
+    stream.withConnectionTimeout(kConnectTimeout).withNumRedirectsToFollow(kMaxRedirects).
+        withExtraHeaders(headers);
+    {
+        std::lock_guard<decltype(mutex_stream_)> lock(mutex_stream_);
+        if (threadShouldExit())
+            return;
+        stream_ = &stream;
+    }
+    const auto body = stream.connect(nullptr) && stream.getStatusCode() == 200 ?
+        stream.readEntireStreamAsString() : juce::String{};
+    const auto status = stream.getStatusCode();
+    const auto response = stream.getResponseHeaders();
+    {
+        std::lock_guard<decltype(mutex_stream_)> lock(mutex_stream_);
+        stream_ = nullptr;
+    }
+    if (threadShouldExit() || (status != 200 && status != 304))
+        return; //offline or cancelled: try again next start
+    settings_manager_->setVersionCheck(now, response["ETag"], response["Last-Modified"]);
+    if (status == 304)
+        return; //nothing new since the last answer, which was already acted on
+    const std::unique_ptr<juce::XmlElement> version_xml_element{juce::XmlDocument::parse(body)};
 
     if (version_xml_element != nullptr) {
         const auto last_checked = settings_manager_->getLastVersionFound();
@@ -23,13 +23,18 @@ MIDI2LR.  If not, see <http://www.gnu.org/licenses/>.
 #define MIDI2LR_VERSIONCHECKER_H_INCLUDED
 
 #include <memory>
+#include <mutex>
 #include "../JuceLibraryCode/JuceHeader.h"
 class SettingsManager;
 
+// checks for a newer release at most once per SettingsManager::getVersionCheckInterval,
+// asking the server only for changes since the last answer. Never blocks start-up or quit
 class VersionChecker final: public juce::Thread, private juce::AsyncUpdater {
 public:
     explicit VersionChecker(SettingsManager* const settings_manager_) noexcept;
     ~VersionChecker();
+    // abandons a check in progress, returning without waiting for the network
+    void Cancel();
 
 private:
     // Thread interface
@@ -40,6 +45,8 @@ class VersionChecker final: public juce::Thread, private juce::AsyncUpdater {
 
     int new_version_{0};
     SettingsManager* const settings_manager_;
+    std::mutex mutex_stream_;
+    juce::WebInputStream* stream_{nullptr}; //request in progress, for Cancel
     std::unique_ptr<juce::DialogWindow> dialog_;
 };
 